@@ -22,6 +22,7 @@
 #include <cstddef>
 #include <new>
 #include <type_traits>
+#include <utility>
 #include "aribcc_export.h"
 
 namespace aribcaption {
@@ -30,6 +31,13 @@ ARIBCC_API void* AlignedAlloc(size_t size, size_t alignment);
 
 ARIBCC_API void AlignedFree(void* ptr);
 
+/**
+ * Allocator of N-bytes aligned memory
+ *
+ * Elements are default-initialized rather than value-initialized on construction without arguments,
+ * e.g. resize() of a std::vector<uint8_t, AlignedAllocator> leaves the new bytes uninitialized,
+ * so that pixel buffers which are about to be overwritten are not cleared beforehand.
+ */
 template <class T, std::size_t N>
 class AlignedAllocator {
     static_assert(N % 4 == 0);
@@ -62,6 +70,16 @@ public:
         void* ptr = p;
         AlignedFree(ptr);
     }
+
+    template <class U>
+    void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>) {
+        ::new(static_cast<void*>(ptr)) U;
+    }
+
+    template <class U, class... Args>
+    void construct(U* ptr, Args&&... args) {
+        ::new(static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+    }
 };
 
 template <class T, std::size_t M,
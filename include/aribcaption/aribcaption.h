@@ -31,4 +31,8 @@
 #include "renderer.h"
 #endif  // ARIBCC_NO_RENDERER
 
+#ifdef ARIBCC_USE_AHARDWAREBUFFER
+#include "hardware_buffer_output.h"
+#endif  // ARIBCC_USE_AHARDWAREBUFFER
+
 #endif  // ARIBCAPTION_ARIBCAPTION_H
@@ -24,11 +24,28 @@
 #include "context.hpp"
 #include "color.hpp"
 #include "caption.hpp"
+#include "caption_view.hpp"
 #include "decoder.hpp"
+#include "caption_seek_index.hpp"
+#include "subtitle_writer.hpp"
+#include "ts_demuxer.hpp"
 
 #ifndef ARIBCC_NO_RENDERER
 #include "image.hpp"
 #include "renderer.hpp"
+#include "caption_pipeline.hpp"
 #endif  // ARIBCC_NO_RENDERER
 
+#ifdef ARIBCC_USE_GLES
+#include "gles_compositor.hpp"
+#endif  // ARIBCC_USE_GLES
+
+#ifdef ARIBCC_USE_COREVIDEO
+#include "pixel_buffer_output.hpp"
+#endif  // ARIBCC_USE_COREVIDEO
+
+#ifdef ARIBCC_USE_AHARDWAREBUFFER
+#include "hardware_buffer_output.hpp"
+#endif  // ARIBCC_USE_AHARDWAREBUFFER
+
 #endif  // ARIBCAPTION_ARIBCAPTION_HPP
@@ -345,6 +345,86 @@ typedef struct aribcc_caption_t {
 ARIBCC_API void aribcc_caption_cleanup(aribcc_caption_t* caption);
 
 
+/**
+ * Opaque type holding a caption without converting it into @aribcc_caption_t.
+ *
+ * Obtained from @aribcc_decoder_decode_handle(), and can be handed over to the renderer
+ * through @aribcc_renderer_append_caption_handle() without deep copies.
+ * Caption fields are inspected through the accessor functions below.
+ *
+ * Release it with @aribcc_caption_handle_free() unless its ownership has been transferred.
+ */
+typedef struct aribcc_caption_handle_t aribcc_caption_handle_t;
+
+ARIBCC_API void aribcc_caption_handle_free(aribcc_caption_handle_t* caption);
+
+ARIBCC_API aribcc_captiontype_t aribcc_caption_handle_get_type(const aribcc_caption_handle_t* caption);
+
+ARIBCC_API aribcc_captionflags_t aribcc_caption_handle_get_flags(const aribcc_caption_handle_t* caption);
+
+ARIBCC_API uint32_t aribcc_caption_handle_get_iso6392_language_code(const aribcc_caption_handle_t* caption);
+
+/**
+ * Get caption statements in UTF-8. Owned by the handle, never NULL.
+ */
+ARIBCC_API const char* aribcc_caption_handle_get_text(const aribcc_caption_handle_t* caption);
+
+ARIBCC_API int64_t aribcc_caption_handle_get_pts(const aribcc_caption_handle_t* caption);
+
+ARIBCC_API int64_t aribcc_caption_handle_get_wait_duration(const aribcc_caption_handle_t* caption);
+
+ARIBCC_API void aribcc_caption_handle_get_plane_size(const aribcc_caption_handle_t* caption,
+                                                     int* plane_width,
+                                                     int* plane_height);
+
+/**
+ * Query Built-in Sound Replay of the caption
+ *
+ * @param caption           @aribcc_caption_handle_t
+ * @param builtin_sound_id  Parameter for writing back the sound ID, may be NULL
+ * @return true if the caption indicates a Built-in Sound Replay
+ */
+ARIBCC_API bool aribcc_caption_handle_get_builtin_sound(const aribcc_caption_handle_t* caption,
+                                                        uint8_t* builtin_sound_id);
+
+/**
+ * Get the fingerprint of the caption content computed by the decoder, 0 if unknown
+ */
+ARIBCC_API uint64_t aribcc_caption_handle_get_fingerprint(const aribcc_caption_handle_t* caption);
+
+ARIBCC_API uint32_t aribcc_caption_handle_get_region_count(const aribcc_caption_handle_t* caption);
+
+/**
+ * Get the fingerprint of a caption region's content computed by the decoder
+ *
+ * @param caption  @aribcc_caption_handle_t
+ * @param index    region index, must be less than @aribcc_caption_handle_get_region_count()
+ * @return 0 if unknown or index is out of range
+ */
+ARIBCC_API uint64_t aribcc_caption_handle_get_region_fingerprint(const aribcc_caption_handle_t* caption,
+                                                                 uint32_t index);
+
+/**
+ * Get a caption region without copying its chars
+ *
+ * The chars array of out_region points into the handle, and stays valid until the handle is released
+ * or transferred. Do not call @aribcc_caption_region_cleanup() on it.
+ *
+ * @param caption     @aribcc_caption_handle_t
+ * @param index       region index, must be less than @aribcc_caption_handle_get_region_count()
+ * @param out_region  Parameter for writing back the region, must be non-null
+ * @return false if index is out of range
+ */
+ARIBCC_API bool aribcc_caption_handle_get_region(aribcc_caption_handle_t* caption,
+                                                 uint32_t index,
+                                                 aribcc_caption_region_t* out_region);
+
+/**
+ * Get DRCS hashmap of the caption, owned by the handle. May be NULL if DRCS not exists.
+ */
+ARIBCC_API aribcc_drcsmap_t* aribcc_caption_handle_get_drcs_map(aribcc_caption_handle_t* caption);
+
+
 
 #ifdef __cplusplus
 }  // extern "C"
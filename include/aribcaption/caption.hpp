@@ -25,6 +25,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include "aribcc_export.h"
 #include "color.hpp"
 
 namespace aribcaption {
@@ -151,12 +152,18 @@ struct CaptionChar {
 
     /**
      * String representation of character encoded in UTF-8. This string is Null-terminated.
-     * Will be empty string if CaptionCharType is kDRCS because alternative codepoint is unknown.
+     * Will be empty string if CaptionCharType is kDRCS because alternative codepoint is unknown,
+     * or if disabled by @Decoder::SetGenerateCharUTF8().
      */
     char u8str[8] = {0};
 public:
     CaptionChar() = default;
 
+    /**
+     * Rebuild u8str from the codepoint
+     */
+    ARIBCC_API void UpdateU8Str();
+
     /**
      * Helper function for calculating the width of the character block
      */
@@ -174,6 +181,82 @@ public:
     }
 };
 
+/**
+ * Run of consecutive caption characters sharing the same attributes, see @CompactCaptionChars
+ *
+ * Characters of a run are placed one after another in a line,
+ * i.e. the N-th character is located at (x + N * section_width(), y).
+ */
+struct CaptionCharRun {
+    uint32_t char_count = 0;
+    CaptionCharType type = CaptionCharType::kDefault;
+    CharStyle style = CharStyle::kCharStyleDefault;
+    EnclosureStyle enclosure_style = EnclosureStyle::kEnclosureStyleDefault;
+
+    int x = 0;  ///< Position of the first character
+    int y = 0;
+    int char_width = 0;
+    int char_height = 0;
+    int char_horizontal_spacing = 0;
+    int char_vertical_spacing = 0;
+    float char_horizontal_scale = 0.0f;
+    float char_vertical_scale = 0.0f;
+
+    ColorRGBA text_color;
+    ColorRGBA back_color;
+    ColorRGBA stroke_color;
+public:
+    [[nodiscard]]
+    int section_width() const {
+        return (int)std::floor((float)(char_width + char_horizontal_spacing) * char_horizontal_scale);
+    }
+
+    [[nodiscard]]
+    int section_height() const {
+        return (int)std::floor((float)(char_height + char_vertical_spacing) * char_vertical_scale);
+    }
+};
+
+/**
+ * Compact representation of an array of CaptionChar
+ *
+ * Attributes shared by consecutive characters are stored once per @CaptionCharRun,
+ * while each character only takes a codepoint. UTF-8 strings are derived from codepoints on expanding.
+ */
+struct CompactCaptionChars {
+    std::vector<CaptionCharRun> runs;
+    std::vector<uint32_t> codepoints;      ///< Codepoint of each character
+    std::vector<uint32_t> pua_codepoints;  ///< PUA codepoint of each character, empty if none of them has one
+    std::vector<uint32_t> drcs_codes;      ///< DRCS code of each character, empty if there's no DRCS character
+public:
+    [[nodiscard]]
+    size_t size() const { return codepoints.size(); }
+
+    [[nodiscard]]
+    bool empty() const { return codepoints.empty(); }
+
+    void clear() {
+        runs.clear();
+        codepoints.clear();
+        pua_codepoints.clear();
+        drcs_codes.clear();
+    }
+
+    /**
+     * Build the compact representation of chars
+     *
+     * @return false if chars couldn't be represented exactly, i.e. CaptionChar::u8str doesn't match the codepoint.
+     *         Empty CaptionChar::u8str is accepted, and will be filled on expanding.
+     *         This object is cleared in that case.
+     */
+    ARIBCC_API bool Assign(const std::vector<CaptionChar>& chars);
+
+    /**
+     * Expand into an array of CaptionChar, reusing the capacity of out_chars
+     */
+    ARIBCC_API void Expand(std::vector<CaptionChar>& out_chars) const;
+};
+
 /**
  * Structure contains DRCS data and related information.
  */
@@ -194,16 +277,37 @@ public:
     DRCS& operator=(DRCS&&) noexcept = default;
 };
 
+/**
+ * Map of DRCS characters, keyed by CaptionChar::drcs_code
+ */
+using DRCSMap = std::unordered_map<uint32_t, DRCS>;
+
 /**
  * Structure represents a caption region.
  */
 struct CaptionRegion {
     std::vector<CaptionChar> chars;
+
+    /**
+     * Compact form of chars, only used if the caption is stored compactly,
+     * e.g. by @Renderer::SetCompactCaptionStorage(). chars will be empty in that case.
+     */
+    CompactCaptionChars compact_chars;
+
     int x = 0;
     int y = 0;
     int width = 0;
     int height = 0;
     bool is_ruby = false;           ///< Will be true if the region is likely to be ruby text (furigana)
+
+    /**
+     * 64-bit fingerprint of the region content computed by the decoder, 0 if unknown
+     *
+     * Covers text, styles, colors, geometry and DRCS patterns of the chars, so that identical regions could be
+     * detected without comparing the chars. Reset it to 0 if the region is modified after decoding.
+     * Not carried by @SerializeCaption().
+     */
+    uint64_t fingerprint = 0;
 public:
     CaptionRegion() = default;
     CaptionRegion(const CaptionRegion&) = default;
@@ -237,6 +341,7 @@ struct Caption {
     /**
      * Caption statements represented in UTF-8 string.
      * Ruby text is excluded in this string.
+     * Will be empty if disabled by @Decoder::SetGenerateCaptionText(), see @UpdateText().
      *
      * Pay attention to the UTF-8 encoding if you are under Windows.
      */
@@ -252,7 +357,7 @@ struct Caption {
      *
      * Use CaptionChar::drcs_code as key for retrieving DRCS.
      */
-    std::unordered_map<uint32_t, DRCS> drcs_map;
+    DRCSMap drcs_map;
 
     /**
      * Caption't presentation timestamp, in milliseconds
@@ -287,12 +392,29 @@ struct Caption {
      * The ID of build-in sound for playback. Valid only if has_builtin_sound is true.
      */
     uint8_t builtin_sound_id = 0;
+
+    /**
+     * 64-bit fingerprint of the caption content computed by the decoder, 0 if unknown
+     *
+     * Covers the text, flags, duration, plane size, builtin sound and fingerprints of all regions, PTS excluded.
+     * Retransmitted captions thus share the same fingerprint. Reset it to 0 if the caption is modified after decoding.
+     */
+    uint64_t fingerprint = 0;
 public:
     Caption() = default;
     Caption(const Caption&) = default;
     Caption(Caption&&) noexcept = default;
     Caption& operator=(const Caption&) = default;
     Caption& operator=(Caption&&) noexcept = default;
+
+    /**
+     * Rebuild text from the characters of non-ruby regions
+     *
+     * DRCS characters without alternative text are represented by a Geta Mark (U+3013), and a line feed is
+     * inserted whenever the characters move onto another row. Since the original control codes are gone,
+     * the result may differ from the one built by the decoder in line feeds.
+     */
+    ARIBCC_API void UpdateText();
 };
 
 }  // namespace aribcaption
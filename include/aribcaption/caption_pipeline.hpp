@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_CAPTION_PIPELINE_HPP
+#define ARIBCAPTION_CAPTION_PIPELINE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "aribcc_export.h"
+#include "caption.hpp"
+#include "context.hpp"
+#include "decoder.hpp"
+#include "renderer.hpp"
+
+namespace aribcaption {
+
+namespace internal { class CaptionPipelineImpl; }
+
+/**
+ * Decoder and Renderer connected by a lock-free queue, for decoding and rendering on different threads
+ *
+ * The demuxing thread feeds PES data through @Decode() / @Feed(), decoded captions are moved into a
+ * single-producer single-consumer queue. The rendering thread calls @Render(), which moves queued captions
+ * into the renderer before rendering. Neither side takes a lock or waits for the other.
+ *
+ * Thread safety: functions of the demuxing side (@Decode(), @Feed(), @Flush(), @decoder()) must be called
+ * from one thread, and functions of the rendering side (@TryRender(), @Render(), @renderer()) from another one.
+ * Both @Decoder and @Renderer must be initialized through the accessors before feeding any data.
+ */
+class CaptionPipeline {
+public:
+    /**
+     * A context is needed for constructing the CaptionPipeline.
+     *
+     * The context shouldn't be destructed before any other object constructed from the context has been destructed.
+     *
+     * @param context        see @Context
+     * @param queue_capacity Count of captions could be held between the two threads, rounded up to a power of 2.
+     *                       Captions decoded while the queue is full are kept on the demuxing side,
+     *                       and queued by the following @Decode() / @Feed() calls.
+     */
+    ARIBCC_API explicit CaptionPipeline(Context& context, size_t queue_capacity = 64);
+    ARIBCC_API ~CaptionPipeline();
+    ARIBCC_API CaptionPipeline(CaptionPipeline&&) noexcept;
+    ARIBCC_API CaptionPipeline& operator=(CaptionPipeline&&) noexcept;
+public:
+    /**
+     * Get the decoder, for initializing and configuring from the demuxing thread
+     */
+    [[nodiscard]]
+    ARIBCC_API Decoder& decoder();
+
+    /**
+     * Get the renderer, for initializing and configuring from the rendering thread
+     *
+     * Don't append captions into the renderer directly.
+     */
+    [[nodiscard]]
+    ARIBCC_API Renderer& renderer();
+
+    /**
+     * Decode caption PES data and queue the decoded caption for rendering. Called on the demuxing thread.
+     *
+     * See @Decoder::Decode()
+     */
+    ARIBCC_API DecodeStatus Decode(const uint8_t* pes_data, size_t length, int64_t pts);
+
+    /**
+     * Feed caption PES data fragment by fragment, queueing decoded captions for rendering.
+     * Called on the demuxing thread.
+     *
+     * See @Decoder::Feed()
+     */
+    ARIBCC_API DecodeStatus Feed(const uint8_t* data, size_t length, int64_t pts, bool packet_start);
+
+    /**
+     * Reset the decoder, e.g. after seeking. Called on the demuxing thread.
+     *
+     * Captions queued before are discarded, and the renderer is flushed by the next @TryRender() / @Render() call.
+     */
+    ARIBCC_API void Flush();
+
+    /**
+     * Move queued captions into the renderer, then call @Renderer::TryRender(). Called on the rendering thread.
+     */
+    ARIBCC_API RenderStatus TryRender(int64_t pts);
+
+    /**
+     * Move queued captions into the renderer, then call @Renderer::Render(). Called on the rendering thread.
+     */
+    ARIBCC_API RenderStatus Render(int64_t pts, RenderResult& out_result);
+public:
+    CaptionPipeline(const CaptionPipeline&) = delete;
+    CaptionPipeline& operator=(const CaptionPipeline&) = delete;
+private:
+    std::unique_ptr<internal::CaptionPipelineImpl> pimpl_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_CAPTION_PIPELINE_HPP
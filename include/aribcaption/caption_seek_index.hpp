@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_CAPTION_SEEK_INDEX_HPP
+#define ARIBCAPTION_CAPTION_SEEK_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "aribcc_export.h"
+#include "decoder.hpp"
+
+namespace aribcaption {
+
+/**
+ * Seek point recorded in @CaptionSeekIndex
+ */
+struct CaptionSeekPoint {
+    int64_t pts = 0;           ///< PTS of the caption PES packet, in milliseconds
+    uint64_t file_offset = 0;  ///< File offset where feeding should be resumed, e.g. @TSCaptionPacket::offset
+    uint32_t state_index = 0;  ///< Index of the decoder state to be restored before decoding the packet
+};
+
+/**
+ * Seek index of a caption stream, mapping PTS to file offset and the decoder state required at that position
+ *
+ * Build it while decoding the stream from the beginning: call @Decoder::SaveState() right before decoding each
+ * caption PES packet and @Append() the result. Identical states are stored only once.
+ *
+ * After a seek, @Seek() restores the decoder to the state of the seek point in O(1), so that decoding could be
+ * resumed from the file offset of the seek point without replaying the PES packets before.
+ *
+ * The index could be serialized into a compact, versioned binary format by @Serialize() / @SaveToFile().
+ */
+class CaptionSeekIndex {
+public:
+    ARIBCC_API CaptionSeekIndex();
+    ARIBCC_API ~CaptionSeekIndex();
+    ARIBCC_API CaptionSeekIndex(const CaptionSeekIndex&);
+    ARIBCC_API CaptionSeekIndex(CaptionSeekIndex&&) noexcept;
+    ARIBCC_API CaptionSeekIndex& operator=(const CaptionSeekIndex&);
+    ARIBCC_API CaptionSeekIndex& operator=(CaptionSeekIndex&&) noexcept;
+public:
+    /**
+     * Append a seek point
+     *
+     * Seek points must be appended in non-decreasing PTS order.
+     *
+     * @param pts          PTS of the caption PES packet, in milliseconds
+     * @param file_offset  File offset where feeding should be resumed for decoding the packet
+     * @param state        Decoder state saved by @Decoder::SaveState() right before decoding the packet
+     * @return false if the PTS is decreasing
+     */
+    ARIBCC_API bool Append(int64_t pts, uint64_t file_offset, const std::vector<uint8_t>& state);
+
+    /**
+     * Find the last seek point whose PTS is less than or equal to the specified PTS
+     *
+     * @return nullptr if the index is empty or the PTS is earlier than the first seek point
+     */
+    [[nodiscard]]
+    ARIBCC_API const CaptionSeekPoint* FindSeekPoint(int64_t pts) const;
+
+    /**
+     * Restore the decoder to the state of the seek point found by @FindSeekPoint()
+     *
+     * The decoder is flushed if the PTS is earlier than the first seek point, since decoding starts over in that case.
+     *
+     * @param pts              target PTS, in milliseconds
+     * @param decoder          decoder to be restored
+     * @param out_file_offset  Write back parameter for the file offset where feeding should be resumed
+     * @return false if the index is empty or the state couldn't be restored
+     */
+    ARIBCC_API bool Seek(int64_t pts, Decoder& decoder, uint64_t& out_file_offset) const;
+
+    /**
+     * Get decoder state of a seek point
+     */
+    [[nodiscard]]
+    ARIBCC_API const std::vector<uint8_t>& GetState(const CaptionSeekPoint& point) const;
+
+    [[nodiscard]]
+    const std::vector<CaptionSeekPoint>& seek_points() const { return points_; }
+
+    [[nodiscard]]
+    size_t state_count() const { return states_.size(); }
+
+    /**
+     * Remove all seek points and states
+     */
+    ARIBCC_API void Clear();
+
+    /**
+     * Serialize the index into a compact binary form
+     */
+    ARIBCC_API void Serialize(std::vector<uint8_t>& out_data) const;
+
+    /**
+     * Load an index serialized by @Serialize()
+     *
+     * @return false if the data is invalid, the index is kept unchanged in that case
+     */
+    ARIBCC_API bool Deserialize(const uint8_t* data, size_t size);
+
+    /**
+     * Write the serialized index into a file
+     *
+     * @param filename  File path, in UTF-8
+     */
+    ARIBCC_API bool SaveToFile(const std::string& filename) const;
+
+    /**
+     * Load an index file written by @SaveToFile()
+     *
+     * @param filename  File path, in UTF-8
+     */
+    ARIBCC_API bool LoadFromFile(const std::string& filename);
+private:
+    std::vector<CaptionSeekPoint> points_;
+    std::vector<std::vector<uint8_t>> states_;
+    std::unordered_multimap<uint64_t, uint32_t> state_lookup_;  // State content hash => index into states_
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_CAPTION_SEEK_INDEX_HPP
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_CAPTION_VIEW_HPP
+#define ARIBCAPTION_CAPTION_VIEW_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+#include "aribcc_export.h"
+#include "caption.hpp"
+
+namespace aribcaption {
+
+/**
+ * Binary encoding of Caption, intended for passing captions between processes, e.g. through sockets or shared memory
+ *
+ * The encoding is a single contiguous buffer of little-endian fixed-size records:
+ * a header, followed by region records, char records and DRCS records,
+ * with strings and DRCS pixels stored out of line and referenced by offsets.
+ * Records are read in place through @CaptionView without rebuilding STL containers.
+ *
+ * The header records the format version and the size of each record type:
+ * readers accept buffers of the same major version with larger records, so fields could be appended later.
+ */
+constexpr uint32_t kCaptionEncodingMagic = 0x50414341;  // "ACAP"
+constexpr uint16_t kCaptionEncodingVersion = 1;
+
+/**
+ * Encode a caption into the binary form
+ *
+ * @param caption   caption to be encoded
+ * @param out_data  Write back parameter for the encoded bytes, its capacity is reused
+ */
+ARIBCC_API void SerializeCaption(const Caption& caption, std::vector<uint8_t>& out_data);
+
+namespace internal {
+
+inline uint32_t LoadLE32(const uint8_t* ptr) {
+    return static_cast<uint32_t>(ptr[0]) |
+           static_cast<uint32_t>(ptr[1]) << 8 |
+           static_cast<uint32_t>(ptr[2]) << 16 |
+           static_cast<uint32_t>(ptr[3]) << 24;
+}
+
+inline int32_t LoadLEI32(const uint8_t* ptr) {
+    return static_cast<int32_t>(LoadLE32(ptr));
+}
+
+inline int64_t LoadLEI64(const uint8_t* ptr) {
+    return static_cast<int64_t>(static_cast<uint64_t>(LoadLE32(ptr)) |
+                                static_cast<uint64_t>(LoadLE32(ptr + 4)) << 32);
+}
+
+inline float LoadLEFloat(const uint8_t* ptr) {
+    uint32_t bits = LoadLE32(ptr);
+    float value = 0;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline ColorRGBA LoadColor(const uint8_t* ptr) {
+    return ColorRGBA(ptr[0], ptr[1], ptr[2], ptr[3]);
+}
+
+}  // namespace internal
+
+/**
+ * Read-only view of an encoded CaptionChar
+ */
+class CaptionCharView {
+public:
+    explicit CaptionCharView(const uint8_t* record) : p_(record) {}
+
+    [[nodiscard]] CaptionCharType type() const { return static_cast<CaptionCharType>(p_[0]); }
+    [[nodiscard]] CharStyle style() const { return static_cast<CharStyle>(p_[1]); }
+    [[nodiscard]] EnclosureStyle enclosure_style() const { return static_cast<EnclosureStyle>(p_[2]); }
+    [[nodiscard]] uint32_t codepoint() const { return internal::LoadLE32(p_ + 4); }
+    [[nodiscard]] uint32_t pua_codepoint() const { return internal::LoadLE32(p_ + 8); }
+    [[nodiscard]] uint32_t drcs_code() const { return internal::LoadLE32(p_ + 12); }
+    [[nodiscard]] int x() const { return internal::LoadLEI32(p_ + 16); }
+    [[nodiscard]] int y() const { return internal::LoadLEI32(p_ + 20); }
+    [[nodiscard]] int char_width() const { return internal::LoadLEI32(p_ + 24); }
+    [[nodiscard]] int char_height() const { return internal::LoadLEI32(p_ + 28); }
+    [[nodiscard]] int char_horizontal_spacing() const { return internal::LoadLEI32(p_ + 32); }
+    [[nodiscard]] int char_vertical_spacing() const { return internal::LoadLEI32(p_ + 36); }
+    [[nodiscard]] float char_horizontal_scale() const { return internal::LoadLEFloat(p_ + 40); }
+    [[nodiscard]] float char_vertical_scale() const { return internal::LoadLEFloat(p_ + 44); }
+    [[nodiscard]] ColorRGBA text_color() const { return internal::LoadColor(p_ + 48); }
+    [[nodiscard]] ColorRGBA back_color() const { return internal::LoadColor(p_ + 52); }
+    [[nodiscard]] ColorRGBA stroke_color() const { return internal::LoadColor(p_ + 56); }
+
+    /**
+     * UTF-8 representation of the character, view into the encoded buffer
+     */
+    [[nodiscard]]
+    std::string_view u8str() const {
+        auto str = reinterpret_cast<const char*>(p_ + 60);
+        auto end = static_cast<const char*>(memchr(str, '\0', 8));
+        return std::string_view(str, end ? static_cast<size_t>(end - str) : 8);
+    }
+
+    /**
+     * Decode into a CaptionChar
+     */
+    ARIBCC_API void ToCaptionChar(CaptionChar& out_char) const;
+private:
+    const uint8_t* p_;
+};
+
+/**
+ * Read-only view of an encoded CaptionRegion
+ */
+class CaptionRegionView {
+public:
+    CaptionRegionView(const uint8_t* base, const uint8_t* record, size_t char_record_size)
+        : base_(base), p_(record), char_record_size_(char_record_size) {}
+
+    [[nodiscard]] int x() const { return internal::LoadLEI32(p_); }
+    [[nodiscard]] int y() const { return internal::LoadLEI32(p_ + 4); }
+    [[nodiscard]] int width() const { return internal::LoadLEI32(p_ + 8); }
+    [[nodiscard]] int height() const { return internal::LoadLEI32(p_ + 12); }
+    [[nodiscard]] bool is_ruby() const { return p_[16] != 0; }
+    [[nodiscard]] size_t char_count() const { return internal::LoadLE32(p_ + 20); }
+
+    [[nodiscard]]
+    CaptionCharView char_at(size_t index) const {
+        return CaptionCharView(base_ + internal::LoadLE32(p_ + 24) + index * char_record_size_);
+    }
+
+    /**
+     * Decode into a CaptionRegion, reusing the capacity of out_region.chars
+     */
+    ARIBCC_API void ToCaptionRegion(CaptionRegion& out_region) const;
+private:
+    const uint8_t* base_;
+    const uint8_t* p_;
+    size_t char_record_size_;
+};
+
+/**
+ * Read-only view of an encoded DRCS
+ */
+class DRCSView {
+public:
+    DRCSView(const uint8_t* base, const uint8_t* record) : base_(base), p_(record) {}
+
+    [[nodiscard]] uint32_t code() const { return internal::LoadLE32(p_); }
+    [[nodiscard]] int width() const { return internal::LoadLEI32(p_ + 4); }
+    [[nodiscard]] int height() const { return internal::LoadLEI32(p_ + 8); }
+    [[nodiscard]] int depth() const { return internal::LoadLEI32(p_ + 12); }
+    [[nodiscard]] int depth_bits() const { return internal::LoadLEI32(p_ + 16); }
+    [[nodiscard]] uint32_t alternative_ucs4() const { return internal::LoadLE32(p_ + 20); }
+    [[nodiscard]] const uint8_t* pixels() const { return base_ + internal::LoadLE32(p_ + 24); }
+    [[nodiscard]] size_t pixels_size() const { return internal::LoadLE32(p_ + 28); }
+    [[nodiscard]] std::string_view md5() const { return String(32); }
+    [[nodiscard]] std::string_view alternative_text() const { return String(40); }
+
+    /**
+     * Decode into a DRCS
+     */
+    ARIBCC_API void ToDRCS(DRCS& out_drcs) const;
+private:
+    [[nodiscard]]
+    std::string_view String(size_t field) const {
+        return std::string_view(reinterpret_cast<const char*>(base_ + internal::LoadLE32(p_ + field)),
+                                internal::LoadLE32(p_ + field + 4));
+    }
+private:
+    const uint8_t* base_;
+    const uint8_t* p_;
+};
+
+/**
+ * Zero-copy read view of a caption encoded by @SerializeCaption()
+ *
+ * The whole buffer is validated once by @Open(), after which accessors read records in place without checking.
+ * The view doesn't own the buffer, which must outlive the view and any string views obtained from it.
+ */
+class CaptionView {
+public:
+    CaptionView() = default;
+
+    /**
+     * Validate an encoded caption and attach the view to it
+     *
+     * @param data  buffer of the encoded caption, no alignment is required
+     * @param size  buffer size in bytes, could be larger than the encoded caption
+     * @return false if the buffer is truncated, corrupted or of an unsupported version
+     */
+    ARIBCC_API bool Open(const uint8_t* data, size_t size);
+
+    /**
+     * Size of the encoded caption in bytes, useful for walking through captions stored back to back
+     */
+    [[nodiscard]] size_t encoded_size() const { return internal::LoadLE32(p_ + 8); }
+
+    [[nodiscard]] CaptionType type() const { return static_cast<CaptionType>(p_[12]); }
+    [[nodiscard]] CaptionFlags flags() const { return static_cast<CaptionFlags>(p_[13]); }
+    [[nodiscard]] bool has_builtin_sound() const { return p_[14] != 0; }
+    [[nodiscard]] uint8_t builtin_sound_id() const { return p_[15]; }
+    [[nodiscard]] uint32_t iso6392_language_code() const { return internal::LoadLE32(p_ + 16); }
+    [[nodiscard]] int64_t pts() const { return internal::LoadLEI64(p_ + 20); }
+    [[nodiscard]] int64_t wait_duration() const { return internal::LoadLEI64(p_ + 28); }
+    [[nodiscard]] int plane_width() const { return internal::LoadLEI32(p_ + 36); }
+    [[nodiscard]] int plane_height() const { return internal::LoadLEI32(p_ + 40); }
+
+    [[nodiscard]]
+    std::string_view text() const {
+        return std::string_view(reinterpret_cast<const char*>(p_ + internal::LoadLE32(p_ + 44)),
+                                internal::LoadLE32(p_ + 48));
+    }
+
+    [[nodiscard]] size_t region_count() const { return internal::LoadLE32(p_ + 52); }
+
+    [[nodiscard]]
+    CaptionRegionView region_at(size_t index) const {
+        return CaptionRegionView(p_, p_ + internal::LoadLE32(p_ + 56) + index * region_record_size_,
+                                 char_record_size_);
+    }
+
+    [[nodiscard]] size_t drcs_count() const { return internal::LoadLE32(p_ + 60); }
+
+    [[nodiscard]]
+    DRCSView drcs_at(size_t index) const {
+        return DRCSView(p_, p_ + internal::LoadLE32(p_ + 64) + index * drcs_record_size_);
+    }
+
+    /**
+     * Decode into a Caption, reusing the storage of out_caption where possible
+     */
+    ARIBCC_API void ToCaption(Caption& out_caption) const;
+private:
+    const uint8_t* p_ = nullptr;
+    size_t char_record_size_ = 0;
+    size_t region_record_size_ = 0;
+    size_t drcs_record_size_ = 0;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_CAPTION_VIEW_HPP
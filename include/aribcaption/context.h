@@ -19,6 +19,9 @@
 #ifndef ARIBCAPTION_CONTEXT_H
 #define ARIBCAPTION_CONTEXT_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "aribcc_export.h"
 
 #ifdef __cplusplus
@@ -42,6 +45,8 @@ typedef void(*aribcc_logcat_callback_t)(aribcc_loglevel_t level, const char* mes
  * An opaque type that is needed for other aribcc APIs.
  *
  * Construct a context using @aribcc_context_alloc() before using any other aribcc APIs.
+ *
+ * Functions taking a context may be called concurrently from multiple threads, except @aribcc_context_free().
  */
 typedef struct aribcc_context_t aribcc_context_t;
 
@@ -67,6 +72,245 @@ ARIBCC_API void aribcc_context_set_logcat_callback(aribcc_context_t* context,
                                                    aribcc_logcat_callback_t callback,
                                                    void* userdata);
 
+/**
+ * Indicate the most verbose level of messages to be passed into the logcat callback
+ *
+ * Messages above the level are dropped before being formatted. Default as ARIBCC_LOGLEVEL_VERBOSE.
+ *
+ * @param context  aribcc_context_t*
+ * @param level    See @aribcc_loglevel_t
+ */
+ARIBCC_API void aribcc_context_set_log_level(aribcc_context_t* context, aribcc_loglevel_t level);
+
+/**
+ * Limit the rate of repeated warning & verbose messages, error messages are never suppressed
+ *
+ * @param context                 aribcc_context_t*
+ * @param max_messages_per_second Messages allowed per second for each kind of message, 0 for unlimited (default)
+ */
+ARIBCC_API void aribcc_context_set_log_rate_limit(aribcc_context_t* context, uint32_t max_messages_per_second);
+
+/**
+ * Share loaded font faces and font data between renderers constructed from this context
+ *
+ * Only affects renderers constructed after this call. Disabled by default.
+ *
+ * @param context  aribcc_context_t*
+ * @param share    Enable or disable sharing
+ */
+ARIBCC_API void aribcc_context_set_share_font_faces(aribcc_context_t* context, bool share);
+
+/**
+ * Add a font file (TrueType / OpenType, collections included) loaded into memory
+ *
+ * Added fonts are served by the memory font provider (ARIBCC_FONTPROVIDER_TYPE_MEMORY), which is selected
+ * automatically if no system font provider is available, e.g. for WebAssembly builds running in browsers.
+ * Only affects renderers initialized after this call.
+ *
+ * @param context  aribcc_context_t*
+ * @param data     Font file data, copied into the context
+ * @param size     Size of data in bytes
+ */
+ARIBCC_API void aribcc_context_add_font_data(aribcc_context_t* context, const uint8_t* data, size_t size);
+
+/**
+ * Counters collected by context, see @aribcc_context_set_metrics_enabled()
+ */
+typedef enum aribcc_metric_counter_t {
+    ARIBCC_METRIC_COUNTER_DECODED_PACKETS = 0,
+    ARIBCC_METRIC_COUNTER_DECODE_ERRORS = 1,
+    ARIBCC_METRIC_COUNTER_DECODED_CAPTIONS = 2,
+    ARIBCC_METRIC_COUNTER_RENDERED_REGIONS = 3,
+    ARIBCC_METRIC_COUNTER_IMAGES_PRODUCED = 4,
+    ARIBCC_METRIC_COUNTER_GLYPH_CACHE_HITS = 5,
+    ARIBCC_METRIC_COUNTER_GLYPH_CACHE_MISSES = 6,
+    ARIBCC_METRIC_COUNTER_FONT_LOOKUPS = 7,
+    ARIBCC_METRIC_COUNTER_BITMAP_BYTES_ALLOCATED = 8,
+    ARIBCC_METRIC_COUNTER_DECODE_LIMITS_EXCEEDED = 9
+} aribcc_metric_counter_t;
+
+/**
+ * Histograms collected by context, see @aribcc_context_set_metrics_enabled()
+ */
+typedef enum aribcc_metric_histogram_t {
+    ARIBCC_METRIC_HISTOGRAM_DECODE_TIME = 0,        ///< in microseconds
+    ARIBCC_METRIC_HISTOGRAM_CHARS_PER_CAPTION = 1,
+    ARIBCC_METRIC_HISTOGRAM_REGION_RENDER_TIME = 2  ///< in microseconds
+} aribcc_metric_histogram_t;
+
+#define ARIBCC_METRIC_HISTOGRAM_BUCKETS 24
+
+/**
+ * Snapshot of a histogram
+ *
+ * Bucket 0 counts value 0, bucket i (i > 0) counts values in [2^(i-1), 2^i - 1].
+ * The last bucket also counts all of the larger values.
+ */
+typedef struct aribcc_metric_histogram_snapshot_t {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[ARIBCC_METRIC_HISTOGRAM_BUCKETS];
+} aribcc_metric_histogram_snapshot_t;
+
+/**
+ * Enable or disable collecting metrics of decoders and renderers constructed from this context
+ *
+ * Collecting costs nearly nothing if disabled, which is the default.
+ *
+ * @param context  aribcc_context_t*
+ * @param enabled  Enable or disable collecting
+ */
+ARIBCC_API void aribcc_context_set_metrics_enabled(aribcc_context_t* context, bool enabled);
+
+/**
+ * Get current value of a counter
+ *
+ * @param context  aribcc_context_t*
+ * @param counter  See @aribcc_metric_counter_t
+ * @return         0 if counter is invalid
+ */
+ARIBCC_API uint64_t aribcc_context_get_metric_counter(aribcc_context_t* context, aribcc_metric_counter_t counter);
+
+/**
+ * Take a snapshot of a histogram
+ *
+ * @param context      aribcc_context_t*
+ * @param histogram    See @aribcc_metric_histogram_t
+ * @param out_snapshot Write back parameter, see @aribcc_metric_histogram_snapshot_t
+ * @return             false if histogram is invalid
+ */
+ARIBCC_API bool aribcc_context_get_metric_histogram(aribcc_context_t* context,
+                                                    aribcc_metric_histogram_t histogram,
+                                                    aribcc_metric_histogram_snapshot_t* out_snapshot);
+
+/**
+ * Reset all of the collected metrics to zero
+ *
+ * @param context  aribcc_context_t*
+ */
+ARIBCC_API void aribcc_context_reset_metrics(aribcc_context_t* context);
+
+/**
+ * Trace event of a completed span
+ *
+ * See @aribcc_context_set_trace_callback()
+ */
+typedef struct aribcc_trace_event_t {
+    const char* name;      ///< Static string, e.g. "RendererImpl::Render"
+    const char* category;  ///< Static string, "decoder" or "renderer"
+    uint64_t timestamp;    ///< Start time of the span, in microseconds of a monotonic clock
+    uint64_t duration;     ///< Duration of the span, in microseconds
+    uint32_t thread_id;    ///< Sequential ID of the emitting thread, starts from 1
+} aribcc_trace_event_t;
+
+/**
+ * Trace callback function prototype, called on the emitting thread
+ *
+ * See @aribcc_context_set_trace_callback()
+ */
+typedef void(*aribcc_trace_callback_t)(const aribcc_trace_event_t* event, void* userdata);
+
+/**
+ * Indicate a callback function for receiving trace events of decoding and rendering.
+ * To clear the callback, pass NULL for the callback parameter.
+ *
+ * Trace events are only emitted if libaribcaption was built with ARIBCC_ENABLE_TRACING,
+ * see @aribcc_is_tracing_supported().
+ *
+ * @param context  aribcc_context_t*
+ * @param callback See @aribcc_trace_callback_t
+ * @param userdata User data that will be passed in callback
+ */
+ARIBCC_API void aribcc_context_set_trace_callback(aribcc_context_t* context,
+                                                  aribcc_trace_callback_t callback,
+                                                  void* userdata);
+
+/**
+ * Record trace events into a ring buffer, which keeps the latest max_events events
+ *
+ * Pass 0 to disable recording, which is the default. Recorded events are dropped on every call.
+ *
+ * @param context    aribcc_context_t*
+ * @param max_events Capacity of the ring buffer
+ */
+ARIBCC_API void aribcc_context_set_trace_buffer_size(aribcc_context_t* context, size_t max_events);
+
+/**
+ * Dump recorded trace events in Chrome trace event format (JSON object format)
+ *
+ * Output is truncated to fit into buffer, and always null-terminated if buffer_size is greater than 0.
+ *
+ * @param context     aribcc_context_t*
+ * @param buffer      Buffer for receiving the JSON text, may be NULL if buffer_size is 0
+ * @param buffer_size Size of buffer in bytes
+ * @return            Length of the whole JSON text, terminating null character excluded
+ */
+ARIBCC_API size_t aribcc_context_dump_trace_events(aribcc_context_t* context, char* buffer, size_t buffer_size);
+
+/**
+ * Check whether libaribcaption was built with trace events enabled
+ */
+ARIBCC_API bool aribcc_is_tracing_supported(void);
+
+/**
+ * Custom memory allocation callbacks, see @aribcc_context_set_allocator()
+ *
+ * Callbacks may be called from any thread concurrently, and must be valid until all of the memory has been freed,
+ * i.e. until the objects constructed from the context and the results they handed out have been freed.
+ */
+typedef struct aribcc_allocator_t {
+    void* (*alloc)(void* opaque, size_t size);                             ///< Required
+    void* (*aligned_alloc)(void* opaque, size_t size, size_t alignment);  ///< Optional, may be NULL
+    void (*free)(void* opaque, void* ptr);                                 ///< Required
+    void* opaque;                                                          ///< User pointer passed into callbacks
+} aribcc_allocator_t;
+
+/**
+ * Indicate callbacks for allocating pixel buffers and caption / render result storage
+ *
+ * Only affects decoders and renderers constructed after this call.
+ *
+ * @param context   aribcc_context_t*
+ * @param allocator See @aribcc_allocator_t, pass NULL to restore the default, which uses the system heap
+ * @return          false if only one of alloc and free is set, the allocator is kept unchanged in that case
+ */
+ARIBCC_API bool aribcc_context_set_allocator(aribcc_context_t* context, const aribcc_allocator_t* allocator);
+
+/**
+ * Levels of releasing memory, each level includes the lower levels
+ *
+ * See @aribcc_context_trim_memory() and @aribcc_renderer_trim_memory()
+ */
+typedef enum aribcc_memory_trim_level_t {
+    /**
+     * Free buffers of the bitmap pool, the region image cache and prerendered images
+     */
+    ARIBCC_MEMORY_TRIM_LEVEL_BACKGROUND = 0,
+
+    /**
+     * Additionally the glyph caches and scaled DRCS patterns
+     */
+    ARIBCC_MEMORY_TRIM_LEVEL_MODERATE = 1,
+
+    /**
+     * Additionally images kept for the next rendering and the loaded font faces
+     */
+    ARIBCC_MEMORY_TRIM_LEVEL_COMPLETE = 2
+} aribcc_memory_trim_level_t;
+
+/**
+ * Release memory held by the renderers constructed from this context, e.g. on platform memory pressure
+ *
+ * May be called from any thread. Free buffers of the bitmap pools are released immediately,
+ * while the rest is released by each renderer on its next rendering.
+ *
+ * @param context  aribcc_context_t*
+ * @param level    See @aribcc_memory_trim_level_t
+ */
+ARIBCC_API void aribcc_context_trim_memory(aribcc_context_t* context, aribcc_memory_trim_level_t level);
+
 
 #ifdef __cplusplus
 }  // extern "C"
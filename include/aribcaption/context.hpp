@@ -19,8 +19,11 @@
 #ifndef ARIBCAPTION_CONTEXT_HPP
 #define ARIBCAPTION_CONTEXT_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <functional>
+#include <string>
 #include "aribcc_export.h"
 
 namespace aribcaption {
@@ -38,12 +41,158 @@ enum class LogLevel {
  */
 using LogcatCB = std::function<void(LogLevel level, const char* message)>;
 
+/**
+ * Counters collected by @Context, see @Context::SetMetricsEnabled()
+ */
+enum class MetricCounter {
+    kDecodedPackets = 0,    ///< PES packets passed into decoders
+    kDecodeErrors,          ///< PES packets failed to be decoded
+    kDecodedCaptions,       ///< Captions obtained from decoders
+    kRenderedRegions,       ///< Caption regions rendered, region images taken from the cache excluded
+    kImagesProduced,        ///< Images produced by renderers, prerendered images included
+    kGlyphCacheHits,        ///< Glyph lookups served by the glyph cache
+    kGlyphCacheMisses,      ///< Glyph lookups which needed rasterizing
+    kFontLookups,           ///< Font faces queried from font providers
+    kBitmapBytesAllocated,  ///< Bytes of pixel buffers newly allocated, rather than recycled by the bitmap pool
+    kDecodeLimitsExceeded,  ///< PES packets dropped by decoders for exceeding DecodeLimits
+    kCount                  ///< Number of counters
+};
+
+/**
+ * Histograms collected by @Context, see @Context::SetMetricsEnabled()
+ */
+enum class MetricHistogram {
+    kDecodeTime = 0,    ///< Time for decoding a PES packet, in microseconds
+    kCharsPerCaption,   ///< Characters of a decoded caption
+    kRegionRenderTime,  ///< Time for rendering a caption region, in microseconds
+    kCount              ///< Number of histograms
+};
+
+constexpr size_t kMetricHistogramBuckets = 24;
+
+/**
+ * Snapshot of a histogram
+ *
+ * Bucket 0 counts value 0, bucket i (i > 0) counts values in [2^(i-1), 2^i - 1].
+ * The last bucket also counts all of the larger values.
+ */
+struct MetricHistogramSnapshot {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t min = 0;  ///< 0 if count is 0
+    uint64_t max = 0;
+    uint64_t buckets[kMetricHistogramBuckets] = {};
+};
+
+/**
+ * Snapshot of the metrics collected by @Context
+ *
+ * See @Context::GetMetrics()
+ */
+struct MetricsSnapshot {
+    uint64_t counters[static_cast<size_t>(MetricCounter::kCount)] = {};
+    MetricHistogramSnapshot histograms[static_cast<size_t>(MetricHistogram::kCount)];
+
+    [[nodiscard]]
+    uint64_t counter(MetricCounter counter) const {
+        return counters[static_cast<size_t>(counter)];
+    }
+
+    [[nodiscard]]
+    const MetricHistogramSnapshot& histogram(MetricHistogram histogram) const {
+        return histograms[static_cast<size_t>(histogram)];
+    }
+};
+
+/**
+ * Trace event of a completed span
+ *
+ * See @Context::SetTraceCallback()
+ */
+struct TraceEvent {
+    const char* name = nullptr;      ///< Static string, e.g. "RendererImpl::Render"
+    const char* category = nullptr;  ///< Static string, "decoder" or "renderer"
+    uint64_t timestamp = 0;          ///< Start time of the span, in microseconds of a monotonic clock
+    uint64_t duration = 0;           ///< Duration of the span, in microseconds
+    uint32_t thread_id = 0;          ///< Sequential ID of the emitting thread, starts from 1
+};
+
+/**
+ * Trace callback function prototype, called on the emitting thread
+ *
+ * See @Context::SetTraceCallback()
+ */
+using TraceCB = std::function<void(const TraceEvent& event)>;
+
+/**
+ * Custom memory allocation callbacks, see @Context::SetAllocator()
+ *
+ * Callbacks may be called from any thread concurrently, and must be valid until all of the memory has been freed,
+ * i.e. until the objects constructed from the context and the results they handed out have been freed.
+ */
+struct AllocatorCallbacks {
+    /**
+     * Allocate size bytes, return nullptr on failure. Required.
+     */
+    void* (*alloc)(void* opaque, size_t size) = nullptr;
+
+    /**
+     * Allocate size bytes aligned to alignment (a power of two), return nullptr on failure.
+     * Optional, blocks are over-allocated by @alloc and aligned manually if null.
+     */
+    void* (*aligned_alloc)(void* opaque, size_t size, size_t alignment) = nullptr;
+
+    /**
+     * Free a block returned by @alloc or @aligned_alloc. Required.
+     */
+    void (*free)(void* opaque, void* ptr) = nullptr;
+
+    /**
+     * User pointer passed into the callbacks
+     */
+    void* opaque = nullptr;
+};
+
+/**
+ * Levels of releasing memory, see @Context::TrimMemory() and @Renderer::TrimMemory()
+ *
+ * Each level includes the releases of the lower levels. Everything released is rebuilt on demand.
+ */
+enum class MemoryTrimLevel {
+    /**
+     * Release memory that is cheap to rebuild: free buffers of the bitmap pool, the region image cache
+     * and prerendered images. Suits e.g. the application going to background.
+     */
+    kBackground = 0,
+
+    /**
+     * Additionally release the glyph caches and scaled DRCS patterns, which are rasterized again afterwards.
+     */
+    kModerate = 1,
+
+    /**
+     * Additionally release images kept for the next rendering and the loaded font faces, which are
+     * looked up again by the next rendering. Suits e.g. iOS memory warnings or Android TRIM_MEMORY_COMPLETE.
+     */
+    kComplete = 2,
+};
+
+class FontDataRegistry;
 class Logger;
+class MemoryAllocator;
+class MemoryTrimRegistry;
+class Metrics;
+class SharedRegistry;
+class Tracer;
 
 /**
  * Construct a context before using any other aribcc APIs.
  *
  * Context must be freed after all the objects constructed from the context have been freed.
+ *
+ * Thread safety: methods of Context may be called concurrently from multiple threads,
+ * and objects constructed from the same context may be used on different threads simultaneously.
+ * Construction, destruction and moving of the context itself must not race with any other use.
  */
 class Context {
 public:
@@ -59,13 +208,151 @@ public:
      * @param logcat_cb See @LogcatCB
      */
     ARIBCC_API void SetLogcatCallback(const LogcatCB& logcat_cb);
+
+    /**
+     * Indicate the most verbose level of messages to be passed into the logcat callback
+     *
+     * Messages above the level are dropped before being formatted. Default as kVerbose.
+     *
+     * @param level See @LogLevel
+     */
+    ARIBCC_API void SetLogLevel(LogLevel level);
+
+    /**
+     * Limit the rate of repeated warning & verbose messages
+     *
+     * Messages are limited per message kind, e.g. the same warning repeated for every character.
+     * Count of the suppressed messages is reported along with the next message that gets through.
+     * Error messages are never suppressed.
+     *
+     * @param max_messages_per_second Indicate 0 for unlimited, which is the default
+     */
+    ARIBCC_API void SetLogRateLimit(uint32_t max_messages_per_second);
+
+    /**
+     * Share loaded font faces and font data between renderers constructed from this context
+     *
+     * Useful if many renderers live in one process, e.g. one renderer per channel.
+     * Only affects renderers constructed after this call. Disabled by default.
+     * Currently only the FreeType text renderer supports sharing.
+     *
+     * @param share  Enable or disable sharing
+     */
+    ARIBCC_API void SetShareFontFaces(bool share);
+
+    /**
+     * Add a font file (TrueType / OpenType, collections included) loaded into memory
+     *
+     * Added fonts are served by the memory font provider (FontProviderType::kMemory), which is selected
+     * automatically if no system font provider is available, e.g. for WebAssembly builds running in browsers.
+     * Faces are matched by their family names or PostScript names, see @Renderer::SetDefaultFontFamily().
+     * Only affects renderers initialized after this call.
+     *
+     * @param data  Font file data, copied into the context
+     * @param size  Size of data in bytes
+     */
+    ARIBCC_API void AddFontData(const uint8_t* data, size_t size);
+
+    /**
+     * Enable or disable collecting metrics of decoders and renderers constructed from this context
+     *
+     * Metrics are accumulated across all of the objects of the context, and are kept while disabled.
+     * Collecting costs nearly nothing if disabled, which is the default.
+     *
+     * @param enabled  Enable or disable collecting
+     */
+    ARIBCC_API void SetMetricsEnabled(bool enabled);
+
+    /**
+     * Take a snapshot of the collected metrics
+     *
+     * @param out_metrics Write back parameter, see @MetricsSnapshot
+     */
+    ARIBCC_API void GetMetrics(MetricsSnapshot& out_metrics) const;
+
+    /**
+     * Reset all of the collected metrics to zero
+     */
+    ARIBCC_API void ResetMetrics();
+
+    /**
+     * Indicate a callback function for receiving trace events of decoding and rendering.
+     * To clear the callback, pass nullptr for trace_cb.
+     *
+     * Trace events are only emitted if libaribcaption was built with ARIBCC_ENABLE_TRACING,
+     * see @IsTracingSupported(). Otherwise the trace scopes are compiled out entirely.
+     *
+     * @param trace_cb See @TraceCB
+     */
+    ARIBCC_API void SetTraceCallback(const TraceCB& trace_cb);
+
+    /**
+     * Record trace events into a ring buffer, which keeps the latest max_events events
+     *
+     * Pass 0 to disable recording, which is the default. Recorded events are dropped on every call.
+     *
+     * @param max_events  Capacity of the ring buffer
+     */
+    ARIBCC_API void SetTraceBufferSize(size_t max_events);
+
+    /**
+     * Dump recorded trace events in Chrome trace event format (JSON object format)
+     *
+     * The output could be loaded by Perfetto UI or chrome://tracing.
+     *
+     * @param out_json Write back parameter for the JSON text
+     */
+    ARIBCC_API void DumpTraceEvents(std::string& out_json);
+
+    /**
+     * Check whether libaribcaption was built with trace events enabled
+     */
+    [[nodiscard]]
+    ARIBCC_API static bool IsTracingSupported();
+
+    /**
+     * Indicate callbacks for allocating pixel buffers and C API caption / render result storage
+     *
+     * Useful for placing the memory into a custom heap, e.g. an arena or huge pages.
+     * Only affects decoders and renderers constructed after this call. Containers of C++ structures
+     * (e.g. @Caption and @Image) keep using the standard allocator.
+     * Pass callbacks with both alloc and free set to null to restore the default, which uses the system heap.
+     *
+     * @param callbacks See @AllocatorCallbacks
+     * @return false if only one of alloc and free is set, the allocator is kept unchanged in that case
+     */
+    ARIBCC_API bool SetAllocator(const AllocatorCallbacks& callbacks);
+
+    /**
+     * Release memory held by the renderers constructed from this context, e.g. on platform memory pressure
+     *
+     * May be called from any thread, e.g. from Android onTrimMemory() or iOS memory warning handlers.
+     * Free buffers of the bitmap pools are released immediately, while the rest is released by each renderer
+     * on its next rendering, as a renderer must not be used from multiple threads concurrently.
+     * Call @Renderer::TrimMemory() on the rendering thread for releasing everything at once.
+     *
+     * @param level  See @MemoryTrimLevel
+     */
+    ARIBCC_API void TrimMemory(MemoryTrimLevel level);
 public:
     Context(const Context&) = delete;
     Context& operator=(const Context&) = delete;
 private:
     std::shared_ptr<Logger> logger_;
+    std::shared_ptr<MemoryAllocator> allocator_;
+    std::shared_ptr<MemoryTrimRegistry> memory_trim_registry_;
+    std::shared_ptr<Metrics> metrics_;
+    std::shared_ptr<SharedRegistry> shared_registry_;
+    std::shared_ptr<FontDataRegistry> font_data_registry_;
+    std::shared_ptr<Tracer> tracer_;
 private:
     friend std::shared_ptr<Logger> GetContextLogger(Context& context);
+    friend std::shared_ptr<MemoryAllocator> GetContextAllocator(Context& context);
+    friend std::shared_ptr<MemoryTrimRegistry> GetContextMemoryTrimRegistry(Context& context);
+    friend std::shared_ptr<Metrics> GetContextMetrics(Context& context);
+    friend std::shared_ptr<SharedRegistry> GetContextSharedRegistry(Context& context);
+    friend std::shared_ptr<FontDataRegistry> GetContextFontDataRegistry(Context& context);
+    friend std::shared_ptr<Tracer> GetContextTracer(Context& context);
 };
 
 }  // namespace aribcaption
@@ -94,9 +94,48 @@ typedef enum aribcc_encoding_scheme_t {
 typedef enum aribcc_decode_status_t {
     ARIBCC_DECODE_STATUS_ERROR = 0,
     ARIBCC_DECODE_STATUS_NO_CAPTION = 1,
-    ARIBCC_DECODE_STATUS_GOT_CAPTION = 2
+    ARIBCC_DECODE_STATUS_GOT_CAPTION = 2,
+    ARIBCC_DECODE_STATUS_GOT_DUPLICATE_CAPTION = 3  ///< see @aribcc_decoder_set_deduplicate_captions()
 } aribcc_decode_status_t;
 
+/**
+ * Structure describes a PES packet for batch decoding
+ *
+ * See @aribcc_decoder_decode_batch()
+ */
+typedef struct aribcc_decode_packet_t {
+    const uint8_t* data;    ///< pointer pointed to PES data, must be non-null
+    size_t length;          ///< PES data length
+    int64_t pts;            ///< PES packet PTS, in milliseconds
+} aribcc_decode_packet_t;
+
+/**
+ * Structure for holding captions decoded from a batch of PES packets
+ *
+ * All captions are stored inside one contiguous buffer.
+ * Call @aribcc_decode_batch_result_cleanup() for releasing them, do not cleanup captions one by one.
+ *
+ * See @aribcc_decoder_decode_batch()
+ */
+typedef struct aribcc_decode_batch_result_t {
+    aribcc_caption_t* captions;     ///< decoded captions in the order of packets, caption_count elements
+    uint32_t* packet_indices;       ///< index of the packet where each caption was decoded from, caption_count elements
+    uint32_t caption_count;
+    uint32_t error_count;           ///< count of packets failed to decode
+} aribcc_decode_batch_result_t;
+
+/**
+ * Hard limits bounding the work done for a single PES packet, 0 means unlimited
+ *
+ * See @aribcc_decoder_set_decode_limits()
+ */
+typedef struct aribcc_decode_limits_t {
+    size_t max_pes_bytes;            ///< bytes of PES data up to the end of the data group
+    size_t max_chars_per_caption;    ///< characters of a caption, ruby and text only characters included
+    size_t max_regions_per_caption;  ///< caption regions of a caption
+    size_t max_decode_steps;         ///< watchdog: control codes and runs of characters processed per packet
+} aribcc_decode_limits_t;
+
 /**
  * ARIB STD-B24 caption decoder
  *
@@ -108,6 +147,7 @@ typedef struct aribcc_decoder_t aribcc_decoder_t;
  * A context is needed for allocating the Decoder.
  *
  * The context shouldn't be freed before any other object constructed from the context has been freed.
+ * A decoder must not be used from multiple threads concurrently, but different decoders can be used on different threads.
  */
 ARIBCC_API aribcc_decoder_t* aribcc_decoder_alloc(aribcc_context_t* context);
 
@@ -168,6 +208,81 @@ ARIBCC_API void aribcc_decoder_switch_language(aribcc_decoder_t* decoder, aribcc
  */
 ARIBCC_API void aribcc_decoder_set_replace_msz_fullwidth_ascii(aribcc_decoder_t* decoder, bool replace);
 
+/**
+ * Set whether to decode captions into text only
+ *
+ * If enabled, decoded captions only carry text (ruby text excluded), flags, PTS and duration.
+ * Regions and DRCS map are left empty.
+ *
+ * @param decoder    @aribcc_decoder_t
+ * @param text_only  bool
+ */
+ARIBCC_API void aribcc_decoder_set_text_only(aribcc_decoder_t* decoder, bool text_only);
+
+/**
+ * Set whether to fill caption text while decoding, enabled by default
+ *
+ * Ignored in text only mode.
+ *
+ * @param decoder   @aribcc_decoder_t
+ * @param generate  bool
+ */
+ARIBCC_API void aribcc_decoder_set_generate_caption_text(aribcc_decoder_t* decoder, bool generate);
+
+/**
+ * Set whether to fill UTF-8 string of each caption character while decoding, enabled by default
+ *
+ * @param decoder   @aribcc_decoder_t
+ * @param generate  bool
+ */
+ARIBCC_API void aribcc_decoder_set_generate_char_utf8(aribcc_decoder_t* decoder, bool generate);
+
+/**
+ * Set whether to decode captions of all languages in one pass
+ *
+ * If enabled, caption statements of every language are decoded rather than only the indicated one,
+ * and captions are tagged by iso6392_language_code.
+ *
+ * @param decoder  @aribcc_decoder_t
+ * @param enable   default as false
+ */
+ARIBCC_API void aribcc_decoder_set_decode_all_languages(aribcc_decoder_t* decoder, bool enable);
+
+/**
+ * Set hard limits for decoding a single PES packet
+ *
+ * Packets exceeding the limits are reported as ARIBCC_DECODE_STATUS_ERROR
+ * and counted by ARIBCC_METRIC_COUNTER_DECODE_LIMITS_EXCEEDED.
+ *
+ * @param decoder  @aribcc_decoder_t
+ * @param limits   @aribcc_decode_limits_t, unlimited by default
+ */
+ARIBCC_API void aribcc_decoder_set_decode_limits(aribcc_decoder_t* decoder, const aribcc_decode_limits_t* limits);
+
+/**
+ * Set whether to suppress retransmitted captions
+ *
+ * If enabled, a caption identical to the previously returned one is reported as
+ * ARIBCC_DECODE_STATUS_GOT_DUPLICATE_CAPTION. @aribcc_decoder_decode() and @aribcc_decoder_feed() then only write
+ * pts and wait_duration into out_caption: PTS of the caption returned before, and its duration extended to cover
+ * the duplicate, see @aribcc_renderer_extend_caption(). No caption handle is returned for duplicates.
+ *
+ * @param decoder  @aribcc_decoder_t
+ * @param enable   default as false
+ */
+ARIBCC_API void aribcc_decoder_set_deduplicate_captions(aribcc_decoder_t* decoder, bool enable);
+
+/**
+ * Capture PES packets passed into the decoder into a file, for replaying them offline (see aribcc_replay)
+ *
+ * Each packet is recorded along with its PTS, caption type, profile, encoding scheme and language before being decoded.
+ *
+ * @param decoder   @aribcc_decoder_t
+ * @param filename  Path of the capture file in UTF-8, overwritten if existing. Pass NULL or "" to stop capturing
+ * @return false if the file couldn't be created
+ */
+ARIBCC_API bool aribcc_decoder_set_capture_file(aribcc_decoder_t* decoder, const char* filename);
+
 /**
  * Query ISO639-2 Language Code for specific language id
  * @param decoder      @aribcc_decoder_t
@@ -196,7 +311,103 @@ ARIBCC_API aribcc_decode_status_t aribcc_decoder_decode(aribcc_decoder_t* decode
                                                         aribcc_caption_t* out_caption);
 
 /**
- * Reset decoder internal states
+ * Decode caption PES data into an opaque caption handle
+ *
+ * Identical to @aribcc_decoder_decode(), except that the decoded caption is handed out as-is
+ * instead of being converted into @aribcc_caption_t.
+ *
+ * @param decoder     @aribcc_decoder_t
+ * @param pes_data    pointer pointed to PES data, must be non-null
+ * @param length      PES data length, must be greater than 0
+ * @param pts         PES packet PTS, in milliseconds
+ * @param out_caption Parameter for writing back the caption handle, must be non-null.
+ *                    Written as NULL unless ARIBCC_DECODE_STATUS_GOT_CAPTION is returned.
+ *                    Release it by @aribcc_caption_handle_free(), or pass it to
+ *                    @aribcc_renderer_append_caption_handle().
+ * @return            ARIBCC_DECODE_STATUS_ERROR on failure,
+ *                    ARIBCC_DECODE_STATUS_NO_CAPTION if nothing obtained,
+ *                    ARIBCC_DECODE_STATUS_GOT_CAPTION if got a caption
+ */
+ARIBCC_API aribcc_decode_status_t aribcc_decoder_decode_handle(aribcc_decoder_t* decoder,
+                                                               const uint8_t* pes_data,
+                                                               size_t length,
+                                                               int64_t pts,
+                                                               aribcc_caption_handle_t** out_caption);
+
+/**
+ * Decode an array of caption PES packets in one call
+ *
+ * Packets are decoded in order, as if @aribcc_decoder_decode() was called on each of them.
+ * Failed packets are skipped and counted.
+ *
+ * @param decoder       @aribcc_decoder_t
+ * @param packets       array of @aribcc_decode_packet_t
+ * @param packet_count  element count of packets
+ * @param out_result    Parameter for writing back decoded captions, must be non-null.
+ *                      Call @aribcc_decode_batch_result_cleanup() after use.
+ * @return              ARIBCC_DECODE_STATUS_ERROR if got nothing but failures,
+ *                      ARIBCC_DECODE_STATUS_NO_CAPTION if nothing obtained,
+ *                      ARIBCC_DECODE_STATUS_GOT_CAPTION if got any caption
+ */
+ARIBCC_API aribcc_decode_status_t aribcc_decoder_decode_batch(aribcc_decoder_t* decoder,
+                                                              const aribcc_decode_packet_t* packets,
+                                                              size_t packet_count,
+                                                              aribcc_decode_batch_result_t* out_result);
+
+/**
+ * Decode an array of caption PES packets of a recorded stream on multiple threads
+ *
+ * Packets are split where a new caption management data is applied, and decoded simultaneously by independent
+ * decoders. Results are identical to @aribcc_decoder_decode_batch() unless a statement relies on states
+ * defined before a split point. See @Decoder::DecodeArchive() for details.
+ *
+ * @param decoder       @aribcc_decoder_t
+ * @param packets       array of @aribcc_decode_packet_t
+ * @param packet_count  element count of packets
+ * @param thread_count  count of threads including the calling thread, 0 for the count of hardware threads
+ * @param out_result    Parameter for writing back decoded captions, must be non-null.
+ *                      Call @aribcc_decode_batch_result_cleanup() after use.
+ * @return              Same as @aribcc_decoder_decode_batch()
+ */
+ARIBCC_API aribcc_decode_status_t aribcc_decoder_decode_archive(aribcc_decoder_t* decoder,
+                                                                const aribcc_decode_packet_t* packets,
+                                                                size_t packet_count,
+                                                                size_t thread_count,
+                                                                aribcc_decode_batch_result_t* out_result);
+
+/**
+ * Release all captions held by the @aribcc_decode_batch_result_t structure
+ *
+ * @param result  @aribcc_decode_batch_result_t
+ */
+ARIBCC_API void aribcc_decode_batch_result_cleanup(aribcc_decode_batch_result_t* result);
+
+/**
+ * Feed caption PES data fragment by fragment, e.g. TS packet payloads as they arrive
+ *
+ * Fragments are appended until the data group of the PES packet is complete, which is then decoded
+ * as if @aribcc_decoder_decode() was called on the whole PES data. A fragment must not span two PES packets.
+ *
+ * @param decoder      @aribcc_decoder_t
+ * @param data         pointer pointed to the fragment, the first one starts with data_identifier
+ *                     (i.e. the PES packet header has been stripped)
+ * @param length       fragment length
+ * @param pts          PES packet PTS, in milliseconds, only taken from the first fragment
+ * @param packet_start true for the first fragment of a PES packet, incomplete data of the previous packet is dropped
+ * @param out_caption  Parameter for writing back decoded caption, must be non-null
+ * @return             ARIBCC_DECODE_STATUS_ERROR on failure,
+ *                     ARIBCC_DECODE_STATUS_NO_CAPTION if nothing obtained or the PES packet hasn't been completed,
+ *                     ARIBCC_DECODE_STATUS_GOT_CAPTION if got a caption
+ */
+ARIBCC_API aribcc_decode_status_t aribcc_decoder_feed(aribcc_decoder_t* decoder,
+                                                      const uint8_t* data,
+                                                      size_t length,
+                                                      int64_t pts,
+                                                      bool packet_start,
+                                                      aribcc_caption_t* out_caption);
+
+/**
+ * Reset decoder internal states, and drop incomplete PES data passed into @aribcc_decoder_feed()
  *
  * @param decoder  @aribcc_decoder_t
  */
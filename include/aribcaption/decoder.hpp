@@ -19,8 +19,11 @@
 #ifndef ARIBCAPTION_B24_DECODER_HPP
 #define ARIBCAPTION_B24_DECODER_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 #include "aribcc_export.h"
 #include "caption.hpp"
 #include "context.hpp"
@@ -91,7 +94,8 @@ enum class EncodingScheme {
 enum class DecodeStatus {
     kError = 0,
     kNoCaption = 1,
-    kGotCaption = 2
+    kGotCaption = 2,
+    kGotDuplicateCaption = 3,  ///< Identical to the previous caption, see @Decoder::SetDeduplicateCaptions()
 };
 
 /**
@@ -99,10 +103,57 @@ enum class DecodeStatus {
  */
 struct DecodeResult {
     std::unique_ptr<Caption> caption;
+
+    /**
+     * Valid only if DecodeStatus::kGotDuplicateCaption is returned, caption is left empty in that case.
+     *
+     * PTS of the identical caption returned before, and its duration extended to cover the duplicate,
+     * which could be applied by @Renderer::ExtendCaption(). DURATION_INDEFINITE if undetermined.
+     */
+    int64_t duplicate_pts = PTS_NOPTS;
+    int64_t duplicate_duration = 0;
+};
+
+/**
+ * Structure describes a PES packet for batch decoding
+ *
+ * See @Decoder::DecodeBatch()
+ */
+struct DecodePacket {
+    const uint8_t* data = nullptr;  ///< pointer pointed to PES data, must be non-null
+    size_t length = 0;              ///< PES data length
+    int64_t pts = 0;                ///< PES packet PTS, in milliseconds
+};
+
+/**
+ * Structure for holding captions decoded from a batch of PES packets
+ *
+ * See @Decoder::DecodeBatch()
+ */
+struct DecodeBatchResult {
+    std::vector<Caption> captions;       ///< decoded captions, in the order of packets
+    std::vector<size_t> packet_indices;  ///< index of the packet where each caption was decoded from
+    size_t error_count = 0;              ///< count of packets failed to decode
+};
+
+/**
+ * Hard limits bounding the work done for a single PES packet, see @Decoder::SetDecodeLimits()
+ *
+ * Packets exceeding any of the limits are dropped and reported as DecodeStatus::kError, so that
+ * corrupt or hostile streams couldn't stall decoding. A limit of 0 means unlimited.
+ */
+struct DecodeLimits {
+    size_t max_pes_bytes = 0;            ///< bytes of PES data up to the end of the data group
+    size_t max_chars_per_caption = 0;    ///< characters of a caption, ruby and text only characters included
+    size_t max_regions_per_caption = 0;  ///< caption regions of a caption
+    size_t max_decode_steps = 0;         ///< watchdog: control codes and runs of characters processed per packet
 };
 
 /**
  * ARIB STD-B24 caption decoder
+ *
+ * Thread safety: a Decoder must not be used from multiple threads concurrently.
+ * Different decoders, even constructed from the same @Context, can be used on different threads simultaneously.
  */
 class Decoder {
 public:
@@ -159,6 +210,96 @@ public:
      */
     ARIBCC_API void SetReplaceMSZFullWidthAlphanumeric(bool replace);
 
+    /**
+     * Set whether to recycle caption storage between @Decode() calls
+     *
+     * If enabled, the Caption held by the DecodeResult passed into Decode() is cleared and decoded into,
+     * keeping the capacity of its containers, instead of allocating a new Caption for every PES packet.
+     * Keep passing the same DecodeResult and leave its caption in place (copy rather than move out of it)
+     * so that steady-state decoding performs no heap allocations.
+     *
+     * @param reuse default as false
+     */
+    ARIBCC_API void SetReuseCaptionStorage(bool reuse);
+
+    /**
+     * Set whether to decode captions into text only
+     *
+     * If enabled, decoded captions only carry @Caption::text (ruby text excluded as usual), flags, PTS and duration.
+     * Caption::regions and Caption::drcs_map are left empty, so that the captions couldn't be rendered.
+     * Intended for transcript extraction, e.g. converting into SRT or indexing.
+     *
+     * @param text_only default as false
+     */
+    ARIBCC_API void SetTextOnly(bool text_only);
+
+    /**
+     * Set whether to fill @Caption::text while decoding
+     *
+     * Consumers which don't read the text (e.g. renderers) could disable it for saving the UTF-8 encoding and
+     * the appending. Call @Caption::UpdateText() for building it on demand later. Ignored in text only mode.
+     *
+     * @param generate default as true
+     */
+    ARIBCC_API void SetGenerateCaptionText(bool generate);
+
+    /**
+     * Set whether to fill @CaptionChar::u8str while decoding
+     *
+     * If disabled, CaptionChar::u8str is left as empty string, and could be built on demand by
+     * @CaptionChar::UpdateU8Str(). Renderers only read codepoints.
+     *
+     * @param generate default as true
+     */
+    ARIBCC_API void SetGenerateCharUTF8(bool generate);
+
+    /**
+     * Set whether to decode captions of all languages in one pass
+     *
+     * By default, caption statements of languages other than the one indicated by @Initialize() / @SwitchLanguage()
+     * are dropped. If enabled, statements of every language are decoded, each keeping its own writing state,
+     * and captions are tagged by @Caption::iso6392_language_code. Caption management data and DRCS patterns
+     * are parsed once and shared by all languages.
+     *
+     * State snapshots (see @SaveState()) only cover the language decoded last in this mode.
+     *
+     * @param enable default as false
+     */
+    ARIBCC_API void SetDecodeAllLanguages(bool enable);
+
+    /**
+     * Set hard limits for decoding a single PES packet
+     *
+     * Packets exceeding the limits are reported as DecodeStatus::kError and counted by
+     * MetricCounter::kDecodeLimitsExceeded, the caption decoded so far is dropped.
+     * Well-formed captions keep far below sensible limits, e.g. ARIB TR-B14 allows a few hundred characters.
+     *
+     * @param limits see @DecodeLimits, unlimited by default
+     */
+    ARIBCC_API void SetDecodeLimits(const DecodeLimits& limits);
+
+    /**
+     * Set whether to suppress retransmitted captions
+     *
+     * Broadcasters resend caption statements periodically. If enabled, a caption identical to the previously
+     * returned one (see @Caption::fingerprint) is not returned again, DecodeStatus::kGotDuplicateCaption is
+     * returned instead, with DecodeResult::duplicate_pts / duplicate_duration describing the extended caption.
+     *
+     * @param enable default as false
+     */
+    ARIBCC_API void SetDeduplicateCaptions(bool enable);
+
+    /**
+     * Capture PES packets passed into this decoder into a file, for replaying them offline (see aribcc_replay)
+     *
+     * Each packet is recorded along with its PTS, caption type, profile, encoding scheme and language
+     * before being decoded, including packets completed by @Feed() and passed into @DecodeBatch() / @DecodeArchive().
+     *
+     * @param filename  Path of the capture file in UTF-8, overwritten if existing. Indicate empty string to stop
+     * @return false if the file couldn't be created
+     */
+    ARIBCC_API bool SetCaptureFile(const std::string& filename);
+
     /**
      * Query ISO639-2 Language Code for specific language id
      * @param language_id See @LanguageId
@@ -173,15 +314,92 @@ public:
      * @param pes_data   pointer pointed to PES data, must be non-null
      * @param length     PES data length, must be greater than 0
      * @param pts        PES packet PTS, in milliseconds
-     * @param out_result Write back parameter for passing decoded caption, only valid if DecodeStatus is kGotCaption
+     * @param out_result Write back parameter for passing decoded caption, only valid if DecodeStatus is kGotCaption.
+     *                   Its previous caption will be recycled if @SetReuseCaptionStorage() is enabled.
      * @return           kError on failure, kNoCaption if nothing obtained, kGotCaption if got a caption
      */
     ARIBCC_API DecodeStatus Decode(const uint8_t* pes_data, size_t length, int64_t pts, DecodeResult& out_result);
 
     /**
-     * Reset decoder internal states
+     * Decode an array of caption PES packets in one call
+     *
+     * Packets are decoded in order, as if Decode() was called on each of them. Failed packets are skipped and counted.
+     * Pass the same DecodeBatchResult again for a subsequent batch, so that its captions' storage gets recycled.
+     *
+     * @param packets    array of @DecodePacket
+     * @param count      element count of packets
+     * @param out_result Write back parameter for passing decoded captions
+     * @return           kGotCaption if got any caption, kError if got nothing but failures, otherwise kNoCaption
+     */
+    ARIBCC_API DecodeStatus DecodeBatch(const DecodePacket* packets, size_t count, DecodeBatchResult& out_result);
+
+    /**
+     * Decode an array of caption PES packets of a recorded stream on multiple threads
+     *
+     * Packets are split into chunks where a new caption management data is applied, at which writing states
+     * get reset. Chunks are decoded simultaneously by independent decoders, the first one continuing from current
+     * states, and results are merged in the order of packets. Afterwards the decoder continues from the states
+     * left by the last chunk, as if DecodeBatch() was called.
+     *
+     * Results are identical to @DecodeBatch() unless a statement relies on states defined before a split point,
+     * e.g. a DRCS pattern transmitted before the caption management data.
+     *
+     * @param packets      array of @DecodePacket, usually all caption packets of a file
+     * @param count        element count of packets
+     * @param out_result   Write back parameter for passing decoded captions
+     * @param thread_count Count of threads taking part in decoding, including the calling thread.
+     *                     0 for the count of hardware threads, 1 for decoding serially as @DecodeBatch()
+     * @return             Same as @DecodeBatch()
+     */
+    ARIBCC_API DecodeStatus DecodeArchive(const DecodePacket* packets, size_t count, DecodeBatchResult& out_result,
+                                          size_t thread_count = 0);
+
+    /**
+     * Feed caption PES data fragment by fragment, e.g. TS packet payloads as they arrive
+     *
+     * Fragments are appended until the data group of the PES packet is complete, which is then decoded
+     * as if Decode() was called on the whole PES data. A fragment must not span two PES packets,
+     * bytes following the end of the data group are ignored. If the first fragment already holds
+     * the whole data group, it is decoded in place without being copied.
+     *
+     * @param data         pointer pointed to the fragment, the first one starts with data_identifier
+     *                     (i.e. the PES packet header has been stripped)
+     * @param length       fragment length
+     * @param pts          PES packet PTS, in milliseconds, only taken from the first fragment
+     * @param packet_start true for the first fragment of a PES packet (payload_unit_start_indicator),
+     *                     incomplete data of the previous packet is dropped
+     * @param out_result   Write back parameter for passing decoded caption, only valid if DecodeStatus is kGotCaption
+     * @return             kNoCaption if the PES packet hasn't been completed yet, otherwise same as Decode()
+     */
+    ARIBCC_API DecodeStatus Feed(const uint8_t* data, size_t length, int64_t pts, bool packet_start,
+                                 DecodeResult& out_result);
+
+    /**
+     * Reset decoder internal states, and drop incomplete PES data passed into @Feed()
      */
     ARIBCC_API void Flush();
+
+    /**
+     * Save decoder internal states into a snapshot
+     *
+     * The snapshot holds states carried between PES packets, e.g. caption management data, designated graphic sets,
+     * writing format, character styles and DRCS patterns. Restoring it by @RestoreState() allows decoding to be
+     * resumed from the next PES packet after a seek, without replaying the packets before.
+     *
+     * @param out_state Write back parameter for the serialized snapshot
+     */
+    ARIBCC_API void SaveState(std::vector<uint8_t>& out_state) const;
+
+    /**
+     * Restore decoder internal states from a snapshot saved by @SaveState()
+     *
+     * The decoder must have been initialized with the same caption type, profile and language ID.
+     *
+     * @param data snapshot bytes
+     * @param size snapshot size in bytes
+     * @return     false if the snapshot is invalid or mismatched, decoder states are kept unchanged in that case
+     */
+    ARIBCC_API bool RestoreState(const uint8_t* data, size_t size);
 public:
     Decoder(const Decoder&) = delete;
     Decoder& operator=(const Decoder&) = delete;
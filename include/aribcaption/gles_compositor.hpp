@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ARIBCAPTION_GLES_COMPOSITOR_HPP
+#define ARIBCAPTION_GLES_COMPOSITOR_HPP
+
+#include <cstdint>
+#include <memory>
+#include "aribcc_export.h"
+#include "context.hpp"
+#include "renderer.hpp"
+
+namespace aribcaption {
+
+namespace internal { class GLESCompositorImpl; }
+
+/**
+ * OpenGL ES 3.0 compositor of glyph atlas rendering results, see @Renderer::RenderGlyphAtlas()
+ *
+ * Keeps the glyph atlas in a GPU texture, uploading only the dirty areas, and draws the glyph quads
+ * (backgrounds, enclosures and underlines included) with one instanced draw call into a framebuffer.
+ * Rasterizing new glyphs is the only work left on the CPU, which stops once the atlas is warmed up.
+ *
+ * Only available if libaribcaption was built with ARIBCC_USE_GLES.
+ *
+ * Thread safety: all methods must be called on a thread where the OpenGL ES context used by @Initialize() is current,
+ * destruction included.
+ */
+class GLESCompositor {
+public:
+    /**
+     * A context is needed for constructing the GLESCompositor.
+     *
+     * The context shouldn't be destructed before any other object constructed from the context has been destructed.
+     */
+    ARIBCC_API explicit GLESCompositor(Context& context);
+    ARIBCC_API ~GLESCompositor();
+    ARIBCC_API GLESCompositor(GLESCompositor&&) noexcept;
+    ARIBCC_API GLESCompositor& operator=(GLESCompositor&&) noexcept;
+public:
+    /**
+     * Create GPU resources, i.e. shaders, buffers and the atlas texture
+     *
+     * An OpenGL ES 3.0 (or later) context must be current.
+     *
+     * @return false if shaders couldn't be compiled
+     */
+    ARIBCC_API bool Initialize();
+
+    /**
+     * Release GPU resources, also called on destruction. Call it earlier if the OpenGL ES context is going away.
+     */
+    ARIBCC_API void Release();
+
+    /**
+     * Upload areas of the glyph atlas updated by the result, or the whole atlas if it has been reset
+     *
+     * Must be called for every result obtained from the renderer, kNoImage ones included,
+     * since dirty areas are only reported once.
+     */
+    ARIBCC_API void Upload(const GlyphAtlasRenderResult& result);
+
+    /**
+     * Alpha blend quads of the result over a framebuffer
+     *
+     * The framebuffer isn't cleared. To draw into a texture, attach it to a framebuffer object.
+     * Colors are written in premultiplied alpha, which equals to straight alpha over an opaque framebuffer.
+     * Changes the bound framebuffer, viewport, blending, program, vertex array and texture of unit 0.
+     *
+     * @param result       Result whose atlas has been uploaded by @Upload()
+     * @param framebuffer  Name of the framebuffer object, 0 for the default framebuffer
+     * @param frame_width  Frame width indicated to the renderer, i.e. the viewport width
+     * @param frame_height Frame height indicated to the renderer, i.e. the viewport height
+     */
+    ARIBCC_API void Draw(const GlyphAtlasRenderResult& result, uint32_t framebuffer, int frame_width, int frame_height);
+
+    /**
+     * Render caption at specific PTS by @Renderer::RenderGlyphAtlas(), then Upload() and Draw() the result
+     *
+     * @return Status returned by @Renderer::RenderGlyphAtlas(), nothing is drawn if it's kError or kNoImage
+     */
+    ARIBCC_API RenderStatus Render(Renderer& renderer,
+                                   int64_t pts,
+                                   uint32_t framebuffer,
+                                   int frame_width,
+                                   int frame_height);
+public:
+    GLESCompositor(const GLESCompositor&) = delete;
+    GLESCompositor& operator=(const GLESCompositor&) = delete;
+private:
+    std::unique_ptr<internal::GLESCompositorImpl> pimpl_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_GLES_COMPOSITOR_HPP
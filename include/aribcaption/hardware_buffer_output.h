@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ARIBCAPTION_HARDWARE_BUFFER_OUTPUT_H
+#define ARIBCAPTION_HARDWARE_BUFFER_OUTPUT_H
+
+#include <android/hardware_buffer.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "aribcc_config.h"
+#include "aribcc_export.h"
+#include "context.h"
+#include "image.h"
+#include "renderer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Structure represents a rendered caption image held by an AHardwareBuffer
+ *
+ * See HardwareBufferImage in hardware_buffer_output.hpp for details
+ */
+typedef struct aribcc_hardware_buffer_image_t {
+    /**
+     * AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM buffer, referenced until @aribcc_hardware_buffer_render_result_cleanup().
+     * Call AHardwareBuffer_acquire() for holding it longer. The top-left width x height area holds the caption.
+     */
+    AHardwareBuffer* hardware_buffer;
+
+    int width;             ///< image width, inside the hardware buffer
+    int height;            ///< image height, inside the hardware buffer
+    int dst_x;             ///< x coordinate of image's top-left corner inside the player's renderer frame
+    int dst_y;             ///< y coordinate of image's top-left corner inside the player's renderer frame
+    int display_width;     ///< see aribcc_image_t::display_width
+    int display_height;    ///< see aribcc_image_t::display_height
+
+    aribcc_pixelformat_t pixel_format;  ///< RGBA8888 or RGBA8888_PREMULTIPLIED
+
+    void* priv;            ///< reference held to the pooled buffer, for internal use only
+} aribcc_hardware_buffer_image_t;
+
+/**
+ * Structure for holding rendered images in hardware buffers
+ *
+ * See @aribcc_hardware_buffer_output_render()
+ */
+typedef struct aribcc_hardware_buffer_render_result_t {
+    int64_t pts;             ///< PTS of rendered caption
+    int64_t duration;        ///< duration of rendered caption, may be ARIBCC_DURATION_INDEFINITE
+
+    /**
+     * Rendered images array, may be NULL if error occurred or ARIBCC_RENDER_STATUS_NO_IMAGE returned.
+     * Call @aribcc_hardware_buffer_render_result_cleanup() for releasing.
+     */
+    aribcc_hardware_buffer_image_t* images;
+    uint32_t image_count;    ///< element count of images array
+} aribcc_hardware_buffer_render_result_t;
+
+/**
+ * Release images and the array held by the render result, returning buffers into the pool
+ *
+ * @param render_result  aribcc_hardware_buffer_render_result_t*
+ */
+ARIBCC_API void aribcc_hardware_buffer_render_result_cleanup(aribcc_hardware_buffer_render_result_t* render_result);
+
+/**
+ * Opaque type for the hardware buffer output
+ *
+ * Renderer output into pooled AHardwareBuffers, see HardwareBufferOutput in hardware_buffer_output.hpp.
+ * Only available on Android API level 26+ if libaribcaption was built with ARIBCC_USE_AHARDWAREBUFFER.
+ */
+typedef struct aribcc_hardware_buffer_output_t aribcc_hardware_buffer_output_t;
+
+/**
+ * Allocate a hardware buffer output
+ *
+ * The context shouldn't be freed before any other object constructed from the context has been freed.
+ *
+ * @param context aribcc_context_t*
+ * @return        aribcc_hardware_buffer_output_t*, or NULL if allocation failed
+ */
+ARIBCC_API aribcc_hardware_buffer_output_t* aribcc_hardware_buffer_output_alloc(aribcc_context_t* context);
+
+/**
+ * Free the hardware buffer output. Buffers still held by render results stay valid until cleaned up.
+ *
+ * @param output aribcc_hardware_buffer_output_t*
+ */
+ARIBCC_API void aribcc_hardware_buffer_output_free(aribcc_hardware_buffer_output_t* output);
+
+/**
+ * Render caption at specific PTS by @aribcc_renderer_render(), and write the images into pooled hardware buffers
+ *
+ * @param output      aribcc_hardware_buffer_output_t*
+ * @param renderer    Initialized aribcc_renderer_t*
+ * @param pts         Presentation timestamp, in milliseconds
+ * @param out_result  Write back parameter for passing rendered images, should be cleaned up by
+ *                    @aribcc_hardware_buffer_render_result_cleanup() after use.
+ *                    Left untouched if ARIBCC_RENDER_STATUS_NOT_READY is returned.
+ * @return            Status returned by the renderer, or ARIBCC_RENDER_STATUS_ERROR if buffers couldn't be written
+ */
+ARIBCC_API aribcc_render_status_t aribcc_hardware_buffer_output_render(aribcc_hardware_buffer_output_t* output,
+                                                                       aribcc_renderer_t* renderer,
+                                                                       int64_t pts,
+                                                                       aribcc_hardware_buffer_render_result_t* out_result);
+
+/**
+ * Release pooled buffers and references to the previous images
+ *
+ * @param output aribcc_hardware_buffer_output_t*
+ */
+ARIBCC_API void aribcc_hardware_buffer_output_flush(aribcc_hardware_buffer_output_t* output);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ARIBCAPTION_HARDWARE_BUFFER_OUTPUT_H
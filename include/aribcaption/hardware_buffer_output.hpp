@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ARIBCAPTION_HARDWARE_BUFFER_OUTPUT_HPP
+#define ARIBCAPTION_HARDWARE_BUFFER_OUTPUT_HPP
+
+#include <android/hardware_buffer.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "aribcc_export.h"
+#include "context.hpp"
+#include "image.hpp"
+#include "renderer.hpp"
+
+namespace aribcaption {
+
+namespace internal { class HardwareBufferOutputImpl; }
+
+/**
+ * Structure represents a rendered caption image held by an AHardwareBuffer
+ *
+ * Copies share the same buffer, which goes back to the pool of the @HardwareBufferOutput
+ * after the last copy has been destructed.
+ */
+struct HardwareBufferImage {
+    /**
+     * AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM buffer, with CPU_WRITE_OFTEN and GPU_SAMPLED_IMAGE usage.
+     *
+     * It may be larger than the image, only the top-left @width x @height area holds the caption,
+     * pixels outside of it are undefined. Must not be written to, since it may be handed out again
+     * by a following rendering if the image is unchanged.
+     *
+     * Keep the HardwareBufferImage alive until the GPU has finished sampling from the buffer,
+     * otherwise the buffer may be recycled and overwritten by a later rendering.
+     */
+    std::shared_ptr<AHardwareBuffer> hardware_buffer;
+
+    int width = 0;     ///< image width, inside the hardware buffer
+    int height = 0;    ///< image height, inside the hardware buffer
+
+    int dst_x = 0;     ///< x coordinate of image's top-left corner inside the player's renderer frame
+    int dst_y = 0;     ///< y coordinate of image's top-left corner inside the player's renderer frame
+
+    int display_width = 0;   ///< see @Image::display_width
+    int display_height = 0;  ///< see @Image::display_height
+
+    PixelFormat pixel_format = PixelFormat::kRGBA8888;  ///< kRGBA8888 or kRGBA8888Premultiplied
+};
+
+/**
+ * Structure for holding rendered images in hardware buffers, see @HardwareBufferOutput::Render()
+ */
+struct HardwareBufferRenderResult {
+    int64_t pts = 0;             ///< PTS of rendered caption
+    int64_t duration = 0;        ///< duration of rendered caption, may be DURATION_INDEFINITE
+    std::vector<HardwareBufferImage> images;
+};
+
+/**
+ * Renderer output into pooled AHardwareBuffers, for zero-copy GPU upload on Android
+ *
+ * Images are written into hardware buffers locked for CPU writing, which could then be bound as
+ * GL (eglGetNativeClientBufferANDROID) or Vulkan (VK_ANDROID_external_memory_android_hardware_buffer) external images,
+ * or wrapped into a Java Bitmap by AHardwareBuffer_toHardwareBuffer() and Bitmap.wrapHardwareBuffer() (API level 29+).
+ * Buffers are taken from a pool bucketed by size, and images unchanged since the previous rendering
+ * keep their buffers without being written again.
+ *
+ * Renderer's default PixelFormat::kRGBA8888 (or kRGBA8888Premultiplied) is written straight through,
+ * BGRA images are swizzled while writing. Indexed and run-length encoded images are not supported.
+ *
+ * Only available on Android API level 26+ if libaribcaption was built with ARIBCC_USE_AHARDWAREBUFFER.
+ *
+ * Thread safety: same as the @Renderer it renders from. Handed out buffers may be used and released on any thread.
+ */
+class HardwareBufferOutput {
+public:
+    /**
+     * A context is needed for constructing the HardwareBufferOutput.
+     *
+     * The context shouldn't be destructed before any other object constructed from the context has been destructed.
+     */
+    ARIBCC_API explicit HardwareBufferOutput(Context& context);
+    ARIBCC_API ~HardwareBufferOutput();
+    ARIBCC_API HardwareBufferOutput(HardwareBufferOutput&&) noexcept;
+    ARIBCC_API HardwareBufferOutput& operator=(HardwareBufferOutput&&) noexcept;
+public:
+    /**
+     * Render caption at specific PTS by @Renderer::Render(), and write the images into pooled hardware buffers
+     *
+     * @param renderer    Initialized renderer
+     * @param pts         Presentation timestamp, in milliseconds
+     * @param out_result  Write back parameter for passing rendered images, will be empty if status is kError / kNoImage.
+     *                    Left untouched if status is kNotReady.
+     * @return            Status returned by @Renderer::Render(), or kError if hardware buffers couldn't be written
+     */
+    ARIBCC_API RenderStatus Render(Renderer& renderer, int64_t pts, HardwareBufferRenderResult& out_result);
+
+    /**
+     * Release pooled buffers and references to the previous images, e.g. after frame size changed
+     *
+     * Buffers still referenced by the caller stay valid, and will be released instead of being pooled.
+     */
+    ARIBCC_API void Flush();
+public:
+    HardwareBufferOutput(const HardwareBufferOutput&) = delete;
+    HardwareBufferOutput& operator=(const HardwareBufferOutput&) = delete;
+private:
+    std::unique_ptr<internal::HardwareBufferOutputImpl> pimpl_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_HARDWARE_BUFFER_OUTPUT_HPP
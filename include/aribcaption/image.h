@@ -22,6 +22,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include "aribcc_export.h"
+#include "color.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,14 +31,31 @@ extern "C" {
 /**
  * enums for pixel format used by aribcc api.
  *
- * Only @ARIBCC_PIXELFORMAT_RGBA8888 is used for now.
+ * Pixels are stored in memory byte order, e.g. R, G, B, A for @ARIBCC_PIXELFORMAT_RGBA8888.
+ * Renderer produces @ARIBCC_PIXELFORMAT_RGBA8888 with straight alpha
+ * unless indicated by @aribcc_renderer_set_output_pixel_format().
  */
 typedef enum aribcc_pixelformat_t {
     ARIBCC_PIXELFORMAT_RGBA8888 = 0,
+    ARIBCC_PIXELFORMAT_RGBA8888_PREMULTIPLIED = 1,  ///< RGBA with color components premultiplied by alpha
+    ARIBCC_PIXELFORMAT_BGRA8888 = 2,
+    ARIBCC_PIXELFORMAT_BGRA8888_PREMULTIPLIED = 3,  ///< BGRA with color components premultiplied by alpha
+    ARIBCC_PIXELFORMAT_INDEXED8 = 4,                ///< 8-bit indices into the palette of @aribcc_image_t
     ARIBCC_PIXELFORMAT_DEFAULT = ARIBCC_PIXELFORMAT_RGBA8888
 } aribcc_pixelformat_t;
 
 
+/**
+ * Structure describes a horizontal run of pixels inside a run-length encoded image
+ */
+typedef struct aribcc_image_span_t {
+    int x;            ///< x coordinate of the first pixel, relative to the image
+    int y;            ///< line of the span, relative to the image
+    int length;       ///< pixel count of the span
+    uint32_t offset;  ///< byte offset of the first pixel inside the bitmap buffer
+} aribcc_image_span_t;
+
+
 /**
  * Structure represents a rendered caption image produced by the renderer
  */
@@ -49,7 +67,7 @@ typedef struct aribcc_image_t {
     int dst_x;     ///< x coordinate of bitmap's top-left corner inside the player's renderer frame
     int dst_y;     ///< y coordinate of bitmap's top-left corner inside the player's renderer frame
 
-    aribcc_pixelformat_t pixel_format;    ///< pixel format, always be @ARIBCC_PIXELFORMAT_RGBA8888
+    aribcc_pixelformat_t pixel_format;    ///< pixel format, see @aribcc_renderer_set_output_pixel_format()
 
     /**
      * Pointer pointed to the bitmap area. The buffer size is indicated in bitmap_size field.
@@ -59,6 +77,32 @@ typedef struct aribcc_image_t {
      */
     uint8_t* bitmap;
     uint32_t bitmap_size;
+
+    /**
+     * Colors indexed by the pixels of an @ARIBCC_PIXELFORMAT_INDEXED8 image, in straight alpha RGBA.
+     * NULL for other pixel formats. Entry 0 is always fully transparent.
+     *
+     * Released along with the bitmap by @aribcc_image_cleanup().
+     */
+    aribcc_color_t* palette;
+    uint32_t palette_size;
+
+    /**
+     * Spans of a run-length encoded image, sorted by line and x coordinate. NULL for dense images.
+     * See @aribcc_renderer_set_run_length_encoded_images().
+     *
+     * In that case stride is 0, and the bitmap holds pixels of the spans packed one after another.
+     * Released along with the bitmap by @aribcc_image_cleanup().
+     */
+    aribcc_image_span_t* spans;
+    uint32_t span_count;
+
+    /**
+     * Size of the rect starting at (dst_x, dst_y) that the bitmap should be scaled into, inside the frame.
+     * 0 if the bitmap is displayed at its own size. See @aribcc_renderer_set_max_render_magnification().
+     */
+    int display_width;
+    int display_height;
 } aribcc_image_t;
 
 
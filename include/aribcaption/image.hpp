@@ -19,28 +19,47 @@
 #ifndef ARIBCAPTION_IMAGE_HPP
 #define ARIBCAPTION_IMAGE_HPP
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <vector>
 #include "aligned_alloc.hpp"
+#include "color.hpp"
 
 namespace aribcaption {
 
 /**
  * enums for pixel format used by aribcc api.
  *
- * Only @kRGBA8888 is used for now.
+ * Pixels are stored in memory byte order, e.g. R, G, B, A for @kRGBA8888.
+ * Renderer produces @kRGBA8888 with straight alpha unless indicated by @Renderer::SetOutputPixelFormat().
  */
 enum class PixelFormat {
     kRGBA8888 = 0,
+    kRGBA8888Premultiplied = 1,   ///< RGBA with color components premultiplied by alpha
+    kBGRA8888 = 2,
+    kBGRA8888Premultiplied = 3,   ///< BGRA with color components premultiplied by alpha
+    kIndexed8 = 4,                ///< 8-bit indices into @Image::palette
     kDefault = kRGBA8888,
 };
 
+/**
+ * Structure describes a horizontal run of pixels inside a run-length encoded image, see @Image::spans
+ */
+struct ImageSpan {
+    int x = 0;            ///< x coordinate of the first pixel, relative to the image
+    int y = 0;            ///< line of the span, relative to the image
+    int length = 0;       ///< pixel count of the span
+    uint32_t offset = 0;  ///< byte offset of the first pixel inside the bitmap buffer
+};
+
 /**
  * Structure represents a rendered caption image produced by the renderer
  */
 struct Image {
 public:
     static constexpr size_t kAlignedTo = 32;
+    using Buffer = std::vector<uint8_t, AlignedAllocator<uint8_t, kAlignedTo>>;
 public:
     int width = 0;     ///< bitmap width
     int height = 0;    ///< bitmap height
@@ -49,15 +68,62 @@ public:
     int dst_x = 0;     ///< x coordinate of bitmap's top-left corner inside the player's renderer frame
     int dst_y = 0;     ///< y coordinate of bitmap's top-left corner inside the player's renderer frame
 
-    PixelFormat pixel_format = PixelFormat::kDefault;    ///< pixel format, always be kRGBA8888
+    /**
+     * Size of the rect starting at (dst_x, dst_y) that the bitmap should be scaled into, inside the frame.
+     * 0 if the bitmap is displayed at its own size, see @Renderer::SetMaxRenderMagnification().
+     */
+    int display_width = 0;
+    int display_height = 0;
+
+    PixelFormat pixel_format = PixelFormat::kDefault;    ///< pixel format, see @Renderer::SetOutputPixelFormat()
 
     std::vector<uint8_t, AlignedAllocator<uint8_t, kAlignedTo>> bitmap;
+
+    /**
+     * Shared, immutable, reference-counted bitmap buffer.
+     *
+     * Only presents if shared image buffers are enabled, see @Renderer::SetShareImageBuffers().
+     * In that case @bitmap will be empty, and copying the Image won't copy the pixels.
+     */
+    std::shared_ptr<const Buffer> shared_bitmap;
+
+    /**
+     * Colors indexed by the pixels of a @PixelFormat::kIndexed8 image, in straight alpha RGBA. Empty otherwise.
+     *
+     * Holds at most 256 entries, entry 0 is always fully transparent.
+     */
+    std::vector<ColorRGBA> palette;
+
+    /**
+     * Spans of a run-length encoded image, sorted by line and x coordinate. Empty for dense images.
+     *
+     * Only presents if run-length encoded images are enabled, see @Renderer::SetRunLengthEncodedImages().
+     * In that case @stride is 0, and the bitmap buffer holds pixels of the spans packed one after another.
+     * Pixels not covered by any span are fully transparent, while spans may contain a few transparent pixels too.
+     */
+    std::vector<ImageSpan> spans;
 public:
     Image() = default;
     Image(const Image&) = default;
     Image(Image&&) noexcept = default;
     Image& operator=(const Image&) = default;
     Image& operator=(Image&&) noexcept = default;
+public:
+    /**
+     * Retrieve pointer to the pixels, regardless of whether the bitmap buffer is shared
+     */
+    [[nodiscard]]
+    const uint8_t* data() const {
+        return shared_bitmap ? shared_bitmap->data() : bitmap.data();
+    }
+
+    /**
+     * Retrieve size of the bitmap buffer in bytes, regardless of whether the bitmap buffer is shared
+     */
+    [[nodiscard]]
+    size_t size() const {
+        return shared_bitmap ? shared_bitmap->size() : bitmap.size();
+    }
 };
 
 }  // namespace aribcaption
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ARIBCAPTION_PIXEL_BUFFER_OUTPUT_HPP
+#define ARIBCAPTION_PIXEL_BUFFER_OUTPUT_HPP
+
+#include <CoreVideo/CoreVideo.h>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "aribcc_export.h"
+#include "context.hpp"
+#include "image.hpp"
+#include "renderer.hpp"
+
+namespace aribcaption {
+
+namespace internal { class PixelBufferOutputImpl; }
+
+/**
+ * Structure represents a rendered caption image held by an IOSurface backed CVPixelBuffer
+ *
+ * Holds a reference to the pixel buffer, copying the structure retains it.
+ */
+struct PixelBufferImage {
+public:
+    /**
+     * kCVPixelFormatType_32BGRA, IOSurface backed and Metal compatible pixel buffer.
+     *
+     * It may be larger than the image, only the top-left @width x @height area holds the caption,
+     * pixels outside of it are undefined. Must not be written to, since it may be handed out again
+     * by a following rendering if the image is unchanged.
+     */
+    CVPixelBufferRef pixel_buffer = nullptr;
+
+    int width = 0;     ///< image width, inside the pixel buffer
+    int height = 0;    ///< image height, inside the pixel buffer
+
+    int dst_x = 0;     ///< x coordinate of image's top-left corner inside the player's renderer frame
+    int dst_y = 0;     ///< y coordinate of image's top-left corner inside the player's renderer frame
+
+    int display_width = 0;   ///< see @Image::display_width
+    int display_height = 0;  ///< see @Image::display_height
+
+    PixelFormat pixel_format = PixelFormat::kBGRA8888;  ///< kBGRA8888 or kBGRA8888Premultiplied
+public:
+    PixelBufferImage() = default;
+
+    ~PixelBufferImage() {
+        if (pixel_buffer) {
+            CVPixelBufferRelease(pixel_buffer);
+        }
+    }
+
+    PixelBufferImage(const PixelBufferImage& image)
+        : pixel_buffer(image.pixel_buffer ? CVPixelBufferRetain(image.pixel_buffer) : nullptr),
+          width(image.width), height(image.height),
+          dst_x(image.dst_x), dst_y(image.dst_y),
+          display_width(image.display_width), display_height(image.display_height),
+          pixel_format(image.pixel_format) {}
+
+    PixelBufferImage(PixelBufferImage&& image) noexcept
+        : pixel_buffer(std::exchange(image.pixel_buffer, nullptr)),
+          width(image.width), height(image.height),
+          dst_x(image.dst_x), dst_y(image.dst_y),
+          display_width(image.display_width), display_height(image.display_height),
+          pixel_format(image.pixel_format) {}
+
+    PixelBufferImage& operator=(PixelBufferImage image) noexcept {
+        std::swap(pixel_buffer, image.pixel_buffer);
+        width = image.width;
+        height = image.height;
+        dst_x = image.dst_x;
+        dst_y = image.dst_y;
+        display_width = image.display_width;
+        display_height = image.display_height;
+        pixel_format = image.pixel_format;
+        return *this;
+    }
+};
+
+/**
+ * Structure for holding rendered images in pixel buffers, see @PixelBufferOutput::Render()
+ */
+struct PixelBufferRenderResult {
+    int64_t pts = 0;             ///< PTS of rendered caption
+    int64_t duration = 0;        ///< duration of rendered caption, may be DURATION_INDEFINITE
+    std::vector<PixelBufferImage> images;
+};
+
+/**
+ * Renderer output into IOSurface backed CVPixelBuffers, for zero-copy composition by Metal or AVFoundation
+ *
+ * Images are written into pixel buffers taken from reusable CVPixelBufferPools, bucketed by size, which could be
+ * wrapped into MTLTextures by CVMetalTextureCache or enqueued into AVSampleBufferDisplayLayer without being uploaded.
+ * Images unchanged since the previous rendering keep their pixel buffers and are not written again.
+ *
+ * For writing pixels straight through, indicate PixelFormat::kBGRA8888Premultiplied (or kBGRA8888)
+ * by @Renderer::SetOutputPixelFormat(). RGBA images are swizzled while writing. Indexed and run-length encoded
+ * images are not supported.
+ *
+ * Only available on Apple platforms if libaribcaption was built with ARIBCC_USE_COREVIDEO.
+ *
+ * Thread safety: same as the @Renderer it renders from. Handed out pixel buffers may be used on any thread.
+ */
+class PixelBufferOutput {
+public:
+    /**
+     * A context is needed for constructing the PixelBufferOutput.
+     *
+     * The context shouldn't be destructed before any other object constructed from the context has been destructed.
+     */
+    ARIBCC_API explicit PixelBufferOutput(Context& context);
+    ARIBCC_API ~PixelBufferOutput();
+    ARIBCC_API PixelBufferOutput(PixelBufferOutput&&) noexcept;
+    ARIBCC_API PixelBufferOutput& operator=(PixelBufferOutput&&) noexcept;
+public:
+    /**
+     * Render caption at specific PTS by @Renderer::Render(), and write the images into pooled pixel buffers
+     *
+     * @param renderer    Initialized renderer
+     * @param pts         Presentation timestamp, in milliseconds
+     * @param out_result  Write back parameter for passing rendered images, will be empty if status is kError / kNoImage.
+     *                    Left untouched if status is kNotReady.
+     * @return            Status returned by @Renderer::Render(), or kError if pixel buffers couldn't be written
+     */
+    ARIBCC_API RenderStatus Render(Renderer& renderer, int64_t pts, PixelBufferRenderResult& out_result);
+
+    /**
+     * Release pixel buffer pools and references to the previous images, e.g. after frame size changed
+     *
+     * Pixel buffers still referenced by the caller stay valid.
+     */
+    ARIBCC_API void Flush();
+public:
+    PixelBufferOutput(const PixelBufferOutput&) = delete;
+    PixelBufferOutput& operator=(const PixelBufferOutput&) = delete;
+private:
+    std::unique_ptr<internal::PixelBufferOutputImpl> pimpl_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_PIXEL_BUFFER_OUTPUT_HPP
@@ -73,7 +73,14 @@ typedef enum aribcc_fontprovider_type_t {
     /**
      * FontProvder based on Win32 GDI API. Available on Windows 2000+.
      */
-    ARIBCC_FONTPROVIDER_TYPE_GDI = 5
+    ARIBCC_FONTPROVIDER_TYPE_GDI = 5,
+#endif
+
+#if defined(ARIBCC_USE_FREETYPE)
+    /**
+     * FontProvider serving fonts added by aribcc_context_add_font_data(). Available with FreeType, e.g. on WebAssembly.
+     */
+    ARIBCC_FONTPROVIDER_TYPE_MEMORY = 6
 #endif
 } aribcc_fontprovider_type_t;
 
@@ -133,8 +140,64 @@ typedef enum aribcc_caption_storage_policy_t {
      * The renderer will keep appended captions at an upper limit of duration, in milliseconds.
      */
     ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_DURATION = 3,
+
+    /**
+     * The renderer will keep appended captions at an upper limit of estimated memory usage, in bytes.
+     * The oldest captions are converted into compact form first, then evicted if it's still over the limit.
+     */
+    ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_BYTES = 4,
 } aribcc_caption_storage_policy_t;
 
+/**
+ * Enums for indicating how stroke borders of text are generated
+ */
+typedef enum aribcc_stroke_mode_t {
+    /**
+     * Stroke the glyph outline and rasterize the stroked outline. Exact, but rasterizes each stroked glyph twice.
+     * This is the default behavior.
+     */
+    ARIBCC_STROKE_MODE_OUTLINE = 0,
+
+    /**
+     * Dilate the rasterized fill coverage by the stroke width. Much cheaper than ARIBCC_STROKE_MODE_OUTLINE,
+     * at the cost of slightly rounder corners on thick borders.
+     */
+    ARIBCC_STROKE_MODE_DILATION = 1,
+} aribcc_stroke_mode_t;
+
+/**
+ * Enums for choosing a speed / quality trade-off of glyph and DRCS rasterization
+ */
+typedef enum aribcc_quality_preset_t {
+    /**
+     * Unhinted glyphs, stroke borders by ARIBCC_STROKE_MODE_DILATION, nearest neighbor DRCS scaling.
+     */
+    ARIBCC_QUALITY_PRESET_FAST = 0,
+
+    /**
+     * Default hinting of the text renderer, ARIBCC_STROKE_MODE_OUTLINE, nearest neighbor DRCS scaling.
+     * This is the default behavior.
+     */
+    ARIBCC_QUALITY_PRESET_BALANCED = 1,
+
+    /**
+     * Light hinting, ARIBCC_STROKE_MODE_OUTLINE, bilinear DRCS scaling.
+     */
+    ARIBCC_QUALITY_PRESET_BEST = 2,
+} aribcc_quality_preset_t;
+
+/**
+ * Enums for reporting the quality level a caption was rendered at, each level includes the previous ones
+ *
+ * See @aribcc_renderer_set_render_time_budget()
+ */
+typedef enum aribcc_render_quality_t {
+    ARIBCC_RENDER_QUALITY_FULL = 0,
+    ARIBCC_RENDER_QUALITY_NO_RUBY = 1,
+    ARIBCC_RENDER_QUALITY_DILATION_STROKE = 2,
+    ARIBCC_RENDER_QUALITY_REDUCED_SCALE = 3,
+} aribcc_render_quality_t;
+
 /**
  * Enums for reporting rendering status
  *
@@ -145,6 +208,7 @@ typedef enum aribcc_render_status_t {
     ARIBCC_RENDER_STATUS_NO_IMAGE = 1,
     ARIBCC_RENDER_STATUS_GOT_IMAGE = 2,
     ARIBCC_RENDER_STATUS_GOT_IMAGE_UNCHANGED = 3,
+    ARIBCC_RENDER_STATUS_NOT_READY = 4,
 } aribcc_render_status_t;
 
 /**
@@ -164,8 +228,54 @@ typedef struct aribcc_render_result_t {
      */
     aribcc_image_t* images;
     uint32_t image_count;    ///< element count of images array
+
+    uint32_t region_cache_hits;  ///< count of images reused from the region image cache in this rendering
+    aribcc_render_quality_t quality;  ///< quality level of images, see @aribcc_renderer_set_render_time_budget()
+
+    /**
+     * Array of image_count elements, may be NULL if images is NULL.
+     *
+     * Non-zero if images[i] differs from every image returned by the previous rendering,
+     * zero if it's identical (same content, same position) to one of them, thus re-uploading could be skipped.
+     * All zero for ARIBCC_RENDER_STATUS_GOT_IMAGE_UNCHANGED.
+     */
+    uint8_t* image_changed;
 } aribcc_render_result_t;
 
+/**
+ * Enums for pixel layout of caller-supplied video frames
+ *
+ * See @aribcc_renderer_render_into()
+ */
+typedef enum aribcc_frame_format_t {
+    ARIBCC_FRAME_FORMAT_RGBA8888 = 0,   ///< packed, in plane 0
+    ARIBCC_FRAME_FORMAT_BGRA8888 = 1,   ///< packed, in plane 0
+    ARIBCC_FRAME_FORMAT_YUV420P = 2,    ///< 8-bit Y, U and V in planes 0, 1 and 2, chroma subsampled by 2x2
+    ARIBCC_FRAME_FORMAT_NV12 = 3,       ///< 8-bit Y in plane 0, interleaved UV in plane 1, chroma subsampled by 2x2
+    ARIBCC_FRAME_FORMAT_P010 = 4,       ///< Same layout as NV12 with 16-bit little-endian samples, 10-bit value in the high bits
+} aribcc_frame_format_t;
+
+/**
+ * Enums for RGB to YUV conversion matrix, all are limited range
+ */
+typedef enum aribcc_yuv_matrix_t {
+    ARIBCC_YUV_MATRIX_BT601 = 0,
+    ARIBCC_YUV_MATRIX_BT709 = 1,
+    ARIBCC_YUV_MATRIX_BT2020 = 2,       ///< BT.2020 non-constant luminance
+} aribcc_yuv_matrix_t;
+
+/**
+ * Structure describes a caller-owned video frame for burning captions in
+ */
+typedef struct aribcc_frame_buffer_t {
+    aribcc_frame_format_t format;
+    aribcc_yuv_matrix_t yuv_matrix;     ///< used by YUV formats only
+    int width;                          ///< should match the frame size indicated to the renderer
+    int height;
+    uint8_t* planes[3];
+    int strides[3];                     ///< bytes in a line of each plane
+} aribcc_frame_buffer_t;
+
 /**
  * Cleanup the aribcc_render_result_t structure.
  *
@@ -177,6 +287,120 @@ typedef struct aribcc_render_result_t {
 ARIBCC_API void aribcc_render_result_cleanup(aribcc_render_result_t* render_result);
 
 
+/**
+ * Enums for indicating how a glyph quad should be drawn
+ */
+typedef enum aribcc_glyph_quad_type_t {
+    ARIBCC_GLYPH_QUAD_TYPE_SOLID = 0,    ///< Rectangle filled with color. Atlas is not used.
+    ARIBCC_GLYPH_QUAD_TYPE_BORDER = 1,   ///< Stroke border of a glyph, atlas coverage multiplied by color
+    ARIBCC_GLYPH_QUAD_TYPE_FILL = 2,     ///< Filling of a glyph, atlas coverage multiplied by color
+} aribcc_glyph_quad_type_t;
+
+/**
+ * Structure represents a textured (or solid) rectangle produced by glyph atlas rendering
+ *
+ * See @aribcc_renderer_render_glyph_atlas()
+ */
+typedef struct aribcc_glyph_quad_t {
+    aribcc_glyph_quad_type_t type;
+    int atlas_x;    ///< x coordinate of the glyph inside the atlas, unused for ARIBCC_GLYPH_QUAD_TYPE_SOLID
+    int atlas_y;    ///< y coordinate of the glyph inside the atlas, unused for ARIBCC_GLYPH_QUAD_TYPE_SOLID
+    int width;
+    int height;
+    int dst_x;      ///< x coordinate of the quad's top-left corner inside the player's renderer frame
+    int dst_y;      ///< y coordinate of the quad's top-left corner inside the player's renderer frame
+    aribcc_color_t color;
+} aribcc_glyph_quad_t;
+
+/**
+ * Structure represents an area inside the glyph atlas
+ */
+typedef struct aribcc_atlas_rect_t {
+    int x;
+    int y;
+    int width;
+    int height;
+} aribcc_atlas_rect_t;
+
+/**
+ * Structure for holding the result of glyph atlas rendering
+ *
+ * The atlas is an 8-bit coverage texture persistent across calls. Glyphs are only added into it,
+ * so that only dirty_rects need to be uploaded, unless atlas_generation changes.
+ *
+ * All pointers are owned by the renderer, and are valid until next call to any function of the renderer.
+ */
+typedef struct aribcc_glyph_atlas_render_result_t {
+    int64_t pts;             ///< PTS of rendered caption
+    int64_t duration;        ///< duration of rendered caption, may be ARIBCC_DURATION_INDEFINITE
+
+    const aribcc_glyph_quad_t* quads;   ///< in drawing order, should be alpha blended one by one
+    uint32_t quad_count;
+
+    uint32_t atlas_generation;          ///< changes if the atlas has been reset, upload the whole atlas then
+    int atlas_width;
+    int atlas_height;                   ///< stride always equals to atlas_width
+    const uint8_t* atlas_pixels;
+
+    const aribcc_atlas_rect_t* dirty_rects;   ///< areas of the atlas updated since the previous call
+    uint32_t dirty_rect_count;
+} aribcc_glyph_atlas_render_result_t;
+
+/**
+ * Structure for reporting statistics of the renderer's glyph cache
+ *
+ * See @aribcc_renderer_get_glyph_cache_stats()
+ */
+typedef struct aribcc_glyph_cache_stats_t {
+    uint64_t hits;           ///< count of glyphs served from the cache
+    uint64_t misses;         ///< count of glyphs that had to be rasterized
+    size_t entry_count;      ///< count of glyphs currently cached
+    size_t used_bytes;       ///< approximate memory used by cached glyphs, in bytes
+    size_t limit_bytes;      ///< current memory limit of the cache, in bytes
+} aribcc_glyph_cache_stats_t;
+
+/**
+ * Structure for reporting statistics of the renderer's bitmap buffer pool
+ *
+ * See @aribcc_renderer_get_bitmap_pool_stats()
+ */
+typedef struct aribcc_bitmap_pool_stats_t {
+    uint64_t hits;           ///< count of buffer requests served from the pool
+    uint64_t misses;         ///< count of buffer requests that had to be allocated
+    size_t pooled_count;     ///< count of free buffers currently retained by the pool
+    size_t pooled_bytes;     ///< memory retained by free buffers, in bytes
+    size_t limit_bytes;      ///< current high-water mark of the pool, in bytes
+} aribcc_bitmap_pool_stats_t;
+
+/**
+ * Structure for reporting memory held by the renderer, per subsystem
+ *
+ * See @aribcc_renderer_get_memory_usage()
+ */
+typedef struct aribcc_renderer_memory_usage_t {
+    size_t caption_storage_bytes;     ///< appended captions
+    size_t glyph_cache_bytes;         ///< rasterized glyphs cached by the text renderers
+    size_t drcs_cache_bytes;          ///< scaled DRCS patterns
+    size_t region_image_cache_bytes;  ///< rendered region images cached by content
+    size_t rendered_image_bytes;      ///< images kept for the next rendering, prerendered images included
+    size_t glyph_atlas_bytes;         ///< pixels of the glyph atlas
+    size_t bitmap_pool_bytes;         ///< free buffers retained by the bitmap pool
+    size_t font_face_count;           ///< font faces loaded by the text renderers, font files are memory mapped
+} aribcc_renderer_memory_usage_t;
+
+/**
+ * Structure for reporting how long the startup phases of the renderer took, in microseconds
+ *
+ * Phases not yet reached are reported as zero. See @aribcc_renderer_get_startup_timings()
+ */
+typedef struct aribcc_renderer_startup_timings_t {
+    uint64_t initialize_us;           ///< whole renderer initialization
+    uint64_t font_provider_init_us;   ///< initialization of the FontProvider, part of initialize_us
+    uint64_t text_renderer_init_us;   ///< initialization of the TextRenderer, part of initialize_us
+    uint64_t first_font_load_us;      ///< loading of the main font face, done on the first character drawn
+    uint64_t first_render_us;         ///< first rendering of a caption into images, first_font_load_us included
+} aribcc_renderer_startup_timings_t;
+
 /**
  * ARIB STD-B24 caption renderer
  *
@@ -188,6 +412,7 @@ typedef struct aribcc_renderer_t aribcc_renderer_t;
  * A context is needed for allocating the Renderer.
  *
  * The context shouldn't be freed before any other object constructed from the context has been freed.
+ * A renderer must not be used from multiple threads concurrently, but different renderers can be used on different threads.
  */
 ARIBCC_API aribcc_renderer_t* aribcc_renderer_alloc(aribcc_context_t* context);
 
@@ -210,6 +435,19 @@ ARIBCC_API bool aribcc_renderer_initialize(aribcc_renderer_t* renderer,
                                            aribcc_fontprovider_type_t font_provider_type,
                                            aribcc_textrenderer_type_t text_renderer_type);
 
+/**
+ * Initialize as a warm copy of another initialized renderer, instead of calling @aribcc_renderer_initialize.
+ *
+ * Settings are taken over from other, and loaded font faces and cached glyphs are shared,
+ * so that the first captions rendered don't wait for opening fonts again. Captions are not copied.
+ * other must not be used on another thread meanwhile.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param other     An initialized @aribcc_renderer_t
+ * @return true on success
+ */
+ARIBCC_API bool aribcc_renderer_initialize_from(aribcc_renderer_t* renderer, aribcc_renderer_t* other);
+
 /**
  * Indicate stroke width for stroke text, in dots (relative)
  *
@@ -234,6 +472,36 @@ ARIBCC_API void aribcc_renderer_set_replace_drcs(aribcc_renderer_t* renderer, bo
  */
 ARIBCC_API void aribcc_renderer_set_force_stroke_text(aribcc_renderer_t* renderer, bool force_stroke);
 
+/**
+ * Indicate how stroke borders are generated, trading exact outline fidelity for throughput
+ * Currently only honored by the FreeType text renderer.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param mode      default as ARIBCC_STROKE_MODE_OUTLINE
+ */
+ARIBCC_API void aribcc_renderer_set_stroke_mode(aribcc_renderer_t* renderer, aribcc_stroke_mode_t mode);
+
+/**
+ * Apply a quality preset, indicating glyph hinting, stroke mode and DRCS scaling filter at once.
+ * A following aribcc_renderer_set_stroke_mode() overrides the stroke mode of the preset.
+ * Hinting is only honored by the FreeType text renderer.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param preset    default as ARIBCC_QUALITY_PRESET_BALANCED
+ */
+ARIBCC_API void aribcc_renderer_set_quality_preset(aribcc_renderer_t* renderer, aribcc_quality_preset_t preset);
+
+/**
+ * Indicate whether glyphs are produced from signed distance fields, rasterizing each glyph outline only once
+ * regardless of character size. Currently only honored by the FreeType text renderer.
+ *
+ * See @Renderer::SetDistanceFieldGlyphs() for details.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param enable    default as false
+ */
+ARIBCC_API void aribcc_renderer_set_distance_field_glyphs(aribcc_renderer_t* renderer, bool enable);
+
 /**
  * Indicate whether ignore rendering for ruby-like (furigana) characters
  *
@@ -250,6 +518,16 @@ ARIBCC_API void aribcc_renderer_set_force_no_ruby(aribcc_renderer_t* renderer, b
  */
 ARIBCC_API void aribcc_renderer_set_force_no_background(aribcc_renderer_t* renderer, bool force_no_background);
 
+/**
+ * Indicate whether trim region images to the bounding box of non-transparent pixels
+ *
+ * Empty areas around the text are cut off from each region image, dst_x / dst_y are adjusted accordingly.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param trim      default as false
+ */
+ARIBCC_API void aribcc_renderer_set_trim_region_images(aribcc_renderer_t* renderer, bool trim);
+
 /**
  * Merge rendered region images into one big image on aribcc_renderer_render() call.
  * @param renderer  @aribcc_renderer_t
@@ -257,6 +535,56 @@ ARIBCC_API void aribcc_renderer_set_force_no_background(aribcc_renderer_t* rende
  */
 ARIBCC_API void aribcc_renderer_set_merge_region_images(aribcc_renderer_t* renderer, bool merge);
 
+/**
+ * Render superimpose (ARIBCC_CAPTIONTYPE_SUPERIMPOSE) in a separate layer above captions
+ *
+ * If enabled, superimpose appended is kept apart from captions, and @aribcc_renderer_render() returns both layers,
+ * caption images followed by superimpose images. Use @aribcc_renderer_render_layers() for separate results.
+ * Both layers share fonts, glyph caches and settings of the renderer.
+ * Other rendering functions, prerendering and asynchronous rendering cover the caption layer only.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param enable    default as false
+ */
+ARIBCC_API void aribcc_renderer_set_superimpose_layer(aribcc_renderer_t* renderer, bool enable);
+
+/**
+ * Indicate pixel format of rendered images, e.g. premultiplied alpha or BGRA for GPU upload
+ *
+ * Images are converted by the renderer, so that no conversion pass is needed by the caller.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param format    default as @ARIBCC_PIXELFORMAT_RGBA8888
+ */
+ARIBCC_API void aribcc_renderer_set_output_pixel_format(aribcc_renderer_t* renderer, aribcc_pixelformat_t format);
+
+/**
+ * Indicate alignment of rendered images, so that they could be uploaded or scanned out without repacking
+ *
+ * Rows are padded so that stride is a multiple of row_alignment (e.g. 256 for D3D12 texture uploads),
+ * and bitmap is aligned to base_alignment. Both must be powers of two, values below 32 (the default) are raised to 32.
+ * Bitmaps are allocated by the context's allocator, see @aribcc_context_set_allocator().
+ *
+ * @param renderer        @aribcc_renderer_t
+ * @param row_alignment   alignment of stride in bytes
+ * @param base_alignment  alignment of bitmap in bytes
+ * @return                false if either alignment is not a power of two
+ */
+ARIBCC_API bool aribcc_renderer_set_image_alignment(aribcc_renderer_t* renderer,
+                                                    size_t row_alignment,
+                                                    size_t base_alignment);
+
+/**
+ * Emit rendered images in run-length encoded form
+ *
+ * If enabled, each line of an image is stored as spans of non-transparent pixels,
+ * see @aribcc_image_t::spans, so that blending only needs to touch the covered spans.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param enable    default as false
+ */
+ARIBCC_API void aribcc_renderer_set_run_length_encoded_images(aribcc_renderer_t* renderer, bool enable);
+
 /**
  * Indicate font families (an array of font family names) for default usage
  *
@@ -336,18 +664,180 @@ ARIBCC_API bool aribcc_renderer_set_frame_size(aribcc_renderer_t* renderer, int
  */
 ARIBCC_API bool aribcc_renderer_set_margins(aribcc_renderer_t* renderer, int top, int bottom, int left, int right);
 
+/**
+ * Limit the magnification of the caption plane that region images are rendered at, 0 for unlimited
+ *
+ * Images rendered at a lower magnification report the size they should be scaled into by
+ * display_width / display_height of @aribcc_image_t. See @Renderer::SetMaxRenderMagnification() for details.
+ *
+ * @param renderer       @aribcc_renderer_t
+ * @param magnification  maximum magnification, default as 0
+ */
+ARIBCC_API void aribcc_renderer_set_max_render_magnification(aribcc_renderer_t* renderer, float magnification);
+
+/**
+ * Indicate a time budget for rendering a caption, 0 for unlimited
+ *
+ * Rendering quality is degraded in steps to fit into the budget, and restored once possible.
+ * See @Renderer::SetRenderTimeBudget() for details.
+ *
+ * @param renderer   @aribcc_renderer_t
+ * @param budget_us  budget in microseconds, default as 0
+ */
+ARIBCC_API void aribcc_renderer_set_render_time_budget(aribcc_renderer_t* renderer, int64_t budget_us);
+
 /**
  * Set storage policy for renderer's internal caption storage
  *
  * @param renderer       @aribcc_renderer_t
  * @param storage_policy See @aribcc_caption_storage_policy_t
- * @param upper_limit    Must be non-zero value for ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_COUNT or
- *                       ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_DURATION
+ * @param upper_limit    Must be non-zero value for ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_COUNT,
+ *                       ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_DURATION or
+ *                       ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_BYTES
  */
 ARIBCC_API void aribcc_renderer_set_storage_policy(aribcc_renderer_t* renderer,
                                                    aribcc_caption_storage_policy_t storage_policy,
                                                    size_t upper_limit);
 
+/**
+ * Store appended captions in compact form, which saves memory if lots of captions are stored
+ *
+ * Characters are expanded temporarily while rendering.
+ *
+ * @param renderer @aribcc_renderer_t
+ * @param compact  default as false
+ */
+ARIBCC_API void aribcc_renderer_set_compact_caption_storage(aribcc_renderer_t* renderer, bool compact);
+
+/**
+ * Store captions away from the rendering position in compressed form, which saves memory for long recordings
+ *
+ * Only captions within hot_window milliseconds around the rendering position are kept expanded.
+ * Others are decompressed when being looked up again.
+ *
+ * @param renderer   @aribcc_renderer_t
+ * @param enable     default as false
+ * @param hot_window width of the window before and after the rendering position, in milliseconds
+ */
+ARIBCC_API void aribcc_renderer_set_cold_caption_storage(aribcc_renderer_t* renderer,
+                                                         bool enable,
+                                                         int64_t hot_window);
+
+/**
+ * Get estimated memory usage of the renderer's internal caption storage, in bytes
+ *
+ * @param renderer @aribcc_renderer_t
+ */
+ARIBCC_API size_t aribcc_renderer_get_caption_storage_bytes(aribcc_renderer_t* renderer);
+
+/**
+ * Set memory limit of the glyph cache, in bytes
+ *
+ * Rasterized glyphs are cached by the text renderer and evicted in least-recently-used order.
+ * Currently only the Freetype based text renderer makes use of the cache.
+ * Scaled DRCS patterns are cached separately, within a quarter of this limit.
+ *
+ * @param renderer     @aribcc_renderer_t
+ * @param limit_bytes  Indicate 0 to disable the cache. Default as 4 MiB
+ */
+ARIBCC_API void aribcc_renderer_set_glyph_cache_limit(aribcc_renderer_t* renderer, size_t limit_bytes);
+
+/**
+ * Persist rasterized glyphs and font fallback resolutions into a cache file, for warm starts across runs
+ *
+ * The file is memory mapped and read on demand, new glyphs are written back in the background
+ * and on @aribcc_renderer_free(). Entries are tied to the font file contents, pixel size and library version.
+ * Currently only the Freetype based text renderer makes use of the file.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param filename  Path of the cache file in UTF-8, created if not existing. Indicate NULL or "" to disable
+ * @return          false if no valid file was loaded, e.g. not created yet or written by another version
+ */
+ARIBCC_API bool aribcc_renderer_set_glyph_cache_file(aribcc_renderer_t* renderer, const char* filename);
+
+/**
+ * Set capacity of the region image cache, in count of images
+ *
+ * Rendered region images are cached by content, so that identical regions appearing in subsequent captions
+ * (e.g. retransmissions or roll-up captions) won't be rendered again.
+ * See @aribcc_render_result_t::region_cache_hits.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param count     Indicate 0 to disable the cache. Default as 4
+ */
+ARIBCC_API void aribcc_renderer_set_region_image_cache_size(aribcc_renderer_t* renderer, size_t count);
+
+/**
+ * Set count of threads used for rendering caption regions in parallel
+ *
+ * The calling thread takes part in rendering, thus count - 1 worker threads are created.
+ * Must be called after @aribcc_renderer_initialize.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param count     Indicate 0 or 1 to render serially. Default as 1
+ * @return          false if TextRenderer of a worker thread failed to initialize
+ */
+ARIBCC_API bool aribcc_renderer_set_region_render_threads(aribcc_renderer_t* renderer, size_t count);
+
+/**
+ * Retrieve statistics of the glyph cache
+ *
+ * @param renderer   @aribcc_renderer_t
+ * @param out_stats  Write back parameter, all zero if the text renderer doesn't support glyph cache
+ */
+ARIBCC_API void aribcc_renderer_get_glyph_cache_stats(aribcc_renderer_t* renderer,
+                                                      aribcc_glyph_cache_stats_t* out_stats);
+
+/**
+ * Set high-water mark of the bitmap buffer pool, in bytes
+ *
+ * Bitmaps of rendered images are recycled into the renderer's pool by @aribcc_image_cleanup().
+ * Free buffers exceeding the limit are released to the system.
+ * Images may outlive the renderer, their bitmaps are simply freed then.
+ *
+ * @param renderer     @aribcc_renderer_t
+ * @param limit_bytes  Indicate 0 to disable pooling. Default as 32 MiB
+ */
+ARIBCC_API void aribcc_renderer_set_bitmap_pool_limit(aribcc_renderer_t* renderer, size_t limit_bytes);
+
+/**
+ * Retrieve statistics of the bitmap buffer pool
+ *
+ * @param renderer   @aribcc_renderer_t
+ * @param out_stats  Write back parameter
+ */
+ARIBCC_API void aribcc_renderer_get_bitmap_pool_stats(aribcc_renderer_t* renderer,
+                                                      aribcc_bitmap_pool_stats_t* out_stats);
+
+/**
+ * Release internal memory in graded steps, e.g. on platform memory pressure
+ *
+ * Unlike @aribcc_renderer_flush(), appended captions are kept. Everything released is rebuilt on demand.
+ * See @aribcc_context_trim_memory() for trimming all renderers of a context from any thread.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param level     See @aribcc_memory_trim_level_t
+ */
+ARIBCC_API void aribcc_renderer_trim_memory(aribcc_renderer_t* renderer, aribcc_memory_trim_level_t level);
+
+/**
+ * Retrieve memory held by the renderer, per subsystem
+ *
+ * @param renderer   @aribcc_renderer_t
+ * @param out_usage  Write back parameter
+ */
+ARIBCC_API void aribcc_renderer_get_memory_usage(aribcc_renderer_t* renderer,
+                                                 aribcc_renderer_memory_usage_t* out_usage);
+
+/**
+ * Retrieve how long the startup phases of the renderer took, e.g. for tracking time-to-first-caption
+ *
+ * @param renderer     @aribcc_renderer_t
+ * @param out_timings  Write back parameter
+ */
+ARIBCC_API void aribcc_renderer_get_startup_timings(aribcc_renderer_t* renderer,
+                                                    aribcc_renderer_startup_timings_t* out_timings);
+
 /**
  * Append a caption into renderer's internal storage for subsequent rendering
  *
@@ -359,6 +849,44 @@ ARIBCC_API void aribcc_renderer_set_storage_policy(aribcc_renderer_t* renderer,
  */
 ARIBCC_API bool aribcc_renderer_append_caption(aribcc_renderer_t* renderer, const aribcc_caption_t* caption);
 
+/**
+ * Append a caption handle into renderer's internal storage for subsequent rendering
+ *
+ * The caption is moved into the storage without copying. Ownership of the handle is always transferred,
+ * the handle becomes invalid after this call, even on failure.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param caption   @aribcc_caption_handle_t, e.g. obtained from @aribcc_decoder_decode_handle()
+ * @return true on success
+ */
+ARIBCC_API bool aribcc_renderer_append_caption_handle(aribcc_renderer_t* renderer, aribcc_caption_handle_t* caption);
+
+/**
+ * Append an array of captions into renderer's internal storage for subsequent rendering
+ *
+ * Captions sorted by PTS, e.g. captions of @aribcc_decode_batch_result_t, are stored in one linear pass.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param captions  array of captions, elements are copied
+ * @param count     element count of captions
+ * @return false if any caption is invalid, which has been skipped
+ */
+ARIBCC_API bool aribcc_renderer_append_captions(aribcc_renderer_t* renderer,
+                                                const aribcc_caption_t* captions,
+                                                size_t count);
+
+/**
+ * Change the duration of a caption in the storage, without replacing it
+ *
+ * Intended for ARIBCC_DECODE_STATUS_GOT_DUPLICATE_CAPTION, see @aribcc_decoder_set_deduplicate_captions().
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param pts       PTS of the caption, in milliseconds
+ * @param duration  new duration in milliseconds, or @ARIBCC_DURATION_INDEFINITE
+ * @return false if no caption of the PTS exists
+ */
+ARIBCC_API bool aribcc_renderer_extend_caption(aribcc_renderer_t* renderer, int64_t pts, int64_t duration);
+
 /**
  * Retrieve expected render status at specific PTS, rather than actually do rendering.
  *
@@ -372,6 +900,71 @@ ARIBCC_API bool aribcc_renderer_append_caption(aribcc_renderer_t* renderer, cons
 ARIBCC_API aribcc_render_status_t aribcc_renderer_try_render(aribcc_renderer_t* renderer,
                                                              int64_t pts);
 
+/**
+ * Retrieve PTS of the next change of rendered output after specific PTS
+ *
+ * That is the start of the next appended caption, or the end of the caption presented at pts, whichever earlier.
+ * Players could wait until then instead of rendering on every frame.
+ *
+ * @param renderer    @aribcc_renderer_t
+ * @param pts         Presentation timestamp, in milliseconds
+ * @return            PTS of the next change in milliseconds, or ARIBCC_PTS_NOPTS if nothing would change afterwards
+ */
+ARIBCC_API int64_t aribcc_renderer_get_next_change_pts(aribcc_renderer_t* renderer, int64_t pts);
+
+/**
+ * Render appended captions whose PTS lies in [pts_begin, pts_end) ahead of presentation
+ *
+ * Prerendered images are kept inside the renderer, and will be handed out by aribcc_renderer_render()
+ * at presentation time, unless rendering settings have been changed in between.
+ *
+ * @param renderer    @aribcc_renderer_t
+ * @param pts_begin   Begin of the PTS range, in milliseconds, inclusive
+ * @param pts_end     End of the PTS range, in milliseconds, exclusive
+ * @return            Count of newly prerendered captions
+ */
+ARIBCC_API size_t aribcc_renderer_prerender(aribcc_renderer_t* renderer, int64_t pts_begin, int64_t pts_end);
+
+/**
+ * Callback for notifying that images of the caption at pts have been rendered in background
+ *
+ * Called from the worker thread, must not call into the renderer.
+ */
+typedef void(*aribcc_render_ready_callback_t)(int64_t pts, void* userdata);
+
+/**
+ * Enable or disable asynchronous rendering
+ *
+ * When enabled, appended captions are rendered by a background worker thread, and aribcc_renderer_render()
+ * hands out the latest completed images without blocking, or returns ARIBCC_RENDER_STATUS_NOT_READY
+ * if the caption at that PTS is still being rendered.
+ *
+ * @param renderer    @aribcc_renderer_t
+ * @param enable      Start the worker thread if true, stop it if false
+ * @param callback    Optional, could be NULL
+ * @param userdata    Passed to the callback
+ */
+ARIBCC_API void aribcc_renderer_set_async_rendering(aribcc_renderer_t* renderer,
+                                                    bool enable,
+                                                    aribcc_render_ready_callback_t callback,
+                                                    void* userdata);
+
+/**
+ * Load fonts ahead of the first caption, to avoid the latency of font discovery and face loading
+ *
+ * Frame size must be indicated first.
+ *
+ * @param renderer               @aribcc_renderer_t
+ * @param iso6392_language_code  ISO639-2 language code of upcoming captions, e.g. ARIBCC_MAKE_LANG('j', 'p', 'n')
+ * @param prerasterize           Also rasterize common kana / kanji into the glyph cache in current frame size
+ * @param in_background          Preload on a background thread. A following render call will wait for it.
+ * @return                       true on success, or if preloading has been started in background
+ */
+ARIBCC_API bool aribcc_renderer_preload(aribcc_renderer_t* renderer,
+                                        uint32_t iso6392_language_code,
+                                        bool prerasterize,
+                                        bool in_background);
+
 /**
  * Render caption at specific PTS
  *
@@ -385,6 +978,77 @@ ARIBCC_API aribcc_render_status_t aribcc_renderer_render(aribcc_renderer_t* rend
                                                          int64_t pts,
                                                          aribcc_render_result_t* out_result);
 
+/**
+ * Render caption at specific PTS and alpha blend it directly onto a caller-owned video frame
+ *
+ * No images are copied out, and the caption is blended on every call, including unchanged ones.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param pts       Presentation timestamp, in milliseconds
+ * @param frame     See @aribcc_frame_buffer_t, left untouched if no image was rendered
+ * @return          Same as @aribcc_renderer_render()
+ */
+ARIBCC_API aribcc_render_status_t aribcc_renderer_render_into(aribcc_renderer_t* renderer,
+                                                              int64_t pts,
+                                                              const aribcc_frame_buffer_t* frame);
+
+/**
+ * Render captions and superimpose at specific PTS into separate results, see @aribcc_renderer_set_superimpose_layer()
+ *
+ * Call @aribcc_render_result_cleanup() on both results for freeing the images.
+ *
+ * @param renderer         @aribcc_renderer_t
+ * @param pts              Presentation timestamp, in milliseconds
+ * @param out_caption      Write back parameter for images of the caption layer, empty if it has no image
+ * @param out_superimpose  Write back parameter for images of the superimpose layer, empty if it has no image
+ * @return                 Same as @aribcc_renderer_render() for both layers together
+ */
+ARIBCC_API aribcc_render_status_t aribcc_renderer_render_layers(aribcc_renderer_t* renderer,
+                                                               int64_t pts,
+                                                               aribcc_render_result_t* out_caption,
+                                                               aribcc_render_result_t* out_superimpose);
+
+/**
+ * Render caption at specific PTS, and borrow rendered images from the renderer without copying
+ *
+ * The images array and bitmaps are owned by the renderer, and are valid only until the next call to
+ * aribcc_renderer_render(), aribcc_renderer_render_borrowed(), or any function which changes the renderer's state.
+ * Bitmaps must not be modified. Do not call @aribcc_render_result_cleanup() on the borrowed result.
+ *
+ * @param renderer    @aribcc_renderer_t
+ * @param pts         Presentation timestamp, in milliseconds
+ * @param out_result  Write back parameter for passing borrowed images, images will be NULL if status is kError / kNoImage
+ * @return            Same as @aribcc_renderer_render()
+ */
+ARIBCC_API aribcc_render_status_t aribcc_renderer_render_borrowed(aribcc_renderer_t* renderer,
+                                                                  int64_t pts,
+                                                                  aribcc_render_result_t* out_result);
+
+/**
+ * Set size of the glyph atlas in pixels, used by @aribcc_renderer_render_glyph_atlas(). Will reset the atlas.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param width     must be > 0, default as 1024
+ * @param height    must be > 0, default as 1024
+ * @return true on success
+ */
+ARIBCC_API bool aribcc_renderer_set_glyph_atlas_size(aribcc_renderer_t* renderer, int width, int height);
+
+/**
+ * Render caption at specific PTS into glyph quads referring a persistent glyph atlas,
+ * rather than composed RGBA images. Useful for GPU compositing.
+ *
+ * Only the Freetype based text renderer supports this function for now.
+ *
+ * @param renderer    @aribcc_renderer_t
+ * @param pts         Presentation timestamp, in milliseconds
+ * @param out_result  Write back parameter, quads will be NULL if status is kError / kNoImage
+ * @return            ARIBCC_RENDER_STATUS_GOT_IMAGE / ARIBCC_RENDER_STATUS_GOT_IMAGE_UNCHANGED if quads provided
+ */
+ARIBCC_API aribcc_render_status_t aribcc_renderer_render_glyph_atlas(aribcc_renderer_t* renderer,
+                                                                     int64_t pts,
+                                                                     aribcc_glyph_atlas_render_result_t* out_result);
+
 /**
  * Clear caption storage inside the renderer. Will evict all the appended captions.
  *
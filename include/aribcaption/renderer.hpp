@@ -19,12 +19,14 @@
 #ifndef ARIBCAPTION_RENDERER_HPP
 #define ARIBCAPTION_RENDERER_HPP
 
+#include <functional>
 #include <memory>
 #include <optional>
 #include "aribcc_config.h"
 #include "aribcc_export.h"
 #include "context.hpp"
 #include "caption.hpp"
+#include "color.hpp"
 #include "image.hpp"
 
 namespace aribcaption {
@@ -72,6 +74,13 @@ enum class FontProviderType {
      */
     kGDI = 5,
 #endif
+
+#if defined(ARIBCC_USE_FREETYPE)
+    /**
+     * FontProvider serving fonts added by @Context::AddFontData(). Available with FreeType, e.g. on WebAssembly.
+     */
+    kMemory = 6,
+#endif
 };
 
 /**
@@ -132,6 +141,70 @@ enum class CaptionStoragePolicy {
      * The renderer will keep appended captions at an upper limit of duration, in milliseconds.
      */
     kUpperLimitDuration = 3,
+
+    /**
+     * The renderer will keep appended captions at an upper limit of estimated memory usage, in bytes.
+     *
+     * Once over the limit, the oldest captions are converted into compact form (see @CompactCaptionChars) first,
+     * and evicted if it's still over the limit. The latest caption is always kept.
+     */
+    kUpperLimitBytes = 4,
+};
+
+/**
+ * Enums for indicating how stroke borders of text are generated
+ *
+ * See @Renderer::SetStrokeMode()
+ */
+enum class StrokeMode {
+    /**
+     * Stroke the glyph outline and rasterize the stroked outline. Exact, but rasterizes each stroked glyph twice.
+     * This is the default behavior.
+     */
+    kOutline = 0,
+
+    /**
+     * Dilate the rasterized fill coverage by the stroke width. Much cheaper than kOutline,
+     * at the cost of slightly rounder corners on thick borders.
+     */
+    kDilation = 1,
+};
+
+/**
+ * Enums for choosing a speed / quality trade-off of glyph and DRCS rasterization
+ *
+ * See @Renderer::SetQualityPreset()
+ */
+enum class QualityPreset {
+    /**
+     * Unhinted glyphs, stroke borders by StrokeMode::kDilation, nearest neighbor DRCS scaling.
+     * Suitable for devices with slow CPUs.
+     */
+    kFast = 0,
+
+    /**
+     * Default hinting of the text renderer, StrokeMode::kOutline, nearest neighbor DRCS scaling.
+     * This is the default behavior.
+     */
+    kBalanced = 1,
+
+    /**
+     * Light hinting that keeps glyph shapes closer to their outlines, StrokeMode::kOutline,
+     * bilinear DRCS scaling which smooths DRCS upscaled to large character sizes.
+     */
+    kBest = 2,
+};
+
+/**
+ * Enums for reporting the quality level a caption was rendered at, each level includes the previous ones
+ *
+ * See @Renderer::SetRenderTimeBudget()
+ */
+enum class RenderQuality {
+    kFull = 0,            ///< Rendered as indicated by settings
+    kNoRuby = 1,          ///< Ruby (furigana) regions are skipped
+    kDilationStroke = 2,  ///< Stroke borders are generated by StrokeMode::kDilation
+    kReducedScale = 3,    ///< Rendered at half magnification, images need scaling into their display size
 };
 
 /**
@@ -144,6 +217,7 @@ enum class RenderStatus {
     kNoImage = 1,
     kGotImage = 2,
     kGotImageUnchanged = 3,
+    kNotReady = 4,           ///< Asynchronous rendering only, caption exists but its images are still being rendered
 };
 
 /**
@@ -153,10 +227,268 @@ struct RenderResult {
     int64_t pts = 0;             ///< PTS of rendered caption
     int64_t duration = 0;        ///< duration of rendered caption, may be DURATION_INDEFINITE
     std::vector<Image> images;
+    uint32_t region_cache_hits = 0;  ///< count of images reused from the region image cache in this rendering
+    RenderQuality quality = RenderQuality::kFull;  ///< quality level of images, see @Renderer::SetRenderTimeBudget()
+
+    /**
+     * Same size as images. Non-zero if the image at the same index differs from every image
+     * returned by the previous rendering, zero if it's identical (same content, same position) to one of them.
+     * All zero for RenderStatus::kGotImageUnchanged.
+     */
+    std::vector<uint8_t> image_changed;
+};
+
+/**
+ * Frame size of an additional rendition, see @Renderer::RenderForFrameSizes()
+ */
+struct RenderTargetSize {
+    int frame_width = 0;
+    int frame_height = 0;
+};
+
+/**
+ * Enums for pixel layout of caller-supplied video frames
+ *
+ * See @FrameBuffer and @Renderer::RenderInto()
+ */
+enum class FrameFormat {
+    kRGBA8888 = 0,   ///< packed, in plane 0
+    kBGRA8888 = 1,   ///< packed, in plane 0
+    kYUV420P = 2,    ///< 8-bit Y, U and V in planes 0, 1 and 2, chroma subsampled by 2x2
+    kNV12 = 3,       ///< 8-bit Y in plane 0, interleaved UV in plane 1, chroma subsampled by 2x2
+    kP010 = 4,       ///< Same layout as NV12 with 16-bit little-endian samples, 10-bit value in the high bits
+};
+
+/**
+ * Enums for RGB to YUV conversion matrix, all are limited range
+ */
+enum class YUVMatrix {
+    kBT601 = 0,
+    kBT709 = 1,
+    kBT2020 = 2,     ///< BT.2020 non-constant luminance
+};
+
+/**
+ * Structure describes a caller-owned video frame for burning captions in
+ *
+ * See @Renderer::RenderInto()
+ */
+struct FrameBuffer {
+    FrameFormat format = FrameFormat::kRGBA8888;
+    YUVMatrix yuv_matrix = YUVMatrix::kBT709;   ///< used by YUV formats only
+    int width = 0;                              ///< should match the frame size indicated to the renderer
+    int height = 0;
+    uint8_t* planes[3] = {nullptr, nullptr, nullptr};
+    int strides[3] = {0, 0, 0};                 ///< bytes in a line of each plane
+};
+
+/**
+ * Enums for indicating how a GlyphQuad should be drawn
+ */
+enum class GlyphQuadType {
+    kSolid = 0,    ///< Rectangle filled with color, e.g. background, underline and enclosure. Atlas is not used.
+    kBorder = 1,   ///< Stroke border of a glyph, atlas coverage multiplied by color
+    kFill = 2,     ///< Filling of a glyph, atlas coverage multiplied by color
+};
+
+/**
+ * Structure represents a textured (or solid) rectangle produced by glyph atlas rendering
+ *
+ * See @Renderer::RenderGlyphAtlas()
+ */
+struct GlyphQuad {
+    GlyphQuadType type = GlyphQuadType::kSolid;
+    int atlas_x = 0;    ///< x coordinate of the glyph inside the atlas, unused for kSolid
+    int atlas_y = 0;    ///< y coordinate of the glyph inside the atlas, unused for kSolid
+    int width = 0;
+    int height = 0;
+    int dst_x = 0;      ///< x coordinate of the quad's top-left corner inside the player's renderer frame
+    int dst_y = 0;      ///< y coordinate of the quad's top-left corner inside the player's renderer frame
+    ColorRGBA color;
+};
+
+/**
+ * Structure represents an area inside the glyph atlas
+ */
+struct AtlasRect {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+/**
+ * Structure for holding the result of glyph atlas rendering
+ *
+ * The atlas is an 8-bit coverage texture persistent across calls. Glyphs are only added into it,
+ * so that only dirty_rects need to be uploaded, unless atlas_generation changes.
+ */
+struct GlyphAtlasRenderResult {
+    int64_t pts = 0;             ///< PTS of rendered caption
+    int64_t duration = 0;        ///< duration of rendered caption, may be DURATION_INDEFINITE
+
+    std::vector<GlyphQuad> quads;  ///< in drawing order, should be alpha blended one by one
+
+    /**
+     * Changes if the atlas has been reset, all previous content becomes invalid.
+     * Upload the whole atlas in that case.
+     */
+    uint32_t atlas_generation = 0;
+    int atlas_width = 0;
+    int atlas_height = 0;          ///< stride always equals to atlas_width
+
+    /**
+     * Pixels of the atlas, owned by the renderer. Valid until next call to any function of the renderer.
+     */
+    const uint8_t* atlas_pixels = nullptr;
+
+    std::vector<AtlasRect> dirty_rects;  ///< areas of the atlas updated since the previous call
+};
+
+/**
+ * Structure describes a solid rectangle of a caption layout, e.g. an underline or an enclosure line
+ *
+ * See @Renderer::RenderLayout()
+ */
+struct LayoutRect {
+    int x = 0;        ///< x coordinate of the top-left corner inside the player's renderer frame
+    int y = 0;        ///< y coordinate of the top-left corner inside the player's renderer frame
+    int width = 0;
+    int height = 0;
+    ColorRGBA color;
+};
+
+/**
+ * Structure describes a positioned character of a caption layout
+ *
+ * See @Renderer::RenderLayout()
+ */
+struct LayoutChar {
+    CaptionCharType type = CaptionCharType::kDefault;
+    uint32_t codepoint = 0;       ///< Unicode codepoint, 0 for kDRCS, see @CaptionChar::codepoint
+    uint32_t pua_codepoint = 0;   ///< alternative codepoint in Private Use Area, see @CaptionChar::pua_codepoint
+    uint32_t drcs_code = 0;       ///< key into @Caption::drcs_map for kDRCS / kDRCSReplaced
+
+    /**
+     * Character section including spacing, inside the renderer frame. The background is filled here.
+     */
+    int section_x = 0;
+    int section_y = 0;
+    int section_width = 0;
+    int section_height = 0;
+
+    /**
+     * Box the glyph is scaled into, inside the renderer frame. The em box of the font fits the box.
+     */
+    int char_x = 0;
+    int char_y = 0;
+    int char_width = 0;
+    int char_height = 0;
+
+    CharStyle style = CharStyle::kCharStyleDefault;
+    EnclosureStyle enclosure_style = EnclosureStyle::kEnclosureStyleNone;
+    ColorRGBA text_color;
+    ColorRGBA back_color;         ///< fully transparent if background is disabled by @Renderer::SetForceNoBackground()
+    ColorRGBA stroke_color;
+    float stroke_width = 0.0f;    ///< stroke border width in pixels, 0 if not stroked
+};
+
+/**
+ * Structure describes a positioned caption region of a caption layout
+ *
+ * See @Renderer::RenderLayout()
+ */
+struct LayoutRegion {
+    int x = 0;                    ///< x coordinate of the region inside the player's renderer frame
+    int y = 0;                    ///< y coordinate of the region inside the player's renderer frame
+    int width = 0;
+    int height = 0;
+    bool is_ruby = false;
+
+    std::vector<LayoutChar> chars;
+
+    /**
+     * Underlines of consecutive underlined chars on the same line, placed on the bottom edge of the char boxes.
+     * Renderers that know the font metrics may move them to the underline position of the font.
+     */
+    std::vector<LayoutRect> underlines;
+    std::vector<LayoutRect> enclosures;   ///< enclosure lines around char sections, in text color
+};
+
+/**
+ * Structure for holding the layout of a caption
+ *
+ * See @Renderer::RenderLayout()
+ */
+struct LayoutResult {
+    int64_t pts = 0;              ///< PTS of the caption
+    int64_t duration = 0;         ///< duration of the caption, may be DURATION_INDEFINITE
+
+    std::vector<LayoutRegion> regions;
+};
+
+/**
+ * Structure for reporting statistics of the renderer's glyph cache
+ *
+ * See @Renderer::GetGlyphCacheStats()
+ */
+struct GlyphCacheStats {
+    uint64_t hits = 0;           ///< count of glyphs served from the cache
+    uint64_t misses = 0;         ///< count of glyphs that had to be rasterized
+    size_t entry_count = 0;      ///< count of glyphs currently cached
+    size_t used_bytes = 0;       ///< approximate memory used by cached glyphs, in bytes
+    size_t limit_bytes = 0;      ///< current memory limit of the cache, in bytes
+};
+
+/**
+ * Structure for reporting statistics of the renderer's bitmap buffer pool
+ *
+ * See @Renderer::GetBitmapPoolStats()
+ */
+struct BitmapPoolStats {
+    uint64_t hits = 0;           ///< count of buffer requests served from the pool
+    uint64_t misses = 0;         ///< count of buffer requests that had to be allocated
+    size_t pooled_count = 0;     ///< count of free buffers currently retained by the pool
+    size_t pooled_bytes = 0;     ///< memory retained by free buffers, in bytes
+    size_t limit_bytes = 0;      ///< current high-water mark of the pool, in bytes
+};
+
+/**
+ * Structure for reporting memory held by the renderer, per subsystem
+ *
+ * See @Renderer::GetMemoryUsage()
+ */
+struct RendererMemoryUsage {
+    size_t caption_storage_bytes = 0;     ///< appended captions, see @Renderer::GetCaptionStorageBytes()
+    size_t glyph_cache_bytes = 0;         ///< rasterized glyphs cached by the text renderers
+    size_t drcs_cache_bytes = 0;          ///< scaled DRCS patterns
+    size_t region_image_cache_bytes = 0;  ///< rendered region images cached by content
+    size_t rendered_image_bytes = 0;      ///< images kept for the next rendering, prerendered images included
+    size_t glyph_atlas_bytes = 0;         ///< pixels of the glyph atlas, see @Renderer::RenderGlyphAtlas()
+    size_t bitmap_pool_bytes = 0;         ///< free buffers retained by the bitmap pool
+    size_t font_face_count = 0;           ///< font faces loaded by the text renderers, font files are memory mapped
+};
+
+/**
+ * Structure for reporting how long the startup phases of the renderer took, in microseconds
+ *
+ * Phases not yet reached are reported as zero. See @Renderer::GetStartupTimings()
+ */
+struct RendererStartupTimings {
+    uint64_t initialize_us = 0;           ///< whole @Renderer::Initialize() or @Renderer::InitializeFrom()
+    uint64_t font_provider_init_us = 0;   ///< initialization of the FontProvider, part of initialize_us
+    uint64_t text_renderer_init_us = 0;   ///< initialization of the TextRenderer, part of initialize_us
+    uint64_t first_font_load_us = 0;      ///< loading of the main font face, done on the first character drawn
+    uint64_t first_render_us = 0;         ///< first rendering of a caption into images, first_font_load_us included
 };
 
 /**
  * ARIB STD-B24 caption renderer
+ *
+ * Thread safety: a Renderer must not be used from multiple threads concurrently,
+ * apart from its own internal threads (see @SetAsyncRendering(), @Preload() and @SetRegionRenderThreads()).
+ * Different renderers, even constructed from the same @Context, can be used on different threads simultaneously.
+ * Font faces shared through @Context::SetShareFontFaces() are synchronized internally.
  */
 class Renderer {
 public:
@@ -182,6 +514,21 @@ public:
                                FontProviderType font_provider_type = FontProviderType::kAuto,
                                TextRendererType text_renderer_type = TextRendererType::kAuto);
 
+    /**
+     * Initialize as a warm copy of another initialized renderer, instead of calling @Initialize().
+     *
+     * Caption type, font families, frame size, margins and the other rendering settings are taken over from other.
+     * Loaded font faces are shared and cached glyphs are copied, so that the first captions rendered
+     * don't wait for opening fonts and rasterizing glyphs again, e.g. when starting to render another stream.
+     * Captions, rendered images and asynchronous rendering (see @SetAsyncRendering()) are per stream, not copied.
+     *
+     * other must not be used on another thread meanwhile. Afterwards both renderers are independent.
+     *
+     * @param other  An initialized renderer
+     * @return true on success
+     */
+    ARIBCC_API bool InitializeFrom(Renderer& other);
+
     /**
      * Indicate stroke width for stroke text, in dots (relative)
      * @param dots must >= 0.0f
@@ -200,6 +547,39 @@ public:
      */
     ARIBCC_API void SetForceStrokeText(bool force_stroke);
 
+    /**
+     * Indicate how stroke borders are generated, trading exact outline fidelity for throughput
+     * Currently only honored by the FreeType text renderer.
+     *
+     * @param mode default as StrokeMode::kOutline
+     */
+    ARIBCC_API void SetStrokeMode(StrokeMode mode);
+
+    /**
+     * Apply a quality preset, indicating glyph hinting, stroke mode and DRCS scaling filter at once
+     *
+     * The preset is applied at the time of calling, a following @SetStrokeMode() overrides its stroke mode.
+     * Hinting is only honored by the FreeType text renderer, DirectWrite and CoreText text renderers always
+     * draw unhinted outlines. DRCS scaling filter applies to all text renderers.
+     *
+     * @param preset default as QualityPreset::kBalanced
+     */
+    ARIBCC_API void SetQualityPreset(QualityPreset preset);
+
+    /**
+     * Indicate whether glyphs are produced from signed distance fields
+     *
+     * If enabled, each glyph outline is rasterized only once at a reference size into a distance field,
+     * from which filling and stroke borders of any character size are resampled, so that changing frame size
+     * or magnification doesn't rasterize outlines again. Glyphs are slightly softer than rasterizing outlines
+     * at the target size, and stroke borders are generated from the field regardless of @SetStrokeMode().
+     * Characters much larger than the reference size, or with stroke borders too thick for the field,
+     * are still rasterized from outlines. Currently only honored by the FreeType text renderer.
+     *
+     * @param enable default as false
+     */
+    ARIBCC_API void SetDistanceFieldGlyphs(bool enable);
+
     /**
      * Indicate whether ignore rendering for ruby-like (furigana) characters
      * @param force_no_ruby default as false
@@ -212,12 +592,94 @@ public:
      */
     ARIBCC_API void SetForceNoBackground(bool force_no_background);
 
+    /**
+     * Indicate whether trim region images to the bounding box of non-transparent pixels
+     *
+     * Empty areas around the text, which are fully transparent if background is disabled,
+     * are cut off from each region image. dst_x / dst_y are adjusted accordingly, so that blending is unaffected.
+     * Reduces memory and blending costs for the caller, e.g. together with @SetForceNoBackground().
+     *
+     * @param trim default as false
+     */
+    ARIBCC_API void SetTrimRegionImages(bool trim);
+
     /**
      * Merge rendered region images into one big image on Render() call.
      * @param merge default as false
      */
     ARIBCC_API void SetMergeRegionImages(bool merge);
 
+    /**
+     * Indicate pixel format of images returned by Render(), e.g. premultiplied alpha or BGRA for GPU upload
+     *
+     * Images are converted by the renderer, so that no conversion pass is needed by the caller.
+     * Doesn't affect RenderGlyphAtlas().
+     *
+     * kIndexed8 emits 8-bit indices with a per-image palette, which is about a quarter of the RGBA size
+     * and maps onto bitmap subtitle encoders such as DVB subtitles or PGS.
+     * Images holding more than 255 visible colors (e.g. anti-aliased glyph edges) are quantized.
+     *
+     * @param format  See @PixelFormat, default as kRGBA8888
+     */
+    ARIBCC_API void SetOutputPixelFormat(PixelFormat format);
+
+    /**
+     * Emit images returned by Render() in run-length encoded form
+     *
+     * If enabled, each line of an image is stored as spans of non-transparent pixels, see @Image::spans,
+     * so that blending only needs to touch the covered spans. Caption images are mostly transparent,
+     * which makes them several times smaller than dense bitmaps. Applies to any output pixel format.
+     * RenderInto() accepts run-length encoded images as well.
+     *
+     * @param enable default as false
+     */
+    ARIBCC_API void SetRunLengthEncodedImages(bool enable);
+
+    /**
+     * Back rendered images with shared, immutable and reference-counted bitmap buffers.
+     *
+     * If enabled, pixels are held by @Image::shared_bitmap rather than @Image::bitmap,
+     * so that RenderResult hands out references instead of copies of the pixels.
+     * Use @Image::data() for accessing pixels in either case.
+     *
+     * @param share default as false
+     */
+    ARIBCC_API void SetShareImageBuffers(bool share);
+
+    /**
+     * Render superimpose (CaptionType::kSuperimpose) in a separate layer above captions
+     *
+     * By default all appended captions share one timeline regardless of their types, so that a renderer
+     * handles either captions or superimpose. If enabled, superimpose passed to @AppendCaption() is kept apart,
+     * and @Render() / @RenderInto() return both layers, caption images followed by superimpose images.
+     * Use @RenderLayers() for separate results. Both layers share fonts, glyph caches and settings of this renderer,
+     * with @SetMergeRegionImages() each layer is merged into an image of its own.
+     *
+     * Superimpose is rendered synchronously, and only by Render(), RenderInto() and RenderLayers().
+     * Other rendering functions, prerendering and asynchronous rendering cover the caption layer only.
+     * Superimpose stored is dropped on disabling.
+     *
+     * @param enable  default as false
+     */
+    ARIBCC_API void SetSuperimposeLayer(bool enable);
+
+    /**
+     * Indicate alignment of images returned by Render(), so that they could be uploaded or scanned out without repacking
+     *
+     * Rows are padded so that @Image::stride is a multiple of row_alignment, e.g. 256 for D3D12 texture uploads
+     * or 64 for some DRM / V4L2 overlay planes, and the first pixel is placed at an address aligned to base_alignment.
+     * Both must be powers of two, values below @Image::kAlignedTo are raised to it, which is also the default.
+     * Run-length encoded images are packed, thus only affected by base_alignment.
+     *
+     * Pixel buffers are allocated by the context's allocator, see @Context::SetAllocator(), which may carve them out
+     * of caller-provided memory, e.g. a persistently mapped upload heap.
+     *
+     * @param row_alignment   alignment of Image::stride in bytes
+     * @param base_alignment  alignment of the pixel buffer in bytes
+     * @return                false if either alignment is not a power of two
+     */
+    ARIBCC_API bool SetImageAlignment(size_t row_alignment, size_t base_alignment);
+
     /**
      * Indicate font families (an array of font family names) for default usage
      *
@@ -250,6 +712,9 @@ public:
      *
      * Usually rendered images will be inside this frame area, unless negative margin values are specified.
      *
+     * Rendered images are kept and only moved if the caption area keeps its size, e.g. letterboxing
+     * after a window resize. They are reported as changed by the next @Render() call.
+     *
      * @param frame_width   must be >= 0
      * @param frame_height  must be >= 0
      * @return true on success
@@ -270,14 +735,193 @@ public:
      */
     ARIBCC_API bool SetMargins(int top, int bottom, int left, int right);
 
+    /**
+     * Limit the magnification of the caption plane that region images are rendered at
+     *
+     * Rasterizing at full magnification is expensive on large frames, e.g. 4K. If the caption area inside
+     * the video area would be magnified beyond the limit, regions are rendered at the limit instead,
+     * e.g. 1.0 renders at the native resolution of the caption plane (960x540, or the size indicated by SWF).
+     * Such images are smaller than the place where they should be displayed: @Image::display_width
+     * and @Image::display_height report the size of the rect starting at (dst_x, dst_y) inside the frame,
+     * which the caller scales the bitmap into, usually by the GPU. @RenderInto() scales them while blending.
+     *
+     * Glyph atlas rendering (see @RenderGlyphAtlas()) is not affected.
+     *
+     * @param magnification maximum magnification, 0 for unlimited. Default as 0.
+     */
+    ARIBCC_API void SetMaxRenderMagnification(float magnification);
+
+    /**
+     * Indicate a time budget for rendering a caption in a @Render() / @RenderInto() call
+     *
+     * Rendering cost per character is measured for each @RenderQuality level. Before rendering a caption,
+     * the best level predicted to fit into the budget is chosen, degrading in steps: skip ruby, stroke by
+     * dilation, then render at half magnification (reported by @Image::display_width / display_height,
+     * as @SetMaxRenderMagnification() does). The level used is reported by @RenderResult::quality.
+     *
+     * While a degraded caption stays on screen, following calls re-render it at a better level
+     * once that is predicted to fit, thus full quality is restored without stalling the caller.
+     * Not applied to asynchronous rendering, which doesn't render on the calling thread.
+     *
+     * @param budget_us budget in microseconds, 0 for unlimited. Default as 0.
+     */
+    ARIBCC_API void SetRenderTimeBudget(int64_t budget_us);
+
     /**
      * Set storage policy for renderer's internal caption storage
      *
      * @param policy       See @CaptionStoragePolicy
-     * @param upper_limit  Optional parameter, but must has a value for kUpperLimitCount & kUpperLimitDuration
+     * @param upper_limit  Optional parameter, but must has a value for kUpperLimitCount, kUpperLimitDuration
+     *                     & kUpperLimitBytes
      */
     ARIBCC_API void SetStoragePolicy(CaptionStoragePolicy policy, std::optional<size_t> upper_limit = std::nullopt);
 
+    /**
+     * Store appended captions in compact form, see @CompactCaptionChars
+     *
+     * Characters of stored captions are moved into @CaptionRegion::compact_chars, which saves most of the memory
+     * taken by CaptionChar if lots of captions are stored, e.g. with @CaptionStoragePolicy::kUnlimited.
+     * Characters are expanded temporarily while rendering.
+     *
+     * Captions holding compact_chars are always accepted by @AppendCaption(), regardless of this setting.
+     *
+     * @param compact default as false
+     */
+    ARIBCC_API void SetCompactCaptionStorage(bool compact);
+
+    /**
+     * Store captions away from the rendering position in compressed form
+     *
+     * If enabled, only captions within @hot_window milliseconds around the PTS last looked up by rendering are kept
+     * expanded. The others are serialized, compressed, then decompressed when being looked up again.
+     * Intended for long recordings with all of the captions appended ahead for seeking, which trades a little latency
+     * after seeking for much lower resident memory.
+     *
+     * @param enable     default as false
+     * @param hot_window width of the window before and after the rendering position, in milliseconds
+     */
+    ARIBCC_API void SetColdCaptionStorage(bool enable, int64_t hot_window = 60000);
+
+    /**
+     * Get estimated memory usage of the internal caption storage, in bytes
+     *
+     * The limit for @CaptionStoragePolicy::kUpperLimitBytes is checked against this value.
+     */
+    ARIBCC_API size_t GetCaptionStorageBytes();
+
+    /**
+     * Set memory limit of the glyph cache, in bytes
+     *
+     * Rasterized glyphs are cached by the TextRenderer and evicted in least-recently-used order.
+     * Currently only the Freetype based TextRenderer makes use of the cache.
+     * Scaled DRCS patterns are cached separately, within a quarter of this limit.
+     *
+     * @param limit_bytes  Indicate 0 to disable the cache. Default as 4 MiB
+     */
+    ARIBCC_API void SetGlyphCacheLimit(size_t limit_bytes);
+
+    /**
+     * Persist rasterized glyphs and font fallback resolutions into a cache file, for warm starts across runs
+     *
+     * The file is memory mapped and glyphs are read on demand once missing from the in-memory glyph cache.
+     * New glyphs are written back in the background, and on destruction of the Renderer.
+     * Entries are tied to the font file contents, pixel size and library version, so outdated ones never match.
+     * Currently only the Freetype based TextRenderer makes use of the file. Not meant to be shared by
+     * multiple Renderers at the same time, the last one written back wins.
+     *
+     * @param filename  Path of the cache file in UTF-8, created if not existing. Indicate empty string to disable
+     * @return          false if no valid file was loaded, e.g. not created yet or written by another version
+     */
+    ARIBCC_API bool SetGlyphCacheFile(const std::string& filename);
+
+    /**
+     * Set capacity of the region image cache, in count of images
+     *
+     * Rendered region images are cached by content, so that identical regions appearing in subsequent captions
+     * (e.g. retransmissions or roll-up captions) won't be rendered again. See @RenderResult::region_cache_hits.
+     *
+     * @param count  Indicate 0 to disable the cache. Default as 4
+     */
+    ARIBCC_API void SetRegionImageCacheSize(size_t count);
+
+    /**
+     * Set count of threads used for rendering caption regions in parallel
+     *
+     * Each thread uses its own TextRenderer, so fonts are opened once per thread
+     * unless @Context::SetShareFontFaces() is enabled. Rendered images are identical to serial rendering.
+     * The calling thread of Render() takes part in rendering, thus count - 1 worker threads are created.
+     * Must be called after Initialize().
+     *
+     * @param count  Indicate 0 or 1 to render serially. Default as 1
+     * @return       false if TextRenderer of a worker thread failed to initialize
+     */
+    ARIBCC_API bool SetRegionRenderThreads(size_t count);
+
+    /**
+     * Retrieve statistics of the glyph cache
+     *
+     * @return See @GlyphCacheStats. All zero if the TextRenderer doesn't support glyph cache.
+     */
+    ARIBCC_API GlyphCacheStats GetGlyphCacheStats() const;
+
+    /**
+     * Set high-water mark of the bitmap buffer pool, in bytes
+     *
+     * Pixel buffers of rendered images are recycled into a size-bucketed pool once released,
+     * either by dropping the images handed back through @RecycleImages(), by the last reference of a shared buffer,
+     * or by aribcc_image_cleanup() for the C API. Free buffers exceeding the limit are released to the system.
+     *
+     * @param limit_bytes  Indicate 0 to disable pooling. Default as 32 MiB
+     */
+    ARIBCC_API void SetBitmapPoolLimit(size_t limit_bytes);
+
+    /**
+     * Retrieve statistics of the bitmap buffer pool
+     *
+     * @return See @BitmapPoolStats
+     */
+    ARIBCC_API BitmapPoolStats GetBitmapPoolStats() const;
+
+    /**
+     * Release internal memory in graded steps, e.g. on platform memory pressure
+     *
+     * Unlike @Flush(), appended captions are kept. Everything released is rebuilt on demand, at the cost of
+     * slower rendering afterwards. Since @MemoryTrimLevel::kComplete drops the images kept for the next rendering,
+     * the next @Render() reports RenderStatus::kGotImage even if the caption is unchanged, and the glyph atlas
+     * starts over with a new generation. Results of asynchronous rendering are kept.
+     * See @Context::TrimMemory() for trimming all renderers of a context from any thread.
+     *
+     * @param level  See @MemoryTrimLevel
+     */
+    ARIBCC_API void TrimMemory(MemoryTrimLevel level);
+
+    /**
+     * Retrieve memory held by the renderer, per subsystem
+     *
+     * @return See @RendererMemoryUsage
+     */
+    ARIBCC_API RendererMemoryUsage GetMemoryUsage() const;
+
+    /**
+     * Retrieve how long the startup phases of the renderer took, e.g. for tracking time-to-first-caption
+     *
+     * Fonts loaded by @PreloadFonts() count as the first font loading, a renderer initialized by
+     * @InitializeFrom() reuses the loaded fonts and thus reports no font loading.
+     *
+     * @return See @RendererStartupTimings
+     */
+    ARIBCC_API RendererStartupTimings GetStartupTimings() const;
+
+    /**
+     * Hand rendered images back to the renderer once they are no longer needed,
+     * so that their bitmap buffers could be reused by subsequent renders.
+     *
+     * Call to this function is optional, images may also simply be destructed.
+     *
+     * @param images  Images previously returned by @Render(), use std::move()
+     */
+    ARIBCC_API void RecycleImages(std::vector<Image>&& images);
+
     /**
      * Append a caption into renderer's internal storage for subsequent rendering
      *
@@ -298,6 +942,30 @@ public:
      */
     ARIBCC_API bool AppendCaption(Caption&& caption);
 
+    /**
+     * Append a batch of captions into renderer's internal storage, e.g. a whole decoded caption track for VOD
+     *
+     * Captions sorted by PTS and later than all stored captions are moved into the storage in one linear pass,
+     * undetermined durations are corrected along the way. Otherwise they are appended one by one,
+     * the same as calling @AppendCaption() for each.
+     *
+     * @param captions Rvalue reference of the batch, use std::move(). Left empty after this call.
+     * @return false if any caption is invalid, which has been skipped
+     */
+    ARIBCC_API bool AppendCaptions(std::vector<Caption>&& captions);
+
+    /**
+     * Change the duration of a caption in the storage, without replacing it
+     *
+     * Intended for retransmitted captions suppressed by the decoder, see @Decoder::SetDeduplicateCaptions().
+     * Images already rendered for the caption are kept.
+     *
+     * @param pts       PTS of the caption, in milliseconds
+     * @param duration  new duration in milliseconds, or DURATION_INDEFINITE
+     * @return false if no caption of the PTS exists
+     */
+    ARIBCC_API bool ExtendCaption(int64_t pts, int64_t duration);
+
     /**
      * Retrieve expected RenderStatus at specific PTS, rather than actually do rendering.
      *
@@ -309,6 +977,83 @@ public:
      */
     ARIBCC_API RenderStatus TryRender(int64_t pts);
 
+    /**
+     * Retrieve PTS of the next change of rendered output after specific PTS
+     *
+     * That is the start of the next appended caption, or the end of the caption presented at pts, whichever earlier.
+     * Rendering results stay the same in between, so that players could wait until then instead of rendering
+     * on every frame. Appending captions or changing rendering settings may bring the change earlier.
+     *
+     * @param pts    Presentation timestamp, in milliseconds
+     * @return       PTS of the next change in milliseconds, or PTS_NOPTS if nothing would change afterwards
+     */
+    [[nodiscard]]
+    ARIBCC_API int64_t GetNextChangePTS(int64_t pts);
+
+    /**
+     * Render appended captions whose PTS lies in [pts_begin, pts_end) ahead of presentation
+     *
+     * Useful for file playback or transcoding, where upcoming captions are already appended.
+     * Prerendered images are kept inside, and will be handed out by Render() at presentation time,
+     * unless rendering settings have been changed in between, which leads to an ordinary rendering.
+     * Prerendered images are dropped once their caption has been presented, removed, or Flush() is called.
+     *
+     * @param pts_begin  Begin of the PTS range, in milliseconds, inclusive
+     * @param pts_end    End of the PTS range, in milliseconds, exclusive
+     * @return           Count of newly prerendered captions
+     */
+    ARIBCC_API size_t Prerender(int64_t pts_begin, int64_t pts_end);
+
+    /**
+     * Render all appended captions whose PTS lies in [pts_begin, pts_end) at once, for offline processing
+     *
+     * Useful for burning a whole caption track into video, where every caption is known ahead of time.
+     * Regions of consecutive captions are rendered together, thus spread over the threads
+     * indicated by @SetRegionRenderThreads(), rather than being limited to the regions of one caption.
+     * Captions without regions are included with empty images, since they clear the previous caption.
+     * Captions failed to render are skipped. Presentation states used by Render() are left untouched.
+     *
+     * @param pts_begin    Begin of the PTS range, in milliseconds, inclusive
+     * @param pts_end      End of the PTS range, in milliseconds, exclusive
+     * @param out_results  Write back parameter for rendered captions in PTS order,
+     *                     each with its pts, duration and images. image_changed is all non-zero.
+     * @return             Count of rendered captions
+     */
+    ARIBCC_API size_t RenderBatch(int64_t pts_begin, int64_t pts_end, std::vector<RenderResult>& out_results);
+
+    /**
+     * Enable or disable asynchronous rendering
+     *
+     * When enabled, appended captions are rendered by a background worker thread, and Render() / TryRender()
+     * never block on rendering: they hand out the latest completed images, or return kNotReady
+     * if the caption at that PTS is still being rendered. Changing rendering settings re-renders all the captions.
+     * Prerender() does nothing in this mode. RenderGlyphAtlas() is unaffected.
+     *
+     * Renderer functions themselves must still be called from a single thread.
+     *
+     * @param enable    Start the worker thread if true, stop it if false. Disabled by default.
+     * @param on_ready  Optional callback invoked from the worker thread when images of the caption at pts are ready.
+     *                  Must not call into the renderer.
+     */
+    ARIBCC_API void SetAsyncRendering(bool enable, std::function<void(int64_t pts)> on_ready = nullptr);
+
+    /**
+     * Load fonts ahead of the first caption, to avoid the latency of font discovery and face loading
+     *
+     * Font families of all the configured languages are resolved, and the fonts of the expected language
+     * are opened. Optionally, common kana / kanji are rasterized into the glyph cache in current frame size.
+     * Frame size must be indicated first. Call again if font families or frame size have been changed.
+     *
+     * @param iso6392_language_code  ISO639-2 language code of upcoming captions, e.g. ThreeCC("jpn")
+     * @param prerasterize           Also rasterize common characters into the glyph cache
+     * @param in_background          Preload on a background thread and return immediately.
+     *                               A following Render() call will wait until preloading finishes.
+     * @return                       true on success, or if preloading has been started in background
+     */
+    ARIBCC_API bool Preload(uint32_t iso6392_language_code = ThreeCC("jpn"),
+                            bool prerasterize = false,
+                            bool in_background = false);
+
     /**
      * Render caption at specific PTS
      *
@@ -319,9 +1064,91 @@ public:
      *
      * @return            kGotImage / kGotImageUnchanged if rendered images provided
      *                    kGotImageUnchanged means this batch of images is completely identical to the previous call
+     *                    kNotReady if images are still being rendered, see SetAsyncRendering()
      */
     ARIBCC_API RenderStatus Render(int64_t pts, RenderResult& out_result);
 
+    /**
+     * Render caption at specific PTS into several frame sizes in one call, e.g. for every rendition of an ABR ladder
+     *
+     * Fonts and glyph caches of this renderer are shared by all sizes, so only layout and rasterization
+     * are done per size. Margins indicated by @SetMargins() are scaled proportionally to each frame size.
+     * Presentation states used by Render() are left untouched, thus image_changed is all non-zero.
+     *
+     * @param pts          Presentation timestamp, in milliseconds
+     * @param sizes        Frame sizes to render into, see @RenderTargetSize
+     * @param out_results  Write back parameter for rendered images of each size, in the order of sizes.
+     *                     Will be empty if status is kError / kNoImage
+     * @return             kGotImage if rendered, kNoImage if there's no caption at pts, kError on failure
+     */
+    ARIBCC_API RenderStatus RenderForFrameSizes(int64_t pts,
+                                                const std::vector<RenderTargetSize>& sizes,
+                                                std::vector<RenderResult>& out_results);
+
+    /**
+     * Render caption at specific PTS and alpha blend it directly onto a caller-owned video frame
+     *
+     * Rendered region images are kept inside the renderer and blended onto the frame, thus no images are copied
+     * into a RenderResult, and merging region images is unnecessary. Useful for burning captions into video.
+     * The caption is blended on every call, including kGotImageUnchanged, since the frame is usually a new one.
+     *
+     * @param pts    Presentation timestamp, in milliseconds
+     * @param frame  See @FrameBuffer, the frame is left untouched if status is kError / kNoImage / kNotReady
+     * @return       Same as @Render()
+     */
+    ARIBCC_API RenderStatus RenderInto(int64_t pts, const FrameBuffer& frame);
+
+    /**
+     * Render captions and superimpose at specific PTS into separate results, see @SetSuperimposeLayer()
+     *
+     * Each result is written like in @Render(), with images of its own layer only,
+     * and left empty if the layer has no image at pts.
+     *
+     * @param pts              Presentation timestamp, in milliseconds
+     * @param out_caption      Write back parameter for images of the caption layer
+     * @param out_superimpose  Write back parameter for images of the superimpose layer
+     * @return                 Same as @Render() for both layers together,
+     *                         kGotImageUnchanged only if neither layer changed
+     */
+    ARIBCC_API RenderStatus RenderLayers(int64_t pts, RenderResult& out_caption, RenderResult& out_superimpose);
+
+    /**
+     * Set size of the glyph atlas in pixels, used by @RenderGlyphAtlas(). Will reset the atlas.
+     *
+     * @param width   must be > 0, default as 1024
+     * @param height  must be > 0, default as 1024
+     * @return true on success
+     */
+    ARIBCC_API bool SetGlyphAtlasSize(int width, int height);
+
+    /**
+     * Render caption at specific PTS into glyph quads referring a persistent glyph atlas,
+     * rather than composed RGBA images. Useful for GPU compositing.
+     *
+     * Only the Freetype based TextRenderer supports this function for now.
+     *
+     * @param pts         Presentation timestamp, in milliseconds
+     * @param out_result  Write back parameter, quads will be empty if status is kError / kNoImage
+     * @return            kGotImage / kGotImageUnchanged if quads provided
+     *                    kGotImageUnchanged means quads are completely identical to the previous call
+     */
+    ARIBCC_API RenderStatus RenderGlyphAtlas(int64_t pts, GlyphAtlasRenderResult& out_result);
+
+    /**
+     * Lay out caption at specific PTS without rasterizing anything
+     *
+     * Region rects, char sections and glyph boxes, colors, styles, underlines and enclosures are reported
+     * in renderer frame coordinates, the same as images produced by @Render() would be positioned.
+     * Intended for callers drawing text by themselves, e.g. web overlays or native text views.
+     * Fonts are not loaded, hence chars failing to render aren't known, and DRCS are reported as is.
+     * @SetMaxRenderMagnification() doesn't apply.
+     *
+     * @param pts         Presentation timestamp, in milliseconds
+     * @param out_result  Write back parameter, regions will be empty if status is kError / kNoImage
+     * @return            kGotImage if a caption is presented at pts, otherwise kNoImage / kError
+     */
+    ARIBCC_API RenderStatus RenderLayout(int64_t pts, LayoutResult& out_result);
+
     /**
      * Clear caption storage inside the renderer. Will evict all the appended captions.
      *
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ARIBCAPTION_SUBTITLE_WRITER_HPP
+#define ARIBCAPTION_SUBTITLE_WRITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "aribcc_export.h"
+#include "caption.hpp"
+
+namespace aribcaption {
+
+/**
+ * Text subtitle formats supported by @SubtitleWriter
+ */
+enum class SubtitleFormat {
+    kWebVTT = 0,  ///< WebVTT, cues positioned by cue settings, ruby as <ruby> markup
+    kTTML = 1,    ///< TTML2, cues positioned by inline regions, ruby as tts:ruby spans
+    kASS = 2,     ///< Advanced SubStation Alpha, lines positioned by \pos on a canvas of the caption plane size
+};
+
+/**
+ * Converter from decoded captions into text subtitle formats, keeping the layout of the captions
+ *
+ * Each line of a caption becomes a cue placed at the position of the line on the caption plane.
+ * Text colors and character styles (bold, italic, underline, stroke) are carried over,
+ * and ruby regions are attached to the characters they annotate, or placed on their own for ASS.
+ *
+ * Output is streamed through the callback as captions are appended, cue by cue.
+ * A caption with indefinite duration is held until the next caption arrives, which terminates it.
+ * Captions decoded by @Decoder::SetTextOnly() are written as unpositioned cues.
+ */
+class SubtitleWriter {
+public:
+    /**
+     * Callback for receiving a piece of output, pieces should be concatenated in order
+     */
+    using OutputCallback = std::function<void(const char* data, size_t length)>;
+public:
+    ARIBCC_API explicit SubtitleWriter(SubtitleFormat format);
+    ARIBCC_API ~SubtitleWriter();
+public:
+    /**
+     * Set callback for receiving output, must be set before appending any caption
+     */
+    ARIBCC_API void SetOutputCallback(OutputCallback callback);
+
+    /**
+     * Set duration of an indefinite caption left pending by @Finish()
+     *
+     * @param duration in milliseconds, default as 1000
+     */
+    ARIBCC_API void SetLastCaptionDuration(int64_t duration);
+
+    /**
+     * Append a decoded caption
+     *
+     * Captions must be appended in presentation order. Captions without text, e.g. clear screen,
+     * only terminate the previous caption.
+     */
+    ARIBCC_API void AppendCaption(const Caption& caption);
+
+    /**
+     * Write the pending caption and the end of the document
+     *
+     * The writer could be reused for another document afterwards.
+     */
+    ARIBCC_API void Finish();
+
+    /**
+     * Get count of cues written so far, one per caption line
+     */
+    [[nodiscard]]
+    size_t cue_count() const { return cue_count_; }
+public:
+    SubtitleWriter(const SubtitleWriter&) = delete;
+    SubtitleWriter& operator=(const SubtitleWriter&) = delete;
+private:
+    void WriteHeader(const Caption* caption);
+    void WriteCaption(const Caption& caption, int64_t end);
+    void Output();
+private:
+    SubtitleFormat format_;
+    OutputCallback output_callback_;
+    int64_t last_caption_duration_ = 1000;
+
+    bool header_written_ = false;
+    int plane_width_ = 0;
+    int plane_height_ = 0;
+
+    bool has_pending_ = false;
+    Caption pending_caption_;
+
+    size_t cue_count_ = 0;
+    std::string buffer_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_SUBTITLE_WRITER_HPP
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_TS_DEMUXER_HPP
+#define ARIBCAPTION_TS_DEMUXER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "aribcc_export.h"
+#include "caption.hpp"
+#include "context.hpp"
+
+namespace aribcaption {
+
+namespace internal { class TSDemuxerImpl; }
+
+/**
+ * Caption elementary stream announced in PMT
+ */
+struct TSCaptionStream {
+    uint16_t program_number = 0;
+    uint16_t pid = 0;
+    uint8_t component_tag = 0xFF;             ///< 0xFF if stream_identifier_descriptor not exists
+    CaptionType type = CaptionType::kCaption; ///< Pass to @Decoder::Initialize() for decoding the stream
+};
+
+/**
+ * Caption PES packet reassembled by @TSDemuxer
+ */
+struct TSCaptionPacket {
+    const TSCaptionStream* stream = nullptr;  ///< Stream which the packet belongs to
+    const uint8_t* data = nullptr;            ///< PES payload, could be passed into @Decoder::Decode() directly
+    size_t length = 0;                        ///< PES payload length
+    int64_t pts = PTS_NOPTS;                  ///< in milliseconds, PTS_NOPTS for asynchronous PES
+    uint64_t offset = 0;                      ///< Input offset of the TS packet starting the PES
+};
+
+/**
+ * Lightweight MPEG-TS demuxer extracting ARIB caption PES packets
+ *
+ * Caption streams are located through PAT / PMT: streams of stream_type 0x06 which carry
+ * a data_component_descriptor of ARIB caption (data_component_id 0x0008), or a caption component tag.
+ * Their PES packets are reassembled and passed to the packet callback, whose data could be fed
+ * into @Decoder::Decode() directly.
+ *
+ * No heap allocation happens in steady state: buffers are allocated once a caption stream is found.
+ *
+ * Thread safety: a TSDemuxer must not be used from multiple threads concurrently.
+ */
+class TSDemuxer {
+public:
+    /**
+     * Callback for receiving caption PES packets.
+     * Packet data is only valid inside the callback.
+     */
+    using PacketCallback = std::function<void(const TSCaptionPacket& packet)>;
+public:
+    /**
+     * A context is needed for constructing the TSDemuxer.
+     *
+     * The context shouldn't be destructed before any other object constructed from the context has been destructed.
+     */
+    ARIBCC_API explicit TSDemuxer(Context& context);
+    ARIBCC_API ~TSDemuxer();
+    ARIBCC_API TSDemuxer(TSDemuxer&&) noexcept;
+    ARIBCC_API TSDemuxer& operator=(TSDemuxer&&) noexcept;
+public:
+    /**
+     * Set callback for receiving caption PES packets
+     */
+    ARIBCC_API void SetPacketCallback(PacketCallback callback);
+
+    /**
+     * Select the program to demux by program_number
+     *
+     * @param program_number 0 for the first program listed in PAT, which is the default
+     */
+    ARIBCC_API void SetProgramNumber(uint16_t program_number);
+
+    /**
+     * Feed MPEG-TS data of 188-byte packets
+     *
+     * Data could be split at any position, incomplete packets are kept until the next call.
+     * Sync is recovered by skipping bytes if the data is corrupted.
+     *
+     * @param data  pointer pointed to TS data
+     * @param size  TS data size in bytes
+     */
+    ARIBCC_API void Feed(const uint8_t* data, size_t size);
+
+    /**
+     * Memory-map a whole TS file and feed it, followed by @Flush()
+     *
+     * @param filename  File path, in UTF-8
+     * @return false if the file couldn't be mapped
+     */
+    ARIBCC_API bool FeedFile(const std::string& filename);
+
+    /**
+     * Deliver PES packets which haven't been terminated, e.g. at the end of input
+     */
+    ARIBCC_API void Flush();
+
+    /**
+     * Prepare for feeding data from another position of the input, e.g. after seeking in a file
+     *
+     * Incomplete packets are dropped without being delivered, while found streams are kept,
+     * so that feeding could be resumed at a @TSCaptionPacket::offset recorded before without waiting for PAT / PMT.
+     *
+     * @param offset  Input offset of the data fed next, used for @TSCaptionPacket::offset
+     */
+    ARIBCC_API void Seek(uint64_t offset);
+
+    /**
+     * Reset all demuxer states, including found streams
+     */
+    ARIBCC_API void Reset();
+
+    /**
+     * Get caption streams found in PMT of the selected program
+     */
+    [[nodiscard]]
+    ARIBCC_API const std::vector<TSCaptionStream>& GetCaptionStreams() const;
+
+    /**
+     * Get PTS of the first video PES packet in the selected program, in milliseconds
+     *
+     * Useful as the origin of caption timestamps. PTS_NOPTS if not found yet.
+     */
+    [[nodiscard]]
+    ARIBCC_API int64_t GetFirstVideoPTS() const;
+public:
+    TSDemuxer(const TSDemuxer&) = delete;
+    TSDemuxer& operator=(const TSDemuxer&) = delete;
+private:
+    std::unique_ptr<internal::TSDemuxerImpl> pimpl_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_TS_DEMUXER_HPP
@@ -19,6 +19,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include "aribcaption/aligned_alloc.hpp"
+#include "base/memory_allocator.hpp"
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
     #include <malloc.h>
@@ -66,7 +67,7 @@ static void aligned_free_generic(void* ptr) {
 
 #endif
 
-void* AlignedAlloc(size_t size, size_t alignment) {
+void* SystemAlignedAlloc(size_t size, size_t alignment) {
     void* ptr = nullptr;
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
@@ -80,7 +81,7 @@ void* AlignedAlloc(size_t size, size_t alignment) {
     return ptr;
 }
 
-void AlignedFree(void* ptr) {
+void SystemAlignedFree(void* ptr) {
 #if defined(_MSC_VER) || defined(__MINGW32__)
     _aligned_free(ptr);
 #elif HAS_POSIX_MEMALIGN
@@ -90,4 +91,13 @@ void AlignedFree(void* ptr) {
 #endif
 }
 
+void* AlignedAlloc(size_t size, size_t alignment) {
+    size_t min_alignment = MemoryAllocator::CurrentMinAlignment();
+    return MemoryAllocator::Current().Allocate(size, alignment < min_alignment ? min_alignment : alignment);
+}
+
+void AlignedFree(void* ptr) {
+    MemoryAllocator::Free(ptr);
+}
+
 }  // namespace aribcaption
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_BINARY_IO_HPP
+#define ARIBCAPTION_BINARY_IO_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace aribcaption {
+
+// Little-endian writer for serialized formats, e.g. decoder state snapshots and caption seek indexes
+class BinaryWriter {
+public:
+    explicit BinaryWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    void WriteU8(uint8_t value) {
+        out_.push_back(value);
+    }
+
+    void WriteU16(uint16_t value) {
+        WriteLE(value, 2);
+    }
+
+    void WriteU32(uint32_t value) {
+        WriteLE(value, 4);
+    }
+
+    void WriteU64(uint64_t value) {
+        WriteLE(value, 8);
+    }
+
+    void WriteI32(int32_t value) {
+        WriteU32(static_cast<uint32_t>(value));
+    }
+
+    void WriteI64(int64_t value) {
+        WriteU64(static_cast<uint64_t>(value));
+    }
+
+    void WriteFloat(float value) {
+        uint32_t bits = 0;
+        memcpy(&bits, &value, sizeof(bits));
+        WriteU32(bits);
+    }
+
+    // LEB128 variable length unsigned integer
+    void WriteVarUInt(uint64_t value) {
+        while (value >= 0x80) {
+            out_.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out_.push_back(static_cast<uint8_t>(value));
+    }
+
+    // Zigzag encoded variable length signed integer
+    void WriteVarInt(int64_t value) {
+        WriteVarUInt((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void WriteBytes(const uint8_t* data, size_t size) {
+        out_.insert(out_.end(), data, data + size);
+    }
+
+    // Length prefixed byte string
+    void WriteString(const std::string& str) {
+        WriteVarUInt(str.size());
+        WriteBytes(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+    }
+
+    [[nodiscard]]
+    size_t position() const { return out_.size(); }
+private:
+    void WriteLE(uint64_t value, size_t bytes) {
+        for (size_t i = 0; i < bytes; i++) {
+            out_.push_back(static_cast<uint8_t>(value >> (i * 8)));
+        }
+    }
+private:
+    std::vector<uint8_t>& out_;
+};
+
+// Bounds checked reader for data written by BinaryWriter
+// Reading past the end returns zeros and marks the reader as failed, so that callers could check ok() once at last
+class BinaryReader {
+public:
+    BinaryReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    uint8_t ReadU8() {
+        return static_cast<uint8_t>(ReadLE(1));
+    }
+
+    uint16_t ReadU16() {
+        return static_cast<uint16_t>(ReadLE(2));
+    }
+
+    uint32_t ReadU32() {
+        return static_cast<uint32_t>(ReadLE(4));
+    }
+
+    uint64_t ReadU64() {
+        return ReadLE(8);
+    }
+
+    int32_t ReadI32() {
+        return static_cast<int32_t>(ReadU32());
+    }
+
+    int64_t ReadI64() {
+        return static_cast<int64_t>(ReadU64());
+    }
+
+    float ReadFloat() {
+        uint32_t bits = ReadU32();
+        float value = 0;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    uint64_t ReadVarUInt() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (!Require(1)) {
+                return 0;
+            }
+            uint8_t byte = data_[pos_++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        ok_ = false;
+        return 0;
+    }
+
+    int64_t ReadVarInt() {
+        uint64_t value = ReadVarUInt();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    // Returns a pointer into the underlying buffer, or nullptr if there aren't enough bytes
+    const uint8_t* ReadBytes(size_t size) {
+        if (!Require(size)) {
+            return nullptr;
+        }
+        const uint8_t* ptr = data_ + pos_;
+        pos_ += size;
+        return ptr;
+    }
+
+    std::string ReadString() {
+        auto size = static_cast<size_t>(ReadVarUInt());
+        const uint8_t* ptr = ReadBytes(size);
+        return ptr ? std::string(reinterpret_cast<const char*>(ptr), size) : std::string();
+    }
+
+    [[nodiscard]]
+    bool ok() const { return ok_; }
+
+    [[nodiscard]]
+    size_t position() const { return pos_; }
+
+    [[nodiscard]]
+    size_t remaining() const { return size_ - pos_; }
+private:
+    bool Require(size_t bytes) {
+        if (!ok_ || bytes > size_ - pos_) {
+            ok_ = false;
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t ReadLE(size_t bytes) {
+        if (!Require(bytes)) {
+            return 0;
+        }
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; i++) {
+            value |= static_cast<uint64_t>(data_[pos_ + i]) << (i * 8);
+        }
+        pos_ += bytes;
+        return value;
+    }
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_BINARY_IO_HPP
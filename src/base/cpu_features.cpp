@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "base/cpu_features.hpp"
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    #define ARIBCC_CPU_X86 1
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #include <immintrin.h>
+    #endif
+#endif
+
+namespace aribcaption::cpu {
+
+#if defined(ARIBCC_CPU_X86)
+
+static bool DetectAVX2() {
+#if defined(_MSC_VER)
+    int regs[4] = {0};
+    __cpuid(regs, 0);
+    if (regs[0] < 7) {
+        return false;
+    }
+
+    // OSXSAVE and AVX bits
+    __cpuid(regs, 1);
+    constexpr int kOSXSAVE = 1 << 27;
+    constexpr int kAVX = 1 << 28;
+    if ((regs[2] & (kOSXSAVE | kAVX)) != (kOSXSAVE | kAVX)) {
+        return false;
+    }
+
+    // The OS must save both XMM and YMM state on context switches
+    if ((_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+
+    __cpuidex(regs, 7, 0);
+    constexpr int kAVX2 = 1 << 5;
+    return (regs[1] & kAVX2) != 0;
+#elif defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+bool HasAVX2() {
+    static const bool has_avx2 = DetectAVX2();
+    return has_avx2;
+}
+
+#else
+
+bool HasAVX2() {
+    return false;
+}
+
+#endif  // defined(ARIBCC_CPU_X86)
+
+}  // namespace aribcaption::cpu
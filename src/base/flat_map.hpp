@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_FLAT_MAP_HPP
+#define ARIBCAPTION_FLAT_MAP_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace aribcaption {
+
+// Associative container backed by a vector sorted by key, e.g. for the decoder's DRCS tables
+//
+// Meant for small maps, which mostly hold none or a few entries: the entries live in a single contiguous
+// allocation, without the per-node allocations and hashing of std::unordered_map. clear() keeps the capacity.
+// Interface follows std::map for the commonly used subset. Insertion and erasure are O(n), invalidating
+// iterators and references. Keys must not be modified through iterators.
+template <typename Key, typename T>
+class FlatMap {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using size_type = size_t;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+public:
+    FlatMap() = default;
+    FlatMap(std::initializer_list<value_type> init) {
+        for (const value_type& value : init) {
+            insert_or_assign(value.first, value.second);
+        }
+    }
+    FlatMap(const FlatMap&) = default;
+    FlatMap(FlatMap&&) noexcept = default;
+    FlatMap& operator=(const FlatMap&) = default;
+    FlatMap& operator=(FlatMap&&) noexcept = default;
+public:
+    iterator begin() noexcept { return entries_.begin(); }
+    iterator end() noexcept { return entries_.end(); }
+    const_iterator begin() const noexcept { return entries_.begin(); }
+    const_iterator end() const noexcept { return entries_.end(); }
+    const_iterator cbegin() const noexcept { return entries_.cbegin(); }
+    const_iterator cend() const noexcept { return entries_.cend(); }
+
+    [[nodiscard]]
+    bool empty() const noexcept { return entries_.empty(); }
+    [[nodiscard]]
+    size_type size() const noexcept { return entries_.size(); }
+    [[nodiscard]]
+    size_type capacity() const noexcept { return entries_.capacity(); }
+    void reserve(size_type count) { entries_.reserve(count); }
+    void clear() noexcept { entries_.clear(); }
+    void swap(FlatMap& other) noexcept { entries_.swap(other.entries_); }
+
+    iterator lower_bound(const Key& key) {
+        return std::lower_bound(entries_.begin(), entries_.end(), key, KeyLess());
+    }
+    const_iterator lower_bound(const Key& key) const {
+        return std::lower_bound(entries_.begin(), entries_.end(), key, KeyLess());
+    }
+
+    iterator find(const Key& key) {
+        auto iter = lower_bound(key);
+        return iter != entries_.end() && iter->first == key ? iter : entries_.end();
+    }
+    const_iterator find(const Key& key) const {
+        auto iter = lower_bound(key);
+        return iter != entries_.end() && iter->first == key ? iter : entries_.end();
+    }
+    [[nodiscard]]
+    size_type count(const Key& key) const { return find(key) != entries_.end() ? 1 : 0; }
+    [[nodiscard]]
+    bool contains(const Key& key) const { return find(key) != entries_.end(); }
+
+    T& operator[](const Key& key) {
+        return try_emplace(key).first->second;
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args) {
+        auto iter = lower_bound(key);
+        if (iter != entries_.end() && iter->first == key) {
+            return {iter, false};
+        }
+        iter = entries_.emplace(iter, std::piecewise_construct,
+                                std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+        return {iter, true};
+    }
+
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const Key& key, M&& value) {
+        auto [iter, inserted] = try_emplace(key, std::forward<M>(value));
+        if (!inserted) {
+            iter->second = std::forward<M>(value);
+        }
+        return {iter, inserted};
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) {
+        return try_emplace(value.first, value.second);
+    }
+    std::pair<iterator, bool> insert(value_type&& value) {
+        return try_emplace(value.first, std::move(value.second));
+    }
+
+    template <typename M>
+    std::pair<iterator, bool> emplace(const Key& key, M&& value) {
+        return try_emplace(key, std::forward<M>(value));
+    }
+
+    iterator erase(const_iterator pos) { return entries_.erase(pos); }
+    size_type erase(const Key& key) {
+        auto iter = find(key);
+        if (iter == entries_.end()) {
+            return 0;
+        }
+        entries_.erase(iter);
+        return 1;
+    }
+
+    friend bool operator==(const FlatMap& lhs, const FlatMap& rhs) { return lhs.entries_ == rhs.entries_; }
+    friend bool operator!=(const FlatMap& lhs, const FlatMap& rhs) { return lhs.entries_ != rhs.entries_; }
+private:
+    struct KeyLess {
+        bool operator()(const value_type& entry, const Key& key) const { return entry.first < key; }
+    };
+private:
+    std::vector<value_type> entries_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_FLAT_MAP_HPP
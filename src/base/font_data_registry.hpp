@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ARIBCAPTION_FONT_DATA_REGISTRY_HPP
+#define ARIBCAPTION_FONT_DATA_REGISTRY_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace aribcaption {
+
+/**
+ * Thread-safe list of font files added through Context::AddFontData(), looked up by the memory font provider
+ */
+class FontDataRegistry {
+public:
+    using FontData = std::shared_ptr<const std::vector<uint8_t>>;
+public:
+    FontDataRegistry() = default;
+public:
+    void Add(FontData data) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fonts_.push_back(std::move(data));
+    }
+
+    [[nodiscard]]
+    std::vector<FontData> GetFonts() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return fonts_;
+    }
+public:
+    FontDataRegistry(const FontDataRegistry&) = delete;
+    FontDataRegistry& operator=(const FontDataRegistry&) = delete;
+private:
+    mutable std::mutex mutex_;
+    std::vector<FontData> fonts_;  // in the order of being added
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_FONT_DATA_REGISTRY_HPP
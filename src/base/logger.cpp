@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2022 magicxqq <xqq@xqq.im>. All rights reserved.
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
  *
  * This file is part of libaribcaption.
  *
@@ -16,69 +16,115 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <chrono>
 #include <cstdio>
 #include <cstddef>
 #include <cstdarg>
+#include <memory>
 #include <string>
 #include "base/logger.hpp"
 
 namespace aribcaption {
 
+namespace {
+
+constexpr uint64_t kRateLimitWindowMs = 1000;
+
+// Rate states of call sites are kept up to this count, states of idle windows are dropped beyond it
+constexpr size_t kMaxRateStates = 256;
+
+}  // namespace
+
 void Logger::e(const char* format, ...) {
-    if (!logcat_cb_) {
+    if (!ShouldLog(LogLevel::kError)) {
         return;
     }
-
     va_list args;
     va_start(args, format);
-    auto length = static_cast<size_t>(std::vsnprintf(nullptr, 0, format, args));
-    va_end(args);
-
-    std::string buffer(length, 0);
-
-    va_start(args, format);
-    std::vsnprintf(buffer.data(), length + 1, format, args);
+    Log(LogLevel::kError, format, args);
     va_end(args);
-
-    logcat_cb_(LogLevel::kError, buffer.c_str());
 }
 
 void Logger::w(const char* format, ...) {
-    if (!logcat_cb_) {
+    if (!ShouldLog(LogLevel::kWarning)) {
         return;
     }
-
     va_list args;
     va_start(args, format);
-    auto length = static_cast<size_t>(std::vsnprintf(nullptr, 0, format, args));
-    va_end(args);
-
-    std::string buffer(length, 0);
-
-    va_start(args, format);
-    std::vsnprintf(buffer.data(), length + 1, format, args);
+    Log(LogLevel::kWarning, format, args);
     va_end(args);
-
-    logcat_cb_(LogLevel::kWarning, buffer.c_str());
 }
 
 void Logger::v(const char* format, ...) {
-    if (!logcat_cb_) {
+    if (!ShouldLog(LogLevel::kVerbose)) {
         return;
     }
-
     va_list args;
     va_start(args, format);
-    auto length = static_cast<size_t>(std::vsnprintf(nullptr, 0, format, args));
+    Log(LogLevel::kVerbose, format, args);
     va_end(args);
+}
 
-    std::string buffer(length, 0);
+void Logger::Log(LogLevel level, const char* format, va_list args) {
+    uint32_t suppressed = 0;
+    if (level != LogLevel::kError && !PassRateLimit(format, suppressed)) {
+        return;
+    }
 
-    va_start(args, format);
+    std::shared_ptr<const LogcatCB> logcat_cb = std::atomic_load(&logcat_cb_);
+    if (!logcat_cb) {
+        return;
+    }
+
+    if (suppressed) {
+        std::string message = "Logger: " + std::to_string(suppressed) + " similar messages were suppressed";
+        (*logcat_cb)(level, message.c_str());
+    }
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+    auto length = static_cast<size_t>(std::vsnprintf(nullptr, 0, format, args_copy));
+    va_end(args_copy);
+
+    std::string buffer(length, 0);
     std::vsnprintf(buffer.data(), length + 1, format, args);
-    va_end(args);
 
-    logcat_cb_(LogLevel::kVerbose, buffer.c_str());
+    (*logcat_cb)(level, buffer.c_str());
+}
+
+bool Logger::PassRateLimit(const char* format, uint32_t& out_suppressed) {
+    uint32_t limit = rate_limit_.load(std::memory_order_relaxed);
+    if (!limit) {
+        return true;
+    }
+
+    auto now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+
+    std::lock_guard<std::mutex> lock(rate_mutex_);
+    if (rate_states_.size() >= kMaxRateStates && rate_states_.find(format) == rate_states_.end()) {
+        for (auto iter = rate_states_.begin(); iter != rate_states_.end(); ) {
+            if (now - iter->second.window_start >= kRateLimitWindowMs && !iter->second.suppressed) {
+                iter = rate_states_.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+
+    RateState& state = rate_states_[format];
+    if (now - state.window_start >= kRateLimitWindowMs) {
+        state.window_start = now;
+        state.count = 0;
+    }
+    if (state.count >= limit) {
+        state.suppressed++;
+        return false;
+    }
+    state.count++;
+    out_suppressed = state.suppressed;
+    state.suppressed = 0;
+    return true;
 }
 
 }  // namespace aribcaption
@@ -19,6 +19,12 @@
 #ifndef ARIBCAPTION_LOGGER_HPP
 #define ARIBCAPTION_LOGGER_HPP
 
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include "aribcaption/context.hpp"
 
 #if defined(__clang__) || defined(__GNUC__)
@@ -35,12 +41,41 @@
 
 namespace aribcaption {
 
+/**
+ * Thread-safe logger, messages may be logged while the callback is being replaced from another thread.
+ *
+ * The callback is swapped in as an immutable snapshot, so logging doesn't take any lock unless rate limited.
+ * A message being logged concurrently with SetCallback() may still be delivered to the previous callback.
+ *
+ * Messages above the log level, or without a callback, are dropped before being formatted.
+ * If rate limiting is enabled, warnings and verbose messages are limited per format string,
+ * i.e. per call site, and the count of suppressed ones is reported once the next one gets through.
+ */
 class Logger {
 public:
     Logger() = default;
 
     void SetCallback(const LogcatCB& logcat_cb) {
-        logcat_cb_ = logcat_cb;
+        std::shared_ptr<const LogcatCB> callback;
+        if (logcat_cb) {
+            callback = std::make_shared<const LogcatCB>(logcat_cb);
+        }
+        has_callback_.store(callback != nullptr, std::memory_order_relaxed);
+        std::atomic_store(&logcat_cb_, std::move(callback));
+    }
+
+    void SetLevel(LogLevel level) {
+        level_.store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    void SetRateLimit(uint32_t max_messages_per_second) {
+        rate_limit_.store(max_messages_per_second, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    bool ShouldLog(LogLevel level) const {
+        return has_callback_.load(std::memory_order_relaxed) &&
+               static_cast<int>(level) <= level_.load(std::memory_order_relaxed);
     }
 
     void e(MSVC_FORMAT_CHECK(const char* format), ...) ATTRIBUTE_FORMAT_PRINTF(2, 3);
@@ -52,7 +87,22 @@ public:
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
 private:
-    LogcatCB logcat_cb_;
+    void Log(LogLevel level, const char* format, va_list args);
+    bool PassRateLimit(const char* format, uint32_t& out_suppressed);
+private:
+    struct RateState {
+        uint64_t window_start = 0;  // in milliseconds
+        uint32_t count = 0;
+        uint32_t suppressed = 0;
+    };
+
+    std::shared_ptr<const LogcatCB> logcat_cb_;
+    std::atomic<bool> has_callback_{false};
+    std::atomic<int> level_{static_cast<int>(LogLevel::kVerbose)};
+    std::atomic<uint32_t> rate_limit_{0};
+
+    std::mutex rate_mutex_;
+    std::unordered_map<const char*, RateState> rate_states_;  // format string => state
 };
 
 
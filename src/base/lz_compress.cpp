@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cstring>
+#include "base/binary_io.hpp"
+#include "base/lz_compress.hpp"
+
+namespace aribcaption::lz {
+
+namespace {
+
+constexpr size_t kMinMatch = 4;
+constexpr size_t kMaxOffset = 0xFFFF;
+constexpr int kHashBits = 12;
+
+// Sequences are encoded as: token, [literal length bytes], literals, offset (u16), [match length bytes]
+// High nibble of the token is the literal length, low nibble is the match length minus kMinMatch.
+// 15 in a nibble is continued by bytes added to it, until a byte less than 255.
+// The last sequence only carries literals.
+
+uint32_t Load32(const uint8_t* ptr) {
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+uint32_t Hash(uint32_t value) {
+    return (value * 2654435761u) >> (32 - kHashBits);
+}
+
+void WriteLength(std::vector<uint8_t>& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(static_cast<uint8_t>(length));
+}
+
+void WriteSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literal_length,
+                   size_t offset, size_t match_length) {
+    size_t match_code = match_length ? match_length - kMinMatch : 0;
+    uint8_t token = static_cast<uint8_t>((literal_length < 15 ? literal_length : 15) << 4 |
+                                         (match_code < 15 ? match_code : 15));
+    out.push_back(token);
+    if (literal_length >= 15) {
+        WriteLength(out, literal_length - 15);
+    }
+    out.insert(out.end(), literals, literals + literal_length);
+    if (!match_length) {
+        return;
+    }
+    out.push_back(static_cast<uint8_t>(offset));
+    out.push_back(static_cast<uint8_t>(offset >> 8));
+    if (match_code >= 15) {
+        WriteLength(out, match_code - 15);
+    }
+}
+
+bool ReadLength(const uint8_t*& ptr, const uint8_t* end, size_t& length) {
+    uint8_t byte;
+    do {
+        if (ptr == end) {
+            return false;
+        }
+        byte = *ptr++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+}  // namespace
+
+void Compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out_data) {
+    out_data.clear();
+    out_data.reserve(size / 2 + 16);
+    BinaryWriter writer(out_data);
+    writer.WriteVarUInt(size);
+
+    uint32_t table[1 << kHashBits] = {};  // Position + 1, 0 if empty
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (size >= kMinMatch && pos <= size - kMinMatch) {
+        uint32_t sequence = Load32(data + pos);
+        uint32_t hash = Hash(sequence);
+        size_t candidate = table[hash];
+        table[hash] = static_cast<uint32_t>(pos + 1);
+
+        if (!candidate || pos - (candidate - 1) > kMaxOffset || Load32(data + candidate - 1) != sequence) {
+            pos++;
+            continue;
+        }
+        size_t match = candidate - 1;
+        size_t length = kMinMatch;
+        while (pos + length < size && data[match + length] == data[pos + length]) {
+            length++;
+        }
+        WriteSequence(out_data, data + anchor, pos - anchor, pos - match, length);
+        pos += length;
+        anchor = pos;
+    }
+    WriteSequence(out_data, data + anchor, size - anchor, 0, 0);
+}
+
+bool Decompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out_data) {
+    BinaryReader reader(data, size);
+    uint64_t raw_size = reader.ReadVarUInt();
+    // Each compressed byte expands to less than 255 * 2 bytes
+    if (!reader.ok() || raw_size > size * 510) {
+        return false;
+    }
+
+    out_data.clear();
+    out_data.reserve(static_cast<size_t>(raw_size));
+    const uint8_t* ptr = data + reader.position();
+    const uint8_t* end = data + size;
+    while (ptr < end) {
+        uint8_t token = *ptr++;
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !ReadLength(ptr, end, literal_length)) {
+            return false;
+        }
+        if (literal_length > static_cast<size_t>(end - ptr)) {
+            return false;
+        }
+        out_data.insert(out_data.end(), ptr, ptr + literal_length);
+        ptr += literal_length;
+        if (ptr == end) {
+            break;  // Last sequence
+        }
+
+        if (end - ptr < 2) {
+            return false;
+        }
+        size_t offset = ptr[0] | static_cast<size_t>(ptr[1]) << 8;
+        ptr += 2;
+        size_t match_length = token & 0x0F;
+        if (match_length == 15 && !ReadLength(ptr, end, match_length)) {
+            return false;
+        }
+        match_length += kMinMatch;
+        if (offset == 0 || offset > out_data.size() || out_data.size() + match_length > raw_size) {
+            return false;
+        }
+        // Matches may overlap with the bytes being copied
+        size_t match = out_data.size() - offset;
+        for (size_t i = 0; i < match_length; i++) {
+            out_data.push_back(out_data[match + i]);
+        }
+    }
+
+    return out_data.size() == raw_size;
+}
+
+}  // namespace aribcaption::lz
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_LZ_COMPRESS_HPP
+#define ARIBCAPTION_LZ_COMPRESS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace aribcaption::lz {
+
+// Byte oriented LZ77 compression in the style of LZ4 block format, used for cold caption storage.
+// Compressed data is prefixed by the uncompressed size, and is only expected to be read back by Decompress().
+void Compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out_data);
+
+// Returns false if the compressed data is corrupted
+bool Decompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out_data);
+
+}  // namespace aribcaption::lz
+
+#endif  // ARIBCAPTION_LZ_COMPRESS_HPP
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_MAPPED_FILE_HPP
+#define ARIBCAPTION_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace aribcaption {
+
+/**
+ * Read-only memory mapping of a whole file, backed by mmap() or CreateFileMapping()
+ *
+ * Pages are loaded on demand and shared between every mapping of the same file in the system.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+public:
+    /**
+     * Map the file into memory, previous mapping will be closed
+     *
+     * @param filename  File path, in UTF-8
+     * @return true on success
+     */
+    bool Open(const std::string& filename);
+    void Close();
+
+    [[nodiscard]]
+    bool IsOpen() const { return data_ != nullptr; }
+
+    [[nodiscard]]
+    const uint8_t* data() const { return data_; }
+
+    [[nodiscard]]
+    size_t size() const { return size_; }
+public:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#if defined(_WIN32)
+    void* mapping_ = nullptr;  // HANDLE of the file mapping object
+#endif
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_MAPPED_FILE_HPP
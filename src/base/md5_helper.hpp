@@ -19,15 +19,17 @@
 #ifndef ARIBCAPTION_MD5_HELPER_HPP
 #define ARIBCAPTION_MD5_HELPER_HPP
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <cstdio>
-#include <vector>
 #include <string>
 #include "base/md5.h"
 
 namespace aribcaption::md5 {
 
-inline std::string GetDigest(const uint8_t* buffer, size_t length) {
+using Digest = std::array<uint8_t, 16>;
+
+inline Digest GetDigestBytes(const uint8_t* buffer, size_t length) {
     const uint8_t* ptr = buffer;
     MD5_CTX ctx;
     MD5_Init(&ctx);
@@ -44,17 +46,40 @@ inline std::string GetDigest(const uint8_t* buffer, size_t length) {
         }
     }
 
-    std::vector<uint8_t> digest(16, 0);
-    MD5_Final(&digest[0], &ctx);
+    Digest digest{};
+    MD5_Final(digest.data(), &ctx);
+    return digest;
+}
+
+inline std::string DigestToString(const Digest& digest) {
+    constexpr char hex[] = "0123456789abcdef";
 
     std::string digest_str(32, '\0');
     for (size_t i = 0; i < 16; i++) {
-        snprintf(&digest_str[i * 2], 16 * 2, "%02x", static_cast<uint32_t>(digest[i]));
+        digest_str[i * 2] = hex[digest[i] >> 4];
+        digest_str[i * 2 + 1] = hex[digest[i] & 0x0F];
     }
 
     return digest_str;
 }
 
+inline std::string GetDigest(const uint8_t* buffer, size_t length) {
+    return DigestToString(GetDigestBytes(buffer, length));
+}
+
+// Parse 32-char lowercase hex digest string, usable at compile time
+constexpr Digest ParseDigest(const char* digest_str) {
+    auto nibble = [](char c) -> uint8_t {
+        return static_cast<uint8_t>(c >= 'a' ? c - 'a' + 10 : c - '0');
+    };
+
+    Digest digest{};
+    for (size_t i = 0; i < 16; i++) {
+        digest[i] = static_cast<uint8_t>(nibble(digest_str[i * 2]) << 4 | nibble(digest_str[i * 2 + 1]));
+    }
+    return digest;
+}
+
 }  // namespace aribcaption::md5
 
 #endif  // ARIBCAPTION_MD5_HELPER_HPP
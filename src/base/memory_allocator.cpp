@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <cstdint>
+#include <cstring>
+#include "base/memory_allocator.hpp"
+
+namespace aribcaption {
+
+namespace {
+
+// Stored right in front of the pointer handed out
+struct BlockHeader {
+    void (*free)(void* opaque, void* ptr);  // null for blocks from the system heap
+    void* opaque;
+    void* block;                            // start of the underlying allocation
+};
+
+const MemoryAllocator kSystemAllocator;
+
+}  // namespace
+
+thread_local const MemoryAllocator* MemoryAllocator::current_ = nullptr;
+thread_local size_t MemoryAllocator::current_min_alignment_ = 0;
+
+MemoryAllocator::MemoryAllocator(const AllocatorCallbacks& callbacks) : callbacks_(callbacks) {}
+
+void* MemoryAllocator::Allocate(size_t size, size_t alignment) const {
+    if (alignment < alignof(BlockHeader)) {
+        alignment = alignof(BlockHeader);
+    }
+    // Header padded up to alignment, so that an aligned block stays aligned after it
+    size_t header_size = (sizeof(BlockHeader) + alignment - 1) & ~(alignment - 1);
+    if (size > SIZE_MAX - header_size - alignment) {
+        return nullptr;
+    }
+
+    void* block = nullptr;
+    if (!callbacks_.alloc) {
+        block = SystemAlignedAlloc(header_size + size, alignment);
+    } else if (callbacks_.aligned_alloc) {
+        block = callbacks_.aligned_alloc(callbacks_.opaque, header_size + size, alignment);
+    } else {
+        block = callbacks_.alloc(callbacks_.opaque, sizeof(BlockHeader) + (alignment - 1) + size);
+    }
+    if (!block) {
+        return nullptr;
+    }
+
+    uintptr_t aligned = reinterpret_cast<uintptr_t>(block) + sizeof(BlockHeader);
+    aligned = (aligned + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+
+    BlockHeader header{};
+    header.free = callbacks_.alloc ? callbacks_.free : nullptr;
+    header.opaque = callbacks_.opaque;
+    header.block = block;
+    memcpy(reinterpret_cast<uint8_t*>(aligned) - sizeof(BlockHeader), &header, sizeof(header));
+
+    return reinterpret_cast<void*>(aligned);
+}
+
+void* MemoryAllocator::AllocateZeroed(size_t size, size_t alignment) const {
+    void* ptr = Allocate(size, alignment);
+    if (ptr) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+void MemoryAllocator::Free(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    BlockHeader header{};
+    memcpy(&header, static_cast<uint8_t*>(ptr) - sizeof(BlockHeader), sizeof(header));
+    if (header.free) {
+        header.free(header.opaque, header.block);
+    } else {
+        SystemAlignedFree(header.block);
+    }
+}
+
+const MemoryAllocator& MemoryAllocator::Current() {
+    return current_ ? *current_ : kSystemAllocator;
+}
+
+}  // namespace aribcaption
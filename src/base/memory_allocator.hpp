@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ARIBCAPTION_MEMORY_ALLOCATOR_HPP
+#define ARIBCAPTION_MEMORY_ALLOCATOR_HPP
+
+#include <cstddef>
+#include "aribcaption/context.hpp"
+
+namespace aribcaption {
+
+// Platform aligned allocation, implemented in aligned_alloc.cpp
+void* SystemAlignedAlloc(size_t size, size_t alignment);
+void SystemAlignedFree(void* ptr);
+
+/**
+ * Allocator of a Context, forwarding into the callbacks indicated by Context::SetAllocator()
+ *
+ * Every block carries a small header in front of the returned pointer, recording how it should be released.
+ * So Free() releases blocks of any allocator, without the allocator (or its Context) being alive.
+ *
+ * Immutable after construction, thus thread-safe.
+ */
+class MemoryAllocator {
+public:
+    static constexpr size_t kDefaultAlignment = alignof(std::max_align_t);
+public:
+    // Allocates from the system heap
+    MemoryAllocator() = default;
+    explicit MemoryAllocator(const AllocatorCallbacks& callbacks);
+public:
+    // alignment must be a power of two, returns nullptr on failure
+    [[nodiscard]]
+    void* Allocate(size_t size, size_t alignment = kDefaultAlignment) const;
+
+    // Same as Allocate(), with memory cleared
+    [[nodiscard]]
+    void* AllocateZeroed(size_t size, size_t alignment = kDefaultAlignment) const;
+
+    // Release a block returned by Allocate() or AllocateZeroed() of any allocator, ptr may be null
+    static void Free(void* ptr);
+
+    // Allocator used by AlignedAlloc() on the calling thread, see ScopedMemoryAllocator
+    [[nodiscard]]
+    static const MemoryAllocator& Current();
+
+    // Alignment AlignedAlloc() raises requests to on the calling thread, see ScopedMemoryAllocator
+    [[nodiscard]]
+    static size_t CurrentMinAlignment() {
+        return current_min_alignment_;
+    }
+public:
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+private:
+    AllocatorCallbacks callbacks_;
+private:
+    friend class ScopedMemoryAllocator;
+    static thread_local const MemoryAllocator* current_;
+    static thread_local size_t current_min_alignment_;
+};
+
+/**
+ * Route AlignedAlloc() on the calling thread into allocator within the scope, e.g. for growing pixel buffers
+ *
+ * Allocator may be null, which keeps the current one. Allocations are also aligned to at least min_alignment,
+ * which must be a power of two.
+ */
+class ScopedMemoryAllocator {
+public:
+    explicit ScopedMemoryAllocator(const MemoryAllocator* allocator, size_t min_alignment = 0)
+        : previous_(MemoryAllocator::current_), previous_min_alignment_(MemoryAllocator::current_min_alignment_) {
+        if (allocator) {
+            MemoryAllocator::current_ = allocator;
+        }
+        if (min_alignment > MemoryAllocator::current_min_alignment_) {
+            MemoryAllocator::current_min_alignment_ = min_alignment;
+        }
+    }
+
+    ~ScopedMemoryAllocator() {
+        MemoryAllocator::current_ = previous_;
+        MemoryAllocator::current_min_alignment_ = previous_min_alignment_;
+    }
+public:
+    ScopedMemoryAllocator(const ScopedMemoryAllocator&) = delete;
+    ScopedMemoryAllocator& operator=(const ScopedMemoryAllocator&) = delete;
+private:
+    const MemoryAllocator* previous_;
+    size_t previous_min_alignment_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_MEMORY_ALLOCATOR_HPP
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_MEMORY_TRIM_REGISTRY_HPP
+#define ARIBCAPTION_MEMORY_TRIM_REGISTRY_HPP
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "aribcaption/context.hpp"
+
+namespace aribcaption {
+
+/**
+ * Thread-safe list of the objects of a context to be notified by Context::TrimMemory()
+ *
+ * Listeners are called with the registry locked, so Remove() guarantees that the listener is no longer running.
+ */
+class MemoryTrimRegistry {
+public:
+    using Listener = std::function<void(MemoryTrimLevel level)>;
+public:
+    MemoryTrimRegistry() = default;
+public:
+    uint64_t Add(Listener listener) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t id = next_id_++;
+        listeners_.emplace_back(id, std::move(listener));
+        return id;
+    }
+
+    void Remove(uint64_t id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto iter = listeners_.begin(); iter != listeners_.end(); ++iter) {
+            if (iter->first == id) {
+                listeners_.erase(iter);
+                return;
+            }
+        }
+    }
+
+    void Trim(MemoryTrimLevel level) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& [id, listener] : listeners_) {
+            listener(level);
+        }
+    }
+public:
+    MemoryTrimRegistry(const MemoryTrimRegistry&) = delete;
+    MemoryTrimRegistry& operator=(const MemoryTrimRegistry&) = delete;
+private:
+    std::mutex mutex_;
+    uint64_t next_id_ = 1;
+    std::vector<std::pair<uint64_t, Listener>> listeners_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_MEMORY_TRIM_REGISTRY_HPP
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <chrono>
+#include <limits>
+#include "base/metrics.hpp"
+
+namespace aribcaption {
+
+namespace {
+
+size_t BucketIndex(uint64_t value) {
+    size_t bits = 0;
+    while (value) {
+        bits++;
+        value >>= 1;
+    }
+    return bits < kMetricHistogramBuckets ? bits : kMetricHistogramBuckets - 1;
+}
+
+}  // namespace
+
+Metrics::Metrics() {
+    Reset();
+}
+
+void Metrics::RecordValue(Histogram& histogram, uint64_t value) {
+    histogram.count.fetch_add(1, std::memory_order_relaxed);
+    histogram.sum.fetch_add(value, std::memory_order_relaxed);
+    histogram.buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t min = histogram.min.load(std::memory_order_relaxed);
+    while (value < min && !histogram.min.compare_exchange_weak(min, value, std::memory_order_relaxed)) {}
+    uint64_t max = histogram.max.load(std::memory_order_relaxed);
+    while (value > max && !histogram.max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+}
+
+void Metrics::Snapshot(MetricsSnapshot& out_metrics) const {
+    for (size_t i = 0; i < static_cast<size_t>(MetricCounter::kCount); i++) {
+        out_metrics.counters[i] = counters_[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < static_cast<size_t>(MetricHistogram::kCount); i++) {
+        const Histogram& histogram = histograms_[i];
+        MetricHistogramSnapshot& snapshot = out_metrics.histograms[i];
+        snapshot.count = histogram.count.load(std::memory_order_relaxed);
+        snapshot.sum = histogram.sum.load(std::memory_order_relaxed);
+        snapshot.min = snapshot.count ? histogram.min.load(std::memory_order_relaxed) : 0;
+        snapshot.max = histogram.max.load(std::memory_order_relaxed);
+        for (size_t j = 0; j < kMetricHistogramBuckets; j++) {
+            snapshot.buckets[j] = histogram.buckets[j].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Metrics::Reset() {
+    for (std::atomic<uint64_t>& counter : counters_) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (Histogram& histogram : histograms_) {
+        histogram.count.store(0, std::memory_order_relaxed);
+        histogram.sum.store(0, std::memory_order_relaxed);
+        histogram.min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+        histogram.max.store(0, std::memory_order_relaxed);
+        for (std::atomic<uint64_t>& bucket : histogram.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t Metrics::NowMicroseconds() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_METRICS_HPP
+#define ARIBCAPTION_METRICS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "aribcaption/context.hpp"
+
+namespace aribcaption {
+
+/**
+ * Lock-free metrics shared by objects constructed from the same Context
+ *
+ * Add() and Record() do nothing but test a flag if disabled, so they may be called unconditionally.
+ * Values are updated with relaxed atomics, a snapshot taken concurrently may be slightly inconsistent.
+ */
+class Metrics {
+public:
+    Metrics();
+public:
+    [[nodiscard]]
+    bool enabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void SetEnabled(bool enabled) {
+        enabled_.store(enabled, std::memory_order_relaxed);
+    }
+
+    void Add(MetricCounter counter, uint64_t value = 1) {
+        if (enabled()) {
+            counters_[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+        }
+    }
+
+    void Record(MetricHistogram histogram, uint64_t value) {
+        if (enabled()) {
+            RecordValue(histograms_[static_cast<size_t>(histogram)], value);
+        }
+    }
+
+    void Snapshot(MetricsSnapshot& out_metrics) const;
+    void Reset();
+
+    // Monotonic time for measuring durations
+    static uint64_t NowMicroseconds();
+public:
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+private:
+    struct Histogram {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> min;
+        std::atomic<uint64_t> max;
+        std::atomic<uint64_t> buckets[kMetricHistogramBuckets];
+    };
+
+    static void RecordValue(Histogram& histogram, uint64_t value);
+private:
+    std::atomic<bool> enabled_{false};
+    std::atomic<uint64_t> counters_[static_cast<size_t>(MetricCounter::kCount)];
+    Histogram histograms_[static_cast<size_t>(MetricHistogram::kCount)];
+};
+
+/**
+ * Measure the lifetime of the scope into a histogram, the clock isn't read if metrics are disabled
+ */
+class ScopedMetricTimer {
+public:
+    ScopedMetricTimer(Metrics* metrics, MetricHistogram histogram)
+        : metrics_(metrics && metrics->enabled() ? metrics : nullptr),
+          histogram_(histogram),
+          start_(metrics_ ? Metrics::NowMicroseconds() : 0) {}
+
+    ~ScopedMetricTimer() {
+        if (metrics_) {
+            metrics_->Record(histogram_, Metrics::NowMicroseconds() - start_);
+        }
+    }
+public:
+    ScopedMetricTimer(const ScopedMetricTimer&) = delete;
+    ScopedMetricTimer& operator=(const ScopedMetricTimer&) = delete;
+private:
+    Metrics* metrics_;
+    MetricHistogram histogram_;
+    uint64_t start_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_METRICS_HPP
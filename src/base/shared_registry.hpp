@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_SHARED_REGISTRY_HPP
+#define ARIBCAPTION_SHARED_REGISTRY_HPP
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "aribcaption/context.hpp"
+
+namespace aribcaption {
+
+/**
+ * Thread-safe registry of objects shared between instances constructed from the same Context,
+ * e.g. font faces and font data loaded by multiple renderers.
+ *
+ * Entries are held weakly, an object is released once its last user drops the reference.
+ * Keys should be prefixed by the owner module to avoid collisions between different object types.
+ *
+ * Lookups are read-copy-update: readers search an immutable snapshot of the entries without locking,
+ * writers serialize on a mutex, copy the snapshot, modify and publish it.
+ */
+class SharedRegistry {
+public:
+    SharedRegistry() = default;
+public:
+    /**
+     * Get the object registered by key, or create and register one through factory if not exists
+     *
+     * Factory is called with the registry locked, so it must not access the registry itself.
+     * If factory returns nullptr, nothing is registered and nullptr is returned.
+     */
+    template <class T, class Factory>
+    std::shared_ptr<T> GetOrCreate(const std::string& key, Factory&& factory) {
+        if (std::shared_ptr<T> entry = Find<T>(std::atomic_load(&entries_), key)) {
+            return entry;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // Another thread may have created the entry before we acquired the lock
+        std::shared_ptr<const EntryMap> entries = std::atomic_load(&entries_);
+        if (std::shared_ptr<T> entry = Find<T>(entries, key)) {
+            return entry;
+        }
+
+        std::shared_ptr<T> entry = std::forward<Factory>(factory)();
+        if (!entry) {
+            return nullptr;
+        }
+
+        // Copy without expired entries
+        auto new_entries = std::make_shared<EntryMap>();
+        if (entries) {
+            for (const auto& [entry_key, weak_entry] : *entries) {
+                if (!weak_entry.expired()) {
+                    new_entries->emplace(entry_key, weak_entry);
+                }
+            }
+        }
+        new_entries->insert_or_assign(key, std::weak_ptr<void>(entry));
+
+        std::atomic_store(&entries_, std::shared_ptr<const EntryMap>(std::move(new_entries)));
+        return entry;
+    }
+public:
+    SharedRegistry(const SharedRegistry&) = delete;
+    SharedRegistry& operator=(const SharedRegistry&) = delete;
+private:
+    using EntryMap = std::unordered_map<std::string, std::weak_ptr<void>>;
+
+    template <class T>
+    static std::shared_ptr<T> Find(const std::shared_ptr<const EntryMap>& entries, const std::string& key) {
+        if (!entries) {
+            return nullptr;
+        }
+        auto iter = entries->find(key);
+        if (iter == entries->end()) {
+            return nullptr;
+        }
+        return std::static_pointer_cast<T>(iter->second.lock());
+    }
+private:
+    std::mutex mutex_;  // Serializes writers
+    std::shared_ptr<const EntryMap> entries_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_SHARED_REGISTRY_HPP
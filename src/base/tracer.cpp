@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include "base/metrics.hpp"
+#include "base/tracer.hpp"
+
+namespace aribcaption {
+
+void Tracer::SetCallback(const TraceCB& trace_cb) {
+    std::shared_ptr<const TraceCB> callback;
+    if (trace_cb) {
+        callback = std::make_shared<const TraceCB>(trace_cb);
+    }
+    std::atomic_store(&trace_cb_, std::move(callback));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    UpdateEnabled();
+}
+
+void Tracer::SetBufferSize(size_t max_events) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer_.clear();
+    buffer_.shrink_to_fit();
+    buffer_.reserve(max_events);
+    buffer_size_ = max_events;
+    buffer_next_ = 0;
+    UpdateEnabled();
+}
+
+void Tracer::UpdateEnabled() {
+    enabled_.store(buffer_size_ || std::atomic_load(&trace_cb_), std::memory_order_relaxed);
+}
+
+void Tracer::Emit(const char* category, const char* name, uint64_t timestamp, uint64_t duration) {
+    TraceEvent event;
+    event.name = name;
+    event.category = category;
+    event.timestamp = timestamp;
+    event.duration = duration;
+    event.thread_id = CurrentThreadId();
+
+    if (std::shared_ptr<const TraceCB> callback = std::atomic_load(&trace_cb_)) {
+        (*callback)(event);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!buffer_size_) {
+        return;
+    }
+    if (buffer_.size() < buffer_size_) {
+        buffer_.push_back(event);
+    } else {
+        // Overwrite the oldest one
+        buffer_[buffer_next_] = event;
+        buffer_next_ = (buffer_next_ + 1) % buffer_size_;
+    }
+}
+
+void Tracer::DumpJSON(std::string& out_json) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out_json = "{\"traceEvents\":[";
+    char buf[128];
+    for (size_t i = 0; i < buffer_.size(); i++) {
+        // Oldest first
+        const TraceEvent& event = buffer_[(buffer_next_ + i) % buffer_.size()];
+        if (i) {
+            out_json += ',';
+        }
+        // Names and categories are string literals which need no escaping
+        out_json += "{\"name\":\"";
+        out_json += event.name;
+        out_json += "\",\"cat\":\"";
+        out_json += event.category;
+        snprintf(buf, sizeof(buf), "\",\"ph\":\"X\",\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 ",\"pid\":1,\"tid\":%" PRIu32 "}",
+                 event.timestamp, event.duration, event.thread_id);
+        out_json += buf;
+    }
+    out_json += "],\"displayTimeUnit\":\"ms\"}";
+}
+
+uint32_t Tracer::CurrentThreadId() {
+    static std::atomic<uint32_t> next_thread_id{1};
+    thread_local uint32_t thread_id = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+    return thread_id;
+}
+
+TraceScope::TraceScope(Tracer* tracer, const char* category, const char* name, bool sampled)
+    : tracer_(sampled && tracer && tracer->enabled() ? tracer : nullptr), category_(category), name_(name) {
+    if (tracer_) {
+        start_ = Metrics::NowMicroseconds();
+    }
+}
+
+TraceScope::~TraceScope() {
+    if (tracer_) {
+        tracer_->Emit(category_, name_, start_, Metrics::NowMicroseconds() - start_);
+    }
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_TRACER_HPP
+#define ARIBCAPTION_TRACER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcc_config.h"
+
+namespace aribcaption {
+
+/**
+ * Collects trace events emitted by objects constructed from the same Context
+ *
+ * Events are passed to the callback on the emitting thread, and/or recorded into a ring buffer
+ * which could be dumped in Chrome trace event format (loadable by Perfetto UI and chrome://tracing).
+ */
+class Tracer {
+public:
+    Tracer() = default;
+public:
+    [[nodiscard]]
+    bool enabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void SetCallback(const TraceCB& trace_cb);
+    void SetBufferSize(size_t max_events);
+    void DumpJSON(std::string& out_json);
+
+    void Emit(const char* category, const char* name, uint64_t timestamp, uint64_t duration);
+
+    // Returns true every interval calls, for sampling frequent scopes
+    bool Sample(uint32_t interval) {
+        return sample_counter_.fetch_add(1, std::memory_order_relaxed) % interval == 0;
+    }
+
+    static uint32_t CurrentThreadId();
+public:
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+private:
+    void UpdateEnabled();  // requires mutex_ held
+private:
+    std::atomic<bool> enabled_{false};
+    std::atomic<uint32_t> sample_counter_{0};
+    std::shared_ptr<const TraceCB> trace_cb_;
+
+    std::mutex mutex_;  // Guards the ring buffer
+    std::vector<TraceEvent> buffer_;
+    size_t buffer_size_ = 0;
+    size_t buffer_next_ = 0;  // Index to be written next, once buffer_ is full
+};
+
+/**
+ * Emit a complete event spanning the lifetime of the scope, if the tracer is enabled
+ */
+class TraceScope {
+public:
+    TraceScope(Tracer* tracer, const char* category, const char* name, bool sampled = true);
+    ~TraceScope();
+public:
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+private:
+    Tracer* tracer_;
+    const char* category_;
+    const char* name_;
+    uint64_t start_ = 0;
+};
+
+}  // namespace aribcaption
+
+#define ARIBCC_TRACE_CONCAT_INNER(a, b) a##b
+#define ARIBCC_TRACE_CONCAT(a, b) ARIBCC_TRACE_CONCAT_INNER(a, b)
+
+// Trace scopes are only compiled with -DARIBCC_ENABLE_TRACING:BOOL=ON
+#ifdef ARIBCC_ENABLE_TRACING
+    #define ARIBCC_TRACE_SCOPE(tracer, category, name) \
+        ::aribcaption::TraceScope ARIBCC_TRACE_CONCAT(trace_scope_, __LINE__)((tracer), (category), (name))
+    #define ARIBCC_TRACE_SCOPE_SAMPLED(tracer, category, name, interval)                            \
+        ::aribcaption::TraceScope ARIBCC_TRACE_CONCAT(trace_scope_, __LINE__)(                      \
+            (tracer), (category), (name), (tracer) && (tracer)->enabled() && (tracer)->Sample(interval))
+#else
+    #define ARIBCC_TRACE_SCOPE(tracer, category, name) ((void)0)
+    #define ARIBCC_TRACE_SCOPE_SAMPLED(tracer, category, name, interval) ((void)0)
+#endif
+
+#endif  // ARIBCAPTION_TRACER_HPP
@@ -19,6 +19,7 @@
 #ifndef ARIBCAPTION_UTF_HELPER_HPP
 #define ARIBCAPTION_UTF_HELPER_HPP
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <string>
@@ -82,6 +83,49 @@ inline size_t UTF8AppendCodePoint(char* buf, uint32_t ucs4) {
     return bytes;
 }
 
+// Pre-encoded UTF-8 sequence, zero-padded so it could be copied into CaptionChar::u8str directly
+struct UTF8Char {
+    char bytes[7] = {0};
+    uint8_t length = 0;
+};
+
+constexpr UTF8Char EncodeUTF8(uint32_t ucs4) {
+    UTF8Char u8;
+
+    if (ucs4 < 0x80) {
+        u8.bytes[0] = static_cast<char>(ucs4);
+        u8.length = 1;
+    } else if (ucs4 < 0x800) {
+        u8.bytes[0] = static_cast<char>(0xC0 | (ucs4 >> 6));    // 110xxxxx
+        u8.bytes[1] = static_cast<char>(0x80 | (ucs4 & 0x3F));  // 10xxxxxx
+        u8.length = 2;
+    } else if (ucs4 < 0x10000) {
+        u8.bytes[0] = static_cast<char>(0xE0 | (ucs4 >> 12));          // 1110xxxx
+        u8.bytes[1] = static_cast<char>(0x80 | ((ucs4 >> 6) & 0x3F));  // 10xxxxxx
+        u8.bytes[2] = static_cast<char>(0x80 | (ucs4 & 0x3F));         // 10xxxxxx
+        u8.length = 3;
+    } else if (ucs4 < 0x110000) {
+        u8.bytes[0] = static_cast<char>(0xF0 | (ucs4 >> 18));          // 11110xxx
+        u8.bytes[1] = static_cast<char>(0x80 | ((ucs4 >> 12) & 0x3F)); // 10xxxxxx
+        u8.bytes[2] = static_cast<char>(0x80 | ((ucs4 >> 6) & 0x3F));  // 10xxxxxx
+        u8.bytes[3] = static_cast<char>(0x80 | (ucs4 & 0x3F));         // 10xxxxxx
+        u8.length = 4;
+    }
+
+    // Invalid ucs4 results in an empty sequence
+    return u8;
+}
+
+// Encode a whole codepoint table into UTF-8 at compile time
+template <size_t N>
+constexpr std::array<UTF8Char, N> EncodeUTF8Table(const uint32_t (&table)[N]) {
+    std::array<UTF8Char, N> u8table{};
+    for (size_t i = 0; i < N; i++) {
+        u8table[i] = EncodeUTF8(table[i]);
+    }
+    return u8table;
+}
+
 inline bool IsUTF16Surrogate(uint16_t u16) {
     return (u16 & 0xF800) == 0xD800;
 }
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cstring>
+#include "aribcaption/caption.hpp"
+#include "base/utf_helper.hpp"
+
+namespace aribcaption {
+
+void CaptionChar::UpdateU8Str() {
+    memset(u8str, 0, sizeof(u8str));
+    if (type != CaptionCharType::kDRCS) {
+        utf::UTF8Char u8char = utf::EncodeUTF8(codepoint);
+        memcpy(u8str, u8char.bytes, u8char.length);
+    }
+}
+
+void Caption::UpdateText() {
+    text.clear();
+
+    bool has_prev_row = false;
+    int prev_y = 0;
+    for (const CaptionRegion& region : regions) {
+        if (region.is_ruby) {
+            continue;
+        }
+        for (const CaptionChar& ch : region.chars) {
+            if (has_prev_row && ch.y != prev_y) {
+                utf::UTF8AppendCodePoint(text, 0x000A);  // \n
+            }
+            has_prev_row = true;
+            prev_y = ch.y;
+
+            if (ch.type == CaptionCharType::kDRCS) {
+                utf::UTF8AppendCodePoint(text, 0x3013);  // Geta Mark
+            } else {
+                utf::UTF8AppendCodePoint(text, ch.codepoint);
+            }
+        }
+    }
+}
+
+}  // namespace aribcaption
@@ -21,6 +21,7 @@
 #include <cstring>
 #include "aribcaption/caption.h"
 #include "aribcaption/caption.hpp"
+#include "base/memory_allocator.hpp"
 #include "base/utf_helper.hpp"
 
 using namespace aribcaption;
@@ -122,28 +123,28 @@ const char* aribcc_drcs_get_alternative_text(aribcc_drcs_t* drcs) {
 
 // aribcc_drcsmap_t related function implementations
 aribcc_drcsmap_t* aribcc_drcsmap_alloc() {
-    auto map = new(std::nothrow) std::unordered_map<uint32_t, DRCS>();
+    auto map = new(std::nothrow) DRCSMap();
     return reinterpret_cast<aribcc_drcsmap_t*>(map);
 }
 
 void aribcc_drcsmap_free(aribcc_drcsmap_t* drcs_map) {
-    auto map = reinterpret_cast<std::unordered_map<uint32_t, DRCS>*>(drcs_map);
+    auto map = reinterpret_cast<DRCSMap*>(drcs_map);
     delete map;
 }
 
 void aribcc_drcsmap_erase(aribcc_drcsmap_t* drcs_map, uint32_t key) {
-    auto map = reinterpret_cast<std::unordered_map<uint32_t, DRCS>*>(drcs_map);
+    auto map = reinterpret_cast<DRCSMap*>(drcs_map);
     map->erase(key);
 }
 
 void aribcc_drcsmap_put(aribcc_drcsmap_t* drcs_map, uint32_t key, const aribcc_drcs_t* drcs) {
-    auto map = reinterpret_cast<std::unordered_map<uint32_t, DRCS>*>(drcs_map);
+    auto map = reinterpret_cast<DRCSMap*>(drcs_map);
     auto drcspp = reinterpret_cast<const DRCS*>(drcs);
     map->insert_or_assign(key, *drcspp);
 }
 
 aribcc_drcs_t* aribcc_drcsmap_get(aribcc_drcsmap_t* drcs_map, uint32_t key) {
-    auto map = reinterpret_cast<std::unordered_map<uint32_t, DRCS>*>(drcs_map);
+    auto map = reinterpret_cast<DRCSMap*>(drcs_map);
     auto iter = map->find(key);
     if (iter != map->end()) {
         return reinterpret_cast<aribcc_drcs_t*>(&iter->second);
@@ -152,7 +153,7 @@ aribcc_drcs_t* aribcc_drcsmap_get(aribcc_drcsmap_t* drcs_map, uint32_t key) {
 }
 
 void aribcc_drcsmap_clear(aribcc_drcsmap_t* drcs_map) {
-    auto map = reinterpret_cast<std::unordered_map<uint32_t, DRCS>*>(drcs_map);
+    auto map = reinterpret_cast<DRCSMap*>(drcs_map);
     map->clear();
 }
 
@@ -160,7 +161,7 @@ void aribcc_drcsmap_clear(aribcc_drcsmap_t* drcs_map) {
 // aribcc_caption_region_t related function implementations
 void aribcc_caption_region_cleanup(aribcc_caption_region_t* region) {
     if (region->chars) {
-        free(region->chars);
+        MemoryAllocator::Free(region->chars);
         region->chars = nullptr;
         region->char_count = 0;
     }
@@ -170,7 +171,7 @@ void aribcc_caption_region_cleanup(aribcc_caption_region_t* region) {
 // aribcc_caption_t related function implementations
 void aribcc_caption_cleanup(aribcc_caption_t* caption) {
     if (caption->text) {
-        free(caption->text);
+        MemoryAllocator::Free(caption->text);
         caption->text = nullptr;
     }
 
@@ -178,7 +179,7 @@ void aribcc_caption_cleanup(aribcc_caption_t* caption) {
         for (uint32_t i = 0; i < caption->region_count; i++) {
             aribcc_caption_region_cleanup(&caption->regions[i]);
         }
-        free(caption->regions);
+        MemoryAllocator::Free(caption->regions);
         caption->regions = nullptr;
         caption->region_count = 0;
     }
@@ -190,4 +191,104 @@ void aribcc_caption_cleanup(aribcc_caption_t* caption) {
 }
 
 
+// aribcc_caption_handle_t related function implementations
+void aribcc_caption_handle_free(aribcc_caption_handle_t* caption) {
+    auto captionpp = reinterpret_cast<Caption*>(caption);
+    delete captionpp;
+}
+
+aribcc_captiontype_t aribcc_caption_handle_get_type(const aribcc_caption_handle_t* caption) {
+    auto captionpp = reinterpret_cast<const Caption*>(caption);
+    return static_cast<aribcc_captiontype_t>(captionpp->type);
+}
+
+aribcc_captionflags_t aribcc_caption_handle_get_flags(const aribcc_caption_handle_t* caption) {
+    auto captionpp = reinterpret_cast<const Caption*>(caption);
+    return static_cast<aribcc_captionflags_t>(captionpp->flags);
+}
+
+uint32_t aribcc_caption_handle_get_iso6392_language_code(const aribcc_caption_handle_t* caption) {
+    auto captionpp = reinterpret_cast<const Caption*>(caption);
+    return captionpp->iso6392_language_code;
+}
+
+const char* aribcc_caption_handle_get_text(const aribcc_caption_handle_t* caption) {
+    auto captionpp = reinterpret_cast<const Caption*>(caption);
+    return captionpp->text.c_str();
+}
+
+int64_t aribcc_caption_handle_get_pts(const aribcc_caption_handle_t* caption) {
+    auto captionpp = reinterpret_cast<const Caption*>(caption);
+    return captionpp->pts;
+}
+
+int64_t aribcc_caption_handle_get_wait_duration(const aribcc_caption_handle_t* caption) {
+    auto captionpp = reinterpret_cast<const Caption*>(caption);
+    return captionpp->wait_duration;
+}
+
+void aribcc_caption_handle_get_plane_size(const aribcc_caption_handle_t* caption,
+                                          int* plane_width,
+                                          int* plane_height) {
+    auto captionpp = reinterpret_cast<const Caption*>(caption);
+    *plane_width = captionpp->plane_width;
+    *plane_height = captionpp->plane_height;
+}
+
+uint64_t aribcc_caption_handle_get_fingerprint(const aribcc_caption_handle_t* caption) {
+    auto captionpp = reinterpret_cast<const Caption*>(caption);
+    return captionpp->fingerprint;
+}
+
+bool aribcc_caption_handle_get_builtin_sound(const aribcc_caption_handle_t* caption, uint8_t* builtin_sound_id) {
+    auto captionpp = reinterpret_cast<const Caption*>(caption);
+    if (builtin_sound_id) {
+        *builtin_sound_id = captionpp->builtin_sound_id;
+    }
+    return captionpp->has_builtin_sound;
+}
+
+uint32_t aribcc_caption_handle_get_region_count(const aribcc_caption_handle_t* caption) {
+    auto captionpp = reinterpret_cast<const Caption*>(caption);
+    return static_cast<uint32_t>(captionpp->regions.size());
+}
+
+uint64_t aribcc_caption_handle_get_region_fingerprint(const aribcc_caption_handle_t* caption, uint32_t index) {
+    auto captionpp = reinterpret_cast<const Caption*>(caption);
+    if (index >= captionpp->regions.size()) {
+        return 0;
+    }
+    return captionpp->regions[index].fingerprint;
+}
+
+bool aribcc_caption_handle_get_region(aribcc_caption_handle_t* caption,
+                                      uint32_t index,
+                                      aribcc_caption_region_t* out_region) {
+    static_assert(sizeof(aribcc_caption_char_t) == sizeof(CaptionChar));
+
+    auto captionpp = reinterpret_cast<Caption*>(caption);
+    if (index >= captionpp->regions.size()) {
+        return false;
+    }
+
+    CaptionRegion& region = captionpp->regions[index];
+    out_region->x = region.x;
+    out_region->y = region.y;
+    out_region->width = region.width;
+    out_region->height = region.height;
+    out_region->is_ruby = region.is_ruby;
+    out_region->chars = region.chars.empty() ? nullptr : reinterpret_cast<aribcc_caption_char_t*>(region.chars.data());
+    out_region->char_count = static_cast<uint32_t>(region.chars.size());
+    return true;
+}
+
+aribcc_drcsmap_t* aribcc_caption_handle_get_drcs_map(aribcc_caption_handle_t* caption) {
+    auto captionpp = reinterpret_cast<Caption*>(caption);
+    if (captionpp->drcs_map.empty()) {
+        return nullptr;
+    }
+    return reinterpret_cast<aribcc_drcsmap_t*>(&captionpp->drcs_map);
+}
+
+
 }  // extern "C"
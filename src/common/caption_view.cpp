@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "aribcaption/caption_view.hpp"
+
+namespace aribcaption {
+
+namespace {
+
+constexpr size_t kHeaderSize = 76;
+constexpr size_t kRegionRecordSize = 28;
+constexpr size_t kCharRecordSize = 68;
+constexpr size_t kDRCSRecordSize = 48;
+
+void StoreLE16(uint8_t* ptr, uint16_t value) {
+    ptr[0] = static_cast<uint8_t>(value);
+    ptr[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void StoreLE32(uint8_t* ptr, uint32_t value) {
+    ptr[0] = static_cast<uint8_t>(value);
+    ptr[1] = static_cast<uint8_t>(value >> 8);
+    ptr[2] = static_cast<uint8_t>(value >> 16);
+    ptr[3] = static_cast<uint8_t>(value >> 24);
+}
+
+void StoreLEI32(uint8_t* ptr, int32_t value) {
+    StoreLE32(ptr, static_cast<uint32_t>(value));
+}
+
+void StoreLEI64(uint8_t* ptr, int64_t value) {
+    StoreLE32(ptr, static_cast<uint32_t>(static_cast<uint64_t>(value)));
+    StoreLE32(ptr + 4, static_cast<uint32_t>(static_cast<uint64_t>(value) >> 32));
+}
+
+void StoreLEFloat(uint8_t* ptr, float value) {
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    StoreLE32(ptr, bits);
+}
+
+void StoreColor(uint8_t* ptr, ColorRGBA color) {
+    ptr[0] = color.r;
+    ptr[1] = color.g;
+    ptr[2] = color.b;
+    ptr[3] = color.a;
+}
+
+uint16_t LoadLE16(const uint8_t* ptr) {
+    return static_cast<uint16_t>(ptr[0] | ptr[1] << 8);
+}
+
+bool InRange(uint64_t offset, uint64_t size, uint64_t total) {
+    return offset <= total && size <= total - offset;
+}
+
+// Appends variable length data after the fixed records, returns its offset
+class BlobWriter {
+public:
+    BlobWriter(std::vector<uint8_t>& out, size_t offset) : out_(out), offset_(offset) {}
+
+    uint32_t Append(const void* data, size_t size) {
+        auto offset = static_cast<uint32_t>(offset_);
+        if (size) {
+            memcpy(out_.data() + offset_, data, size);
+            offset_ += size;
+        }
+        return offset;
+    }
+private:
+    std::vector<uint8_t>& out_;
+    size_t offset_;
+};
+
+}  // namespace
+
+void SerializeCaption(const Caption& caption, std::vector<uint8_t>& out_data) {
+    // Regions stored in compact form are encoded as expanded
+    size_t char_count = 0;
+    for (const CaptionRegion& region : caption.regions) {
+        char_count += region.chars.empty() ? region.compact_chars.size() : region.chars.size();
+    }
+
+    std::vector<std::pair<uint32_t, const DRCS*>> drcs_list;
+    drcs_list.reserve(caption.drcs_map.size());
+    size_t blob_size = caption.text.size();
+    for (const auto& [code, drcs] : caption.drcs_map) {
+        drcs_list.emplace_back(code, &drcs);
+        blob_size += drcs.pixels.size() + drcs.md5.size() + drcs.alternative_text.size();
+    }
+    // Keep the encoding deterministic regardless of hash map ordering
+    std::sort(drcs_list.begin(), drcs_list.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    size_t regions_offset = kHeaderSize;
+    size_t chars_offset = regions_offset + caption.regions.size() * kRegionRecordSize;
+    size_t drcs_offset = chars_offset + char_count * kCharRecordSize;
+    size_t blob_offset = drcs_offset + drcs_list.size() * kDRCSRecordSize;
+    size_t total_size = blob_offset + blob_size;
+
+    out_data.assign(total_size, 0);
+    uint8_t* p = out_data.data();
+    BlobWriter blob(out_data, blob_offset);
+
+    StoreLE32(p, kCaptionEncodingMagic);
+    StoreLE16(p + 4, kCaptionEncodingVersion);
+    StoreLE16(p + 6, static_cast<uint16_t>(kHeaderSize));
+    StoreLE32(p + 8, static_cast<uint32_t>(total_size));
+    p[12] = static_cast<uint8_t>(caption.type);
+    p[13] = static_cast<uint8_t>(caption.flags);
+    p[14] = caption.has_builtin_sound;
+    p[15] = caption.builtin_sound_id;
+    StoreLE32(p + 16, caption.iso6392_language_code);
+    StoreLEI64(p + 20, caption.pts);
+    StoreLEI64(p + 28, caption.wait_duration);
+    StoreLEI32(p + 36, caption.plane_width);
+    StoreLEI32(p + 40, caption.plane_height);
+    StoreLE32(p + 44, blob.Append(caption.text.data(), caption.text.size()));
+    StoreLE32(p + 48, static_cast<uint32_t>(caption.text.size()));
+    StoreLE32(p + 52, static_cast<uint32_t>(caption.regions.size()));
+    StoreLE32(p + 56, static_cast<uint32_t>(regions_offset));
+    StoreLE32(p + 60, static_cast<uint32_t>(drcs_list.size()));
+    StoreLE32(p + 64, static_cast<uint32_t>(drcs_offset));
+    StoreLE16(p + 68, static_cast<uint16_t>(kCharRecordSize));
+    StoreLE16(p + 70, static_cast<uint16_t>(kRegionRecordSize));
+    StoreLE16(p + 72, static_cast<uint16_t>(kDRCSRecordSize));
+
+    uint8_t* region_record = p + regions_offset;
+    uint8_t* char_record = p + chars_offset;
+    std::vector<CaptionChar> expanded_chars;
+    for (const CaptionRegion& region : caption.regions) {
+        const std::vector<CaptionChar>* chars = &region.chars;
+        if (region.chars.empty() && !region.compact_chars.empty()) {
+            region.compact_chars.Expand(expanded_chars);
+            chars = &expanded_chars;
+        }
+
+        StoreLEI32(region_record, region.x);
+        StoreLEI32(region_record + 4, region.y);
+        StoreLEI32(region_record + 8, region.width);
+        StoreLEI32(region_record + 12, region.height);
+        region_record[16] = region.is_ruby;
+        StoreLE32(region_record + 20, static_cast<uint32_t>(chars->size()));
+        StoreLE32(region_record + 24, static_cast<uint32_t>(char_record - p));
+        region_record += kRegionRecordSize;
+
+        for (const CaptionChar& ch : *chars) {
+            char_record[0] = static_cast<uint8_t>(ch.type);
+            char_record[1] = static_cast<uint8_t>(ch.style);
+            char_record[2] = static_cast<uint8_t>(ch.enclosure_style);
+            StoreLE32(char_record + 4, ch.codepoint);
+            StoreLE32(char_record + 8, ch.pua_codepoint);
+            StoreLE32(char_record + 12, ch.drcs_code);
+            StoreLEI32(char_record + 16, ch.x);
+            StoreLEI32(char_record + 20, ch.y);
+            StoreLEI32(char_record + 24, ch.char_width);
+            StoreLEI32(char_record + 28, ch.char_height);
+            StoreLEI32(char_record + 32, ch.char_horizontal_spacing);
+            StoreLEI32(char_record + 36, ch.char_vertical_spacing);
+            StoreLEFloat(char_record + 40, ch.char_horizontal_scale);
+            StoreLEFloat(char_record + 44, ch.char_vertical_scale);
+            StoreColor(char_record + 48, ch.text_color);
+            StoreColor(char_record + 52, ch.back_color);
+            StoreColor(char_record + 56, ch.stroke_color);
+            memcpy(char_record + 60, ch.u8str, sizeof(ch.u8str));
+            char_record += kCharRecordSize;
+        }
+    }
+
+    uint8_t* drcs_record = p + drcs_offset;
+    for (const auto& [code, drcs] : drcs_list) {
+        StoreLE32(drcs_record, code);
+        StoreLEI32(drcs_record + 4, drcs->width);
+        StoreLEI32(drcs_record + 8, drcs->height);
+        StoreLEI32(drcs_record + 12, drcs->depth);
+        StoreLEI32(drcs_record + 16, drcs->depth_bits);
+        StoreLE32(drcs_record + 20, drcs->alternative_ucs4);
+        StoreLE32(drcs_record + 24, blob.Append(drcs->pixels.data(), drcs->pixels.size()));
+        StoreLE32(drcs_record + 28, static_cast<uint32_t>(drcs->pixels.size()));
+        StoreLE32(drcs_record + 32, blob.Append(drcs->md5.data(), drcs->md5.size()));
+        StoreLE32(drcs_record + 36, static_cast<uint32_t>(drcs->md5.size()));
+        StoreLE32(drcs_record + 40, blob.Append(drcs->alternative_text.data(), drcs->alternative_text.size()));
+        StoreLE32(drcs_record + 44, static_cast<uint32_t>(drcs->alternative_text.size()));
+        drcs_record += kDRCSRecordSize;
+    }
+}
+
+bool CaptionView::Open(const uint8_t* data, size_t size) {
+    p_ = nullptr;
+    if (!data || size < 8 || internal::LoadLE32(data) != kCaptionEncodingMagic ||
+            LoadLE16(data + 4) != kCaptionEncodingVersion) {
+        return false;
+    }
+
+    size_t header_size = LoadLE16(data + 6);
+    if (header_size < kHeaderSize || header_size > size) {
+        return false;
+    }
+    uint64_t total_size = internal::LoadLE32(data + 8);
+    if (total_size < header_size || total_size > size) {
+        return false;
+    }
+
+    size_t char_record_size = LoadLE16(data + 68);
+    size_t region_record_size = LoadLE16(data + 70);
+    size_t drcs_record_size = LoadLE16(data + 72);
+    if (char_record_size < kCharRecordSize || region_record_size < kRegionRecordSize ||
+            drcs_record_size < kDRCSRecordSize) {
+        return false;
+    }
+
+    if (!InRange(internal::LoadLE32(data + 44), internal::LoadLE32(data + 48), total_size)) {
+        return false;
+    }
+
+    uint64_t region_count = internal::LoadLE32(data + 52);
+    uint64_t regions_offset = internal::LoadLE32(data + 56);
+    if (!InRange(regions_offset, region_count * region_record_size, total_size)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < region_count; i++) {
+        const uint8_t* record = data + regions_offset + i * region_record_size;
+        uint64_t char_count = internal::LoadLE32(record + 20);
+        if (!InRange(internal::LoadLE32(record + 24), char_count * char_record_size, total_size)) {
+            return false;
+        }
+    }
+
+    uint64_t drcs_count = internal::LoadLE32(data + 60);
+    uint64_t drcs_offset = internal::LoadLE32(data + 64);
+    if (!InRange(drcs_offset, drcs_count * drcs_record_size, total_size)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < drcs_count; i++) {
+        const uint8_t* record = data + drcs_offset + i * drcs_record_size;
+        for (size_t field : {24, 32, 40}) {
+            if (!InRange(internal::LoadLE32(record + field), internal::LoadLE32(record + field + 4), total_size)) {
+                return false;
+            }
+        }
+    }
+
+    p_ = data;
+    char_record_size_ = char_record_size;
+    region_record_size_ = region_record_size;
+    drcs_record_size_ = drcs_record_size;
+    return true;
+}
+
+void CaptionCharView::ToCaptionChar(CaptionChar& out_char) const {
+    out_char.type = type();
+    out_char.codepoint = codepoint();
+    out_char.pua_codepoint = pua_codepoint();
+    out_char.drcs_code = drcs_code();
+    out_char.x = x();
+    out_char.y = y();
+    out_char.char_width = char_width();
+    out_char.char_height = char_height();
+    out_char.char_horizontal_spacing = char_horizontal_spacing();
+    out_char.char_vertical_spacing = char_vertical_spacing();
+    out_char.char_horizontal_scale = char_horizontal_scale();
+    out_char.char_vertical_scale = char_vertical_scale();
+    out_char.text_color = text_color();
+    out_char.back_color = back_color();
+    out_char.stroke_color = stroke_color();
+    out_char.style = style();
+    out_char.enclosure_style = enclosure_style();
+    memcpy(out_char.u8str, p_ + 60, sizeof(out_char.u8str));
+    out_char.u8str[sizeof(out_char.u8str) - 1] = '\0';
+}
+
+void CaptionRegionView::ToCaptionRegion(CaptionRegion& out_region) const {
+    out_region.x = x();
+    out_region.y = y();
+    out_region.width = width();
+    out_region.height = height();
+    out_region.is_ruby = is_ruby();
+    out_region.fingerprint = 0;  // Not encoded
+    out_region.compact_chars.clear();
+
+    size_t count = char_count();
+    out_region.chars.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        char_at(i).ToCaptionChar(out_region.chars[i]);
+    }
+}
+
+void DRCSView::ToDRCS(DRCS& out_drcs) const {
+    out_drcs.width = width();
+    out_drcs.height = height();
+    out_drcs.depth = depth();
+    out_drcs.depth_bits = depth_bits();
+    out_drcs.pixels.assign(pixels(), pixels() + pixels_size());
+    out_drcs.md5 = md5();
+    out_drcs.alternative_text = alternative_text();
+    out_drcs.alternative_ucs4 = alternative_ucs4();
+}
+
+void CaptionView::ToCaption(Caption& out_caption) const {
+    out_caption.type = type();
+    out_caption.flags = flags();
+    out_caption.iso6392_language_code = iso6392_language_code();
+    out_caption.text = text();
+    out_caption.pts = pts();
+    out_caption.wait_duration = wait_duration();
+    out_caption.plane_width = plane_width();
+    out_caption.plane_height = plane_height();
+    out_caption.has_builtin_sound = has_builtin_sound();
+    out_caption.builtin_sound_id = builtin_sound_id();
+    out_caption.fingerprint = 0;  // Not encoded
+
+    size_t regions = region_count();
+    out_caption.regions.resize(regions);
+    for (size_t i = 0; i < regions; i++) {
+        region_at(i).ToCaptionRegion(out_caption.regions[i]);
+    }
+
+    out_caption.drcs_map.clear();
+    size_t drcs = drcs_count();
+    for (size_t i = 0; i < drcs; i++) {
+        DRCSView view = drcs_at(i);
+        view.ToDRCS(out_caption.drcs_map[view.code()]);
+    }
+}
+
+}  // namespace aribcaption
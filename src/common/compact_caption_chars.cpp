@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cstring>
+#include "aribcaption/caption.hpp"
+#include "base/utf_helper.hpp"
+
+namespace aribcaption {
+
+namespace {
+
+bool IsSameRun(const CaptionCharRun& run, const CaptionChar& ch) {
+    return run.type == ch.type && run.style == ch.style && run.enclosure_style == ch.enclosure_style &&
+           run.y == ch.y && run.x + static_cast<int>(run.char_count) * run.section_width() == ch.x &&
+           run.char_width == ch.char_width && run.char_height == ch.char_height &&
+           run.char_horizontal_spacing == ch.char_horizontal_spacing &&
+           run.char_vertical_spacing == ch.char_vertical_spacing &&
+           run.char_horizontal_scale == ch.char_horizontal_scale &&
+           run.char_vertical_scale == ch.char_vertical_scale &&
+           run.text_color.u32 == ch.text_color.u32 && run.back_color.u32 == ch.back_color.u32 &&
+           run.stroke_color.u32 == ch.stroke_color.u32;
+}
+
+void MakeU8Str(CaptionCharType type, uint32_t codepoint, char (&u8str)[8]) {
+    memset(u8str, 0, sizeof(u8str));
+    if (type != CaptionCharType::kDRCS) {
+        utf::UTF8Char u8char = utf::EncodeUTF8(codepoint);
+        memcpy(u8str, u8char.bytes, u8char.length);
+    }
+}
+
+}  // namespace
+
+bool CompactCaptionChars::Assign(const std::vector<CaptionChar>& chars) {
+    clear();
+    codepoints.reserve(chars.size());
+
+    bool has_pua = false;
+    bool has_drcs = false;
+    for (const CaptionChar& ch : chars) {
+        has_pua |= ch.pua_codepoint != 0;
+        has_drcs |= ch.type != CaptionCharType::kText;
+    }
+    if (has_pua) {
+        pua_codepoints.reserve(chars.size());
+    }
+    if (has_drcs) {
+        drcs_codes.reserve(chars.size());
+    }
+
+    for (const CaptionChar& ch : chars) {
+        char u8str[8];
+        MakeU8Str(ch.type, ch.codepoint, u8str);
+        if (ch.u8str[0] != '\0' && memcmp(u8str, ch.u8str, sizeof(u8str)) != 0) {
+            clear();
+            return false;
+        }
+
+        if (runs.empty() || !IsSameRun(runs.back(), ch)) {
+            CaptionCharRun& run = runs.emplace_back();
+            run.type = ch.type;
+            run.style = ch.style;
+            run.enclosure_style = ch.enclosure_style;
+            run.x = ch.x;
+            run.y = ch.y;
+            run.char_width = ch.char_width;
+            run.char_height = ch.char_height;
+            run.char_horizontal_spacing = ch.char_horizontal_spacing;
+            run.char_vertical_spacing = ch.char_vertical_spacing;
+            run.char_horizontal_scale = ch.char_horizontal_scale;
+            run.char_vertical_scale = ch.char_vertical_scale;
+            run.text_color = ch.text_color;
+            run.back_color = ch.back_color;
+            run.stroke_color = ch.stroke_color;
+        }
+        runs.back().char_count++;
+
+        codepoints.push_back(ch.codepoint);
+        if (has_pua) {
+            pua_codepoints.push_back(ch.pua_codepoint);
+        }
+        if (has_drcs) {
+            drcs_codes.push_back(ch.drcs_code);
+        }
+    }
+    return true;
+}
+
+void CompactCaptionChars::Expand(std::vector<CaptionChar>& out_chars) const {
+    out_chars.resize(codepoints.size());
+
+    size_t index = 0;
+    for (const CaptionCharRun& run : runs) {
+        int section_width = run.section_width();
+        for (uint32_t i = 0; i < run.char_count; i++, index++) {
+            CaptionChar& ch = out_chars[index];
+            ch.type = run.type;
+            ch.codepoint = codepoints[index];
+            ch.pua_codepoint = pua_codepoints.empty() ? 0 : pua_codepoints[index];
+            ch.drcs_code = drcs_codes.empty() ? 0 : drcs_codes[index];
+            ch.x = run.x + static_cast<int>(i) * section_width;
+            ch.y = run.y;
+            ch.char_width = run.char_width;
+            ch.char_height = run.char_height;
+            ch.char_horizontal_spacing = run.char_horizontal_spacing;
+            ch.char_vertical_spacing = run.char_vertical_spacing;
+            ch.char_horizontal_scale = run.char_horizontal_scale;
+            ch.char_vertical_scale = run.char_vertical_scale;
+            ch.text_color = run.text_color;
+            ch.back_color = run.back_color;
+            ch.stroke_color = run.stroke_color;
+            ch.style = run.style;
+            ch.enclosure_style = run.enclosure_style;
+            MakeU8Str(run.type, ch.codepoint, ch.u8str);
+        }
+    }
+}
+
+}  // namespace aribcaption
@@ -17,11 +17,23 @@
  */
 
 #include "aribcaption/context.hpp"
+#include "base/font_data_registry.hpp"
 #include "base/logger.hpp"
+#include "base/memory_allocator.hpp"
+#include "base/memory_trim_registry.hpp"
+#include "base/metrics.hpp"
+#include "base/shared_registry.hpp"
+#include "base/tracer.hpp"
 
 namespace aribcaption {
 
-Context::Context() : logger_(std::make_shared<Logger>()) {}
+Context::Context()
+    : logger_(std::make_shared<Logger>()),
+      allocator_(std::make_shared<MemoryAllocator>()),
+      memory_trim_registry_(std::make_shared<MemoryTrimRegistry>()),
+      metrics_(std::make_shared<Metrics>()),
+      font_data_registry_(std::make_shared<FontDataRegistry>()),
+      tracer_(std::make_shared<Tracer>()) {}
 
 Context::~Context() = default;
 
@@ -33,8 +45,104 @@ void Context::SetLogcatCallback(const LogcatCB& logcat_cb) {
     logger_->SetCallback(logcat_cb);
 }
 
+void Context::SetLogLevel(LogLevel level) {
+    logger_->SetLevel(level);
+}
+
+void Context::SetLogRateLimit(uint32_t max_messages_per_second) {
+    logger_->SetRateLimit(max_messages_per_second);
+}
+
+void Context::SetShareFontFaces(bool share) {
+    if (!share) {
+        // Renderers already sharing keep their own references
+        std::atomic_store(&shared_registry_, std::shared_ptr<SharedRegistry>());
+        return;
+    }
+
+    std::shared_ptr<SharedRegistry> expected;
+    if (!std::atomic_load(&shared_registry_)) {
+        // Another thread may have enabled sharing meanwhile, keep its registry in that case
+        std::atomic_compare_exchange_strong(&shared_registry_, &expected, std::make_shared<SharedRegistry>());
+    }
+}
+
+void Context::AddFontData(const uint8_t* data, size_t size) {
+    font_data_registry_->Add(std::make_shared<const std::vector<uint8_t>>(data, data + size));
+}
+
+void Context::SetMetricsEnabled(bool enabled) {
+    metrics_->SetEnabled(enabled);
+}
+
+void Context::GetMetrics(MetricsSnapshot& out_metrics) const {
+    metrics_->Snapshot(out_metrics);
+}
+
+void Context::ResetMetrics() {
+    metrics_->Reset();
+}
+
+void Context::SetTraceCallback(const TraceCB& trace_cb) {
+    tracer_->SetCallback(trace_cb);
+}
+
+void Context::SetTraceBufferSize(size_t max_events) {
+    tracer_->SetBufferSize(max_events);
+}
+
+void Context::DumpTraceEvents(std::string& out_json) {
+    tracer_->DumpJSON(out_json);
+}
+
+bool Context::SetAllocator(const AllocatorCallbacks& callbacks) {
+    if (!callbacks.alloc != !callbacks.free) {
+        logger_->e("Context: alloc and free callbacks must be set together");
+        return false;
+    }
+    // Objects constructed earlier keep the allocator they took, so swap in a new one rather than mutating it
+    std::atomic_store(&allocator_, std::make_shared<MemoryAllocator>(callbacks));
+    return true;
+}
+
+void Context::TrimMemory(MemoryTrimLevel level) {
+    memory_trim_registry_->Trim(level);
+}
+
+bool Context::IsTracingSupported() {
+#ifdef ARIBCC_ENABLE_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
 std::shared_ptr<Logger> GetContextLogger(Context& context) {
     return context.logger_;
 }
 
+std::shared_ptr<MemoryAllocator> GetContextAllocator(Context& context) {
+    return std::atomic_load(&context.allocator_);
+}
+
+std::shared_ptr<MemoryTrimRegistry> GetContextMemoryTrimRegistry(Context& context) {
+    return context.memory_trim_registry_;
+}
+
+std::shared_ptr<Metrics> GetContextMetrics(Context& context) {
+    return context.metrics_;
+}
+
+std::shared_ptr<SharedRegistry> GetContextSharedRegistry(Context& context) {
+    return std::atomic_load(&context.shared_registry_);
+}
+
+std::shared_ptr<FontDataRegistry> GetContextFontDataRegistry(Context& context) {
+    return context.font_data_registry_;
+}
+
+std::shared_ptr<Tracer> GetContextTracer(Context& context) {
+    return context.tracer_;
+}
+
 }  // namespace aribcaption
@@ -16,6 +16,9 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
+#include <cstring>
+#include <string>
 #include "aribcaption/context.h"
 #include "aribcaption/context.hpp"
 
@@ -39,6 +42,121 @@ void aribcc_context_set_logcat_callback(aribcc_context_t* context, aribcc_logcat
     }
 }
 
+void aribcc_context_set_log_level(aribcc_context_t* context, aribcc_loglevel_t level) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    ctx->SetLogLevel(static_cast<LogLevel>(level));
+}
+
+void aribcc_context_set_log_rate_limit(aribcc_context_t* context, uint32_t max_messages_per_second) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    ctx->SetLogRateLimit(max_messages_per_second);
+}
+
+void aribcc_context_set_share_font_faces(aribcc_context_t* context, bool share) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    ctx->SetShareFontFaces(share);
+}
+
+void aribcc_context_add_font_data(aribcc_context_t* context, const uint8_t* data, size_t size) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    ctx->AddFontData(data, size);
+}
+
+void aribcc_context_set_metrics_enabled(aribcc_context_t* context, bool enabled) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    ctx->SetMetricsEnabled(enabled);
+}
+
+uint64_t aribcc_context_get_metric_counter(aribcc_context_t* context, aribcc_metric_counter_t counter) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    if (counter < 0 || counter >= static_cast<int>(MetricCounter::kCount)) {
+        return 0;
+    }
+    MetricsSnapshot metrics;
+    ctx->GetMetrics(metrics);
+    return metrics.counter(static_cast<MetricCounter>(counter));
+}
+
+bool aribcc_context_get_metric_histogram(aribcc_context_t* context,
+                                         aribcc_metric_histogram_t histogram,
+                                         aribcc_metric_histogram_snapshot_t* out_snapshot) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    if (histogram < 0 || histogram >= static_cast<int>(MetricHistogram::kCount)) {
+        return false;
+    }
+    MetricsSnapshot metrics;
+    ctx->GetMetrics(metrics);
+    const MetricHistogramSnapshot& snapshot = metrics.histogram(static_cast<MetricHistogram>(histogram));
+    out_snapshot->count = snapshot.count;
+    out_snapshot->sum = snapshot.sum;
+    out_snapshot->min = snapshot.min;
+    out_snapshot->max = snapshot.max;
+    for (size_t i = 0; i < kMetricHistogramBuckets; i++) {
+        out_snapshot->buckets[i] = snapshot.buckets[i];
+    }
+    return true;
+}
+
+void aribcc_context_reset_metrics(aribcc_context_t* context) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    ctx->ResetMetrics();
+}
+
+void aribcc_context_set_trace_callback(aribcc_context_t* context, aribcc_trace_callback_t callback, void* userdata) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    if (callback) {
+        ctx->SetTraceCallback([callback, userdata] (const TraceEvent& event) {
+            aribcc_trace_event_t capi_event;
+            capi_event.name = event.name;
+            capi_event.category = event.category;
+            capi_event.timestamp = event.timestamp;
+            capi_event.duration = event.duration;
+            capi_event.thread_id = event.thread_id;
+            callback(&capi_event, userdata);
+        });
+    } else {
+        ctx->SetTraceCallback(nullptr);
+    }
+}
+
+void aribcc_context_set_trace_buffer_size(aribcc_context_t* context, size_t max_events) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    ctx->SetTraceBufferSize(max_events);
+}
+
+size_t aribcc_context_dump_trace_events(aribcc_context_t* context, char* buffer, size_t buffer_size) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    std::string json;
+    ctx->DumpTraceEvents(json);
+    if (buffer && buffer_size) {
+        size_t length = std::min(json.size(), buffer_size - 1);
+        memcpy(buffer, json.data(), length);
+        buffer[length] = '\0';
+    }
+    return json.size();
+}
+
+bool aribcc_is_tracing_supported() {
+    return Context::IsTracingSupported();
+}
+
+bool aribcc_context_set_allocator(aribcc_context_t* context, const aribcc_allocator_t* allocator) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    AllocatorCallbacks callbacks;
+    if (allocator) {
+        callbacks.alloc = allocator->alloc;
+        callbacks.aligned_alloc = allocator->aligned_alloc;
+        callbacks.free = allocator->free;
+        callbacks.opaque = allocator->opaque;
+    }
+    return ctx->SetAllocator(callbacks);
+}
+
+void aribcc_context_trim_memory(aribcc_context_t* context, aribcc_memory_trim_level_t level) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    ctx->TrimMemory(static_cast<MemoryTrimLevel>(level));
+}
+
 void aribcc_context_free(aribcc_context_t* context) {
     auto ctx = reinterpret_cast<Context*>(context);
     delete ctx;
@@ -0,0 +1,617 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <vector>
+#include "aribcaption/subtitle_writer.hpp"
+
+namespace aribcaption {
+
+namespace {
+
+constexpr int kDefaultPlaneWidth = 960;
+constexpr int kDefaultPlaneHeight = 540;
+constexpr int kStyleMask = kCharStyleBold | kCharStyleItalic | kCharStyleUnderline | kCharStyleStroke;
+
+// Ruby text attached to chars [begin, end) of a line
+struct RubyAnnotation {
+    size_t begin = 0;
+    size_t end = 0;
+    std::string text;
+    int font_size = 0;
+};
+
+// Characters of one caption line, written as one cue
+struct CueLine {
+    int x = 0;
+    int y = 0;     // Top of the line including attached ruby
+    int right = 0;
+    int bottom = 0;
+    bool is_ruby = false;
+    std::vector<const CaptionChar*> chars;
+    std::vector<RubyAnnotation> rubies;
+};
+
+// Attributes shared by consecutive chars, see WriteRunStart()
+struct RunStyle {
+    ColorRGBA text_color{255, 255, 255};
+    ColorRGBA stroke_color{0, 0, 0};
+    int style = kCharStyleDefault;
+    int font_size = 0;
+public:
+    bool operator==(const RunStyle& other) const {
+        return text_color.u32 == other.text_color.u32 && stroke_color.u32 == other.stroke_color.u32 &&
+               style == other.style && font_size == other.font_size;
+    }
+    bool operator!=(const RunStyle& other) const { return !(*this == other); }
+};
+
+int FontSize(const CaptionChar& ch) {
+    return static_cast<int>(std::lround(static_cast<float>(ch.char_height) * ch.char_vertical_scale));
+}
+
+RunStyle MakeRunStyle(const CaptionChar& ch) {
+    RunStyle run;
+    run.text_color = ch.text_color;
+    run.style = ch.style & kStyleMask;
+    run.stroke_color = (run.style & kCharStyleStroke) ? ch.stroke_color : ColorRGBA(0, 0, 0);
+    run.font_size = FontSize(ch);
+    return run;
+}
+
+void AppendCharText(const Caption& caption, const CaptionChar& ch, std::string& out) {
+    if (ch.type == CaptionCharType::kDRCS) {
+        auto iter = caption.drcs_map.find(ch.drcs_code);
+        if (iter != caption.drcs_map.end()) {
+            out += iter->second.alternative_text;
+        }
+        return;
+    }
+    out += ch.u8str;
+}
+
+void AppendEscaped(SubtitleFormat format, const std::string& text, std::string& out) {
+    for (char ch : text) {
+        if (format == SubtitleFormat::kASS) {
+            switch (ch) {
+                case '{': out += "\\{"; break;
+                case '}': out += "\\}"; break;
+                case '\n': out += "\\N"; break;
+                default: out += ch; break;
+            }
+        } else {
+            switch (ch) {
+                case '&': out += "&amp;"; break;
+                case '<': out += "&lt;"; break;
+                case '>': out += "&gt;"; break;
+                case '\n': out += format == SubtitleFormat::kTTML ? "<br/>" : "\n"; break;
+                default: out += ch; break;
+            }
+        }
+    }
+}
+
+void AppendFormat(std::string& out, const char* format, ...) {
+    char buffer[128];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length > 0) {
+        out.append(buffer, std::min(static_cast<size_t>(length), sizeof(buffer) - 1));
+    }
+}
+
+void AppendTime(SubtitleFormat format, int64_t millis, std::string& out) {
+    millis = std::max<int64_t>(0, millis);
+    int64_t hours = millis / 1000 / 60 / 60;
+    int64_t minutes = (millis / 1000 / 60) % 60;
+    int64_t seconds = (millis / 1000) % 60;
+    if (format == SubtitleFormat::kASS) {
+        AppendFormat(out, "%" PRId64 ":%02" PRId64 ":%02" PRId64 ".%02" PRId64,
+                     hours, minutes, seconds, (millis % 1000) / 10);
+    } else {
+        AppendFormat(out, "%02" PRId64 ":%02" PRId64 ":%02" PRId64 ".%03" PRId64,
+                     hours, minutes, seconds, millis % 1000);
+    }
+}
+
+void AppendHexColor(ColorRGBA color, std::string& out) {
+    if (color.a == 255) {
+        AppendFormat(out, "#%02x%02x%02x", color.r, color.g, color.b);
+    } else {
+        AppendFormat(out, "#%02x%02x%02x%02x", color.r, color.g, color.b, color.a);
+    }
+}
+
+// WebVTT only supports the default color classes without a style sheet, pick the nearest one
+const char* WebVTTColorClass(ColorRGBA color) {
+    static const struct { ColorRGBA color; const char* name; } kClasses[] = {
+        {ColorRGBA(255, 255, 255), "white"}, {ColorRGBA(0, 255, 0), "lime"},
+        {ColorRGBA(0, 255, 255), "cyan"},    {ColorRGBA(255, 0, 0), "red"},
+        {ColorRGBA(255, 255, 0), "yellow"},  {ColorRGBA(255, 0, 255), "magenta"},
+        {ColorRGBA(0, 0, 255), "blue"},      {ColorRGBA(0, 0, 0), "black"},
+    };
+    const char* name = nullptr;
+    int min_distance = INT32_MAX;
+    for (const auto& item : kClasses) {
+        int dr = color.r - item.color.r;
+        int dg = color.g - item.color.g;
+        int db = color.b - item.color.b;
+        int distance = dr * dr + dg * dg + db * db;
+        if (distance < min_distance) {
+            min_distance = distance;
+            name = item.name;
+        }
+    }
+    return name;
+}
+
+// Open a run of chars styled differently from the base, prev is the style of the previous run for ASS
+void WriteRunStart(SubtitleFormat format, const RunStyle& base, const RunStyle& prev, const RunStyle& run,
+                   std::string& out) {
+    if (format == SubtitleFormat::kASS) {
+        if (run == prev) {
+            return;
+        }
+        out += '{';
+        if (run.text_color.u32 != prev.text_color.u32) {
+            AppendFormat(out, "\\c&H%02X%02X%02X&", run.text_color.b, run.text_color.g, run.text_color.r);
+        }
+        if (run.text_color.a != prev.text_color.a) {
+            AppendFormat(out, "\\1a&H%02X&", 255 - run.text_color.a);
+        }
+        if (run.stroke_color.u32 != prev.stroke_color.u32) {
+            AppendFormat(out, "\\3c&H%02X%02X%02X&", run.stroke_color.b, run.stroke_color.g, run.stroke_color.r);
+        }
+        int changed = run.style ^ prev.style;
+        if (changed & kCharStyleBold) {
+            out += (run.style & kCharStyleBold) ? "\\b1" : "\\b0";
+        }
+        if (changed & kCharStyleItalic) {
+            out += (run.style & kCharStyleItalic) ? "\\i1" : "\\i0";
+        }
+        if (changed & kCharStyleUnderline) {
+            out += (run.style & kCharStyleUnderline) ? "\\u1" : "\\u0";
+        }
+        if (run.font_size != prev.font_size) {
+            AppendFormat(out, "\\fs%d", run.font_size);
+        }
+        out += '}';
+    } else if (format == SubtitleFormat::kWebVTT) {
+        if (run.text_color.u32 != base.text_color.u32) {
+            out += "<c.";
+            out += WebVTTColorClass(run.text_color);
+            out += '>';
+        }
+        if (run.style & kCharStyleBold) {
+            out += "<b>";
+        }
+        if (run.style & kCharStyleItalic) {
+            out += "<i>";
+        }
+        if (run.style & kCharStyleUnderline) {
+            out += "<u>";
+        }
+    } else if (run != base) {
+        out += "<span";
+        if (run.text_color.u32 != base.text_color.u32) {
+            out += " tts:color=\"";
+            AppendHexColor(run.text_color, out);
+            out += '"';
+        }
+        if (run.style & kCharStyleBold) {
+            out += " tts:fontWeight=\"bold\"";
+        }
+        if (run.style & kCharStyleItalic) {
+            out += " tts:fontStyle=\"italic\"";
+        }
+        if (run.style & kCharStyleUnderline) {
+            out += " tts:textDecoration=\"underline\"";
+        }
+        if (run.style & kCharStyleStroke) {
+            out += " tts:textOutline=\"";
+            AppendHexColor(run.stroke_color, out);
+            out += " 1px\"";
+        }
+        if (run.font_size != base.font_size) {
+            AppendFormat(out, " tts:fontSize=\"%dpx\"", run.font_size);
+        }
+        out += '>';
+    }
+}
+
+void WriteRunEnd(SubtitleFormat format, const RunStyle& base, const RunStyle& run, std::string& out) {
+    if (format == SubtitleFormat::kWebVTT) {
+        if (run.style & kCharStyleUnderline) {
+            out += "</u>";
+        }
+        if (run.style & kCharStyleItalic) {
+            out += "</i>";
+        }
+        if (run.style & kCharStyleBold) {
+            out += "</b>";
+        }
+        if (run.text_color.u32 != base.text_color.u32) {
+            out += "</c>";
+        }
+    } else if (format == SubtitleFormat::kTTML && run != base) {
+        out += "</span>";
+    }
+}
+
+// Write chars [begin, end) of a line, grouped into runs
+void WriteChars(SubtitleFormat format, const Caption& caption, const CueLine& line, size_t begin, size_t end,
+                const RunStyle& base, RunStyle& prev, std::string& text, std::string& out) {
+    size_t index = begin;
+    while (index < end) {
+        RunStyle run = MakeRunStyle(*line.chars[index]);
+        text.clear();
+        for (; index < end && MakeRunStyle(*line.chars[index]) == run; index++) {
+            AppendCharText(caption, *line.chars[index], text);
+        }
+        if (text.empty()) {
+            continue;
+        }
+        WriteRunStart(format, base, prev, run, out);
+        AppendEscaped(format, text, out);
+        WriteRunEnd(format, base, run, out);
+        prev = run;
+    }
+}
+
+void WriteLineText(SubtitleFormat format, const Caption& caption, const CueLine& line, const RunStyle& base,
+                   std::string& text, std::string& out) {
+    RunStyle prev = base;
+    size_t index = 0;
+    for (const RubyAnnotation& ruby : line.rubies) {
+        WriteChars(format, caption, line, index, ruby.begin, base, prev, text, out);
+        if (format == SubtitleFormat::kWebVTT) {
+            out += "<ruby>";
+            WriteChars(format, caption, line, ruby.begin, ruby.end, base, prev, text, out);
+            out += "<rt>";
+            AppendEscaped(format, ruby.text, out);
+            out += "</rt></ruby>";
+        } else {
+            out += "<span tts:ruby=\"container\"><span tts:ruby=\"base\">";
+            WriteChars(format, caption, line, ruby.begin, ruby.end, base, prev, text, out);
+            AppendFormat(out, "</span><span tts:ruby=\"text\" tts:fontSize=\"%dpx\">", ruby.font_size);
+            AppendEscaped(format, ruby.text, out);
+            out += "</span></span>";
+        }
+        index = ruby.end;
+    }
+    WriteChars(format, caption, line, index, line.chars.size(), base, prev, text, out);
+}
+
+// Group caption regions into lines, ruby regions are attached to the chars below them if attach_ruby is set
+void BuildLines(const Caption& caption, bool attach_ruby, std::vector<std::vector<CaptionChar>>& expanded_chars,
+                std::vector<CueLine>& out_lines) {
+    expanded_chars.resize(caption.regions.size());
+
+    std::vector<size_t> order;
+    for (size_t i = 0; i < caption.regions.size(); i++) {
+        const CaptionRegion& region = caption.regions[i];
+        if (region.chars.empty() && !region.compact_chars.empty()) {
+            region.compact_chars.Expand(expanded_chars[i]);
+        } else {
+            expanded_chars[i].clear();
+        }
+        order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        const CaptionRegion& ra = caption.regions[a];
+        const CaptionRegion& rb = caption.regions[b];
+        return ra.y != rb.y ? ra.y < rb.y : ra.x < rb.x;
+    });
+
+    auto region_chars = [&](size_t i) -> const std::vector<CaptionChar>& {
+        return caption.regions[i].chars.empty() ? expanded_chars[i] : caption.regions[i].chars;
+    };
+
+    std::vector<size_t> ruby_regions;
+    for (size_t i : order) {
+        const CaptionRegion& region = caption.regions[i];
+        const std::vector<CaptionChar>& chars = region_chars(i);
+        if (chars.empty()) {
+            continue;
+        } else if (region.is_ruby) {
+            ruby_regions.push_back(i);
+            continue;
+        }
+        if (out_lines.empty() || out_lines.back().is_ruby || out_lines.back().y != region.y) {
+            CueLine& line = out_lines.emplace_back();
+            line.x = region.x;
+            line.y = region.y;
+            line.right = region.x + region.width;
+            line.bottom = region.y + region.height;
+        }
+        CueLine& line = out_lines.back();
+        line.x = std::min(line.x, region.x);
+        line.right = std::max(line.right, region.x + region.width);
+        line.bottom = std::max(line.bottom, region.y + region.height);
+        for (const CaptionChar& ch : chars) {
+            line.chars.push_back(&ch);
+        }
+    }
+    size_t base_line_count = out_lines.size();
+
+    for (size_t i : ruby_regions) {
+        const CaptionRegion& region = caption.regions[i];
+        const std::vector<CaptionChar>& chars = region_chars(i);
+        int region_bottom = region.y + region.height;
+
+        // The nearest line right below the ruby, which overlaps it horizontally
+        CueLine* base_line = nullptr;
+        for (size_t n = 0; attach_ruby && n < base_line_count; n++) {
+            CueLine& line = out_lines[n];
+            bool below = line.bottom > region_bottom && line.chars.front()->y >= region.y;
+            bool overlapped = line.x < region.x + region.width && region.x < line.right;
+            if (below && overlapped && (!base_line || line.y < base_line->y)) {
+                base_line = &line;
+            }
+        }
+
+        RubyAnnotation ruby;
+        if (base_line) {
+            ruby.begin = base_line->chars.size();
+            for (size_t n = 0; n < base_line->chars.size(); n++) {
+                const CaptionChar& ch = *base_line->chars[n];
+                int center = ch.x + ch.section_width() / 2;
+                if (center >= region.x && center < region.x + region.width) {
+                    ruby.begin = std::min(ruby.begin, n);
+                    ruby.end = n + 1;
+                }
+            }
+            for (const RubyAnnotation& other : base_line->rubies) {
+                if (ruby.begin < other.end && other.begin < ruby.end) {
+                    ruby.end = 0;  // Already annotated, place it on its own
+                }
+            }
+        }
+
+        if (base_line && ruby.begin < ruby.end) {
+            for (const CaptionChar& ch : chars) {
+                AppendCharText(caption, ch, ruby.text);
+            }
+            ruby.font_size = FontSize(chars.front());
+            base_line->y = std::min(base_line->y, region.y);
+            base_line->rubies.push_back(std::move(ruby));
+            continue;
+        }
+
+        CueLine& line = out_lines.emplace_back();
+        line.x = region.x;
+        line.y = region.y;
+        line.right = region.x + region.width;
+        line.bottom = region_bottom;
+        line.is_ruby = true;
+        for (const CaptionChar& ch : chars) {
+            line.chars.push_back(&ch);
+        }
+    }
+
+    for (CueLine& line : out_lines) {
+        std::sort(line.rubies.begin(), line.rubies.end(), [](const RubyAnnotation& a, const RubyAnnotation& b) {
+            return a.begin < b.begin;
+        });
+    }
+}
+
+}  // namespace
+
+SubtitleWriter::SubtitleWriter(SubtitleFormat format) : format_(format) {}
+
+SubtitleWriter::~SubtitleWriter() = default;
+
+void SubtitleWriter::SetOutputCallback(OutputCallback callback) {
+    output_callback_ = std::move(callback);
+}
+
+void SubtitleWriter::SetLastCaptionDuration(int64_t duration) {
+    last_caption_duration_ = std::max<int64_t>(0, duration);
+}
+
+void SubtitleWriter::AppendCaption(const Caption& caption) {
+    if (!header_written_) {
+        WriteHeader(&caption);
+    }
+    if (has_pending_) {
+        WriteCaption(pending_caption_, caption.pts);
+        has_pending_ = false;
+    }
+
+    if (!caption.text.empty() || !caption.regions.empty()) {
+        if (caption.wait_duration == DURATION_INDEFINITE) {
+            pending_caption_ = caption;
+            has_pending_ = true;
+        } else {
+            WriteCaption(caption, caption.pts + caption.wait_duration);
+        }
+    }
+    Output();
+}
+
+void SubtitleWriter::Finish() {
+    if (!header_written_) {
+        WriteHeader(nullptr);
+    }
+    if (has_pending_) {
+        WriteCaption(pending_caption_, pending_caption_.pts + last_caption_duration_);
+        has_pending_ = false;
+    }
+    if (format_ == SubtitleFormat::kTTML) {
+        buffer_ += "</div>\n</body>\n</tt>\n";
+    }
+    Output();
+    header_written_ = false;
+}
+
+void SubtitleWriter::WriteHeader(const Caption* caption) {
+    plane_width_ = caption && caption->plane_width > 0 ? caption->plane_width : kDefaultPlaneWidth;
+    plane_height_ = caption && caption->plane_height > 0 ? caption->plane_height : kDefaultPlaneHeight;
+    header_written_ = true;
+
+    switch (format_) {
+        case SubtitleFormat::kWebVTT:
+            buffer_ += "WEBVTT\n\n";
+            break;
+        case SubtitleFormat::kTTML: {
+            std::string language;
+            uint32_t code = caption ? caption->iso6392_language_code : 0;
+            for (int shift = 16; shift >= 0; shift -= 8) {
+                auto ch = static_cast<char>((code >> shift) & 0xFF);
+                if (ch >= 'a' && ch <= 'z') {
+                    language += ch;
+                }
+            }
+            buffer_ += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                       "<tt xmlns=\"http://www.w3.org/ns/ttml\" "
+                       "xmlns:tts=\"http://www.w3.org/ns/ttml#styling\" "
+                       "xmlns:ttp=\"http://www.w3.org/ns/ttml#parameter\" ttp:version=\"2\" ";
+            AppendFormat(buffer_, "tts:extent=\"%dpx %dpx\" ", plane_width_, plane_height_);
+            buffer_ += "xml:lang=\"" + language + "\">\n<body>\n<div>\n";
+            break;
+        }
+        case SubtitleFormat::kASS:
+            buffer_ += "[Script Info]\n"
+                       "ScriptType: v4.00+\n";
+            AppendFormat(buffer_, "PlayResX: %d\nPlayResY: %d\n", plane_width_, plane_height_);
+            buffer_ += "WrapStyle: 2\n"
+                       "\n"
+                       "[V4+ Styles]\n"
+                       "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, "
+                       "Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, "
+                       "Shadow, Alignment, MarginL, MarginR, MarginV, Encoding\n"
+                       "Style: Default,sans-serif,36,&H00FFFFFF,&H00FFFFFF,&H00000000,&H80000000,"
+                       "0,0,0,0,100,100,0,0,1,2,0,7,0,0,0,1\n"
+                       "\n"
+                       "[Events]\n"
+                       "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n";
+            break;
+    }
+}
+
+void SubtitleWriter::WriteCaption(const Caption& caption, int64_t end) {
+    int64_t begin = caption.pts == PTS_NOPTS ? 0 : caption.pts;
+    std::string text;
+
+    std::vector<std::vector<CaptionChar>> expanded_chars;
+    std::vector<CueLine> lines;
+    BuildLines(caption, format_ != SubtitleFormat::kASS, expanded_chars, lines);
+
+    if (lines.empty()) {
+        // Text only caption, without layout
+        if (caption.text.empty()) {
+            return;
+        }
+        switch (format_) {
+            case SubtitleFormat::kWebVTT:
+                AppendTime(format_, begin, buffer_);
+                buffer_ += " --> ";
+                AppendTime(format_, end, buffer_);
+                buffer_ += '\n';
+                AppendEscaped(format_, caption.text, buffer_);
+                buffer_ += "\n\n";
+                break;
+            case SubtitleFormat::kTTML:
+                buffer_ += "<p begin=\"";
+                AppendTime(format_, begin, buffer_);
+                buffer_ += "\" end=\"";
+                AppendTime(format_, end, buffer_);
+                buffer_ += "\">";
+                AppendEscaped(format_, caption.text, buffer_);
+                buffer_ += "</p>\n";
+                break;
+            case SubtitleFormat::kASS:
+                buffer_ += "Dialogue: 0,";
+                AppendTime(format_, begin, buffer_);
+                buffer_ += ',';
+                AppendTime(format_, end, buffer_);
+                buffer_ += ",Default,,0,0,0,,{\\an2}";
+                AppendEscaped(format_, caption.text, buffer_);
+                buffer_ += '\n';
+                break;
+        }
+        cue_count_++;
+        return;
+    }
+
+    for (const CueLine& line : lines) {
+        RunStyle base;
+        base.font_size = FontSize(*line.chars.front());
+        size_t cue_begin = buffer_.size();
+
+        switch (format_) {
+            case SubtitleFormat::kWebVTT:
+                AppendTime(format_, begin, buffer_);
+                buffer_ += " --> ";
+                AppendTime(format_, end, buffer_);
+                AppendFormat(buffer_, " line:%.2f%% position:%.2f%%,line-left align:left\n",
+                             100.0 * line.y / plane_height_, 100.0 * line.x / plane_width_);
+                text.clear();
+                WriteLineText(format_, caption, line, base, text, buffer_);
+                buffer_ += "\n\n";
+                break;
+            case SubtitleFormat::kTTML:
+                buffer_ += "<p begin=\"";
+                AppendTime(format_, begin, buffer_);
+                buffer_ += "\" end=\"";
+                AppendTime(format_, end, buffer_);
+                AppendFormat(buffer_, "\" tts:fontSize=\"%dpx\">", base.font_size);
+                AppendFormat(buffer_, "<region tts:origin=\"%dpx %dpx\" tts:extent=\"%dpx %dpx\"/>",
+                             line.x, line.y, line.right - line.x, line.bottom - line.y);
+                WriteLineText(format_, caption, line, base, text, buffer_);
+                buffer_ += "</p>\n";
+                break;
+            case SubtitleFormat::kASS:
+                buffer_ += "Dialogue: ";
+                buffer_ += line.is_ruby ? "1," : "0,";
+                AppendTime(format_, begin, buffer_);
+                buffer_ += ',';
+                AppendTime(format_, end, buffer_);
+                AppendFormat(buffer_, ",Default,,0,0,0,,{\\pos(%d,%d)\\fs%d}", line.x, line.y, base.font_size);
+                WriteLineText(format_, caption, line, base, text, buffer_);
+                buffer_ += '\n';
+                break;
+        }
+
+        // Drop lines that turned out to be empty, e.g. DRCS without alternative text
+        text.clear();
+        for (const CaptionChar* ch : line.chars) {
+            AppendCharText(caption, *ch, text);
+        }
+        if (text.empty()) {
+            buffer_.resize(cue_begin);
+            continue;
+        }
+        cue_count_++;
+    }
+}
+
+void SubtitleWriter::Output() {
+    if (!buffer_.empty() && output_callback_) {
+        output_callback_(buffer_.data(), buffer_.size());
+    }
+    buffer_.clear();
+}
+
+}  // namespace aribcaption
@@ -16,11 +16,33 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <cstddef>
 #include "decoder/b24_codesets.hpp"
 
 namespace aribcaption {
 
-extern const std::unordered_map<uint8_t, CodesetEntry> kGCodesetByF = {
+namespace {
+
+struct FinalByteEntry {
+    uint8_t F;
+    CodesetEntry entry;
+};
+
+template <size_t N>
+constexpr std::array<CodesetEntry, 256> MakeCodesetTable(const FinalByteEntry (&entries)[N]) {
+    std::array<CodesetEntry, 256> table{};
+    // Fill every slot explicitly rather than relying on value-initialization of the array,
+    // which some compilers get wrong for constexpr default constructors
+    for (CodesetEntry& entry : table) {
+        entry = CodesetEntry{};
+    }
+    for (const FinalByteEntry& item : entries) {
+        table[item.F] = item.entry;
+    }
+    return table;
+}
+
+constexpr FinalByteEntry kGCodesets[] = {
     {0x42, kKanjiEntry},
     {0x4a, kAlphanumericEntry},
     {0x4b, kLatinExtensionEntry},
@@ -40,7 +62,7 @@ extern const std::unordered_map<uint8_t, CodesetEntry> kGCodesetByF = {
     {0x3b, kAdditionalSymbolsEntry}
 };
 
-extern const std::unordered_map<uint8_t, CodesetEntry> kDRCSCodesetByF = {
+constexpr FinalByteEntry kDRCSCodesets[] = {
     {0x40, kDRCS0Entry},
     {0x41, kDRCS1Entry},
     {0x42, kDRCS2Entry},
@@ -60,4 +82,41 @@ extern const std::unordered_map<uint8_t, CodesetEntry> kDRCSCodesetByF = {
     {0x70, kMacroEntry},
 };
 
+template <size_t N>
+constexpr bool IsFinalByteDefined(uint8_t F, const FinalByteEntry (&entries)[N]) {
+    for (const FinalByteEntry& item : entries) {
+        if (item.F == F) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Every final byte absent from entries must map to GraphicSet::kNone with no bytes
+template <size_t N>
+constexpr bool IsCodesetTableValid(const std::array<CodesetEntry, 256>& table, const FinalByteEntry (&entries)[N]) {
+    for (size_t F = 0; F < table.size(); F++) {
+        const CodesetEntry& entry = table[F];
+        if (IsFinalByteDefined(static_cast<uint8_t>(F), entries)) {
+            if (entry.graphics_set == GraphicSet::kNone || entry.bytes == 0) {
+                return false;
+            }
+        } else if (entry.graphics_set != GraphicSet::kNone || entry.bytes != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr std::array<CodesetEntry, 256> kGCodesetTable = MakeCodesetTable(kGCodesets);
+constexpr std::array<CodesetEntry, 256> kDRCSCodesetTable = MakeCodesetTable(kDRCSCodesets);
+
+static_assert(IsCodesetTableValid(kGCodesetTable, kGCodesets), "Undefined G set final bytes must map to kNone");
+static_assert(IsCodesetTableValid(kDRCSCodesetTable, kDRCSCodesets), "Undefined DRCS final bytes must map to kNone");
+
+}  // namespace
+
+extern const std::array<CodesetEntry, 256> kGCodesetByF = kGCodesetTable;
+extern const std::array<CodesetEntry, 256> kDRCSCodesetByF = kDRCSCodesetTable;
+
 }  // namespace aribcaption
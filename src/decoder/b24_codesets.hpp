@@ -19,8 +19,8 @@
 #ifndef ARIBCAPTION_B24_CODESETS_HPP
 #define ARIBCAPTION_B24_CODESETS_HPP
 
+#include <array>
 #include <cstdint>
-#include <unordered_map>
 
 namespace aribcaption {
 
@@ -59,13 +59,15 @@ enum class GraphicSet : uint8_t {
     kDRCS_13,
     kDRCS_14,
     kDRCS_15,
-    kMacro
+    kMacro,
+    kNone  // Undefined final byte
 };
 
 struct CodesetEntry {
     GraphicSet graphics_set;
     uint8_t bytes;
 
+    constexpr CodesetEntry() noexcept : graphics_set(GraphicSet::kNone), bytes(0) {}
     constexpr CodesetEntry(GraphicSet set, uint8_t byte_count) noexcept : graphics_set(set), bytes(byte_count) {}
 };
 
@@ -105,9 +107,10 @@ inline constexpr CodesetEntry kDRCS14Entry(GraphicSet::kDRCS_14, 1);
 inline constexpr CodesetEntry kDRCS15Entry(GraphicSet::kDRCS_15, 1);
 inline constexpr CodesetEntry kMacroEntry(GraphicSet::kMacro, 1);
 
+// Indexed by final byte F, entries of undefined F are of GraphicSet::kNone
 // Definitions moved into b24_codesets.cpp due to VS2017 compiler bug
-extern const std::unordered_map<uint8_t, CodesetEntry> kGCodesetByF;
-extern const std::unordered_map<uint8_t, CodesetEntry> kDRCSCodesetByF;
+extern const std::array<CodesetEntry, 256> kGCodesetByF;
+extern const std::array<CodesetEntry, 256> kDRCSCodesetByF;
 
 }  // namespace aribcaption
 
@@ -21,6 +21,8 @@
 
 #include <cstdint>
 #include <unordered_map>
+#include "base/utf_helper.hpp"
+#include "decoder/b24_packed_table.hpp"
 
 namespace aribcaption {
 
@@ -1254,6 +1256,20 @@ inline constexpr uint32_t kKanjiTable[] = {
     0x24eb, 0x24ec, 0x325b, 0xfffd
 };
 
+// Pre-encoded UTF-8 form of the tables above
+inline constexpr auto kAlphanumericTable_Halfwidth_UTF8 = utf::EncodeUTF8Table(kAlphanumericTable_Halfwidth);
+inline constexpr auto kAlphanumericTable_Fullwidth_UTF8 = utf::EncodeUTF8Table(kAlphanumericTable_Fullwidth);
+inline constexpr auto kAlphanumericTable_Latin_UTF8 = utf::EncodeUTF8Table(kAlphanumericTable_Latin);
+inline constexpr auto kLatinExtensionTable_UTF8 = utf::EncodeUTF8Table(kLatinExtensionTable);
+inline constexpr auto kLatinSpecialTable_UTF8 = utf::EncodeUTF8Table(kLatinSpecialTable);
+inline constexpr auto kHiraganaTable_UTF8 = utf::EncodeUTF8Table(kHiraganaTable);
+inline constexpr auto kKatakanaTable_UTF8 = utf::EncodeUTF8Table(kKatakanaTable);
+inline constexpr auto kJISX0201KatakanaTable_UTF8 = utf::EncodeUTF8Table(kJISX0201KatakanaTable);
+inline constexpr auto kKanjiTable_UTF8 = utf::EncodeUTF8Table(kKanjiTable);
+
+// Runtime form of kKanjiTable, half the size of the uint32_t source table
+inline constexpr auto kKanjiTable_Packed = PackCodepointTable<CountNonBMPCodepoints(kKanjiTable)>(kKanjiTable);
+
 }  // namespace aribcaption
 
 #endif  // ARIBCAPTION_B24_CONV_TABLES_HPP
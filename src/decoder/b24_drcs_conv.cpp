@@ -16,12 +16,51 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
+#include <array>
 #include "decoder/b24_drcs_conv.hpp"
 
 namespace aribcaption {
 
+namespace {
+
+struct DRCSReplacementSource {
+    const char* md5;
+    uint32_t ucs4;
+};
+
+struct DRCSReplacement {
+    md5::Digest digest;
+    uint32_t ucs4;
+};
+
+constexpr bool DigestLess(const md5::Digest& a, const md5::Digest& b) {
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i];
+        }
+    }
+    return false;
+}
+
+// Convert hex digests into binary form and sort them by digest, at compile time
+template <size_t N>
+constexpr std::array<DRCSReplacement, N> MakeDRCSReplacementTable(const DRCSReplacementSource (&source)[N]) {
+    std::array<DRCSReplacement, N> table{};
+    for (size_t i = 0; i < N; i++) {
+        DRCSReplacement item{md5::ParseDigest(source[i].md5), source[i].ucs4};
+        size_t j = i;
+        while (j > 0 && DigestLess(item.digest, table[j - 1].digest)) {
+            table[j] = table[j - 1];
+            j--;
+        }
+        table[j] = item;
+    }
+    return table;
+}
+
 // MD5 => UCS4, for common DRCS patterns
-extern const std::unordered_map<std::string, uint32_t> kDRCSReplacementMap = {
+constexpr DRCSReplacementSource kDRCSReplacementSource[] = {
     {"022b6f43e2a414fd68f172da202bac9a", 0x269e},
     {"94fb7be756372db6b62e3e0a119083d5", 0x269e},
     {"12aecdea283e4d07f88b9f2b740e4f86", 0x269f},
@@ -314,4 +353,21 @@ extern const std::unordered_map<std::string, uint32_t> kDRCSReplacementMap = {
     {"ec7b2c805a5ba3d52c281ee2296b94d7", 0x8523},
 };
 
+constexpr auto kDRCSReplacementTable = MakeDRCSReplacementTable(kDRCSReplacementSource);
+
+}  // namespace
+
+uint32_t FindDRCSReplacement(const md5::Digest& digest) {
+    auto iter = std::lower_bound(kDRCSReplacementTable.begin(),
+                                 kDRCSReplacementTable.end(),
+                                 digest,
+                                 [](const DRCSReplacement& item, const md5::Digest& key) {
+                                     return DigestLess(item.digest, key);
+                                 });
+    if (iter == kDRCSReplacementTable.end() || iter->digest != digest) {
+        return 0;
+    }
+    return iter->ucs4;
+}
+
 }  // namespace aribcaption
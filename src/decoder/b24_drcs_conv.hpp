@@ -20,14 +20,14 @@
 #define ARIBCAPTION_B24_DRCS_CONV_HPP
 
 #include <cstdint>
-#include <string>
-#include <unordered_map>
+#include "base/md5_helper.hpp"
 
 namespace aribcaption {
 
 // MD5 => UCS4, for common DRCS patterns
+// Returns 0 if the pattern is unrecognized
 // Definition has been moved into b24_drcs_conv.cpp due to VS2017 compiler bug
-extern const std::unordered_map<std::string, uint32_t> kDRCSReplacementMap;
+uint32_t FindDRCSReplacement(const md5::Digest& digest);
 
 }  // namespace aribcaption
 
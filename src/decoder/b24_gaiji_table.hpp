@@ -20,6 +20,8 @@
 #define ARIBCAPTION_B24_GAIJI_TABLE_HPP
 
 #include <cstdint>
+#include "base/utf_helper.hpp"
+#include "decoder/b24_packed_table.hpp"
 
 namespace aribcaption {
 
@@ -267,6 +269,28 @@ inline constexpr uint32_t kAdditionalSymbolsTable_PUA[] = {
     0x24eb, 0x24ec, 0x325b, 0xfffd
 };
 
+inline constexpr auto kAdditionalSymbolsTable_Unicode_UTF8 = utf::EncodeUTF8Table(kAdditionalSymbolsTable_Unicode);
+
+inline constexpr auto kAdditionalSymbolsTable_Unicode_Packed =
+    PackCodepointTable<CountNonBMPCodepoints(kAdditionalSymbolsTable_Unicode)>(kAdditionalSymbolsTable_Unicode);
+
+// PUA codepoints all lie in the BMP, entries that duplicate the Unicode codepoint or fall outside U+E000..U+F8FF
+// are stored as 0 (non-existent)
+template <size_t N>
+constexpr std::array<uint16_t, N> PackPUATable(const uint32_t (&pua_table)[N], const uint32_t (&unicode_table)[N]) {
+    std::array<uint16_t, N> packed{};
+    for (size_t i = 0; i < N; i++) {
+        uint32_t pua = pua_table[i];
+        if (pua != unicode_table[i] && pua >= 0xE000 && pua <= 0xF8FF) {
+            packed[i] = static_cast<uint16_t>(pua);
+        }
+    }
+    return packed;
+}
+
+inline constexpr auto kAdditionalSymbolsTable_PUA_Packed =
+    PackPUATable(kAdditionalSymbolsTable_PUA, kAdditionalSymbolsTable_Unicode);
+
 }  // namespace aribcaption
 
 #endif  // ARIBCAPTION_B24_GAIJI_TABLE_HPP
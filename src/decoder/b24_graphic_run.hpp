@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_B24_GRAPHIC_RUN_HPP
+#define ARIBCAPTION_B24_GRAPHIC_RUN_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "base/always_inline.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define ARIBCC_B24_SCAN_SSE2 1
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define ARIBCC_B24_SCAN_NEON 1
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#endif
+
+namespace aribcaption {
+
+// GL / GR graphic characters are 0x21~0x7E and 0xA1~0xFE, everything else is a control code or space
+ALWAYS_INLINE bool IsGraphicByte(uint8_t ch) {
+    uint8_t low = ch & 0x7F;
+    return low > 0x20 && low < 0x7F;
+}
+
+// Count of bytes from data that are all GL / GR graphic characters
+inline size_t FindGraphicRunLength(const uint8_t* data, size_t length) {
+    size_t offset = 0;
+
+#if defined(ARIBCC_B24_SCAN_SSE2)
+    const __m128i low_mask = _mm_set1_epi8(0x7F);
+    const __m128i first_graphic = _mm_set1_epi8(0x21);
+    const __m128i del = _mm_set1_epi8(0x7F);
+    for (; offset + 16 <= length; offset += 16) {
+        __m128i low = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset)), low_mask);
+        __m128i control = _mm_or_si128(_mm_cmplt_epi8(low, first_graphic), _mm_cmpeq_epi8(low, del));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(control));
+        if (mask) {
+#ifdef _MSC_VER
+            unsigned long index = 0;
+            _BitScanForward(&index, mask);
+            return offset + index;
+#else
+            return offset + static_cast<size_t>(__builtin_ctz(mask));
+#endif
+        }
+    }
+#elif defined(ARIBCC_B24_SCAN_NEON)
+    const uint8x16_t low_mask = vdupq_n_u8(0x7F);
+    const uint8x16_t first_graphic = vdupq_n_u8(0x21);
+    const uint8x16_t del = vdupq_n_u8(0x7F);
+    for (; offset + 16 <= length; offset += 16) {
+        uint8x16_t low = vandq_u8(vld1q_u8(data + offset), low_mask);
+        uint8x16_t control = vorrq_u8(vcltq_u8(low, first_graphic), vceqq_u8(low, del));
+        // Narrow into 4 bits per byte
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(control), 4)), 0);
+        if (mask) {
+#ifdef _MSC_VER
+            unsigned long index = 0;
+            _BitScanForward64(&index, mask);
+            return offset + index / 4;
+#else
+            return offset + static_cast<size_t>(__builtin_ctzll(mask)) / 4;
+#endif
+        }
+    }
+#endif
+
+    for (; offset < length; offset++) {
+        if (!IsGraphicByte(data[offset])) {
+            break;
+        }
+    }
+    return offset;
+}
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_B24_GRAPHIC_RUN_HPP
@@ -19,27 +19,59 @@
 #ifndef ARIBCAPTION_B24_MACROS_HPP
 #define ARIBCAPTION_B24_MACROS_HPP
 
+#include <array>
 #include <cstdint>
+#include "decoder/b24_codesets.hpp"
 
 namespace aribcaption {
 
-inline constexpr uint8_t kDefaultMacros[][20] = {
-    {0x1B, 0x24, 0x42, 0x1B, 0x29, 0x4A, 0x1B, 0x2A, 0x30, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x24, 0x42, 0x1B, 0x29, 0x31, 0x1B, 0x2A, 0x30, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x24, 0x42, 0x1B, 0x29, 0x20, 0x41, 0x1B, 0x2A, 0x30, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x28, 0x32, 0x1B, 0x29, 0x34, 0x1B, 0x2A, 0x35, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x28, 0x32, 0x1B, 0x29, 0x33, 0x1B, 0x2A, 0x35, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x28, 0x32, 0x1B, 0x29, 0x20, 0x41, 0x1B, 0x2A, 0x35, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x28, 0x20, 0x41, 0x1B, 0x29, 0x20, 0x42, 0x1B, 0x2A, 0x20, 0x43, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x28, 0x20, 0x44, 0x1B, 0x29, 0x20, 0x45, 0x1B, 0x2A, 0x20, 0x46, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x28, 0x20, 0x47, 0x1B, 0x29, 0x20, 0x48, 0x1B, 0x2A, 0x20, 0x49, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x28, 0x20, 0x4A, 0x1B, 0x29, 0x20, 0x4B, 0x1B, 0x2A, 0x20, 0x4C, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x28, 0x20, 0x4D, 0x1B, 0x29, 0x20, 0x4E, 0x1B, 0x2A, 0x20, 0x4F, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x24, 0x42, 0x1B, 0x29, 0x20, 0x42, 0x1B, 0x2A, 0x30, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x24, 0x42, 0x1B, 0x29, 0x20, 0x43, 0x1B, 0x2A, 0x30, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x24, 0x42, 0x1B, 0x29, 0x20, 0x44, 0x1B, 0x2A, 0x30, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x28, 0x31, 0x1B, 0x29, 0x30, 0x1B, 0x2A, 0x4A, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D},
-    {0x1B, 0x28, 0x4A, 0x1B, 0x29, 0x32, 0x1B, 0x2A, 0x20, 0x41, 0x1B, 0x2B, 0x20, 0x70, 0x0F, 0x1B, 0x7D}
+/**
+ * Designations performed by a default macro
+ *
+ * Every default macro defined in ARIB STD-B24, Volume 1, Part 2 designates G0 ~ G3 (G3 as the macro set),
+ * then invokes G0 into GL by LS0 and G2 into GR by LS2R.
+ * They are stored pre-expanded, so that a macro could be applied without parsing its byte sequence,
+ * which is kept above each entry for reference.
+ */
+struct MacroDesignation {
+    std::array<CodesetEntry, 4> GX;
+    uint8_t GL_index;
+    uint8_t GR_index;
+};
+
+inline constexpr MacroDesignation kDefaultMacros[] = {
+    // 1B 24 42 1B 29 4A 1B 2A 30 1B 2B 20 70 0F 1B 7D
+    {{kKanjiEntry, kAlphanumericEntry, kHiraganaEntry, kMacroEntry}, 0, 2},
+    // 1B 24 42 1B 29 31 1B 2A 30 1B 2B 20 70 0F 1B 7D
+    {{kKanjiEntry, kKatakanaEntry, kHiraganaEntry, kMacroEntry}, 0, 2},
+    // 1B 24 42 1B 29 20 41 1B 2A 30 1B 2B 20 70 0F 1B 7D
+    {{kKanjiEntry, kDRCS1Entry, kHiraganaEntry, kMacroEntry}, 0, 2},
+    // 1B 28 32 1B 29 34 1B 2A 35 1B 2B 20 70 0F 1B 7D
+    {{kMosaicAEntry, kMosaicCEntry, kMosaicDEntry, kMacroEntry}, 0, 2},
+    // 1B 28 32 1B 29 33 1B 2A 35 1B 2B 20 70 0F 1B 7D
+    {{kMosaicAEntry, kMosaicBEntry, kMosaicDEntry, kMacroEntry}, 0, 2},
+    // 1B 28 32 1B 29 20 41 1B 2A 35 1B 2B 20 70 0F 1B 7D
+    {{kMosaicAEntry, kDRCS1Entry, kMosaicDEntry, kMacroEntry}, 0, 2},
+    // 1B 28 20 41 1B 29 20 42 1B 2A 20 43 1B 2B 20 70 0F 1B 7D
+    {{kDRCS1Entry, kDRCS2Entry, kDRCS3Entry, kMacroEntry}, 0, 2},
+    // 1B 28 20 44 1B 29 20 45 1B 2A 20 46 1B 2B 20 70 0F 1B 7D
+    {{kDRCS4Entry, kDRCS5Entry, kDRCS6Entry, kMacroEntry}, 0, 2},
+    // 1B 28 20 47 1B 29 20 48 1B 2A 20 49 1B 2B 20 70 0F 1B 7D
+    {{kDRCS7Entry, kDRCS8Entry, kDRCS9Entry, kMacroEntry}, 0, 2},
+    // 1B 28 20 4A 1B 29 20 4B 1B 2A 20 4C 1B 2B 20 70 0F 1B 7D
+    {{kDRCS10Entry, kDRCS11Entry, kDRCS12Entry, kMacroEntry}, 0, 2},
+    // 1B 28 20 4D 1B 29 20 4E 1B 2A 20 4F 1B 2B 20 70 0F 1B 7D
+    {{kDRCS13Entry, kDRCS14Entry, kDRCS15Entry, kMacroEntry}, 0, 2},
+    // 1B 24 42 1B 29 20 42 1B 2A 30 1B 2B 20 70 0F 1B 7D
+    {{kKanjiEntry, kDRCS2Entry, kHiraganaEntry, kMacroEntry}, 0, 2},
+    // 1B 24 42 1B 29 20 43 1B 2A 30 1B 2B 20 70 0F 1B 7D
+    {{kKanjiEntry, kDRCS3Entry, kHiraganaEntry, kMacroEntry}, 0, 2},
+    // 1B 24 42 1B 29 20 44 1B 2A 30 1B 2B 20 70 0F 1B 7D
+    {{kKanjiEntry, kDRCS4Entry, kHiraganaEntry, kMacroEntry}, 0, 2},
+    // 1B 28 31 1B 29 30 1B 2A 4A 1B 2B 20 70 0F 1B 7D
+    {{kKatakanaEntry, kHiraganaEntry, kAlphanumericEntry, kMacroEntry}, 0, 2},
+    // 1B 28 4A 1B 29 32 1B 2A 20 41 1B 2B 20 70 0F 1B 7D
+    {{kAlphanumericEntry, kMosaicAEntry, kDRCS1Entry, kMacroEntry}, 0, 2}
 };
 
 }  // namespace aribcaption
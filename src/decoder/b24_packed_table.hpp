@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_B24_PACKED_TABLE_HPP
+#define ARIBCAPTION_B24_PACKED_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace aribcaption {
+
+// Codepoint table packed into 16-bit entries
+//
+// Nearly every codepoint used by ARIB STD-B24 lies in the BMP, so entries hold the codepoint directly.
+// The few non-BMP codepoints are moved into a small exception list, and their entries hold 0xD800 + index
+// into that list instead. UTF-16 surrogates never appear as codepoints so the two ranges can't collide.
+template <size_t N, size_t E>
+struct PackedCodepointTable {
+    static constexpr uint16_t kExceptionBase = 0xD800;
+    static constexpr size_t kMaxExceptions = 0x800;
+    static_assert(E < kMaxExceptions, "Too many non-BMP codepoints for a packed table");
+
+    uint16_t entries[N]{};
+    uint32_t exceptions[E > 0 ? E : 1]{};
+
+    [[nodiscard]]
+    constexpr uint32_t operator[](size_t index) const {
+        uint16_t entry = entries[index];
+        if ((entry & 0xF800) == kExceptionBase) {
+            return exceptions[entry - kExceptionBase];
+        }
+        return entry;
+    }
+
+    [[nodiscard]]
+    static constexpr size_t size() { return N; }
+};
+
+template <size_t N>
+constexpr size_t CountNonBMPCodepoints(const uint32_t (&table)[N]) {
+    size_t count = 0;
+    for (size_t i = 0; i < N; i++) {
+        if (table[i] > 0xFFFF) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Pack a whole codepoint table at compile time, E must be CountNonBMPCodepoints(table)
+template <size_t E, size_t N>
+constexpr PackedCodepointTable<N, E> PackCodepointTable(const uint32_t (&table)[N]) {
+    PackedCodepointTable<N, E> packed{};
+    size_t exception_count = 0;
+    for (size_t i = 0; i < N; i++) {
+        uint32_t ucs4 = table[i];
+        if (ucs4 > 0xFFFF) {
+            packed.exceptions[exception_count] = ucs4;  // Out of bounds (not a constant expression) if E is too small
+            packed.entries[i] = static_cast<uint16_t>(PackedCodepointTable<N, E>::kExceptionBase + exception_count);
+            exception_count++;
+        } else {
+            packed.entries[i] = static_cast<uint16_t>(ucs4);
+        }
+    }
+    return packed;
+}
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_B24_PACKED_TABLE_HPP
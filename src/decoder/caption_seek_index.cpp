@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include "aribcaption/caption_seek_index.hpp"
+#include "base/binary_io.hpp"
+#include "base/mapped_file.hpp"
+
+#if defined(_WIN32)
+    #include "base/wchar_helper.hpp"
+#endif
+
+namespace aribcaption {
+
+namespace {
+
+constexpr uint32_t kIndexMagic = 0x49534341;  // "ACSI"
+constexpr uint32_t kIndexVersion = 1;
+
+uint64_t HashState(const std::vector<uint8_t>& state) {
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint8_t byte : state) {
+        hash ^= byte;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+FILE* OpenFile(const std::string& filename, const char* mode) {
+#if defined(_WIN32)
+    std::wstring wide_mode(mode, mode + strlen(mode));
+    return _wfopen(wchar::UTF8ToWideString(filename).c_str(), wide_mode.c_str());
+#else
+    return fopen(filename.c_str(), mode);
+#endif
+}
+
+}  // namespace
+
+CaptionSeekIndex::CaptionSeekIndex() = default;
+
+CaptionSeekIndex::~CaptionSeekIndex() = default;
+
+CaptionSeekIndex::CaptionSeekIndex(const CaptionSeekIndex&) = default;
+
+CaptionSeekIndex::CaptionSeekIndex(CaptionSeekIndex&&) noexcept = default;
+
+CaptionSeekIndex& CaptionSeekIndex::operator=(const CaptionSeekIndex&) = default;
+
+CaptionSeekIndex& CaptionSeekIndex::operator=(CaptionSeekIndex&&) noexcept = default;
+
+bool CaptionSeekIndex::Append(int64_t pts, uint64_t file_offset, const std::vector<uint8_t>& state) {
+    if (!points_.empty() && pts < points_.back().pts) {
+        return false;
+    }
+
+    uint64_t hash = HashState(state);
+    auto [begin, end] = state_lookup_.equal_range(hash);
+    auto iter = std::find_if(begin, end, [&](const auto& pair) { return states_[pair.second] == state; });
+
+    uint32_t state_index = 0;
+    if (iter != end) {
+        state_index = iter->second;
+    } else {
+        state_index = static_cast<uint32_t>(states_.size());
+        states_.push_back(state);
+        state_lookup_.emplace(hash, state_index);
+    }
+
+    points_.push_back(CaptionSeekPoint{pts, file_offset, state_index});
+    return true;
+}
+
+const CaptionSeekPoint* CaptionSeekIndex::FindSeekPoint(int64_t pts) const {
+    auto iter = std::upper_bound(points_.begin(), points_.end(), pts,
+                                 [](int64_t value, const CaptionSeekPoint& point) { return value < point.pts; });
+    if (iter == points_.begin()) {
+        return nullptr;
+    }
+    return &*std::prev(iter);
+}
+
+bool CaptionSeekIndex::Seek(int64_t pts, Decoder& decoder, uint64_t& out_file_offset) const {
+    if (points_.empty()) {
+        return false;
+    }
+
+    const CaptionSeekPoint* point = FindSeekPoint(pts);
+    if (!point) {
+        // Earlier than any caption, start over from the first seek point
+        point = &points_.front();
+    }
+
+    const std::vector<uint8_t>& state = states_[point->state_index];
+    if (!decoder.RestoreState(state.data(), state.size())) {
+        return false;
+    }
+    out_file_offset = point->file_offset;
+    return true;
+}
+
+const std::vector<uint8_t>& CaptionSeekIndex::GetState(const CaptionSeekPoint& point) const {
+    return states_[point.state_index];
+}
+
+void CaptionSeekIndex::Clear() {
+    points_.clear();
+    states_.clear();
+    state_lookup_.clear();
+}
+
+void CaptionSeekIndex::Serialize(std::vector<uint8_t>& out_data) const {
+    out_data.clear();
+    BinaryWriter writer(out_data);
+
+    writer.WriteU32(kIndexMagic);
+    writer.WriteU32(kIndexVersion);
+
+    writer.WriteVarUInt(states_.size());
+    for (const std::vector<uint8_t>& state : states_) {
+        writer.WriteVarUInt(state.size());
+        writer.WriteBytes(state.data(), state.size());
+    }
+
+    // Seek points are delta coded, most of them take only a few bytes
+    writer.WriteVarUInt(points_.size());
+    int64_t prev_pts = 0;
+    uint64_t prev_offset = 0;
+    for (const CaptionSeekPoint& point : points_) {
+        writer.WriteVarInt(point.pts - prev_pts);
+        writer.WriteVarInt(static_cast<int64_t>(point.file_offset - prev_offset));
+        writer.WriteVarUInt(point.state_index);
+        prev_pts = point.pts;
+        prev_offset = point.file_offset;
+    }
+}
+
+bool CaptionSeekIndex::Deserialize(const uint8_t* data, size_t size) {
+    BinaryReader reader(data, size);
+    if (reader.ReadU32() != kIndexMagic || reader.ReadU32() != kIndexVersion) {
+        return false;
+    }
+
+    CaptionSeekIndex index;
+
+    uint64_t state_count = reader.ReadVarUInt();
+    if (state_count > reader.remaining()) {
+        return false;
+    }
+    index.states_.reserve(static_cast<size_t>(state_count));
+    for (uint64_t i = 0; i < state_count; i++) {
+        auto state_size = static_cast<size_t>(reader.ReadVarUInt());
+        const uint8_t* state = reader.ReadBytes(state_size);
+        if (!state) {
+            return false;
+        }
+        index.states_.emplace_back(state, state + state_size);
+        index.state_lookup_.emplace(HashState(index.states_.back()), static_cast<uint32_t>(i));
+    }
+
+    uint64_t point_count = reader.ReadVarUInt();
+    if (point_count > reader.remaining()) {
+        return false;
+    }
+    index.points_.reserve(static_cast<size_t>(point_count));
+    int64_t pts = 0;
+    uint64_t offset = 0;
+    for (uint64_t i = 0; i < point_count; i++) {
+        int64_t pts_delta = reader.ReadVarInt();
+        offset += static_cast<uint64_t>(reader.ReadVarInt());
+        uint64_t state_index = reader.ReadVarUInt();
+        if (!reader.ok() || pts_delta < 0 || state_index >= state_count) {
+            return false;
+        }
+        pts += pts_delta;
+        index.points_.push_back(CaptionSeekPoint{pts, offset, static_cast<uint32_t>(state_index)});
+    }
+
+    if (!reader.ok()) {
+        return false;
+    }
+    *this = std::move(index);
+    return true;
+}
+
+bool CaptionSeekIndex::SaveToFile(const std::string& filename) const {
+    std::vector<uint8_t> data;
+    Serialize(data);
+
+    FILE* file = OpenFile(filename, "wb");
+    if (!file) {
+        return false;
+    }
+    bool succeeded = fwrite(data.data(), 1, data.size(), file) == data.size();
+    succeeded = fclose(file) == 0 && succeeded;
+    return succeeded;
+}
+
+bool CaptionSeekIndex::LoadFromFile(const std::string& filename) {
+    MappedFile file;
+    if (!file.Open(filename)) {
+        return false;
+    }
+    return Deserialize(file.data(), file.size());
+}
+
+}  // namespace aribcaption
@@ -53,6 +53,38 @@ void Decoder::SetReplaceMSZFullWidthAlphanumeric(bool replace) {
     pimpl_->SetReplaceMSZFullWidthAlphanumeric(replace);
 }
 
+void Decoder::SetReuseCaptionStorage(bool reuse) {
+    pimpl_->SetReuseCaptionStorage(reuse);
+}
+
+void Decoder::SetTextOnly(bool text_only) {
+    pimpl_->SetTextOnly(text_only);
+}
+
+void Decoder::SetGenerateCaptionText(bool generate) {
+    pimpl_->SetGenerateCaptionText(generate);
+}
+
+void Decoder::SetGenerateCharUTF8(bool generate) {
+    pimpl_->SetGenerateCharUTF8(generate);
+}
+
+void Decoder::SetDecodeAllLanguages(bool enable) {
+    pimpl_->SetDecodeAllLanguages(enable);
+}
+
+void Decoder::SetDecodeLimits(const DecodeLimits& limits) {
+    pimpl_->SetDecodeLimits(limits);
+}
+
+void Decoder::SetDeduplicateCaptions(bool enable) {
+    pimpl_->SetDeduplicateCaptions(enable);
+}
+
+bool Decoder::SetCaptureFile(const std::string& filename) {
+    return pimpl_->SetCaptureFile(filename);
+}
+
 uint32_t Decoder::QueryISO6392LanguageCode(LanguageId language_id) const {
     return pimpl_->QueryISO6392LanguageCode(language_id);
 }
@@ -61,8 +93,30 @@ DecodeStatus Decoder::Decode(const uint8_t* pes_data, size_t length, int64_t pts
     return pimpl_->Decode(pes_data, length, pts, out_result);
 }
 
+DecodeStatus Decoder::DecodeBatch(const DecodePacket* packets, size_t count, DecodeBatchResult& out_result) {
+    return pimpl_->DecodeBatch(packets, count, out_result);
+}
+
+DecodeStatus Decoder::DecodeArchive(const DecodePacket* packets, size_t count, DecodeBatchResult& out_result,
+                                    size_t thread_count) {
+    return pimpl_->DecodeArchive(packets, count, thread_count, out_result);
+}
+
+DecodeStatus Decoder::Feed(const uint8_t* data, size_t length, int64_t pts, bool packet_start,
+                           DecodeResult& out_result) {
+    return pimpl_->Feed(data, length, pts, packet_start, out_result);
+}
+
 void Decoder::Flush() {
     pimpl_->Flush();
 }
 
+void Decoder::SaveState(std::vector<uint8_t>& out_state) const {
+    pimpl_->SaveState(out_state);
+}
+
+bool Decoder::RestoreState(const uint8_t* data, size_t size) {
+    return pimpl_->RestoreState(data, size);
+}
+
 }  // namespace aribcaption
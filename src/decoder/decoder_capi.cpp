@@ -75,12 +75,54 @@ void aribcc_decoder_set_replace_msz_fullwidth_ascii(aribcc_decoder_t* decoder, b
     impl->SetReplaceMSZFullWidthAlphanumeric(replace);
 }
 
+void aribcc_decoder_set_text_only(aribcc_decoder_t* decoder, bool text_only) {
+    auto impl = reinterpret_cast<DecoderImpl*>(decoder);
+    impl->SetTextOnly(text_only);
+}
+
+void aribcc_decoder_set_generate_caption_text(aribcc_decoder_t* decoder, bool generate) {
+    auto impl = reinterpret_cast<DecoderImpl*>(decoder);
+    impl->SetGenerateCaptionText(generate);
+}
+
+void aribcc_decoder_set_generate_char_utf8(aribcc_decoder_t* decoder, bool generate) {
+    auto impl = reinterpret_cast<DecoderImpl*>(decoder);
+    impl->SetGenerateCharUTF8(generate);
+}
+
+void aribcc_decoder_set_decode_all_languages(aribcc_decoder_t* decoder, bool enable) {
+    auto impl = reinterpret_cast<DecoderImpl*>(decoder);
+    impl->SetDecodeAllLanguages(enable);
+}
+
+void aribcc_decoder_set_decode_limits(aribcc_decoder_t* decoder, const aribcc_decode_limits_t* limits) {
+    auto impl = reinterpret_cast<DecoderImpl*>(decoder);
+    DecodeLimits decode_limits;
+    decode_limits.max_pes_bytes = limits->max_pes_bytes;
+    decode_limits.max_chars_per_caption = limits->max_chars_per_caption;
+    decode_limits.max_regions_per_caption = limits->max_regions_per_caption;
+    decode_limits.max_decode_steps = limits->max_decode_steps;
+    impl->SetDecodeLimits(decode_limits);
+}
+
+void aribcc_decoder_set_deduplicate_captions(aribcc_decoder_t* decoder, bool enable) {
+    auto impl = reinterpret_cast<DecoderImpl*>(decoder);
+    impl->SetDeduplicateCaptions(enable);
+}
+
+bool aribcc_decoder_set_capture_file(aribcc_decoder_t* decoder, const char* filename) {
+    auto impl = reinterpret_cast<DecoderImpl*>(decoder);
+    return impl->SetCaptureFile(filename ? filename : "");
+}
+
 uint32_t aribcc_decoder_query_iso6392_language_code(aribcc_decoder_t* decoder, aribcc_languageid_t language_id) {
     auto impl = reinterpret_cast<DecoderImpl*>(decoder);
     return impl->QueryISO6392LanguageCode(static_cast<LanguageId>(language_id));
 }
 
-static void ConvertCaptionRegionToCAPI(const CaptionRegion& region, aribcc_caption_region_t* out_region) {
+static void ConvertCaptionRegionToCAPI(const CaptionRegion& region,
+                                       const MemoryAllocator& allocator,
+                                       aribcc_caption_region_t* out_region) {
     out_region->x = region.x;
     out_region->y = region.y;
     out_region->width = region.width;
@@ -91,7 +133,7 @@ static void ConvertCaptionRegionToCAPI(const CaptionRegion& region, aribcc_capti
 
     if (!region.chars.empty()) {
         out_region->chars = reinterpret_cast<aribcc_caption_char_t*>(
-            calloc(out_region->char_count, sizeof(aribcc_caption_char_t))
+            allocator.AllocateZeroed(out_region->char_count * sizeof(aribcc_caption_char_t))
         );
     }
 
@@ -100,7 +142,7 @@ static void ConvertCaptionRegionToCAPI(const CaptionRegion& region, aribcc_capti
     }
 }
 
-static void ConvertCaptionToCAPI(Caption&& caption, aribcc_caption_t* out_caption) {
+static void ConvertCaptionPropertiesToCAPI(const Caption& caption, aribcc_caption_t* out_caption) {
     out_caption->type = static_cast<aribcc_captiontype_t>(caption.type);
     out_caption->flags = static_cast<aribcc_captionflags_t>(caption.flags);
     out_caption->iso6392_language_code = caption.iso6392_language_code;
@@ -110,27 +152,31 @@ static void ConvertCaptionToCAPI(Caption&& caption, aribcc_caption_t* out_captio
     out_caption->plane_height = caption.plane_height;
     out_caption->has_builtin_sound = caption.has_builtin_sound;
     out_caption->builtin_sound_id = caption.builtin_sound_id;
+}
+
+static void ConvertCaptionToCAPI(Caption&& caption, const MemoryAllocator& allocator, aribcc_caption_t* out_caption) {
+    ConvertCaptionPropertiesToCAPI(caption, out_caption);
 
     if (!caption.text.empty()) {
-        out_caption->text = reinterpret_cast<char*>(malloc(caption.text.length() + 1));
+        out_caption->text = reinterpret_cast<char*>(allocator.Allocate(caption.text.length() + 1));
         strcpy(out_caption->text, caption.text.c_str());
     }
 
     if (!caption.regions.empty()) {
         out_caption->region_count = static_cast<uint32_t>(caption.regions.size());
         out_caption->regions = reinterpret_cast<aribcc_caption_region_t*>(
-            calloc(out_caption->region_count, sizeof(aribcc_caption_region_t))
+            allocator.AllocateZeroed(out_caption->region_count * sizeof(aribcc_caption_region_t))
         );
     }
 
     for (size_t i = 0; i < out_caption->region_count; i++) {
         auto& src = caption.regions[i];
         aribcc_caption_region_t* dst = &out_caption->regions[i];
-        ConvertCaptionRegionToCAPI(src, dst);
+        ConvertCaptionRegionToCAPI(src, allocator, dst);
     }
 
     if (!caption.drcs_map.empty()) {
-        auto drcs_map = new(std::nothrow) std::unordered_map<uint32_t, DRCS>(std::move(caption.drcs_map));
+        auto drcs_map = new(std::nothrow) DRCSMap(std::move(caption.drcs_map));
         out_caption->drcs_map = reinterpret_cast<aribcc_drcsmap_t*>(drcs_map);
     }
 }
@@ -151,7 +197,182 @@ aribcc_decode_status_t aribcc_decoder_decode(aribcc_decoder_t* decoder,
 
     if (status == DecodeStatus::kGotCaption) {
         Caption* caption = result.caption.get();
-        ConvertCaptionToCAPI(std::move(*caption), out_caption);
+        ConvertCaptionToCAPI(std::move(*caption), impl->allocator(), out_caption);
+    } else if (status == DecodeStatus::kGotDuplicateCaption) {
+        out_caption->pts = result.duplicate_pts;
+        out_caption->wait_duration = result.duplicate_duration;
+    }
+
+    return static_cast<aribcc_decode_status_t>(status);
+}
+
+aribcc_decode_status_t aribcc_decoder_decode_handle(aribcc_decoder_t* decoder,
+                                                    const uint8_t* pes_data,
+                                                    size_t length,
+                                                    int64_t pts,
+                                                    aribcc_caption_handle_t** out_caption) {
+    auto impl = reinterpret_cast<DecoderImpl*>(decoder);
+
+    DecodeResult result;
+    auto status = impl->Decode(pes_data, length, pts, result);
+
+    *out_caption = nullptr;
+    if (status == DecodeStatus::kGotCaption) {
+        *out_caption = reinterpret_cast<aribcc_caption_handle_t*>(result.caption.release());
+    }
+
+    return static_cast<aribcc_decode_status_t>(status);
+}
+
+// Lay out all captions of the batch into one contiguous buffer: [captions][regions][chars][packet indices][texts]
+static void ConvertBatchResultToCAPI(DecodeBatchResult& result,
+                                     const MemoryAllocator& allocator,
+                                     aribcc_decode_batch_result_t* out_result) {
+    size_t caption_count = result.captions.size();
+    size_t region_count = 0;
+    size_t char_count = 0;
+    size_t text_bytes = 0;
+
+    for (const Caption& caption : result.captions) {
+        region_count += caption.regions.size();
+        for (const CaptionRegion& region : caption.regions) {
+            char_count += region.chars.size();
+        }
+        if (!caption.text.empty()) {
+            text_bytes += caption.text.length() + 1;
+        }
+    }
+
+    out_result->caption_count = static_cast<uint32_t>(caption_count);
+    out_result->error_count = static_cast<uint32_t>(result.error_count);
+    if (!caption_count) {
+        return;
+    }
+
+    size_t buffer_size = caption_count * sizeof(aribcc_caption_t) +
+                         region_count * sizeof(aribcc_caption_region_t) +
+                         char_count * sizeof(aribcc_caption_char_t) +
+                         caption_count * sizeof(uint32_t) +
+                         text_bytes;
+    auto buffer = reinterpret_cast<uint8_t*>(allocator.AllocateZeroed(buffer_size));
+    if (!buffer) {
+        out_result->caption_count = 0;
+        return;
+    }
+
+    auto captions = reinterpret_cast<aribcc_caption_t*>(buffer);
+    auto regions = reinterpret_cast<aribcc_caption_region_t*>(captions + caption_count);
+    auto chars = reinterpret_cast<aribcc_caption_char_t*>(regions + region_count);
+    auto packet_indices = reinterpret_cast<uint32_t*>(chars + char_count);
+    auto texts = reinterpret_cast<char*>(packet_indices + caption_count);
+
+    for (size_t i = 0; i < caption_count; i++) {
+        Caption& caption = result.captions[i];
+        aribcc_caption_t* out_caption = &captions[i];
+        ConvertCaptionPropertiesToCAPI(caption, out_caption);
+        packet_indices[i] = static_cast<uint32_t>(result.packet_indices[i]);
+
+        if (!caption.text.empty()) {
+            out_caption->text = texts;
+            memcpy(texts, caption.text.c_str(), caption.text.length() + 1);
+            texts += caption.text.length() + 1;
+        }
+
+        if (!caption.regions.empty()) {
+            out_caption->regions = regions;
+            out_caption->region_count = static_cast<uint32_t>(caption.regions.size());
+        }
+
+        for (const CaptionRegion& region : caption.regions) {
+            regions->x = region.x;
+            regions->y = region.y;
+            regions->width = region.width;
+            regions->height = region.height;
+            regions->is_ruby = region.is_ruby;
+            regions->char_count = static_cast<uint32_t>(region.chars.size());
+            if (!region.chars.empty()) {
+                regions->chars = chars;
+                memcpy(chars, region.chars.data(), region.chars.size() * sizeof(aribcc_caption_char_t));
+                chars += region.chars.size();
+            }
+            regions++;
+        }
+
+        if (!caption.drcs_map.empty()) {
+            auto drcs_map = new(std::nothrow) DRCSMap(std::move(caption.drcs_map));
+            out_caption->drcs_map = reinterpret_cast<aribcc_drcsmap_t*>(drcs_map);
+        }
+    }
+
+    out_result->captions = captions;
+    out_result->packet_indices = packet_indices;
+}
+
+aribcc_decode_status_t aribcc_decoder_decode_batch(aribcc_decoder_t* decoder,
+                                                   const aribcc_decode_packet_t* packets,
+                                                   size_t packet_count,
+                                                   aribcc_decode_batch_result_t* out_result) {
+    static_assert(sizeof(aribcc_decode_packet_t) == sizeof(DecodePacket));
+
+    auto impl = reinterpret_cast<DecoderImpl*>(decoder);
+    DecodeBatchResult& result = impl->capi_batch_result();
+
+    auto status = impl->DecodeBatch(reinterpret_cast<const DecodePacket*>(packets), packet_count, result);
+
+    memset(out_result, 0, sizeof(*out_result));
+    ConvertBatchResultToCAPI(result, impl->allocator(), out_result);
+
+    return static_cast<aribcc_decode_status_t>(status);
+}
+
+aribcc_decode_status_t aribcc_decoder_decode_archive(aribcc_decoder_t* decoder,
+                                                     const aribcc_decode_packet_t* packets,
+                                                     size_t packet_count,
+                                                     size_t thread_count,
+                                                     aribcc_decode_batch_result_t* out_result) {
+    auto impl = reinterpret_cast<DecoderImpl*>(decoder);
+    DecodeBatchResult& result = impl->capi_batch_result();
+
+    auto status = impl->DecodeArchive(reinterpret_cast<const DecodePacket*>(packets), packet_count,
+                                      thread_count, result);
+
+    memset(out_result, 0, sizeof(*out_result));
+    ConvertBatchResultToCAPI(result, impl->allocator(), out_result);
+
+    return static_cast<aribcc_decode_status_t>(status);
+}
+
+void aribcc_decode_batch_result_cleanup(aribcc_decode_batch_result_t* result) {
+    for (uint32_t i = 0; i < result->caption_count; i++) {
+        if (result->captions[i].drcs_map) {
+            aribcc_drcsmap_free(result->captions[i].drcs_map);
+        }
+    }
+
+    // Regions, chars and texts live inside the same buffer
+    MemoryAllocator::Free(result->captions);
+    memset(result, 0, sizeof(*result));
+}
+
+aribcc_decode_status_t aribcc_decoder_feed(aribcc_decoder_t* decoder,
+                                           const uint8_t* data,
+                                           size_t length,
+                                           int64_t pts,
+                                           bool packet_start,
+                                           aribcc_caption_t* out_caption) {
+    auto impl = reinterpret_cast<DecoderImpl*>(decoder);
+
+    DecodeResult result;
+    auto status = impl->Feed(data, length, pts, packet_start, result);
+
+    memset(out_caption, 0, sizeof(*out_caption));
+
+    if (status == DecodeStatus::kGotCaption) {
+        Caption* caption = result.caption.get();
+        ConvertCaptionToCAPI(std::move(*caption), impl->allocator(), out_caption);
+    } else if (status == DecodeStatus::kGotDuplicateCaption) {
+        out_caption->pts = result.duplicate_pts;
+        out_caption->wait_duration = result.duplicate_duration;
     }
 
     return static_cast<aribcc_decode_status_t>(status);
@@ -16,24 +16,38 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstring>
 #include <cmath>
+#include <thread>
 #include "base/logger.hpp"
 #include "base/md5_helper.hpp"
 #include "base/utf_helper.hpp"
+#include "base/xxhash.hpp"
 #include "decoder/b24_codesets.hpp"
 #include "decoder/b24_colors.hpp"
 #include "decoder/b24_controlsets.hpp"
 #include "decoder/b24_conv_tables.hpp"
 #include "decoder/b24_drcs_conv.hpp"
+#include "decoder/b24_graphic_run.hpp"
 #include "decoder/b24_gaiji_table.hpp"
 #include "decoder/b24_macros.hpp"
 #include "decoder/decoder_impl.hpp"
 
 namespace aribcaption::internal {
 
-DecoderImpl::DecoderImpl(Context& context) : log_(GetContextLogger(context)) {}
+DecoderImpl::DecoderImpl(Context& context)
+    : context_(context),
+      log_(GetContextLogger(context)),
+      allocator_(GetContextAllocator(context)),
+      metrics_(GetContextMetrics(context)),
+      tracer_(GetContextTracer(context)) {
+    for (size_t i = 0; i < GX_.size(); i++) {
+        DesignateGraphicSet(i, GX_[i]);
+    }
+}
 
 DecoderImpl::~DecoderImpl() = default;
 
@@ -47,6 +61,7 @@ bool DecoderImpl::Initialize(EncodingScheme encoding_scheme,
     profile_ = profile;
     language_id_ = language_id;
     ResetInternalState();
+    last_management_data_.clear();
     return true;
 }
 
@@ -79,10 +94,68 @@ void DecoderImpl::SwitchLanguage(LanguageId language_id) {
     }
 }
 
+void DecoderImpl::SetDecodeAllLanguages(bool enable) {
+    if (decode_all_languages_ == enable) {
+        return;
+    }
+    if (!enable) {
+        // Continue with the writing states of the indicated language
+        SwitchStatementLanguage(language_id_);
+    }
+    decode_all_languages_ = enable;
+    statement_language_ = language_id_;
+    language_states_.fill(std::nullopt);
+}
+
 void DecoderImpl::SetReplaceMSZFullWidthAlphanumeric(bool replace) {
     replace_msz_fullwidth_ascii_ = replace;
 }
 
+void DecoderImpl::SetDeduplicateCaptions(bool enable) {
+    deduplicate_captions_ = enable;
+    has_last_caption_ = false;
+}
+
+bool DecoderImpl::SetCaptureFile(const std::string& filename) {
+    capture_writer_.reset();
+    if (filename.empty()) {
+        return true;
+    }
+
+    auto writer = std::make_unique<PESCaptureWriter>();
+    if (!writer->Open(filename)) {
+        log_->e("DecoderImpl: Cannot create capture file %s", filename.c_str());
+        return false;
+    }
+    capture_writer_ = std::move(writer);
+    return true;
+}
+
+void DecoderImpl::CapturePacket(const uint8_t* pes_data, size_t length, int64_t pts) {
+    PESCaptureRecord record;
+    record.pts = pts;
+    record.type = type_;
+    record.profile = profile_;
+    record.encoding_scheme = request_encoding_;
+    record.language_id = language_id_;
+    record.data = pes_data;
+    record.length = length;
+    if (!capture_writer_->Write(record)) {
+        log_->e("DecoderImpl: Writing capture file failed, capturing stopped");
+        capture_writer_.reset();
+    }
+}
+
+void DecoderImpl::SetReuseCaptionStorage(bool reuse) {
+    reuse_caption_storage_ = reuse;
+    if (!reuse) {
+        spare_region_chars_.clear();
+        spare_region_chars_.shrink_to_fit();
+        spare_drcs_nodes_.clear();
+        spare_drcs_nodes_.shrink_to_fit();
+    }
+}
+
 uint32_t DecoderImpl::QueryISO6392LanguageCode(LanguageId language_id) const {
     if (language_infos_.empty()) {
         return current_iso6392_language_code_;
@@ -99,6 +172,297 @@ uint32_t DecoderImpl::QueryISO6392LanguageCode(LanguageId language_id) const {
 }
 
 DecodeStatus DecoderImpl::Decode(const uint8_t* pes_data, size_t length, int64_t pts, DecodeResult& out_result) {
+    return DecodePES(pes_data, length, pts, out_result, reuse_caption_storage_);
+}
+
+DecodeStatus DecoderImpl::DecodeBatch(const DecodePacket* packets, size_t count, DecodeBatchResult& out_result) {
+    size_t caption_count = 0;
+    out_result.packet_indices.clear();
+    out_result.error_count = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const DecodePacket& packet = packets[i];
+        DecodeStatus status = DecodePES(packet.data, packet.length, packet.pts, batch_result_, true);
+        if (status == DecodeStatus::kError) {
+            out_result.error_count++;
+            continue;
+        } else if (status != DecodeStatus::kGotCaption) {
+            continue;
+        }
+
+        // Swap with the caption left from previous batch, so that its storage gets recycled
+        if (caption_count < out_result.captions.size()) {
+            std::swap(out_result.captions[caption_count], *batch_result_.caption);
+        } else {
+            out_result.captions.push_back(std::move(*batch_result_.caption));
+        }
+        out_result.packet_indices.push_back(i);
+        caption_count++;
+    }
+
+    out_result.captions.resize(caption_count);
+
+    if (caption_count) {
+        return DecodeStatus::kGotCaption;
+    } else if (out_result.error_count) {
+        return DecodeStatus::kError;
+    }
+    return DecodeStatus::kNoCaption;
+}
+
+// Locate caption management data carried by the PES data, false if it's caption statement data or malformed
+static bool GetManagementDataGroup(const DecodePacket& packet, CaptionType type, int* group,
+                                   const uint8_t** payload, size_t* size) {
+    const uint8_t* data = packet.data;
+    if (!data || packet.length < 3 || data[0] != static_cast<uint8_t>(type) || data[1] != 0xFF) {
+        return false;
+    }
+    size_t data_group_begin = 3 + (data[2] & 0x0F);
+    if (data_group_begin + 5 > packet.length) {
+        return false;
+    }
+    uint8_t data_group_id = (data[data_group_begin] & 0b11111100) >> 2;
+    size_t data_group_size = ((size_t)data[data_group_begin + 3] << 8) |
+                             ((size_t)data[data_group_begin + 4] << 0);
+    if ((data_group_id & 0x0F) != 0 || !data_group_size ||
+            data_group_begin + 5 + data_group_size > packet.length) {
+        return false;
+    }
+    *group = (data_group_id & 0xF0) >> 4;
+    *payload = data + data_group_begin + 5;
+    *size = data_group_size;
+    return true;
+}
+
+DecodeStatus DecoderImpl::DecodeArchive(const DecodePacket* packets, size_t count, size_t thread_count,
+                                        DecodeBatchResult& out_result) {
+    if (thread_count == 0) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    // Split packets where a new caption management data is going to be applied, which resets writing states.
+    // A few chunks per thread balance the load, as chunks differ in size.
+    size_t min_chunk_size = std::max<size_t>(count / (thread_count * 4), 1);
+    std::vector<size_t> chunk_begins{0};
+    int prev_group = prev_dgi_group_;
+    const uint8_t* last_payload = last_management_data_.data();
+    size_t last_size = last_management_data_.size();
+
+    for (size_t i = 0; thread_count > 1 && i < count; i++) {
+        int group = 0;
+        const uint8_t* payload = nullptr;
+        size_t size = 0;
+        if (!GetManagementDataGroup(packets[i], type_, &group, &payload, &size) || group == prev_group) {
+            continue;
+        }
+        prev_group = group;
+        if (size == last_size && std::equal(payload, payload + size, last_payload)) {
+            continue;
+        }
+        last_payload = payload;
+        last_size = size;
+        if (i - chunk_begins.back() >= min_chunk_size) {
+            chunk_begins.push_back(i);
+        }
+    }
+
+    size_t chunk_count = chunk_begins.size();
+    if (chunk_count == 1) {
+        return DecodeBatch(packets, count, out_result);
+    }
+    chunk_begins.push_back(count);
+
+    // Chunks except the first one are decoded from scratch by independent decoders
+    std::vector<std::unique_ptr<DecoderImpl>> decoders(chunk_count);
+    std::vector<DecodeBatchResult> results(chunk_count);
+    for (size_t i = 1; i < chunk_count; i++) {
+        decoders[i] = CreateArchiveWorker();
+    }
+
+    std::atomic<size_t> next_chunk{1};
+    auto run_chunks = [&] {
+        for (size_t i = next_chunk++; i < chunk_count; i = next_chunk++) {
+            decoders[i]->DecodeBatch(packets + chunk_begins[i], chunk_begins[i + 1] - chunk_begins[i], results[i]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(thread_count, chunk_count); i++) {
+        workers.emplace_back(run_chunks);
+    }
+
+    // The first chunk continues from current states, on the calling thread
+    DecodeBatch(packets, chunk_begins[1], out_result);
+    for (size_t i = chunk_begins[1]; capture_writer_ && i < count; i++) {
+        CapturePacket(packets[i].data, packets[i].length, packets[i].pts);
+    }
+    run_chunks();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    for (size_t i = 1; i < chunk_count; i++) {
+        DecodeBatchResult& result = results[i];
+        for (size_t j = 0; j < result.captions.size(); j++) {
+            out_result.captions.push_back(std::move(result.captions[j]));
+            out_result.packet_indices.push_back(chunk_begins[i] + result.packet_indices[j]);
+        }
+        out_result.error_count += result.error_count;
+    }
+
+    // Take over states left by the last chunk, as if all packets were decoded here
+    std::vector<uint8_t> state;
+    decoders[chunk_count - 1]->SaveState(state);
+    RestoreState(state.data(), state.size());
+
+    if (!out_result.captions.empty()) {
+        return DecodeStatus::kGotCaption;
+    } else if (out_result.error_count) {
+        return DecodeStatus::kError;
+    }
+    return DecodeStatus::kNoCaption;
+}
+
+std::unique_ptr<DecoderImpl> DecoderImpl::CreateArchiveWorker() {
+    auto decoder = std::make_unique<DecoderImpl>(context_);
+    decoder->Initialize(request_encoding_, type_, profile_, language_id_);
+    decoder->SetReplaceMSZFullWidthAlphanumeric(replace_msz_fullwidth_ascii_);
+    decoder->SetTextOnly(text_only_);
+    decoder->SetGenerateCaptionText(generate_caption_text_);
+    decoder->SetGenerateCharUTF8(generate_char_u8str_);
+    decoder->SetDecodeAllLanguages(decode_all_languages_);
+    decoder->SetDecodeLimits(limits_);
+    decoder->SetDeduplicateCaptions(deduplicate_captions_);
+    return decoder;
+}
+
+// Length of the PES data up to the end of its data group, 0 if the header hasn't been completed yet
+static size_t GetPESDataLength(const uint8_t* data, size_t length) {
+    if (length < 3) {
+        return 0;
+    }
+    size_t data_group_begin = 3 + (data[2] & 0x0F);
+    if (length < data_group_begin + 5) {
+        return 0;
+    }
+    size_t data_group_size = ((size_t)data[data_group_begin + 3] << 8) |
+                             ((size_t)data[data_group_begin + 4] << 0);
+    return data_group_begin + 5 + data_group_size;
+}
+
+DecodeStatus DecoderImpl::Feed(const uint8_t* data, size_t length, int64_t pts, bool packet_start,
+                               DecodeResult& out_result) {
+    if (packet_start) {
+        if (feed_pending_) {
+            log_->w("DecoderImpl: Drop incomplete PES data of %zu bytes", feed_buffer_.size());
+        }
+        feed_buffer_.clear();
+        feed_pending_ = true;
+        feed_pts_ = pts;
+
+        size_t pes_length = GetPESDataLength(data, length);
+        if (pes_length && pes_length <= length) {
+            // Whole data group carried in the first fragment, decode it in place
+            feed_pending_ = false;
+            return Decode(data, pes_length, pts, out_result);
+        }
+    } else if (!feed_pending_) {
+        return DecodeStatus::kNoCaption;  // Start of the PES packet has been missed
+    }
+
+    feed_buffer_.insert(feed_buffer_.end(), data, data + length);
+    size_t pes_length = GetPESDataLength(feed_buffer_.data(), feed_buffer_.size());
+    if (!pes_length || pes_length > feed_buffer_.size()) {
+        return DecodeStatus::kNoCaption;
+    }
+
+    feed_pending_ = false;
+    return Decode(feed_buffer_.data(), pes_length, feed_pts_, out_result);
+}
+
+DecodeStatus DecoderImpl::DecodePES(const uint8_t* pes_data,
+                                    size_t length,
+                                    int64_t pts,
+                                    DecodeResult& out_result,
+                                    bool reuse_storage) {
+    ARIBCC_TRACE_SCOPE(tracer_.get(), "decoder", "DecoderImpl::Decode");
+    if (capture_writer_) {
+        CapturePacket(pes_data, length, pts);
+    }
+    if (!metrics_->enabled()) {
+        return ParsePES(pes_data, length, pts, out_result, reuse_storage);
+    }
+
+    DecodeStatus status;
+    {
+        ScopedMetricTimer timer(metrics_.get(), MetricHistogram::kDecodeTime);
+        status = ParsePES(pes_data, length, pts, out_result, reuse_storage);
+    }
+    metrics_->Add(MetricCounter::kDecodedPackets);
+    if (status == DecodeStatus::kError) {
+        metrics_->Add(MetricCounter::kDecodeErrors);
+    } else if (status == DecodeStatus::kGotCaption) {
+        metrics_->Add(MetricCounter::kDecodedCaptions);
+    }
+    if (status == DecodeStatus::kGotCaption && !text_only_) {
+        size_t char_count = 0;
+        for (const CaptionRegion& region : out_result.caption->regions) {
+            char_count += region.chars.size();
+        }
+        metrics_->Record(MetricHistogram::kCharsPerCaption, char_count);
+    }
+    return status;
+}
+
+// Fold a character into the fingerprint of its region, fields affecting the presentation are covered
+static uint64_t FingerprintCaptionChar(uint64_t fingerprint, const CaptionChar& ch, uint64_t drcs_fingerprint) {
+    auto pack = [](auto low, auto high) -> uint64_t {
+        uint32_t low_bits = 0, high_bits = 0;
+        memcpy(&low_bits, &low, sizeof(low));
+        memcpy(&high_bits, &high, sizeof(high));
+        return low_bits | static_cast<uint64_t>(high_bits) << 32;
+    };
+    uint64_t words[8] = {
+        pack(static_cast<uint32_t>(ch.type) | static_cast<uint32_t>(ch.style) << 8 |
+             static_cast<uint32_t>(ch.enclosure_style) << 16, ch.codepoint),
+        pack(ch.pua_codepoint, ch.x),
+        pack(ch.y, ch.char_width),
+        pack(ch.char_height, ch.char_horizontal_spacing),
+        pack(ch.char_vertical_spacing, ch.char_horizontal_scale),
+        pack(ch.char_vertical_scale, ch.text_color.u32),
+        pack(ch.back_color.u32, ch.stroke_color.u32),
+        drcs_fingerprint,
+    };
+    return xxhash::Hash64(reinterpret_cast<const uint8_t*>(words), sizeof(words), fingerprint);
+}
+
+static uint64_t FingerprintCaption(const Caption& caption) {
+    uint64_t fingerprint = xxhash::Hash64(reinterpret_cast<const uint8_t*>(caption.text.data()), caption.text.size());
+    uint64_t words[5] = {
+        static_cast<uint64_t>(caption.type) | static_cast<uint64_t>(caption.flags) << 8 |
+            static_cast<uint64_t>(caption.has_builtin_sound) << 16 |
+            static_cast<uint64_t>(caption.builtin_sound_id) << 24 |
+            static_cast<uint64_t>(caption.iso6392_language_code) << 32,
+        static_cast<uint64_t>(caption.wait_duration),
+        static_cast<uint32_t>(caption.plane_width) |
+            static_cast<uint64_t>(static_cast<uint32_t>(caption.plane_height)) << 32,
+        caption.regions.size(),
+        caption.drcs_map.size(),
+    };
+    fingerprint = xxhash::Hash64(reinterpret_cast<const uint8_t*>(words), sizeof(words), fingerprint);
+    for (const CaptionRegion& region : caption.regions) {
+        fingerprint = xxhash::Hash64(reinterpret_cast<const uint8_t*>(&region.fingerprint),
+                                     sizeof(region.fingerprint), fingerprint);
+    }
+    return fingerprint;
+}
+
+DecodeStatus DecoderImpl::ParsePES(const uint8_t* pes_data,
+                                   size_t length,
+                                   int64_t pts,
+                                   DecodeResult& out_result,
+                                   bool reuse_storage) {
     if (pes_data == nullptr) {
         log_->e("DecoderImpl: pes_data is nullptr");
         assert(pes_data != nullptr);
@@ -110,7 +474,13 @@ DecodeStatus DecoderImpl::Decode(const uint8_t* pes_data, size_t length, int64_t
         return DecodeStatus::kError;
     }
 
-    out_result.caption.reset();
+    PrepareCaption(out_result, reuse_storage);
+    out_result.duplicate_pts = PTS_NOPTS;
+    out_result.duplicate_duration = 0;
+    has_text_only_chars_ = false;
+    decode_steps_ = 0;
+    caption_char_count_ = 0;
+    decode_limit_exceeded_ = false;
     pts_ = pts;
     const uint8_t* data = pes_data;
 
@@ -151,13 +521,16 @@ DecodeStatus DecoderImpl::Decode(const uint8_t* pes_data, size_t length, int64_t
         return DecodeStatus::kNoCaption;
     }
 
+    if (limits_.max_pes_bytes && data_group_begin + 5 + data_group_size > limits_.max_pes_bytes) {
+        ReportDecodeLimitExceeded("max_pes_bytes", limits_.max_pes_bytes);
+        return DecodeStatus::kError;
+    }
+
     uint8_t dgi_id = data_group_id & 0x0F;
-    int dgi_group = (data_group_id & 0xF0) >> 8;
+    int dgi_group = (data_group_id & 0xF0) >> 4;
 
     bool ret = false;
 
-    caption_ = std::make_unique<Caption>();
-
     if (dgi_id == 0) {
         // Caption management data
         if (dgi_group == prev_dgi_group_) {
@@ -166,14 +539,30 @@ DecodeStatus DecoderImpl::Decode(const uint8_t* pes_data, size_t length, int64_t
              * This packet could be considered as retransmission, ignore it
              */
             return DecodeStatus::kNoCaption;
+        }
+
+        prev_dgi_group_ = dgi_group;
+        const uint8_t* management_data = data + data_group_begin + 5;
+        if (data_group_size == last_management_data_.size() &&
+                std::equal(management_data, management_data + data_group_size, last_management_data_.begin())) {
+            // Identical to the caption management data applied last time, e.g. resent periodically
+            // while the group has been toggled, no need to parse and reset states again
+            return DecodeStatus::kNoCaption;
+        }
+
+        // Handle caption management data
+        ret = ParseCaptionManagementData(management_data, data_group_size);
+        if (ret) {
+            last_management_data_.assign(management_data, management_data + data_group_size);
         } else {
-            // Handle caption management data
-            prev_dgi_group_ = dgi_group;
-            ret = ParseCaptionManagementData(data + data_group_begin + 5, data_group_size);
+            last_management_data_.clear();
         }
     } else {
         // Caption statement data
-        if (dgi_id != static_cast<uint8_t>(language_id_)) {
+        if (decode_all_languages_ && dgi_id <= static_cast<uint8_t>(LanguageId::kMax)) {
+            SwitchStatementLanguage(static_cast<LanguageId>(dgi_id));
+        }
+        if (dgi_id != static_cast<uint8_t>(decode_all_languages_ ? statement_language_ : language_id_)) {
             // Non-expected language id, ignore it
             return DecodeStatus::kNoCaption;
         } else {
@@ -183,13 +572,17 @@ DecodeStatus DecoderImpl::Decode(const uint8_t* pes_data, size_t length, int64_t
     }
 
     if (!ret) {
-        caption_.reset();
+        if (!reuse_storage) {
+            caption_.reset();
+        }
         return DecodeStatus::kError;
     }
 
-    if (!caption_->regions.empty() || caption_->flags) {
+    if (!caption_->regions.empty() || has_text_only_chars_ || caption_->flags) {
         caption_->type = static_cast<CaptionType>(type_);
-        caption_->iso6392_language_code = current_iso6392_language_code_;
+        caption_->iso6392_language_code = decode_all_languages_ && statement_language_ != language_id_
+                                          ? QueryISO6392LanguageCode(statement_language_)
+                                          : current_iso6392_language_code_;
         caption_->plane_width = caption_plane_width_;
         caption_->plane_height = caption_plane_height_;
         caption_->has_builtin_sound = has_builtin_sound_;
@@ -200,6 +593,14 @@ DecodeStatus DecoderImpl::Decode(const uint8_t* pes_data, size_t length, int64_t
         if (caption_->wait_duration == 0) {
             caption_->wait_duration = DURATION_INDEFINITE;
         }
+        caption_->fingerprint = FingerprintCaption(*caption_);
+
+        if (deduplicate_captions_ && CheckDuplicateCaption(out_result)) {
+            if (!reuse_storage) {
+                caption_.reset();
+            }
+            return DecodeStatus::kGotDuplicateCaption;
+        }
 
         out_result.caption = std::move(caption_);
         return DecodeStatus::kGotCaption;
@@ -208,8 +609,73 @@ DecodeStatus DecoderImpl::Decode(const uint8_t* pes_data, size_t length, int64_t
     return DecodeStatus::kNoCaption;
 }
 
+bool DecoderImpl::CheckDuplicateCaption(DecodeResult& out_result) {
+    const Caption& caption = *caption_;
+    if (has_last_caption_ && caption.fingerprint == last_caption_fingerprint_ &&
+            caption.pts != PTS_NOPTS && last_caption_pts_ != PTS_NOPTS && caption.pts >= last_caption_pts_) {
+        // Identical durations are covered by the fingerprint, extend the previous one up to the end of this one
+        if (caption.wait_duration == DURATION_INDEFINITE) {
+            last_caption_duration_ = DURATION_INDEFINITE;
+        } else if (last_caption_duration_ != DURATION_INDEFINITE) {
+            last_caption_duration_ = std::max(last_caption_duration_,
+                                              caption.pts + caption.wait_duration - last_caption_pts_);
+        }
+        out_result.duplicate_pts = last_caption_pts_;
+        out_result.duplicate_duration = last_caption_duration_;
+        return true;
+    }
+
+    has_last_caption_ = true;
+    last_caption_fingerprint_ = caption.fingerprint;
+    last_caption_pts_ = caption.pts;
+    last_caption_duration_ = caption.wait_duration;
+    return false;
+}
+
+void DecoderImpl::PrepareCaption(DecodeResult& out_result, bool reuse_storage) {
+    if (!reuse_storage) {
+        out_result.caption.reset();
+        caption_ = std::make_unique<Caption>();
+        return;
+    }
+
+    // Take over the caller's caption if presents, otherwise keep the one left by a previous call
+    if (out_result.caption) {
+        caption_ = std::move(out_result.caption);
+    } else if (!caption_) {
+        caption_ = std::make_unique<Caption>();
+    }
+
+    Caption& caption = *caption_;
+    caption.type = CaptionType::kDefault;
+    caption.flags = CaptionFlags::kCaptionFlagsDefault;
+    caption.iso6392_language_code = 0;
+    caption.text.clear();
+    for (CaptionRegion& region : caption.regions) {
+        region.chars.clear();
+        spare_region_chars_.push_back(std::move(region.chars));
+    }
+    caption.regions.clear();
+    while (!caption.drcs_map.empty()) {
+        spare_drcs_nodes_.push_back(caption.drcs_map.extract(caption.drcs_map.begin()));
+    }
+    caption.pts = 0;
+    caption.wait_duration = 0;
+    caption.plane_width = 0;
+    caption.plane_height = 0;
+    caption.has_builtin_sound = false;
+    caption.builtin_sound_id = 0;
+    caption.fingerprint = 0;
+}
+
 void DecoderImpl::Flush() {
     ResetInternalState();
+    has_last_caption_ = false;
+    statement_language_ = language_id_;
+    language_states_.fill(std::nullopt);
+    last_management_data_.clear();
+    feed_pending_ = false;
+    feed_buffer_.clear();
 }
 
 auto DecoderImpl::DetectEncodingScheme() -> EncodingScheme {
@@ -247,22 +713,22 @@ void DecoderImpl::ResetGraphicSets() {
     // Set default G1~G4 codesets
     if (active_encoding_ == EncodingScheme::kABNT_NBR_15606_1_Latin) {
         // Latin language, defined in ABNT NBR 15606-1
-        GX_[0] = kAlphanumericEntry;
-        GX_[1] = kAlphanumericEntry;
-        GX_[2] = kLatinExtensionEntry;
-        GX_[3] = kLatinSpecialEntry;
+        DesignateGraphicSet(0, kAlphanumericEntry);
+        DesignateGraphicSet(1, kAlphanumericEntry);
+        DesignateGraphicSet(2, kLatinExtensionEntry);
+        DesignateGraphicSet(3, kLatinSpecialEntry);
     } else if (profile_ == Profile::kProfileA) {
         // full-seg, Profile A
-        GX_[0] = kKanjiEntry;
-        GX_[1] = kAlphanumericEntry;
-        GX_[2] = kHiraganaEntry;
-        GX_[3] = kMacroEntry;
+        DesignateGraphicSet(0, kKanjiEntry);
+        DesignateGraphicSet(1, kAlphanumericEntry);
+        DesignateGraphicSet(2, kHiraganaEntry);
+        DesignateGraphicSet(3, kMacroEntry);
     } else if (profile_ == Profile::kProfileC) {
         // one-seg, Profile C
-        GX_[0] = kDRCS1Entry;
-        GX_[1] = kAlphanumericEntry;
-        GX_[2] = kKanjiEntry;
-        GX_[3] = kMacroEntry;
+        DesignateGraphicSet(0, kDRCS1Entry);
+        DesignateGraphicSet(1, kAlphanumericEntry);
+        DesignateGraphicSet(2, kKanjiEntry);
+        DesignateGraphicSet(3, kMacroEntry);
     }
     GL_ = &GX_[0];
     GR_ = &GX_[2];
@@ -363,6 +829,98 @@ void DecoderImpl::ResetInternalState() {
     back_color_ = kB24ColorCLUT[palette_][8];
 }
 
+void DecoderImpl::SaveStatementState(StatementState& state) const {
+    state.GX = GX_;
+    state.GL_index = static_cast<size_t>(GL_ - GX_.data());
+    state.GR_index = static_cast<size_t>(GR_ - GX_.data());
+    state.swf = swf_;
+    state.caption_plane_width = caption_plane_width_;
+    state.caption_plane_height = caption_plane_height_;
+    state.display_area_width = display_area_width_;
+    state.display_area_height = display_area_height_;
+    state.display_area_start_x = display_area_start_x_;
+    state.display_area_start_y = display_area_start_y_;
+    state.active_pos_inited = active_pos_inited_;
+    state.active_pos_x = active_pos_x_;
+    state.active_pos_y = active_pos_y_;
+    state.char_width = char_width_;
+    state.char_height = char_height_;
+    state.char_horizontal_spacing = char_horizontal_spacing_;
+    state.char_vertical_spacing = char_vertical_spacing_;
+    state.char_horizontal_scale = char_horizontal_scale_;
+    state.char_vertical_scale = char_vertical_scale_;
+    state.has_underline = has_underline_;
+    state.has_bold = has_bold_;
+    state.has_italic = has_italic_;
+    state.has_stroke = has_stroke_;
+    state.stroke_color = stroke_color_;
+    state.enclosure_style = enclosure_style_;
+    state.has_builtin_sound = has_builtin_sound_;
+    state.builtin_sound_id = builtin_sound_id_;
+    state.palette = palette_;
+    state.text_color = text_color_;
+    state.back_color = back_color_;
+}
+
+void DecoderImpl::LoadStatementState(const StatementState& state) {
+    for (size_t i = 0; i < state.GX.size(); i++) {
+        DesignateGraphicSet(i, state.GX[i]);
+    }
+    GL_ = &GX_[state.GL_index];
+    GR_ = &GX_[state.GR_index];
+    swf_ = state.swf;
+    caption_plane_width_ = state.caption_plane_width;
+    caption_plane_height_ = state.caption_plane_height;
+    display_area_width_ = state.display_area_width;
+    display_area_height_ = state.display_area_height;
+    display_area_start_x_ = state.display_area_start_x;
+    display_area_start_y_ = state.display_area_start_y;
+    active_pos_inited_ = state.active_pos_inited;
+    active_pos_x_ = state.active_pos_x;
+    active_pos_y_ = state.active_pos_y;
+    char_width_ = state.char_width;
+    char_height_ = state.char_height;
+    char_horizontal_spacing_ = state.char_horizontal_spacing;
+    char_vertical_spacing_ = state.char_vertical_spacing;
+    char_horizontal_scale_ = state.char_horizontal_scale;
+    char_vertical_scale_ = state.char_vertical_scale;
+    has_underline_ = state.has_underline;
+    has_bold_ = state.has_bold;
+    has_italic_ = state.has_italic;
+    has_stroke_ = state.has_stroke;
+    stroke_color_ = state.stroke_color;
+    enclosure_style_ = state.enclosure_style;
+    has_builtin_sound_ = state.has_builtin_sound;
+    builtin_sound_id_ = state.builtin_sound_id;
+    palette_ = state.palette;
+    text_color_ = state.text_color;
+    back_color_ = state.back_color;
+}
+
+void DecoderImpl::SwitchStatementLanguage(LanguageId language_id) {
+    if (statement_language_ == language_id) {
+        return;
+    }
+
+    language_states_[static_cast<size_t>(statement_language_) - 1].emplace();
+    SaveStatementState(*language_states_[static_cast<size_t>(statement_language_) - 1]);
+    statement_language_ = language_id;
+
+    std::optional<StatementState>& state = language_states_[static_cast<size_t>(language_id) - 1];
+    if (state) {
+        LoadStatementState(*state);
+        return;
+    }
+
+    // Not decoded yet since the last caption management data (or ever), start over as indicated by it
+    ResetInternalState();
+    size_t index = static_cast<size_t>(language_id) - 1;
+    if (index < language_infos_.size() && language_infos_[index].language_id == language_id) {
+        swf_ = language_infos_[index].format - 1;
+        ResetWritingFormat();
+    }
+}
+
 bool DecoderImpl::ParseCaptionManagementData(const uint8_t* data, size_t length) {
     if (length < 10) {
         log_->e("DecoderImpl: Data not enough for parsing CaptionManagementData");
@@ -411,6 +969,13 @@ bool DecoderImpl::ParseCaptionManagementData(const uint8_t* data, size_t length)
 
         if (language_info.language_id == this->language_id_) {
             current_iso6392_language_code_ = language_info.iso6392_language_code;
+        }
+        if (decode_all_languages_ && language_info.language_id != statement_language_) {
+            // Writing states of other languages are reset once switched to
+            if (language_tag < language_states_.size()) {
+                language_states_[language_tag].reset();
+            }
+        } else if (language_info.language_id == (decode_all_languages_ ? statement_language_ : language_id_)) {
             swf_ = language_info.format - 1;
             ResetGraphicSets();
             ResetWritingFormat();
@@ -512,6 +1077,9 @@ bool DecoderImpl::ParseDataUnit(const uint8_t* data, size_t length) {
 
         if (data_unit_parameter == 0x20) {
             ParseStatementBody(data + offset + 5, data_unit_size);
+            if (decode_limit_exceeded_) {
+                return false;
+            }
         } else if (data_unit_parameter == 0x30) {
             ParseDRCS(data + offset + 5, data_unit_size, 1);
         } else if (data_unit_parameter == 0x31) {
@@ -549,12 +1117,10 @@ bool DecoderImpl::ParseStatementBody(const uint8_t* data, size_t length) {
         } else {
             if (ch <= 0x20) {
                 ret = HandleC0(data + offset, length - offset, &bytes_processed);
-            } else if (ch < 0x7F) {
-                ret = HandleGLGR(data + offset, length - offset, &bytes_processed, GL_);
+            } else if (IsGraphicByte(ch)) {
+                ret = HandleGraphicRun(data + offset, length - offset, &bytes_processed);
             } else if (ch <= 0xA0) {
                 ret = HandleC1(data + offset, length - offset, &bytes_processed);
-            } else if (ch < 0xFF) {
-                ret = HandleGLGR(data + offset, length - offset, &bytes_processed, GR_);
             }
         }
 
@@ -563,11 +1129,36 @@ bool DecoderImpl::ParseStatementBody(const uint8_t* data, size_t length) {
             return false;
         }
         offset += bytes_processed;
+
+        if (!CheckDecodeLimits()) {
+            return false;
+        }
     }
 
     return true;
 }
 
+bool DecoderImpl::CheckDecodeLimits() {
+    decode_steps_++;
+    if (limits_.max_decode_steps && decode_steps_ > limits_.max_decode_steps) {
+        ReportDecodeLimitExceeded("max_decode_steps", limits_.max_decode_steps);
+        return false;
+    } else if (limits_.max_chars_per_caption && caption_char_count_ > limits_.max_chars_per_caption) {
+        ReportDecodeLimitExceeded("max_chars_per_caption", limits_.max_chars_per_caption);
+        return false;
+    } else if (limits_.max_regions_per_caption && caption_->regions.size() > limits_.max_regions_per_caption) {
+        ReportDecodeLimitExceeded("max_regions_per_caption", limits_.max_regions_per_caption);
+        return false;
+    }
+    return true;
+}
+
+void DecoderImpl::ReportDecodeLimitExceeded(const char* name, size_t limit) {
+    log_->e("DecoderImpl: Dropped PES data exceeding %s of %zu", name, limit);
+    decode_limit_exceeded_ = true;
+    metrics_->Add(MetricCounter::kDecodeLimitsExceeded);
+}
+
 bool DecoderImpl::ParseDRCS(const uint8_t* data, size_t length, size_t byte_count) {
     if (length == 0) {
         log_->e("DecoderImpl: Data not enough for parsing DRCS");
@@ -619,29 +1210,14 @@ bool DecoderImpl::ParseDRCS(const uint8_t* data, size_t length, size_t byte_coun
                     return false;
                 }
 
-                DRCS drcs;
-                drcs.width = static_cast<int>(width);
-                drcs.height = static_cast<int>(height);
-                drcs.depth = static_cast<int>(depth);
-                drcs.depth_bits = static_cast<int>(depth_bits);
-                drcs.pixels.assign(data + offset, data + offset + bitmap_size);
+                std::shared_ptr<const DRCS> drcs = InternDRCS(width, height, depth, depth_bits,
+                                                              data + offset, bitmap_size);
                 offset += bitmap_size;
 
-                drcs.md5 = md5::GetDigest(drcs.pixels.data(), bitmap_size);
-
-                // Find alternative replacement
-                auto iter = kDRCSReplacementMap.find(drcs.md5);
-                if (iter != kDRCSReplacementMap.end()) {
-                    drcs.alternative_ucs4 = iter->second;
-                    utf::UTF8AppendCodePoint(drcs.alternative_text, iter->second);
-                } else {
-                    log_->w("DecoderImpl: Cannot convert unrecognized DRCS pattern with MD5 %s to Unicode", drcs.md5.c_str());
-                }
-
                 if (byte_count == 1) {
                     uint8_t index = ((character_code & 0x0F00) >> 8) + 0x40;
                     uint16_t ch = (character_code & 0x00FF) & 0x7F;
-                    CodesetEntry entry = kDRCSCodesetByF.at(index);
+                    CodesetEntry entry = kDRCSCodesetByF[index];
                     size_t map_index = static_cast<uint8_t>(entry.graphics_set) -
                                        static_cast<uint8_t>(GraphicSet::kDRCS_0);
                     drcs_maps_[map_index].insert_or_assign(ch, std::move(drcs));
@@ -668,6 +1244,54 @@ bool DecoderImpl::ParseDRCS(const uint8_t* data, size_t length, size_t byte_coun
     return true;
 }
 
+static uint64_t HashDRCSPattern(int width, int height, int depth, const uint8_t* pixels, size_t size) {
+    // Identity of interned patterns only, MD5 is still computed for new ones for replacement lookups
+    uint64_t seed = static_cast<uint64_t>(width & 0xFF) |
+                    static_cast<uint64_t>(height & 0xFF) << 8 |
+                    static_cast<uint64_t>(depth & 0xFF) << 16;
+    return xxhash::Hash64(pixels, size, seed);
+}
+
+std::shared_ptr<const DRCS> DecoderImpl::InternDRCS(int width, int height, int depth, int depth_bits,
+                                                    const uint8_t* pixels, size_t size) {
+    uint64_t hash = HashDRCSPattern(width, height, depth, pixels, size);
+
+    auto iter = drcs_store_.find(hash);
+    if (iter != drcs_store_.end()) {
+        const DRCS& interned = *iter->second;
+        if (interned.width == width && interned.height == height && interned.depth == depth &&
+                interned.pixels.size() == size && memcmp(interned.pixels.data(), pixels, size) == 0) {
+            return iter->second;
+        }
+    }
+
+    auto drcs = std::make_shared<DRCS>();
+    drcs->width = width;
+    drcs->height = height;
+    drcs->depth = depth;
+    drcs->depth_bits = depth_bits;
+    drcs->pixels.assign(pixels, pixels + size);
+
+    md5::Digest digest = md5::GetDigestBytes(pixels, size);
+    drcs->md5 = md5::DigestToString(digest);
+
+    // Find alternative replacement
+    if (uint32_t ucs4 = FindDRCSReplacement(digest)) {
+        drcs->alternative_ucs4 = ucs4;
+        utf::UTF8AppendCodePoint(drcs->alternative_text, ucs4);
+    } else {
+        log_->w("DecoderImpl: Cannot convert unrecognized DRCS pattern with MD5 %s to Unicode", drcs->md5.c_str());
+    }
+
+    if (drcs_store_.size() >= kMaxInternedDRCS) {
+        // Patterns still designated in drcs_maps_ are kept alive by their own references
+        drcs_store_.clear();
+    }
+    drcs_store_.insert_or_assign(hash, drcs);
+
+    return drcs;
+}
+
 
 bool DecoderImpl::HandleC0(const uint8_t* data, size_t remain_bytes, size_t* bytes_processed) {
     size_t bytes = 0;
@@ -700,7 +1324,9 @@ bool DecoderImpl::HandleC0(const uint8_t* data, size_t remain_bytes, size_t* byt
             break;
         }
         case C0::APR:  // Active position return
-            utf::UTF8AppendCodePoint(caption_->text, 0x000A);  // \n
+            if (text_only_ || generate_caption_text_) {
+                utf::UTF8AppendCodePoint(caption_->text, 0x000A);  // \n
+            }
             MoveActivePosToNewline();
             bytes = 1;
             break;
@@ -785,6 +1411,15 @@ bool DecoderImpl::HandleC0(const uint8_t* data, size_t remain_bytes, size_t* byt
 bool DecoderImpl::HandleESC(const uint8_t* data, size_t remain_bytes, size_t* bytes_processed) {
     size_t bytes = 0;
 
+    auto designate = [this](size_t GX_index, const CodesetEntry& entry) {
+        if (entry.graphics_set == GraphicSet::kNone || entry.bytes == 0) {
+            log_->e("DecoderImpl: Designation of undefined graphic set");
+            return false;
+        }
+        DesignateGraphicSet(GX_index, entry);
+        return true;
+    };
+
     switch (data[0]) {
         case ESC::LS2:
             GL_ = &GX_[2];
@@ -817,14 +1452,17 @@ bool DecoderImpl::HandleESC(const uint8_t* data, size_t remain_bytes, size_t* by
                     if (data[2] == 0x20) {  // 2-byte DRCS
                         if (remain_bytes < 4)
                             return false;
-                        GX_[GX_index] = kDRCSCodesetByF.at(data[3]);
+                        if (!designate(GX_index, kDRCSCodesetByF[data[3]]))
+                            return false;
                         bytes = 4;
                     } else {  // 2-byte G set
-                        GX_[GX_index] = kGCodesetByF.at(data[2]);
+                        if (!designate(GX_index, kGCodesetByF[data[2]]))
+                            return false;
                         bytes = 3;
                     }
                 } else {  // 2-byte G set
-                    GX_[0] = kGCodesetByF.at(data[1]);
+                    if (!designate(0, kGCodesetByF[data[1]]))
+                        return false;
                     bytes = 2;
                 }
             } else if (data[0] >= 0x28 && data[0] <= 0x2B) {  // 1-byte G set or DRCS
@@ -834,10 +1472,12 @@ bool DecoderImpl::HandleESC(const uint8_t* data, size_t remain_bytes, size_t* by
                 if (data[1] == 0x20) {  // 1-byte DRCS
                     if (remain_bytes < 3)
                         return false;
-                    GX_[GX_index] = kDRCSCodesetByF.at(data[2]);
+                    if (!designate(GX_index, kDRCSCodesetByF[data[2]]))
+                        return false;
                     bytes = 3;
                 } else {  // 1-byte G set
-                    GX_[GX_index] = kGCodesetByF.at(data[1]);
+                    if (!designate(GX_index, kGCodesetByF[data[1]]))
+                        return false;
                     bytes = 2;
                 }
             }
@@ -1152,6 +1792,10 @@ bool DecoderImpl::HandleGLGR(const uint8_t* data, size_t remain_bytes, size_t* b
         return false;
     }
 
+    if (entry->bytes == 0) {
+        return false;  // Undefined graphic set
+    }
+
     uint8_t ch2 = 0;
     if (entry->bytes == 2) {
         if (remain_bytes < 2) {
@@ -1163,112 +1807,196 @@ bool DecoderImpl::HandleGLGR(const uint8_t* data, size_t remain_bytes, size_t* b
         }
     }
 
-    if (entry->graphics_set == GraphicSet::kHiragana ||
-               entry->graphics_set == GraphicSet::kProportionalHiragana) {
-        uint32_t index = (uint32_t)ch - 0x21;
-        uint32_t ucs4 = kHiraganaTable[index];
-        PushCharacter(ucs4);
-        MoveRelativeActivePos(1, 0);
-    } else if (entry->graphics_set == GraphicSet::kKatakana ||
-               entry->graphics_set == GraphicSet::kProportionalKatakana) {
-        uint32_t index = (uint32_t)ch - 0x21;
-        uint32_t ucs4 = kKatakanaTable[index];
-        PushCharacter(ucs4);
-        MoveRelativeActivePos(1, 0);
-    } else if (entry->graphics_set == GraphicSet::kJIS_X0201_Katakana) {
-        uint32_t index = (uint32_t)ch - 0x21;
-        uint32_t ucs4 = kJISX0201KatakanaTable[index];
-        PushCharacter(ucs4);
-        MoveRelativeActivePos(1, 0);
-    } else if (entry->graphics_set == GraphicSet::kKanji ||
-               entry->graphics_set == GraphicSet::kJIS_X0213_2004_Kanji_1 ||
-               entry->graphics_set == GraphicSet::kJIS_X0213_2004_Kanji_2 ||
-               entry->graphics_set == GraphicSet::kAdditionalSymbols) {
-        constexpr uint32_t gaiji_begin_ku = 84;
-        uint32_t ku = (uint32_t)ch - 0x21;
-        uint32_t ten = (uint32_t)ch2 - 0x21;
-
-        uint32_t ucs4 = 0;
-        uint32_t pua = 0;
-
-        if (ku < gaiji_begin_ku) {
-            uint32_t index = ku * 94 + ten;
-            ucs4 = kKanjiTable[index];
-            // If [ucs4 is Fullwidth alphanumeric] && [request replace] && [under MSZ mode]
-            if ((ucs4 >= 0xFF01 && ucs4 <= 0xFF5E) && replace_msz_fullwidth_ascii_ &&
-                char_horizontal_scale_ * 2 == char_vertical_scale_) {
-                // Replace Fullwidth alphanumerics with Halfwidth alphanumerics
-                ucs4 = (ucs4 & 0xFF) + 0x20;
-            }
-        } else {  // ku >= 84
-            // Additional Kanji + Additional Symbols
-            uint32_t index = (ku - gaiji_begin_ku) * 94 + ten;
-            ucs4 = kAdditionalSymbolsTable_Unicode[index];
-            pua = kAdditionalSymbolsTable_PUA[index];
-            if (pua == ucs4 || pua < 0xE000 || pua > 0xF8FF) {
-                // Same as ucs4, or invalid PUA
-                pua = 0;  // mark as non-existent
+    size_t gx_index = static_cast<size_t>(entry - GX_.data());
+    if (!(this->*GX_handlers_[gx_index])(gx_index, ch, ch2)) {
+        return false;
+    }
+
+    *bytes_processed = entry->bytes;
+    return true;
+}
+
+bool DecoderImpl::HandleGraphicRun(const uint8_t* data, size_t remain_bytes, size_t* bytes_processed) {
+    // Statement bodies are mostly long runs of characters without control codes in between,
+    // which are converted in one go instead of being dispatched byte by byte
+    size_t run_length = FindGraphicRunLength(data, remain_bytes);
+    size_t offset = 0;
+
+    while (offset < run_length) {
+        // Graphic sets could be redesignated by macros, thus looked up for every character
+        CodesetEntry* entry = (data[offset] & 0x80) ? GR_ : GL_;
+        uint8_t ch = data[offset] & 0x7F;
+        if (entry->bytes == 0) {
+            return false;  // Undefined graphic set
+        }
+        uint8_t ch2 = 0;
+        if (entry->bytes == 2) {
+            if (offset + 1 >= run_length) {
+                if (offset == 0) {
+                    return false;  // Second byte is not a graphic character
+                }
+                break;
             }
+            ch2 = data[offset + 1] & 0x7F;
         }
 
-        PushCharacter(ucs4, pua);
-        MoveRelativeActivePos(1, 0);
-    } else if (entry->graphics_set == GraphicSet::kAlphanumeric ||
-               entry->graphics_set == GraphicSet::kProportionalAlphanumeric) {
-        uint32_t index = (uint32_t)ch - 0x21;
-        uint32_t ucs4 = 0;
-        if (active_encoding_ == EncodingScheme::kABNT_NBR_15606_1_Latin) {
-            ucs4 = kAlphanumericTable_Latin[index];
-        } else if (replace_msz_fullwidth_ascii_ && char_horizontal_scale_ * 2 == char_vertical_scale_) {
-            ucs4 = kAlphanumericTable_Halfwidth[index];
-        } else {
-            ucs4 = kAlphanumericTable_Fullwidth[index];
+        size_t gx_index = static_cast<size_t>(entry - GX_.data());
+        if (!(this->*GX_handlers_[gx_index])(gx_index, ch, ch2)) {
+            return false;
         }
-        PushCharacter(ucs4);
-        MoveRelativeActivePos(1, 0);
-    } else if (entry->graphics_set == GraphicSet::kLatinExtension) {
-        uint32_t index = (uint32_t)ch - 0x21;
-        uint32_t ucs4 = kLatinExtensionTable[index];
-        PushCharacter(ucs4);
-        MoveRelativeActivePos(1, 0);
-    } else if (entry->graphics_set == GraphicSet::kLatinSpecial) {
-        uint32_t index = (uint32_t)ch - 0x21;
-        uint32_t ucs4 = kLatinSpecialTable[index];
-        PushCharacter(ucs4);
-        MoveRelativeActivePos(1, 0);
-    } else if (entry->graphics_set == GraphicSet::kMacro) {
-        uint8_t key = ch;
-        if (key >= 0x60 && key <= 0x6F) {
-            if (!ParseStatementBody(kDefaultMacros[key & 0x0F], sizeof(kDefaultMacros[0]))) {
-                return false;
-            }
+        offset += entry->bytes;
+    }
+
+    *bytes_processed = offset;
+    return true;
+}
+
+bool DecoderImpl::HandleTableChar(size_t gx_index, uint8_t ch, uint8_t) {
+    uint32_t index = (uint32_t)ch - 0x21;
+    PushCharacter(GX_tables_[gx_index][index], GX_u8_tables_[gx_index][index]);
+    MoveRelativeActivePos(1, 0);
+    return true;
+}
+
+bool DecoderImpl::HandleKanjiChar(size_t, uint8_t ch, uint8_t ch2) {
+    constexpr uint32_t gaiji_begin_ku = 84;
+    uint32_t ku = (uint32_t)ch - 0x21;
+    uint32_t ten = (uint32_t)ch2 - 0x21;
+    if (ku >= 94 || ten >= 94) {
+        log_->e("DecoderImpl: Invalid kanji character code");
+        return false;
+    }
+
+    uint32_t ucs4 = 0;
+    uint32_t pua = 0;
+    const utf::UTF8Char* u8char = nullptr;
+
+    if (ku < gaiji_begin_ku) {
+        uint32_t index = ku * 94 + ten;
+        if (index >= kKanjiTable_Packed.size()) {
+            return false;
         }
-    } else if (entry->graphics_set >= GraphicSet::kDRCS_0 &&
-               entry->graphics_set <= GraphicSet::kDRCS_15) {
-        uint32_t map_index = static_cast<uint32_t>(entry->graphics_set) - static_cast<uint32_t>(GraphicSet::kDRCS_0);
-        auto& drcs_map = drcs_maps_[map_index];
-        uint16_t key = ch;
-        if (entry->bytes == 2) {
-            key = (key << 8) | ch2;
+        ucs4 = kKanjiTable_Packed[index];
+        u8char = &kKanjiTable_UTF8[index];
+        // If [ucs4 is Fullwidth alphanumeric] && [request replace] && [under MSZ mode]
+        if ((ucs4 >= 0xFF01 && ucs4 <= 0xFF5E) && replace_msz_fullwidth_ascii_ &&
+            char_horizontal_scale_ * 2 == char_vertical_scale_) {
+            // Replace Fullwidth alphanumerics with Halfwidth alphanumerics
+            ucs4 = (ucs4 & 0xFF) + 0x20;
+            u8char = &kAlphanumericTable_Halfwidth_UTF8[ucs4 - 0x21];
         }
+    } else {  // ku >= 84
+        // Additional Kanji + Additional Symbols
+        uint32_t index = (ku - gaiji_begin_ku) * 94 + ten;
+        if (index >= kAdditionalSymbolsTable_Unicode_Packed.size()) {
+            return false;
+        }
+        ucs4 = kAdditionalSymbolsTable_Unicode_Packed[index];
+        u8char = &kAdditionalSymbolsTable_Unicode_UTF8[index];
+        pua = kAdditionalSymbolsTable_PUA_Packed[index];  // 0 if same as ucs4 or invalid
+    }
 
-        auto iter = drcs_map.find(key);
-        if (iter == drcs_map.end()) {
-            // Unfindable DRCS character, insert Geta Mark instead
-            PushCharacter(0x3013);
-        } else {
-            DRCS& drcs = iter->second;
-            uint32_t code = (map_index << 16) | key;
-            PushDRCSCharacter(code, drcs);
+    PushCharacter(ucs4, *u8char, pua);
+    MoveRelativeActivePos(1, 0);
+    return true;
+}
+
+bool DecoderImpl::HandleAlphanumericChar(size_t, uint8_t ch, uint8_t) {
+    uint32_t index = (uint32_t)ch - 0x21;
+    if (active_encoding_ == EncodingScheme::kABNT_NBR_15606_1_Latin) {
+        PushCharacter(kAlphanumericTable_Latin[index], kAlphanumericTable_Latin_UTF8[index]);
+    } else if (replace_msz_fullwidth_ascii_ && char_horizontal_scale_ * 2 == char_vertical_scale_) {
+        PushCharacter(kAlphanumericTable_Halfwidth[index], kAlphanumericTable_Halfwidth_UTF8[index]);
+    } else {
+        PushCharacter(kAlphanumericTable_Fullwidth[index], kAlphanumericTable_Fullwidth_UTF8[index]);
+    }
+    MoveRelativeActivePos(1, 0);
+    return true;
+}
+
+bool DecoderImpl::HandleMacroChar(size_t, uint8_t ch, uint8_t) {
+    uint8_t key = ch;
+    if (key >= 0x60 && key <= 0x6F) {
+        const MacroDesignation& macro = kDefaultMacros[key & 0x0F];
+        for (size_t i = 0; i < macro.GX.size(); i++) {
+            DesignateGraphicSet(i, macro.GX[i]);
         }
+        GL_ = &GX_[macro.GL_index];
+        GR_ = &GX_[macro.GR_index];
+    }
+    return true;
+}
 
-        MoveRelativeActivePos(1, 0);
-    } // else: not supported, ignore
+bool DecoderImpl::HandleDRCSChar(size_t gx_index, uint8_t ch, uint8_t ch2) {
+    const CodesetEntry& entry = GX_[gx_index];
+    uint32_t map_index = static_cast<uint32_t>(entry.graphics_set) - static_cast<uint32_t>(GraphicSet::kDRCS_0);
+    auto& drcs_map = drcs_maps_[map_index];
+    uint16_t key = ch;
+    if (entry.bytes == 2) {
+        key = (key << 8) | ch2;
+    }
 
-    *bytes_processed = entry->bytes;
+    auto iter = drcs_map.find(key);
+    if (iter == drcs_map.end()) {
+        // Unfindable DRCS character, insert Geta Mark instead
+        PushCharacter(0x3013);
+    } else {
+        uint32_t code = (map_index << 16) | key;
+        PushDRCSCharacter(code, *iter->second);
+    }
+
+    MoveRelativeActivePos(1, 0);
     return true;
 }
 
+bool DecoderImpl::HandleUnsupportedChar(size_t, uint8_t, uint8_t) {
+    return true;  // not supported, ignore
+}
+
+void DecoderImpl::DesignateGraphicSet(size_t gx_index, const CodesetEntry& entry) {
+    GX_[gx_index] = entry;
+    GX_tables_[gx_index] = nullptr;
+    GX_u8_tables_[gx_index] = nullptr;
+
+    GraphicSet set = entry.graphics_set;
+    GraphicSetHandler handler = &DecoderImpl::HandleUnsupportedChar;
+
+    if (set == GraphicSet::kHiragana || set == GraphicSet::kProportionalHiragana) {
+        handler = &DecoderImpl::HandleTableChar;
+        GX_tables_[gx_index] = kHiraganaTable;
+        GX_u8_tables_[gx_index] = kHiraganaTable_UTF8.data();
+    } else if (set == GraphicSet::kKatakana || set == GraphicSet::kProportionalKatakana) {
+        handler = &DecoderImpl::HandleTableChar;
+        GX_tables_[gx_index] = kKatakanaTable;
+        GX_u8_tables_[gx_index] = kKatakanaTable_UTF8.data();
+    } else if (set == GraphicSet::kJIS_X0201_Katakana) {
+        handler = &DecoderImpl::HandleTableChar;
+        GX_tables_[gx_index] = kJISX0201KatakanaTable;
+        GX_u8_tables_[gx_index] = kJISX0201KatakanaTable_UTF8.data();
+    } else if (set == GraphicSet::kKanji ||
+               set == GraphicSet::kJIS_X0213_2004_Kanji_1 ||
+               set == GraphicSet::kJIS_X0213_2004_Kanji_2 ||
+               set == GraphicSet::kAdditionalSymbols) {
+        handler = &DecoderImpl::HandleKanjiChar;
+    } else if (set == GraphicSet::kAlphanumeric || set == GraphicSet::kProportionalAlphanumeric) {
+        handler = &DecoderImpl::HandleAlphanumericChar;
+    } else if (set == GraphicSet::kLatinExtension) {
+        handler = &DecoderImpl::HandleTableChar;
+        GX_tables_[gx_index] = kLatinExtensionTable;
+        GX_u8_tables_[gx_index] = kLatinExtensionTable_UTF8.data();
+    } else if (set == GraphicSet::kLatinSpecial) {
+        handler = &DecoderImpl::HandleTableChar;
+        GX_tables_[gx_index] = kLatinSpecialTable;
+        GX_u8_tables_[gx_index] = kLatinSpecialTable_UTF8.data();
+    } else if (set == GraphicSet::kMacro) {
+        handler = &DecoderImpl::HandleMacroChar;
+    } else if (set >= GraphicSet::kDRCS_0 && set <= GraphicSet::kDRCS_15) {
+        handler = &DecoderImpl::HandleDRCSChar;
+    }
+
+    GX_handlers_[gx_index] = handler;
+}
+
 bool DecoderImpl::HandleUTF8(const uint8_t* data, size_t remain_bytes, size_t* bytes_processed) {
     if (!remain_bytes) {
         return false;
@@ -1282,7 +2010,7 @@ bool DecoderImpl::HandleUTF8(const uint8_t* data, size_t remain_bytes, size_t* b
             // Unfindable DRCS character, insert Geta Mark instead
             PushCharacter(0x3013);
         } else {
-            PushDRCSCharacter(ucs4, iter->second);
+            PushDRCSCharacter(ucs4, *iter->second);
         }
     } else {
         PushCharacter(ucs4);
@@ -1294,54 +2022,99 @@ bool DecoderImpl::HandleUTF8(const uint8_t* data, size_t remain_bytes, size_t* b
 }
 
 void DecoderImpl::PushCharacter(uint32_t ucs4, uint32_t pua) {
+    if (!text_only_ && !generate_caption_text_ && !generate_char_u8str_) {
+        PushCharacter(ucs4, utf::UTF8Char{}, pua);
+        return;
+    }
+    PushCharacter(ucs4, utf::EncodeUTF8(ucs4), pua);
+}
+
+void DecoderImpl::PushCharacter(uint32_t ucs4, const utf::UTF8Char& u8char, uint32_t pua) {
+    if (text_only_) {
+        if (!IsRubyMode()) {
+            caption_->text.append(u8char.bytes, u8char.length);
+        }
+        has_text_only_chars_ = true;
+        caption_char_count_++;
+        return;
+    }
+
     CaptionChar caption_char;
     caption_char.type = CaptionCharType::kText;
     caption_char.codepoint = ucs4;
     caption_char.pua_codepoint = pua;
 
-    size_t u8count = utf::UTF8AppendCodePoint(caption_char.u8str, ucs4);
-    caption_char.u8str[u8count] = '\0';
+    if (generate_char_u8str_) {
+        // u8char.bytes is zero-padded, the terminator comes along
+        memcpy(caption_char.u8str, u8char.bytes, sizeof(u8char.bytes));
+    }
 
-    if (!IsRubyMode()) {
-        utf::UTF8AppendCodePoint(caption_->text, ucs4);
+    if (generate_caption_text_ && !IsRubyMode()) {
+        caption_->text.append(u8char.bytes, u8char.length);
     }
 
     ApplyCaptionCharCommonProperties(caption_char);
-    PushCaptionChar(caption_char);
+    PushCaptionChar(caption_char, 0);
 }
 
-void DecoderImpl::PushDRCSCharacter(uint32_t code, DRCS& drcs) {
+void DecoderImpl::PushDRCSCharacter(uint32_t code, const DRCS& drcs) {
+    if (text_only_) {
+        if (drcs.alternative_text.empty()) {
+            utf::UTF8AppendCodePoint(caption_->text, 0x3013);  // Geta Mark
+        } else if (!IsRubyMode()) {
+            caption_->text.append(drcs.alternative_text);
+        }
+        has_text_only_chars_ = true;
+        caption_char_count_++;
+        return;
+    }
+
     CaptionChar caption_char;
 
     if (drcs.alternative_text.empty()) {
         caption_char.type = CaptionCharType::kDRCS;
-        utf::UTF8AppendCodePoint(caption_->text, 0x3013);  // Fill a Geta Mark here
+        if (generate_caption_text_)
+            utf::UTF8AppendCodePoint(caption_->text, 0x3013);  // Fill a Geta Mark here
     } else {
         caption_char.type = CaptionCharType::kDRCSReplaced;
-        strcpy(caption_char.u8str, drcs.alternative_text.c_str());
+        if (generate_char_u8str_)
+            strcpy(caption_char.u8str, drcs.alternative_text.c_str());
         caption_char.codepoint = drcs.alternative_ucs4;
-        if (!IsRubyMode())
+        if (generate_caption_text_ && !IsRubyMode())
             caption_->text.append(drcs.alternative_text);
     }
 
     auto iter = caption_->drcs_map.find(code);
     if (iter == caption_->drcs_map.end()) {
-        caption_->drcs_map.insert({code, drcs});
+        if (spare_drcs_nodes_.empty()) {
+            caption_->drcs_map.insert({code, drcs});
+        } else {
+            // Copy into a recycled node, which keeps capacity of the pixels buffer
+            auto node = std::move(spare_drcs_nodes_.back());
+            spare_drcs_nodes_.pop_back();
+            node.key() = code;
+            node.mapped() = drcs;
+            caption_->drcs_map.insert(std::move(node));
+        }
     }
 
     caption_char.drcs_code = code;
 
     ApplyCaptionCharCommonProperties(caption_char);
-    PushCaptionChar(caption_char);
+    // DRCS codes could be redefined, thus the pattern itself is fingerprinted
+    PushCaptionChar(caption_char, HashDRCSPattern(drcs.width, drcs.height, drcs.depth,
+                                                  drcs.pixels.data(), drcs.pixels.size()));
 }
 
-void DecoderImpl::PushCaptionChar(const CaptionChar& caption_char) {
+void DecoderImpl::PushCaptionChar(const CaptionChar& caption_char, uint64_t drcs_fingerprint) {
     if (NeedNewCaptionRegion()) {
         MakeNewCaptionRegion();
     }
     CaptionRegion& region = caption_->regions.back();
     region.width += caption_char.section_width();
     region.chars.push_back(caption_char);
+    region.fingerprint = FingerprintCaptionChar(region.fingerprint, caption_char, drcs_fingerprint);
+    caption_char_count_++;
 }
 
 void DecoderImpl::ApplyCaptionCharCommonProperties(CaptionChar& caption_char) {
@@ -1405,6 +2178,11 @@ void DecoderImpl::MakeNewCaptionRegion() {
 
     CaptionRegion& region = caption_->regions.back();
 
+    if (!spare_region_chars_.empty() && region.chars.capacity() == 0) {
+        region.chars = std::move(spare_region_chars_.back());
+        spare_region_chars_.pop_back();
+    }
+
     region.x = active_pos_x_;
     region.y = active_pos_y_ - section_height();
     region.height = section_height();
@@ -1412,6 +2190,12 @@ void DecoderImpl::MakeNewCaptionRegion() {
     if (IsRubyMode()) {
         region.is_ruby = true;
     }
+
+    uint64_t words[2] = {
+        static_cast<uint32_t>(region.x) | static_cast<uint64_t>(static_cast<uint32_t>(region.y)) << 32,
+        static_cast<uint32_t>(region.height) | static_cast<uint64_t>(region.is_ruby) << 32,
+    };
+    region.fingerprint = xxhash::Hash64(reinterpret_cast<const uint8_t*>(words), sizeof(words));
 }
 
 bool DecoderImpl::IsRubyMode() const {
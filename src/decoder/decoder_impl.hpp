@@ -24,12 +24,20 @@
 #include <cstdint>
 #include <initializer_list>
 #include <memory>
+#include <optional>
 #include <unordered_map>
+#include <vector>
 #include "aribcaption/caption.hpp"
 #include "aribcaption/context.hpp"
 #include "aribcaption/decoder.hpp"
+#include "base/flat_map.hpp"
 #include "base/logger.hpp"
+#include "base/memory_allocator.hpp"
+#include "base/metrics.hpp"
+#include "base/tracer.hpp"
+#include "base/utf_helper.hpp"
 #include "decoder/b24_codesets.hpp"
+#include "decoder/pes_capture.hpp"
 
 namespace aribcaption::internal {
 
@@ -47,29 +55,85 @@ public:
     void SetProfile(Profile profile);
     void SwitchLanguage(LanguageId language_id);
     void SetReplaceMSZFullWidthAlphanumeric(bool replace);
+    void SetReuseCaptionStorage(bool reuse);
+    void SetTextOnly(bool text_only) { text_only_ = text_only; }
+    void SetGenerateCaptionText(bool generate) { generate_caption_text_ = generate; }
+    void SetGenerateCharUTF8(bool generate) { generate_char_u8str_ = generate; }
+    void SetDecodeAllLanguages(bool enable);
+    void SetDecodeLimits(const DecodeLimits& limits) { limits_ = limits; }
+    void SetDeduplicateCaptions(bool enable);
+    bool SetCaptureFile(const std::string& filename);
     [[nodiscard]]
     uint32_t QueryISO6392LanguageCode(LanguageId language_id) const;
     DecodeStatus Decode(const uint8_t* pes_data, size_t length, int64_t pts, DecodeResult& out_result);
+    DecodeStatus DecodeBatch(const DecodePacket* packets, size_t count, DecodeBatchResult& out_result);
+    DecodeStatus DecodeArchive(const DecodePacket* packets, size_t count, size_t thread_count,
+                               DecodeBatchResult& out_result);
+    DecodeStatus Feed(const uint8_t* data, size_t length, int64_t pts, bool packet_start, DecodeResult& out_result);
+
+    // Storage for batch decoding result passed through the C API
+    DecodeBatchResult& capi_batch_result() {
+        return capi_batch_result_;
+    }
+
+    // Allocator for caption storage passed through the C API
+    [[nodiscard]]
+    const MemoryAllocator& allocator() const {
+        return *allocator_;
+    }
     void Flush();
+    void SaveState(std::vector<uint8_t>& out_state) const;
+    bool RestoreState(const uint8_t* data, size_t size);
 private:
     auto DetectEncodingScheme() -> EncodingScheme;
     void ResetGraphicSets();
     void ResetWritingFormat();
     void ResetInternalState();
+    struct StatementState;
+    void SaveStatementState(StatementState& state) const;
+    void LoadStatementState(const StatementState& state);
+    void SwitchStatementLanguage(LanguageId language_id);
+    std::unique_ptr<DecoderImpl> CreateArchiveWorker();
+    void CapturePacket(const uint8_t* pes_data, size_t length, int64_t pts);
+    DecodeStatus DecodePES(const uint8_t* pes_data,
+                           size_t length,
+                           int64_t pts,
+                           DecodeResult& out_result,
+                           bool reuse_storage);
+    DecodeStatus ParsePES(const uint8_t* pes_data,
+                          size_t length,
+                          int64_t pts,
+                          DecodeResult& out_result,
+                          bool reuse_storage);
+    void PrepareCaption(DecodeResult& out_result, bool reuse_storage);
     bool ParseCaptionManagementData(const uint8_t* data, size_t length);
     bool ParseCaptionStatementData(const uint8_t* data, size_t length);
     bool ParseDataUnit(const uint8_t* data, size_t length);
     bool ParseStatementBody(const uint8_t* data, size_t length);
+    bool CheckDecodeLimits();
+    bool CheckDuplicateCaption(DecodeResult& out_result);
+    void ReportDecodeLimitExceeded(const char* name, size_t limit);
     bool ParseDRCS(const uint8_t* data, size_t length, size_t byte_count);
+    std::shared_ptr<const DRCS> InternDRCS(int width, int height, int depth, int depth_bits,
+                                           const uint8_t* pixels, size_t size);
     bool HandleC0(const uint8_t* data, size_t remain_bytes, size_t* bytes_processed);
     bool HandleESC(const uint8_t* data, size_t remain_bytes, size_t* bytes_processed);
     bool HandleC1(const uint8_t* data, size_t remain_bytes, size_t* bytes_processed);
     bool HandleCSI(const uint8_t* data, size_t remain_bytes, size_t* bytes_processed);
     bool HandleGLGR(const uint8_t* data, size_t remain_bytes, size_t* bytes_processed, CodesetEntry* entry);
+    bool HandleGraphicRun(const uint8_t* data, size_t remain_bytes, size_t* bytes_processed);
+    bool HandleTableChar(size_t gx_index, uint8_t ch, uint8_t ch2);
+    bool HandleKanjiChar(size_t gx_index, uint8_t ch, uint8_t ch2);
+    bool HandleAlphanumericChar(size_t gx_index, uint8_t ch, uint8_t ch2);
+    bool HandleMacroChar(size_t gx_index, uint8_t ch, uint8_t ch2);
+    bool HandleDRCSChar(size_t gx_index, uint8_t ch, uint8_t ch2);
+    bool HandleUnsupportedChar(size_t gx_index, uint8_t ch, uint8_t ch2);
+    void DesignateGraphicSet(size_t gx_index, const CodesetEntry& entry);
     bool HandleUTF8(const uint8_t* data, size_t remain_bytes, size_t* bytes_processed);
     void PushCharacter(uint32_t ucs4, uint32_t pua = 0);
-    void PushDRCSCharacter(uint32_t code, DRCS& drcs);
-    void PushCaptionChar(const CaptionChar& caption_char);
+    void PushCharacter(uint32_t ucs4, const utf::UTF8Char& u8char, uint32_t pua = 0);
+    void PushDRCSCharacter(uint32_t code, const DRCS& drcs);
+    void PushCaptionChar(const CaptionChar& caption_char, uint64_t drcs_fingerprint);
     void ApplyCaptionCharCommonProperties(CaptionChar& caption_char);
     bool NeedNewCaptionRegion();
     void MakeNewCaptionRegion();
@@ -96,8 +160,46 @@ private:
         uint8_t TCS = 0;
         uint32_t iso6392_language_code = 0;
     };
+
+    // Writing states carried between statements, kept per language in all-languages mode
+    struct StatementState {
+        std::array<CodesetEntry, 4> GX = {kKanjiEntry, kAlphanumericEntry, kHiraganaEntry, kMacroEntry};
+        size_t GL_index = 0;
+        size_t GR_index = 2;
+        uint8_t swf = 7;
+        int caption_plane_width = 960;
+        int caption_plane_height = 540;
+        int display_area_width = 960;
+        int display_area_height = 540;
+        int display_area_start_x = 0;
+        int display_area_start_y = 0;
+        bool active_pos_inited = false;
+        int active_pos_x = 0;
+        int active_pos_y = 0;
+        int char_width = 36;
+        int char_height = 36;
+        int char_horizontal_spacing = 4;
+        int char_vertical_spacing = 24;
+        float char_horizontal_scale = 1.0f;
+        float char_vertical_scale = 1.0f;
+        bool has_underline = false;
+        bool has_bold = false;
+        bool has_italic = false;
+        bool has_stroke = false;
+        ColorRGBA stroke_color;
+        EnclosureStyle enclosure_style = EnclosureStyle::kEnclosureStyleDefault;
+        bool has_builtin_sound = false;
+        uint8_t builtin_sound_id = 0;
+        uint8_t palette = 0;
+        ColorRGBA text_color;
+        ColorRGBA back_color;
+    };
 private:
+    Context& context_;
     std::shared_ptr<Logger> log_;
+    std::shared_ptr<MemoryAllocator> allocator_;
+    std::shared_ptr<Metrics> metrics_;
+    std::shared_ptr<Tracer> tracer_;
 
     EncodingScheme request_encoding_ = EncodingScheme::kAuto;
     EncodingScheme active_encoding_ = EncodingScheme::kARIB_STD_B24_JIS;
@@ -108,12 +210,58 @@ private:
 
     bool replace_msz_fullwidth_ascii_ = false;
 
+    // Only fill Caption::text, skip building CaptionChars / regions
+    bool text_only_ = false;
+    bool has_text_only_chars_ = false;
+
+    // Consumers reading codepoints only (e.g. renderers) may skip the UTF-8 representations
+    bool generate_caption_text_ = true;
+    bool generate_char_u8str_ = true;
+
     std::vector<LanguageInfo> language_infos_;
     uint32_t current_iso6392_language_code_ = 0;
     int prev_dgi_group_ = -1;
+    std::vector<uint8_t> last_management_data_;  // Payload of the caption management data applied last time
+
+    // Decode statements of every language, see SetDecodeAllLanguages()
+    bool decode_all_languages_ = false;
+    LanguageId statement_language_ = LanguageId::kDefault;  // Language whose writing states are loaded
+    std::array<std::optional<StatementState>, static_cast<size_t>(LanguageId::kMax)> language_states_;
 
     std::unique_ptr<Caption> caption_;
 
+    // Hard limits for the packet being decoded, see SetDecodeLimits()
+    DecodeLimits limits_;
+    size_t decode_steps_ = 0;
+    size_t caption_char_count_ = 0;
+    bool decode_limit_exceeded_ = false;
+
+    // Caption returned last time, for suppressing retransmissions, see SetDeduplicateCaptions()
+    bool deduplicate_captions_ = false;
+    bool has_last_caption_ = false;
+    uint64_t last_caption_fingerprint_ = 0;
+    int64_t last_caption_pts_ = 0;
+    int64_t last_caption_duration_ = 0;
+
+    // Containers kept between Decode() calls if caption storage reusing is enabled
+    bool reuse_caption_storage_ = false;
+    std::vector<std::vector<CaptionChar>> spare_region_chars_;
+    std::vector<DRCSMap::node_type> spare_drcs_nodes_;
+
+    DecodeResult batch_result_;
+    DecodeBatchResult capi_batch_result_;
+
+    // Packets are recorded before decoding if capturing, see SetCaptureFile()
+    std::unique_ptr<PESCaptureWriter> capture_writer_;
+
+    // PES data reassembled from fragments passed into Feed()
+    bool feed_pending_ = false;
+    int64_t feed_pts_ = 0;
+    std::vector<uint8_t> feed_buffer_;
+
+    // Character handler of G0~G3, bound on designation so that HandleGLGR() doesn't have to branch on the graphic set
+    using GraphicSetHandler = bool (DecoderImpl::*)(size_t gx_index, uint8_t ch, uint8_t ch2);
+
     CodesetEntry* GL_ = nullptr;
     CodesetEntry* GR_ = nullptr;
     std::array<CodesetEntry, 4> GX_ = {
@@ -122,7 +270,15 @@ private:
         kHiraganaEntry,      // G2
         kMacroEntry          // G3
     };
-    std::vector<std::unordered_map<uint16_t, DRCS>> drcs_maps_{16};
+    std::array<GraphicSetHandler, 4> GX_handlers_{};
+    std::array<const uint32_t*, 4> GX_tables_{};  // conversion table for 1-byte sets handled by HandleTableChar()
+    std::array<const utf::UTF8Char*, 4> GX_u8_tables_{};  // pre-encoded UTF-8 form of GX_tables_
+    std::vector<FlatMap<uint16_t, std::shared_ptr<const DRCS>>> drcs_maps_{16};
+
+    // Interned DRCS patterns keyed by content hash, shared across packets
+    // so that MD5 and replacement lookup runs once per distinct pattern
+    static constexpr size_t kMaxInternedDRCS = 1024;
+    std::unordered_map<uint64_t, std::shared_ptr<const DRCS>> drcs_store_;
 
     int64_t pts_ = PTS_NOPTS;  // in milliseconds
 
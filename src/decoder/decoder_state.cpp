@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <utility>
+#include "base/binary_io.hpp"
+#include "decoder/decoder_impl.hpp"
+
+namespace aribcaption::internal {
+
+namespace {
+
+constexpr uint32_t kStateMagic = 0x53444341;  // "ACDS"
+constexpr uint32_t kStateVersion = 1;
+
+constexpr size_t kMaxLanguageInfos = 8;
+
+void WriteColor(BinaryWriter& writer, ColorRGBA color) {
+    writer.WriteU8(color.r);
+    writer.WriteU8(color.g);
+    writer.WriteU8(color.b);
+    writer.WriteU8(color.a);
+}
+
+ColorRGBA ReadColor(BinaryReader& reader) {
+    uint8_t r = reader.ReadU8();
+    uint8_t g = reader.ReadU8();
+    uint8_t b = reader.ReadU8();
+    uint8_t a = reader.ReadU8();
+    return ColorRGBA(r, g, b, a);
+}
+
+}  // namespace
+
+void DecoderImpl::SaveState(std::vector<uint8_t>& out_state) const {
+    out_state.clear();
+    BinaryWriter writer(out_state);
+
+    writer.WriteU32(kStateMagic);
+    writer.WriteU32(kStateVersion);
+
+    // Decoder configuration, must match on restoring
+    writer.WriteI32(static_cast<int32_t>(type_));
+    writer.WriteU8(static_cast<uint8_t>(profile_));
+    writer.WriteU8(static_cast<uint8_t>(language_id_));
+
+    // Caption management data
+    writer.WriteI32(static_cast<int32_t>(active_encoding_));
+    writer.WriteVarUInt(language_infos_.size());
+    for (const LanguageInfo& info : language_infos_) {
+        writer.WriteU8(static_cast<uint8_t>(info.language_id));
+        writer.WriteU8(info.DMF);
+        writer.WriteU8(info.format);
+        writer.WriteU8(info.TCS);
+        writer.WriteU32(info.iso6392_language_code);
+    }
+    writer.WriteU32(current_iso6392_language_code_);
+    writer.WriteI32(prev_dgi_group_);
+
+    // Graphic sets and their invocations
+    for (const CodesetEntry& entry : GX_) {
+        writer.WriteU8(static_cast<uint8_t>(entry.graphics_set));
+        writer.WriteU8(entry.bytes);
+    }
+    writer.WriteU8(static_cast<uint8_t>(GL_ - GX_.data()));
+    writer.WriteU8(static_cast<uint8_t>(GR_ - GX_.data()));
+
+    // Writing format and active position
+    writer.WriteU8(swf_);
+    writer.WriteI32(caption_plane_width_);
+    writer.WriteI32(caption_plane_height_);
+    writer.WriteI32(display_area_width_);
+    writer.WriteI32(display_area_height_);
+    writer.WriteI32(display_area_start_x_);
+    writer.WriteI32(display_area_start_y_);
+    writer.WriteU8(active_pos_inited_);
+    writer.WriteI32(active_pos_x_);
+    writer.WriteI32(active_pos_y_);
+    writer.WriteI32(char_width_);
+    writer.WriteI32(char_height_);
+    writer.WriteI32(char_horizontal_spacing_);
+    writer.WriteI32(char_vertical_spacing_);
+    writer.WriteFloat(char_horizontal_scale_);
+    writer.WriteFloat(char_vertical_scale_);
+
+    // Character styles
+    writer.WriteU8(has_underline_);
+    writer.WriteU8(has_bold_);
+    writer.WriteU8(has_italic_);
+    writer.WriteU8(has_stroke_);
+    WriteColor(writer, stroke_color_);
+    writer.WriteU8(static_cast<uint8_t>(enclosure_style_));
+    writer.WriteU8(has_builtin_sound_);
+    writer.WriteU8(builtin_sound_id_);
+    writer.WriteU8(palette_);
+    WriteColor(writer, text_color_);
+    WriteColor(writer, back_color_);
+
+    // DRCS patterns, MD5 digests and replacements are recomputed on restoring.
+    // FlatMap iterates in order of codes, so identical states are always serialized into identical bytes.
+    for (const auto& drcs_map : drcs_maps_) {
+        writer.WriteVarUInt(drcs_map.size());
+        for (const auto& [code, drcs] : drcs_map) {
+            writer.WriteU16(code);
+            writer.WriteU8(static_cast<uint8_t>(drcs->width));
+            writer.WriteU8(static_cast<uint8_t>(drcs->height));
+            writer.WriteU8(static_cast<uint8_t>(drcs->depth));
+            writer.WriteU8(static_cast<uint8_t>(drcs->depth_bits));
+            writer.WriteVarUInt(drcs->pixels.size());
+            writer.WriteBytes(drcs->pixels.data(), drcs->pixels.size());
+        }
+    }
+}
+
+bool DecoderImpl::RestoreState(const uint8_t* data, size_t size) {
+    BinaryReader reader(data, size);
+    has_last_caption_ = false;  // Not a part of the snapshot, the next caption is always returned
+
+    if (reader.ReadU32() != kStateMagic || reader.ReadU32() != kStateVersion) {
+        log_->e("DecoderImpl: Invalid decoder state snapshot");
+        return false;
+    }
+
+    auto type = static_cast<CaptionType>(reader.ReadI32());
+    auto profile = static_cast<Profile>(reader.ReadU8());
+    auto language_id = static_cast<LanguageId>(reader.ReadU8());
+    if (!reader.ok() || type != type_ || profile != profile_ || language_id != language_id_) {
+        log_->e("DecoderImpl: Decoder state snapshot was saved with different caption type, profile or language");
+        return false;
+    }
+
+    // Parse everything into locals first, so that a corrupted snapshot leaves current states untouched
+    auto active_encoding = static_cast<EncodingScheme>(reader.ReadI32());
+
+    std::vector<LanguageInfo> language_infos;
+    uint64_t language_count = reader.ReadVarUInt();
+    if (language_count > kMaxLanguageInfos) {
+        log_->e("DecoderImpl: Invalid language count in decoder state snapshot");
+        return false;
+    }
+    for (uint64_t i = 0; i < language_count; i++) {
+        LanguageInfo info;
+        info.language_id = static_cast<LanguageId>(reader.ReadU8());
+        info.DMF = reader.ReadU8();
+        info.format = reader.ReadU8();
+        info.TCS = reader.ReadU8();
+        info.iso6392_language_code = reader.ReadU32();
+        language_infos.push_back(info);
+    }
+    uint32_t current_iso6392_language_code = reader.ReadU32();
+    int prev_dgi_group = reader.ReadI32();
+
+    std::array<CodesetEntry, 4> gx = GX_;
+    for (CodesetEntry& entry : gx) {
+        uint8_t set = reader.ReadU8();
+        uint8_t bytes = reader.ReadU8();
+        if (set > static_cast<uint8_t>(GraphicSet::kMacro) || bytes < 1 || bytes > 2) {
+            log_->e("DecoderImpl: Invalid graphic set in decoder state snapshot");
+            return false;
+        }
+        entry = CodesetEntry(static_cast<GraphicSet>(set), bytes);
+    }
+    uint8_t gl_index = reader.ReadU8();
+    uint8_t gr_index = reader.ReadU8();
+    if (gl_index >= gx.size() || gr_index >= gx.size()) {
+        log_->e("DecoderImpl: Invalid GL/GR invocation in decoder state snapshot");
+        return false;
+    }
+
+    uint8_t swf = reader.ReadU8();
+    int caption_plane_width = reader.ReadI32();
+    int caption_plane_height = reader.ReadI32();
+    int display_area_width = reader.ReadI32();
+    int display_area_height = reader.ReadI32();
+    int display_area_start_x = reader.ReadI32();
+    int display_area_start_y = reader.ReadI32();
+    bool active_pos_inited = reader.ReadU8();
+    int active_pos_x = reader.ReadI32();
+    int active_pos_y = reader.ReadI32();
+    int char_width = reader.ReadI32();
+    int char_height = reader.ReadI32();
+    int char_horizontal_spacing = reader.ReadI32();
+    int char_vertical_spacing = reader.ReadI32();
+    float char_horizontal_scale = reader.ReadFloat();
+    float char_vertical_scale = reader.ReadFloat();
+
+    bool has_underline = reader.ReadU8();
+    bool has_bold = reader.ReadU8();
+    bool has_italic = reader.ReadU8();
+    bool has_stroke = reader.ReadU8();
+    ColorRGBA stroke_color = ReadColor(reader);
+    auto enclosure_style = static_cast<EnclosureStyle>(reader.ReadU8());
+    bool has_builtin_sound = reader.ReadU8();
+    uint8_t builtin_sound_id = reader.ReadU8();
+    uint8_t palette = reader.ReadU8();
+    ColorRGBA text_color = ReadColor(reader);
+    ColorRGBA back_color = ReadColor(reader);
+
+    std::vector<FlatMap<uint16_t, std::shared_ptr<const DRCS>>> drcs_maps(drcs_maps_.size());
+    for (auto& drcs_map : drcs_maps) {
+        uint64_t count = reader.ReadVarUInt();
+        for (uint64_t i = 0; i < count && reader.ok(); i++) {
+            uint16_t code = reader.ReadU16();
+            int width = reader.ReadU8();
+            int height = reader.ReadU8();
+            int depth = reader.ReadU8();
+            int depth_bits = reader.ReadU8();
+            auto pixels_size = static_cast<size_t>(reader.ReadVarUInt());
+            const uint8_t* pixels = reader.ReadBytes(pixels_size);
+            if (!pixels || !pixels_size || pixels_size != static_cast<size_t>(width) * height * depth_bits / 8) {
+                log_->e("DecoderImpl: Invalid DRCS pattern in decoder state snapshot");
+                return false;
+            }
+            drcs_map.insert_or_assign(code, InternDRCS(width, height, depth, depth_bits, pixels, pixels_size));
+        }
+    }
+
+    if (!reader.ok()) {
+        log_->e("DecoderImpl: Truncated decoder state snapshot");
+        return false;
+    }
+
+    active_encoding_ = active_encoding;
+    language_infos_ = std::move(language_infos);
+    current_iso6392_language_code_ = current_iso6392_language_code;
+    prev_dgi_group_ = prev_dgi_group;
+
+    for (size_t i = 0; i < gx.size(); i++) {
+        DesignateGraphicSet(i, gx[i]);
+    }
+    GL_ = &GX_[gl_index];
+    GR_ = &GX_[gr_index];
+
+    swf_ = swf;
+    caption_plane_width_ = caption_plane_width;
+    caption_plane_height_ = caption_plane_height;
+    display_area_width_ = display_area_width;
+    display_area_height_ = display_area_height;
+    display_area_start_x_ = display_area_start_x;
+    display_area_start_y_ = display_area_start_y;
+    active_pos_inited_ = active_pos_inited;
+    active_pos_x_ = active_pos_x;
+    active_pos_y_ = active_pos_y;
+    char_width_ = char_width;
+    char_height_ = char_height;
+    char_horizontal_spacing_ = char_horizontal_spacing;
+    char_vertical_spacing_ = char_vertical_spacing;
+    char_horizontal_scale_ = char_horizontal_scale;
+    char_vertical_scale_ = char_vertical_scale;
+
+    has_underline_ = has_underline;
+    has_bold_ = has_bold;
+    has_italic_ = has_italic;
+    has_stroke_ = has_stroke;
+    stroke_color_ = stroke_color;
+    enclosure_style_ = enclosure_style;
+    has_builtin_sound_ = has_builtin_sound;
+    builtin_sound_id_ = builtin_sound_id;
+    palette_ = palette;
+    text_color_ = text_color;
+    back_color_ = back_color;
+
+    drcs_maps_ = std::move(drcs_maps);
+
+    // Restored states take the place of the indicated language, others start over
+    statement_language_ = language_id_;
+    language_states_.fill(std::nullopt);
+    last_management_data_.clear();
+    return true;
+}
+
+}  // namespace aribcaption::internal
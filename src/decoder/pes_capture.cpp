@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cstring>
+#include "decoder/pes_capture.hpp"
+
+#if defined(_WIN32)
+    #include "base/wchar_helper.hpp"
+#endif
+
+namespace aribcaption {
+
+static FILE* OpenCaptureFile(const std::string& filename) {
+#if defined(_WIN32)
+    return _wfopen(wchar::UTF8ToWideString(filename).c_str(), L"wb");
+#else
+    return fopen(filename.c_str(), "wb");
+#endif
+}
+
+PESCaptureWriter::~PESCaptureWriter() {
+    Close();
+}
+
+bool PESCaptureWriter::Open(const std::string& filename) {
+    Close();
+    file_ = OpenCaptureFile(filename);
+    if (!file_) {
+        return false;
+    }
+
+    buffer_.clear();
+    BinaryWriter writer(buffer_);
+    writer.WriteU32(kPESCaptureMagic);
+    writer.WriteU32(kPESCaptureVersion);
+    if (fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size() || fflush(file_) != 0) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void PESCaptureWriter::Close() {
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+bool PESCaptureWriter::Write(const PESCaptureRecord& record) {
+    if (!file_) {
+        return false;
+    }
+
+    buffer_.clear();
+    BinaryWriter writer(buffer_);
+    writer.WriteI64(record.pts);
+    writer.WriteU8(static_cast<uint8_t>(record.type));
+    writer.WriteU8(static_cast<uint8_t>(record.profile));
+    writer.WriteU8(static_cast<uint8_t>(record.encoding_scheme));
+    writer.WriteU8(static_cast<uint8_t>(record.language_id));
+    writer.WriteU32(static_cast<uint32_t>(record.length));
+    writer.WriteBytes(record.data, record.length);
+
+    return fwrite(buffer_.data(), 1, buffer_.size(), file_) == buffer_.size() && fflush(file_) == 0;
+}
+
+}  // namespace aribcaption
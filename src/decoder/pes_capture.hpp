@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_PES_CAPTURE_HPP
+#define ARIBCAPTION_PES_CAPTURE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "aribcaption/caption.hpp"
+#include "aribcaption/decoder.hpp"
+#include "base/binary_io.hpp"
+
+namespace aribcaption {
+
+/**
+ * Capture files of caption PES packets fed into a Decoder, see Decoder::SetCaptureFile()
+ *
+ * Little-endian layout: magic "APCF", u32 version, followed by records of
+ * i64 PTS, u8 caption type, u8 profile, u8 requested encoding scheme, u8 language id, u32 length, PES data.
+ */
+constexpr uint32_t kPESCaptureMagic = 0x46435041;  // "APCF"
+constexpr uint32_t kPESCaptureVersion = 1;
+
+struct PESCaptureRecord {
+    int64_t pts = 0;
+    CaptionType type = CaptionType::kDefault;
+    Profile profile = Profile::kDefault;
+    EncodingScheme encoding_scheme = EncodingScheme::kAuto;
+    LanguageId language_id = LanguageId::kDefault;
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+};
+
+class PESCaptureWriter {
+public:
+    PESCaptureWriter() = default;
+    ~PESCaptureWriter();
+public:
+    // Create or truncate the file, in UTF-8 path
+    bool Open(const std::string& filename);
+    void Close();
+    [[nodiscard]]
+    bool IsOpen() const { return file_ != nullptr; }
+
+    // Records are flushed one by one, so that a capture survives the crash of the process being investigated
+    bool Write(const PESCaptureRecord& record);
+public:
+    PESCaptureWriter(const PESCaptureWriter&) = delete;
+    PESCaptureWriter& operator=(const PESCaptureWriter&) = delete;
+private:
+    FILE* file_ = nullptr;
+    std::vector<uint8_t> buffer_;
+};
+
+// Iterates records of a capture file in memory. Header only, so that tools could read captures standalone
+class PESCaptureReader {
+public:
+    PESCaptureReader(const uint8_t* data, size_t size) : reader_(data, size) {
+        valid_ = reader_.ReadU32() == kPESCaptureMagic && reader_.ReadU32() == kPESCaptureVersion && reader_.ok();
+    }
+
+    [[nodiscard]]
+    bool valid() const { return valid_; }
+
+    // Returns false at the end, or if the rest of the file is truncated. Record data points into the file
+    bool Next(PESCaptureRecord& record) {
+        if (!valid_ || !reader_.remaining()) {
+            return false;
+        }
+        record.pts = reader_.ReadI64();
+        record.type = static_cast<CaptionType>(reader_.ReadU8());
+        record.profile = static_cast<Profile>(reader_.ReadU8());
+        record.encoding_scheme = static_cast<EncodingScheme>(reader_.ReadU8());
+        record.language_id = static_cast<LanguageId>(reader_.ReadU8());
+        record.length = reader_.ReadU32();
+        record.data = reader_.ReadBytes(record.length);
+        return reader_.ok() && record.data;
+    }
+private:
+    BinaryReader reader_;
+    bool valid_ = false;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_PES_CAPTURE_HPP
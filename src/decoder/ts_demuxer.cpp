@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "aribcaption/ts_demuxer.hpp"
+#include "decoder/ts_demuxer_impl.hpp"
+
+namespace aribcaption {
+
+TSDemuxer::TSDemuxer(Context& context) : pimpl_(std::make_unique<internal::TSDemuxerImpl>(context)) {}
+
+TSDemuxer::~TSDemuxer() = default;
+
+TSDemuxer::TSDemuxer(TSDemuxer&&) noexcept = default;
+
+TSDemuxer& TSDemuxer::operator=(TSDemuxer&&) noexcept = default;
+
+void TSDemuxer::SetPacketCallback(PacketCallback callback) {
+    pimpl_->SetPacketCallback(std::move(callback));
+}
+
+void TSDemuxer::SetProgramNumber(uint16_t program_number) {
+    pimpl_->SetProgramNumber(program_number);
+}
+
+void TSDemuxer::Feed(const uint8_t* data, size_t size) {
+    pimpl_->Feed(data, size);
+}
+
+bool TSDemuxer::FeedFile(const std::string& filename) {
+    return pimpl_->FeedFile(filename);
+}
+
+void TSDemuxer::Flush() {
+    pimpl_->Flush();
+}
+
+void TSDemuxer::Seek(uint64_t offset) {
+    pimpl_->Seek(offset);
+}
+
+void TSDemuxer::Reset() {
+    pimpl_->Reset();
+}
+
+const std::vector<TSCaptionStream>& TSDemuxer::GetCaptionStreams() const {
+    return pimpl_->GetCaptionStreams();
+}
+
+int64_t TSDemuxer::GetFirstVideoPTS() const {
+    return pimpl_->GetFirstVideoPTS();
+}
+
+}  // namespace aribcaption
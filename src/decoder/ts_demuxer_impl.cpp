@@ -0,0 +1,518 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "base/mapped_file.hpp"
+#include "decoder/ts_demuxer_impl.hpp"
+
+namespace aribcaption::internal {
+
+namespace {
+
+constexpr uint8_t kSyncByte = 0x47;
+constexpr uint16_t kPATPID = 0x0000;
+constexpr uint16_t kARIBCaptionDataComponentId = 0x0008;
+constexpr int64_t kPTSWrap = INT64_C(1) << 33;
+
+constexpr std::array<uint32_t, 256> MakeCRC32Table() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i << 24;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint32_t, 256> kCRC32Table = MakeCRC32Table();
+
+// CRC-32/MPEG-2 over a whole section, including its CRC_32 field, is zero if intact
+bool IsSectionCRCValid(const uint8_t* section, size_t size) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc = (crc << 8) ^ kCRC32Table[((crc >> 24) ^ section[i]) & 0xFF];
+    }
+    return crc == 0;
+}
+
+bool IsVideoStreamType(uint8_t stream_type) {
+    // MPEG-1 / MPEG-2 / MPEG-4 Visual / H.264 / H.265
+    return stream_type == 0x01 || stream_type == 0x02 || stream_type == 0x10 ||
+           stream_type == 0x1B || stream_type == 0x24;
+}
+
+int64_t ReadPTS(const uint8_t* p) {
+    return (static_cast<int64_t>(p[0] & 0x0E) << 29) |
+           (static_cast<int64_t>(p[1]) << 22) |
+           (static_cast<int64_t>(p[2] & 0xFE) << 14) |
+           (static_cast<int64_t>(p[3]) << 7) |
+           (static_cast<int64_t>(p[4]) >> 1);
+}
+
+// Locate payload of a PES packet, returns false if it isn't a valid PES packet
+bool ParsePESHeader(const uint8_t* pes, size_t size, size_t& out_payload_offset, int64_t& out_pts) {
+    if (size < 6 || pes[0] != 0x00 || pes[1] != 0x00 || pes[2] != 0x01) {
+        return false;
+    }
+
+    uint8_t stream_id = pes[3];
+    out_pts = PTS_NOPTS;
+
+    if (stream_id == 0xBC || stream_id == 0xBE || stream_id == 0xBF ||
+        stream_id == 0xF0 || stream_id == 0xF1 || stream_id == 0xF2 || stream_id == 0xF8 || stream_id == 0xFF) {
+        // No PES header extension, e.g. private_stream_2 used by asynchronous PES
+        out_payload_offset = 6;
+        return true;
+    }
+
+    if (size < 9) {
+        return false;
+    }
+    uint8_t PTS_DTS_flags = pes[7] >> 6;
+    size_t PES_header_data_length = pes[8];
+    out_payload_offset = 9 + PES_header_data_length;
+    if (out_payload_offset > size) {
+        return false;
+    }
+    if ((PTS_DTS_flags & 0b10) && PES_header_data_length >= 5) {
+        out_pts = ReadPTS(pes + 9);
+    }
+    return true;
+}
+
+}  // namespace
+
+TSDemuxerImpl::TSDemuxerImpl(Context& context) : log_(GetContextLogger(context)) {}
+
+TSDemuxerImpl::~TSDemuxerImpl() = default;
+
+void TSDemuxerImpl::SetProgramNumber(uint16_t program_number) {
+    if (program_number_ != program_number) {
+        program_number_ = program_number;
+        Reset();
+    }
+}
+
+void TSDemuxerImpl::Feed(const uint8_t* data, size_t size) {
+    if (carry_size_) {
+        size_t copy_size = std::min(kPacketSize - carry_size_, size);
+        memcpy(carry_.data() + carry_size_, data, copy_size);
+        carry_size_ += copy_size;
+        data += copy_size;
+        size -= copy_size;
+        position_ += copy_size;
+        if (carry_size_ < kPacketSize) {
+            return;
+        }
+        packet_offset_ = carry_offset_;
+        ProcessPacket(carry_.data());
+        carry_size_ = 0;
+    }
+
+    while (size) {
+        if (data[0] != kSyncByte) {
+            // Lost sync, skip to the next sync byte
+            auto sync = static_cast<const uint8_t*>(memchr(data, kSyncByte, size));
+            if (!sync) {
+                position_ += size;
+                return;
+            }
+            auto skipped = static_cast<size_t>(sync - data);
+            size -= skipped;
+            position_ += skipped;
+            data = sync;
+        }
+        if (size < kPacketSize) {
+            memcpy(carry_.data(), data, size);
+            carry_size_ = size;
+            carry_offset_ = position_;
+            position_ += size;
+            return;
+        }
+        packet_offset_ = position_;
+        ProcessPacket(data);
+        data += kPacketSize;
+        size -= kPacketSize;
+        position_ += kPacketSize;
+    }
+}
+
+bool TSDemuxerImpl::FeedFile(const std::string& filename) {
+    MappedFile file;
+    if (!file.Open(filename)) {
+        log_->e("TSDemuxer: Cannot map file %s", filename.c_str());
+        return false;
+    }
+    Feed(file.data(), file.size());
+    Flush();
+    return true;
+}
+
+void TSDemuxerImpl::Flush() {
+    carry_size_ = 0;
+    for (size_t i = 0; i < pes_buffers_.size(); i++) {
+        PESBuffer& buffer = pes_buffers_[i];
+        if (buffer.active && buffer.expected_size == 0) {
+            DeliverPES(i);
+        }
+        // Bounded PES packets which are still incomplete are truncated, drop them
+        buffer.active = false;
+        buffer.continuity_counter = -1;
+    }
+}
+
+void TSDemuxerImpl::Seek(uint64_t offset) {
+    carry_size_ = 0;
+    for (PESBuffer& buffer : pes_buffers_) {
+        buffer.active = false;
+        buffer.continuity_counter = -1;
+    }
+    position_ = offset;
+}
+
+void TSDemuxerImpl::Reset() {
+    carry_size_ = 0;
+    position_ = 0;
+    pat_section_.size = 0;
+    pmt_section_.size = 0;
+    pmt_pid_ = -1;
+    pmt_version_ = -1;
+    current_program_number_ = 0;
+    caption_streams_.clear();
+    pes_buffers_.clear();
+    video_pid_ = -1;
+    first_video_pts_ = PTS_NOPTS;
+    last_pts_ = PTS_NOPTS;
+    pts_wrap_offset_ = 0;
+}
+
+void TSDemuxerImpl::ProcessPacket(const uint8_t* packet) {
+    bool transport_error = packet[1] & 0x80;
+    bool unit_start = packet[1] & 0x40;
+    uint16_t pid = static_cast<uint16_t>((packet[1] & 0x1F) << 8 | packet[2]);
+    uint8_t adaptation_field_control = (packet[3] >> 4) & 0b11;
+    int continuity_counter = packet[3] & 0x0F;
+
+    if (transport_error) {
+        return;
+    }
+
+    size_t payload_offset = 4;
+    if (adaptation_field_control & 0b10) {
+        payload_offset += 1 + packet[4];
+    }
+    if (!(adaptation_field_control & 0b01) || payload_offset >= kPacketSize) {
+        return;  // No payload
+    }
+    const uint8_t* payload = packet + payload_offset;
+    size_t payload_size = kPacketSize - payload_offset;
+
+    if (pid == kPATPID) {
+        ProcessSectionPayload(pat_section_, payload, payload_size, unit_start, &TSDemuxerImpl::ParsePAT);
+        return;
+    } else if (pid == pmt_pid_) {
+        ProcessSectionPayload(pmt_section_, payload, payload_size, unit_start, &TSDemuxerImpl::ParsePMT);
+        return;
+    } else if (pid == video_pid_) {
+        if (unit_start && first_video_pts_ == PTS_NOPTS) {
+            ProcessVideoPayload(payload, payload_size);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < caption_streams_.size(); i++) {
+        if (caption_streams_[i].pid == pid) {
+            ProcessPESPayload(i, payload, payload_size, unit_start, continuity_counter);
+            return;
+        }
+    }
+}
+
+void TSDemuxerImpl::ProcessSectionPayload(SectionBuffer& section, const uint8_t* payload, size_t size,
+                                          bool unit_start, SectionHandler handler) {
+    if (!unit_start) {
+        if (section.size) {
+            AppendSection(section, payload, size, handler);
+        }
+        return;
+    }
+
+    size_t pointer_field = payload[0];
+    payload++;
+    size--;
+    if (pointer_field > size) {
+        section.size = 0;
+        return;
+    }
+
+    // Bytes before the pointed position finish the previous section
+    if (section.size) {
+        AppendSection(section, payload, pointer_field, handler);
+        section.size = 0;
+    }
+    payload += pointer_field;
+    size -= pointer_field;
+
+    // Stuffing bytes (0xFF) follow the last section
+    while (size && payload[0] != 0xFF) {
+        size_t consumed = AppendSection(section, payload, size, handler);
+        if (section.size) {
+            break;  // Continued in the next packet
+        }
+        payload += consumed;
+        size -= consumed;
+    }
+}
+
+size_t TSDemuxerImpl::AppendSection(SectionBuffer& section, const uint8_t* data, size_t size,
+                                    SectionHandler handler) {
+    size_t consumed = 0;
+    if (section.size < 3) {
+        size_t header_size = std::min(3 - section.size, size);
+        memcpy(section.data.data() + section.size, data, header_size);
+        section.size += header_size;
+        consumed += header_size;
+        if (section.size < 3) {
+            return consumed;
+        }
+    }
+
+    size_t section_size = 3 + ((section.data[1] & 0x0F) << 8 | section.data[2]);
+    if (section_size > kMaxSectionSize) {
+        section.size = 0;
+        return size;
+    }
+
+    size_t copy_size = std::min(section_size - section.size, size - consumed);
+    memcpy(section.data.data() + section.size, data + consumed, copy_size);
+    section.size += copy_size;
+    consumed += copy_size;
+
+    if (section.size == section_size) {
+        section.size = 0;
+        if (IsSectionCRCValid(section.data.data(), section_size)) {
+            (this->*handler)(section.data.data(), section_size);
+        } else {
+            log_->w("TSDemuxer: Section CRC mismatch, table_id: 0x%02X", section.data[0]);
+        }
+    }
+    return consumed;
+}
+
+void TSDemuxerImpl::ParsePAT(const uint8_t* section, size_t size) {
+    bool current_next_indicator = section[5] & 0x01;
+    if (section[0] != 0x00 || size < 12 || !current_next_indicator) {
+        return;
+    }
+
+    for (size_t offset = 8; offset + 4 <= size - 4; offset += 4) {
+        auto program_number = static_cast<uint16_t>(section[offset] << 8 | section[offset + 1]);
+        auto pid = static_cast<uint16_t>((section[offset + 2] & 0x1F) << 8 | section[offset + 3]);
+        if (program_number == 0) {
+            continue;  // network_PID
+        }
+        if (program_number_ != 0 && program_number != program_number_) {
+            continue;
+        }
+
+        if (pid != pmt_pid_ || program_number != current_program_number_) {
+            pmt_pid_ = pid;
+            pmt_version_ = -1;
+            pmt_section_.size = 0;
+            current_program_number_ = program_number;
+        }
+        return;
+    }
+}
+
+void TSDemuxerImpl::ParsePMT(const uint8_t* section, size_t size) {
+    bool current_next_indicator = section[5] & 0x01;
+    if (section[0] != 0x02 || size < 16 || !current_next_indicator) {
+        return;
+    }
+
+    auto program_number = static_cast<uint16_t>(section[3] << 8 | section[4]);
+    int version = (section[5] >> 1) & 0x1F;
+    if (program_number != current_program_number_ || version == pmt_version_) {
+        return;
+    }
+    pmt_version_ = version;
+
+    std::vector<TSCaptionStream> streams;
+    int video_pid = -1;
+
+    size_t program_info_length = (section[10] & 0x0F) << 8 | section[11];
+    size_t offset = 12 + program_info_length;
+    size_t end = size - 4;  // CRC_32
+
+    while (offset + 5 <= end) {
+        uint8_t stream_type = section[offset];
+        auto pid = static_cast<uint16_t>((section[offset + 1] & 0x1F) << 8 | section[offset + 2]);
+        size_t es_info_length = (section[offset + 3] & 0x0F) << 8 | section[offset + 4];
+        size_t descriptors_begin = offset + 5;
+        size_t descriptors_end = std::min(descriptors_begin + es_info_length, end);
+        offset = descriptors_begin + es_info_length;
+
+        if (IsVideoStreamType(stream_type)) {
+            if (video_pid == -1) {
+                video_pid = pid;
+            }
+            continue;
+        } else if (stream_type != 0x06) {
+            continue;
+        }
+
+        int component_tag = -1;
+        int data_component_id = -1;
+        for (size_t pos = descriptors_begin; pos + 2 <= descriptors_end;) {
+            uint8_t descriptor_tag = section[pos];
+            size_t descriptor_length = section[pos + 1];
+            const uint8_t* body = section + pos + 2;
+            pos += 2 + descriptor_length;
+            if (pos > descriptors_end) {
+                break;
+            }
+            if (descriptor_tag == 0x52 && descriptor_length >= 1) {
+                component_tag = body[0];  // stream_identifier_descriptor
+            } else if (descriptor_tag == 0xFD && descriptor_length >= 2) {
+                data_component_id = body[0] << 8 | body[1];  // data_component_descriptor
+            }
+        }
+
+        // Component tags 0x30-0x37 are assigned to captions, 0x38-0x3F to superimposes
+        bool is_caption_tag = component_tag >= 0x30 && component_tag <= 0x3F;
+        if (data_component_id != kARIBCaptionDataComponentId && !(data_component_id == -1 && is_caption_tag)) {
+            continue;
+        }
+
+        TSCaptionStream stream;
+        stream.program_number = program_number;
+        stream.pid = pid;
+        stream.component_tag = component_tag == -1 ? 0xFF : static_cast<uint8_t>(component_tag);
+        stream.type = component_tag >= 0x38 && component_tag <= 0x3F ? CaptionType::kSuperimpose
+                                                                     : CaptionType::kCaption;
+        streams.push_back(stream);
+    }
+
+    // Keep PES buffers of the streams still present, so that packets in progress survive a PMT update
+    std::vector<PESBuffer> pes_buffers(streams.size());
+    for (size_t i = 0; i < streams.size(); i++) {
+        auto iter = std::find_if(caption_streams_.begin(), caption_streams_.end(),
+                                 [&](const TSCaptionStream& s) { return s.pid == streams[i].pid; });
+        if (iter != caption_streams_.end()) {
+            pes_buffers[i] = std::move(pes_buffers_[static_cast<size_t>(iter - caption_streams_.begin())]);
+        } else {
+            pes_buffers[i].data.reserve(kMaxPESSize);
+        }
+    }
+
+    caption_streams_ = std::move(streams);
+    pes_buffers_ = std::move(pes_buffers);
+    video_pid_ = video_pid;
+}
+
+void TSDemuxerImpl::ProcessPESPayload(size_t index, const uint8_t* payload, size_t size,
+                                      bool unit_start, int continuity_counter) {
+    PESBuffer& buffer = pes_buffers_[index];
+
+    if (buffer.continuity_counter != -1) {
+        if (continuity_counter == buffer.continuity_counter) {
+            return;  // Duplicate packet
+        } else if (continuity_counter != ((buffer.continuity_counter + 1) & 0x0F)) {
+            buffer.active = false;  // Packets lost, drop the incomplete PES packet
+        }
+    }
+    buffer.continuity_counter = continuity_counter;
+
+    if (unit_start) {
+        if (buffer.active && buffer.expected_size == 0) {
+            DeliverPES(index);  // Unbounded PES packet is terminated by the next one
+        }
+        buffer.data.clear();
+        buffer.expected_size = 0;
+        buffer.offset = packet_offset_;
+        buffer.active = true;
+    } else if (!buffer.active) {
+        return;
+    }
+
+    size_t old_size = buffer.data.size();
+    if (old_size + size > kMaxPESSize) {
+        buffer.active = false;
+        return;
+    }
+    buffer.data.insert(buffer.data.end(), payload, payload + size);
+
+    if (old_size < 6 && buffer.data.size() >= 6) {
+        size_t PES_packet_length = buffer.data[4] << 8 | buffer.data[5];
+        buffer.expected_size = PES_packet_length ? 6 + PES_packet_length : 0;
+    }
+    if (buffer.expected_size && buffer.data.size() >= buffer.expected_size) {
+        DeliverPES(index);
+    }
+}
+
+void TSDemuxerImpl::DeliverPES(size_t index) {
+    PESBuffer& buffer = pes_buffers_[index];
+    buffer.active = false;
+
+    size_t size = buffer.expected_size ? buffer.expected_size : buffer.data.size();
+    size_t payload_offset = 0;
+    int64_t pts = PTS_NOPTS;
+    if (!ParsePESHeader(buffer.data.data(), size, payload_offset, pts) || payload_offset >= size) {
+        return;
+    }
+
+    TSCaptionPacket packet;
+    packet.stream = &caption_streams_[index];
+    packet.data = buffer.data.data() + payload_offset;
+    packet.length = size - payload_offset;
+    packet.pts = pts == PTS_NOPTS ? PTS_NOPTS : UnwrapPTS(pts) / 90;
+    packet.offset = buffer.offset;
+
+    if (callback_) {
+        callback_(packet);
+    }
+}
+
+void TSDemuxerImpl::ProcessVideoPayload(const uint8_t* payload, size_t size) {
+    size_t payload_offset = 0;
+    int64_t pts = PTS_NOPTS;
+    if (ParsePESHeader(payload, size, payload_offset, pts) && pts != PTS_NOPTS) {
+        first_video_pts_ = UnwrapPTS(pts) / 90;
+    }
+}
+
+int64_t TSDemuxerImpl::UnwrapPTS(int64_t pts) {
+    pts += pts_wrap_offset_;
+    if (last_pts_ != PTS_NOPTS) {
+        if (pts < last_pts_ - kPTSWrap / 2) {
+            pts_wrap_offset_ += kPTSWrap;
+            pts += kPTSWrap;
+        } else if (pts > last_pts_ + kPTSWrap / 2 && pts_wrap_offset_ >= kPTSWrap) {
+            return pts - kPTSWrap;  // Late packet from before the wrap around
+        }
+    }
+    last_pts_ = pts;
+    return pts;
+}
+
+}  // namespace aribcaption::internal
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_TS_DEMUXER_IMPL_HPP
+#define ARIBCAPTION_TS_DEMUXER_IMPL_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/ts_demuxer.hpp"
+#include "base/logger.hpp"
+
+namespace aribcaption::internal {
+
+class TSDemuxerImpl {
+public:
+    static constexpr size_t kPacketSize = 188;
+    static constexpr size_t kMaxSectionSize = 1024;
+    static constexpr size_t kMaxPESSize = 6 + 65535;
+public:
+    explicit TSDemuxerImpl(Context& context);
+    ~TSDemuxerImpl();
+public:
+    void SetPacketCallback(TSDemuxer::PacketCallback callback) { callback_ = std::move(callback); }
+    void SetProgramNumber(uint16_t program_number);
+    void Feed(const uint8_t* data, size_t size);
+    bool FeedFile(const std::string& filename);
+    void Flush();
+    void Seek(uint64_t offset);
+    void Reset();
+
+    [[nodiscard]]
+    const std::vector<TSCaptionStream>& GetCaptionStreams() const { return caption_streams_; }
+
+    [[nodiscard]]
+    int64_t GetFirstVideoPTS() const { return first_video_pts_; }
+private:
+    struct SectionBuffer {
+        std::array<uint8_t, kMaxSectionSize> data;
+        size_t size = 0;  // 0 if no section is being collected
+    };
+
+    struct PESBuffer {
+        std::vector<uint8_t> data;
+        size_t expected_size = 0;  // 0 if unknown yet or unbounded
+        uint64_t offset = 0;  // Input offset of the TS packet starting the PES packet
+        int continuity_counter = -1;
+        bool active = false;
+    };
+
+    using SectionHandler = void (TSDemuxerImpl::*)(const uint8_t* section, size_t size);
+private:
+    void ProcessPacket(const uint8_t* packet);
+    void ProcessSectionPayload(SectionBuffer& section, const uint8_t* payload, size_t size,
+                               bool unit_start, SectionHandler handler);
+    size_t AppendSection(SectionBuffer& section, const uint8_t* data, size_t size, SectionHandler handler);
+    void ParsePAT(const uint8_t* section, size_t size);
+    void ParsePMT(const uint8_t* section, size_t size);
+    void ProcessPESPayload(size_t index, const uint8_t* payload, size_t size, bool unit_start, int continuity_counter);
+    void DeliverPES(size_t index);
+    void ProcessVideoPayload(const uint8_t* payload, size_t size);
+    int64_t UnwrapPTS(int64_t pts);
+private:
+    std::shared_ptr<Logger> log_;
+    TSDemuxer::PacketCallback callback_;
+    uint16_t program_number_ = 0;
+
+    std::array<uint8_t, kPacketSize> carry_;  // Incomplete packet left from previous Feed()
+    size_t carry_size_ = 0;
+    uint64_t carry_offset_ = 0;
+
+    uint64_t position_ = 0;       // Input offset of the data being fed
+    uint64_t packet_offset_ = 0;  // Input offset of the TS packet being processed
+
+    SectionBuffer pat_section_;
+    SectionBuffer pmt_section_;
+    int pmt_pid_ = -1;
+    int pmt_version_ = -1;
+    uint16_t current_program_number_ = 0;
+
+    std::vector<TSCaptionStream> caption_streams_;
+    std::vector<PESBuffer> pes_buffers_;  // Parallel to caption_streams_
+
+    int video_pid_ = -1;
+    int64_t first_video_pts_ = PTS_NOPTS;
+
+    int64_t last_pts_ = PTS_NOPTS;  // In 90kHz, after unwrapping
+    int64_t pts_wrap_offset_ = 0;
+};
+
+}  // namespace aribcaption::internal
+
+#endif  // ARIBCAPTION_TS_DEMUXER_IMPL_HPP
@@ -22,11 +22,16 @@
 #include <cstddef>
 #include <cstdint>
 #include "aribcaption/color.hpp"
+#include "aribcaption/image.hpp"
 #include "base/always_inline.hpp"
 #include "renderer/alphablend_generic.hpp"
 
 #if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
 #include "renderer/alphablend_x86.hpp"
+#elif defined(__arm__) || defined(__aarch64__) || defined(_M_ARM) || defined(_M_ARM64)
+#include "renderer/alphablend_arm.hpp"
+#elif defined(__wasm__)
+#include "renderer/alphablend_wasm.hpp"
 #endif
 
 namespace aribcaption::alphablend {
@@ -34,6 +39,10 @@ namespace aribcaption::alphablend {
 ALWAYS_INLINE void FillLine(ColorRGBA* __restrict dest, ColorRGBA color, size_t width) {
 #if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
     internal::FillLine_x86(dest, color, width);
+#elif defined(__arm__) || defined(__aarch64__) || defined(_M_ARM) || defined(_M_ARM64)
+    internal::FillLine_ARM(dest, color, width);
+#elif defined(__wasm__)
+    internal::FillLine_WASM(dest, color, width);
 #else
     internal::FillLine_Generic(dest, color, width);
 #endif
@@ -43,6 +52,10 @@ ALWAYS_INLINE void FillLineWithAlphas(ColorRGBA* __restrict dest,
                                       const uint8_t* __restrict src_alphas, ColorRGBA color, size_t width) {
 #if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
     internal::FillLineWithAlphas_x86(dest, src_alphas, color, width);
+#elif defined(__arm__) || defined(__aarch64__) || defined(_M_ARM) || defined(_M_ARM64)
+    internal::FillLineWithAlphas_ARM(dest, src_alphas, color, width);
+#elif defined(__wasm__)
+    internal::FillLineWithAlphas_WASM(dest, src_alphas, color, width);
 #else
     internal::FillLineWithAlphas_Generic(dest, src_alphas, color, width);
 #endif
@@ -51,14 +64,37 @@ ALWAYS_INLINE void FillLineWithAlphas(ColorRGBA* __restrict dest,
 ALWAYS_INLINE void BlendColorToLine(ColorRGBA* __restrict dest, ColorRGBA color, size_t width) {
 #if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
     internal::BlendColorToLine_x86(dest, color, width);
+#elif defined(__arm__) || defined(__aarch64__) || defined(_M_ARM) || defined(_M_ARM64)
+    internal::BlendColorToLine_ARM(dest, color, width);
+#elif defined(__wasm__)
+    internal::BlendColorToLine_WASM(dest, color, width);
 #else
     internal::BlendColorToLine_Generic(dest, color, width);
 #endif
 }
 
+// Blend a solid color into the line, weighted by 8-bit per-pixel coverage.
+// Equivalent to FillLineWithAlphas() into a temporary line followed by BlendLine(), without the temporary.
+ALWAYS_INLINE void BlendColorWithAlphasToLine(ColorRGBA* __restrict dest,
+                                              const uint8_t* __restrict src_alphas, ColorRGBA color, size_t width) {
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    internal::BlendColorWithAlphasToLine_x86(dest, src_alphas, color, width);
+#elif defined(__arm__) || defined(__aarch64__) || defined(_M_ARM) || defined(_M_ARM64)
+    internal::BlendColorWithAlphasToLine_ARM(dest, src_alphas, color, width);
+#elif defined(__wasm__)
+    internal::BlendColorWithAlphasToLine_WASM(dest, src_alphas, color, width);
+#else
+    internal::BlendColorWithAlphasToLine_Generic(dest, src_alphas, color, width);
+#endif
+}
+
 ALWAYS_INLINE void BlendLine(ColorRGBA* __restrict dest, const ColorRGBA* __restrict src, size_t width) {
 #if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
     internal::BlendLine_x86(dest, src, width);
+#elif defined(__arm__) || defined(__aarch64__) || defined(_M_ARM) || defined(_M_ARM64)
+    internal::BlendLine_ARM(dest, src, width);
+#elif defined(__wasm__)
+    internal::BlendLine_WASM(dest, src, width);
 #else
     internal::BlendLine_Generic(dest, src, width);
 #endif
@@ -68,11 +104,53 @@ ALWAYS_INLINE void BlendLine_PremultipliedSrc(ColorRGBA* __restrict dest,
                                               const ColorRGBA* __restrict src, size_t width) {
 #if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
     internal::BlendLine_PremultipliedSrc_x86(dest, src, width);
+#elif defined(__arm__) || defined(__aarch64__) || defined(_M_ARM) || defined(_M_ARM64)
+    internal::BlendLine_PremultipliedSrc_ARM(dest, src, width);
+#elif defined(__wasm__)
+    internal::BlendLine_PremultipliedSrc_WASM(dest, src, width);
 #else
     internal::BlendLine_PremultipliedSrc_Generic(dest, src, width);
 #endif
 }
 
+// Blend premultiplied RGBA pixels onto a line of 8-bit (uint8_t) or P010 (uint16_t) luma samples
+template <typename Sample>
+ALWAYS_INLINE void BlendLumaLine(Sample* __restrict dest, const ColorRGBA* __restrict src,
+                                 size_t width, const YUVCoefficients& k) {
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    internal::BlendLumaLine_x86(dest, src, width, k);
+#else
+    internal::BlendLumaLine_Generic(dest, src, width, k);
+#endif
+}
+
+// Blend 2x2 blocks of premultiplied RGBA pixels from line0 and line1 onto subsampled chroma samples.
+// Both lines hold blocks * 2 pixels. With interleaved_uv (NV12 / P010), dest_v is expected to be dest_u + 1.
+template <typename Sample, bool interleaved_uv>
+ALWAYS_INLINE void BlendChromaLine(Sample* dest_u, Sample* dest_v,
+                                   const ColorRGBA* __restrict line0, const ColorRGBA* __restrict line1,
+                                   size_t blocks, const YUVCoefficients& k) {
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    internal::BlendChromaLine_x86<Sample, interleaved_uv>(dest_u, dest_v, line0, line1, blocks, k);
+#else
+    internal::BlendChromaLine_Generic<Sample, interleaved_uv>(dest_u, dest_v, line0, line1, blocks, k);
+#endif
+}
+
+// Convert straight alpha RGBA pixels into the layout of format in place, specialized per format at compile time
+template <PixelFormat format>
+ALWAYS_INLINE void ConvertLine(ColorRGBA* __restrict line, size_t width) {
+    if constexpr (format == PixelFormat::kRGBA8888Premultiplied) {
+        internal::ConvertLine_Generic<true, false>(line, width);
+    } else if constexpr (format == PixelFormat::kBGRA8888) {
+        internal::ConvertLine_Generic<false, true>(line, width);
+    } else if constexpr (format == PixelFormat::kBGRA8888Premultiplied) {
+        internal::ConvertLine_Generic<true, true>(line, width);
+    } else {
+        (void)line, (void)width;
+    }
+}
+
 }  // namespace aribcaption::alphablend
 
 #endif  // ARIBCAPTION_ALPHA_BLEND_HPP
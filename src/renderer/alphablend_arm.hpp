@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_ALPHABLEND_ARM_HPP
+#define ARIBCAPTION_ALPHABLEND_ARM_HPP
+
+#include <cstring>
+#include "renderer/alphablend_generic.hpp"
+
+// NEON is mandatory on AArch64, on 32-bit ARM it is only used when enabled at compile time
+#if defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define ARIBCC_HAS_NEON_KERNELS 1
+#endif
+
+namespace aribcaption::alphablend::internal {
+
+namespace arm {
+
+#if defined(ARIBCC_HAS_NEON_KERNELS)
+
+// Results of the NEON kernels are bit-exact with the x86 SSE2 / AVX2 kernels:
+// every product is truncated by >> 8 separately before the saturating add.
+
+// (x * y) >> 8, per channel
+ALWAYS_INLINE uint8x8_t MulHi(uint8x8_t x, uint8x8_t y) {
+    return vshrn_n_u16(vmull_u8(x, y), 8);
+}
+
+ALWAYS_INLINE uint8x8x4_t BlendPixels8(uint8x8x4_t dst, uint8x8x4_t src) {
+    uint8x8_t ff_minus_alpha = vmvn_u8(src.val[3]);
+    uint8x8x4_t result;
+    result.val[0] = vqadd_u8(MulHi(src.val[0], src.val[3]), MulHi(dst.val[0], ff_minus_alpha));
+    result.val[1] = vqadd_u8(MulHi(src.val[1], src.val[3]), MulHi(dst.val[1], ff_minus_alpha));
+    result.val[2] = vqadd_u8(MulHi(src.val[2], src.val[3]), MulHi(dst.val[2], ff_minus_alpha));
+    result.val[3] = vqadd_u8(MulHi(vdup_n_u8(255), src.val[3]), MulHi(dst.val[3], ff_minus_alpha));
+    return result;
+}
+
+ALWAYS_INLINE uint8x8x4_t BlendPixels8_PremultipliedSrc(uint8x8x4_t dst, uint8x8x4_t src) {
+    uint8x8_t ff_minus_alpha = vmvn_u8(src.val[3]);
+    uint8x8x4_t result;
+    result.val[0] = vqadd_u8(src.val[0], MulHi(dst.val[0], ff_minus_alpha));
+    result.val[1] = vqadd_u8(src.val[1], MulHi(dst.val[1], ff_minus_alpha));
+    result.val[2] = vqadd_u8(src.val[2], MulHi(dst.val[2], ff_minus_alpha));
+    result.val[3] = vqadd_u8(src.val[3], MulHi(dst.val[3], ff_minus_alpha));
+    return result;
+}
+
+ALWAYS_INLINE uint8x8x4_t LoadPixels8(const ColorRGBA* src) {
+    return vld4_u8(reinterpret_cast<const uint8_t*>(src));
+}
+
+ALWAYS_INLINE void StorePixels8(ColorRGBA* dest, uint8x8x4_t pixels) {
+    vst4_u8(reinterpret_cast<uint8_t*>(dest), pixels);
+}
+
+ALWAYS_INLINE void FillLine_NEON(ColorRGBA* __restrict dest, ColorRGBA color, size_t width) {
+    uint32x4_t color4 = vdupq_n_u32(color.u32);
+
+    size_t i = 0;
+    for (; i + 4 <= width; i += 4) {
+        vst1q_u32(reinterpret_cast<uint32_t*>(dest + i), color4);
+    }
+
+    FillLine_Generic(dest + i, color, width - i);
+}
+
+ALWAYS_INLINE void FillLineWithAlphas_NEON(ColorRGBA* __restrict dest,
+                                           const uint8_t* __restrict src, ColorRGBA color, size_t width) {
+    uint8x8x4_t pixels;
+    pixels.val[0] = vdup_n_u8(color.r);
+    pixels.val[1] = vdup_n_u8(color.g);
+    pixels.val[2] = vdup_n_u8(color.b);
+    uint8x8_t color_alpha = vdup_n_u8(color.a);
+
+    size_t i = 0;
+    for (; i + 8 <= width; i += 8) {
+        pixels.val[3] = MulHi(vld1_u8(src + i), color_alpha);
+        StorePixels8(dest + i, pixels);
+    }
+
+    FillLineWithAlphas_Generic(dest + i, src + i, color, width - i);
+}
+
+ALWAYS_INLINE void BlendColorToLine_NEON(ColorRGBA* __restrict dest, ColorRGBA color, size_t width) {
+    uint8x8x4_t src;
+    src.val[0] = vdup_n_u8(color.r);
+    src.val[1] = vdup_n_u8(color.g);
+    src.val[2] = vdup_n_u8(color.b);
+    src.val[3] = vdup_n_u8(color.a);
+
+    size_t i = 0;
+    for (; i + 8 <= width; i += 8) {
+        StorePixels8(dest + i, BlendPixels8(LoadPixels8(dest + i), src));
+    }
+
+    if (size_t remain = width - i) {
+        ColorRGBA dst[8];
+        memcpy(dst, dest + i, remain * sizeof(ColorRGBA));
+        StorePixels8(dst, BlendPixels8(LoadPixels8(dst), src));
+        memcpy(dest + i, dst, remain * sizeof(ColorRGBA));
+    }
+}
+
+ALWAYS_INLINE void BlendColorWithAlphasToLine_NEON(ColorRGBA* __restrict dest, const uint8_t* __restrict src_alphas,
+                                                   ColorRGBA color, size_t width) {
+    uint8x8x4_t src;
+    src.val[0] = vdup_n_u8(color.r);
+    src.val[1] = vdup_n_u8(color.g);
+    src.val[2] = vdup_n_u8(color.b);
+    uint8x8_t color_alpha = vdup_n_u8(color.a);
+
+    size_t i = 0;
+    for (; i + 8 <= width; i += 8) {
+        src.val[3] = MulHi(vld1_u8(src_alphas + i), color_alpha);
+        StorePixels8(dest + i, BlendPixels8(LoadPixels8(dest + i), src));
+    }
+
+    if (size_t remain = width - i) {
+        uint8_t alphas[8] = {0};
+        ColorRGBA dst[8];
+        memcpy(alphas, src_alphas + i, remain);
+        memcpy(dst, dest + i, remain * sizeof(ColorRGBA));
+        src.val[3] = MulHi(vld1_u8(alphas), color_alpha);
+        StorePixels8(dst, BlendPixels8(LoadPixels8(dst), src));
+        memcpy(dest + i, dst, remain * sizeof(ColorRGBA));
+    }
+}
+
+ALWAYS_INLINE void BlendLine_NEON(ColorRGBA* __restrict dest, const ColorRGBA* __restrict source, size_t width) {
+    size_t i = 0;
+    for (; i + 8 <= width; i += 8) {
+        StorePixels8(dest + i, BlendPixels8(LoadPixels8(dest + i), LoadPixels8(source + i)));
+    }
+
+    if (size_t remain = width - i) {
+        ColorRGBA src[8];
+        ColorRGBA dst[8];
+        memcpy(src, source + i, remain * sizeof(ColorRGBA));
+        memcpy(dst, dest + i, remain * sizeof(ColorRGBA));
+        StorePixels8(dst, BlendPixels8(LoadPixels8(dst), LoadPixels8(src)));
+        memcpy(dest + i, dst, remain * sizeof(ColorRGBA));
+    }
+}
+
+ALWAYS_INLINE void BlendLine_PremultipliedSrc_NEON(ColorRGBA* __restrict dest,
+                                                   const ColorRGBA* __restrict source, size_t width) {
+    size_t i = 0;
+    for (; i + 8 <= width; i += 8) {
+        StorePixels8(dest + i, BlendPixels8_PremultipliedSrc(LoadPixels8(dest + i), LoadPixels8(source + i)));
+    }
+
+    if (size_t remain = width - i) {
+        ColorRGBA src[8];
+        ColorRGBA dst[8];
+        memcpy(src, source + i, remain * sizeof(ColorRGBA));
+        memcpy(dst, dest + i, remain * sizeof(ColorRGBA));
+        StorePixels8(dst, BlendPixels8_PremultipliedSrc(LoadPixels8(dst), LoadPixels8(src)));
+        memcpy(dest + i, dst, remain * sizeof(ColorRGBA));
+    }
+}
+
+#endif  // defined(ARIBCC_HAS_NEON_KERNELS)
+
+}  // namespace arm
+
+
+ALWAYS_INLINE void FillLine_ARM(ColorRGBA* __restrict dest, ColorRGBA color, size_t width) {
+#if defined(ARIBCC_HAS_NEON_KERNELS)
+    arm::FillLine_NEON(dest, color, width);
+#else
+    FillLine_Generic(dest, color, width);
+#endif
+}
+
+ALWAYS_INLINE void FillLineWithAlphas_ARM(ColorRGBA* __restrict dest,
+                                          const uint8_t* __restrict src_alphas, ColorRGBA color, size_t width) {
+#if defined(ARIBCC_HAS_NEON_KERNELS)
+    arm::FillLineWithAlphas_NEON(dest, src_alphas, color, width);
+#else
+    FillLineWithAlphas_Generic(dest, src_alphas, color, width);
+#endif
+}
+
+ALWAYS_INLINE void BlendColorToLine_ARM(ColorRGBA* __restrict dest, ColorRGBA color, size_t width) {
+#if defined(ARIBCC_HAS_NEON_KERNELS)
+    arm::BlendColorToLine_NEON(dest, color, width);
+#else
+    BlendColorToLine_Generic(dest, color, width);
+#endif
+}
+
+ALWAYS_INLINE void BlendColorWithAlphasToLine_ARM(ColorRGBA* __restrict dest, const uint8_t* __restrict src_alphas,
+                                                  ColorRGBA color, size_t width) {
+#if defined(ARIBCC_HAS_NEON_KERNELS)
+    arm::BlendColorWithAlphasToLine_NEON(dest, src_alphas, color, width);
+#else
+    BlendColorWithAlphasToLine_Generic(dest, src_alphas, color, width);
+#endif
+}
+
+ALWAYS_INLINE void BlendLine_ARM(ColorRGBA* __restrict dest, const ColorRGBA* __restrict src, size_t width) {
+#if defined(ARIBCC_HAS_NEON_KERNELS)
+    arm::BlendLine_NEON(dest, src, width);
+#else
+    BlendLine_Generic(dest, src, width);
+#endif
+}
+
+ALWAYS_INLINE void BlendLine_PremultipliedSrc_ARM(ColorRGBA* __restrict dest,
+                                                  const ColorRGBA* __restrict src, size_t width) {
+#if defined(ARIBCC_HAS_NEON_KERNELS)
+    arm::BlendLine_PremultipliedSrc_NEON(dest, src, width);
+#else
+    BlendLine_PremultipliedSrc_Generic(dest, src, width);
+#endif
+}
+
+}  // namespace aribcaption::alphablend::internal
+
+#endif  // ARIBCAPTION_ALPHABLEND_ARM_HPP
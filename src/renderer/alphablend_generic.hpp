@@ -19,6 +19,7 @@
 #ifndef ARIBCAPTION_ALPHABLEND_GENERIC_HPP
 #define ARIBCAPTION_ALPHABLEND_GENERIC_HPP
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include "aribcaption/color.hpp"
@@ -31,6 +32,12 @@ ALWAYS_INLINE uint32_t Div255(uint32_t x) {
     return (x + 1 + (x >> 8)) >> 8;
 }
 
+// Rounded divide by 255, exact for multiples of 255 within the range of 10-bit samples
+ALWAYS_INLINE uint32_t Div255Round(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
 // Fast clamp to 255 algorithm
 ALWAYS_INLINE uint8_t Clamp255(uint32_t x) {
     x |= -(x > 255);
@@ -74,6 +81,13 @@ ALWAYS_INLINE ColorRGBA BlendColor_PremultipliedSrc(ColorRGBA bg_color, ColorRGB
     return ColorRGBA((b_r & mask_b_r) | (a_g & mask_a_g));
 }
 
+// 8-bit limited range RGB to YUV coefficients, scaled by 256
+struct YUVCoefficients {
+    int16_t yr, yg, yb;
+    int16_t ur, ug, ub;
+    int16_t vr, vg, vb;
+};
+
 
 namespace internal {
 
@@ -97,6 +111,15 @@ ALWAYS_INLINE void BlendColorToLine_Generic(ColorRGBA* __restrict dest, ColorRGB
     }
 }
 
+ALWAYS_INLINE void BlendColorWithAlphasToLine_Generic(ColorRGBA* __restrict dest,
+                                                      const uint8_t* __restrict src_alphas,
+                                                      ColorRGBA color, size_t width) {
+    for (size_t i = 0; i < width; i++) {
+        uint8_t alpha = (static_cast<uint32_t>(src_alphas[i]) * color.a) >> 8;
+        dest[i] = BlendColor(dest[i], ColorRGBA(color, alpha));
+    }
+}
+
 ALWAYS_INLINE void BlendLine_Generic(ColorRGBA* __restrict dest, const ColorRGBA* __restrict src, size_t width) {
     for (size_t i = 0; i < width; i++) {
         dest[i] = BlendColor(dest[i], src[i]);
@@ -110,6 +133,99 @@ ALWAYS_INLINE void BlendLine_PremultipliedSrc_Generic(ColorRGBA* __restrict dest
     }
 }
 
+// Convert straight alpha RGBA pixels into output layout in place
+template <bool premultiply, bool swap_r_b>
+ALWAYS_INLINE void ConvertLine_Generic(ColorRGBA* __restrict line, size_t width) {
+    for (size_t i = 0; i < width; i++) {
+        ColorRGBA color = line[i];
+        if constexpr (premultiply) {
+            color.r = static_cast<uint8_t>(Div255(static_cast<uint32_t>(color.r) * color.a));
+            color.g = static_cast<uint8_t>(Div255(static_cast<uint32_t>(color.g) * color.a));
+            color.b = static_cast<uint8_t>(Div255(static_cast<uint32_t>(color.b) * color.a));
+        }
+        if constexpr (swap_r_b) {
+            uint8_t r = color.r;
+            color.r = color.b;
+            color.b = r;
+        }
+        line[i] = color;
+    }
+}
+
+// Layout of YUV plane samples
+// uint8_t samples are 8-bit, uint16_t samples are 10-bit stored in the high bits (P010)
+template <typename Sample>
+struct YUVSampleTraits;
+
+template <>
+struct YUVSampleTraits<uint8_t> {
+    static constexpr int kShift = 0;     // bit depth - 8
+    static constexpr int kPadding = 0;   // unused low bits
+    static constexpr int kMax = 255;
+};
+
+template <>
+struct YUVSampleTraits<uint16_t> {
+    static constexpr int kShift = 2;
+    static constexpr int kPadding = 6;
+    static constexpr int kMax = 1023;
+};
+
+// Blend premultiplied RGBA pixels onto a line of luma samples
+// out = bg * (1 - a) + 16 * a + fg
+template <typename Sample>
+ALWAYS_INLINE void BlendLumaLine_Generic(Sample* __restrict dest, const ColorRGBA* __restrict src,
+                                         size_t width, const YUVCoefficients& k) {
+    using Traits = YUVSampleTraits<Sample>;
+    for (size_t i = 0; i < width; i++) {
+        ColorRGBA pixel = src[i];
+        if (pixel.a == 0) {
+            continue;
+        }
+        uint32_t dst = dest[i] >> Traits::kPadding;
+        int bg = static_cast<int>(Div255Round(dst * (255 - pixel.a) + (16u << Traits::kShift) * pixel.a));
+        int fg = ((k.yr * pixel.r + k.yg * pixel.g + k.yb * pixel.b) * (1 << Traits::kShift) + 128) >> 8;
+        dest[i] = static_cast<Sample>(std::clamp(bg + fg, 0, Traits::kMax) << Traits::kPadding);
+    }
+}
+
+// Blend 2x2 blocks of premultiplied RGBA pixels from two lines onto a line of subsampled chroma samples.
+// Each block is averaged, then blended as out = bg * (1 - a) + 128 * a + fg.
+// With interleaved_uv, U and V samples alternate in a single plane and dest_v is expected to be dest_u + 1.
+template <typename Sample, bool interleaved_uv>
+ALWAYS_INLINE void BlendChromaLine_Generic(Sample* dest_u, Sample* dest_v,
+                                           const ColorRGBA* __restrict line0, const ColorRGBA* __restrict line1,
+                                           size_t blocks, const YUVCoefficients& k) {
+    using Traits = YUVSampleTraits<Sample>;
+    constexpr size_t step = interleaved_uv ? 2 : 1;
+
+    for (size_t i = 0; i < blocks; i++) {
+        int r = 0, g = 0, b = 0, a = 0;
+        for (const ColorRGBA* line : {line0, line1}) {
+            for (size_t x = i * 2; x < i * 2 + 2; x++) {
+                r += line[x].r;
+                g += line[x].g;
+                b += line[x].b;
+                a += line[x].a;
+            }
+        }
+        if (a == 0) {
+            continue;
+        }
+        a = (a + 2) >> 2;
+
+        Sample& u = dest_u[i * step];
+        Sample& v = dest_v[i * step];
+        uint32_t neutral = (128u << Traits::kShift) * a;
+        int bg_u = static_cast<int>(Div255Round((u >> Traits::kPadding) * (255 - a) + neutral));
+        int bg_v = static_cast<int>(Div255Round((v >> Traits::kPadding) * (255 - a) + neutral));
+        int fg_u = ((k.ur * r + k.ug * g + k.ub * b) * (1 << Traits::kShift) + 512) >> 10;
+        int fg_v = ((k.vr * r + k.vg * g + k.vb * b) * (1 << Traits::kShift) + 512) >> 10;
+        u = static_cast<Sample>(std::clamp(bg_u + fg_u, 0, Traits::kMax) << Traits::kPadding);
+        v = static_cast<Sample>(std::clamp(bg_v + fg_v, 0, Traits::kMax) << Traits::kPadding);
+    }
+}
+
 }  // namespace internal
 
 
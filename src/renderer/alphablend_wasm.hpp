@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ARIBCAPTION_ALPHABLEND_WASM_HPP
+#define ARIBCAPTION_ALPHABLEND_WASM_HPP
+
+#include <cstring>
+#include "renderer/alphablend_generic.hpp"
+
+// WebAssembly SIMD is only used when enabled at compile time (-msimd128), there is no runtime detection
+#if defined(__wasm_simd128__)
+    #include <wasm_simd128.h>
+    #define ARIBCC_HAS_WASM_SIMD_KERNELS 1
+#endif
+
+namespace aribcaption::alphablend::internal {
+
+namespace wasm {
+
+#if defined(ARIBCC_HAS_WASM_SIMD_KERNELS)
+
+// Results of the wasm_simd128 kernels are bit-exact with the x86 SSE2 / AVX2 and NEON kernels:
+// every product is truncated by >> 8 separately before the saturating add.
+
+// (x * y) >> 8, per byte
+ALWAYS_INLINE v128_t MulHi(v128_t x, v128_t y) {
+    v128_t lo = wasm_u16x8_shr(wasm_u16x8_extmul_low_u8x16(x, y), 8);
+    v128_t hi = wasm_u16x8_shr(wasm_u16x8_extmul_high_u8x16(x, y), 8);
+    return wasm_u8x16_narrow_i16x8(lo, hi);
+}
+
+ALWAYS_INLINE v128_t AlphaMask() {
+    return wasm_i32x4_splat(static_cast<int32_t>(0xFF000000));
+}
+
+// Copy the alpha of each pixel into all of its 4 channels
+ALWAYS_INLINE v128_t BroadcastPixelAlphas(v128_t pixels) {
+    return wasm_i8x16_shuffle(pixels, pixels, 3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+}
+
+// Spread 4 of the 16 alphas, starting from alphas[4 * group], over the channels of 4 pixels
+template <int group>
+ALWAYS_INLINE v128_t SpreadAlphas(v128_t alphas) {
+    constexpr int i = group * 4;
+    return wasm_i8x16_shuffle(alphas, alphas,
+                              i, i, i, i, i + 1, i + 1, i + 1, i + 1,
+                              i + 2, i + 2, i + 2, i + 2, i + 3, i + 3, i + 3, i + 3);
+}
+
+// Replace alpha channels of 4 pixels in rgb by 4 of the 16 alphas, starting from alphas[4 * group]
+template <int group>
+ALWAYS_INLINE v128_t InsertAlphas(v128_t rgb, v128_t alphas) {
+    constexpr int i = 16 + group * 4;
+    return wasm_i8x16_shuffle(rgb, alphas, 0, 1, 2, i, 4, 5, 6, i + 1, 8, 9, 10, i + 2, 12, 13, 14, i + 3);
+}
+
+// src_rgb_ff holds the source colors with alpha channels set to 255, so that alpha comes out as
+// (255 * alpha) >> 8 + (dst_alpha * (255 - alpha)) >> 8 like the other channels
+ALWAYS_INLINE v128_t BlendPixels4(v128_t dst, v128_t src_rgb_ff, v128_t alpha4) {
+    return wasm_u8x16_add_sat(MulHi(src_rgb_ff, alpha4), MulHi(dst, wasm_v128_not(alpha4)));
+}
+
+ALWAYS_INLINE v128_t BlendPixels4(v128_t dst, v128_t src) {
+    return BlendPixels4(dst, wasm_v128_or(src, AlphaMask()), BroadcastPixelAlphas(src));
+}
+
+ALWAYS_INLINE v128_t BlendPixels4_PremultipliedSrc(v128_t dst, v128_t src) {
+    return wasm_u8x16_add_sat(src, MulHi(dst, wasm_v128_not(BroadcastPixelAlphas(src))));
+}
+
+ALWAYS_INLINE void FillLine_WASM(ColorRGBA* __restrict dest, ColorRGBA color, size_t width) {
+    v128_t color4 = wasm_i32x4_splat(static_cast<int32_t>(color.u32));
+
+    size_t i = 0;
+    for (; i + 4 <= width; i += 4) {
+        wasm_v128_store(dest + i, color4);
+    }
+
+    FillLine_Generic(dest + i, color, width - i);
+}
+
+ALWAYS_INLINE void FillLineWithAlphas_WASM(ColorRGBA* __restrict dest,
+                                           const uint8_t* __restrict src, ColorRGBA color, size_t width) {
+    v128_t color4 = wasm_i32x4_splat(static_cast<int32_t>(color.u32));
+    v128_t color_alpha = wasm_i8x16_splat(static_cast<int8_t>(color.a));
+
+    size_t i = 0;
+    for (; i + 16 <= width; i += 16) {
+        v128_t alphas = MulHi(wasm_v128_load(src + i), color_alpha);
+        wasm_v128_store(dest + i, InsertAlphas<0>(color4, alphas));
+        wasm_v128_store(dest + i + 4, InsertAlphas<1>(color4, alphas));
+        wasm_v128_store(dest + i + 8, InsertAlphas<2>(color4, alphas));
+        wasm_v128_store(dest + i + 12, InsertAlphas<3>(color4, alphas));
+    }
+
+    FillLineWithAlphas_Generic(dest + i, src + i, color, width - i);
+}
+
+ALWAYS_INLINE void BlendColorToLine_WASM(ColorRGBA* __restrict dest, ColorRGBA color, size_t width) {
+    v128_t color4 = wasm_i32x4_splat(static_cast<int32_t>(color.u32));
+    v128_t src_rgb_ff = wasm_v128_or(color4, AlphaMask());
+    v128_t alpha4 = wasm_i8x16_splat(static_cast<int8_t>(color.a));
+
+    size_t i = 0;
+    for (; i + 4 <= width; i += 4) {
+        wasm_v128_store(dest + i, BlendPixels4(wasm_v128_load(dest + i), src_rgb_ff, alpha4));
+    }
+
+    if (size_t remain = width - i) {
+        ColorRGBA dst[4];
+        memcpy(dst, dest + i, remain * sizeof(ColorRGBA));
+        wasm_v128_store(dst, BlendPixels4(wasm_v128_load(dst), src_rgb_ff, alpha4));
+        memcpy(dest + i, dst, remain * sizeof(ColorRGBA));
+    }
+}
+
+ALWAYS_INLINE void BlendColorWithAlphasToLine_WASM(ColorRGBA* __restrict dest, const uint8_t* __restrict src_alphas,
+                                                   ColorRGBA color, size_t width) {
+    v128_t src_rgb_ff = wasm_v128_or(wasm_i32x4_splat(static_cast<int32_t>(color.u32)), AlphaMask());
+    v128_t color_alpha = wasm_i8x16_splat(static_cast<int8_t>(color.a));
+
+    auto blend16 = [&](ColorRGBA* dst, const uint8_t* src) {
+        v128_t alphas = MulHi(wasm_v128_load(src), color_alpha);
+        wasm_v128_store(dst, BlendPixels4(wasm_v128_load(dst), src_rgb_ff, SpreadAlphas<0>(alphas)));
+        wasm_v128_store(dst + 4, BlendPixels4(wasm_v128_load(dst + 4), src_rgb_ff, SpreadAlphas<1>(alphas)));
+        wasm_v128_store(dst + 8, BlendPixels4(wasm_v128_load(dst + 8), src_rgb_ff, SpreadAlphas<2>(alphas)));
+        wasm_v128_store(dst + 12, BlendPixels4(wasm_v128_load(dst + 12), src_rgb_ff, SpreadAlphas<3>(alphas)));
+    };
+
+    size_t i = 0;
+    for (; i + 16 <= width; i += 16) {
+        blend16(dest + i, src_alphas + i);
+    }
+
+    if (size_t remain = width - i) {
+        uint8_t alphas[16] = {0};
+        ColorRGBA dst[16];
+        memcpy(alphas, src_alphas + i, remain);
+        memcpy(dst, dest + i, remain * sizeof(ColorRGBA));
+        blend16(dst, alphas);
+        memcpy(dest + i, dst, remain * sizeof(ColorRGBA));
+    }
+}
+
+ALWAYS_INLINE void BlendLine_WASM(ColorRGBA* __restrict dest, const ColorRGBA* __restrict source, size_t width) {
+    size_t i = 0;
+    for (; i + 4 <= width; i += 4) {
+        wasm_v128_store(dest + i, BlendPixels4(wasm_v128_load(dest + i), wasm_v128_load(source + i)));
+    }
+
+    if (size_t remain = width - i) {
+        ColorRGBA src[4];
+        ColorRGBA dst[4];
+        memcpy(src, source + i, remain * sizeof(ColorRGBA));
+        memcpy(dst, dest + i, remain * sizeof(ColorRGBA));
+        wasm_v128_store(dst, BlendPixels4(wasm_v128_load(dst), wasm_v128_load(src)));
+        memcpy(dest + i, dst, remain * sizeof(ColorRGBA));
+    }
+}
+
+ALWAYS_INLINE void BlendLine_PremultipliedSrc_WASM(ColorRGBA* __restrict dest,
+                                                   const ColorRGBA* __restrict source, size_t width) {
+    size_t i = 0;
+    for (; i + 4 <= width; i += 4) {
+        wasm_v128_store(dest + i, BlendPixels4_PremultipliedSrc(wasm_v128_load(dest + i), wasm_v128_load(source + i)));
+    }
+
+    if (size_t remain = width - i) {
+        ColorRGBA src[4];
+        ColorRGBA dst[4];
+        memcpy(src, source + i, remain * sizeof(ColorRGBA));
+        memcpy(dst, dest + i, remain * sizeof(ColorRGBA));
+        wasm_v128_store(dst, BlendPixels4_PremultipliedSrc(wasm_v128_load(dst), wasm_v128_load(src)));
+        memcpy(dest + i, dst, remain * sizeof(ColorRGBA));
+    }
+}
+
+#endif  // defined(ARIBCC_HAS_WASM_SIMD_KERNELS)
+
+}  // namespace wasm
+
+
+ALWAYS_INLINE void FillLine_WASM(ColorRGBA* __restrict dest, ColorRGBA color, size_t width) {
+#if defined(ARIBCC_HAS_WASM_SIMD_KERNELS)
+    wasm::FillLine_WASM(dest, color, width);
+#else
+    FillLine_Generic(dest, color, width);
+#endif
+}
+
+ALWAYS_INLINE void FillLineWithAlphas_WASM(ColorRGBA* __restrict dest,
+                                           const uint8_t* __restrict src_alphas, ColorRGBA color, size_t width) {
+#if defined(ARIBCC_HAS_WASM_SIMD_KERNELS)
+    wasm::FillLineWithAlphas_WASM(dest, src_alphas, color, width);
+#else
+    FillLineWithAlphas_Generic(dest, src_alphas, color, width);
+#endif
+}
+
+ALWAYS_INLINE void BlendColorToLine_WASM(ColorRGBA* __restrict dest, ColorRGBA color, size_t width) {
+#if defined(ARIBCC_HAS_WASM_SIMD_KERNELS)
+    wasm::BlendColorToLine_WASM(dest, color, width);
+#else
+    BlendColorToLine_Generic(dest, color, width);
+#endif
+}
+
+ALWAYS_INLINE void BlendColorWithAlphasToLine_WASM(ColorRGBA* __restrict dest, const uint8_t* __restrict src_alphas,
+                                                   ColorRGBA color, size_t width) {
+#if defined(ARIBCC_HAS_WASM_SIMD_KERNELS)
+    wasm::BlendColorWithAlphasToLine_WASM(dest, src_alphas, color, width);
+#else
+    BlendColorWithAlphasToLine_Generic(dest, src_alphas, color, width);
+#endif
+}
+
+ALWAYS_INLINE void BlendLine_WASM(ColorRGBA* __restrict dest, const ColorRGBA* __restrict src, size_t width) {
+#if defined(ARIBCC_HAS_WASM_SIMD_KERNELS)
+    wasm::BlendLine_WASM(dest, src, width);
+#else
+    BlendLine_Generic(dest, src, width);
+#endif
+}
+
+ALWAYS_INLINE void BlendLine_PremultipliedSrc_WASM(ColorRGBA* __restrict dest,
+                                                   const ColorRGBA* __restrict src, size_t width) {
+#if defined(ARIBCC_HAS_WASM_SIMD_KERNELS)
+    wasm::BlendLine_PremultipliedSrc_WASM(dest, src, width);
+#else
+    BlendLine_PremultipliedSrc_Generic(dest, src, width);
+#endif
+}
+
+}  // namespace aribcaption::alphablend::internal
+
+#endif  // ARIBCAPTION_ALPHABLEND_WASM_HPP
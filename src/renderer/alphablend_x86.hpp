@@ -22,7 +22,10 @@
 #include <xmmintrin.h>  // SSE
 #include <emmintrin.h>  // SSE2
 #include <algorithm>
+#include <cstring>
+#include "base/cpu_features.hpp"
 #include "renderer/alphablend_generic.hpp"
+#include "renderer/alphablend_x86_avx2.hpp"
 
 // Workaround Windows.h (minwindef.h) max/min macro definitions
 #ifdef max
@@ -267,6 +270,74 @@ ALWAYS_INLINE void BlendLine_SSE2(ColorRGBA* __restrict dest, const ColorRGBA* _
     }
 }
 
+ALWAYS_INLINE void BlendColorWithAlphasToLine_SSE2(ColorRGBA* __restrict dest, const uint8_t* __restrict src_alphas,
+                                                   ColorRGBA color, size_t width) {
+    //            RGBA_0xAABBGGRR
+    const __m128i mask_0xffffffff = _mm_cmpeq_epi8(_mm_setzero_si128(), _mm_setzero_si128());
+    const __m128i mask_0xff000000 = _mm_slli_epi32(mask_0xffffffff, 24);
+    const __m128i mask_0x00ff0000 = _mm_srli_epi32(mask_0xff000000, 8);
+    const __m128i mask_0x00ffffff = _mm_srli_epi32(mask_0xffffffff, 8);
+    const __m128i mask_0x00ff00ff = _mm_srli_epi16(mask_0xffffffff, 8);
+    const __m128i mask_0xff00ff00 = _mm_slli_epi16(mask_0xffffffff, 8);
+
+    uint32_t trailing_remain_pixels = 0;
+    if ((trailing_remain_pixels = width % 4) != 0) {
+        width -= trailing_remain_pixels;
+    }
+
+    __m128i color4 = _mm_set1_epi32(static_cast<int>(color.u32));
+    __m128i color4_rgb = _mm_and_si128(color4, mask_0x00ffffff);
+    __m128i color4_alpha = _mm_srli_epi32(_mm_and_si128(color4, mask_0xff000000), 8);
+
+    for (size_t i = 0; i < width; i += 4, dest += 4, src_alphas += 4) {
+        // Same as FillLineWithAlphas
+        __m128i alpha4 = _mm_cvtsi32_si128(*reinterpret_cast<const int*>(src_alphas));
+        alpha4 = _mm_unpacklo_epi8(alpha4, _mm_setzero_si128());
+        alpha4 = _mm_unpacklo_epi8(alpha4, _mm_setzero_si128());
+        alpha4 = _mm_slli_epi32(alpha4, 16);
+
+        __m128i weighted_alpha = _mm_and_si128(mask_0xff000000, _mm_mullo_epi16(color4_alpha, alpha4));
+        __m128i src = _mm_or_si128(color4_rgb, weighted_alpha);
+
+        // Same as BlendLine
+        __m128i src_a_g = _mm_srli_epi16(src, 8);                      // 0x00AA00GG
+        __m128i src_b_r = _mm_and_si128(src, mask_0x00ff00ff);         // 0x00BB00RR
+        __m128i src_alpha = _mm_shufflelo_epi16(src_a_g, 0b11110101);  // (lo)0x00AA00AA
+
+        src_a_g = _mm_or_si128(src_a_g, mask_0x00ff0000);              // 0x00FF00GG
+        src_alpha = _mm_shufflehi_epi16(src_alpha, 0b11110101);        // (hi)0x00AA00AA
+
+        src_b_r = _mm_mullo_epi16(src_b_r, src_alpha);
+        src_a_g = _mm_mullo_epi16(src_a_g, src_alpha);
+
+        src_b_r = _mm_srli_epi16(src_b_r, 8);                          // 0x00BB00RR
+        src_a_g = _mm_and_si128(src_a_g, mask_0xff00ff00);             // 0xAA00GG00
+
+        __m128i src_ff_minus_alpha = _mm_xor_si128(src_alpha, mask_0x00ff00ff);
+        __m128i multiplied_src = _mm_or_si128(src_b_r, src_a_g);       // (src)0xAABBGGRR
+
+        __m128i dst = _mm_loadu_si128(reinterpret_cast<__m128i*>(dest));
+
+        __m128i dst_b_r = _mm_and_si128(dst, mask_0x00ff00ff);
+        __m128i dst_a_g = _mm_srli_epi16(dst, 8);
+
+        dst_b_r = _mm_mullo_epi16(dst_b_r, src_ff_minus_alpha);
+        dst_a_g = _mm_mullo_epi16(dst_a_g, src_ff_minus_alpha);
+
+        dst_b_r = _mm_srli_epi16(dst_b_r, 8);
+        dst_a_g = _mm_and_si128(dst_a_g, mask_0xff00ff00);
+
+        __m128i result = _mm_adds_epu8(multiplied_src, _mm_or_si128(dst_b_r, dst_a_g));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), result);
+    }
+
+    if (trailing_remain_pixels) {
+        ColorRGBA src[4];
+        FillLineWithAlphas_Generic(src, src_alphas, color, trailing_remain_pixels);
+        BlendLine_SSE2(dest, src, trailing_remain_pixels);
+    }
+}
+
 ALWAYS_INLINE void BlendLine_PremultipliedSrc_SSE2(ColorRGBA* __restrict dest,
                                                    const ColorRGBA* __restrict source, size_t width) {
     //            RGBA_0xAABBGGRR
@@ -324,12 +395,197 @@ ALWAYS_INLINE void BlendLine_PremultipliedSrc_SSE2(ColorRGBA* __restrict dest,
     }
 }
 
+// Sum adjacent 32-bit lanes: [a0 + a1, a2 + a3, b0 + b1, b2 + b3]
+ALWAYS_INLINE __m128i HorizontalAddPairs_SSE2(__m128i a, __m128i b) {
+    __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1));
+    return _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+}
+
+// Same as Div255Round(), on 32-bit lanes
+ALWAYS_INLINE __m128i Div255Round_SSE2(__m128i x) {
+    x = _mm_add_epi32(x, _mm_set1_epi32(128));
+    return _mm_srli_epi32(_mm_add_epi32(x, _mm_srli_epi32(x, 8)), 8);
+}
+
+// Load 4 YUV samples into 32-bit lanes, with padding bits removed
+template <typename Sample>
+ALWAYS_INLINE __m128i LoadYUVSamples4_SSE2(const Sample* src) {
+    if constexpr (sizeof(Sample) == 1) {
+        int32_t samples;
+        std::memcpy(&samples, src, sizeof(samples));
+        __m128i result = _mm_unpacklo_epi8(_mm_cvtsi32_si128(samples), _mm_setzero_si128());
+        return _mm_unpacklo_epi16(result, _mm_setzero_si128());
+    } else {
+        __m128i result = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+        result = _mm_srli_epi16(result, YUVSampleTraits<Sample>::kPadding);
+        return _mm_unpacklo_epi16(result, _mm_setzero_si128());
+    }
+}
+
+// Load 4 interleaved UV pairs into 32-bit lanes of U and V
+template <typename Sample>
+ALWAYS_INLINE void LoadInterleavedYUVSamples4_SSE2(const Sample* src, __m128i& u, __m128i& v) {
+    __m128i uv;
+    if constexpr (sizeof(Sample) == 1) {
+        uv = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)), _mm_setzero_si128());
+    } else {
+        uv = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)),
+                            YUVSampleTraits<Sample>::kPadding);
+    }
+    u = _mm_and_si128(uv, _mm_set1_epi32(0x0000FFFF));
+    v = _mm_srli_epi32(uv, 16);
+}
+
+// Saturate 32-bit lanes of a and b into [0, max] as 16-bit lanes [a0 a1 a2 a3 b0 b1 b2 b3]
+template <typename Sample>
+ALWAYS_INLINE __m128i ClampYUVSamples_SSE2(__m128i a, __m128i b) {
+    __m128i result = _mm_packs_epi32(a, b);
+    result = _mm_max_epi16(result, _mm_setzero_si128());
+    return _mm_min_epi16(result, _mm_set1_epi16(YUVSampleTraits<Sample>::kMax));
+}
+
+// Store the low 4 samples of clamped 16-bit lanes
+template <typename Sample>
+ALWAYS_INLINE void StoreYUVSamples4_SSE2(Sample* dest, __m128i samples) {
+    if constexpr (sizeof(Sample) == 1) {
+        int32_t result = _mm_cvtsi128_si32(_mm_packus_epi16(samples, samples));
+        std::memcpy(dest, &result, sizeof(result));
+    } else {
+        samples = _mm_slli_epi16(samples, YUVSampleTraits<Sample>::kPadding);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dest), samples);
+    }
+}
+
+// Store 8 clamped 16-bit samples
+template <typename Sample>
+ALWAYS_INLINE void StoreYUVSamples8_SSE2(Sample* dest, __m128i samples) {
+    if constexpr (sizeof(Sample) == 1) {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dest), _mm_packus_epi16(samples, samples));
+    } else {
+        samples = _mm_slli_epi16(samples, YUVSampleTraits<Sample>::kPadding);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), samples);
+    }
+}
+
+// Sum up r, g, b and a of two 2x2 blocks into 16-bit lanes: [block0 rgba, block1 rgba]
+ALWAYS_INLINE __m128i SumBlocks2_SSE2(const ColorRGBA* line0, const ColorRGBA* line1) {
+    __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line0));
+    __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line1));
+    __m128i pixels01 = _mm_add_epi16(_mm_unpacklo_epi8(top, _mm_setzero_si128()),
+                                     _mm_unpacklo_epi8(bottom, _mm_setzero_si128()));
+    __m128i pixels23 = _mm_add_epi16(_mm_unpackhi_epi8(top, _mm_setzero_si128()),
+                                     _mm_unpackhi_epi8(bottom, _mm_setzero_si128()));
+    return _mm_add_epi16(_mm_unpacklo_epi64(pixels01, pixels23), _mm_unpackhi_epi64(pixels01, pixels23));
+}
+
+template <typename Sample>
+ALWAYS_INLINE void BlendLumaLine_SSE2(Sample* __restrict dest, const ColorRGBA* __restrict src,
+                                      size_t width, const YUVCoefficients& k) {
+    using Traits = YUVSampleTraits<Sample>;
+    const __m128i coeff_y = _mm_setr_epi16(k.yr, k.yg, k.yb, 0, k.yr, k.yg, k.yb, 0);
+    const __m128i mask_0x000000ff = _mm_set1_epi32(0xFF);
+    const __m128i black_level = _mm_set1_epi32((16 << Traits::kShift) << 16);
+    const __m128i rounding = _mm_set1_epi32(128);
+
+    uint32_t trailing_remain_pixels = 0;
+    if ((trailing_remain_pixels = width % 4) != 0) {
+        width -= trailing_remain_pixels;
+    }
+
+    for (size_t i = 0; i < width; i += 4, src += 4, dest += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        __m128i pixels01 = _mm_unpacklo_epi8(pixels, _mm_setzero_si128());  // r0 g0 b0 a0 r1 g1 b1 a1
+        __m128i pixels23 = _mm_unpackhi_epi8(pixels, _mm_setzero_si128());
+
+        __m128i fg = HorizontalAddPairs_SSE2(_mm_madd_epi16(pixels01, coeff_y), _mm_madd_epi16(pixels23, coeff_y));
+        fg = _mm_srai_epi32(_mm_add_epi32(_mm_slli_epi32(fg, Traits::kShift), rounding), 8);
+
+        // (lo)dst * (255 - a) + (hi)black * a
+        __m128i alpha = _mm_srli_epi32(pixels, 24);
+        __m128i weights = _mm_or_si128(_mm_xor_si128(alpha, mask_0x000000ff), _mm_slli_epi32(alpha, 16));
+        __m128i dst = _mm_or_si128(LoadYUVSamples4_SSE2(dest), black_level);
+        __m128i bg = Div255Round_SSE2(_mm_madd_epi16(dst, weights));
+
+        __m128i result = _mm_add_epi32(bg, fg);
+        StoreYUVSamples4_SSE2(dest, ClampYUVSamples_SSE2<Sample>(result, result));
+    }
+
+    if (trailing_remain_pixels) {
+        BlendLumaLine_Generic(dest, src, trailing_remain_pixels, k);
+    }
+}
+
+template <typename Sample, bool interleaved_uv>
+ALWAYS_INLINE void BlendChromaLine_SSE2(Sample* dest_u, Sample* dest_v,
+                                        const ColorRGBA* __restrict line0, const ColorRGBA* __restrict line1,
+                                        size_t blocks, const YUVCoefficients& k) {
+    using Traits = YUVSampleTraits<Sample>;
+    constexpr size_t step = interleaved_uv ? 2 : 1;
+    const __m128i coeff_u = _mm_setr_epi16(k.ur, k.ug, k.ub, 0, k.ur, k.ug, k.ub, 0);
+    const __m128i coeff_v = _mm_setr_epi16(k.vr, k.vg, k.vb, 0, k.vr, k.vg, k.vb, 0);
+    const __m128i coeff_a = _mm_setr_epi16(0, 0, 0, 1, 0, 0, 0, 1);
+    const __m128i mask_0x000000ff = _mm_set1_epi32(0xFF);
+    const __m128i neutral_level = _mm_set1_epi32((128 << Traits::kShift) << 16);
+    const __m128i rounding = _mm_set1_epi32(512);
+
+    uint32_t trailing_remain_blocks = 0;
+    if ((trailing_remain_blocks = blocks % 4) != 0) {
+        blocks -= trailing_remain_blocks;
+    }
+
+    for (size_t i = 0; i < blocks; i += 4, line0 += 8, line1 += 8, dest_u += 4 * step, dest_v += 4 * step) {
+        __m128i sum01 = SumBlocks2_SSE2(line0, line1);
+        __m128i sum23 = SumBlocks2_SSE2(line0 + 4, line1 + 4);
+
+        __m128i fg_u = HorizontalAddPairs_SSE2(_mm_madd_epi16(sum01, coeff_u), _mm_madd_epi16(sum23, coeff_u));
+        __m128i fg_v = HorizontalAddPairs_SSE2(_mm_madd_epi16(sum01, coeff_v), _mm_madd_epi16(sum23, coeff_v));
+        __m128i alpha = HorizontalAddPairs_SSE2(_mm_madd_epi16(sum01, coeff_a), _mm_madd_epi16(sum23, coeff_a));
+        fg_u = _mm_srai_epi32(_mm_add_epi32(_mm_slli_epi32(fg_u, Traits::kShift), rounding), 10);
+        fg_v = _mm_srai_epi32(_mm_add_epi32(_mm_slli_epi32(fg_v, Traits::kShift), rounding), 10);
+        alpha = _mm_srli_epi32(_mm_add_epi32(alpha, _mm_set1_epi32(2)), 2);
+
+        __m128i dst_u;
+        __m128i dst_v;
+        if constexpr (interleaved_uv) {
+            LoadInterleavedYUVSamples4_SSE2(dest_u, dst_u, dst_v);
+        } else {
+            dst_u = LoadYUVSamples4_SSE2(dest_u);
+            dst_v = LoadYUVSamples4_SSE2(dest_v);
+        }
+
+        // (lo)dst * (255 - a) + (hi)neutral * a
+        __m128i weights = _mm_or_si128(_mm_xor_si128(alpha, mask_0x000000ff), _mm_slli_epi32(alpha, 16));
+        __m128i bg_u = Div255Round_SSE2(_mm_madd_epi16(_mm_or_si128(dst_u, neutral_level), weights));
+        __m128i bg_v = Div255Round_SSE2(_mm_madd_epi16(_mm_or_si128(dst_v, neutral_level), weights));
+
+        // u0 u1 u2 u3 v0 v1 v2 v3
+        __m128i result = ClampYUVSamples_SSE2<Sample>(_mm_add_epi32(bg_u, fg_u), _mm_add_epi32(bg_v, fg_v));
+        if constexpr (interleaved_uv) {
+            StoreYUVSamples8_SSE2(dest_u, _mm_unpacklo_epi16(result, _mm_srli_si128(result, 8)));
+        } else {
+            StoreYUVSamples4_SSE2(dest_u, result);
+            StoreYUVSamples4_SSE2(dest_v, _mm_srli_si128(result, 8));
+        }
+    }
+
+    if (trailing_remain_blocks) {
+        BlendChromaLine_Generic<Sample, interleaved_uv>(dest_u, dest_v, line0, line1, trailing_remain_blocks, k);
+    }
+}
+
 #endif  // defined(__SSE2__) || defined(_MSC_VER)
 
 }  // namespace x86
 
 
 ALWAYS_INLINE void FillLine_x86(ColorRGBA* __restrict dest, ColorRGBA color, size_t width) {
+#if defined(ARIBCC_HAS_AVX2_KERNELS)
+    if (width >= x86::kAVX2MinWidth && cpu::HasAVX2()) {
+        x86::FillLine_AVX2(dest, color, width);
+        return;
+    }
+#endif
 #if defined(__SSE2__) || defined(_MSC_VER)
     x86::FillLine_SSE2(dest, color, width);
 #else
@@ -339,6 +595,12 @@ ALWAYS_INLINE void FillLine_x86(ColorRGBA* __restrict dest, ColorRGBA color, siz
 
 ALWAYS_INLINE void FillLineWithAlphas_x86(ColorRGBA* __restrict dest,
                                           const uint8_t* __restrict src_alphas, ColorRGBA color, size_t width) {
+#if defined(ARIBCC_HAS_AVX2_KERNELS)
+    if (width >= x86::kAVX2MinWidth && cpu::HasAVX2()) {
+        x86::FillLineWithAlphas_AVX2(dest, src_alphas, color, width);
+        return;
+    }
+#endif
 #if defined(__SSE2__) || defined(_MSC_VER)
     x86::FillLineWithAlphas_SSE2(dest, src_alphas, color, width);
 #else
@@ -347,6 +609,12 @@ ALWAYS_INLINE void FillLineWithAlphas_x86(ColorRGBA* __restrict dest,
 }
 
 ALWAYS_INLINE void BlendColorToLine_x86(ColorRGBA* __restrict dest, ColorRGBA color, size_t width) {
+#if defined(ARIBCC_HAS_AVX2_KERNELS)
+    if (width >= x86::kAVX2MinWidth && cpu::HasAVX2()) {
+        x86::BlendColorToLine_AVX2(dest, color, width);
+        return;
+    }
+#endif
 #if defined(__SSE2__) || defined(_MSC_VER)
     x86::BlendColorToLine_SSE2(dest, color, width);
 #else
@@ -354,7 +622,28 @@ ALWAYS_INLINE void BlendColorToLine_x86(ColorRGBA* __restrict dest, ColorRGBA co
 #endif
 }
 
+ALWAYS_INLINE void BlendColorWithAlphasToLine_x86(ColorRGBA* __restrict dest, const uint8_t* __restrict src_alphas,
+                                                  ColorRGBA color, size_t width) {
+#if defined(ARIBCC_HAS_AVX2_KERNELS)
+    if (width >= x86::kAVX2MinWidth && cpu::HasAVX2()) {
+        x86::BlendColorWithAlphasToLine_AVX2(dest, src_alphas, color, width);
+        return;
+    }
+#endif
+#if defined(__SSE2__) || defined(_MSC_VER)
+    x86::BlendColorWithAlphasToLine_SSE2(dest, src_alphas, color, width);
+#else
+    BlendColorWithAlphasToLine_Generic(dest, src_alphas, color, width);
+#endif
+}
+
 ALWAYS_INLINE void BlendLine_x86(ColorRGBA* __restrict dest, const ColorRGBA* __restrict src, size_t width) {
+#if defined(ARIBCC_HAS_AVX2_KERNELS)
+    if (width >= x86::kAVX2MinWidth && cpu::HasAVX2()) {
+        x86::BlendLine_AVX2(dest, src, width);
+        return;
+    }
+#endif
 #if defined(__SSE2__) || defined(_MSC_VER)
     x86::BlendLine_SSE2(dest, src, width);
 #else
@@ -364,6 +653,12 @@ ALWAYS_INLINE void BlendLine_x86(ColorRGBA* __restrict dest, const ColorRGBA* __
 
 ALWAYS_INLINE void BlendLine_PremultipliedSrc_x86(ColorRGBA* __restrict dest,
                                                   const ColorRGBA* __restrict src, size_t width) {
+#if defined(ARIBCC_HAS_AVX2_KERNELS)
+    if (width >= x86::kAVX2MinWidth && cpu::HasAVX2()) {
+        x86::BlendLine_PremultipliedSrc_AVX2(dest, src, width);
+        return;
+    }
+#endif
 #if defined(__SSE2__) || defined(_MSC_VER)
     x86::BlendLine_PremultipliedSrc_SSE2(dest, src, width);
 #else
@@ -371,6 +666,27 @@ ALWAYS_INLINE void BlendLine_PremultipliedSrc_x86(ColorRGBA* __restrict dest,
 #endif
 }
 
+template <typename Sample>
+ALWAYS_INLINE void BlendLumaLine_x86(Sample* __restrict dest, const ColorRGBA* __restrict src,
+                                     size_t width, const YUVCoefficients& k) {
+#if defined(__SSE2__) || defined(_MSC_VER)
+    x86::BlendLumaLine_SSE2(dest, src, width, k);
+#else
+    BlendLumaLine_Generic(dest, src, width, k);
+#endif
+}
+
+template <typename Sample, bool interleaved_uv>
+ALWAYS_INLINE void BlendChromaLine_x86(Sample* dest_u, Sample* dest_v,
+                                       const ColorRGBA* __restrict line0, const ColorRGBA* __restrict line1,
+                                       size_t blocks, const YUVCoefficients& k) {
+#if defined(__SSE2__) || defined(_MSC_VER)
+    x86::BlendChromaLine_SSE2<Sample, interleaved_uv>(dest_u, dest_v, line0, line1, blocks, k);
+#else
+    BlendChromaLine_Generic<Sample, interleaved_uv>(dest_u, dest_v, line0, line1, blocks, k);
+#endif
+}
+
 }  // namespace aribcaption::alphablend::internal
 
 #endif  // ARIBCAPTION_ALPHABLEND_X86_HPP
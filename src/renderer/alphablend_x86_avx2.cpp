@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "renderer/alphablend_x86_avx2.hpp"
+
+#if (defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)) && \
+    defined(ARIBCC_HAS_AVX2_KERNELS)
+
+#include <immintrin.h>
+#include <cstring>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    #define ARIBCC_TARGET_AVX2
+    #define ARIBCC_AVX2_INLINE __forceinline
+#else
+    #define ARIBCC_TARGET_AVX2 __attribute__((target("avx2")))
+    #define ARIBCC_AVX2_INLINE inline __attribute__((target("avx2"), __always_inline__))
+#endif
+
+namespace aribcaption::alphablend::internal::x86 {
+
+namespace {
+
+struct ConstantsAVX2 {
+    __m256i mask_0xff000000;
+    __m256i mask_0x00ff0000;
+    __m256i mask_0x00ffffff;
+    __m256i mask_0x00ff00ff;
+    __m256i mask_0xff00ff00;
+};
+
+ARIBCC_AVX2_INLINE ConstantsAVX2 MakeConstants() {
+    //            RGBA_0xAABBGGRR
+    const __m256i mask_0xffffffff = _mm256_cmpeq_epi8(_mm256_setzero_si256(), _mm256_setzero_si256());
+    ConstantsAVX2 c{};
+    c.mask_0xff000000 = _mm256_slli_epi32(mask_0xffffffff, 24);
+    c.mask_0x00ff0000 = _mm256_srli_epi32(c.mask_0xff000000, 8);
+    c.mask_0x00ffffff = _mm256_srli_epi32(mask_0xffffffff, 8);
+    c.mask_0x00ff00ff = _mm256_srli_epi16(mask_0xffffffff, 8);
+    c.mask_0xff00ff00 = _mm256_slli_epi16(mask_0xffffffff, 8);
+    return c;
+}
+
+// Lane mask selecting the first |count| (< 8) pixels, for masked loads / stores of line tails
+ARIBCC_AVX2_INLINE __m256i TailMask(size_t count) {
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(count)),
+                              _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+// Same arithmetic as the SSE2 kernels, so that results are bit-exact between both paths
+ARIBCC_AVX2_INLINE __m256i PremultiplySrc(__m256i src, __m256i& src_ff_minus_alpha, const ConstantsAVX2& c) {
+    __m256i src_a_g = _mm256_srli_epi16(src, 8);                      // 0x00AA00GG
+    __m256i src_b_r = _mm256_and_si256(src, c.mask_0x00ff00ff);       // 0x00BB00RR
+    __m256i src_alpha = _mm256_shufflelo_epi16(src_a_g, 0b11110101);  // (lo)0x00AA00AA
+    src_alpha = _mm256_shufflehi_epi16(src_alpha, 0b11110101);        // (hi)0x00AA00AA
+
+    src_a_g = _mm256_or_si256(src_a_g, c.mask_0x00ff0000);            // 0x00FF00GG
+
+    src_b_r = _mm256_mullo_epi16(src_b_r, src_alpha);
+    src_a_g = _mm256_mullo_epi16(src_a_g, src_alpha);
+
+    src_b_r = _mm256_srli_epi16(src_b_r, 8);                          // 0x00BB00RR
+    src_a_g = _mm256_and_si256(src_a_g, c.mask_0xff00ff00);           // 0xAA00GG00
+
+    src_ff_minus_alpha = _mm256_xor_si256(src_alpha, c.mask_0x00ff00ff);
+    return _mm256_or_si256(src_b_r, src_a_g);                         // (src)0xAABBGGRR
+}
+
+ARIBCC_AVX2_INLINE __m256i BlendPremultiplied(__m256i dst, __m256i premultiplied_src,
+                                              __m256i src_ff_minus_alpha, const ConstantsAVX2& c) {
+    __m256i dst_b_r = _mm256_and_si256(dst, c.mask_0x00ff00ff);
+    __m256i dst_a_g = _mm256_srli_epi16(dst, 8);
+
+    dst_b_r = _mm256_mullo_epi16(dst_b_r, src_ff_minus_alpha);
+    dst_a_g = _mm256_mullo_epi16(dst_a_g, src_ff_minus_alpha);
+
+    dst_b_r = _mm256_srli_epi16(dst_b_r, 8);
+    dst_a_g = _mm256_and_si256(dst_a_g, c.mask_0xff00ff00);
+
+    return _mm256_adds_epu8(premultiplied_src, _mm256_or_si256(dst_b_r, dst_a_g));
+}
+
+ARIBCC_AVX2_INLINE __m256i BlendPremultipliedSrc(__m256i dst, __m256i src, const ConstantsAVX2& c) {
+    __m256i src_000000aa = _mm256_srli_epi32(src, 24);
+    __m256i src_00aa0000 = _mm256_slli_epi32(src_000000aa, 16);
+    __m256i src_alpha = _mm256_or_si256(src_000000aa, src_00aa0000);
+    __m256i src_ff_minus_alpha = _mm256_xor_si256(src_alpha, c.mask_0x00ff00ff);
+    return BlendPremultiplied(dst, src, src_ff_minus_alpha, c);
+}
+
+ARIBCC_AVX2_INLINE __m256i FillWithAlphas(__m128i alpha8, __m256i color8_rgb, __m256i color8_alpha,
+                                          const ConstantsAVX2& c) {
+    __m256i alpha = _mm256_slli_epi32(_mm256_cvtepu8_epi32(alpha8), 16);
+    __m256i weighted_alpha = _mm256_and_si256(c.mask_0xff000000, _mm256_mullo_epi16(color8_alpha, alpha));
+    return _mm256_or_si256(color8_rgb, weighted_alpha);
+}
+
+}  // namespace
+
+ARIBCC_TARGET_AVX2
+void FillLine_AVX2(ColorRGBA* __restrict dest, ColorRGBA color, size_t width) {
+    __m256i color8 = _mm256_set1_epi32(static_cast<int>(color.u32));
+
+    size_t i = 0;
+    for (; i + 8 <= width; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), color8);
+    }
+
+    if (size_t remain = width - i) {
+        _mm256_maskstore_epi32(reinterpret_cast<int*>(dest + i), TailMask(remain), color8);
+    }
+}
+
+ARIBCC_TARGET_AVX2
+void FillLineWithAlphas_AVX2(ColorRGBA* __restrict dest,
+                             const uint8_t* __restrict src, ColorRGBA color, size_t width) {
+    const ConstantsAVX2 c = MakeConstants();
+
+    __m256i color8 = _mm256_set1_epi32(static_cast<int>(color.u32));
+    __m256i color8_rgb = _mm256_and_si256(color8, c.mask_0x00ffffff);
+    __m256i color8_alpha = _mm256_srli_epi32(_mm256_and_si256(color8, c.mask_0xff000000), 8);
+
+    size_t i = 0;
+    for (; i + 8 <= width; i += 8) {
+        __m128i alpha8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+        __m256i result = FillWithAlphas(alpha8, color8_rgb, color8_alpha, c);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), result);
+    }
+
+    if (size_t remain = width - i) {
+        uint8_t alphas[8] = {0};
+        memcpy(alphas, src + i, remain);
+        __m128i alpha8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(alphas));
+        __m256i result = FillWithAlphas(alpha8, color8_rgb, color8_alpha, c);
+        _mm256_maskstore_epi32(reinterpret_cast<int*>(dest + i), TailMask(remain), result);
+    }
+}
+
+ARIBCC_TARGET_AVX2
+void BlendColorToLine_AVX2(ColorRGBA* __restrict dest, ColorRGBA color, size_t width) {
+    const ConstantsAVX2 c = MakeConstants();
+
+    __m256i src_ff_minus_alpha;
+    __m256i premultiplied_src = PremultiplySrc(_mm256_set1_epi32(static_cast<int>(color.u32)),
+                                               src_ff_minus_alpha, c);
+
+    size_t i = 0;
+    for (; i + 8 <= width; i += 8) {
+        __m256i dst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest + i));
+        __m256i result = BlendPremultiplied(dst, premultiplied_src, src_ff_minus_alpha, c);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), result);
+    }
+
+    if (size_t remain = width - i) {
+        __m256i mask = TailMask(remain);
+        __m256i dst = _mm256_maskload_epi32(reinterpret_cast<const int*>(dest + i), mask);
+        __m256i result = BlendPremultiplied(dst, premultiplied_src, src_ff_minus_alpha, c);
+        _mm256_maskstore_epi32(reinterpret_cast<int*>(dest + i), mask, result);
+    }
+}
+
+ARIBCC_TARGET_AVX2
+void BlendColorWithAlphasToLine_AVX2(ColorRGBA* __restrict dest, const uint8_t* __restrict src_alphas,
+                                     ColorRGBA color, size_t width) {
+    const ConstantsAVX2 c = MakeConstants();
+
+    __m256i color8 = _mm256_set1_epi32(static_cast<int>(color.u32));
+    __m256i color8_rgb = _mm256_and_si256(color8, c.mask_0x00ffffff);
+    __m256i color8_alpha = _mm256_srli_epi32(_mm256_and_si256(color8, c.mask_0xff000000), 8);
+
+    size_t i = 0;
+    for (; i + 8 <= width; i += 8) {
+        __m128i alpha8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src_alphas + i));
+        __m256i src = FillWithAlphas(alpha8, color8_rgb, color8_alpha, c);
+        __m256i dst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest + i));
+
+        __m256i src_ff_minus_alpha;
+        __m256i premultiplied_src = PremultiplySrc(src, src_ff_minus_alpha, c);
+        __m256i result = BlendPremultiplied(dst, premultiplied_src, src_ff_minus_alpha, c);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), result);
+    }
+
+    if (size_t remain = width - i) {
+        uint8_t alphas[8] = {0};
+        memcpy(alphas, src_alphas + i, remain);
+        __m128i alpha8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(alphas));
+        __m256i src = FillWithAlphas(alpha8, color8_rgb, color8_alpha, c);
+
+        __m256i mask = TailMask(remain);
+        __m256i dst = _mm256_maskload_epi32(reinterpret_cast<const int*>(dest + i), mask);
+
+        __m256i src_ff_minus_alpha;
+        __m256i premultiplied_src = PremultiplySrc(src, src_ff_minus_alpha, c);
+        __m256i result = BlendPremultiplied(dst, premultiplied_src, src_ff_minus_alpha, c);
+        _mm256_maskstore_epi32(reinterpret_cast<int*>(dest + i), mask, result);
+    }
+}
+
+ARIBCC_TARGET_AVX2
+void BlendLine_AVX2(ColorRGBA* __restrict dest, const ColorRGBA* __restrict source, size_t width) {
+    const ConstantsAVX2 c = MakeConstants();
+
+    size_t i = 0;
+    for (; i + 8 <= width; i += 8) {
+        __m256i src = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        __m256i dst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest + i));
+
+        __m256i src_ff_minus_alpha;
+        __m256i premultiplied_src = PremultiplySrc(src, src_ff_minus_alpha, c);
+        __m256i result = BlendPremultiplied(dst, premultiplied_src, src_ff_minus_alpha, c);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), result);
+    }
+
+    if (size_t remain = width - i) {
+        __m256i mask = TailMask(remain);
+        __m256i src = _mm256_maskload_epi32(reinterpret_cast<const int*>(source + i), mask);
+        __m256i dst = _mm256_maskload_epi32(reinterpret_cast<const int*>(dest + i), mask);
+
+        __m256i src_ff_minus_alpha;
+        __m256i premultiplied_src = PremultiplySrc(src, src_ff_minus_alpha, c);
+        __m256i result = BlendPremultiplied(dst, premultiplied_src, src_ff_minus_alpha, c);
+        _mm256_maskstore_epi32(reinterpret_cast<int*>(dest + i), mask, result);
+    }
+}
+
+ARIBCC_TARGET_AVX2
+void BlendLine_PremultipliedSrc_AVX2(ColorRGBA* __restrict dest,
+                                     const ColorRGBA* __restrict source, size_t width) {
+    const ConstantsAVX2 c = MakeConstants();
+
+    size_t i = 0;
+    for (; i + 8 <= width; i += 8) {
+        __m256i src = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        __m256i dst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), BlendPremultipliedSrc(dst, src, c));
+    }
+
+    if (size_t remain = width - i) {
+        __m256i mask = TailMask(remain);
+        __m256i src = _mm256_maskload_epi32(reinterpret_cast<const int*>(source + i), mask);
+        __m256i dst = _mm256_maskload_epi32(reinterpret_cast<const int*>(dest + i), mask);
+        _mm256_maskstore_epi32(reinterpret_cast<int*>(dest + i), mask, BlendPremultipliedSrc(dst, src, c));
+    }
+}
+
+}  // namespace aribcaption::alphablend::internal::x86
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_ALPHABLEND_X86_AVX2_HPP
+#define ARIBCAPTION_ALPHABLEND_X86_AVX2_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "aribcaption/color.hpp"
+
+// AVX2 kernels live in their own translation unit and are compiled with per-function target attributes,
+// so that the rest of the library keeps the baseline ISA and they are only entered after a runtime CPU check.
+#if defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+    #define ARIBCC_HAS_AVX2_KERNELS 1
+#endif
+
+namespace aribcaption::alphablend::internal::x86 {
+
+#if defined(ARIBCC_HAS_AVX2_KERNELS)
+
+// Lines narrower than this are not worth the out-of-line call, SSE2 handles them
+constexpr size_t kAVX2MinWidth = 16;
+
+void FillLine_AVX2(ColorRGBA* __restrict dest, ColorRGBA color, size_t width);
+
+void FillLineWithAlphas_AVX2(ColorRGBA* __restrict dest,
+                             const uint8_t* __restrict src, ColorRGBA color, size_t width);
+
+void BlendColorToLine_AVX2(ColorRGBA* __restrict dest, ColorRGBA color, size_t width);
+
+void BlendColorWithAlphasToLine_AVX2(ColorRGBA* __restrict dest, const uint8_t* __restrict src_alphas,
+                                     ColorRGBA color, size_t width);
+
+void BlendLine_AVX2(ColorRGBA* __restrict dest, const ColorRGBA* __restrict source, size_t width);
+
+void BlendLine_PremultipliedSrc_AVX2(ColorRGBA* __restrict dest,
+                                     const ColorRGBA* __restrict source, size_t width);
+
+#endif  // defined(ARIBCC_HAS_AVX2_KERNELS)
+
+}  // namespace aribcaption::alphablend::internal::x86
+
+#endif  // ARIBCAPTION_ALPHABLEND_X86_AVX2_HPP
@@ -17,7 +17,9 @@
  */
 
 #include <cassert>
+#include <cstring>
 #include "renderer/bitmap.hpp"
+#include "renderer/bitmap_pool.hpp"
 
 namespace aribcaption {
 
@@ -37,7 +39,20 @@ Image Bitmap::ToImage(Bitmap&& bmp) {
     return image;
 }
 
-Bitmap Bitmap::FromImage(Image&& image) {
+namespace {
+
+Image::Buffer CopyBuffer(const Image::Buffer& source, BitmapPool* pool) {
+    if (!pool) {
+        return source;
+    }
+    Image::Buffer buffer = pool->AcquireBuffer(source.size());
+    buffer.assign(source.begin(), source.end());
+    return buffer;
+}
+
+}  // namespace
+
+Bitmap Bitmap::FromImage(Image&& image, BitmapPool* pool) {
     Bitmap bitmap;
 
     bitmap.width_ = image.width;
@@ -45,25 +60,73 @@ Bitmap Bitmap::FromImage(Image&& image) {
     bitmap.stride_ = image.stride;
     bitmap.pixel_format_ = image.pixel_format;
 
-    bitmap.pixels = std::move(image.bitmap);
+    if (image.shared_bitmap) {
+        // Shared buffer is immutable, make a copy
+        bitmap.pixels = CopyBuffer(*image.shared_bitmap, pool);
+        image.shared_bitmap.reset();
+    } else {
+        bitmap.pixels = std::move(image.bitmap);
+    }
 
     return bitmap;
 }
 
-Bitmap::Bitmap(int width, int height, PixelFormat pixel_format) :
+void Bitmap::ShareImageBuffer(Image& image, BitmapPool* pool) {
+    if (image.shared_bitmap || image.bitmap.empty()) {
+        return;
+    }
+    if (pool) {
+        image.shared_bitmap = pool->ShareBuffer(std::move(image.bitmap));
+    } else {
+        image.shared_bitmap = std::make_shared<const Image::Buffer>(std::move(image.bitmap));
+    }
+    image.bitmap = Image::Buffer();
+}
+
+Image Bitmap::UnshareImageBuffer(const Image& image, BitmapPool* pool) {
+    if (!image.shared_bitmap && !pool) {
+        return image;
+    }
+
+    // Pixels are copied into a pooled buffer, which also keeps the pool's alignment
+    Image copy;
+    copy.width = image.width;
+    copy.height = image.height;
+    copy.stride = image.stride;
+    copy.dst_x = image.dst_x;
+    copy.dst_y = image.dst_y;
+    copy.display_width = image.display_width;
+    copy.display_height = image.display_height;
+    copy.pixel_format = image.pixel_format;
+    copy.palette = image.palette;
+    copy.spans = image.spans;
+    copy.bitmap = CopyBuffer(image.shared_bitmap ? *image.shared_bitmap : image.bitmap, pool);
+    return copy;
+}
+
+Bitmap::Bitmap(int width, int height, PixelFormat pixel_format, BitmapPool* pool, BitmapInit init) :
       width_(width), height_(height), pixel_format_(pixel_format) {
     assert(width > 0 && height > 0);
     assert(pixel_format == PixelFormat::kRGBA8888);
 
     stride_ = width * 4;
 
-    uint32_t remainder = stride_ % kAlignedTo;
+    // Bitmaps taken from the pool are handed out as images, whose row alignment may be raised
+    size_t row_alignment = pool ? pool->row_alignment() : kAlignedTo;
+    size_t remainder = static_cast<size_t>(stride_) % row_alignment;
     if (remainder) {
-        uint32_t padding = kAlignedTo - remainder;
+        size_t padding = row_alignment - remainder;
         stride_ += static_cast<int>(padding);
     }
 
-    pixels.resize(stride_ * height);
+    size_t size = static_cast<size_t>(stride_) * height;
+    if (pool) {
+        pixels = pool->AcquireBuffer(size);
+    }
+    pixels.resize(size);  // Default-initialized by AlignedAllocator, i.e. not cleared
+    if (init == BitmapInit::kClear) {
+        memset(pixels.data(), 0, size);
+    }
 }
 
 }  // namespace aribcaption
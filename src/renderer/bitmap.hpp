@@ -30,16 +30,30 @@
 
 namespace aribcaption {
 
+class BitmapPool;
+
+// Initial content of pixels of a newly constructed Bitmap
+enum class BitmapInit {
+    kClear,          // Fully transparent
+    kUninitialized,  // Left as is, for callers which overwrite every pixel (and the stride padding) anyway
+};
+
 class Bitmap {
 public:
     static constexpr size_t kAlignedTo = 32;
 public:
     static Image ToImage(Bitmap&& bitmap);
-    static Bitmap FromImage(Image&& image);
+    static Bitmap FromImage(Image&& image, BitmapPool* pool = nullptr);
+
+    // Move image's pixels into a shared immutable buffer, or make a copy back into Image::bitmap
+    // If pool presents, buffers are taken from and returned to the pool
+    static void ShareImageBuffer(Image& image, BitmapPool* pool = nullptr);
+    static Image UnshareImageBuffer(const Image& image, BitmapPool* pool = nullptr);
 private:
     Bitmap() = default;
 public:
-    Bitmap(int width, int height, PixelFormat pixel_format);
+    Bitmap(int width, int height, PixelFormat pixel_format, BitmapPool* pool = nullptr,
+           BitmapInit init = BitmapInit::kClear);
     ~Bitmap() = default;
     Bitmap(const Bitmap& bmp) = default;
     Bitmap(Bitmap&& bmp) noexcept = default;
@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+#include "renderer/bitmap_pool.hpp"
+
+namespace aribcaption {
+
+namespace {
+
+// Placed right in front of buffers handed out through the C API, so that they can find their way back to the pool.
+// Alive until the block is freed, pooled buffers included.
+struct CAPIBlockHeader {
+    std::weak_ptr<BitmapPool> pool;
+    size_t capacity = 0;
+    uint8_t* block = nullptr;  // start of the allocation, followed by padding of at least kCAPIBlockHeaderSize
+};
+
+constexpr size_t kCAPIBlockHeaderSize = Image::kAlignedTo;
+static_assert(sizeof(CAPIBlockHeader) <= kCAPIBlockHeaderSize, "CAPIBlockHeader must fit into the alignment padding");
+
+CAPIBlockHeader* GetCAPIBlockHeader(uint8_t* buffer) {
+    return reinterpret_cast<CAPIBlockHeader*>(buffer - kCAPIBlockHeaderSize);
+}
+
+size_t HighestPowerOfTwo(size_t x) {
+    size_t p = 1;
+    while (x >>= 1) {
+        p <<= 1;
+    }
+    return p;
+}
+
+}  // namespace
+
+BitmapPool::~BitmapPool() {
+    for (auto& [bucket, buffers] : capi_buffers_) {
+        for (uint8_t* buffer : buffers) {
+            FreeCAPIBuffer(buffer);
+        }
+    }
+}
+
+void BitmapPool::SetLimit(size_t limit_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    limit_bytes_ = limit_bytes;
+    TrimToLimit();
+}
+
+void BitmapPool::ReleaseFreeBuffers() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t limit_bytes = limit_bytes_;
+    limit_bytes_ = 0;
+    TrimToLimit();
+    limit_bytes_ = limit_bytes;
+}
+
+void BitmapPool::SetAlignment(size_t row_alignment, size_t base_alignment) {
+    assert((row_alignment & (row_alignment - 1)) == 0 && (base_alignment & (base_alignment - 1)) == 0);
+    row_alignment = std::max(row_alignment, Image::kAlignedTo);
+    base_alignment = std::max(base_alignment, Image::kAlignedTo);
+    row_alignment_.store(row_alignment, std::memory_order_relaxed);
+
+    // Pooled buffers may not satisfy the new alignment, buffers still in use are checked once recycled
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (base_alignment_.exchange(base_alignment, std::memory_order_relaxed) == base_alignment) {
+        return;
+    }
+    size_t limit_bytes = limit_bytes_;
+    limit_bytes_ = 0;
+    TrimToLimit();
+    limit_bytes_ = limit_bytes;
+}
+
+bool BitmapPool::IsAligned(const void* ptr) const {
+    return (reinterpret_cast<uintptr_t>(ptr) & (base_alignment() - 1)) == 0;
+}
+
+// Size classes are 4 steps per power of two: 1x, 1.25x, 1.5x, 1.75x
+size_t BitmapPool::BucketCeil(size_t size) {
+    if (size <= kMinBucketSize) {
+        return kMinBucketSize;
+    }
+    size_t step = HighestPowerOfTwo(size) / 4;
+    return (size + step - 1) / step * step;
+}
+
+size_t BitmapPool::BucketFloor(size_t capacity) {
+    if (capacity < kMinBucketSize) {
+        return 0;
+    }
+    size_t step = HighestPowerOfTwo(capacity) / 4;
+    return capacity / step * step;
+}
+
+Image::Buffer BitmapPool::AcquireBuffer(size_t size) {
+    size_t bucket = BucketCeil(size);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = buffers_.find(bucket);
+        if (iter != buffers_.end() && !iter->second.empty()) {
+            Image::Buffer buffer = std::move(iter->second.back());
+            iter->second.pop_back();
+            pooled_bytes_ -= buffer.capacity();
+            pooled_count_--;
+            hits_++;
+            return buffer;
+        }
+        misses_++;
+    }
+
+    if (metrics_) {
+        metrics_->Add(MetricCounter::kBitmapBytesAllocated, bucket);
+    }
+    ScopedMemoryAllocator scoped_allocator(allocator_.get(), base_alignment());
+    Image::Buffer buffer;
+    buffer.reserve(bucket);
+    return buffer;
+}
+
+void BitmapPool::Recycle(Image::Buffer&& buffer) {
+    size_t capacity = buffer.capacity();
+    size_t bucket = BucketFloor(capacity);
+    if (bucket == 0) {
+        return;
+    }
+
+    Image::Buffer released = std::move(buffer);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pooled_bytes_ + capacity > limit_bytes_ || !IsAligned(released.data())) {
+        return;  // Over high-water mark or misaligned, freed on return
+    }
+    released.clear();
+    buffers_[bucket].push_back(std::move(released));
+    pooled_bytes_ += capacity;
+    pooled_count_++;
+}
+
+void BitmapPool::Recycle(Image&& image) {
+    Recycle(std::move(image.bitmap));
+    image.shared_bitmap.reset();
+}
+
+std::shared_ptr<const Image::Buffer> BitmapPool::ShareBuffer(Image::Buffer&& buffer) {
+    std::weak_ptr<BitmapPool> weak_pool = weak_from_this();
+    auto deleter = [weak_pool](const Image::Buffer* shared) {
+        auto owned = const_cast<Image::Buffer*>(shared);
+        if (std::shared_ptr<BitmapPool> pool = weak_pool.lock()) {
+            pool->Recycle(std::move(*owned));
+        }
+        delete owned;
+    };
+    return std::shared_ptr<const Image::Buffer>(new Image::Buffer(std::move(buffer)), deleter);
+}
+
+uint8_t* BitmapPool::AcquireCAPIBuffer(size_t size) {
+    size_t bucket = BucketCeil(size);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = capi_buffers_.find(bucket);
+        if (iter != capi_buffers_.end() && !iter->second.empty()) {
+            uint8_t* buffer = iter->second.back();
+            iter->second.pop_back();
+            pooled_bytes_ -= bucket;
+            pooled_count_--;
+            hits_++;
+            return buffer;  // Header is kept while pooled
+        }
+        misses_++;
+    }
+
+    if (metrics_) {
+        metrics_->Add(MetricCounter::kBitmapBytesAllocated, bucket);
+    }
+    size_t alignment = base_alignment();
+    size_t padding = std::max(kCAPIBlockHeaderSize, alignment);
+    auto block = static_cast<uint8_t*>(allocator_->Allocate(padding + bucket, alignment));
+    if (!block) {
+        return nullptr;
+    }
+
+    uint8_t* buffer = block + padding;
+    auto header = new(GetCAPIBlockHeader(buffer)) CAPIBlockHeader;
+    header->pool = weak_from_this();
+    header->capacity = bucket;
+    header->block = block;
+
+    return buffer;
+}
+
+void BitmapPool::ReleaseCAPIBuffer(uint8_t* buffer) {
+    if (!buffer) {
+        return;
+    }
+
+    CAPIBlockHeader* header = GetCAPIBlockHeader(buffer);
+    if (std::shared_ptr<BitmapPool> pool = header->pool.lock()) {
+        pool->RecycleCAPIBuffer(buffer, header->capacity);
+    } else {
+        FreeCAPIBuffer(buffer);
+    }
+}
+
+void BitmapPool::FreeCAPIBuffer(uint8_t* buffer) {
+    CAPIBlockHeader* header = GetCAPIBlockHeader(buffer);
+    uint8_t* block = header->block;
+    header->~CAPIBlockHeader();
+    AlignedFree(block);
+}
+
+void BitmapPool::RecycleCAPIBuffer(uint8_t* buffer, size_t capacity) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pooled_bytes_ + capacity <= limit_bytes_ && IsAligned(buffer)) {
+            capi_buffers_[capacity].push_back(buffer);
+            pooled_bytes_ += capacity;
+            pooled_count_++;
+            return;
+        }
+    }
+    FreeCAPIBuffer(buffer);
+}
+
+BitmapPoolStats BitmapPool::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    BitmapPoolStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.pooled_count = pooled_count_;
+    stats.pooled_bytes = pooled_bytes_;
+    stats.limit_bytes = limit_bytes_;
+    return stats;
+}
+
+void BitmapPool::TrimToLimit() {
+    // Drop the largest buffers first
+    while (pooled_bytes_ > limit_bytes_ && !buffers_.empty()) {
+        auto iter = std::prev(buffers_.end());
+        while (!iter->second.empty() && pooled_bytes_ > limit_bytes_) {
+            pooled_bytes_ -= iter->second.back().capacity();
+            pooled_count_--;
+            iter->second.pop_back();
+        }
+        if (iter->second.empty()) {
+            buffers_.erase(iter);
+        }
+    }
+
+    while (pooled_bytes_ > limit_bytes_ && !capi_buffers_.empty()) {
+        auto iter = std::prev(capi_buffers_.end());
+        while (!iter->second.empty() && pooled_bytes_ > limit_bytes_) {
+            FreeCAPIBuffer(iter->second.back());
+            pooled_bytes_ -= iter->first;
+            pooled_count_--;
+            iter->second.pop_back();
+        }
+        if (iter->second.empty()) {
+            capi_buffers_.erase(iter);
+        }
+    }
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_BITMAP_POOL_HPP
+#define ARIBCAPTION_BITMAP_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "aribcaption/image.hpp"
+#include "aribcaption/renderer.hpp"
+#include "base/memory_allocator.hpp"
+#include "base/metrics.hpp"
+
+namespace aribcaption {
+
+/**
+ * Size-bucketed pool of aligned pixel buffers, recycling bitmaps of released Images.
+ *
+ * Buffers are grouped into size classes of 4 steps per power of two, so a recycled buffer
+ * serves any later request within its class. Retained free buffers never exceed the limit (high-water mark).
+ *
+ * Thread-safe: buffers may come back from other threads, e.g. through aribcc_image_cleanup().
+ * Must be owned by std::shared_ptr, outstanding buffers only hold weak references to the pool.
+ */
+class BitmapPool : public std::enable_shared_from_this<BitmapPool> {
+public:
+    static constexpr size_t kDefaultLimitBytes = 32 * 1024 * 1024;
+    static constexpr size_t kMinBucketSize = 4096;
+public:
+    // Allocations are counted into metrics, if not null. Buffers come from allocator, or the system heap if null
+    explicit BitmapPool(std::shared_ptr<Metrics> metrics = nullptr, std::shared_ptr<MemoryAllocator> allocator = nullptr)
+        : metrics_(std::move(metrics)),
+          allocator_(allocator ? std::move(allocator) : std::make_shared<MemoryAllocator>()) {}
+    ~BitmapPool();
+public:
+    void SetLimit(size_t limit_bytes);
+
+    // Free all of the pooled buffers now, the limit is kept
+    void ReleaseFreeBuffers();
+
+    // Alignment of rows and of the first pixel of bitmaps taken from the pool, see Renderer::SetImageAlignment()
+    // Both must be powers of two, and are raised to Image::kAlignedTo at least. Pooled buffers are dropped.
+    void SetAlignment(size_t row_alignment, size_t base_alignment);
+
+    [[nodiscard]]
+    size_t row_alignment() const {
+        return row_alignment_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    size_t base_alignment() const {
+        return base_alignment_.load(std::memory_order_relaxed);
+    }
+
+    // Returns an empty buffer whose capacity is at least size, aligned to base_alignment(),
+    // resize() or assign() it before use
+    Image::Buffer AcquireBuffer(size_t size);
+    void Recycle(Image::Buffer&& buffer);
+
+    // Recycle the owned bitmap of the image, shared bitmaps return by themselves once unreferenced
+    void Recycle(Image&& image);
+
+    // Wrap buffer into a shared immutable buffer, which goes back to the pool after the last reference dropped
+    std::shared_ptr<const Image::Buffer> ShareBuffer(Image::Buffer&& buffer);
+
+    // Aligned buffers handed out through the C API, release with ReleaseCAPIBuffer()
+    uint8_t* AcquireCAPIBuffer(size_t size);
+    static void ReleaseCAPIBuffer(uint8_t* buffer);
+
+    [[nodiscard]]
+    BitmapPoolStats GetStats() const;
+
+    // Also used for other C API render result storage, release with MemoryAllocator::Free()
+    [[nodiscard]]
+    const MemoryAllocator& allocator() const {
+        return *allocator_;
+    }
+private:
+    static size_t BucketCeil(size_t size);
+    static size_t BucketFloor(size_t capacity);
+    void RecycleCAPIBuffer(uint8_t* buffer, size_t capacity);
+    static void FreeCAPIBuffer(uint8_t* buffer);
+    bool IsAligned(const void* ptr) const;
+    void TrimToLimit();  // requires mutex_ held
+public:
+    BitmapPool(const BitmapPool&) = delete;
+    BitmapPool& operator=(const BitmapPool&) = delete;
+private:
+    std::shared_ptr<Metrics> metrics_;
+    std::shared_ptr<MemoryAllocator> allocator_;
+
+    std::atomic<size_t> row_alignment_{Image::kAlignedTo};
+    std::atomic<size_t> base_alignment_{Image::kAlignedTo};
+
+    mutable std::mutex mutex_;
+
+    size_t limit_bytes_ = kDefaultLimitBytes;
+    size_t pooled_bytes_ = 0;
+    size_t pooled_count_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+
+    // bucket size => free buffers
+    std::map<size_t, std::vector<Image::Buffer>> buffers_;
+    std::map<size_t, std::vector<uint8_t*>> capi_buffers_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_BITMAP_POOL_HPP
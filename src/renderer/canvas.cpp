@@ -90,4 +90,24 @@ void Canvas::DrawBitmap(const Bitmap& bmp, int target_x, int target_y) {
     DrawBitmap(bmp, rect);
 }
 
+void Canvas::DrawMask(ColorRGBA color, const uint8_t* mask, int width, int height, int stride,
+                      int target_x, int target_y) {
+    Rect rect{target_x, target_y, target_x + width, target_y + height};
+    Rect clipped = Rect::ClipRect(bitmap_.GetRect(), rect);
+
+    if (clipped.width() <= 0 || clipped.height() <= 0) {
+        return;
+    }
+
+    int clip_x_offset = clipped.left - rect.left;
+    int clip_y_offset = clipped.top - rect.top;
+    auto line_width = static_cast<size_t>(clipped.width());
+
+    for (int y = clipped.top; y < clipped.bottom; y++) {
+        ColorRGBA* dest_begin = bitmap_.GetPixelAt(clipped.left, y);
+        const uint8_t* src_begin = mask + static_cast<size_t>(clip_y_offset + y - clipped.top) * stride + clip_x_offset;
+        alphablend::BlendColorWithAlphasToLine(dest_begin, src_begin, color, line_width);
+    }
+}
+
 }  // namespace aribcaption
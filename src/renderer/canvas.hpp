@@ -19,6 +19,7 @@
 #ifndef ARIBCAPTION_CANVAS_HPP
 #define ARIBCAPTION_CANVAS_HPP
 
+#include <cstdint>
 #include <optional>
 #include "aribcaption/caption.hpp"
 #include "aribcaption/color.hpp"
@@ -38,6 +39,10 @@ public:
     void DrawRect(ColorRGBA color, const Rect& rect);
     void DrawBitmap(const Bitmap& bmp, const Rect& rect);
     void DrawBitmap(const Bitmap& bmp, int target_x, int target_y);
+
+    // Blend solid color weighted by an 8-bit coverage mask (width * height, stride in bytes) at (target_x, target_y)
+    void DrawMask(ColorRGBA color, const uint8_t* mask, int width, int height, int stride,
+                  int target_x, int target_y);
 public:
     // Disallow copy and assign
     Canvas(const Canvas&) = delete;
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "aribcaption/caption_pipeline.hpp"
+#include "renderer/caption_pipeline_impl.hpp"
+
+namespace aribcaption {
+
+CaptionPipeline::CaptionPipeline(Context& context, size_t queue_capacity)
+    : pimpl_(std::make_unique<internal::CaptionPipelineImpl>(context, queue_capacity)) {}
+
+CaptionPipeline::~CaptionPipeline() = default;
+
+CaptionPipeline::CaptionPipeline(CaptionPipeline&&) noexcept = default;
+
+CaptionPipeline& CaptionPipeline::operator=(CaptionPipeline&&) noexcept = default;
+
+Decoder& CaptionPipeline::decoder() {
+    return pimpl_->decoder();
+}
+
+Renderer& CaptionPipeline::renderer() {
+    return pimpl_->renderer();
+}
+
+DecodeStatus CaptionPipeline::Decode(const uint8_t* pes_data, size_t length, int64_t pts) {
+    return pimpl_->Decode(pes_data, length, pts);
+}
+
+DecodeStatus CaptionPipeline::Feed(const uint8_t* data, size_t length, int64_t pts, bool packet_start) {
+    return pimpl_->Feed(data, length, pts, packet_start);
+}
+
+void CaptionPipeline::Flush() {
+    pimpl_->Flush();
+}
+
+RenderStatus CaptionPipeline::TryRender(int64_t pts) {
+    return pimpl_->TryRender(pts);
+}
+
+RenderStatus CaptionPipeline::Render(int64_t pts, RenderResult& out_result) {
+    return pimpl_->Render(pts, out_result);
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <utility>
+#include "renderer/caption_pipeline_impl.hpp"
+
+namespace aribcaption::internal {
+
+CaptionPipelineImpl::CaptionPipelineImpl(Context& context, size_t queue_capacity)
+    : log_(GetContextLogger(context)), decoder_(context), renderer_(context), queue_(queue_capacity) {}
+
+DecodeStatus CaptionPipelineImpl::Decode(const uint8_t* pes_data, size_t length, int64_t pts) {
+    SubmitPending();
+
+    DecodeStatus status = decoder_.Decode(pes_data, length, pts, decode_result_);
+    EnqueueDecodeResult(status);
+    return status;
+}
+
+DecodeStatus CaptionPipelineImpl::Feed(const uint8_t* data, size_t length, int64_t pts, bool packet_start) {
+    SubmitPending();
+
+    DecodeStatus status = decoder_.Feed(data, length, pts, packet_start, decode_result_);
+    EnqueueDecodeResult(status);
+    return status;
+}
+
+void CaptionPipelineImpl::EnqueueDecodeResult(DecodeStatus status) {
+    if (status == DecodeStatus::kGotCaption) {
+        Enqueue(Item{std::move(*decode_result_.caption)});
+    } else if (status == DecodeStatus::kGotDuplicateCaption) {
+        Item item;
+        item.caption.pts = decode_result_.duplicate_pts;
+        item.caption.wait_duration = decode_result_.duplicate_duration;
+        item.extend = true;
+        Enqueue(std::move(item));
+    }
+}
+
+void CaptionPipelineImpl::Flush() {
+    decoder_.Flush();
+
+    // Captions queued before are flushed out of the renderer on the rendering thread
+    pending_.clear();
+    Item item;
+    item.flush = true;
+    Enqueue(std::move(item));
+}
+
+void CaptionPipelineImpl::Enqueue(Item&& item) {
+    if (pending_.empty() && queue_.TryPush(std::move(item))) {
+        return;
+    }
+    if (pending_.empty()) {
+        log_->w("CaptionPipeline: Queue is full, captions are held back until next decoding");
+    }
+    pending_.push_back(std::move(item));
+}
+
+void CaptionPipelineImpl::SubmitPending() {
+    while (!pending_.empty() && queue_.TryPush(std::move(pending_.front()))) {
+        pending_.pop_front();
+    }
+}
+
+void CaptionPipelineImpl::Dequeue() {
+    while (queue_.TryPop(dequeued_)) {
+        if (dequeued_.flush) {
+            renderer_.Flush();
+        } else if (dequeued_.extend) {
+            renderer_.ExtendCaption(dequeued_.caption.pts, dequeued_.caption.wait_duration);
+        } else {
+            renderer_.AppendCaption(std::move(dequeued_.caption));
+        }
+    }
+}
+
+RenderStatus CaptionPipelineImpl::TryRender(int64_t pts) {
+    Dequeue();
+    return renderer_.TryRender(pts);
+}
+
+RenderStatus CaptionPipelineImpl::Render(int64_t pts, RenderResult& out_result) {
+    Dequeue();
+    return renderer_.Render(pts, out_result);
+}
+
+}  // namespace aribcaption::internal
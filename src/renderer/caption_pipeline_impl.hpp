@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_CAPTION_PIPELINE_IMPL_HPP
+#define ARIBCAPTION_CAPTION_PIPELINE_IMPL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include "aribcaption/caption.hpp"
+#include "aribcaption/caption_pipeline.hpp"
+#include "aribcaption/context.hpp"
+#include "aribcaption/decoder.hpp"
+#include "aribcaption/renderer.hpp"
+#include "base/logger.hpp"
+#include "base/spsc_queue.hpp"
+
+namespace aribcaption::internal {
+
+class CaptionPipelineImpl {
+public:
+    CaptionPipelineImpl(Context& context, size_t queue_capacity);
+    ~CaptionPipelineImpl() = default;
+public:
+    Decoder& decoder() { return decoder_; }
+    Renderer& renderer() { return renderer_; }
+
+    DecodeStatus Decode(const uint8_t* pes_data, size_t length, int64_t pts);
+    DecodeStatus Feed(const uint8_t* data, size_t length, int64_t pts, bool packet_start);
+    void Flush();
+
+    RenderStatus TryRender(int64_t pts);
+    RenderStatus Render(int64_t pts, RenderResult& out_result);
+public:
+    CaptionPipelineImpl(const CaptionPipelineImpl&) = delete;
+    CaptionPipelineImpl& operator=(const CaptionPipelineImpl&) = delete;
+private:
+    struct Item {
+        Caption caption;
+        bool flush = false;
+        bool extend = false;  // Only pts and wait_duration of caption are set, see Renderer::ExtendCaption()
+    };
+
+    // Demuxing side
+    void Enqueue(Item&& item);
+    void EnqueueDecodeResult(DecodeStatus status);
+    void SubmitPending();
+
+    // Rendering side
+    void Dequeue();
+private:
+    std::shared_ptr<Logger> log_;
+
+    Decoder decoder_;
+    Renderer renderer_;
+
+    DecodeResult decode_result_;
+    std::deque<Item> pending_;  // items which haven't fit into the queue, in order
+
+    Item dequeued_;
+    SPSCQueue<Item> queue_;
+};
+
+}  // namespace aribcaption::internal
+
+#endif  // ARIBCAPTION_CAPTION_PIPELINE_IMPL_HPP
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "renderer/distance_field.hpp"
+
+namespace aribcaption {
+
+namespace {
+
+constexpr float kInfinity = 1e20f;
+
+// 1D squared euclidean distance transform of length samples starting at grid[0], spaced by stride
+// Felzenszwalb & Huttenlocher, "Distance Transforms of Sampled Functions"
+void DistanceTransform1D(float* grid, int stride, int length,
+                         std::vector<float>& f, std::vector<int>& v, std::vector<float>& z) {
+    for (int q = 0; q < length; q++) {
+        f[q] = grid[q * stride];
+    }
+
+    v[0] = 0;
+    z[0] = -kInfinity;
+    z[1] = kInfinity;
+    for (int q = 1, k = 0; q < length; q++) {
+        float s;
+        do {
+            int r = v[k];
+            s = (f[q] - f[r] + static_cast<float>(q * q - r * r)) / static_cast<float>(q - r) / 2.0f;
+        } while (s <= z[k] && --k > -1);
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = kInfinity;
+    }
+
+    for (int q = 0, k = 0; q < length; q++) {
+        while (z[k + 1] < static_cast<float>(q)) {
+            k++;
+        }
+        int r = v[k];
+        grid[q * stride] = f[r] + static_cast<float>((q - r) * (q - r));
+    }
+}
+
+void DistanceTransform2D(std::vector<float>& grid, int width, int height) {
+    int length = std::max(width, height);
+    std::vector<float> f(length);
+    std::vector<int> v(length);
+    std::vector<float> z(length + 1);
+
+    for (int x = 0; x < width; x++) {
+        DistanceTransform1D(&grid[x], width, height, f, v, z);
+    }
+    for (int y = 0; y < height; y++) {
+        DistanceTransform1D(&grid[static_cast<size_t>(y) * width], 1, width, f, v, z);
+    }
+}
+
+}  // namespace
+
+GlyphMask ComputeDistanceField(const GlyphMask& mask) {
+    if (mask.width <= 0 || mask.height <= 0) {
+        return GlyphMask{};
+    }
+
+    constexpr int spread = kDistanceFieldSpread;
+
+    GlyphMask field;
+    field.left = mask.left - spread;
+    field.top = mask.top + spread;
+    field.width = mask.width + 2 * spread;
+    field.height = mask.height + 2 * spread;
+
+    // Squared distances to the nearest pixel outside (inner) and inside (outer) the glyph.
+    // Partially covered pixels are seeded by their sub-pixel distance to the 50% contour.
+    size_t size = static_cast<size_t>(field.width) * field.height;
+    std::vector<float> outer(size, kInfinity);
+    std::vector<float> inner(size, 0.0f);
+
+    for (int y = 0; y < mask.height; y++) {
+        const uint8_t* src = &mask.coverage[static_cast<size_t>(y) * mask.width];
+        size_t row = static_cast<size_t>(y + spread) * field.width + spread;
+        for (int x = 0; x < mask.width; x++) {
+            uint8_t coverage = src[x];
+            if (coverage == 255) {
+                outer[row + x] = 0.0f;
+                inner[row + x] = kInfinity;
+            } else if (coverage > 0) {
+                float d = 0.5f - static_cast<float>(coverage) / 255.0f;
+                outer[row + x] = d > 0.0f ? d * d : 0.0f;
+                inner[row + x] = d < 0.0f ? d * d : 0.0f;
+            }
+        }
+    }
+
+    DistanceTransform2D(outer, field.width, field.height);
+    DistanceTransform2D(inner, field.width, field.height);
+
+    constexpr float steps_per_pixel = 127.0f / static_cast<float>(spread);
+    field.coverage.resize(size);
+    for (size_t i = 0; i < size; i++) {
+        float distance = std::sqrt(inner[i]) - std::sqrt(outer[i]);
+        float encoded = std::clamp(128.0f + distance * steps_per_pixel, 0.0f, 255.0f);
+        field.coverage[i] = static_cast<uint8_t>(std::lround(encoded));
+    }
+
+    return field;
+}
+
+GlyphMask ResampleDistanceField(const GlyphMask& field, float scale_x, float scale_y, float dilation) {
+    if (field.width <= 0 || field.height <= 0 || scale_x <= 0.0f || scale_y <= 0.0f) {
+        return GlyphMask{};
+    }
+
+    constexpr int spread = kDistanceFieldSpread;
+    dilation = std::max(dilation, 0.0f);
+    float reach = dilation + 1.0f;
+
+    // Bounds of the ink (the source coverage mask) in target pixels, grown by reach
+    int left = static_cast<int>(std::floor(static_cast<float>(field.left + spread) * scale_x - reach));
+    int right = static_cast<int>(std::ceil(static_cast<float>(field.left + field.width - spread) * scale_x + reach));
+    int top = static_cast<int>(std::ceil(static_cast<float>(field.top - spread) * scale_y + reach));
+    int bottom = static_cast<int>(std::floor(static_cast<float>(field.top - field.height + spread) * scale_y - reach));
+
+    GlyphMask result;
+    result.left = left;
+    result.top = top;
+    result.width = right - left;
+    result.height = top - bottom;
+    result.coverage.resize(static_cast<size_t>(result.width) * result.height);
+
+    // Sample positions of target pixel centers, clamped to the field which is far outside the glyph on its edges
+    auto sample_position = [](float position, int length, int& index, float& weight) {
+        position = std::clamp(position, 0.0f, static_cast<float>(length - 1));
+        index = std::min(static_cast<int>(position), length - 2);
+        weight = position - static_cast<float>(index);
+    };
+
+    std::vector<int> column_index(result.width);
+    std::vector<float> column_weight(result.width);
+    for (int x = 0; x < result.width; x++) {
+        float position = (static_cast<float>(left + x) + 0.5f) / scale_x - static_cast<float>(field.left) - 0.5f;
+        sample_position(position, field.width, column_index[x], column_weight[x]);
+    }
+
+    // Encoded distance to coverage: clamp(distance + dilation + 0.5, 0, 1) * 255, in target pixels
+    float pixels_per_step = static_cast<float>(spread) / 127.0f * (scale_x + scale_y) / 2.0f;
+    float factor = pixels_per_step * 255.0f;
+    float bias = (dilation + 0.5f) * 255.0f - 128.0f * factor;
+
+    std::vector<float> line(field.width);
+    for (int y = 0; y < result.height; y++) {
+        float position = static_cast<float>(field.top) - 0.5f -
+                         (static_cast<float>(top - y) - 0.5f) / scale_y;
+        int row;
+        float row_weight;
+        sample_position(position, field.height, row, row_weight);
+
+        // Vertical interpolation of the whole field line, then horizontal per target pixel
+        const uint8_t* line0 = &field.coverage[static_cast<size_t>(row) * field.width];
+        const uint8_t* line1 = line0 + field.width;
+        for (int x = 0; x < field.width; x++) {
+            auto v0 = static_cast<float>(line0[x]);
+            auto v1 = static_cast<float>(line1[x]);
+            line[x] = (v0 + (v1 - v0) * row_weight) * factor + bias;
+        }
+
+        uint8_t* dest = &result.coverage[static_cast<size_t>(y) * result.width];
+        for (int x = 0; x < result.width; x++) {
+            float v0 = line[column_index[x]];
+            float v1 = line[column_index[x] + 1];
+            float coverage = std::clamp(v0 + (v1 - v0) * column_weight[x], 0.0f, 255.0f);
+            dest[x] = static_cast<uint8_t>(coverage + 0.5f);
+        }
+    }
+
+    return result;
+}
+
+}  // namespace aribcaption
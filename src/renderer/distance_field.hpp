@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_DISTANCE_FIELD_HPP
+#define ARIBCAPTION_DISTANCE_FIELD_HPP
+
+#include "renderer/glyph_cache.hpp"
+
+namespace aribcaption {
+
+/**
+ * Reach of a distance field in pixels of the field, distances beyond are clamped.
+ */
+constexpr int kDistanceFieldSpread = 10;
+
+/**
+ * Compute the signed distance field of a coverage mask, positive inside the glyph.
+ *
+ * The returned mask holds distances encoded into 8 bits (128 on the 50% contour, kDistanceFieldSpread per 127 steps)
+ * instead of coverage. It is kDistanceFieldSpread pixels larger than the source on each side,
+ * its origin is moved accordingly. An empty source results in an empty field.
+ */
+GlyphMask ComputeDistanceField(const GlyphMask& mask);
+
+/**
+ * Produce a coverage mask from a distance field computed by ComputeDistanceField()
+ *
+ * @param field     distance field
+ * @param scale_x   horizontal size ratio of the target to the field
+ * @param scale_y   vertical size ratio of the target to the field
+ * @param dilation  distance in target pixels to grow the outline by, e.g. stroke width for borders, 0 for filling.
+ *                  Should be less than kDistanceFieldSpread * scale - 1 for the result not to be clipped.
+ */
+GlyphMask ResampleDistanceField(const GlyphMask& field, float scale_x, float scale_y, float dilation);
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_DISTANCE_FIELD_HPP
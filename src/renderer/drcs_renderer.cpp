@@ -16,14 +16,22 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
-#include "renderer/alphablend.hpp"
+#include <cstdlib>
+#include <cstring>
 #include "renderer/bitmap.hpp"
 #include "renderer/canvas.hpp"
 #include "renderer/drcs_renderer.hpp"
+#include "renderer/drcs_unpack.hpp"
 
 namespace aribcaption {
 
+DRCSRenderer::DRCSRenderer() {
+    mask_cache_.SetLimit(kDefaultCacheLimitBytes);
+}
+
 bool DRCSRenderer::DrawDRCS(const DRCS& drcs, CharStyle style, ColorRGBA color, ColorRGBA stroke_color,
                             int stroke_width, int target_width, int target_height,
                             Bitmap& target_bmp, int target_x, int target_y) {
@@ -31,54 +39,231 @@ bool DRCSRenderer::DrawDRCS(const DRCS& drcs, CharStyle style, ColorRGBA color,
         return false;
     }
 
+    bool has_stroke = (style & CharStyle::kCharStyleStroke) && stroke_width > 0;
+    std::shared_ptr<const CachedGlyph> scaled = GetScaledMask(drcs, target_width, target_height,
+                                                              has_stroke ? stroke_width : 0);
+
     Canvas canvas(target_bmp);
 
     // Draw stroke (border) if needed
-    if (style & CharStyle::kCharStyleStroke) {
-        Bitmap stroke_bitmap = DRCSToColoredBitmap(drcs, target_width, target_height, stroke_color);
-
-        canvas.DrawBitmap(stroke_bitmap, target_x - stroke_width, target_y);
-        canvas.DrawBitmap(stroke_bitmap, target_x + stroke_width, target_y);
-        canvas.DrawBitmap(stroke_bitmap, target_x, target_y - stroke_width);
-        canvas.DrawBitmap(stroke_bitmap, target_x, target_y + stroke_width);
+    if (has_stroke) {
+        const GlyphMask& border = scaled->border.value();
+        canvas.DrawMask(stroke_color, border.coverage.data(), border.width, border.height, border.width,
+                        target_x + border.left, target_y + border.top);
     }
 
     // Draw DRCS with text color
-    Bitmap text_bitmap = DRCSToColoredBitmap(drcs, target_width, target_height, color);
-    canvas.DrawBitmap(text_bitmap, target_x, target_y);
+    const GlyphMask& fill = scaled->fill;
+    canvas.DrawMask(color, fill.coverage.data(), fill.width, fill.height, fill.width, target_x, target_y);
 
     return true;
 }
 
-Bitmap DRCSRenderer::DRCSToColoredBitmap(const DRCS& drcs, int target_width, int target_height, ColorRGBA color) {
-    Bitmap bitmap(target_width, target_height, PixelFormat::kRGBA8888);
+auto DRCSRenderer::GetScaledMask(const DRCS& drcs, int target_width, int target_height, int stroke_width)
+        -> std::shared_ptr<const CachedGlyph> {
+    uint64_t hash = HashDRCS(drcs);
+
+    GlyphCacheKey key;
+    key.face_id = static_cast<uint32_t>(hash >> 32);
+    key.glyph_index = static_cast<uint32_t>(hash);
+    key.pixel_width = target_width;
+    key.pixel_height = target_height;
+    key.stroke_width = stroke_width;
+
+    if (std::shared_ptr<const CachedGlyph> cached = mask_cache_.Get(key)) {
+        return cached;
+    }
+
+    auto scaled = std::make_shared<CachedGlyph>();
+    GlyphMask& mask = scaled->fill;
+    mask.width = target_width;
+    mask.height = target_height;
+    mask.coverage.resize(static_cast<size_t>(target_width) * target_height);
+    ScaleDRCSToCoverage(drcs, target_width, target_height, scale_filter_, mask.coverage.data());
+
+    if (stroke_width > 0) {
+        scaled->border = DilateMask(mask, stroke_width);
+    }
+
+    mask_cache_.Put(key, scaled);
+    return scaled;
+}
+
+void DRCSRenderer::SetScaleFilter(DRCSScaleFilter filter) {
+    if (scale_filter_ != filter) {
+        scale_filter_ = filter;
+        mask_cache_.Clear();
+    }
+}
+
+void DRCSRenderer::SetCacheLimit(size_t limit_bytes) {
+    mask_cache_.SetLimit(limit_bytes);
+}
+
+void DRCSRenderer::ClearCache() {
+    mask_cache_.Clear();
+}
+
+void DRCSRenderer::CopyCacheFrom(const DRCSRenderer& other) {
+    mask_cache_.CopyFrom(other.mask_cache_);
+}
+
+uint64_t DRCSRenderer::HashDRCS(const DRCS& drcs) {
+    // FNV-1a over the pattern geometry and pixels
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto update = [&hash](uint8_t byte) {
+        hash ^= byte;
+        hash *= 0x100000001b3ULL;
+    };
+
+    for (int value : {drcs.width, drcs.height, drcs.depth, drcs.depth_bits}) {
+        update(static_cast<uint8_t>(value));
+        update(static_cast<uint8_t>(value >> 8));
+    }
+    for (uint8_t byte : drcs.pixels) {
+        update(byte);
+    }
+
+    return hash;
+}
+
+void DRCSRenderer::ScaleDRCSToCoverage(const DRCS& drcs, int target_width, int target_height,
+                                       DRCSScaleFilter filter, uint8_t* coverage) {
+    const size_t src_stride = static_cast<size_t>(drcs.width);
+    const size_t dest_stride = static_cast<size_t>(target_width);
+
+    std::vector<uint8_t> source(src_stride * drcs.height);
+    drcs::UnpackToCoverage(drcs.pixels.data(), drcs.pixels.size(), source.size(),
+                           drcs.depth, drcs.depth_bits, source.data());
+
+    if (target_width == drcs.width && target_height == drcs.height) {
+        memcpy(coverage, source.data(), source.size());
+        return;
+    }
+
+    if (filter == DRCSScaleFilter::kNearest) {
+        std::vector<int> src_x(target_width);
+        for (int x = 0; x < target_width; x++) {
+            src_x[x] = x * drcs.width / target_width;
+        }
+
+        int prev_src_y = -1;
+        for (int y = 0; y < target_height; y++) {
+            uint8_t* dest = coverage + y * dest_stride;
+            int sy = y * drcs.height / target_height;
+            if (sy == prev_src_y) {
+                // Upscaled rows repeat the previous one
+                memcpy(dest, dest - dest_stride, dest_stride);
+                continue;
+            }
+            const uint8_t* src = source.data() + sy * src_stride;
+            for (int x = 0; x < target_width; x++) {
+                dest[x] = src[src_x[x]];
+            }
+            prev_src_y = sy;
+        }
+        return;
+    }
 
-    float x_fraction = static_cast<float>(drcs.width) / static_cast<float>(target_width);
-    float y_fraction = static_cast<float>(drcs.height) / static_cast<float>(target_height);
+    // Bilinear, sampling at pixel centers with 8-bit fixed point weights
+    struct Tap {
+        int index0;
+        int index1;
+        uint32_t weight1;  // 0..256, weight of index1
+    };
+    auto make_taps = [](int src_size, int dest_size) {
+        std::vector<Tap> taps(dest_size);
+        for (int i = 0; i < dest_size; i++) {
+            // ((i + 0.5) * src_size / dest_size - 0.5) in 1/256 units
+            int64_t pos = ((2 * static_cast<int64_t>(i) + 1) * src_size * 256) / (2 * dest_size) - 128;
+            pos = std::clamp<int64_t>(pos, 0, static_cast<int64_t>(src_size - 1) * 256);
+            taps[i].index0 = static_cast<int>(pos >> 8);
+            taps[i].index1 = std::min(taps[i].index0 + 1, src_size - 1);
+            taps[i].weight1 = static_cast<uint32_t>(pos & 0xFF);
+        }
+        return taps;
+    };
+    std::vector<Tap> x_taps = make_taps(drcs.width, target_width);
+    std::vector<Tap> y_taps = make_taps(drcs.height, target_height);
+
+    // Horizontal pass once per source row, the vertical pass then only blends two of them per target row
+    std::vector<uint16_t> horizontal(dest_stride * drcs.height);
+    for (int sy = 0; sy < drcs.height; sy++) {
+        const uint8_t* src = source.data() + sy * src_stride;
+        uint16_t* dest = horizontal.data() + sy * dest_stride;
+        for (int x = 0; x < target_width; x++) {
+            const Tap& tx = x_taps[x];
+            dest[x] = static_cast<uint16_t>(src[tx.index0] * (256 - tx.weight1) + src[tx.index1] * tx.weight1);
+        }
+    }
 
     for (int y = 0; y < target_height; y++) {
-        ColorRGBA* dest = bitmap.GetPixelAt(0, y);
-        int drcs_y = static_cast<int>(y_fraction * static_cast<float>(y));
+        const Tap& ty = y_taps[y];
+        const uint16_t* row0 = horizontal.data() + ty.index0 * dest_stride;
+        const uint16_t* row1 = horizontal.data() + ty.index1 * dest_stride;
+        uint8_t* dest = coverage + y * dest_stride;
         for (int x = 0; x < target_width; x++) {
-            int drcs_x = static_cast<int>(x_fraction * static_cast<float>(x));
+            uint32_t value = row0[x] * (256 - ty.weight1) + row1[x] * ty.weight1;
+            dest[x] = static_cast<uint8_t>((value + 32768) >> 16);
+        }
+    }
+}
 
-            intptr_t index = (drcs_y * drcs.width + drcs_x) * drcs.depth_bits / 8;
-            intptr_t bit_offset = (drcs_y * drcs.width + drcs_x) * drcs.depth_bits % 8;
-            uint8_t byte = drcs.pixels[index];
+GlyphMask DRCSRenderer::DilateMask(const GlyphMask& mask, int radius) {
+    GlyphMask border;
+    border.left = mask.left - radius;
+    border.top = mask.top - radius;
+    border.width = mask.width + radius * 2;
+    border.height = mask.height + radius * 2;
+    border.coverage.resize(static_cast<size_t>(border.width) * border.height);
 
-            uint8_t value = (byte >> (8 - (bit_offset + drcs.depth_bits))) & (drcs.depth - 1);
-            uint8_t grey = alphablend::Clamp255((uint32_t)255 * value / (drcs.depth - 1));
+    // Disk shaped structuring element is decomposed into horizontal spans, one per row offset.
+    // Each span width only depends on |dy|, so rows are dilated horizontally once per distinct half width.
+    std::vector<int> half_widths(radius + 1);
+    for (int dy = 0; dy <= radius; dy++) {
+        half_widths[dy] = static_cast<int>(std::sqrt(static_cast<float>(radius * radius - dy * dy)));
+    }
 
-            if (grey) {
-                uint8_t alpha = (static_cast<uint32_t>(grey) * color.a) >> 8;
-                dest[x] = ColorRGBA(color, alpha);
-            } else {
-                dest[x] = ColorRGBA(0);
+    // horizontal[k]: source rows dilated by [-k, k], in border coordinates horizontally
+    std::vector<std::vector<uint8_t>> horizontal(radius + 1);
+    for (int dy = 0; dy <= radius; dy++) {
+        int k = half_widths[dy];
+        std::vector<uint8_t>& rows = horizontal[k];
+        if (!rows.empty()) {
+            continue;
+        }
+        rows.resize(static_cast<size_t>(border.width) * mask.height);
+        for (int y = 0; y < mask.height; y++) {
+            const uint8_t* src = mask.coverage.data() + static_cast<size_t>(y) * mask.width;
+            uint8_t* dest = rows.data() + static_cast<size_t>(y) * border.width;
+            for (int x = 0; x < border.width; x++) {
+                int sx_begin = std::max(x - radius - k, 0);
+                int sx_end = std::min(x - radius + k, mask.width - 1);
+                uint8_t value = 0;
+                for (int sx = sx_begin; sx <= sx_end; sx++) {
+                    value = std::max(value, src[sx]);
+                }
+                dest[x] = value;
+            }
+        }
+    }
+
+    for (int y = 0; y < border.height; y++) {
+        uint8_t* dest = border.coverage.data() + static_cast<size_t>(y) * border.width;
+        for (int dy = -radius; dy <= radius; dy++) {
+            int sy = y - radius + dy;
+            if (sy < 0 || sy >= mask.height) {
+                continue;
+            }
+            const std::vector<uint8_t>& rows = horizontal[half_widths[std::abs(dy)]];
+            const uint8_t* src = rows.data() + static_cast<size_t>(sy) * border.width;
+            for (int x = 0; x < border.width; x++) {
+                dest[x] = std::max(dest[x], src[x]);
             }
         }
     }
 
-    return bitmap;
+    return border;
 }
 
 }  // namespace aribcaption
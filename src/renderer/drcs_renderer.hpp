@@ -19,23 +19,57 @@
 #ifndef ARIBCAPTION_DRCS_RENDERER_HPP
 #define ARIBCAPTION_DRCS_RENDERER_HPP
 
+#include <cstdint>
+#include <memory>
+#include <vector>
 #include "aribcaption/caption.hpp"
 #include "aribcaption/color.hpp"
+#include "renderer/glyph_cache.hpp"
 
 namespace aribcaption {
 
 class Bitmap;
 
+enum class DRCSScaleFilter {
+    kNearest,   // Keeps the hard pixel edges of the pattern
+    kBilinear,  // Smoother result on large upscales
+};
+
 class DRCSRenderer {
 public:
-    DRCSRenderer() = default;
+    DRCSRenderer();
     ~DRCSRenderer() = default;
 public:
     bool DrawDRCS(const DRCS& drcs, CharStyle style, ColorRGBA color, ColorRGBA stroke_color,
                   int stroke_width, int char_width, int char_height,
                   Bitmap& target_bmp, int x, int y);
+
+    // 8-bit coverage mask of the DRCS scaled to target size, served from the scaled mask cache.
+    // If stroke_width > 0, border will contain the fill mask dilated by a disk of radius stroke_width
+    auto GetScaledMask(const DRCS& drcs, int target_width, int target_height, int stroke_width = 0)
+        -> std::shared_ptr<const CachedGlyph>;
+
+    // Changing the filter drops the scaled mask cache
+    void SetScaleFilter(DRCSScaleFilter filter);
+
+    void SetCacheLimit(size_t limit_bytes);
+    void ClearCache();
+    // Take over the scaled masks of other, which should use the same scale filter
+    void CopyCacheFrom(const DRCSRenderer& other);
+    [[nodiscard]]
+    size_t cache_bytes() const { return mask_cache_.GetStats().used_bytes; }
+private:
+    static uint64_t HashDRCS(const DRCS& drcs);
+    static void ScaleDRCSToCoverage(const DRCS& drcs, int target_width, int target_height,
+                                    DRCSScaleFilter filter, uint8_t* coverage);
+    static GlyphMask DilateMask(const GlyphMask& mask, int radius);
 private:
-    static Bitmap DRCSToColoredBitmap(const DRCS& drcs, int target_width, int target_height, ColorRGBA color);
+    // A quarter of GlyphCache::kDefaultLimitBytes, see RegionRenderer::SetGlyphCacheLimit()
+    static constexpr size_t kDefaultCacheLimitBytes = GlyphCache::kDefaultLimitBytes / 4;
+
+    // Scaled masks keyed by (DRCS content hash, target size), reusing the glyph cache machinery
+    GlyphCache mask_cache_;
+    DRCSScaleFilter scale_filter_ = DRCSScaleFilter::kNearest;
 public:
     DRCSRenderer(const DRCSRenderer&) = delete;
     DRCSRenderer& operator=(const DRCSRenderer&) = delete;
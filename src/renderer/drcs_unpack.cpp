@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "base/always_inline.hpp"
+#include "renderer/alphablend_generic.hpp"
+#include "renderer/drcs_unpack.hpp"
+
+#if (defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)) && \
+    (defined(__SSE2__) || defined(_MSC_VER))
+    #include <emmintrin.h>  // SSE2
+    #define ARIBCC_HAS_SSE2_DRCS_KERNELS 1
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define ARIBCC_HAS_NEON_DRCS_KERNELS 1
+#endif
+
+namespace aribcaption::drcs {
+
+namespace {
+
+// Reads depth_bits bits starting at bit_offset, fields may straddle a byte boundary if depth_bits isn't a power of 2
+ALWAYS_INLINE uint32_t ReadLevel(const uint8_t* pixels, size_t pixels_size, size_t bit_offset, int depth_bits) {
+    size_t index = bit_offset / 8;
+    uint32_t window = 0;
+    if (index < pixels_size) {
+        window = static_cast<uint32_t>(pixels[index]) << 8;
+    }
+    if (index + 1 < pixels_size) {
+        window |= pixels[index + 1];
+    }
+    uint32_t shift = 16 - static_cast<uint32_t>(bit_offset % 8) - static_cast<uint32_t>(depth_bits);
+    return (window >> shift) & ((1u << depth_bits) - 1);
+}
+
+void UnpackToCoverage_Generic(const uint8_t* pixels, size_t pixels_size, size_t pixel_count,
+                              int depth, int depth_bits, uint8_t* coverage) {
+    uint8_t levels[256];
+    uint32_t max_level = static_cast<uint32_t>(std::max(depth - 1, 1));
+    for (uint32_t v = 0; v < (1u << depth_bits); v++) {
+        levels[v] = alphablend::Clamp255(255 * v / max_level);
+    }
+
+    size_t bit_offset = 0;
+    for (size_t i = 0; i < pixel_count; i++) {
+        coverage[i] = levels[ReadLevel(pixels, pixels_size, bit_offset, depth_bits)];
+        bit_offset += depth_bits;
+    }
+}
+
+// Vector kernels handle depth == 1 << depth_bits with depth_bits of 1, 2 or 4, which covers every DRCS seen in practice.
+//
+// Each input byte is replicated once per pixel it contains, then every bit of a pixel is tested separately.
+// 255 * v / (2^bits - 1) simply repeats the bit pattern of v across the byte, so the coverage is the OR of
+// a fixed weight per set bit, no multiplication needed: 0b10 -> 0xAA, 0b01 -> 0x55 for 2-bit pixels.
+ALWAYS_INLINE uint8_t BitMask(int depth_bits, int lane, int bit) {
+    int pixels_per_byte = 8 / depth_bits;
+    int pixel = lane % pixels_per_byte;
+    return static_cast<uint8_t>(0x80 >> (pixel * depth_bits + bit));
+}
+
+ALWAYS_INLINE uint8_t BitWeight(int depth_bits, int bit) {
+    return static_cast<uint8_t>((0xFF / ((1 << depth_bits) - 1)) << (depth_bits - 1 - bit));
+}
+
+#if defined(ARIBCC_HAS_SSE2_DRCS_KERNELS)
+
+template <int kDepthBits>
+void UnpackBlocks_SSE2(const uint8_t* pixels, size_t blocks, uint8_t* coverage) {
+    constexpr int kReplicas = 8 / kDepthBits;
+
+    __m128i masks[kDepthBits];
+    __m128i weights[kDepthBits];
+    for (int bit = 0; bit < kDepthBits; bit++) {
+        alignas(16) uint8_t lanes[16];
+        for (int lane = 0; lane < 16; lane++) {
+            lanes[lane] = BitMask(kDepthBits, lane, bit);
+        }
+        masks[bit] = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes));
+        weights[bit] = _mm_set1_epi8(static_cast<char>(BitWeight(kDepthBits, bit)));
+    }
+
+    for (size_t block = 0; block < blocks; block++) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + block * 16));
+
+        // Replicate every byte kReplicas times, in order
+        __m128i replicated[8];
+        replicated[0] = _mm_unpacklo_epi8(v, v);
+        replicated[1] = _mm_unpackhi_epi8(v, v);
+        if constexpr (kReplicas >= 4) {
+            for (int i = 1; i >= 0; i--) {
+                replicated[i * 2 + 1] = _mm_unpackhi_epi16(replicated[i], replicated[i]);
+                replicated[i * 2] = _mm_unpacklo_epi16(replicated[i], replicated[i]);
+            }
+        }
+        if constexpr (kReplicas >= 8) {
+            for (int i = 3; i >= 0; i--) {
+                replicated[i * 2 + 1] = _mm_unpackhi_epi32(replicated[i], replicated[i]);
+                replicated[i * 2] = _mm_unpacklo_epi32(replicated[i], replicated[i]);
+            }
+        }
+
+        for (int i = 0; i < kReplicas; i++) {
+            __m128i out = _mm_setzero_si128();
+            for (int bit = 0; bit < kDepthBits; bit++) {
+                __m128i tested = _mm_cmpeq_epi8(_mm_and_si128(replicated[i], masks[bit]), masks[bit]);
+                out = _mm_or_si128(out, _mm_and_si128(tested, weights[bit]));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(coverage + (block * kReplicas + i) * 16), out);
+        }
+    }
+}
+
+#elif defined(ARIBCC_HAS_NEON_DRCS_KERNELS)
+
+template <int kDepthBits>
+void UnpackBlocks_NEON(const uint8_t* pixels, size_t blocks, uint8_t* coverage) {
+    constexpr int kReplicas = 8 / kDepthBits;
+
+    uint8x16_t masks[kDepthBits];
+    uint8x16_t weights[kDepthBits];
+    for (int bit = 0; bit < kDepthBits; bit++) {
+        uint8_t lanes[16];
+        for (int lane = 0; lane < 16; lane++) {
+            lanes[lane] = BitMask(kDepthBits, lane, bit);
+        }
+        masks[bit] = vld1q_u8(lanes);
+        weights[bit] = vdupq_n_u8(BitWeight(kDepthBits, bit));
+    }
+
+    for (size_t block = 0; block < blocks; block++) {
+        uint8x16_t v = vld1q_u8(pixels + block * 16);
+
+        // Replicate every byte kReplicas times, in order
+        uint8x16_t replicated[8];
+        uint8x16x2_t zipped8 = vzipq_u8(v, v);
+        replicated[0] = zipped8.val[0];
+        replicated[1] = zipped8.val[1];
+        if constexpr (kReplicas >= 4) {
+            for (int i = 1; i >= 0; i--) {
+                uint16x8_t half = vreinterpretq_u16_u8(replicated[i]);
+                uint16x8x2_t zipped16 = vzipq_u16(half, half);
+                replicated[i * 2] = vreinterpretq_u8_u16(zipped16.val[0]);
+                replicated[i * 2 + 1] = vreinterpretq_u8_u16(zipped16.val[1]);
+            }
+        }
+        if constexpr (kReplicas >= 8) {
+            for (int i = 3; i >= 0; i--) {
+                uint32x4_t word = vreinterpretq_u32_u8(replicated[i]);
+                uint32x4x2_t zipped32 = vzipq_u32(word, word);
+                replicated[i * 2] = vreinterpretq_u8_u32(zipped32.val[0]);
+                replicated[i * 2 + 1] = vreinterpretq_u8_u32(zipped32.val[1]);
+            }
+        }
+
+        for (int i = 0; i < kReplicas; i++) {
+            uint8x16_t out = vdupq_n_u8(0);
+            for (int bit = 0; bit < kDepthBits; bit++) {
+                out = vorrq_u8(out, vandq_u8(vtstq_u8(replicated[i], masks[bit]), weights[bit]));
+            }
+            vst1q_u8(coverage + (block * kReplicas + i) * 16, out);
+        }
+    }
+}
+
+#endif
+
+template <int kDepthBits>
+void UnpackBlocks(const uint8_t* pixels, size_t blocks, uint8_t* coverage) {
+#if defined(ARIBCC_HAS_SSE2_DRCS_KERNELS)
+    UnpackBlocks_SSE2<kDepthBits>(pixels, blocks, coverage);
+#elif defined(ARIBCC_HAS_NEON_DRCS_KERNELS)
+    UnpackBlocks_NEON<kDepthBits>(pixels, blocks, coverage);
+#else
+    constexpr size_t kPixelsPerBlock = 16 * 8 / kDepthBits;
+    UnpackToCoverage_Generic(pixels, blocks * 16, blocks * kPixelsPerBlock, 1 << kDepthBits, kDepthBits, coverage);
+#endif
+}
+
+}  // namespace
+
+void UnpackToCoverage(const uint8_t* pixels, size_t pixels_size, size_t pixel_count,
+                      int depth, int depth_bits, uint8_t* coverage) {
+    if (depth_bits < 1 || depth_bits > 8) {
+        memset(coverage, 0, pixel_count);
+        return;
+    }
+
+    size_t unpacked = 0;
+    if (depth == 1 << depth_bits && (depth_bits == 1 || depth_bits == 2 || depth_bits == 4)) {
+        size_t pixels_per_block = 16 * 8 / depth_bits;
+        size_t blocks = std::min(pixel_count / pixels_per_block, pixels_size / 16);
+        if (depth_bits == 1) {
+            UnpackBlocks<1>(pixels, blocks, coverage);
+        } else if (depth_bits == 2) {
+            UnpackBlocks<2>(pixels, blocks, coverage);
+        } else {
+            UnpackBlocks<4>(pixels, blocks, coverage);
+        }
+        unpacked = blocks * pixels_per_block;
+    }
+
+    // Remaining pixels always start at a byte boundary
+    size_t consumed_bytes = unpacked * depth_bits / 8;
+    UnpackToCoverage_Generic(pixels + consumed_bytes, pixels_size - consumed_bytes, pixel_count - unpacked,
+                             depth, depth_bits, coverage + unpacked);
+}
+
+}  // namespace aribcaption::drcs
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_DRCS_UNPACK_HPP
+#define ARIBCAPTION_DRCS_UNPACK_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace aribcaption::drcs {
+
+/**
+ * Expand packed DRCS pixels into 8-bit coverage, one byte per pixel.
+ *
+ * Pixels are packed MSB first with depth_bits bits each, continuously across rows.
+ * A level of v is expanded to 255 * v / (depth - 1), levels >= depth saturate to 255.
+ * Pixels lying beyond pixels_size bytes are treated as 0, coverage must hold pixel_count bytes.
+ */
+void UnpackToCoverage(const uint8_t* pixels, size_t pixels_size, size_t pixel_count,
+                      int depth, int depth_bits, uint8_t* coverage);
+
+}  // namespace aribcaption::drcs
+
+#endif  // ARIBCAPTION_DRCS_UNPACK_HPP
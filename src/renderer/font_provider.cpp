@@ -40,6 +40,10 @@
     #include "renderer/font_provider_gdi.hpp"
 #endif
 
+#if defined(ARIBCC_USE_FREETYPE)
+    #include "renderer/font_provider_memory.hpp"
+#endif
+
 namespace aribcaption {
 
 std::unique_ptr<FontProvider> FontProvider::Create(FontProviderType type, Context& context) {
@@ -69,6 +73,11 @@ std::unique_ptr<FontProvider> FontProvider::Create(FontProviderType type, Contex
             return std::make_unique<FontProviderGDI>(context);
 #endif
 
+#if defined(ARIBCC_USE_FREETYPE)
+        case FontProviderType::kMemory:
+            return std::make_unique<FontProviderMemory>(context);
+#endif
+
         case FontProviderType::kAuto:
         default:
 #if defined(_WIN32) && defined(ARIBCC_USE_DIRECTWRITE)
@@ -81,6 +90,8 @@ std::unique_ptr<FontProvider> FontProvider::Create(FontProviderType type, Contex
             return std::make_unique<FontProviderAndroid>(context);
 #elif defined(ARIBCC_USE_FONTCONFIG)
             return std::make_unique<FontProviderFontconfig>(context);
+#elif defined(ARIBCC_USE_FREETYPE)
+            return std::make_unique<FontProviderMemory>(context);
 #else
             static_assert(false, "No available auto-select FontProvider!");
 #endif
@@ -41,7 +41,7 @@ struct FontfaceInfo {
     std::string postscript_name;
     std::string filename;
     int face_index = 0;
-    std::vector<uint8_t> font_data;
+    std::shared_ptr<const std::vector<uint8_t>> font_data;  // Font file loaded into memory, may be shared between faces
     FontProviderType provider_type = FontProviderType::kAuto;
     std::unique_ptr<FontfaceInfoPrivate> provider_priv;
 };
@@ -20,6 +20,7 @@
 #include <cstring>
 #include <cstdlib>
 #include <algorithm>
+#include <mutex>
 #include "renderer/font_provider_android.hpp"
 
 using namespace tinyxml2;
@@ -40,11 +41,42 @@ FontProviderType FontProviderAndroid::GetType() {
     return FontProviderType::kAndroid;
 }
 
+namespace {
+
+// Font families parsed from the system font configs, shared by all instances in the process.
+// System fonts don't change while the process is alive, so the XML files are parsed only once.
+struct FontCatalogCache {
+    std::mutex mutex;
+    bool loaded = false;
+    std::string base_font_path;
+    std::vector<FontFamily> font_families;
+};
+
+FontCatalogCache& GetFontCatalogCache() {
+    static FontCatalogCache cache;
+    return cache;
+}
+
+}  // namespace
+
 bool FontProviderAndroid::Initialize() {
     base_font_path_ = getenv("ANDROID_ROOT");
     base_font_path_.append("/fonts/");
 
+    FontCatalogCache& cache = GetFontCatalogCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (cache.loaded && cache.base_font_path == base_font_path_) {
+        font_families_ = cache.font_families;
+        return true;
+    }
+
+    font_families_.clear();
     bool ret = ParseAndroidSystemFonts();
+    if (ret) {
+        cache.loaded = true;
+        cache.base_font_path = base_font_path_;
+        cache.font_families = font_families_;
+    }
     return ret;
 }
 
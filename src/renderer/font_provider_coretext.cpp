@@ -17,6 +17,7 @@
  */
 
 #include <CoreFoundation/CoreFoundation.h>
+#include <cassert>
 #include <TargetConditionals.h>
 #if TARGET_OS_IPHONE
     #include <CoreText/CoreText.h>
@@ -26,7 +27,6 @@
 #include "base/cfstr_helper.hpp"
 #include "base/scoped_cfref.hpp"
 #include "base/scoped_holder.hpp"
-#include "base/utf_helper.hpp"
 #include "renderer/font_provider_coretext.hpp"
 
 namespace aribcaption {
@@ -37,7 +37,24 @@ FontProviderType FontProviderCoreText::GetType() {
     return FontProviderType::kCoreText;
 }
 
+// Matching font descriptors is expensive, especially on iOS.
+// Resolve each family once and share the results between all renderers, released along with the last instance.
+std::shared_ptr<FontProviderCoreText::SharedCache> FontProviderCoreText::AcquireSharedCache() {
+    static std::mutex shared_cache_mutex;
+    static std::weak_ptr<SharedCache> shared_cache;
+
+    std::lock_guard<std::mutex> lock(shared_cache_mutex);
+    if (auto cache = shared_cache.lock()) {
+        return cache;
+    }
+
+    auto cache = std::make_shared<SharedCache>();
+    shared_cache = cache;
+    return cache;
+}
+
 bool FontProviderCoreText::Initialize() {
+    cache_ = AcquireSharedCache();
     return true;
 }
 
@@ -81,8 +98,54 @@ static std::string ConvertFamilyName(const std::string& family_name, uint32_t is
 
 auto FontProviderCoreText::GetFontFace(const std::string& font_name,
                                        std::optional<uint32_t> ucs4) -> Result<FontfaceInfo, FontProviderError> {
+    assert(cache_);
     std::string converted_font = ConvertFamilyName(font_name, iso6392_language_code_);
-    ScopedCFRef<CFStringRef> fontname_request(cfstr::StdStringToCFString(converted_font));
+
+    std::lock_guard<std::mutex> lock(cache_->mutex);
+    auto& resolved_fonts = cache_->resolved_fonts;
+    auto iter = resolved_fonts.find(converted_font);
+    if (iter == resolved_fonts.end()) {
+        auto result = ResolveFont(converted_font);
+        if (result.is_err()) {
+            if (result.error() != FontProviderError::kFontNotFound) {
+                return Err(result.error());
+            }
+            resolved_fonts.emplace(converted_font, std::nullopt);
+            return Err(FontProviderError::kFontNotFound);
+        }
+        iter = resolved_fonts.emplace(converted_font, std::move(result.value())).first;
+    }
+
+    if (!iter->second) {
+        return Err(FontProviderError::kFontNotFound);
+    }
+    const ResolvedFont& font = iter->second.value();
+
+    // Check whether the font contains the required codepoint if needed
+    if (ucs4.has_value()) {
+        if (!CFCharacterSetIsLongCharacterMember(font.charset.get(), static_cast<UTF32Char>(ucs4.value()))) {
+            log_->w("CoreText: Font %s doesn't contain U+%04X", converted_font.c_str(), ucs4.value());
+            return Err(FontProviderError::kCodePointNotFound);
+        }
+    }
+
+    FontfaceInfo info;
+    info.family_name = font.family_name;
+    info.postscript_name = font.postscript_name;
+    info.filename = font.filename;
+    info.face_index = -1;
+    info.provider_type = FontProviderType::kCoreText;
+
+    // CTFont is immutable, hand out another reference of the cached one
+    auto priv = std::make_unique<FontfaceInfoPrivateCoreText>();
+    priv->ct_font = ScopedCFRef<CTFontRef>(static_cast<CTFontRef>(CFRetain(font.ct_font.get())));
+    info.provider_priv = std::move(priv);
+
+    return Ok(std::move(info));
+}
+
+auto FontProviderCoreText::ResolveFont(const std::string& family_name) -> Result<ResolvedFont, FontProviderError> {
+    ScopedCFRef<CFStringRef> fontname_request(cfstr::StdStringToCFString(family_name));
     if (!fontname_request)
         return Err(FontProviderError::kOtherError);
 
@@ -120,20 +183,10 @@ auto FontProviderCoreText::GetFontFace(const std::string& font_name,
         return Err(FontProviderError::kFontNotFound);
     }
 
-    // Check whether the font contains the required codepoint if needed
-    if (ucs4.has_value()) {
-        std::u16string utf16;
-        size_t count = utf::UTF16AppendCodePoint(utf16, ucs4.value());
-        CGGlyph glyphs[2] = {0};
-        bool ret = CTFontGetGlyphsForCharacters(ct_font.get(),
-                                                reinterpret_cast<UniChar*>(utf16.data()),
-                                                glyphs,
-                                                static_cast<CFIndex>(count));
-        if (!ret) {
-            log_->w("CoreText: Font %s doesn't contain U+%04X", converted_font.c_str(), ucs4.value());
-            return Err(FontProviderError::kCodePointNotFound);
-        }
-    }
+    // Codepoint coverage, checked for each request against the cached font
+    ScopedCFRef<CFCharacterSetRef> charset(CTFontCopyCharacterSet(ct_font.get()));
+    if (!charset)
+        return Err(FontProviderError::kOtherError);
 
     // Retrieve descriptor associated with the CTFont
     ScopedCFRef<CTFontDescriptorRef> ct_font_descriptor(CTFontCopyFontDescriptor(ct_font.get()));
@@ -162,18 +215,14 @@ auto FontProviderCoreText::GetFontFace(const std::string& font_name,
     if (!cf_postscript_name)
         return Err(FontProviderError::kOtherError);
 
-    FontfaceInfo info;
-    info.family_name = cfstr::CFStringToStdString(cf_family_name.get());
-    info.postscript_name = cfstr::CFStringToStdString(cf_postscript_name.get());
-    info.filename = cfstr::CFStringToStdString(cf_path.get());;
-    info.face_index = -1;
-    info.provider_type = FontProviderType::kCoreText;
-
-    auto priv = std::make_unique<FontfaceInfoPrivateCoreText>();
-    priv->ct_font = std::move(ct_font);
-    info.provider_priv = std::move(priv);
+    ResolvedFont font;
+    font.family_name = cfstr::CFStringToStdString(cf_family_name.get());
+    font.postscript_name = cfstr::CFStringToStdString(cf_postscript_name.get());
+    font.filename = cfstr::CFStringToStdString(cf_path.get());
+    font.ct_font = std::move(ct_font);
+    font.charset = std::move(charset);
 
-    return Ok(std::move(info));
+    return Ok(std::move(font));
 }
 
 }  // namespace aribcaption
@@ -26,6 +26,10 @@
     #include <ApplicationServices/ApplicationServices.h>
 #endif
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
 #include "aribcaption/context.hpp"
 #include "base/logger.hpp"
 #include "base/scoped_cfref.hpp"
@@ -52,10 +56,31 @@ public:
     void SetLanguage(uint32_t iso6392_language_code) override;
     Result<FontfaceInfo, FontProviderError> GetFontFace(const std::string& font_name,
                                                         std::optional<uint32_t> ucs4) override;
+private:
+    struct ResolvedFont {
+        ScopedCFRef<CTFontRef> ct_font;
+        ScopedCFRef<CFCharacterSetRef> charset;  // Codepoints covered by ct_font
+        std::string family_name;
+        std::string postscript_name;
+        std::string filename;
+    };
+
+    // Resolved fonts shared by all instances, see AcquireSharedCache()
+    struct SharedCache {
+        std::mutex mutex;  // Guards resolved_fonts
+        // Converted family name => resolved font, or nullopt if not found.
+        // The language is folded into the converted name, so entries stay valid across SetLanguage().
+        std::unordered_map<std::string, std::optional<ResolvedFont>> resolved_fonts;
+    };
+    static std::shared_ptr<SharedCache> AcquireSharedCache();
+
+    auto ResolveFont(const std::string& family_name) -> Result<ResolvedFont, FontProviderError>;
 private:
     std::shared_ptr<Logger> log_;
 
     uint32_t iso6392_language_code_ = 0;
+
+    std::shared_ptr<SharedCache> cache_;
 };
 
 }  // namespace aribcaption
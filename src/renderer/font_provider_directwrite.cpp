@@ -18,6 +18,7 @@
 
 #include <windows.h>
 #include <initguid.h>
+#include <cassert>
 #include "base/wchar_helper.hpp"
 #include "renderer/font_provider_directwrite.hpp"
 
@@ -31,26 +32,51 @@ FontProviderType FontProviderDirectWrite::GetType() {
     return FontProviderType::kDirectWrite;
 }
 
-bool FontProviderDirectWrite::Initialize() {
+// Resolving families through the system font collection is slow with many fonts installed,
+// resolve each family once and share the results between all renderers.
+// The cache is released along with the last instance, so newly installed fonts are found by the next Initialize().
+std::shared_ptr<FontProviderDirectWrite::SharedFactory> FontProviderDirectWrite::AcquireSharedFactory() {
+    static std::mutex shared_factory_mutex;
+    static std::weak_ptr<SharedFactory> shared_factory;
+
+    std::lock_guard<std::mutex> lock(shared_factory_mutex);
+    if (auto factory = shared_factory.lock()) {
+        return factory;
+    }
+
+    auto factory = std::make_shared<SharedFactory>();
     HRESULT hr = DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED,
                                      IID_IDWriteFactory,
-                                     static_cast<IUnknown**>(&dwrite_factory_));
+                                     static_cast<IUnknown**>(&factory->dwrite_factory));
     if (FAILED(hr)) {
-        log_->e("FontProviderDirectWrite: Failed to create IDWriteFactory");
-        return false;
+        return nullptr;
     }
 
-    hr = dwrite_factory_->GetGdiInterop(&dwrite_gdi_interop_);
+    hr = factory->dwrite_factory->GetGdiInterop(&factory->dwrite_gdi_interop);
     if (FAILED(hr)) {
-        log_->e("FontProviderDirectWrite: Failed to retrieve IDWriteGdiInterop");
+        return nullptr;
+    }
+
+    shared_factory = factory;
+    return factory;
+}
+
+bool FontProviderDirectWrite::Initialize() {
+    std::shared_ptr<SharedFactory> factory = AcquireSharedFactory();
+    if (!factory) {
+        log_->e("FontProviderDirectWrite: Failed to create IDWriteFactory or retrieve IDWriteGdiInterop");
         return false;
     }
 
+    factory_ = std::move(factory);
     return true;
 }
 
 ComPtr<IDWriteFactory> FontProviderDirectWrite::GetDWriteFactory() {
-    return dwrite_factory_;
+    if (!factory_) {
+        return nullptr;
+    }
+    return factory_->dwrite_factory;
 }
 
 void FontProviderDirectWrite::SetLanguage(uint32_t iso6392_language_code) {
@@ -134,8 +160,61 @@ static std::string DWriteLocalizedStringsToUTF8(IDWriteLocalizedStrings* strs,
 
 auto FontProviderDirectWrite::GetFontFace(const std::string& font_name,
                                           std::optional<uint32_t> ucs4) -> Result<FontfaceInfo, FontProviderError> {
+    assert(factory_);
     std::string converted_family_name = ConvertFamilyName(font_name, iso6392_language_code_);
-    std::wstring wide_font_name = wchar::UTF8ToWideString(converted_family_name);
+
+    std::unique_lock<std::mutex> lock(factory_->mutex);
+    auto& resolve_cache = factory_->resolve_cache;
+    auto iter = resolve_cache.find(converted_family_name);
+    if (iter == resolve_cache.end()) {
+        auto result = ResolveFont(converted_family_name);
+        if (result.is_err()) {
+            if (result.error() != FontProviderError::kFontNotFound) {
+                return Err(result.error());
+            }
+            resolve_cache.emplace(converted_family_name, std::nullopt);
+            return Err(FontProviderError::kFontNotFound);
+        }
+        iter = resolve_cache.emplace(converted_family_name, std::move(result.value())).first;
+    }
+
+    if (!iter->second) {
+        return Err(FontProviderError::kFontNotFound);
+    }
+    // Entries are never erased while the cache is alive, and COM objects are reference counted
+    const ResolvedFont& font = iter->second.value();
+    ComPtr<IDWriteFont> dwrite_font = font.font;
+    ComPtr<IDWriteFontFace> dwrite_fontface = font.fontface;
+
+    FontfaceInfo fontface_info;
+    fontface_info.filename = font.filename;
+    fontface_info.family_name = font.family_name;
+    fontface_info.postscript_name = font.postscript_name;
+    fontface_info.face_index = font.face_index;
+    fontface_info.provider_type = FontProviderType::kDirectWrite;
+    lock.unlock();
+
+    // Check whether the font contains the requested Unicode codepoint
+    if (ucs4.has_value()) {
+        BOOL ucs4_exists = FALSE;
+        HRESULT hr = dwrite_font->HasCharacter(ucs4.value(), &ucs4_exists);
+        if (FAILED(hr) || !ucs4_exists) {
+            log_->w("FontProviderDirectWrite: Font %s doesn't contain U+%04X", font_name.c_str(), ucs4.value());
+            return Err(FontProviderError::kCodePointNotFound);
+        }
+    }
+
+    auto fontface_info_private = std::make_unique<FontfaceInfoPrivateDirectWrite>();
+    fontface_info_private->font = std::move(dwrite_font);
+    fontface_info_private->fontface = std::move(dwrite_fontface);
+
+    fontface_info.provider_priv = std::move(fontface_info_private);
+
+    return Ok(std::move(fontface_info));
+}
+
+auto FontProviderDirectWrite::ResolveFont(const std::string& family_name) -> Result<ResolvedFont, FontProviderError> {
+    std::wstring wide_font_name = wchar::UTF8ToWideString(family_name);
 
     LOGFONTW lf = {0};
     wcscpy_s(lf.lfFaceName, wide_font_name.c_str());
@@ -147,7 +226,7 @@ auto FontProviderDirectWrite::GetFontFace(const std::string& font_name,
     lf.lfPitchAndFamily = DEFAULT_PITCH | FF_DONTCARE;
 
     ComPtr<IDWriteFont> dwrite_font;
-    HRESULT hr = dwrite_gdi_interop_->CreateFontFromLOGFONT(&lf, &dwrite_font);
+    HRESULT hr = factory_->dwrite_gdi_interop->CreateFontFromLOGFONT(&lf, &dwrite_font);
     if (FAILED(hr)) {
         log_->e("FontProviderDirectWrite: IDWriteGdiInterop::CreateFontFromLOGFONT() failed");
         return Err(FontProviderError::kFontNotFound);
@@ -167,16 +246,6 @@ auto FontProviderDirectWrite::GetFontFace(const std::string& font_name,
         return Err(FontProviderError::kOtherError);
     }
 
-    // Check whether the font contains the requested Unicode codepoint
-    if (ucs4.has_value()) {
-        BOOL ucs4_exists = FALSE;
-        hr = dwrite_font->HasCharacter(ucs4.value(), &ucs4_exists);
-        if (FAILED(hr) || !ucs4_exists) {
-            log_->w("FontProviderDirectWrite: Font %s doesn't contain U+%04X", font_name.c_str(), ucs4.value());
-            return Err(FontProviderError::kCodePointNotFound);
-        }
-    }
-
     // Retrieve Font family name
     BOOL exists = FALSE;
     ComPtr<IDWriteLocalizedStrings> localized_family_names;
@@ -243,21 +312,15 @@ auto FontProviderDirectWrite::GetFontFace(const std::string& font_name,
         return Err(FontProviderError::kOtherError);
     }
 
+    ResolvedFont font;
+    font.filename = wchar::WideStringToUTF8(file_path);
+    font.family_name = DWriteLocalizedStringsToUTF8(localized_family_names.Get());
+    font.postscript_name = DWriteLocalizedStringsToUTF8(localized_postscript_names.Get(), 0);
+    font.face_index = static_cast<int>(dwrite_fontface->GetIndex());
+    font.font = std::move(dwrite_font);
+    font.fontface = std::move(dwrite_fontface);
 
-    FontfaceInfo fontface_info;
-    fontface_info.filename = wchar::WideStringToUTF8(file_path);
-    fontface_info.family_name = DWriteLocalizedStringsToUTF8(localized_family_names.Get());
-    fontface_info.postscript_name = DWriteLocalizedStringsToUTF8(localized_postscript_names.Get(), 0);
-    fontface_info.face_index = static_cast<int>(dwrite_fontface->GetIndex());
-    fontface_info.provider_type = FontProviderType::kDirectWrite;
-
-    auto fontface_info_private = std::make_unique<FontfaceInfoPrivateDirectWrite>();
-    fontface_info_private->font = std::move(dwrite_font);
-    fontface_info_private->fontface = std::move(dwrite_fontface);
-
-    fontface_info.provider_priv = std::move(fontface_info_private);
-
-    return Ok(std::move(fontface_info));
+    return Ok(std::move(font));
 }
 
 }  // namespace aribcaption
@@ -22,6 +22,10 @@
 #include <wrl/client.h>
 #include <dwrite.h>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
 #include "aribcaption/context.hpp"
 #include "base/logger.hpp"
 #include "renderer/font_provider.hpp"
@@ -51,13 +55,34 @@ public:
                                                         std::optional<uint32_t> ucs4) override;
 public:
     ComPtr<IDWriteFactory> GetDWriteFactory();
+private:
+    struct ResolvedFont {
+        ComPtr<IDWriteFont> font;
+        ComPtr<IDWriteFontFace> fontface;
+        std::string family_name;
+        std::string postscript_name;
+        std::string filename;
+        int face_index = 0;
+    };
+
+    // Factory and resolved fonts shared by all instances, see AcquireSharedFactory()
+    struct SharedFactory {
+        ComPtr<IDWriteFactory> dwrite_factory;
+        ComPtr<IDWriteGdiInterop> dwrite_gdi_interop;
+        std::mutex mutex;  // Guards resolve_cache
+        // Converted family name => resolved font, or nullopt if not found. Doesn't depend on the codepoint,
+        // which is checked by IDWriteFont::HasCharacter() against the cached font.
+        std::unordered_map<std::string, std::optional<ResolvedFont>> resolve_cache;
+    };
+    static std::shared_ptr<SharedFactory> AcquireSharedFactory();
+
+    auto ResolveFont(const std::string& family_name) -> Result<ResolvedFont, FontProviderError>;
 private:
     std::shared_ptr<Logger> log_;
 
     uint32_t iso6392_language_code_ = 0;
 
-    ComPtr<IDWriteFactory> dwrite_factory_;
-    ComPtr<IDWriteGdiInterop> dwrite_gdi_interop_;
+    std::shared_ptr<SharedFactory> factory_;
 };
 
 }  // namespace aribcaption
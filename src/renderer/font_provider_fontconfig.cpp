@@ -17,6 +17,7 @@
  */
 
 #include <cassert>
+#include <mutex>
 #include "base/language_code.hpp"
 #include "base/scoped_holder.hpp"
 #include "renderer/font_provider_fontconfig.hpp"
@@ -32,17 +33,44 @@ FontProviderType FontProviderFontconfig::GetType() {
     return FontProviderType::kFontconfig;
 }
 
+// Loading configuration and scanning fonts is expensive, load it once and share it between all renderers.
+// The configuration is released along with the last instance, and loaded again by the next Initialize().
+std::shared_ptr<FontProviderFontconfig::SharedConfig> FontProviderFontconfig::AcquireSharedConfig() {
+    // Loading configuration touches fontconfig's global state, serialize it between renderers on different threads
+    static std::mutex shared_config_mutex;
+    static std::weak_ptr<SharedConfig> shared_config;
+
+    std::lock_guard<std::mutex> lock(shared_config_mutex);
+    if (auto config = shared_config.lock()) {
+        return config;
+    }
+
+    FcConfig* fc_config = FcInitLoadConfigAndFonts();
+    if (!fc_config) {
+        return nullptr;
+    }
+    auto config = std::make_shared<SharedConfig>();
+    config->config = ScopedHolder<FcConfig*>(fc_config, FcConfigDestroy);
+    shared_config = config;
+    return config;
+}
+
 bool FontProviderFontconfig::Initialize() {
-    FcConfig* config = nullptr;
-    if (!(config = FcInitLoadConfigAndFonts())) {
+    std::shared_ptr<SharedConfig> config = AcquireSharedConfig();
+    if (!config) {
         log_->e("Fontconfig: FcInitLoadConfigAndFonts() failed");
         return false;
     }
-    config_ = ScopedHolder<FcConfig*>(config, FcConfigDestroy);
+
+    match_cache_.clear();
+    config_ = std::move(config);
     return true;
 }
 
 void FontProviderFontconfig::SetLanguage(uint32_t iso6392_language_code) {
+    if (iso6392_language_code_ != iso6392_language_code) {
+        match_cache_.clear();
+    }
     iso6392_language_code_ = iso6392_language_code;
 }
 
@@ -50,6 +78,43 @@ auto FontProviderFontconfig::GetFontFace(const std::string& font_name,
                                          std::optional<uint32_t> ucs4) -> Result<FontfaceInfo, FontProviderError> {
     assert(config_);
 
+    auto iter = match_cache_.find(font_name);
+    if (iter == match_cache_.end()) {
+        auto result = MatchFont(font_name);
+        if (result.is_err()) {
+            if (result.error() != FontProviderError::kFontNotFound) {
+                return Err(result.error());
+            }
+            match_cache_.emplace(font_name, std::nullopt);
+            return Err(FontProviderError::kFontNotFound);
+        }
+        iter = match_cache_.emplace(font_name, std::move(result.value())).first;
+    }
+
+    if (!iter->second) {
+        return Err(FontProviderError::kFontNotFound);
+    }
+    const MatchedFont& font = iter->second.value();
+
+    if (ucs4.has_value() && ucs4 != 0) {
+        if (FcTrue != FcCharSetHasChar(font.charset, ucs4.value())) {
+            log_->w("Fontconfig: Font %s doesn't contain U+%04X", font_name.c_str(), ucs4.value());
+            return Err(FontProviderError::kCodePointNotFound);
+        }
+    }
+
+    FontfaceInfo info;
+    info.family_name = font.family_name;
+    info.postscript_name = font.postscript_name;
+    info.filename = font.filename;
+    info.face_index = font.face_index;
+    info.provider_type = FontProviderType::kFontconfig;
+
+    return Ok(std::move(info));
+}
+
+auto FontProviderFontconfig::MatchFont(const std::string& font_name) -> Result<MatchedFont, FontProviderError> {
+
     ScopedHolder<FcPattern*> pattern(
         FcNameParse(reinterpret_cast<const FcChar8*>(font_name.c_str())),
         FcPatternDestroy
@@ -62,7 +127,8 @@ auto FontProviderFontconfig::GetFontFace(const std::string& font_name,
     FcPatternAddString(pattern, FC_FAMILY, reinterpret_cast<const FcChar8*>(font_name.c_str()));
     FcPatternAddBool(pattern, FC_OUTLINE, FcTrue);
 
-    if (FcTrue != FcConfigSubstitute(config_, pattern, FcMatchPattern)) {
+    std::unique_lock<std::mutex> config_lock(config_->mutex);
+    if (FcTrue != FcConfigSubstitute(config_->config, pattern, FcMatchPattern)) {
         log_->e("Fontconfig: Substitution cannot be performed");
         return Err(FontProviderError::kOtherError);
     }
@@ -77,7 +143,8 @@ auto FontProviderFontconfig::GetFontFace(const std::string& font_name,
     }
 
     FcResult result = FcResultMatch;
-    FcPattern* matched = FcFontMatch(config_, pattern, &result);
+    FcPattern* matched = FcFontMatch(config_->config, pattern, &result);
+    config_lock.unlock();
     if (!matched || result != FcResultMatch) {
         log_->w("Fontconfig: Cannot find a suitable font for %s", font_name.c_str());
         return Err(FontProviderError::kFontNotFound);
@@ -97,18 +164,10 @@ auto FontProviderFontconfig::GetFontFace(const std::string& font_name,
         return Err(FontProviderError::kOtherError);
     }
 
-    if (ucs4.has_value() && ucs4 != 0) {
-        FcCharSet* charset = nullptr;
-
-        if (FcResultMatch != FcPatternGetCharSet(best, FC_CHARSET, 0, &charset)) {
-            log_->e("Fontconfig: Retrieve font charset failed for %s", font_name.c_str());
-            return Err(FontProviderError::kOtherError);
-        }
-
-        if (FcTrue != FcCharSetHasChar(charset, ucs4.value())) {
-            log_->w("Fontconfig: Font %s doesn't contain U+%04X", font_name.c_str(), ucs4.value());
-            return Err(FontProviderError::kCodePointNotFound);
-        }
+    FcCharSet* charset = nullptr;
+    if (FcResultMatch != FcPatternGetCharSet(best, FC_CHARSET, 0, &charset)) {
+        log_->e("Fontconfig: Retrieve font charset failed for %s", font_name.c_str());
+        return Err(FontProviderError::kOtherError);
     }
 
     FcChar8* fc_family_name = nullptr;
@@ -123,14 +182,16 @@ auto FontProviderFontconfig::GetFontFace(const std::string& font_name,
         return Err(FontProviderError::kOtherError);
     }
 
-    FontfaceInfo info;
-    info.family_name = reinterpret_cast<char*>(fc_family_name);
-    info.postscript_name = reinterpret_cast<char*>(fc_postscript_name);
-    info.filename = reinterpret_cast<char*>(filename);
-    info.face_index = fc_index;
-    info.provider_type = FontProviderType::kFontconfig;
+    MatchedFont font{
+        reinterpret_cast<char*>(fc_family_name),
+        reinterpret_cast<char*>(fc_postscript_name),
+        reinterpret_cast<char*>(filename),
+        fc_index,
+        // Charset is owned by the pattern, keep a reference of it
+        ScopedHolder<FcCharSet*>(FcCharSetCopy(charset), FcCharSetDestroy),
+    };
 
-    return Ok(std::move(info));
+    return Ok(std::move(font));
 }
 
 }  // namespace aribcaption
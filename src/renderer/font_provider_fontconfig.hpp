@@ -21,8 +21,11 @@
 
 #include <fontconfig/fontconfig.h>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "aribcaption/context.hpp"
 #include "base/logger.hpp"
@@ -41,11 +44,31 @@ public:
     void SetLanguage(uint32_t iso6392_language_code) override;
     Result<FontfaceInfo, FontProviderError> GetFontFace(const std::string& font_name,
                                                         std::optional<uint32_t> ucs4) override;
+private:
+    // Loaded configuration shared by all instances, see AcquireSharedConfig()
+    struct SharedConfig {
+        ScopedHolder<FcConfig*> config;
+        std::mutex mutex;  // Guards substitution & matching against the config
+    };
+    static std::shared_ptr<SharedConfig> AcquireSharedConfig();
+
+    struct MatchedFont {
+        std::string family_name;
+        std::string postscript_name;
+        std::string filename;
+        int face_index = 0;
+        ScopedHolder<FcCharSet*> charset;
+    };
+    auto MatchFont(const std::string& font_name) -> Result<MatchedFont, FontProviderError>;
 private:
     std::shared_ptr<Logger> log_;
 
-    ScopedHolder<FcConfig*> config_;
+    std::shared_ptr<SharedConfig> config_;
     uint32_t iso6392_language_code_ = 0;
+
+    // font_name => matched font, or nullopt if no font matches. Result doesn't depend on the codepoint,
+    // which is checked against the cached charset. Invalidated if language or config changes.
+    std::unordered_map<std::string, std::optional<MatchedFont>> match_cache_;
 };
 
 }  // namespace aribcaption
@@ -17,6 +17,11 @@
  */
 
 #include <windows.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
 #include <vector>
 #include "base/utf_helper.hpp"
 #include "base/wchar_helper.hpp"
@@ -70,6 +75,31 @@ static std::string ConvertFamilyName(const std::string& family_name, uint32_t is
     return font_name;
 }
 
+namespace {
+
+struct FontData {
+    std::shared_ptr<const std::vector<uint8_t>> data;
+    bool is_ttc = false;
+};
+
+// Font files extracted by GetFontData(), identified by face name and charset.
+// Whole CJK collections are tens of MB, share them between lookups and renderers while any face still uses them.
+struct FontDataCache {
+    struct Entry {
+        std::weak_ptr<const std::vector<uint8_t>> data;
+        bool is_ttc = false;
+    };
+    std::mutex mutex;
+    std::map<std::pair<std::wstring, BYTE>, Entry> entries;
+};
+
+FontDataCache& GetFontDataCache() {
+    static FontDataCache cache;
+    return cache;
+}
+
+}  // namespace
+
 static bool RetrieveFontData(HDC hdc, std::vector<uint8_t>& buffer, bool& is_ttc) {
     constexpr DWORD ttcf_table = 0x66637474;
     DWORD table = ttcf_table;
@@ -124,6 +154,42 @@ static bool CheckCodePointExists(HDC hdc, uint32_t ucs4) {
     return true;
 }
 
+// Look up font data of the font selected into hdc from the cache, or extract it
+static bool GetCachedFontData(HDC hdc, const LOGFONTW& lf, FontData& out_font_data) {
+    FontDataCache& cache = GetFontDataCache();
+    auto key = std::make_pair(std::wstring(lf.lfFaceName), lf.lfCharSet);
+
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto iter = cache.entries.find(key);
+    if (iter != cache.entries.end()) {
+        if (auto data = iter->second.data.lock()) {
+            out_font_data.data = std::move(data);
+            out_font_data.is_ttc = iter->second.is_ttc;
+            return true;
+        }
+    }
+
+    auto buffer = std::make_shared<std::vector<uint8_t>>();
+    bool is_ttc = false;
+    if (!RetrieveFontData(hdc, *buffer, is_ttc) || buffer->empty()) {
+        return false;
+    }
+
+    // Drop entries whose data has been released
+    for (auto entry = cache.entries.begin(); entry != cache.entries.end(); ) {
+        if (entry->second.data.expired()) {
+            entry = cache.entries.erase(entry);
+        } else {
+            ++entry;
+        }
+    }
+
+    cache.entries[key] = FontDataCache::Entry{buffer, is_ttc};
+    out_font_data.data = std::move(buffer);
+    out_font_data.is_ttc = is_ttc;
+    return true;
+}
+
 #if defined(_MSC_VER) && !defined(__clang__)
     // Specifying calling convention for lambdas is unsupported in MSVC (except clang-cl)
     #define LAMBDA_CALL_CONV(a)
@@ -174,14 +240,14 @@ auto FontProviderGDI::GetFontFace(const std::string& font_name, std::optional<ui
         }
     }
 
-    bool is_ttc = false;
-    bool succ = RetrieveFontData(hdc_, info.font_data, is_ttc);
-    if (!succ || info.font_data.empty()) {
+    FontData font_data;
+    if (!GetCachedFontData(hdc_, lf, font_data)) {
         SelectObject(hdc_, nullptr);
         return Err(FontProviderError::kOtherError);
     }
+    info.font_data = std::move(font_data.data);
 
-    if (is_ttc) {
+    if (font_data.is_ttc) {
         info.face_index = -1;
     }  // else: face_index = 0
 
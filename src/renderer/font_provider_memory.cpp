@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <cassert>
+#include "renderer/font_provider_memory.hpp"
+
+namespace aribcaption {
+
+FontProviderMemory::FontProviderMemory(Context& context)
+    : log_(GetContextLogger(context)), registry_(GetContextFontDataRegistry(context)) {}
+
+FontProviderMemory::~FontProviderMemory() = default;
+
+FontProviderType FontProviderMemory::GetType() {
+    return FontProviderType::kMemory;
+}
+
+bool FontProviderMemory::Initialize() {
+    std::vector<FontDataRegistry::FontData> fonts = registry_->GetFonts();
+    if (fonts.empty()) {
+        log_->e("FontProviderMemory: No font data has been added, see Context::AddFontData()");
+        return false;
+    }
+
+    faces_.clear();
+    if (!library_) {
+        FT_Library library = nullptr;
+        if (FT_Init_FreeType(&library)) {
+            log_->e("FontProviderMemory: FT_Init_FreeType() failed");
+            return false;
+        }
+        library_ = ScopedHolder<FT_Library>(library, FT_Done_FreeType);
+    }
+
+    for (const FontDataRegistry::FontData& data : fonts) {
+        if (!LoadFaces(data)) {
+            log_->w("FontProviderMemory: Failed to load font data of %zu bytes, ignored", data->size());
+        }
+    }
+
+    if (faces_.empty()) {
+        log_->e("FontProviderMemory: None of the added font data could be loaded");
+        return false;
+    }
+    return true;
+}
+
+bool FontProviderMemory::LoadFaces(const FontDataRegistry::FontData& data) {
+    FT_Long num_faces = 1;
+    for (FT_Long face_index = 0; face_index < num_faces; face_index++) {
+        FT_Face ft_face = nullptr;
+        if (FT_New_Memory_Face(library_, data->data(), static_cast<FT_Long>(data->size()), face_index, &ft_face)) {
+            // First face failed means the data is not a font file
+            return face_index > 0;
+        }
+        num_faces = ft_face->num_faces;
+
+        LoadedFace& loaded = faces_.emplace_back();
+        loaded.face = ScopedHolder<FT_Face>(ft_face, FT_Done_Face);
+        loaded.face_index = static_cast<int>(face_index);
+        loaded.data = data;
+        if (ft_face->family_name) {
+            loaded.family_name = ft_face->family_name;
+        }
+        if (const char* postscript_name = FT_Get_Postscript_Name(ft_face)) {
+            loaded.postscript_name = postscript_name;
+        }
+    }
+    return true;
+}
+
+void FontProviderMemory::SetLanguage(uint32_t iso6392_language_code) {
+    (void)iso6392_language_code;
+}
+
+bool FontProviderMemory::HasCodePoint(const LoadedFace& face, std::optional<uint32_t> ucs4) {
+    return !ucs4 || FT_Get_Char_Index(face.face, ucs4.value()) != 0;
+}
+
+auto FontProviderMemory::GetFontFace(const std::string& font_name,
+                                     std::optional<uint32_t> ucs4) -> Result<FontfaceInfo, FontProviderError> {
+    assert(library_);
+
+    const LoadedFace* matched = nullptr;
+    for (const LoadedFace& face : faces_) {
+        if (face.family_name == font_name || face.postscript_name == font_name) {
+            matched = &face;
+            break;
+        }
+    }
+
+    if (matched && !HasCodePoint(*matched, ucs4)) {
+        return Err(FontProviderError::kCodePointNotFound);
+    } else if (!matched) {
+        // Like fontconfig's best match, fall back to the first face covering the codepoint
+        for (const LoadedFace& face : faces_) {
+            if (HasCodePoint(face, ucs4)) {
+                matched = &face;
+                break;
+            }
+        }
+        if (!matched) {
+            return Err(ucs4 ? FontProviderError::kCodePointNotFound : FontProviderError::kFontNotFound);
+        }
+    }
+
+    FontfaceInfo info;
+    info.family_name = matched->family_name;
+    info.postscript_name = matched->postscript_name;
+    info.face_index = matched->face_index;
+    info.font_data = matched->data;
+    info.provider_type = FontProviderType::kMemory;
+
+    return Ok(std::move(info));
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ARIBCAPTION_FONT_PROVIDER_MEMORY_HPP
+#define ARIBCAPTION_FONT_PROVIDER_MEMORY_HPP
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "base/font_data_registry.hpp"
+#include "base/logger.hpp"
+#include "base/scoped_holder.hpp"
+#include "renderer/font_provider.hpp"
+
+namespace aribcaption {
+
+// Serves fonts added into the context by Context::AddFontData(), for platforms without system fonts (e.g. WebAssembly)
+class FontProviderMemory : public FontProvider {
+public:
+    explicit FontProviderMemory(Context& context);
+    ~FontProviderMemory() override;
+public:
+    FontProviderType GetType() override;
+    bool Initialize() override;
+    void SetLanguage(uint32_t iso6392_language_code) override;
+    Result<FontfaceInfo, FontProviderError> GetFontFace(const std::string& font_name,
+                                                        std::optional<uint32_t> ucs4) override;
+private:
+    struct LoadedFace {
+        std::string family_name;
+        std::string postscript_name;
+        int face_index = 0;
+        FontDataRegistry::FontData data;
+        ScopedHolder<FT_Face> face;  // Kept open for looking up codepoints
+    };
+    bool LoadFaces(const FontDataRegistry::FontData& data);
+    static bool HasCodePoint(const LoadedFace& face, std::optional<uint32_t> ucs4);
+private:
+    std::shared_ptr<Logger> log_;
+    std::shared_ptr<FontDataRegistry> registry_;
+
+    // Declared before faces_, so that faces are released before the library
+    ScopedHolder<FT_Library> library_;
+    std::vector<LoadedFace> faces_;  // in the order of fonts being added
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_FONT_PROVIDER_MEMORY_HPP
@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "renderer/alphablend.hpp"
+#include "renderer/frame_blender.hpp"
+#include "renderer/rect.hpp"
+
+namespace aribcaption {
+
+namespace {
+
+using alphablend::YUVCoefficients;
+
+constexpr YUVCoefficients kBT601Coefficients = {66, 129, 25, -38, -74, 112, 112, -94, -18};
+constexpr YUVCoefficients kBT709Coefficients = {47, 157, 16, -26, -87, 112, 112, -102, -10};
+constexpr YUVCoefficients kBT2020Coefficients = {58, 149, 13, -31, -81, 112, 112, -103, -9};
+
+bool IsPremultiplied(PixelFormat format) {
+    return format == PixelFormat::kRGBA8888Premultiplied || format == PixelFormat::kBGRA8888Premultiplied;
+}
+
+bool IsBGRA(PixelFormat format) {
+    return format == PixelFormat::kBGRA8888 || format == PixelFormat::kBGRA8888Premultiplied;
+}
+
+size_t PixelSize(const Image& image) {
+    return image.pixel_format == PixelFormat::kIndexed8 ? 1 : sizeof(ColorRGBA);
+}
+
+// Pixel at frame coordinates of a dense image
+const uint8_t* ImagePixelAt(const Image& image, int x, int y) {
+    return image.data() + static_cast<size_t>(y - image.dst_y) * image.stride + (x - image.dst_x) * PixelSize(image);
+}
+
+// Call func(x, pixels, width) for each span of a run-length encoded image inside [left, right) of frame line y
+template <typename Func>
+void ForEachSpanInLine(const Image& image, int y, int left, int right, Func&& func) {
+    int line = y - image.dst_y;
+    auto begin = std::lower_bound(image.spans.begin(), image.spans.end(), line,
+                                  [](const ImageSpan& span, int line) { return span.y < line; });
+    size_t pixel_size = PixelSize(image);
+    for (auto iter = begin; iter != image.spans.end() && iter->y == line; ++iter) {
+        int span_left = std::max(left, image.dst_x + iter->x);
+        int span_right = std::min(right, image.dst_x + iter->x + iter->length);
+        if (span_left < span_right) {
+            const uint8_t* pixels = image.data() + iter->offset + (span_left - image.dst_x - iter->x) * pixel_size;
+            func(span_left, pixels, static_cast<size_t>(span_right - span_left));
+        }
+    }
+}
+
+// Look up straight alpha RGBA colors of indexed pixels
+void ExpandIndexedPixels(ColorRGBA* dest, const Image& image, const uint8_t* indices, size_t width) {
+    for (size_t i = 0; i < width; i++) {
+        uint8_t index = indices[i];
+        dest[i] = index < image.palette.size() ? image.palette[index] : ColorRGBA();
+    }
+}
+
+void BlendImageToPackedFrame(const Image& image, const FrameBuffer& frame, const Rect& clipped) {
+    bool premultiplied = IsPremultiplied(image.pixel_format);
+    bool swap_r_b = IsBGRA(image.pixel_format) != (frame.format == FrameFormat::kBGRA8888);
+    bool indexed = image.pixel_format == PixelFormat::kIndexed8;
+
+    // Indexed pixels are expanded, and channel order of the image is swapped through a line buffer
+    // if it differs from the frame
+    std::vector<ColorRGBA> line_buffer;
+    if (swap_r_b || indexed) {
+        line_buffer.resize(static_cast<size_t>(clipped.width()));
+    }
+
+    auto blend_pixels = [&](ColorRGBA* dest, const uint8_t* pixels, size_t width) {
+        auto src = reinterpret_cast<const ColorRGBA*>(pixels);
+        if (indexed) {
+            ExpandIndexedPixels(line_buffer.data(), image, pixels, width);
+            src = line_buffer.data();
+        } else if (swap_r_b) {
+            std::copy(src, src + width, line_buffer.begin());
+        }
+        if (swap_r_b) {
+            alphablend::internal::ConvertLine_Generic<false, true>(line_buffer.data(), width);
+            src = line_buffer.data();
+        }
+
+        if (premultiplied) {
+            alphablend::BlendLine_PremultipliedSrc(dest, src, width);
+        } else {
+            alphablend::BlendLine(dest, src, width);
+        }
+    };
+
+    for (int y = clipped.top; y < clipped.bottom; y++) {
+        auto dest = reinterpret_cast<ColorRGBA*>(frame.planes[0] + static_cast<size_t>(y) * frame.strides[0]);
+        if (image.spans.empty()) {
+            blend_pixels(dest + clipped.left, ImagePixelAt(image, clipped.left, y),
+                         static_cast<size_t>(clipped.width()));
+        } else {
+            // Only covered spans are touched
+            ForEachSpanInLine(image, y, clipped.left, clipped.right, [&](int x, const uint8_t* pixels, size_t width) {
+                blend_pixels(dest + x, pixels, width);
+            });
+        }
+    }
+}
+
+const YUVCoefficients& GetYUVCoefficients(YUVMatrix matrix) {
+    switch (matrix) {
+        case YUVMatrix::kBT601:
+            return kBT601Coefficients;
+        case YUVMatrix::kBT2020:
+            return kBT2020Coefficients;
+        case YUVMatrix::kBT709:
+        default:
+            return kBT709Coefficients;
+    }
+}
+
+// Copy pixels of the image starting at x into premultiplied RGBA
+void LoadPremultipliedLine(ColorRGBA* dest, const Image& image, int x, int y, size_t width) {
+    auto copy_pixels = [&](ColorRGBA* line, const uint8_t* pixels, size_t count) {
+        if (image.pixel_format == PixelFormat::kIndexed8) {
+            ExpandIndexedPixels(line, image, pixels, count);
+        } else {
+            auto src = reinterpret_cast<const ColorRGBA*>(pixels);
+            std::copy(src, src + count, line);
+        }
+    };
+
+    if (image.spans.empty()) {
+        copy_pixels(dest, ImagePixelAt(image, x, y), width);
+    } else {
+        std::fill(dest, dest + width, ColorRGBA());
+        ForEachSpanInLine(image, y, x, x + static_cast<int>(width), [&](int span_x, const uint8_t* pixels, size_t count) {
+            copy_pixels(dest + (span_x - x), pixels, count);
+        });
+    }
+
+    switch (image.pixel_format) {
+        case PixelFormat::kRGBA8888:
+        case PixelFormat::kIndexed8:
+            alphablend::ConvertLine<PixelFormat::kRGBA8888Premultiplied>(dest, width);
+            break;
+        case PixelFormat::kBGRA8888:
+            alphablend::ConvertLine<PixelFormat::kBGRA8888Premultiplied>(dest, width);
+            break;
+        case PixelFormat::kBGRA8888Premultiplied:
+            alphablend::ConvertLine<PixelFormat::kBGRA8888>(dest, width);  // Swap R and B only
+            break;
+        case PixelFormat::kRGBA8888Premultiplied:
+        default:
+            break;
+    }
+}
+
+template <typename Sample, bool interleaved_uv>
+void BlendImageToYUVFrame(const Image& image, const FrameBuffer& frame, const Rect& clipped) {
+    const YUVCoefficients& k = GetYUVCoefficients(frame.yuv_matrix);
+
+    // Lines are extended to whole 2x2 blocks. Pixels outside the image are transparent,
+    // while an odd frame edge is replicated so that the edge block averages its pixels inside the frame.
+    int line_left = clipped.left & ~1;
+    int line_right = (clipped.right + 1) & ~1;
+    auto line_width = static_cast<size_t>(line_right - line_left);
+    auto offset = static_cast<size_t>(clipped.left - line_left);
+    auto width = static_cast<size_t>(clipped.width());
+    bool replicate_right = clipped.right == frame.width && (frame.width & 1);
+
+    std::vector<ColorRGBA> lines(line_width * 2);
+    ColorRGBA* line_buffers[2] = {lines.data(), lines.data() + line_width};
+
+    auto luma_line = [&](int y) {
+        return reinterpret_cast<Sample*>(frame.planes[0] + static_cast<size_t>(y) * frame.strides[0]);
+    };
+
+    for (int cy = clipped.top / 2; cy <= (clipped.bottom - 1) / 2; cy++) {
+        for (int i = 0; i < 2; i++) {
+            int y = cy * 2 + i;
+            ColorRGBA* line = line_buffers[i];
+            if (y < clipped.top || y >= clipped.bottom) {
+                std::fill(line, line + line_width, ColorRGBA());
+                continue;
+            }
+            line[0] = ColorRGBA();
+            line[line_width - 1] = ColorRGBA();
+            LoadPremultipliedLine(line + offset, image, clipped.left, y, width);
+            if (replicate_right) {
+                line[line_width - 1] = line[line_width - 2];
+            }
+            alphablend::BlendLumaLine(luma_line(y) + clipped.left, line + offset, width, k);
+        }
+
+        const ColorRGBA* line1 = cy * 2 + 1 >= frame.height ? line_buffers[0] : line_buffers[1];
+        auto blocks = line_width / 2;
+        auto cx = static_cast<size_t>(line_left / 2);
+        if constexpr (interleaved_uv) {
+            auto uv = reinterpret_cast<Sample*>(frame.planes[1] + static_cast<size_t>(cy) * frame.strides[1]) + cx * 2;
+            alphablend::BlendChromaLine<Sample, true>(uv, uv + 1, line_buffers[0], line1, blocks, k);
+        } else {
+            auto u = reinterpret_cast<Sample*>(frame.planes[1] + static_cast<size_t>(cy) * frame.strides[1]) + cx;
+            auto v = reinterpret_cast<Sample*>(frame.planes[2] + static_cast<size_t>(cy) * frame.strides[2]) + cx;
+            alphablend::BlendChromaLine<Sample, false>(u, v, line_buffers[0], line1, blocks, k);
+        }
+    }
+}
+
+// Bilinearly scale the image into its display size, see Image::display_width
+Image ScaleImageToDisplaySize(const Image& image) {
+    Image scaled;
+    scaled.width = image.display_width;
+    scaled.height = image.display_height;
+    scaled.stride = scaled.width * static_cast<int>(sizeof(ColorRGBA));
+    scaled.dst_x = image.dst_x;
+    scaled.dst_y = image.dst_y;
+    scaled.pixel_format = PixelFormat::kRGBA8888Premultiplied;
+    scaled.bitmap.resize(static_cast<size_t>(scaled.stride) * scaled.height);
+
+    // Source pixels sampled by each column, weights in 1/256
+    auto sample = [](int dest, int dest_length, int src_length, int& index, uint32_t& weight) {
+        float position = (static_cast<float>(dest) + 0.5f) * static_cast<float>(src_length) /
+                         static_cast<float>(dest_length) - 0.5f;
+        position = std::clamp(position, 0.0f, static_cast<float>(src_length - 1));
+        index = static_cast<int>(position);
+        weight = static_cast<uint32_t>((position - static_cast<float>(index)) * 256.0f);
+    };
+
+    std::vector<int> column_index(scaled.width);
+    std::vector<uint32_t> column_weight(scaled.width);
+    for (int x = 0; x < scaled.width; x++) {
+        sample(x, scaled.width, image.width, column_index[x], column_weight[x]);
+    }
+
+    auto width = static_cast<size_t>(image.width);
+    std::vector<ColorRGBA> lines(width * 2);
+    std::vector<uint32_t> blended(width * 4);
+    int loaded_row = -1;
+
+    for (int y = 0; y < scaled.height; y++) {
+        int row;
+        uint32_t row_weight;
+        sample(y, scaled.height, image.height, row, row_weight);
+        int next_row = std::min(row + 1, image.height - 1);
+        if (row != loaded_row) {
+            LoadPremultipliedLine(lines.data(), image, image.dst_x, image.dst_y + row, width);
+            LoadPremultipliedLine(lines.data() + width, image, image.dst_x, image.dst_y + next_row, width);
+            loaded_row = row;
+        }
+
+        // Vertical interpolation in 8-bit fixed point, then horizontal into 16-bit
+        for (size_t x = 0; x < width; x++) {
+            for (int c = 0; c < 4; c++) {
+                uint32_t v0 = reinterpret_cast<const uint8_t*>(&lines[x])[c];
+                uint32_t v1 = reinterpret_cast<const uint8_t*>(&lines[width + x])[c];
+                blended[x * 4 + c] = v0 * (256 - row_weight) + v1 * row_weight;
+            }
+        }
+
+        uint8_t* dest = scaled.bitmap.data() + static_cast<size_t>(y) * scaled.stride;
+        for (int x = 0; x < scaled.width; x++) {
+            size_t x0 = static_cast<size_t>(column_index[x]);
+            size_t x1 = std::min(x0 + 1, width - 1);
+            uint32_t w = column_weight[x];
+            for (int c = 0; c < 4; c++) {
+                uint32_t v = blended[x0 * 4 + c] * (256 - w) + blended[x1 * 4 + c] * w;
+                dest[x * 4 + c] = static_cast<uint8_t>((v + 32768) >> 16);
+            }
+        }
+    }
+
+    return scaled;
+}
+
+}  // namespace
+
+bool BlendImageToFrame(const Image& image, const FrameBuffer& frame) {
+    if (!frame.planes[0] || frame.width <= 0 || frame.height <= 0) {
+        return false;
+    }
+    bool is_yuv = frame.format == FrameFormat::kYUV420P || frame.format == FrameFormat::kNV12 ||
+                  frame.format == FrameFormat::kP010;
+    if (is_yuv && (!frame.planes[1] || (frame.format == FrameFormat::kYUV420P && !frame.planes[2]))) {
+        return false;
+    }
+
+    if (image.display_width > 0 && image.display_height > 0 && image.width > 0 && image.height > 0 && image.data() &&
+            (image.display_width != image.width || image.display_height != image.height)) {
+        return BlendImageToFrame(ScaleImageToDisplaySize(image), frame);
+    }
+
+    Rect image_rect(image.dst_x, image.dst_y, image.dst_x + image.width, image.dst_y + image.height);
+    Rect clipped = Rect::ClipRect(Rect(0, 0, frame.width, frame.height), image_rect);
+    if (clipped.width() <= 0 || clipped.height() <= 0 || !image.data()) {
+        return true;  // Nothing to blend
+    }
+
+    switch (frame.format) {
+        case FrameFormat::kYUV420P:
+            BlendImageToYUVFrame<uint8_t, false>(image, frame, clipped);
+            break;
+        case FrameFormat::kNV12:
+            BlendImageToYUVFrame<uint8_t, true>(image, frame, clipped);
+            break;
+        case FrameFormat::kP010:
+            BlendImageToYUVFrame<uint16_t, true>(image, frame, clipped);
+            break;
+        case FrameFormat::kRGBA8888:
+        case FrameFormat::kBGRA8888:
+        default:
+            BlendImageToPackedFrame(image, frame, clipped);
+            break;
+    }
+    return true;
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_FRAME_BLENDER_HPP
+#define ARIBCAPTION_FRAME_BLENDER_HPP
+
+#include "aribcaption/image.hpp"
+#include "aribcaption/renderer.hpp"
+
+namespace aribcaption {
+
+/**
+ * Alpha blend a rendered caption image onto a caller-supplied video frame, at the image's dst_x / dst_y.
+ * The image is clipped to the frame. For YUV frames the image is converted with the frame's matrix,
+ * and chroma is blended per 2x2 block weighted by the coverage of each pixel.
+ * Images carrying a display size (see Image::display_width) are bilinearly scaled into it first.
+ *
+ * Returns false if the frame is invalid, e.g. missing planes.
+ */
+bool BlendImageToFrame(const Image& image, const FrameBuffer& frame);
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_FRAME_BLENDER_HPP
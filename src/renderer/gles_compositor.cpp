@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "aribcaption/gles_compositor.hpp"
+#include "renderer/gles_compositor_impl.hpp"
+
+namespace aribcaption {
+
+GLESCompositor::GLESCompositor(Context& context) : pimpl_(std::make_unique<internal::GLESCompositorImpl>(context)) {}
+
+GLESCompositor::~GLESCompositor() = default;
+
+GLESCompositor::GLESCompositor(GLESCompositor&&) noexcept = default;
+
+GLESCompositor& GLESCompositor::operator=(GLESCompositor&&) noexcept = default;
+
+bool GLESCompositor::Initialize() {
+    return pimpl_->Initialize();
+}
+
+void GLESCompositor::Release() {
+    pimpl_->Release();
+}
+
+void GLESCompositor::Upload(const GlyphAtlasRenderResult& result) {
+    pimpl_->Upload(result);
+}
+
+void GLESCompositor::Draw(const GlyphAtlasRenderResult& result, uint32_t framebuffer, int frame_width, int frame_height) {
+    pimpl_->Draw(result, framebuffer, frame_width, frame_height);
+}
+
+RenderStatus GLESCompositor::Render(Renderer& renderer,
+                                    int64_t pts,
+                                    uint32_t framebuffer,
+                                    int frame_width,
+                                    int frame_height) {
+    return pimpl_->Render(renderer, pts, framebuffer, frame_width, frame_height);
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <GLES3/gl3.h>
+#include <cassert>
+#include <cstddef>
+#include "renderer/gles_compositor_impl.hpp"
+
+namespace aribcaption::internal {
+
+namespace {
+
+const char* kVertexShader = R"(#version 300 es
+layout(location = 0) in vec2 a_corner;
+layout(location = 1) in vec4 a_dst;
+layout(location = 2) in vec4 a_atlas;
+layout(location = 3) in vec4 a_color;
+uniform vec2 u_frame_size;
+uniform vec2 u_atlas_size;
+out vec2 v_uv;
+flat out float v_solid;
+out vec4 v_color;
+void main() {
+    vec2 size = a_corner * a_dst.zw;
+    vec2 pos = (a_dst.xy + size) / u_frame_size * 2.0 - 1.0;
+    gl_Position = vec4(pos.x, -pos.y, 0.0, 1.0);  // Frame rows go top-down
+    v_uv = (a_atlas.xy + size) / u_atlas_size;
+    v_solid = a_atlas.z == 0.0 ? 1.0 : 0.0;
+    v_color = a_color;
+}
+)";
+
+const char* kFragmentShader = R"(#version 300 es
+precision mediump float;
+uniform sampler2D u_atlas;
+in vec2 v_uv;
+flat in float v_solid;
+in vec4 v_color;
+out vec4 o_color;
+void main() {
+    float coverage = v_solid > 0.5 ? 1.0 : texture(u_atlas, v_uv).r;
+    float alpha = v_color.a * coverage;
+    o_color = vec4(v_color.rgb * alpha, alpha);
+}
+)";
+
+// Triangle strip of the unit square
+const GLfloat kCorners[] = {
+    0.0f, 0.0f,
+    1.0f, 0.0f,
+    0.0f, 1.0f,
+    1.0f, 1.0f,
+};
+
+}  // namespace
+
+GLESCompositorImpl::GLESCompositorImpl(Context& context) : log_(GetContextLogger(context)) {}
+
+GLESCompositorImpl::~GLESCompositorImpl() {
+    Release();
+}
+
+uint32_t GLESCompositorImpl::CompileShader(uint32_t type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char message[512] = {};
+        glGetShaderInfoLog(shader, sizeof(message), nullptr, message);
+        log_->e("GLESCompositor: Failed to compile shader: %s", message);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+bool GLESCompositorImpl::Initialize() {
+    Release();
+
+    GLuint vertex_shader = CompileShader(GL_VERTEX_SHADER, kVertexShader);
+    GLuint fragment_shader = CompileShader(GL_FRAGMENT_SHADER, kFragmentShader);
+    if (!vertex_shader || !fragment_shader) {
+        glDeleteShader(vertex_shader);
+        glDeleteShader(fragment_shader);
+        return false;
+    }
+
+    program_ = glCreateProgram();
+    glAttachShader(program_, vertex_shader);
+    glAttachShader(program_, fragment_shader);
+    glLinkProgram(program_);
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program_, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        char message[512] = {};
+        glGetProgramInfoLog(program_, sizeof(message), nullptr, message);
+        log_->e("GLESCompositor: Failed to link program: %s", message);
+        glDeleteProgram(program_);
+        program_ = 0;
+        return false;
+    }
+    frame_size_location_ = glGetUniformLocation(program_, "u_frame_size");
+    atlas_size_location_ = glGetUniformLocation(program_, "u_atlas_size");
+    atlas_location_ = glGetUniformLocation(program_, "u_atlas");
+
+    glGenVertexArrays(1, &vertex_array_);
+    glBindVertexArray(vertex_array_);
+
+    glGenBuffers(1, &corner_buffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, corner_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(kCorners), kCorners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+    glGenBuffers(1, &instance_buffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+    auto stride = static_cast<GLsizei>(sizeof(QuadInstance));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_SHORT, GL_FALSE, stride,
+                          reinterpret_cast<const void*>(offsetof(QuadInstance, dst)));
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_SHORT, GL_FALSE, stride,
+                          reinterpret_cast<const void*>(offsetof(QuadInstance, atlas)));
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                          reinterpret_cast<const void*>(offsetof(QuadInstance, color)));
+    glVertexAttribDivisor(3, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenTextures(1, &atlas_texture_);
+    glBindTexture(GL_TEXTURE_2D, atlas_texture_);
+    // Quads map atlas texels 1:1 onto the frame
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    initialized_ = true;
+    return true;
+}
+
+void GLESCompositorImpl::Release() {
+    if (!initialized_) {
+        return;
+    }
+
+    glDeleteTextures(1, &atlas_texture_);
+    glDeleteBuffers(1, &instance_buffer_);
+    glDeleteBuffers(1, &corner_buffer_);
+    glDeleteVertexArrays(1, &vertex_array_);
+    glDeleteProgram(program_);
+
+    atlas_texture_ = 0;
+    instance_buffer_ = 0;
+    instance_buffer_capacity_ = 0;
+    corner_buffer_ = 0;
+    vertex_array_ = 0;
+    program_ = 0;
+    atlas_uploaded_ = false;
+    initialized_ = false;
+}
+
+void GLESCompositorImpl::Upload(const GlyphAtlasRenderResult& result) {
+    assert(initialized_ && "GLESCompositor must be initialized first");
+    if (!initialized_ || !result.atlas_pixels) {
+        return;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, atlas_texture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (!atlas_uploaded_ ||
+            atlas_generation_ != result.atlas_generation ||
+            atlas_width_ != result.atlas_width ||
+            atlas_height_ != result.atlas_height) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, result.atlas_width, result.atlas_height, 0,
+                     GL_RED, GL_UNSIGNED_BYTE, result.atlas_pixels);
+        atlas_uploaded_ = true;
+        atlas_generation_ = result.atlas_generation;
+        atlas_width_ = result.atlas_width;
+        atlas_height_ = result.atlas_height;
+    } else if (!result.dirty_rects.empty()) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, result.atlas_width);
+        for (const AtlasRect& rect : result.dirty_rects) {
+            glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.x);
+            glPixelStorei(GL_UNPACK_SKIP_ROWS, rect.y);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height,
+                            GL_RED, GL_UNSIGNED_BYTE, result.atlas_pixels);
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GLESCompositorImpl::Draw(const GlyphAtlasRenderResult& result,
+                              uint32_t framebuffer,
+                              int frame_width,
+                              int frame_height) {
+    assert(initialized_ && "GLESCompositor must be initialized first");
+    if (!initialized_ || result.quads.empty() || !atlas_uploaded_ || frame_width <= 0 || frame_height <= 0) {
+        return;
+    }
+
+    instances_.resize(result.quads.size());
+    for (size_t i = 0; i < result.quads.size(); i++) {
+        const GlyphQuad& quad = result.quads[i];
+        QuadInstance& instance = instances_[i];
+        instance.dst[0] = static_cast<int16_t>(quad.dst_x);
+        instance.dst[1] = static_cast<int16_t>(quad.dst_y);
+        instance.dst[2] = static_cast<int16_t>(quad.width);
+        instance.dst[3] = static_cast<int16_t>(quad.height);
+        instance.atlas[0] = static_cast<uint16_t>(quad.atlas_x);
+        instance.atlas[1] = static_cast<uint16_t>(quad.atlas_y);
+        instance.atlas[2] = static_cast<uint16_t>(quad.type);
+        instance.atlas[3] = 0;
+        instance.color[0] = quad.color.r;
+        instance.color[1] = quad.color.g;
+        instance.color[2] = quad.color.b;
+        instance.color[3] = quad.color.a;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+    auto bytes = static_cast<GLsizeiptr>(instances_.size() * sizeof(QuadInstance));
+    if (instances_.size() > instance_buffer_capacity_) {
+        glBufferData(GL_ARRAY_BUFFER, bytes, instances_.data(), GL_STREAM_DRAW);
+        instance_buffer_capacity_ = instances_.size();
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, instances_.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, frame_width, frame_height);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    glUseProgram(program_);
+    glUniform2f(frame_size_location_, static_cast<GLfloat>(frame_width), static_cast<GLfloat>(frame_height));
+    glUniform2f(atlas_size_location_, static_cast<GLfloat>(atlas_width_), static_cast<GLfloat>(atlas_height_));
+    glUniform1i(atlas_location_, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, atlas_texture_);
+
+    glBindVertexArray(vertex_array_);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(instances_.size()));
+    glBindVertexArray(0);
+}
+
+RenderStatus GLESCompositorImpl::Render(Renderer& renderer,
+                                        int64_t pts,
+                                        uint32_t framebuffer,
+                                        int frame_width,
+                                        int frame_height) {
+    RenderStatus status = renderer.RenderGlyphAtlas(pts, result_);
+    Upload(result_);  // Dirty areas must be taken even if nothing is drawn
+    if (status == RenderStatus::kGotImage || status == RenderStatus::kGotImageUnchanged) {
+        Draw(result_, framebuffer, frame_width, frame_height);
+    }
+    return status;
+}
+
+}  // namespace aribcaption::internal
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ARIBCAPTION_GLES_COMPOSITOR_IMPL_HPP
+#define ARIBCAPTION_GLES_COMPOSITOR_IMPL_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/gles_compositor.hpp"
+#include "aribcaption/renderer.hpp"
+#include "base/logger.hpp"
+
+namespace aribcaption::internal {
+
+class GLESCompositorImpl {
+public:
+    explicit GLESCompositorImpl(Context& context);
+    ~GLESCompositorImpl();
+public:
+    bool Initialize();
+    void Release();
+    void Upload(const GlyphAtlasRenderResult& result);
+    void Draw(const GlyphAtlasRenderResult& result, uint32_t framebuffer, int frame_width, int frame_height);
+    RenderStatus Render(Renderer& renderer, int64_t pts, uint32_t framebuffer, int frame_width, int frame_height);
+private:
+    // Per-instance vertex attributes of a quad
+    struct QuadInstance {
+        int16_t dst[4];      // x, y, width, height
+        uint16_t atlas[4];   // x, y, GlyphQuadType, unused
+        uint8_t color[4];    // RGBA
+    };
+
+    uint32_t CompileShader(uint32_t type, const char* source);
+private:
+    std::shared_ptr<Logger> log_;
+
+    bool initialized_ = false;
+    uint32_t program_ = 0;
+    int32_t frame_size_location_ = -1;
+    int32_t atlas_size_location_ = -1;
+    int32_t atlas_location_ = -1;
+    uint32_t vertex_array_ = 0;
+    uint32_t corner_buffer_ = 0;
+    uint32_t instance_buffer_ = 0;
+    size_t instance_buffer_capacity_ = 0;  // in quads
+    uint32_t atlas_texture_ = 0;
+
+    // Atlas currently held by atlas_texture_
+    bool atlas_uploaded_ = false;
+    uint32_t atlas_generation_ = 0;
+    int atlas_width_ = 0;
+    int atlas_height_ = 0;
+
+    std::vector<QuadInstance> instances_;
+    GlyphAtlasRenderResult result_;  // Reused by Render()
+};
+
+}  // namespace aribcaption::internal
+
+#endif  // ARIBCAPTION_GLES_COMPOSITOR_IMPL_HPP
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "renderer/glyph_atlas.hpp"
+
+namespace aribcaption {
+
+GlyphAtlas::GlyphAtlas() {
+    SetSize(kDefaultSize, kDefaultSize);
+}
+
+void GlyphAtlas::SetSize(int width, int height) {
+    assert(width > 0 && height > 0);
+    width_ = width;
+    height_ = height;
+    pixels_.clear();  // Allocated on first use
+    Reset();
+}
+
+void GlyphAtlas::Reset() {
+    placements_.clear();
+    dirty_rects_.clear();
+    shelf_x_ = 0;
+    shelf_y_ = 0;
+    shelf_height_ = 0;
+    generation_++;
+
+    if (!pixels_.empty()) {
+        memset(pixels_.data(), 0, pixels_.size());
+    }
+}
+
+void GlyphAtlas::Release() {
+    pixels_ = std::vector<uint8_t>();
+    Reset();
+}
+
+auto GlyphAtlas::Insert(const GlyphAtlasKey& key, const GlyphMask& mask) -> std::optional<Rect> {
+    auto iter = placements_.find(key);
+    if (iter != placements_.end()) {
+        return iter->second;
+    }
+
+    int w = mask.width + kPadding;
+    int h = mask.height + kPadding;
+
+    if (shelf_x_ + w > width_) {
+        // Open a new shelf
+        shelf_y_ += shelf_height_;
+        shelf_x_ = 0;
+        shelf_height_ = 0;
+    }
+    if (w > width_ || shelf_y_ + h > height_) {
+        return std::nullopt;
+    }
+
+    if (pixels_.empty()) {
+        pixels_.resize(static_cast<size_t>(width_) * height_);
+    }
+
+    Rect rect(shelf_x_, shelf_y_, shelf_x_ + mask.width, shelf_y_ + mask.height);
+
+    for (int y = 0; y < mask.height; y++) {
+        uint8_t* dest = &pixels_[static_cast<size_t>(rect.top + y) * width_ + rect.left];
+        memcpy(dest, &mask.coverage[static_cast<size_t>(y) * mask.width], mask.width);
+    }
+
+    shelf_x_ += w;
+    shelf_height_ = std::max(shelf_height_, h);
+
+    placements_.emplace(key, rect);
+    dirty_rects_.push_back(rect);
+    return rect;
+}
+
+auto GlyphAtlas::TakeDirtyRects() -> std::vector<Rect> {
+    std::vector<Rect> rects = std::move(dirty_rects_);
+    dirty_rects_.clear();
+    return rects;
+}
+
+}  // namespace aribcaption
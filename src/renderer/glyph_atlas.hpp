@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_GLYPH_ATLAS_HPP
+#define ARIBCAPTION_GLYPH_ATLAS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "renderer/glyph_cache.hpp"
+#include "renderer/rect.hpp"
+
+namespace aribcaption {
+
+enum class GlyphAtlasKeyType : uint8_t {
+    kGlyphFill,
+    kGlyphBorder,
+    kDRCSFill,
+    kDRCSBorder,
+};
+
+// Identifies the content of a mask placed in the atlas, compared in full on lookup
+struct GlyphAtlasKey {
+    GlyphAtlasKeyType type = GlyphAtlasKeyType::kGlyphFill;
+    // Parameters the mask was produced with. For DRCS, only the target size and stroke are used.
+    GlyphCacheKey glyph;
+    std::string drcs;  // MD5 digest, or pixels if unavailable, of the DRCS pattern
+    int drcs_width = 0;
+    int drcs_height = 0;
+    int drcs_depth = 0;
+    uint8_t drcs_scale_filter = 0;  // DRCSScaleFilter the pattern was scaled with
+
+    bool operator==(const GlyphAtlasKey& rhs) const {
+        return type == rhs.type && glyph == rhs.glyph && drcs == rhs.drcs &&
+               drcs_width == rhs.drcs_width && drcs_height == rhs.drcs_height && drcs_depth == rhs.drcs_depth &&
+               drcs_scale_filter == rhs.drcs_scale_filter;
+    }
+};
+
+struct GlyphAtlasKeyHash {
+    size_t operator()(const GlyphAtlasKey& key) const noexcept {
+        size_t h = GlyphCacheKeyHash{}(key.glyph);
+        h ^= std::hash<std::string_view>{}(key.drcs) + 0x9E3779B9u + (h << 6) + (h >> 2);
+        h ^= static_cast<size_t>(key.drcs_width * 31 + key.drcs_height) + 0x9E3779B9u + (h << 6) + (h >> 2);
+        h ^= (static_cast<size_t>(key.type) << 8 | key.drcs_scale_filter) + 0x9E3779B9u + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+
+// Persistent 8-bit coverage texture, glyphs are packed into shelves and never moved until reset
+class GlyphAtlas {
+public:
+    static constexpr int kDefaultSize = 1024;
+    static constexpr int kPadding = 1;  // Gap between glyphs for avoiding bleeding on texture filtering
+public:
+    GlyphAtlas();
+    ~GlyphAtlas() = default;
+public:
+    void SetSize(int width, int height);
+    void Reset();
+    // Reset and free the pixels, which are allocated again on next use
+    void Release();
+
+    // Look up or pack the mask, returns std::nullopt if the atlas is full
+    auto Insert(const GlyphAtlasKey& key, const GlyphMask& mask) -> std::optional<Rect>;
+
+    // Areas updated since the previous call
+    auto TakeDirtyRects() -> std::vector<Rect>;
+
+    [[nodiscard]]
+    int width() const { return width_; }
+
+    [[nodiscard]]
+    int height() const { return height_; }
+
+    [[nodiscard]]
+    const uint8_t* data() const { return pixels_.data(); }
+
+    [[nodiscard]]
+    size_t memory_bytes() const { return pixels_.capacity(); }
+
+    // Increased on every reset, all previous placement becomes invalid
+    [[nodiscard]]
+    uint32_t generation() const { return generation_; }
+public:
+    GlyphAtlas(const GlyphAtlas&) = delete;
+    GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+private:
+    int width_ = 0;
+    int height_ = 0;
+    uint32_t generation_ = 0;
+
+    int shelf_x_ = 0;
+    int shelf_y_ = 0;
+    int shelf_height_ = 0;
+
+    std::vector<uint8_t> pixels_;
+    std::unordered_map<GlyphAtlasKey, Rect, GlyphAtlasKeyHash> placements_;
+    std::vector<Rect> dirty_rects_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_GLYPH_ATLAS_HPP
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "renderer/glyph_cache.hpp"
+
+namespace aribcaption {
+
+void GlyphCache::SetLimit(size_t limit_bytes) {
+    limit_bytes_ = limit_bytes;
+    EvictIfNecessary();
+}
+
+auto GlyphCache::Get(const GlyphCacheKey& key) -> std::shared_ptr<const CachedGlyph> {
+    auto iter = map_.find(key);
+    if (iter == map_.end()) {
+        misses_++;
+        return nullptr;
+    }
+
+    hits_++;
+    lru_.splice(lru_.begin(), lru_, iter->second);
+    return iter->second->glyph;
+}
+
+void GlyphCache::Put(const GlyphCacheKey& key, std::shared_ptr<const CachedGlyph> glyph) {
+    size_t bytes = EstimateBytes(*glyph);
+    if (bytes > limit_bytes_) {
+        return;  // Never fits, don't bother
+    }
+
+    auto iter = map_.find(key);
+    if (iter != map_.end()) {
+        used_bytes_ -= iter->second->bytes;
+        lru_.erase(iter->second);
+        map_.erase(iter);
+    }
+
+    lru_.push_front(Entry{key, std::move(glyph), bytes});
+    map_.emplace(key, lru_.begin());
+    used_bytes_ += bytes;
+
+    EvictIfNecessary();
+}
+
+void GlyphCache::Clear() {
+    map_.clear();
+    lru_.clear();
+    used_bytes_ = 0;
+}
+
+void GlyphCache::CopyFrom(const GlyphCache& other) {
+    if (&other == this) {
+        return;
+    }
+    Clear();
+
+    // Least recently used first, so that the recency order survives and eviction drops the oldest
+    for (auto iter = other.lru_.rbegin(); iter != other.lru_.rend(); ++iter) {
+        Put(iter->key, iter->glyph);
+    }
+}
+
+GlyphCacheStats GlyphCache::GetStats() const {
+    GlyphCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.entry_count = map_.size();
+    stats.used_bytes = used_bytes_;
+    stats.limit_bytes = limit_bytes_;
+    return stats;
+}
+
+size_t GlyphCache::EstimateBytes(const CachedGlyph& glyph) {
+    // Account for the list node, hash node and the glyph object itself
+    size_t bytes = sizeof(Entry) + sizeof(GlyphCacheKey) + sizeof(void*) * 4 + sizeof(CachedGlyph);
+    bytes += glyph.fill.coverage.capacity();
+    if (glyph.border) {
+        bytes += glyph.border->coverage.capacity();
+    }
+    return bytes;
+}
+
+void GlyphCache::EvictIfNecessary() {
+    while (used_bytes_ > limit_bytes_ && !lru_.empty()) {
+        Entry& last = lru_.back();
+        used_bytes_ -= last.bytes;
+        map_.erase(last.key);
+        lru_.pop_back();
+    }
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_GLYPH_CACHE_HPP
+#define ARIBCAPTION_GLYPH_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "aribcaption/renderer.hpp"
+
+namespace aribcaption {
+
+// 8-bit coverage mask of a rasterized glyph, relative to the pen origin on the baseline
+struct GlyphMask {
+    int left = 0;
+    int top = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> coverage;  // width * height, tightly packed
+};
+
+struct CachedGlyph {
+    // Size metrics of the face at rasterized pixel size, in pixels
+    int ascender = 0;
+    int descender = 0;
+    int underline_position = 0;
+    int underline_thickness = 0;
+
+    GlyphMask fill;
+    std::optional<GlyphMask> border;
+};
+
+struct GlyphCacheKey {
+    uint32_t face_id = 0;
+    uint32_t glyph_index = 0;
+    int pixel_width = 0;
+    int pixel_height = 0;
+    int32_t stroke_width = 0;  // 26.6 fixed point, 0 if not stroked
+    uint8_t stroke_mode = 0;   // StrokeMode used for generating the border, 0 if not stroked
+    uint8_t hinting = 0;       // TextHinting of the outline, 0 for distance fields
+    bool distance_field = false;  // Produced from (or being) a distance field, see ComputeDistanceField()
+
+    bool operator==(const GlyphCacheKey& rhs) const {
+        return face_id == rhs.face_id &&
+               glyph_index == rhs.glyph_index &&
+               pixel_width == rhs.pixel_width &&
+               pixel_height == rhs.pixel_height &&
+               stroke_width == rhs.stroke_width &&
+               stroke_mode == rhs.stroke_mode &&
+               hinting == rhs.hinting &&
+               distance_field == rhs.distance_field;
+    }
+};
+
+struct GlyphCacheKeyHash {
+    size_t operator()(const GlyphCacheKey& key) const noexcept {
+        // Fields are mixed in one after another, so that they can't cancel each other out
+        auto mix = [](uint64_t h, uint64_t value) {
+            h = (h ^ value) * 0x9E3779B97F4A7C15ull;
+            return h ^ (h >> 32);
+        };
+        uint64_t h = mix(0, (static_cast<uint64_t>(key.face_id) << 32) | key.glyph_index);
+        h = mix(h, (static_cast<uint64_t>(static_cast<uint32_t>(key.pixel_width)) << 32) |
+                   static_cast<uint32_t>(key.pixel_height));
+        h = mix(h, (static_cast<uint64_t>(static_cast<uint32_t>(key.stroke_width)) << 32) |
+                   (static_cast<uint64_t>(key.stroke_mode) << 16) |
+                   (static_cast<uint64_t>(key.hinting) << 8) |
+                   static_cast<uint64_t>(key.distance_field));
+        return static_cast<size_t>(h);
+    }
+};
+
+// Bounded LRU cache for rasterized glyph masks, limited by total bytes
+class GlyphCache {
+public:
+    static constexpr size_t kDefaultLimitBytes = 4 * 1024 * 1024;
+public:
+    GlyphCache() = default;
+    ~GlyphCache() = default;
+public:
+    void SetLimit(size_t limit_bytes);
+    [[nodiscard]]
+    auto Get(const GlyphCacheKey& key) -> std::shared_ptr<const CachedGlyph>;
+    void Put(const GlyphCacheKey& key, std::shared_ptr<const CachedGlyph> glyph);
+    void Clear();
+    // Replace the content with the entries of other, sharing the glyphs. Our own limit is kept
+    void CopyFrom(const GlyphCache& other);
+    [[nodiscard]]
+    GlyphCacheStats GetStats() const;
+public:
+    GlyphCache(const GlyphCache&) = delete;
+    GlyphCache& operator=(const GlyphCache&) = delete;
+private:
+    static size_t EstimateBytes(const CachedGlyph& glyph);
+    void EvictIfNecessary();
+private:
+    struct Entry {
+        GlyphCacheKey key;
+        std::shared_ptr<const CachedGlyph> glyph;
+        size_t bytes = 0;
+    };
+
+    size_t limit_bytes_ = kDefaultLimitBytes;
+    size_t used_bytes_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+
+    // Most recently used entries at front
+    std::list<Entry> lru_;
+    std::unordered_map<GlyphCacheKey, std::list<Entry>::iterator, GlyphCacheKeyHash> map_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_GLYPH_CACHE_HPP
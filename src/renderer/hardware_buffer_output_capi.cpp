@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <cstring>
+#include <memory>
+#include <new>
+#include "aribcaption/hardware_buffer_output.h"
+#include "aribcaption/hardware_buffer_output.hpp"
+#include "renderer/hardware_buffer_output_impl.hpp"
+#include "renderer/renderer_impl.hpp"
+
+using namespace aribcaption;
+using namespace aribcaption::internal;
+
+extern "C" {
+
+void aribcc_hardware_buffer_render_result_cleanup(aribcc_hardware_buffer_render_result_t* render_result) {
+    if (render_result->images) {
+        for (uint32_t i = 0; i < render_result->image_count; i++) {
+            delete static_cast<std::shared_ptr<AHardwareBuffer>*>(render_result->images[i].priv);
+        }
+        delete[] render_result->images;
+        render_result->images = nullptr;
+        render_result->image_count = 0;
+    }
+}
+
+aribcc_hardware_buffer_output_t* aribcc_hardware_buffer_output_alloc(aribcc_context_t* context) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    auto impl = new(std::nothrow) HardwareBufferOutputImpl(*ctx);
+    return reinterpret_cast<aribcc_hardware_buffer_output_t*>(impl);
+}
+
+void aribcc_hardware_buffer_output_free(aribcc_hardware_buffer_output_t* output) {
+    auto impl = reinterpret_cast<HardwareBufferOutputImpl*>(output);
+    delete impl;
+}
+
+aribcc_render_status_t aribcc_hardware_buffer_output_render(aribcc_hardware_buffer_output_t* output,
+                                                            aribcc_renderer_t* renderer,
+                                                            int64_t pts,
+                                                            aribcc_hardware_buffer_render_result_t* out_result) {
+    auto impl = reinterpret_cast<HardwareBufferOutputImpl*>(output);
+    auto renderer_impl = reinterpret_cast<RendererImpl*>(renderer);
+
+    HardwareBufferRenderResult result;
+    RenderStatus status = impl->Render(*renderer_impl, pts, result);
+    if (status == RenderStatus::kNotReady) {
+        return static_cast<aribcc_render_status_t>(status);
+    }
+
+    memset(out_result, 0, sizeof(*out_result));
+    out_result->pts = result.pts;
+    out_result->duration = result.duration;
+
+    if (result.images.empty()) {
+        return static_cast<aribcc_render_status_t>(status);
+    }
+
+    out_result->images = new(std::nothrow) aribcc_hardware_buffer_image_t[result.images.size()];
+    if (!out_result->images) {
+        return ARIBCC_RENDER_STATUS_ERROR;
+    }
+
+    for (size_t i = 0; i < result.images.size(); i++) {
+        HardwareBufferImage& image = result.images[i];
+        aribcc_hardware_buffer_image_t& capi_image = out_result->images[i];
+        capi_image.hardware_buffer = image.hardware_buffer.get();
+        capi_image.width = image.width;
+        capi_image.height = image.height;
+        capi_image.dst_x = image.dst_x;
+        capi_image.dst_y = image.dst_y;
+        capi_image.display_width = image.display_width;
+        capi_image.display_height = image.display_height;
+        capi_image.pixel_format = static_cast<aribcc_pixelformat_t>(image.pixel_format);
+        capi_image.priv = new(std::nothrow) std::shared_ptr<AHardwareBuffer>(std::move(image.hardware_buffer));
+        if (!capi_image.priv) {
+            capi_image.hardware_buffer = nullptr;  // The buffer goes back to the pool along with result
+        }
+    }
+    out_result->image_count = static_cast<uint32_t>(result.images.size());
+
+    return static_cast<aribcc_render_status_t>(status);
+}
+
+void aribcc_hardware_buffer_output_flush(aribcc_hardware_buffer_output_t* output) {
+    auto impl = reinterpret_cast<HardwareBufferOutputImpl*>(output);
+    impl->Flush();
+}
+
+}  // extern "C"
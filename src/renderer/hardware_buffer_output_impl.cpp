@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <cstring>
+#include "renderer/hardware_buffer_output_impl.hpp"
+
+namespace aribcaption::internal {
+
+static constexpr uint64_t kBufferUsage = AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN |
+                                         AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE;
+
+static uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static PixelFormat ToRGBAFormat(PixelFormat format) {
+    return (format == PixelFormat::kRGBA8888Premultiplied || format == PixelFormat::kBGRA8888Premultiplied)
+           ? PixelFormat::kRGBA8888Premultiplied
+           : PixelFormat::kRGBA8888;
+}
+
+HardwareBufferOutputImpl::BufferPool::~BufferPool() {
+    Clear();
+}
+
+std::shared_ptr<AHardwareBuffer> HardwareBufferOutputImpl::BufferPool::Acquire(uint32_t width,
+                                                                               uint32_t height,
+                                                                               Logger& log) {
+    uint32_t buffer_width = AlignUp(width, kSizeGranularity);
+    uint32_t buffer_height = AlignUp(height, kSizeGranularity);
+    AHardwareBuffer* buffer = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto iter = free_buffers_.rbegin(); iter != free_buffers_.rend(); ++iter) {
+            AHardwareBuffer_Desc desc{};
+            AHardwareBuffer_describe(*iter, &desc);
+            if (desc.width == buffer_width && desc.height == buffer_height) {
+                buffer = *iter;
+                free_buffers_.erase(std::next(iter).base());
+                break;
+            }
+        }
+    }
+
+    if (!buffer) {
+        AHardwareBuffer_Desc desc{};
+        desc.width = buffer_width;
+        desc.height = buffer_height;
+        desc.layers = 1;
+        desc.format = AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM;
+        desc.usage = kBufferUsage;
+        if (int ret = AHardwareBuffer_allocate(&desc, &buffer); ret != 0 || !buffer) {
+            log.e("HardwareBufferOutput: AHardwareBuffer_allocate() failed for %ux%u, error %d",
+                  buffer_width, buffer_height, ret);
+            return nullptr;
+        }
+    }
+
+    std::weak_ptr<BufferPool> weak_pool = weak_from_this();
+    return std::shared_ptr<AHardwareBuffer>(buffer, [weak_pool](AHardwareBuffer* buffer) {
+        if (std::shared_ptr<BufferPool> pool = weak_pool.lock()) {
+            pool->Recycle(buffer);
+        } else {
+            AHardwareBuffer_release(buffer);
+        }
+    });
+}
+
+void HardwareBufferOutputImpl::BufferPool::Recycle(AHardwareBuffer* buffer) {
+    AHardwareBuffer* evicted = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_buffers_.push_back(buffer);
+        if (free_buffers_.size() > kMaxFreeBuffers) {
+            evicted = free_buffers_.front();
+            free_buffers_.erase(free_buffers_.begin());
+        }
+    }
+    if (evicted) {
+        AHardwareBuffer_release(evicted);
+    }
+}
+
+void HardwareBufferOutputImpl::BufferPool::Clear() {
+    std::vector<AHardwareBuffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers.swap(free_buffers_);
+    }
+    for (AHardwareBuffer* buffer : buffers) {
+        AHardwareBuffer_release(buffer);
+    }
+}
+
+HardwareBufferOutputImpl::HardwareBufferOutputImpl(Context& context)
+    : log_(GetContextLogger(context)), pool_(std::make_shared<BufferPool>()) {}
+
+HardwareBufferOutputImpl::~HardwareBufferOutputImpl() = default;
+
+void HardwareBufferOutputImpl::Flush() {
+    previous_.clear();
+    pool_->Clear();
+}
+
+RenderStatus HardwareBufferOutputImpl::Write(RenderStatus status, HardwareBufferRenderResult& out_result) {
+    if (status == RenderStatus::kNotReady) {
+        return status;
+    } else if (status == RenderStatus::kError || status == RenderStatus::kNoImage) {
+        out_result.images.clear();
+        previous_.clear();
+        return status;
+    }
+
+    out_result.pts = result_.pts;
+    out_result.duration = result_.duration;
+
+    if (status == RenderStatus::kGotImageUnchanged && previous_.size() == result_.images.size()) {
+        out_result.images = previous_;
+        return status;
+    }
+
+    std::vector<HardwareBufferImage> images(result_.images.size());
+    for (size_t i = 0; i < result_.images.size(); i++) {
+        const Image& image = result_.images[i];
+        bool unchanged = i < result_.image_changed.size() && !result_.image_changed[i];
+        const HardwareBufferImage* previous = unchanged ? FindPreviousImage(image) : nullptr;
+        if (previous) {
+            images[i] = *previous;
+        } else if (!WriteImage(image, images[i])) {
+            out_result.images.clear();
+            previous_.clear();
+            return RenderStatus::kError;
+        }
+    }
+
+    previous_ = images;
+    out_result.images = std::move(images);
+    return status;
+}
+
+const HardwareBufferImage* HardwareBufferOutputImpl::FindPreviousImage(const Image& image) const {
+    for (const HardwareBufferImage& previous : previous_) {
+        if (previous.dst_x == image.dst_x && previous.dst_y == image.dst_y &&
+                previous.width == image.width && previous.height == image.height &&
+                previous.display_width == image.display_width && previous.display_height == image.display_height &&
+                previous.pixel_format == ToRGBAFormat(image.pixel_format)) {
+            return &previous;
+        }
+    }
+    return nullptr;
+}
+
+bool HardwareBufferOutputImpl::WriteImage(const Image& image, HardwareBufferImage& out_image) {
+    if (image.pixel_format == PixelFormat::kIndexed8 || !image.spans.empty()) {
+        log_->e("HardwareBufferOutput: Indexed or run-length encoded images are not supported");
+        return false;
+    }
+
+    std::shared_ptr<AHardwareBuffer> buffer = pool_->Acquire(static_cast<uint32_t>(image.width),
+                                                             static_cast<uint32_t>(image.height),
+                                                             *log_);
+    if (!buffer) {
+        return false;
+    }
+
+    AHardwareBuffer_Desc desc{};
+    AHardwareBuffer_describe(buffer.get(), &desc);
+    void* address = nullptr;
+    if (int ret = AHardwareBuffer_lock(buffer.get(), AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN, -1, nullptr, &address);
+            ret != 0 || !address) {
+        log_->e("HardwareBufferOutput: AHardwareBuffer_lock() failed, error %d", ret);
+        return false;
+    }
+
+    auto dst = static_cast<uint8_t*>(address);
+    size_t dst_stride = static_cast<size_t>(desc.stride) * 4;  // desc.stride is in pixels
+    const uint8_t* src = image.data();
+    bool swizzle = image.pixel_format == PixelFormat::kBGRA8888 ||
+                   image.pixel_format == PixelFormat::kBGRA8888Premultiplied;
+    size_t line_bytes = static_cast<size_t>(image.width) * 4;
+
+    for (int y = 0; y < image.height; y++) {
+        const uint8_t* src_line = src + static_cast<size_t>(y) * image.stride;
+        uint8_t* dst_line = dst + static_cast<size_t>(y) * dst_stride;
+        if (!swizzle) {
+            memcpy(dst_line, src_line, line_bytes);
+            continue;
+        }
+        for (size_t x = 0; x < line_bytes; x += 4) {
+            dst_line[x + 0] = src_line[x + 2];
+            dst_line[x + 1] = src_line[x + 1];
+            dst_line[x + 2] = src_line[x + 0];
+            dst_line[x + 3] = src_line[x + 3];
+        }
+    }
+
+    // Unlocking makes CPU writes visible to the GPU, no fence is requested since it's a synchronous unlock
+    AHardwareBuffer_unlock(buffer.get(), nullptr);
+
+    out_image.hardware_buffer = std::move(buffer);
+    out_image.width = image.width;
+    out_image.height = image.height;
+    out_image.dst_x = image.dst_x;
+    out_image.dst_y = image.dst_y;
+    out_image.display_width = image.display_width;
+    out_image.display_height = image.display_height;
+    out_image.pixel_format = ToRGBAFormat(image.pixel_format);
+    return true;
+}
+
+}  // namespace aribcaption::internal
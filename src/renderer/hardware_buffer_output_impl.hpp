@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ARIBCAPTION_HARDWARE_BUFFER_OUTPUT_IMPL_HPP
+#define ARIBCAPTION_HARDWARE_BUFFER_OUTPUT_IMPL_HPP
+
+#include <android/hardware_buffer.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/hardware_buffer_output.hpp"
+#include "aribcaption/renderer.hpp"
+#include "base/logger.hpp"
+
+namespace aribcaption::internal {
+
+class HardwareBufferOutputImpl {
+public:
+    // Buffer sizes are rounded up to multiples of this, so that similar sized images share buffers
+    static constexpr uint32_t kSizeGranularity = 64;
+    static constexpr size_t kMaxFreeBuffers = 16;
+public:
+    explicit HardwareBufferOutputImpl(Context& context);
+    ~HardwareBufferOutputImpl();
+public:
+    // Works with both Renderer and RendererImpl, the latter is used by the C API
+    template <typename RendererType>
+    RenderStatus Render(RendererType& renderer, int64_t pts, HardwareBufferRenderResult& out_result) {
+        return Write(renderer.Render(pts, result_), out_result);
+    }
+    void Flush();
+private:
+    // Free buffers, shared with the deleters of handed out buffers which may run on other threads
+    class BufferPool : public std::enable_shared_from_this<BufferPool> {
+    public:
+        BufferPool() = default;
+        ~BufferPool();
+    public:
+        std::shared_ptr<AHardwareBuffer> Acquire(uint32_t width, uint32_t height, Logger& log);
+        void Clear();
+    private:
+        void Recycle(AHardwareBuffer* buffer);
+    private:
+        std::mutex mutex_;
+        std::vector<AHardwareBuffer*> free_buffers_;  // least recently recycled first
+    };
+
+    RenderStatus Write(RenderStatus status, HardwareBufferRenderResult& out_result);
+    bool WriteImage(const Image& image, HardwareBufferImage& out_image);
+    const HardwareBufferImage* FindPreviousImage(const Image& image) const;
+private:
+    std::shared_ptr<Logger> log_;
+    std::shared_ptr<BufferPool> pool_;
+
+    RenderResult result_;                        // Reused by Render()
+    std::vector<HardwareBufferImage> previous_;  // Images handed out by the previous Render()
+};
+
+}  // namespace aribcaption::internal
+
+#endif  // ARIBCAPTION_HARDWARE_BUFFER_OUTPUT_IMPL_HPP
@@ -16,8 +16,9 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-#include "aribcaption/aligned_alloc.hpp"
 #include "aribcaption/image.h"
+#include "base/memory_allocator.hpp"
+#include "renderer/bitmap_pool.hpp"
 
 using namespace aribcaption;
 
@@ -25,10 +26,21 @@ extern "C" {
 
 void aribcc_image_cleanup(aribcc_image_t* image) {
     if (image->bitmap) {
-        AlignedFree(image->bitmap);
+        // Goes back to the renderer's pool, or freed if the renderer has gone
+        BitmapPool::ReleaseCAPIBuffer(image->bitmap);
         image->bitmap = nullptr;
         image->bitmap_size = 0;
     }
+    if (image->palette) {
+        MemoryAllocator::Free(image->palette);
+        image->palette = nullptr;
+        image->palette_size = 0;
+    }
+    if (image->spans) {
+        MemoryAllocator::Free(image->spans);
+        image->spans = nullptr;
+        image->span_count = 0;
+    }
 }
 
 }  // extern "C"
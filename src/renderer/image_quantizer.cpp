@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "base/always_inline.hpp"
+#include "renderer/bitmap_pool.hpp"
+#include "renderer/image_quantizer.hpp"
+
+namespace aribcaption {
+
+namespace {
+
+constexpr size_t kMaxPaletteEntries = 256;
+
+struct ColorEntry {
+    uint32_t count = 0;
+    uint8_t index = 0;
+};
+
+// Fully transparent pixels are folded into a single color, which always takes index 0
+ALWAYS_INLINE uint32_t NormalizedColor(ColorRGBA color) {
+    return color.a ? color.u32 : 0;
+}
+
+// Keep the high bits of each component
+ALWAYS_INLINE uint32_t ReduceColor(uint32_t color, int bits) {
+    uint32_t component_mask = (0xFFu << (8 - bits)) & 0xFFu;
+    return color & (component_mask * 0x01010101u);
+}
+
+template <typename Func>
+void ForEachPixel(const Image& image, Func&& func) {
+    const uint8_t* data = image.data();
+    for (int y = 0; y < image.height; y++) {
+        auto line = reinterpret_cast<const ColorRGBA*>(data + static_cast<size_t>(y) * image.stride);
+        for (int x = 0; x < image.width; x++) {
+            func(x, y, line[x]);
+        }
+    }
+}
+
+}  // namespace
+
+void ConvertImageToIndexed8(Image& image, BitmapPool* pool) {
+    assert(image.pixel_format == PixelFormat::kRGBA8888);
+
+    // Histogram of distinct colors, neighbouring pixels are mostly the same.
+    // Palette entries are assigned in order of first appearance, so that the output is deterministic.
+    std::unordered_map<uint32_t, ColorEntry> histogram;
+    std::vector<uint32_t> colors;
+    uint32_t last_color = 0;
+    ColorEntry* last_entry = &histogram[0];
+    ForEachPixel(image, [&](int, int, ColorRGBA pixel) {
+        uint32_t color = NormalizedColor(pixel);
+        if (color != last_color) {
+            last_color = color;
+            auto [iter, inserted] = histogram.try_emplace(color);
+            if (inserted) {
+                colors.push_back(color);
+            }
+            last_entry = &iter->second;
+        }
+        last_entry->count++;
+    });
+
+    image.palette.clear();
+    image.palette.emplace_back(0, 0, 0, 0);
+
+    if (histogram.size() <= kMaxPaletteEntries) {
+        for (uint32_t color : colors) {
+            histogram[color].index = static_cast<uint8_t>(image.palette.size());
+            image.palette.emplace_back(color);
+        }
+    } else {
+        // Merge colors by reducing precision until they fit, average each bucket weighted by coverage
+        struct Bucket {
+            uint64_t r = 0, g = 0, b = 0;
+            uint64_t weight = 0;
+            uint64_t count = 0;
+            uint8_t index = 0;
+        };
+        std::unordered_map<uint32_t, Bucket> buckets;
+        int bits = 7;
+        for (; bits > 1; bits--) {
+            buckets.clear();
+            for (uint32_t color : colors) {
+                buckets[ReduceColor(color, bits)];
+            }
+            if (buckets.size() < kMaxPaletteEntries) {
+                break;
+            }
+        }
+
+        std::vector<uint32_t> reduced_colors;
+        for (uint32_t color : colors) {
+            ColorRGBA c(color);
+            Bucket& bucket = buckets[ReduceColor(color, bits)];
+            if (bucket.count == 0) {
+                reduced_colors.push_back(ReduceColor(color, bits));
+            }
+            uint64_t weight = static_cast<uint64_t>(c.a) * histogram[color].count;
+            bucket.r += c.r * weight;
+            bucket.g += c.g * weight;
+            bucket.b += c.b * weight;
+            bucket.weight += weight;
+            bucket.count += histogram[color].count;
+        }
+
+        for (uint32_t reduced : reduced_colors) {
+            Bucket& bucket = buckets[reduced];
+            bucket.index = static_cast<uint8_t>(image.palette.size());
+            uint64_t half = bucket.weight / 2;
+            image.palette.emplace_back(static_cast<uint8_t>((bucket.r + half) / bucket.weight),
+                                       static_cast<uint8_t>((bucket.g + half) / bucket.weight),
+                                       static_cast<uint8_t>((bucket.b + half) / bucket.weight),
+                                       static_cast<uint8_t>((bucket.weight + bucket.count / 2) / bucket.count));
+        }
+
+        for (uint32_t color : colors) {
+            histogram[color].index = buckets[ReduceColor(color, bits)].index;
+        }
+    }
+
+    int stride = image.width;
+    int row_alignment = static_cast<int>(pool ? pool->row_alignment() : Image::kAlignedTo);
+    if (int remainder = stride % row_alignment) {
+        stride += row_alignment - remainder;
+    }
+    size_t size = static_cast<size_t>(stride) * image.height;
+    Image::Buffer indices = pool ? pool->AcquireBuffer(size) : Image::Buffer();
+    indices.assign(size, 0);
+
+    last_color = 0;
+    last_entry = &histogram[0];
+    ForEachPixel(image, [&](int x, int y, ColorRGBA pixel) {
+        uint32_t color = NormalizedColor(pixel);
+        if (color != last_color) {
+            last_color = color;
+            last_entry = &histogram[color];
+        }
+        indices[static_cast<size_t>(y) * stride + x] = last_entry->index;
+    });
+
+    if (pool) {
+        pool->Recycle(std::move(image.bitmap));
+    }
+    image.bitmap = std::move(indices);
+    image.stride = stride;
+    image.pixel_format = PixelFormat::kIndexed8;
+}
+
+}  // namespace aribcaption
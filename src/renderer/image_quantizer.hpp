@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_IMAGE_QUANTIZER_HPP
+#define ARIBCAPTION_IMAGE_QUANTIZER_HPP
+
+#include "aribcaption/image.hpp"
+
+namespace aribcaption {
+
+class BitmapPool;
+
+/**
+ * Convert an owned, straight alpha RGBA image into @PixelFormat::kIndexed8 in place.
+ *
+ * Lossless if the image holds no more than 255 distinct visible colors, which is typical for
+ * captions drawn from the 128-entry ARIB CLUT without anti-aliasing. Otherwise colors are merged
+ * by dropping low bits of every component until they fit, each entry being the coverage-weighted
+ * average of its members.
+ *
+ * The RGBA bitmap is recycled into pool, if provided.
+ */
+void ConvertImageToIndexed8(Image& image, BitmapPool* pool);
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_IMAGE_QUANTIZER_HPP
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "base/always_inline.hpp"
+#include "renderer/bitmap_pool.hpp"
+#include "renderer/image_rle.hpp"
+
+namespace aribcaption {
+
+namespace {
+
+// Gaps no longer than this are kept inside spans, an ImageSpan costs about as much as 4 RGBA pixels
+constexpr int kMaxSpanGap = 4;
+
+ALWAYS_INLINE bool IsTransparent(const uint8_t* pixel, size_t pixel_size) {
+    // Alpha comes last for all of RGBA / BGRA formats
+    return pixel_size == 1 ? pixel[0] == 0 : pixel[pixel_size - 1] == 0;
+}
+
+// Find spans of non-transparent pixels in the line, calls func(x, length) for each of them
+template <typename Func>
+void ForEachLineSpan(const uint8_t* line, int width, size_t pixel_size, Func&& func) {
+    int x = 0;
+    while (x < width) {
+        while (x < width && IsTransparent(line + x * pixel_size, pixel_size)) {
+            x++;
+        }
+        if (x == width) {
+            break;
+        }
+        int begin = x;
+        int end = x;  // past the last non-transparent pixel
+        while (x < width) {
+            if (!IsTransparent(line + x * pixel_size, pixel_size)) {
+                end = ++x;
+            } else if (x - end < kMaxSpanGap) {
+                x++;
+            } else {
+                break;
+            }
+        }
+        func(begin, end - begin);
+        x = end;
+    }
+}
+
+}  // namespace
+
+void EncodeImageRunLength(Image& image, BitmapPool* pool) {
+    if (!image.spans.empty() || !image.data() || image.stride == 0) {
+        return;
+    }
+
+    size_t pixel_size = image.pixel_format == PixelFormat::kIndexed8 ? 1 : 4;
+    const uint8_t* data = image.data();
+
+    std::vector<ImageSpan> spans;
+    size_t total_bytes = 0;
+    for (int y = 0; y < image.height; y++) {
+        const uint8_t* line = data + static_cast<size_t>(y) * image.stride;
+        ForEachLineSpan(line, image.width, pixel_size, [&](int x, int length) {
+            spans.push_back(ImageSpan{x, y, length, static_cast<uint32_t>(total_bytes)});
+            total_bytes += static_cast<size_t>(length) * pixel_size;
+        });
+    }
+
+    Image::Buffer buffer = pool ? pool->AcquireBuffer(total_bytes) : Image::Buffer();
+    buffer.resize(total_bytes);
+    for (const ImageSpan& span : spans) {
+        const uint8_t* src = data + static_cast<size_t>(span.y) * image.stride + span.x * pixel_size;
+        memcpy(buffer.data() + span.offset, src, span.length * pixel_size);
+    }
+
+    if (image.shared_bitmap) {
+        image.shared_bitmap.reset();
+    } else if (pool) {
+        pool->Recycle(std::move(image.bitmap));
+    }
+    image.bitmap = std::move(buffer);
+    image.stride = 0;
+    image.spans = std::move(spans);
+}
+
+}  // namespace aribcaption
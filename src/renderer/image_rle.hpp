@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ARIBCAPTION_IMAGE_RLE_HPP
+#define ARIBCAPTION_IMAGE_RLE_HPP
+
+#include "aribcaption/image.hpp"
+
+namespace aribcaption {
+
+class BitmapPool;
+
+/**
+ * Run-length encode a dense image in place, see @Image::spans.
+ *
+ * Works with any pixel format. Pixels with zero alpha (or index 0 for @PixelFormat::kIndexed8) are treated as
+ * transparent. Short transparent gaps are kept inside spans, as they are cheaper than starting a new span.
+ *
+ * The dense bitmap is recycled into pool, if provided. Images which have been encoded are left untouched.
+ */
+void EncodeImageRunLength(Image& image, BitmapPool* pool);
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_IMAGE_RLE_HPP
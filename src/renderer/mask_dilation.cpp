@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "renderer/mask_dilation.hpp"
+
+namespace aribcaption {
+
+namespace {
+
+struct KernelTap {
+    int dx = 0;
+    uint8_t weight = 0;
+};
+
+struct KernelRow {
+    int dy = 0;
+    int full_reach = -1;          // taps within [-full_reach, full_reach] are fully weighted
+    std::vector<KernelTap> taps;  // partially weighted taps (the anti-aliased edge)
+};
+
+// Weight of a tap at pixel distance d is (radius + 1 - d), clamped to [0, 1].
+// Source pixels sit half a pixel inside the outline, this puts the 50% contour of the border at radius.
+std::vector<KernelRow> BuildKernel(float radius, int reach) {
+    std::vector<KernelRow> rows;
+    float edge = radius + 1.0f;
+
+    for (int dy = -reach; dy <= reach; dy++) {
+        KernelRow row;
+        row.dy = dy;
+        for (int dx = -reach; dx <= reach; dx++) {
+            float distance = std::sqrt(static_cast<float>(dx * dx + dy * dy));
+            float weight = std::min(edge - distance, 1.0f);
+            if (weight <= 0.0f) {
+                continue;
+            }
+            auto weight_u8 = static_cast<uint8_t>(std::lround(weight * 255.0f));
+            if (weight_u8 == 255) {
+                row.full_reach = std::max(row.full_reach, std::abs(dx));
+            } else if (weight_u8 > 0) {
+                row.taps.push_back(KernelTap{dx, weight_u8});
+            }
+        }
+        if (row.full_reach >= 0 || !row.taps.empty()) {
+            rows.push_back(std::move(row));
+        }
+    }
+
+    // Order by reach so that horizontal maxima can be grown incrementally, see DilateGlyphMask()
+    std::stable_sort(rows.begin(), rows.end(), [](const KernelRow& a, const KernelRow& b) {
+        return a.full_reach < b.full_reach;
+    });
+
+    return rows;
+}
+
+// Scale coverage by weight / 255, rounded
+inline uint8_t Weigh(uint8_t coverage, uint8_t weight) {
+    uint32_t x = static_cast<uint32_t>(coverage) * weight + 128;
+    return static_cast<uint8_t>((x + (x >> 8)) >> 8);
+}
+
+}  // namespace
+
+GlyphMask DilateGlyphMask(const GlyphMask& mask, float radius) {
+    if (mask.width <= 0 || mask.height <= 0 || radius <= 0.0f) {
+        return mask;
+    }
+
+    int reach = static_cast<int>(std::ceil(radius + 1.0f)) - 1;
+    std::vector<KernelRow> kernel = BuildKernel(radius, reach);
+
+    GlyphMask result;
+    result.left = mask.left - reach;
+    result.top = mask.top + reach;
+    result.width = mask.width + 2 * reach;
+    result.height = mask.height + 2 * reach;
+    result.coverage.assign(static_cast<size_t>(result.width) * result.height, 0);
+
+    // Horizontal max over the fully weighted run of kernel rows, grown as the (sorted) reach increases
+    std::vector<uint8_t> row_max(result.width);
+
+    for (int y = 0; y < mask.height; y++) {
+        const uint8_t* src = &mask.coverage[static_cast<size_t>(y) * mask.width];
+
+        // Skip fully transparent source rows, they never contribute
+        if (std::all_of(src, src + mask.width, [](uint8_t v) { return v == 0; })) {
+            continue;
+        }
+
+        std::fill(row_max.begin(), row_max.end(), 0);
+        int current_reach = -1;
+
+        for (const KernelRow& row : kernel) {
+            uint8_t* dest = &result.coverage[static_cast<size_t>(y + reach + row.dy) * result.width + reach];
+
+            if (row.full_reach >= 0) {
+                // row_max[x + reach] = max(src[x - full_reach], ..., src[x + full_reach])
+                for (int r = current_reach + 1; r <= row.full_reach; r++) {
+                    for (int dx : {-r, r}) {  // r == 0 is applied twice, harmless for max
+                        uint8_t* out = &row_max[reach + dx];
+                        for (int x = 0; x < mask.width; x++) {
+                            out[x] = std::max(out[x], src[x]);
+                        }
+                    }
+                }
+                current_reach = std::max(current_reach, row.full_reach);
+
+                const uint8_t* in = &row_max[0];
+                uint8_t* out = dest - reach;
+                for (int x = 0; x < result.width; x++) {
+                    out[x] = std::max(out[x], in[x]);
+                }
+            }
+
+            for (const KernelTap& tap : row.taps) {
+                uint8_t* out = dest + tap.dx;
+                for (int x = 0; x < mask.width; x++) {
+                    out[x] = std::max(out[x], Weigh(src[x], tap.weight));
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+}  // namespace aribcaption
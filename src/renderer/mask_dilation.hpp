@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_MASK_DILATION_HPP
+#define ARIBCAPTION_MASK_DILATION_HPP
+
+#include "renderer/glyph_cache.hpp"
+
+namespace aribcaption {
+
+/**
+ * Grow a coverage mask by radius pixels, using a round structuring element with anti-aliased edge.
+ * Used as a cheap replacement of outline stroking for generating stroke borders.
+ *
+ * The returned mask is (2 * R) pixels larger than the source in both dimensions,
+ * where R is the integral reach of the element, and its origin is moved accordingly.
+ */
+GlyphMask DilateGlyphMask(const GlyphMask& mask, float radius);
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_MASK_DILATION_HPP
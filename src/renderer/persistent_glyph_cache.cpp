@@ -0,0 +1,411 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "aribcc_config.h"
+#include "base/binary_io.hpp"
+#include "renderer/persistent_glyph_cache.hpp"
+
+#if defined(_WIN32)
+    #include <windows.h>
+    #include "base/wchar_helper.hpp"
+#endif
+
+namespace aribcaption {
+
+namespace {
+
+constexpr uint32_t kCacheMagic = 0x46434741;  // "AGCF"
+constexpr uint32_t kCacheVersion = 2;
+
+FILE* OpenFile(const std::string& filename, const char* mode) {
+#if defined(_WIN32)
+    std::wstring wide_mode(mode, mode + strlen(mode));
+    return _wfopen(wchar::UTF8ToWideString(filename).c_str(), wide_mode.c_str());
+#else
+    return fopen(filename.c_str(), mode);
+#endif
+}
+
+bool ReplaceFile(const std::string& from, const std::string& to) {
+#if defined(_WIN32)
+    return MoveFileExW(wchar::UTF8ToWideString(from).c_str(), wchar::UTF8ToWideString(to).c_str(),
+                       MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+void WriteMask(BinaryWriter& writer, const GlyphMask& mask) {
+    writer.WriteVarInt(mask.left);
+    writer.WriteVarInt(mask.top);
+    writer.WriteVarUInt(static_cast<uint64_t>(mask.width));
+    writer.WriteVarUInt(static_cast<uint64_t>(mask.height));
+    writer.WriteBytes(mask.coverage.data(), mask.coverage.size());
+}
+
+bool ReadMask(BinaryReader& reader, GlyphMask& mask) {
+    mask.left = static_cast<int>(reader.ReadVarInt());
+    mask.top = static_cast<int>(reader.ReadVarInt());
+    uint64_t width = reader.ReadVarUInt();
+    uint64_t height = reader.ReadVarUInt();
+    if (!reader.ok() || width > 0xFFFF || height > 0xFFFF) {
+        return false;
+    }
+    mask.width = static_cast<int>(width);
+    mask.height = static_cast<int>(height);
+    size_t bytes = static_cast<size_t>(width * height);
+    const uint8_t* coverage = reader.ReadBytes(bytes);
+    if (!coverage) {
+        return false;
+    }
+    mask.coverage.assign(coverage, coverage + bytes);
+    return true;
+}
+
+void WriteGlyph(BinaryWriter& writer, const CachedGlyph& glyph) {
+    writer.WriteVarInt(glyph.ascender);
+    writer.WriteVarInt(glyph.descender);
+    writer.WriteVarInt(glyph.underline_position);
+    writer.WriteVarInt(glyph.underline_thickness);
+    WriteMask(writer, glyph.fill);
+    writer.WriteU8(glyph.border ? 1 : 0);
+    if (glyph.border) {
+        WriteMask(writer, glyph.border.value());
+    }
+}
+
+bool ReadGlyph(BinaryReader& reader, CachedGlyph& glyph) {
+    glyph.ascender = static_cast<int>(reader.ReadVarInt());
+    glyph.descender = static_cast<int>(reader.ReadVarInt());
+    glyph.underline_position = static_cast<int>(reader.ReadVarInt());
+    glyph.underline_thickness = static_cast<int>(reader.ReadVarInt());
+    if (!ReadMask(reader, glyph.fill)) {
+        return false;
+    }
+    if (reader.ReadU8()) {
+        if (!ReadMask(reader, glyph.border.emplace())) {
+            return false;
+        }
+    }
+    return reader.ok();
+}
+
+void WriteKey(BinaryWriter& writer, const PersistentGlyphCache::Key& key) {
+    writer.WriteU64(key.font_id);
+    writer.WriteU32(key.glyph_index);
+    writer.WriteI32(key.pixel_width);
+    writer.WriteI32(key.pixel_height);
+    writer.WriteI32(key.stroke_width);
+    writer.WriteU8(key.stroke_mode);
+    writer.WriteU8(key.hinting);
+}
+
+PersistentGlyphCache::Key ReadKey(BinaryReader& reader) {
+    PersistentGlyphCache::Key key;
+    key.font_id = reader.ReadU64();
+    key.glyph_index = reader.ReadU32();
+    key.pixel_width = reader.ReadI32();
+    key.pixel_height = reader.ReadI32();
+    key.stroke_width = reader.ReadI32();
+    key.stroke_mode = reader.ReadU8();
+    key.hinting = reader.ReadU8();
+    return key;
+}
+
+size_t EstimateGlyphBytes(const CachedGlyph& glyph) {
+    size_t bytes = 64 + glyph.fill.coverage.size();
+    if (glyph.border) {
+        bytes += glyph.border->coverage.size();
+    }
+    return bytes;
+}
+
+}  // namespace
+
+size_t PersistentGlyphCache::KeyHash::operator()(const Key& key) const noexcept {
+    uint64_t h = key.font_id ^ (static_cast<uint64_t>(key.glyph_index) << 32);
+    h ^= (static_cast<uint64_t>(static_cast<uint32_t>(key.pixel_width)) << 40) ^
+         (static_cast<uint64_t>(static_cast<uint32_t>(key.pixel_height)) << 20) ^
+         static_cast<uint32_t>(key.stroke_width) ^
+         (static_cast<uint64_t>(key.stroke_mode) << 60) ^
+         (static_cast<uint64_t>(key.hinting) << 56);
+    h *= 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(h ^ (h >> 29));
+}
+
+PersistentGlyphCache::PersistentGlyphCache(Context& context) : log_(GetContextLogger(context)) {}
+
+PersistentGlyphCache::~PersistentGlyphCache() {
+    JoinWriter();
+    if (filename_.empty() || !dirty_count_) {
+        return;
+    }
+
+    std::vector<uint8_t> data;
+    Serialize(TakeSnapshot(), data);
+
+    // The mapping must be closed before replacing the file on Windows
+    mapped_glyphs_.clear();
+    mapped_file_.Close();
+    if (!WriteFile(data)) {
+        log_->w("PersistentGlyphCache: Failed to write %s", filename_.c_str());
+    }
+}
+
+bool PersistentGlyphCache::Open(const std::string& filename) {
+    JoinWriter();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    filename_ = filename;
+    mapped_glyphs_.clear();
+    glyphs_.clear();
+    fallbacks_.clear();
+    mapped_glyph_data_ = nullptr;
+    mapped_glyph_data_size_ = 0;
+    estimated_file_bytes_ = 0;
+    dirty_count_ = 0;
+
+    if (!mapped_file_.Open(filename)) {
+        return false;
+    }
+    if (!LoadIndex(mapped_file_.data(), mapped_file_.size())) {
+        log_->w("PersistentGlyphCache: Ignoring %s, which is corrupted or written by another version",
+                filename.c_str());
+        mapped_glyphs_.clear();
+        fallbacks_.clear();
+        mapped_file_.Close();
+        return false;
+    }
+    estimated_file_bytes_ = mapped_file_.size();
+    return true;
+}
+
+bool PersistentGlyphCache::LoadIndex(const uint8_t* data, size_t size) {
+    BinaryReader reader(data, size);
+    if (reader.ReadU32() != kCacheMagic || reader.ReadU32() != kCacheVersion ||
+            reader.ReadString() != ARIBCC_VERSION) {
+        return false;
+    }
+
+    uint64_t fallback_count = reader.ReadVarUInt();
+    for (uint64_t i = 0; i < fallback_count && reader.ok(); i++) {
+        uint64_t family_hash = reader.ReadU64();
+        auto ucs4 = reader.ReadU32();
+        PersistentFallbackFont font;
+        font.filename = reader.ReadString();
+        font.family_name = reader.ReadString();
+        font.postscript_name = reader.ReadString();
+        font.face_index = reader.ReadI32();
+        font.font_id = reader.ReadU64();
+        fallbacks_[family_hash][ucs4] = std::move(font);
+    }
+
+    uint64_t glyph_count = reader.ReadVarUInt();
+    std::vector<std::pair<Key, MappedGlyph>> index;
+    for (uint64_t i = 0; i < glyph_count && reader.ok(); i++) {
+        Key key = ReadKey(reader);
+        MappedGlyph glyph;
+        glyph.offset = static_cast<size_t>(reader.ReadVarUInt());
+        glyph.size = static_cast<size_t>(reader.ReadVarUInt());
+        index.emplace_back(key, glyph);
+    }
+    if (!reader.ok()) {
+        return false;
+    }
+
+    mapped_glyph_data_ = data + reader.position();
+    mapped_glyph_data_size_ = reader.remaining();
+    for (const auto& [key, glyph] : index) {
+        if (glyph.offset > mapped_glyph_data_size_ || glyph.size > mapped_glyph_data_size_ - glyph.offset) {
+            return false;
+        }
+        mapped_glyphs_.emplace(key, glyph);
+    }
+    return true;
+}
+
+auto PersistentGlyphCache::Get(const Key& key) -> std::shared_ptr<const CachedGlyph> {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto iter = glyphs_.find(key); iter != glyphs_.end()) {
+        return iter->second;
+    }
+
+    auto iter = mapped_glyphs_.find(key);
+    if (iter == mapped_glyphs_.end()) {
+        return nullptr;
+    }
+
+    // Pages of the mapping are only loaded here
+    BinaryReader reader(mapped_glyph_data_ + iter->second.offset, iter->second.size);
+    auto glyph = std::make_shared<CachedGlyph>();
+    if (!ReadGlyph(reader, *glyph)) {
+        return nullptr;
+    }
+    return glyph;
+}
+
+void PersistentGlyphCache::Put(const Key& key, std::shared_ptr<const CachedGlyph> glyph) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (filename_.empty() || estimated_file_bytes_ >= kMaxFileBytes ||
+            mapped_glyphs_.find(key) != mapped_glyphs_.end()) {
+        return;
+    }
+    size_t bytes = EstimateGlyphBytes(*glyph);
+    if (!glyphs_.emplace(key, std::move(glyph)).second) {
+        return;
+    }
+    estimated_file_bytes_ += bytes;
+    if (++dirty_count_ >= kWriteBackThreshold && !writing_) {
+        WriteBackInBackground();
+    }
+}
+
+auto PersistentGlyphCache::GetFallback(uint64_t family_hash, uint32_t ucs4) -> std::optional<PersistentFallbackFont> {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto family_iter = fallbacks_.find(family_hash);
+    if (family_iter == fallbacks_.end()) {
+        return std::nullopt;
+    }
+    auto iter = family_iter->second.find(ucs4);
+    if (iter == family_iter->second.end()) {
+        return std::nullopt;
+    }
+    return iter->second;
+}
+
+void PersistentGlyphCache::PutFallback(uint64_t family_hash, uint32_t ucs4, PersistentFallbackFont font) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (filename_.empty()) {
+        return;
+    }
+    fallbacks_[family_hash][ucs4] = std::move(font);
+    dirty_count_++;  // Written along with glyphs, a fallback resolution alone isn't worth a write
+}
+
+auto PersistentGlyphCache::TakeSnapshot() -> Snapshot {
+    Snapshot snapshot;
+    snapshot.mapped_glyphs.assign(mapped_glyphs_.begin(), mapped_glyphs_.end());
+    snapshot.glyphs.assign(glyphs_.begin(), glyphs_.end());
+    for (const auto& [family_hash, fonts] : fallbacks_) {
+        for (const auto& [ucs4, font] : fonts) {
+            snapshot.fallbacks.emplace_back(std::make_pair(family_hash, ucs4), font);
+        }
+    }
+    dirty_count_ = 0;
+    return snapshot;
+}
+
+void PersistentGlyphCache::Serialize(const Snapshot& snapshot, std::vector<uint8_t>& out_data) const {
+    std::vector<uint8_t> glyph_data;
+    BinaryWriter glyph_writer(glyph_data);
+
+    std::vector<uint8_t> index;
+    BinaryWriter index_writer(index);
+    auto write_index = [&](const Key& key, size_t offset) {
+        WriteKey(index_writer, key);
+        index_writer.WriteVarUInt(offset);
+        index_writer.WriteVarUInt(glyph_data.size() - offset);
+    };
+    for (const auto& [key, mapped] : snapshot.mapped_glyphs) {
+        size_t offset = glyph_data.size();
+        glyph_writer.WriteBytes(mapped_glyph_data_ + mapped.offset, mapped.size);
+        write_index(key, offset);
+    }
+    for (const auto& [key, glyph] : snapshot.glyphs) {
+        size_t offset = glyph_data.size();
+        WriteGlyph(glyph_writer, *glyph);
+        write_index(key, offset);
+    }
+
+    out_data.clear();
+    BinaryWriter writer(out_data);
+    writer.WriteU32(kCacheMagic);
+    writer.WriteU32(kCacheVersion);
+    writer.WriteString(ARIBCC_VERSION);
+
+    writer.WriteVarUInt(snapshot.fallbacks.size());
+    for (const auto& [fallback_key, font] : snapshot.fallbacks) {
+        writer.WriteU64(fallback_key.first);
+        writer.WriteU32(fallback_key.second);
+        writer.WriteString(font.filename);
+        writer.WriteString(font.family_name);
+        writer.WriteString(font.postscript_name);
+        writer.WriteI32(font.face_index);
+        writer.WriteU64(font.font_id);
+    }
+
+    writer.WriteVarUInt(snapshot.mapped_glyphs.size() + snapshot.glyphs.size());
+    writer.WriteBytes(index.data(), index.size());
+    writer.WriteBytes(glyph_data.data(), glyph_data.size());
+}
+
+bool PersistentGlyphCache::WriteFile(const std::vector<uint8_t>& data) {
+    // Write into a temporary file first, so that a partially written file never replaces a valid one
+    std::string temp_filename = filename_ + ".tmp";
+    FILE* file = OpenFile(temp_filename, "wb");
+    if (!file) {
+        return false;
+    }
+    bool succeeded = fwrite(data.data(), 1, data.size(), file) == data.size();
+    succeeded = fclose(file) == 0 && succeeded;
+    if (!succeeded || !ReplaceFile(temp_filename, filename_)) {
+        remove(temp_filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+void PersistentGlyphCache::WriteBackInBackground() {
+    // Called with mutex_ locked. The previous writer has nothing left to do once writing_ is cleared
+    writing_ = true;
+    if (writer_thread_.joinable()) {
+        writer_thread_.join();
+    }
+
+    writer_thread_ = std::thread([this] {
+        Snapshot snapshot;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            snapshot = TakeSnapshot();
+        }
+
+        // The mapping stays untouched until the writer is joined, glyphs are immutable once cached
+        std::vector<uint8_t> data;
+        Serialize(snapshot, data);
+        bool succeeded = WriteFile(data);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!succeeded) {
+            // Retried on destruction, e.g. on Windows where the mapped file can't be replaced
+            log_->w("PersistentGlyphCache: Failed to write %s", filename_.c_str());
+            dirty_count_ = std::max<size_t>(dirty_count_, 1);
+        }
+        writing_ = false;
+    });
+}
+
+void PersistentGlyphCache::JoinWriter() {
+    if (writer_thread_.joinable()) {
+        writer_thread_.join();
+    }
+}
+
+}  // namespace aribcaption
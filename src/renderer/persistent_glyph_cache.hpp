@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_PERSISTENT_GLYPH_CACHE_HPP
+#define ARIBCAPTION_PERSISTENT_GLYPH_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "base/logger.hpp"
+#include "base/mapped_file.hpp"
+#include "renderer/glyph_cache.hpp"
+
+namespace aribcaption {
+
+// Font face resolved as the fallback of a codepoint, see PersistentGlyphCache::GetFallback()
+struct PersistentFallbackFont {
+    std::string filename;
+    std::string family_name;
+    std::string postscript_name;
+    int face_index = 0;
+    uint64_t font_id = 0;
+};
+
+/**
+ * Glyph cache persisted into a file, for warm starts without rasterizing common glyphs again
+ *
+ * Glyphs are identified by font identity rather than per-process face serials. The identity is supplied by
+ * the TextRenderer, which is expected to cover both the font data and the rasterizer version.
+ * The file is memory mapped and glyphs are read on demand, while new glyphs and fallback resolutions are
+ * written back into a new file in the background, which replaces the old one once completed.
+ * Shared between the TextRenderers of a Renderer, thread-safe.
+ */
+class PersistentGlyphCache {
+public:
+    struct Key {
+        uint64_t font_id = 0;
+        uint32_t glyph_index = 0;
+        int pixel_width = 0;
+        int pixel_height = 0;
+        int32_t stroke_width = 0;  // 26.6 fixed point, 0 if not stroked
+        uint8_t stroke_mode = 0;
+        uint8_t hinting = 0;
+
+        bool operator==(const Key& rhs) const {
+            return font_id == rhs.font_id &&
+                   glyph_index == rhs.glyph_index &&
+                   pixel_width == rhs.pixel_width &&
+                   pixel_height == rhs.pixel_height &&
+                   stroke_width == rhs.stroke_width &&
+                   stroke_mode == rhs.stroke_mode &&
+                   hinting == rhs.hinting;
+        }
+    };
+
+    // Written back after this count of new entries, and on destruction
+    static constexpr size_t kWriteBackThreshold = 64;
+    // Glyphs are no longer added once the file grows beyond this size
+    static constexpr size_t kMaxFileBytes = 16 * 1024 * 1024;
+public:
+    explicit PersistentGlyphCache(Context& context);
+    ~PersistentGlyphCache();
+public:
+    /**
+     * Map the cache file and load its index
+     *
+     * The file is written back to the same path even if loading failed.
+     *
+     * @return false if the file doesn't exist, or was written by another version of the library
+     */
+    bool Open(const std::string& filename);
+
+    [[nodiscard]]
+    auto Get(const Key& key) -> std::shared_ptr<const CachedGlyph>;
+    void Put(const Key& key, std::shared_ptr<const CachedGlyph> glyph);
+
+    // Fallback resolutions are keyed by the font family and main face, see TextRendererFreetype
+    [[nodiscard]]
+    auto GetFallback(uint64_t family_hash, uint32_t ucs4) -> std::optional<PersistentFallbackFont>;
+    void PutFallback(uint64_t family_hash, uint32_t ucs4, PersistentFallbackFont font);
+public:
+    PersistentGlyphCache(const PersistentGlyphCache&) = delete;
+    PersistentGlyphCache& operator=(const PersistentGlyphCache&) = delete;
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const noexcept;
+    };
+
+    struct MappedGlyph {
+        size_t offset = 0;  // Relative to mapped_glyph_data_
+        size_t size = 0;
+    };
+
+    // Snapshot of entries to be written, glyphs in the mapping are referenced in place
+    struct Snapshot {
+        std::vector<std::pair<Key, MappedGlyph>> mapped_glyphs;
+        std::vector<std::pair<Key, std::shared_ptr<const CachedGlyph>>> glyphs;
+        std::vector<std::pair<std::pair<uint64_t, uint32_t>, PersistentFallbackFont>> fallbacks;
+    };
+private:
+    bool LoadIndex(const uint8_t* data, size_t size);
+    Snapshot TakeSnapshot();
+    void Serialize(const Snapshot& snapshot, std::vector<uint8_t>& out_data) const;
+    bool WriteFile(const std::vector<uint8_t>& data);
+    void WriteBackInBackground();
+    void JoinWriter();
+private:
+    std::shared_ptr<Logger> log_;
+    std::string filename_;
+
+    std::mutex mutex_;  // Guards the maps below
+    MappedFile mapped_file_;
+    const uint8_t* mapped_glyph_data_ = nullptr;
+    size_t mapped_glyph_data_size_ = 0;
+    std::unordered_map<Key, MappedGlyph, KeyHash> mapped_glyphs_;
+    std::unordered_map<Key, std::shared_ptr<const CachedGlyph>, KeyHash> glyphs_;  // Added after loading
+    std::unordered_map<uint64_t, std::unordered_map<uint32_t, PersistentFallbackFont>> fallbacks_;
+    size_t estimated_file_bytes_ = 0;
+    size_t dirty_count_ = 0;
+
+    std::thread writer_thread_;
+    bool writing_ = false;  // Guarded by mutex_, as well as starting writer_thread_
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_PERSISTENT_GLYPH_CACHE_HPP
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "aribcaption/pixel_buffer_output.hpp"
+#include "renderer/pixel_buffer_output_impl.hpp"
+
+namespace aribcaption {
+
+PixelBufferOutput::PixelBufferOutput(Context& context)
+    : pimpl_(std::make_unique<internal::PixelBufferOutputImpl>(context)) {}
+
+PixelBufferOutput::~PixelBufferOutput() = default;
+
+PixelBufferOutput::PixelBufferOutput(PixelBufferOutput&&) noexcept = default;
+
+PixelBufferOutput& PixelBufferOutput::operator=(PixelBufferOutput&&) noexcept = default;
+
+RenderStatus PixelBufferOutput::Render(Renderer& renderer, int64_t pts, PixelBufferRenderResult& out_result) {
+    return pimpl_->Render(renderer, pts, out_result);
+}
+
+void PixelBufferOutput::Flush() {
+    pimpl_->Flush();
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <algorithm>
+#include <cstring>
+#include "renderer/pixel_buffer_output_impl.hpp"
+
+namespace aribcaption::internal {
+
+static int AlignUp(int value, int alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static PixelFormat ToBGRAFormat(PixelFormat format) {
+    return (format == PixelFormat::kRGBA8888Premultiplied || format == PixelFormat::kBGRA8888Premultiplied)
+           ? PixelFormat::kBGRA8888Premultiplied
+           : PixelFormat::kBGRA8888;
+}
+
+static void SetDictionaryInt(CFMutableDictionaryRef dict, CFStringRef key, int value) {
+    ScopedCFRef<CFNumberRef> number(CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &value));
+    CFDictionarySetValue(dict, key, number.get());
+}
+
+PixelBufferOutputImpl::PixelBufferOutputImpl(Context& context) : log_(GetContextLogger(context)) {}
+
+PixelBufferOutputImpl::~PixelBufferOutputImpl() = default;
+
+void PixelBufferOutputImpl::Flush() {
+    previous_.clear();
+    pools_.clear();
+}
+
+RenderStatus PixelBufferOutputImpl::Render(Renderer& renderer, int64_t pts, PixelBufferRenderResult& out_result) {
+    RenderStatus status = renderer.Render(pts, result_);
+    if (status == RenderStatus::kNotReady) {
+        return status;
+    } else if (status == RenderStatus::kError || status == RenderStatus::kNoImage) {
+        out_result.images.clear();
+        previous_.clear();
+        return status;
+    }
+
+    out_result.pts = result_.pts;
+    out_result.duration = result_.duration;
+
+    if (status == RenderStatus::kGotImageUnchanged && previous_.size() == result_.images.size()) {
+        out_result.images = previous_;
+        return status;
+    }
+
+    std::vector<PixelBufferImage> images(result_.images.size());
+    for (size_t i = 0; i < result_.images.size(); i++) {
+        const Image& image = result_.images[i];
+        bool unchanged = i < result_.image_changed.size() && !result_.image_changed[i];
+        const PixelBufferImage* previous = unchanged ? FindPreviousImage(image) : nullptr;
+        if (previous) {
+            images[i] = *previous;
+        } else if (!WriteImage(image, images[i])) {
+            out_result.images.clear();
+            previous_.clear();
+            return RenderStatus::kError;
+        }
+    }
+
+    previous_ = images;
+    out_result.images = std::move(images);
+    return status;
+}
+
+const PixelBufferImage* PixelBufferOutputImpl::FindPreviousImage(const Image& image) const {
+    for (const PixelBufferImage& previous : previous_) {
+        if (previous.dst_x == image.dst_x && previous.dst_y == image.dst_y &&
+                previous.width == image.width && previous.height == image.height &&
+                previous.display_width == image.display_width && previous.display_height == image.display_height &&
+                previous.pixel_format == ToBGRAFormat(image.pixel_format)) {
+            return &previous;
+        }
+    }
+    return nullptr;
+}
+
+CVPixelBufferPoolRef PixelBufferOutputImpl::AcquirePool(int width, int height) {
+    int pool_width = AlignUp(width, kSizeGranularity);
+    int pool_height = AlignUp(height, kSizeGranularity);
+
+    for (Pool& pool : pools_) {
+        if (pool.width == pool_width && pool.height == pool_height) {
+            pool.last_used = ++use_counter_;
+            return pool.pool.get();
+        }
+    }
+
+    if (pools_.size() >= kMaxPools) {
+        auto least_used = std::min_element(pools_.begin(), pools_.end(), [](const Pool& a, const Pool& b) {
+            return a.last_used < b.last_used;
+        });
+        pools_.erase(least_used);
+    }
+
+    ScopedCFRef<CFMutableDictionaryRef> attributes(CFDictionaryCreateMutable(kCFAllocatorDefault,
+                                                                             0,
+                                                                             &kCFTypeDictionaryKeyCallBacks,
+                                                                             &kCFTypeDictionaryValueCallBacks));
+    ScopedCFRef<CFDictionaryRef> iosurface_properties(CFDictionaryCreate(kCFAllocatorDefault,
+                                                                         nullptr,
+                                                                         nullptr,
+                                                                         0,
+                                                                         &kCFTypeDictionaryKeyCallBacks,
+                                                                         &kCFTypeDictionaryValueCallBacks));
+    SetDictionaryInt(attributes.get(), kCVPixelBufferPixelFormatTypeKey, kCVPixelFormatType_32BGRA);
+    SetDictionaryInt(attributes.get(), kCVPixelBufferWidthKey, pool_width);
+    SetDictionaryInt(attributes.get(), kCVPixelBufferHeightKey, pool_height);
+    CFDictionarySetValue(attributes.get(), kCVPixelBufferIOSurfacePropertiesKey, iosurface_properties.get());
+    CFDictionarySetValue(attributes.get(), kCVPixelBufferMetalCompatibilityKey, kCFBooleanTrue);
+
+    CVPixelBufferPoolRef cv_pool = nullptr;
+    CVReturn ret = CVPixelBufferPoolCreate(kCFAllocatorDefault, nullptr, attributes.get(), &cv_pool);
+    if (ret != kCVReturnSuccess || !cv_pool) {
+        log_->e("PixelBufferOutput: CVPixelBufferPoolCreate() failed for %dx%d, error %d",
+                pool_width, pool_height, static_cast<int>(ret));
+        return nullptr;
+    }
+
+    Pool& pool = pools_.emplace_back();
+    pool.width = pool_width;
+    pool.height = pool_height;
+    pool.last_used = ++use_counter_;
+    pool.pool.reset(cv_pool);
+    return cv_pool;
+}
+
+bool PixelBufferOutputImpl::WriteImage(const Image& image, PixelBufferImage& out_image) {
+    if (image.pixel_format == PixelFormat::kIndexed8 || !image.spans.empty()) {
+        log_->e("PixelBufferOutput: Indexed or run-length encoded images are not supported");
+        return false;
+    }
+
+    CVPixelBufferPoolRef pool = AcquirePool(image.width, image.height);
+    if (!pool) {
+        return false;
+    }
+
+    CVPixelBufferRef pixel_buffer = nullptr;
+    CVReturn ret = CVPixelBufferPoolCreatePixelBuffer(kCFAllocatorDefault, pool, &pixel_buffer);
+    if (ret != kCVReturnSuccess || !pixel_buffer) {
+        log_->e("PixelBufferOutput: CVPixelBufferPoolCreatePixelBuffer() failed, error %d", static_cast<int>(ret));
+        return false;
+    }
+    out_image.pixel_buffer = pixel_buffer;  // Takes the reference
+
+    if (CVPixelBufferLockBaseAddress(pixel_buffer, 0) != kCVReturnSuccess) {
+        log_->e("PixelBufferOutput: CVPixelBufferLockBaseAddress() failed");
+        return false;
+    }
+    auto dst = static_cast<uint8_t*>(CVPixelBufferGetBaseAddress(pixel_buffer));
+    size_t dst_stride = CVPixelBufferGetBytesPerRow(pixel_buffer);
+    const uint8_t* src = image.data();
+    bool swizzle = image.pixel_format == PixelFormat::kRGBA8888 ||
+                   image.pixel_format == PixelFormat::kRGBA8888Premultiplied;
+    size_t line_bytes = static_cast<size_t>(image.width) * 4;
+
+    for (int y = 0; y < image.height; y++) {
+        const uint8_t* src_line = src + static_cast<size_t>(y) * image.stride;
+        uint8_t* dst_line = dst + static_cast<size_t>(y) * dst_stride;
+        if (!swizzle) {
+            memcpy(dst_line, src_line, line_bytes);
+            continue;
+        }
+        for (size_t x = 0; x < line_bytes; x += 4) {
+            dst_line[x + 0] = src_line[x + 2];
+            dst_line[x + 1] = src_line[x + 1];
+            dst_line[x + 2] = src_line[x + 0];
+            dst_line[x + 3] = src_line[x + 3];
+        }
+    }
+
+    CVPixelBufferUnlockBaseAddress(pixel_buffer, 0);
+
+    out_image.width = image.width;
+    out_image.height = image.height;
+    out_image.dst_x = image.dst_x;
+    out_image.dst_y = image.dst_y;
+    out_image.display_width = image.display_width;
+    out_image.display_height = image.display_height;
+    out_image.pixel_format = ToBGRAFormat(image.pixel_format);
+    return true;
+}
+
+}  // namespace aribcaption::internal
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ARIBCAPTION_PIXEL_BUFFER_OUTPUT_IMPL_HPP
+#define ARIBCAPTION_PIXEL_BUFFER_OUTPUT_IMPL_HPP
+
+#include <CoreVideo/CoreVideo.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/pixel_buffer_output.hpp"
+#include "aribcaption/renderer.hpp"
+#include "base/logger.hpp"
+#include "base/scoped_cfref.hpp"
+
+namespace aribcaption::internal {
+
+class PixelBufferOutputImpl {
+public:
+    // Pool sizes are rounded up to multiples of this, so that similar sized images share a pool
+    static constexpr int kSizeGranularity = 64;
+    static constexpr size_t kMaxPools = 8;
+public:
+    explicit PixelBufferOutputImpl(Context& context);
+    ~PixelBufferOutputImpl();
+public:
+    RenderStatus Render(Renderer& renderer, int64_t pts, PixelBufferRenderResult& out_result);
+    void Flush();
+private:
+    struct Pool {
+        int width = 0;
+        int height = 0;
+        uint64_t last_used = 0;
+        ScopedCFRef<CVPixelBufferPoolRef> pool;
+    };
+
+    CVPixelBufferPoolRef AcquirePool(int width, int height);
+    bool WriteImage(const Image& image, PixelBufferImage& out_image);
+    const PixelBufferImage* FindPreviousImage(const Image& image) const;
+private:
+    std::shared_ptr<Logger> log_;
+
+    std::vector<Pool> pools_;
+    uint64_t use_counter_ = 0;
+
+    RenderResult result_;                      // Reused by Render()
+    std::vector<PixelBufferImage> previous_;   // Images handed out by the previous Render()
+};
+
+}  // namespace aribcaption::internal
+
+#endif  // ARIBCAPTION_PIXEL_BUFFER_OUTPUT_IMPL_HPP
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "renderer/region_image_cache.hpp"
+
+namespace aribcaption {
+
+void RegionImageCache::SetCapacity(size_t capacity) {
+    capacity_ = capacity;
+    EvictIfNecessary();
+}
+
+auto RegionImageCache::Get(uint64_t hash) -> const Image* {
+    auto iter = map_.find(hash);
+    if (iter == map_.end()) {
+        return nullptr;
+    }
+
+    lru_.splice(lru_.begin(), lru_, iter->second);
+    return &iter->second->second;
+}
+
+void RegionImageCache::Put(uint64_t hash, const Image& image) {
+    if (capacity_ == 0) {
+        return;
+    }
+
+    auto iter = map_.find(hash);
+    if (iter != map_.end()) {
+        iter->second->second = image;
+        lru_.splice(lru_.begin(), lru_, iter->second);
+        return;
+    }
+
+    lru_.emplace_front(hash, image);
+    map_.emplace(hash, lru_.begin());
+
+    EvictIfNecessary();
+}
+
+size_t RegionImageCache::EstimateBytes() const {
+    size_t bytes = 0;
+    for (const auto& [hash, image] : lru_) {
+        bytes += image.size();
+    }
+    return bytes;
+}
+
+void RegionImageCache::Clear() {
+    map_.clear();
+    lru_.clear();
+}
+
+void RegionImageCache::EvictIfNecessary() {
+    while (lru_.size() > capacity_) {
+        map_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_REGION_IMAGE_CACHE_HPP
+#define ARIBCAPTION_REGION_IMAGE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include "aribcaption/image.hpp"
+
+namespace aribcaption {
+
+// Content-addressed LRU cache for rendered region images, limited by entry count
+class RegionImageCache {
+public:
+    static constexpr size_t kDefaultCapacity = 4;
+public:
+    RegionImageCache() = default;
+    ~RegionImageCache() = default;
+public:
+    void SetCapacity(size_t capacity);
+    [[nodiscard]]
+    size_t capacity() const { return capacity_; }
+    [[nodiscard]]
+    auto Get(uint64_t hash) -> const Image*;
+    void Put(uint64_t hash, const Image& image);
+    void Clear();
+    // Bytes of the cached bitmaps
+    [[nodiscard]]
+    size_t EstimateBytes() const;
+public:
+    RegionImageCache(const RegionImageCache&) = delete;
+    RegionImageCache& operator=(const RegionImageCache&) = delete;
+private:
+    void EvictIfNecessary();
+private:
+    size_t capacity_ = kDefaultCapacity;
+
+    // Most recently used entries at front
+    std::list<std::pair<uint64_t, Image>> lru_;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, Image>>::iterator> map_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_REGION_IMAGE_CACHE_HPP
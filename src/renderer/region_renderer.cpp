@@ -17,24 +17,131 @@
  */
 
 #include <cassert>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include "renderer/bitmap.hpp"
 #include "renderer/canvas.hpp"
 #include "renderer/region_renderer.hpp"
 
 namespace aribcaption {
 
-RegionRenderer::RegionRenderer(Context& context) : context_(context), log_(GetContextLogger(context)) {}
+namespace {
+
+// Spans of single chars are too frequent, only trace one out of every interval DrawChar() calls
+[[maybe_unused]] constexpr uint32_t kDrawCharTraceInterval = 16;
+
+// FNV-1a, used for content-addressing rendered region images
+class RegionHasher {
+public:
+    template <typename T>
+    void Update(T value) {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+        uint8_t bytes[sizeof(T)];
+        memcpy(bytes, &value, sizeof(T));
+        Update(bytes, sizeof(T));
+    }
+
+    void Update(ColorRGBA color) {
+        Update(color.u32);
+    }
+
+    void Update(const std::string& str) {
+        Update(str.size());
+        Update(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+    }
+
+    void Update(const uint8_t* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            hash_ ^= data[i];
+            hash_ *= 0x100000001B3ull;
+        }
+    }
+
+    [[nodiscard]]
+    uint64_t hash() const { return hash_; }
+private:
+    uint64_t hash_ = 0xCBF29CE484222325ull;
+};
+
+// Crop bitmap to the bounding box of non-transparent pixels, returns the kept area in original coordinates
+// Fully transparent bitmaps are left untouched
+Rect TrimTransparentBorders(Bitmap& bitmap, BitmapPool* pool) {
+    int width = bitmap.width();
+    int height = bitmap.height();
+    Rect bounds(width, height, 0, 0);
+
+    for (int y = 0; y < height; y++) {
+        const ColorRGBA* line = bitmap.GetPixelAt(0, y);
+        int left = 0;
+        while (left < width && !line[left].a) {
+            left++;
+        }
+        if (left == width) {
+            continue;
+        }
+        int right = width;
+        while (!line[right - 1].a) {
+            right--;
+        }
+        bounds.Include(left, y);
+        bounds.Include(right - 1, y);
+    }
+
+    if (bounds.width() <= 0 || bounds.height() <= 0) {
+        return Rect(0, 0, width, height);
+    }
+    if (bounds.width() == width && bounds.height() == height) {
+        return bounds;
+    }
+
+    Bitmap trimmed(bounds.width(), bounds.height(), bitmap.pixel_format(), pool, BitmapInit::kUninitialized);
+    auto line_size = static_cast<size_t>(bounds.width()) * sizeof(ColorRGBA);
+    auto padding = static_cast<size_t>(trimmed.stride()) - line_size;
+    for (int y = bounds.top; y < bounds.bottom; y++) {
+        auto dest = reinterpret_cast<uint8_t*>(trimmed.GetPixelAt(0, y - bounds.top));
+        memcpy(dest, bitmap.GetPixelAt(bounds.left, y), line_size);
+        memset(dest + line_size, 0, padding);
+    }
+
+    if (pool) {
+        pool->Recycle(Bitmap::ToImage(std::move(bitmap)));
+    }
+    bitmap = std::move(trimmed);
+    return bounds;
+}
+
+}  // namespace
+
+RegionRenderer::RegionRenderer(Context& context)
+    : context_(context),
+      log_(GetContextLogger(context)),
+      metrics_(GetContextMetrics(context)),
+      tracer_(GetContextTracer(context)) {}
 
 bool RegionRenderer::Initialize(FontProviderType font_provider_type, TextRendererType text_renderer_type) {
+    uint64_t start = Metrics::NowMicroseconds();
     font_provider_ = FontProvider::Create(font_provider_type, context_);
     if (!font_provider_->Initialize()) {
         return false;
     }
+    font_provider_init_us_ = Metrics::NowMicroseconds() - start;
 
+    start = Metrics::NowMicroseconds();
     text_renderer_ = TextRenderer::Create(text_renderer_type, context_, *font_provider_);
     if (!text_renderer_->Initialize()) {
         return false;
     }
+    text_renderer_init_us_ = Metrics::NowMicroseconds() - start;
+
+    if (glyph_cache_limit_) {
+        text_renderer_->SetGlyphCacheLimit(glyph_cache_limit_.value());
+    }
+    text_renderer_->SetStrokeMode(stroke_mode_);
+    text_renderer_->SetHinting(text_hinting_);
+    text_renderer_->SetDistanceFieldGlyphs(distance_field_glyphs_);
+    text_renderer_->SetPersistentGlyphCache(persistent_glyph_cache_);
 
     return true;
 }
@@ -43,11 +150,21 @@ void RegionRenderer::SetFontLanguage(uint32_t iso6392_language_code) {
     assert(font_provider_ && text_renderer_);
     font_provider_->SetLanguage(iso6392_language_code);
     text_renderer_->SetLanguage(iso6392_language_code);
+    font_language_ = iso6392_language_code;
 }
 
 bool RegionRenderer::SetFontFamily(const std::vector<std::string>& font_family) {
     assert(text_renderer_);
-    return text_renderer_->SetFontFamily(font_family);
+    if (!text_renderer_->SetFontFamily(font_family)) {
+        return false;
+    }
+
+    RegionHasher hasher;
+    for (const std::string& family : font_family) {
+        hasher.Update(family);
+    }
+    font_family_hash_ = hasher.hash();
+    return true;
 }
 
 void RegionRenderer::SetOriginalPlaneSize(int plane_width, int plane_height) {
@@ -89,15 +206,260 @@ void RegionRenderer::SetForceStrokeText(bool force_stroke) {
     force_stroke_text_ = force_stroke;
 }
 
+void RegionRenderer::SetStrokeMode(StrokeMode mode) {
+    stroke_mode_ = mode;
+    if (text_renderer_) {
+        text_renderer_->SetStrokeMode(mode);
+    }
+}
+
+void RegionRenderer::SetTextHinting(TextHinting hinting) {
+    text_hinting_ = hinting;
+    if (text_renderer_) {
+        text_renderer_->SetHinting(hinting);
+    }
+}
+
+void RegionRenderer::SetDRCSScaleFilter(DRCSScaleFilter filter) {
+    drcs_scale_filter_ = filter;
+    drcs_renderer_.SetScaleFilter(filter);
+}
+
+void RegionRenderer::SetDistanceFieldGlyphs(bool enable) {
+    distance_field_glyphs_ = enable;
+    if (text_renderer_) {
+        text_renderer_->SetDistanceFieldGlyphs(enable);
+    }
+}
+
 void RegionRenderer::SetForceNoBackground(bool force_no_background) {
     force_no_background_ = force_no_background;
 }
 
+void RegionRenderer::SetTrimImages(bool trim) {
+    trim_images_ = trim;
+}
+
+void RegionRenderer::SetGlyphCacheLimit(size_t limit_bytes) {
+    glyph_cache_limit_ = limit_bytes;
+    drcs_renderer_.SetCacheLimit(limit_bytes / 4);
+    if (text_renderer_) {
+        text_renderer_->SetGlyphCacheLimit(limit_bytes);
+    }
+}
+
+GlyphCacheStats RegionRenderer::GetGlyphCacheStats() const {
+    if (!text_renderer_) {
+        return GlyphCacheStats{};
+    }
+    return text_renderer_->GetGlyphCacheStats();
+}
+
+void RegionRenderer::SetPersistentGlyphCache(std::shared_ptr<PersistentGlyphCache> cache) {
+    persistent_glyph_cache_ = std::move(cache);
+    if (text_renderer_) {
+        text_renderer_->SetPersistentGlyphCache(persistent_glyph_cache_);
+    }
+}
+
+void RegionRenderer::TrimMemory(MemoryTrimLevel level) {
+    region_image_cache_.Clear();
+    if (level >= MemoryTrimLevel::kModerate) {
+        drcs_renderer_.ClearCache();
+        if (text_renderer_) {
+            text_renderer_->TrimMemory(level >= MemoryTrimLevel::kComplete);
+        }
+    }
+}
+
+void RegionRenderer::AddMemoryUsage(RendererMemoryUsage& usage) const {
+    usage.drcs_cache_bytes += drcs_renderer_.cache_bytes();
+    usage.region_image_cache_bytes += region_image_cache_.EstimateBytes();
+    if (text_renderer_) {
+        usage.glyph_cache_bytes += text_renderer_->GetGlyphCacheStats().used_bytes;
+        usage.font_face_count += text_renderer_->GetFontFaceCount();
+    }
+}
+
+void RegionRenderer::GetStartupTimings(RendererStartupTimings& timings) const {
+    timings.font_provider_init_us = font_provider_init_us_;
+    timings.text_renderer_init_us = text_renderer_init_us_;
+    if (text_renderer_) {
+        timings.first_font_load_us = text_renderer_->GetFirstFontLoadMicroseconds();
+    }
+}
+
+void RegionRenderer::SetRegionImageCacheSize(size_t count) {
+    region_image_cache_.SetCapacity(count);
+}
+
+void RegionRenderer::ClearRegionImageCache() {
+    region_image_cache_.Clear();
+}
+
+void RegionRenderer::SetBitmapPool(BitmapPool* pool) {
+    bitmap_pool_ = pool;
+}
+
+void RegionRenderer::CopySettingsFrom(const RegionRenderer& other) {
+    SetStrokeWidth(other.stroke_width_);
+    SetReplaceDRCS(other.replace_drcs_);
+    SetForceStrokeText(other.force_stroke_text_);
+    SetStrokeMode(other.stroke_mode_);
+    SetTextHinting(other.text_hinting_);
+    SetDRCSScaleFilter(other.drcs_scale_filter_);
+    SetDistanceFieldGlyphs(other.distance_field_glyphs_);
+    SetForceNoBackground(other.force_no_background_);
+    SetTrimImages(other.trim_images_);
+    if (other.glyph_cache_limit_) {
+        SetGlyphCacheLimit(other.glyph_cache_limit_.value());
+    }
+    SetPersistentGlyphCache(other.persistent_glyph_cache_);
+    SetRegionImageCacheSize(other.region_image_cache_.capacity());
+    SetBitmapPool(other.bitmap_pool_);
+}
+
+bool RegionRenderer::CopyWarmStateFrom(const RegionRenderer& other) {
+    if (!text_renderer_ || !other.text_renderer_) {
+        return false;
+    }
+    SetFontLanguage(other.font_language_);
+    text_renderer_->CopyWarmStateFrom(*other.text_renderer_);
+    font_family_hash_ = other.font_family_hash_;
+    drcs_renderer_.CopyCacheFrom(other.drcs_renderer_);
+    return true;
+}
+
+uint64_t RegionRenderer::HashRegion(const CaptionRegion& region,
+                                    const DRCSMap& drcs_map) const {
+    RegionHasher hasher;
+
+    // Rendering settings & geometry
+    // Position of the caption area only moves the image, it's applied to dst_x / dst_y on every rendering
+    hasher.Update(plane_width_);
+    hasher.Update(plane_height_);
+    hasher.Update(caption_area_width_);
+    hasher.Update(caption_area_height_);
+    hasher.Update(stroke_width_);
+    hasher.Update(stroke_mode_);
+    hasher.Update(text_hinting_);
+    hasher.Update(drcs_scale_filter_);
+    hasher.Update(distance_field_glyphs_);
+    hasher.Update(replace_drcs_);
+    hasher.Update(force_stroke_text_);
+    hasher.Update(force_no_background_);
+    hasher.Update(trim_images_);
+    hasher.Update(font_language_);
+    hasher.Update(font_family_hash_);
+
+    if (region.fingerprint) {
+        // Content already fingerprinted by the decoder, the chars needn't be walked again
+        hasher.Update(region.fingerprint);
+        hasher.Update(region.width);
+        return hasher.hash();
+    }
+
+    // Region content
+    hasher.Update(region.x);
+    hasher.Update(region.y);
+    hasher.Update(region.width);
+    hasher.Update(region.height);
+    hasher.Update(region.chars.size());
+
+    for (const CaptionChar& ch : region.chars) {
+        hasher.Update(ch.type);
+        hasher.Update(ch.codepoint);
+        hasher.Update(ch.pua_codepoint);
+        hasher.Update(ch.drcs_code);
+        hasher.Update(ch.x);
+        hasher.Update(ch.y);
+        hasher.Update(ch.char_width);
+        hasher.Update(ch.char_height);
+        hasher.Update(ch.char_horizontal_spacing);
+        hasher.Update(ch.char_vertical_spacing);
+        hasher.Update(ch.char_horizontal_scale);
+        hasher.Update(ch.char_vertical_scale);
+        hasher.Update(ch.text_color);
+        hasher.Update(ch.back_color);
+        hasher.Update(ch.stroke_color);
+        hasher.Update(ch.style);
+        hasher.Update(ch.enclosure_style);
+
+        if (ch.type == CaptionCharType::kDRCS || ch.type == CaptionCharType::kDRCSReplaced) {
+            auto iter = drcs_map.find(ch.drcs_code);
+            if (iter == drcs_map.end()) {
+                hasher.Update(false);
+                continue;
+            }
+            const DRCS& drcs = iter->second;
+            hasher.Update(true);
+            hasher.Update(drcs.width);
+            hasher.Update(drcs.height);
+            hasher.Update(drcs.depth_bits);
+            if (!drcs.md5.empty()) {
+                hasher.Update(drcs.md5);
+            } else {
+                hasher.Update(drcs.pixels.data(), drcs.pixels.size());
+            }
+        }
+    }
+
+    return hasher.hash();
+}
+
+bool RegionRenderer::IsGlyphInvisible(const CaptionChar& ch) const {
+    if (ch.type == CaptionCharType::kText) {
+        uint32_t ucs4 = ch.codepoint;
+        if (ucs4 == 0x0009 || ucs4 == 0x0020 || ucs4 == 0x00A0 || ucs4 == 0x1680 ||
+            ucs4 == 0x3000 || ucs4 == 0x202F || ucs4 == 0x205F || (ucs4 >= 0x2000 && ucs4 <= 0x200A)) {
+            return !ch.pua_codepoint;  // Spaces are never drawn by text renderers
+        }
+    }
+    if (ch.text_color.a) {
+        return false;
+    }
+    // Transparent text is still visible through its stroke
+    ColorRGBA stroke_color = ch.stroke_color;
+    bool stroke = ch.style & CharStyle::kCharStyleStroke;
+    if (force_stroke_text_ && !stroke) {
+        stroke = true;
+        stroke_color = ch.back_color;
+    }
+    return !stroke || !stroke_color.a || stroke_width_ * x_magnification_ <= 0.0f;
+}
+
+bool RegionRenderer::IsRegionInvisible(const CaptionRegion& region) const {
+    for (const CaptionChar& ch : region.chars) {
+        if (!force_no_background_ && ch.back_color.a) {
+            return false;
+        } else if (ch.enclosure_style && ch.text_color.a) {
+            return false;
+        } else if (!IsGlyphInvisible(ch)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 auto RegionRenderer::RenderCaptionRegion(const CaptionRegion& region,
-                                         const std::unordered_map<uint32_t, DRCS>& drcs_map)
+                                         const DRCSMap& drcs_map,
+                                         std::optional<uint64_t> precomputed_hash)
                                          -> Result<Image, RegionRenderError> {
     assert(text_renderer_ && plane_inited_ && caption_area_inited_);
 
+    uint64_t region_hash = 0;
+    if (region_image_cache_.capacity()) {
+        region_hash = precomputed_hash ? precomputed_hash.value() : HashRegion(region, drcs_map);
+        if (const Image* cached = region_image_cache_.Get(region_hash)) {
+            region_image_cache_hits_++;
+            // Cached images hold their offsets relative to the region
+            Image image(*cached);
+            image.dst_x += caption_area_start_x_ + ScaleX(region.x);
+            image.dst_y += caption_area_start_y_ + ScaleY(region.y);
+            return Ok(std::move(image));
+        }
+    }
+
     size_t char_count = region.chars.size();
     size_t succeed = 0;
     bool has_font_not_found_error = false;
@@ -106,15 +468,97 @@ auto RegionRenderer::RenderCaptionRegion(const CaptionRegion& region,
 
     if (ScaleWidth(region.width, region.x) < 3 || ScaleHeight(region.height, region.y) < 3) {
         return Err(RegionRenderError::kImageTooSmall);
+    } else if (IsRegionInvisible(region)) {
+        return Err(RegionRenderError::kImageTransparent);
     }
 
+    ARIBCC_TRACE_SCOPE(tracer_.get(), "renderer", "RegionRenderer::RenderCaptionRegion");
+    ScopedMetricTimer timer(metrics_.get(), MetricHistogram::kRegionRenderTime);
+    metrics_->Add(MetricCounter::kRenderedRegions);
+
     Bitmap bitmap(ScaleWidth(region.width, region.x),
                   ScaleHeight(region.height, region.y),
-                  PixelFormat::kRGBA8888);
+                  PixelFormat::kRGBA8888,
+                  bitmap_pool_);
     Canvas canvas(bitmap);
     TextRenderContext text_render_ctx = text_renderer_->BeginDraw(bitmap);
 
+    auto record_text_error = [&](TextRenderStatus status) {
+        log_->e("RegionRenderer: TextRenderer::DrawChar() returned error: %d", static_cast<int>(status));
+        if (status == TextRenderStatus::kFontNotFound) {
+            has_font_not_found_error = true;
+        } else if (status == TextRenderStatus::kCodePointNotFound) {
+            has_codepoint_not_found_error = true;
+        } else if (status == TextRenderStatus::kOtherError) {
+            has_other_error = true;
+        }
+    };
+
+    // Backgrounds and enclosures of adjacent chars sharing the same color are coalesced into single fills.
+    // Pending fills are drawn before any glyph, so that glyphs are kept on top.
+    struct Fill {
+        ColorRGBA color;
+        Rect rect;
+    };
+    std::vector<Fill> fills;
+
+    auto fill_rect = [&](ColorRGBA color, const Rect& rect) {
+        for (auto iter = fills.rbegin(); iter != fills.rend(); ++iter) {
+            if (iter->color.u32 == color.u32 && iter->rect.right == rect.left &&
+                iter->rect.top == rect.top && iter->rect.bottom == rect.bottom) {
+                iter->rect.right = rect.right;
+                return;
+            }
+        }
+        fills.push_back(Fill{color, rect});
+    };
+
+    auto flush_fills = [&]() {
+        for (const Fill& fill : fills) {
+            canvas.ClearRect(fill.color, fill.rect);
+        }
+        fills.clear();
+    };
+
+    // Consecutive text chars sharing style, colors and size are drawn as a run through TextRenderer::DrawRun().
+    // Backgrounds and enclosures of a run are drawn before its chars.
+    struct {
+        CharStyle style = CharStyle::kCharStyleDefault;
+        ColorRGBA color;
+        ColorRGBA stroke_color;
+        int char_width = 0;
+        int char_height = 0;
+        std::vector<TextRunChar> chars;
+    } run;
+    std::vector<TextRenderStatus> run_statuses;
+    float run_stroke_width = stroke_width_ * x_magnification_;
+
+    auto flush_run = [&]() {
+        if (run.chars.empty()) {
+            return;
+        }
+        flush_fills();
+        ARIBCC_TRACE_SCOPE(tracer_.get(), "renderer", "TextRenderer::DrawRun");
+        text_renderer_->DrawRun(text_render_ctx, run.chars, run.style, run.color, run.stroke_color,
+                                run_stroke_width, run.char_width, run.char_height,
+                                TextRenderFallbackPolicy::kAutoFallback, run_statuses);
+        for (TextRenderStatus status : run_statuses) {
+            if (status == TextRenderStatus::kOK) {
+                succeed++;
+            } else {
+                record_text_error(status);
+            }
+        }
+        run.chars.clear();
+    };
+
     for (const CaptionChar& ch : region.chars) {
+        // Chars with an alternative PUA codepoint need manual fallback, draw them alone
+        bool is_run_char = ch.type == CaptionCharType::kText && !ch.pua_codepoint;
+        if (!is_run_char) {
+            flush_run();
+        }
+
         int section_x = ScaleX(ch.x) - ScaleX(region.x);
         int section_y = ScaleY(ch.y) - ScaleY(region.y);
         Rect section_rect(section_x,
@@ -127,7 +571,7 @@ auto RegionRenderer::RenderCaptionRegion(const CaptionRegion& region,
 
         // Draw background if not disabled
         if (!force_no_background_) {
-            canvas.ClearRect(ch.back_color, section_rect);
+            fill_rect(ch.back_color, section_rect);
         }
 
         // Draw enclosure if needed
@@ -135,32 +579,32 @@ auto RegionRenderer::RenderCaptionRegion(const CaptionRegion& region,
             int w = std::max(ScaleX(1), 1);  // use floor
             int h = std::max(ScaleY(1), 1);  // use floor
             if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleTop) {
-                canvas.ClearRect(ch.text_color,
-                                 Rect(section_rect.left,
-                                      section_rect.top,
-                                      section_rect.right,
-                                      section_rect.top + h));
+                fill_rect(ch.text_color,
+                          Rect(section_rect.left,
+                               section_rect.top,
+                               section_rect.right,
+                               section_rect.top + h));
             }
             if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleBottom) {
-                canvas.ClearRect(ch.text_color,
-                                 Rect(section_rect.left,
-                                      section_rect.bottom - h,
-                                      section_rect.right,
-                                      section_rect.bottom));
+                fill_rect(ch.text_color,
+                          Rect(section_rect.left,
+                               section_rect.bottom - h,
+                               section_rect.right,
+                               section_rect.bottom));
             }
             if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleLeft) {
-                canvas.ClearRect(ch.text_color,
-                                 Rect(section_rect.left,
-                                      section_rect.top,
-                                      section_rect.left + w,
-                                      section_rect.bottom));
+                fill_rect(ch.text_color,
+                          Rect(section_rect.left,
+                               section_rect.top,
+                               section_rect.left + w,
+                               section_rect.bottom));
             }
             if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleRight) {
-                canvas.ClearRect(ch.text_color,
-                                 Rect(section_rect.right - w,
-                                      section_rect.top,
-                                      section_rect.right,
-                                      section_rect.bottom));
+                fill_rect(ch.text_color,
+                          Rect(section_rect.right - w,
+                               section_rect.top,
+                               section_rect.right,
+                               section_rect.bottom));
             }
         }
 
@@ -171,6 +615,9 @@ auto RegionRenderer::RenderCaptionRegion(const CaptionRegion& region,
 
         if (char_width < 2 || char_height < 2) {
             continue;  // Too small, skip
+        } else if (IsGlyphInvisible(ch)) {
+            succeed++;  // Nothing to draw, e.g. transparent text
+            continue;
         }
 
         CaptionCharType type = ch.type;
@@ -186,7 +633,28 @@ auto RegionRenderer::RenderCaptionRegion(const CaptionRegion& region,
         }
 
         // Draw char
+        if (is_run_char) {
+            if (!run.chars.empty() && (run.style != style ||
+                                       run.color.u32 != ch.text_color.u32 ||
+                                       run.stroke_color.u32 != stroke_color.u32 ||
+                                       run.char_width != char_width ||
+                                       run.char_height != char_height)) {
+                flush_run();
+            }
+            if (run.chars.empty()) {
+                run.style = style;
+                run.color = ch.text_color;
+                run.stroke_color = stroke_color;
+                run.char_width = char_width;
+                run.char_height = char_height;
+            }
+            run.chars.push_back(TextRunChar{char_x, char_y, ch.codepoint, underline_info});
+            continue;
+        }
+
+        flush_fills();
         if (type == CaptionCharType::kText) {
+            ARIBCC_TRACE_SCOPE_SAMPLED(tracer_.get(), "renderer", "TextRenderer::DrawChar", kDrawCharTraceInterval);
             // Do automatic fallback rendering by default.
             TextRenderFallbackPolicy fallback_policy = TextRenderFallbackPolicy::kAutoFallback;
             if (ch.pua_codepoint) {
@@ -217,14 +685,7 @@ auto RegionRenderer::RenderCaptionRegion(const CaptionRegion& region,
             }
 
             if (status != TextRenderStatus::kOK){
-                log_->e("RegionRenderer: TextRenderer::DrawChar() returned error: %d", static_cast<int>(status));
-                if (status == TextRenderStatus::kFontNotFound) {
-                    has_font_not_found_error = true;
-                } else if (status == TextRenderStatus::kCodePointNotFound) {
-                    has_codepoint_not_found_error = true;
-                } else if (status == TextRenderStatus::kOtherError) {
-                    has_other_error = true;
-                }
+                record_text_error(status);
             }
         } else if (replace_drcs_ && type == CaptionCharType::kDRCSReplaced) {
             // Draw replaced DRCS (alternative ucs4)
@@ -274,6 +735,8 @@ auto RegionRenderer::RenderCaptionRegion(const CaptionRegion& region,
             }
         }
     }
+    flush_run();
+    flush_fills();
 
     text_renderer_->EndDraw(text_render_ctx);
 
@@ -288,11 +751,384 @@ auto RegionRenderer::RenderCaptionRegion(const CaptionRegion& region,
         }
     }
 
+    Rect bounds(0, 0, bitmap.width(), bitmap.height());
+    if (trim_images_) {
+        bounds = TrimTransparentBorders(bitmap, bitmap_pool_);
+    }
+
     Image image = Bitmap::ToImage(std::move(bitmap));
-    image.dst_x = caption_area_start_x_ + ScaleX(region.x);
-    image.dst_y = caption_area_start_y_ + ScaleY(region.y);
+    image.dst_x = bounds.left;
+    image.dst_y = bounds.top;
+
+    if (region_image_cache_.capacity()) {
+        // Share pixels between the cache and the result
+        Bitmap::ShareImageBuffer(image, bitmap_pool_);
+        region_image_cache_.Put(region_hash, image);
+    }
+
+    image.dst_x += caption_area_start_x_ + ScaleX(region.x);
+    image.dst_y += caption_area_start_y_ + ScaleY(region.y);
 
     return Ok(std::move(image));
 }
 
+auto RegionRenderer::RenderCaptionRegionQuads(const CaptionRegion& region,
+                                              const DRCSMap& drcs_map,
+                                              GlyphAtlas& atlas) -> Result<std::vector<GlyphQuad>, RegionRenderError> {
+    assert(text_renderer_ && plane_inited_ && caption_area_inited_);
+
+    size_t char_count = region.chars.size();
+    size_t succeed = 0;
+    bool has_font_not_found_error = false;
+    bool has_codepoint_not_found_error = false;
+
+    if (ScaleWidth(region.width, region.x) < 3 || ScaleHeight(region.height, region.y) < 3) {
+        return Err(RegionRenderError::kImageTooSmall);
+    } else if (IsRegionInvisible(region)) {
+        return Err(RegionRenderError::kImageTransparent);
+    }
+
+    // Quads are positioned inside the renderer frame, rather than the region
+    int origin_x = caption_area_start_x_ + ScaleX(region.x);
+    int origin_y = caption_area_start_y_ + ScaleY(region.y);
+
+    std::vector<GlyphQuad> quads;
+
+    // Quads are clipped by the region, same as drawing into the region bitmap
+    Rect region_rect(0, 0, ScaleWidth(region.width, region.x), ScaleHeight(region.height, region.y));
+
+    auto push_solid = [&](ColorRGBA color, const Rect& rect) {
+        Rect clipped = Rect::ClipRect(rect, region_rect);
+        if (clipped.width() <= 0 || clipped.height() <= 0) {
+            return;
+        }
+        GlyphQuad quad;
+        quad.type = GlyphQuadType::kSolid;
+        quad.width = clipped.width();
+        quad.height = clipped.height();
+        quad.dst_x = origin_x + clipped.left;
+        quad.dst_y = origin_y + clipped.top;
+        quad.color = color;
+        quads.push_back(quad);
+    };
+
+    auto push_mask = [&](GlyphQuadType type, const GlyphAtlasKey& key, const GlyphMask& mask,
+                         ColorRGBA color, int x, int y) -> bool {
+        if (mask.width <= 0 || mask.height <= 0) {
+            return true;
+        }
+        Rect clipped = Rect::ClipRect(Rect(x, y, x + mask.width, y + mask.height), region_rect);
+        if (clipped.width() <= 0 || clipped.height() <= 0) {
+            return true;
+        }
+        std::optional<Rect> atlas_rect = atlas.Insert(key, mask);
+        if (!atlas_rect) {
+            return false;
+        }
+        GlyphQuad quad;
+        quad.type = type;
+        quad.atlas_x = atlas_rect->left + (clipped.left - x);
+        quad.atlas_y = atlas_rect->top + (clipped.top - y);
+        quad.width = clipped.width();
+        quad.height = clipped.height();
+        quad.dst_x = origin_x + clipped.left;
+        quad.dst_y = origin_y + clipped.top;
+        quad.color = color;
+        quads.push_back(quad);
+        return true;
+    };
+
+    for (const CaptionChar& ch : region.chars) {
+        int section_x = ScaleX(ch.x) - ScaleX(region.x);
+        int section_y = ScaleY(ch.y) - ScaleY(region.y);
+        Rect section_rect(section_x,
+                          section_y,
+                          section_x + ScaleWidth(ch.section_width(), ch.x),
+                          section_y + ScaleHeight(ch.section_height(), ch.y));
+        if (section_rect.width() < 3 || section_rect.height() < 3) {
+            continue;  // Too small, skip
+        }
+
+        // Background if not disabled
+        if (!force_no_background_ && ch.back_color.a) {
+            push_solid(ch.back_color, section_rect);
+        }
+
+        // Enclosure if needed
+        if (ch.enclosure_style) {
+            int w = std::max(ScaleX(1), 1);  // use floor
+            int h = std::max(ScaleY(1), 1);  // use floor
+            if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleTop) {
+                push_solid(ch.text_color,
+                           Rect(section_rect.left, section_rect.top, section_rect.right, section_rect.top + h));
+            }
+            if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleBottom) {
+                push_solid(ch.text_color,
+                           Rect(section_rect.left, section_rect.bottom - h, section_rect.right, section_rect.bottom));
+            }
+            if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleLeft) {
+                push_solid(ch.text_color,
+                           Rect(section_rect.left, section_rect.top, section_rect.left + w, section_rect.bottom));
+            }
+            if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleRight) {
+                push_solid(ch.text_color,
+                           Rect(section_rect.right - w, section_rect.top, section_rect.right, section_rect.bottom));
+            }
+        }
+
+        int char_x = ScaleX((float)(ch.x - region.x) + (float)ch.char_horizontal_spacing * ch.char_horizontal_scale / 2);
+        int char_y = ScaleY((float)(ch.y - region.y) + (float)ch.char_vertical_spacing * ch.char_vertical_scale / 2);
+        int char_width = ScaleWidth((float)ch.char_width * ch.char_horizontal_scale);
+        int char_height = ScaleHeight((float)ch.char_height * ch.char_vertical_scale);
+
+        if (char_width < 2 || char_height < 2) {
+            continue;  // Too small, skip
+        }
+
+        CaptionCharType type = ch.type;
+        CharStyle style = ch.style;
+        ColorRGBA stroke_color = ch.stroke_color;
+        float stroke_width = stroke_width_ * x_magnification_;
+        UnderlineInfo underline_info{section_rect.left, section_rect.width()};
+
+        if (force_stroke_text_ && !(ch.style & CharStyle::kCharStyleStroke)) {
+            style = static_cast<CharStyle>(ch.style | CharStyle::kCharStyleStroke);
+            // Use background color for stroke text when forcing stroke text
+            stroke_color = ch.back_color;
+        }
+
+        std::optional<Result<RasterizedChar, TextRenderStatus>> rasterized;
+
+        if (type == CaptionCharType::kText) {
+            TextRenderFallbackPolicy fallback_policy = TextRenderFallbackPolicy::kAutoFallback;
+            if (ch.pua_codepoint) {
+                fallback_policy = TextRenderFallbackPolicy::kFailOnCodePointNotFound;
+            }
+            rasterized = text_renderer_->RasterizeChar(char_x, char_y, ch.codepoint, style, stroke_width,
+                                                       char_width, char_height, underline_info, fallback_policy);
+            if (ch.pua_codepoint && rasterized->is_err() &&
+                rasterized->error() == TextRenderStatus::kCodePointNotFound) {
+                rasterized = text_renderer_->RasterizeChar(char_x, char_y, ch.pua_codepoint, style, stroke_width,
+                                                           char_width, char_height, underline_info,
+                                                           TextRenderFallbackPolicy::kAutoFallback);
+                if (rasterized->is_err() && rasterized->error() == TextRenderStatus::kCodePointNotFound) {
+                    rasterized = text_renderer_->RasterizeChar(char_x, char_y, ch.codepoint, style, stroke_width,
+                                                               char_width, char_height, underline_info,
+                                                               TextRenderFallbackPolicy::kAutoFallback);
+                }
+            }
+        } else if (replace_drcs_ && type == CaptionCharType::kDRCSReplaced) {
+            rasterized = text_renderer_->RasterizeChar(char_x, char_y, ch.codepoint, style, stroke_width,
+                                                       char_width, char_height, underline_info,
+                                                       TextRenderFallbackPolicy::kAutoFallback);
+            if (rasterized->is_err()) {
+                // Fallback to DRCS rendering
+                type = CaptionCharType::kDRCS;
+            }
+        } else if (!replace_drcs_) {
+            // if DRCS replacement is disabled, force fallback to DRCS rendering
+            type = CaptionCharType::kDRCS;
+        }
+
+        if (rasterized && rasterized->is_ok()) {
+            const RasterizedChar& rc = rasterized->value();
+            if (rc.glyph) {
+                if (rc.underline) {
+                    push_solid(ch.text_color, rc.underline.value());
+                }
+                GlyphAtlasKey key;
+                key.glyph = rc.glyph_key;
+                if (rc.glyph->border) {
+                    key.type = GlyphAtlasKeyType::kGlyphBorder;
+                    if (!push_mask(GlyphQuadType::kBorder, key, rc.glyph->border.value(),
+                                   stroke_color, rc.border_x, rc.border_y)) {
+                        return Err(RegionRenderError::kAtlasFull);
+                    }
+                }
+                key.type = GlyphAtlasKeyType::kGlyphFill;
+                if (!push_mask(GlyphQuadType::kFill, key, rc.glyph->fill,
+                               ch.text_color, rc.fill_x, rc.fill_y)) {
+                    return Err(RegionRenderError::kAtlasFull);
+                }
+            }
+            succeed++;
+        } else if (rasterized && type != CaptionCharType::kDRCS) {
+            TextRenderStatus status = rasterized->error();
+            log_->e("RegionRenderer: TextRenderer::RasterizeChar() returned error: %d", static_cast<int>(status));
+            if (status == TextRenderStatus::kFontNotFound) {
+                has_font_not_found_error = true;
+            } else if (status == TextRenderStatus::kCodePointNotFound) {
+                has_codepoint_not_found_error = true;
+            }
+        }
+
+        if (type == CaptionCharType::kDRCS) {
+            auto iter = drcs_map.find(ch.drcs_code);
+            if (iter == drcs_map.end()) {
+                log_->e("RegionRenderer: Missing DRCS for drcs_code %u", ch.drcs_code);
+                continue;
+            }
+            const DRCS& drcs = iter->second;
+            if (drcs.width == 0 || drcs.height == 0 || drcs.pixels.empty()) {
+                log_->e("RegionRenderer: Invalid DRCS for drcs_code %u", ch.drcs_code);
+                continue;
+            }
+
+            bool has_stroke = (style & CharStyle::kCharStyleStroke) && stroke_width > 0;
+            int sw = has_stroke ? static_cast<int>(stroke_width) : 0;
+            std::shared_ptr<const CachedGlyph> scaled = drcs_renderer_.GetScaledMask(drcs, char_width, char_height, sw);
+            const GlyphMask& mask = scaled->fill;
+
+            GlyphAtlasKey key;
+            key.type = GlyphAtlasKeyType::kDRCSFill;
+            key.glyph.pixel_width = char_width;
+            key.glyph.pixel_height = char_height;
+            if (drcs.md5.empty()) {
+                key.drcs.assign(drcs.pixels.begin(), drcs.pixels.end());
+            } else {
+                key.drcs = drcs.md5;
+            }
+            key.drcs_width = drcs.width;
+            key.drcs_height = drcs.height;
+            key.drcs_depth = drcs.depth;
+            key.drcs_scale_filter = static_cast<uint8_t>(drcs_scale_filter_);
+
+            if (scaled->border) {
+                const GlyphMask& border = scaled->border.value();
+                GlyphAtlasKey border_key = key;
+                border_key.type = GlyphAtlasKeyType::kDRCSBorder;
+                border_key.glyph.stroke_width = sw;
+                border_key.glyph.stroke_mode = static_cast<uint8_t>(stroke_mode_);
+                if (!push_mask(GlyphQuadType::kBorder, border_key, border, stroke_color,
+                               char_x + border.left, char_y + border.top)) {
+                    return Err(RegionRenderError::kAtlasFull);
+                }
+            }
+            if (!push_mask(GlyphQuadType::kFill, key, mask, ch.text_color, char_x, char_y)) {
+                return Err(RegionRenderError::kAtlasFull);
+            }
+            succeed++;
+        }
+    }
+
+    // If there's no successfully rendered char, return RegionRenderError
+    if (char_count > 0 && succeed == 0) {
+        if (has_font_not_found_error) {
+            return Err(RegionRenderError::kFontNotFound);
+        } else if (has_codepoint_not_found_error) {
+            return Err(RegionRenderError::kCodePointNotFound);
+        } else {
+            return Err(RegionRenderError::kOtherError);
+        }
+    }
+
+    return Ok(std::move(quads));
+}
+
+LayoutRegion RegionRenderer::LayoutCaptionRegion(const CaptionRegion& region) const {
+    assert(plane_inited_ && caption_area_inited_);
+
+    // Same geometry as RenderCaptionRegion(), offset by the position of the region inside the frame
+    int origin_x = caption_area_start_x_ + ScaleX(region.x);
+    int origin_y = caption_area_start_y_ + ScaleY(region.y);
+
+    LayoutRegion layout;
+    layout.x = origin_x;
+    layout.y = origin_y;
+    layout.width = ScaleWidth(region.width, region.x);
+    layout.height = ScaleHeight(region.height, region.y);
+    layout.is_ruby = region.is_ruby;
+    layout.chars.reserve(region.chars.size());
+
+    int line_width = std::max(ScaleX(1), 1);
+    int line_height = std::max(ScaleY(1), 1);
+
+    for (const CaptionChar& ch : region.chars) {
+        int section_x = ScaleX(ch.x) - ScaleX(region.x);
+        int section_y = ScaleY(ch.y) - ScaleY(region.y);
+        Rect section_rect(origin_x + section_x,
+                          origin_y + section_y,
+                          origin_x + section_x + ScaleWidth(ch.section_width(), ch.x),
+                          origin_y + section_y + ScaleHeight(ch.section_height(), ch.y));
+        if (section_rect.width() < 3 || section_rect.height() < 3) {
+            continue;  // Too small, skipped by rendering as well
+        }
+
+        int char_x = ScaleX((float)(ch.x - region.x) + (float)ch.char_horizontal_spacing * ch.char_horizontal_scale / 2);
+        int char_y = ScaleY((float)(ch.y - region.y) + (float)ch.char_vertical_spacing * ch.char_vertical_scale / 2);
+        int char_width = ScaleWidth((float)ch.char_width * ch.char_horizontal_scale);
+        int char_height = ScaleHeight((float)ch.char_height * ch.char_vertical_scale);
+
+        if (ch.enclosure_style) {
+            auto add_enclosure = [&](const Rect& rect) {
+                layout.enclosures.push_back(LayoutRect{rect.left, rect.top, rect.width(), rect.height(), ch.text_color});
+            };
+            const Rect& r = section_rect;
+            if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleTop) {
+                add_enclosure(Rect(r.left, r.top, r.right, r.top + line_height));
+            }
+            if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleBottom) {
+                add_enclosure(Rect(r.left, r.bottom - line_height, r.right, r.bottom));
+            }
+            if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleLeft) {
+                add_enclosure(Rect(r.left, r.top, r.left + line_width, r.bottom));
+            }
+            if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleRight) {
+                add_enclosure(Rect(r.right - line_width, r.top, r.right, r.bottom));
+            }
+        }
+
+        if (char_width < 2 || char_height < 2) {
+            continue;  // Too small, only background and enclosure are drawn
+        }
+
+        LayoutChar& out = layout.chars.emplace_back();
+        out.type = ch.type;
+        if (!replace_drcs_ && ch.type == CaptionCharType::kDRCSReplaced) {
+            out.type = CaptionCharType::kDRCS;
+        }
+        out.codepoint = ch.codepoint;
+        out.pua_codepoint = ch.pua_codepoint;
+        out.drcs_code = ch.drcs_code;
+        out.section_x = section_rect.left;
+        out.section_y = section_rect.top;
+        out.section_width = section_rect.width();
+        out.section_height = section_rect.height();
+        out.char_x = origin_x + char_x;
+        out.char_y = origin_y + char_y;
+        out.char_width = char_width;
+        out.char_height = char_height;
+        out.style = ch.style;
+        out.enclosure_style = ch.enclosure_style;
+        out.text_color = ch.text_color;
+        out.back_color = force_no_background_ ? ColorRGBA() : ch.back_color;
+        out.stroke_color = ch.stroke_color;
+
+        if (force_stroke_text_ && !(ch.style & CharStyle::kCharStyleStroke)) {
+            out.style = static_cast<CharStyle>(ch.style | CharStyle::kCharStyleStroke);
+            out.stroke_color = ch.back_color;
+        }
+        if (out.style & CharStyle::kCharStyleStroke) {
+            out.stroke_width = stroke_width_ * x_magnification_;
+        }
+
+        if (out.style & CharStyle::kCharStyleUnderline) {
+            // Join with the underline of the previous char if adjacent
+            int underline_y = out.char_y + char_height - line_height;
+            if (!layout.underlines.empty()) {
+                LayoutRect& last = layout.underlines.back();
+                if (last.x + last.width == section_rect.left && last.y == underline_y &&
+                        last.height == line_height && last.color.u32 == ch.text_color.u32) {
+                    last.width += section_rect.width();
+                    continue;
+                }
+            }
+            layout.underlines.push_back(LayoutRect{section_rect.left, underline_y, section_rect.width(), line_height,
+                                                   ch.text_color});
+        }
+    }
+
+    return layout;
+}
+
 }  // namespace aribcaption
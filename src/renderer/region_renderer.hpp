@@ -23,15 +23,21 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <optional>
 #include <unordered_map>
 #include "aribcaption/caption.hpp"
 #include "aribcaption/context.hpp"
 #include "aribcaption/image.hpp"
 #include "base/logger.hpp"
+#include "base/metrics.hpp"
 #include "base/result.hpp"
+#include "base/tracer.hpp"
 #include "renderer/drcs_renderer.hpp"
+#include "renderer/bitmap_pool.hpp"
 #include "renderer/font_provider.hpp"
+#include "renderer/glyph_atlas.hpp"
 #include "renderer/rect.hpp"
+#include "renderer/region_image_cache.hpp"
 #include "renderer/text_renderer.hpp"
 
 namespace aribcaption {
@@ -40,6 +46,8 @@ enum class RegionRenderError {
     kFontNotFound,
     kCodePointNotFound,
     kImageTooSmall,
+    kImageTransparent,  // Nothing visible in the region, skipped like kImageTooSmall
+    kAtlasFull,
     kOtherError,
 };
 
@@ -57,10 +65,52 @@ public:
     void SetStrokeWidth(float dots);
     void SetReplaceDRCS(bool replace);
     void SetForceStrokeText(bool force_stroke);
+    void SetStrokeMode(StrokeMode mode);
+    void SetTextHinting(TextHinting hinting);
+    void SetDRCSScaleFilter(DRCSScaleFilter filter);
+    void SetDistanceFieldGlyphs(bool enable);
     void SetForceNoBackground(bool force_no_background);
+    void SetTrimImages(bool trim);
+    void SetGlyphCacheLimit(size_t limit_bytes);
+    [[nodiscard]]
+    GlyphCacheStats GetGlyphCacheStats() const;
+    void SetPersistentGlyphCache(std::shared_ptr<PersistentGlyphCache> cache);
+    // Release caches in graded steps, see Renderer::TrimMemory()
+    void TrimMemory(MemoryTrimLevel level);
+    // Add memory held by the caches and the text renderer into usage
+    void AddMemoryUsage(RendererMemoryUsage& usage) const;
+    // Fill in the timings of Initialize() and of the text renderer's first font loading
+    void GetStartupTimings(RendererStartupTimings& timings) const;
+    void SetRegionImageCacheSize(size_t count);
+    void ClearRegionImageCache();
+    void SetBitmapPool(BitmapPool* pool);
+    // Apply rendering settings of another instance, e.g. for rendering regions in parallel
+    void CopySettingsFrom(const RegionRenderer& other);
+    // Take over font language, font family, loaded faces and cached glyphs of another instance initialized
+    // with the same types, so that rendering doesn't start cold. Settings are not copied, see CopySettingsFrom()
+    bool CopyWarmStateFrom(const RegionRenderer& other);
+    [[nodiscard]]
+    uint64_t region_image_cache_hits() const { return region_image_cache_hits_; }
+    // Content hash of the region under current rendering settings, identical hash means identical image
+    [[nodiscard]]
+    uint64_t HashRegion(const CaptionRegion& region, const DRCSMap& drcs_map) const;
     auto RenderCaptionRegion(const CaptionRegion& region,
-                             const std::unordered_map<uint32_t, DRCS>& drcs_map) -> Result<Image, RegionRenderError>;
+                             const DRCSMap& drcs_map,
+                             std::optional<uint64_t> region_hash = std::nullopt) -> Result<Image, RegionRenderError>;
+    auto RenderCaptionRegionQuads(const CaptionRegion& region,
+                                  const DRCSMap& drcs_map,
+                                  GlyphAtlas& atlas) -> Result<std::vector<GlyphQuad>, RegionRenderError>;
+    // Positions of the region inside the renderer frame, without rasterizing. Doesn't need fonts.
+    [[nodiscard]]
+    LayoutRegion LayoutCaptionRegion(const CaptionRegion& region) const;
 private:
+    // Whether the glyph of the char leaves no visible pixel, e.g. spaces or transparent text without stroke
+    [[nodiscard]]
+    bool IsGlyphInvisible(const CaptionChar& ch) const;
+    // Whether the region would result in an entirely transparent image
+    [[nodiscard]]
+    bool IsRegionInvisible(const CaptionRegion& region) const;
+
     template <typename T>
     [[nodiscard]]
     int ScaleX(T x) const {
@@ -90,10 +140,14 @@ public:
 private:
     Context& context_;
     std::shared_ptr<Logger> log_;
+    std::shared_ptr<Metrics> metrics_;
+    std::shared_ptr<Tracer> tracer_;
 
     std::unique_ptr<FontProvider> font_provider_;
     std::unique_ptr<TextRenderer> text_renderer_;
     DRCSRenderer drcs_renderer_;
+    uint64_t font_provider_init_us_ = 0;
+    uint64_t text_renderer_init_us_ = 0;
 
     bool plane_inited_ = false;
     int plane_width_ = 0;
@@ -108,10 +162,25 @@ private:
     float stroke_width_ = 1.5f;
     bool replace_drcs_ = true;
     bool force_stroke_text_ = false;
+    StrokeMode stroke_mode_ = StrokeMode::kOutline;
+    TextHinting text_hinting_ = TextHinting::kDefault;
+    DRCSScaleFilter drcs_scale_filter_ = DRCSScaleFilter::kNearest;
+    bool distance_field_glyphs_ = false;
     bool force_no_background_ = false;
+    bool trim_images_ = false;
+    std::optional<size_t> glyph_cache_limit_;
+    std::shared_ptr<PersistentGlyphCache> persistent_glyph_cache_;
 
     float x_magnification_ = 0.0f;
     float y_magnification_ = 0.0f;
+
+    uint32_t font_language_ = 0;
+    uint64_t font_family_hash_ = 0;
+
+    RegionImageCache region_image_cache_;
+    uint64_t region_image_cache_hits_ = 0;
+
+    BitmapPool* bitmap_pool_ = nullptr;  // Owned by RendererImpl
 };
 
 }  // namespace aribcaption
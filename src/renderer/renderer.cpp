@@ -35,6 +35,10 @@ bool Renderer::Initialize(CaptionType caption_type,
     return pimpl_->Initialize(caption_type, font_provider_type, text_renderer_type);
 }
 
+bool Renderer::InitializeFrom(Renderer& other) {
+    return pimpl_->InitializeFrom(*other.pimpl_);
+}
+
 void Renderer::SetStrokeWidth(float dots) {
     pimpl_->SetStrokeWidth(dots);
 }
@@ -47,6 +51,18 @@ void Renderer::SetForceStrokeText(bool force_stroke) {
     pimpl_->SetForceStrokeText(force_stroke);
 }
 
+void Renderer::SetStrokeMode(StrokeMode mode) {
+    pimpl_->SetStrokeMode(mode);
+}
+
+void Renderer::SetQualityPreset(QualityPreset preset) {
+    pimpl_->SetQualityPreset(preset);
+}
+
+void Renderer::SetDistanceFieldGlyphs(bool enable) {
+    pimpl_->SetDistanceFieldGlyphs(enable);
+}
+
 void Renderer::SetForceNoRuby(bool force_no_ruby) {
     pimpl_->SetForceNoRuby(force_no_ruby);
 }
@@ -55,10 +71,34 @@ void Renderer::SetForceNoBackground(bool force_no_background) {
     pimpl_->SetForceNoBackground(force_no_background);
 }
 
+void Renderer::SetTrimRegionImages(bool trim) {
+    pimpl_->SetTrimRegionImages(trim);
+}
+
 void Renderer::SetMergeRegionImages(bool merge) {
     pimpl_->SetMergeRegionImages(merge);
 }
 
+void Renderer::SetOutputPixelFormat(PixelFormat format) {
+    pimpl_->SetOutputPixelFormat(format);
+}
+
+void Renderer::SetRunLengthEncodedImages(bool enable) {
+    pimpl_->SetRunLengthEncodedImages(enable);
+}
+
+void Renderer::SetShareImageBuffers(bool share) {
+    pimpl_->SetShareImageBuffers(share);
+}
+
+void Renderer::SetSuperimposeLayer(bool enable) {
+    pimpl_->SetSuperimposeLayer(enable);
+}
+
+bool Renderer::SetImageAlignment(size_t row_alignment, size_t base_alignment) {
+    return pimpl_->SetImageAlignment(row_alignment, base_alignment);
+}
+
 bool Renderer::SetDefaultFontFamily(const std::vector<std::string>& font_family, bool force_default) {
     return pimpl_->SetDefaultFontFamily(font_family, force_default);
 }
@@ -75,10 +115,74 @@ bool Renderer::SetMargins(int top, int bottom, int left, int right) {
     return pimpl_->SetMargins(top, bottom, left, right);
 }
 
+void Renderer::SetMaxRenderMagnification(float magnification) {
+    pimpl_->SetMaxRenderMagnification(magnification);
+}
+
+void Renderer::SetRenderTimeBudget(int64_t budget_us) {
+    pimpl_->SetRenderTimeBudget(budget_us);
+}
+
 void Renderer::SetStoragePolicy(CaptionStoragePolicy policy, std::optional<size_t> upper_limit) {
     pimpl_->SetStoragePolicy(policy, upper_limit);
 }
 
+void Renderer::SetCompactCaptionStorage(bool compact) {
+    pimpl_->SetCompactCaptionStorage(compact);
+}
+
+void Renderer::SetColdCaptionStorage(bool enable, int64_t hot_window) {
+    pimpl_->SetColdCaptionStorage(enable, hot_window);
+}
+
+size_t Renderer::GetCaptionStorageBytes() {
+    return pimpl_->GetCaptionStorageBytes();
+}
+
+void Renderer::SetGlyphCacheLimit(size_t limit_bytes) {
+    pimpl_->SetGlyphCacheLimit(limit_bytes);
+}
+
+bool Renderer::SetGlyphCacheFile(const std::string& filename) {
+    return pimpl_->SetGlyphCacheFile(filename);
+}
+
+void Renderer::SetRegionImageCacheSize(size_t count) {
+    pimpl_->SetRegionImageCacheSize(count);
+}
+
+bool Renderer::SetRegionRenderThreads(size_t count) {
+    return pimpl_->SetRegionRenderThreads(count);
+}
+
+GlyphCacheStats Renderer::GetGlyphCacheStats() const {
+    return pimpl_->GetGlyphCacheStats();
+}
+
+void Renderer::SetBitmapPoolLimit(size_t limit_bytes) {
+    pimpl_->SetBitmapPoolLimit(limit_bytes);
+}
+
+BitmapPoolStats Renderer::GetBitmapPoolStats() const {
+    return pimpl_->GetBitmapPoolStats();
+}
+
+void Renderer::TrimMemory(MemoryTrimLevel level) {
+    pimpl_->TrimMemory(level);
+}
+
+RendererMemoryUsage Renderer::GetMemoryUsage() const {
+    return pimpl_->GetMemoryUsage();
+}
+
+RendererStartupTimings Renderer::GetStartupTimings() const {
+    return pimpl_->GetStartupTimings();
+}
+
+void Renderer::RecycleImages(std::vector<Image>&& images) {
+    pimpl_->RecycleImages(std::move(images));
+}
+
 bool Renderer::AppendCaption(const Caption& caption) {
     return pimpl_->AppendCaption(caption);
 }
@@ -87,14 +191,68 @@ bool Renderer::AppendCaption(Caption&& caption) {
     return pimpl_->AppendCaption(std::move(caption));
 }
 
+bool Renderer::AppendCaptions(std::vector<Caption>&& captions) {
+    return pimpl_->AppendCaptions(std::move(captions));
+}
+
+bool Renderer::ExtendCaption(int64_t pts, int64_t duration) {
+    return pimpl_->ExtendCaption(pts, duration);
+}
+
 RenderStatus Renderer::TryRender(int64_t pts) {
     return pimpl_->TryRender(pts);
 }
 
+RenderStatus Renderer::RenderForFrameSizes(int64_t pts,
+                                           const std::vector<RenderTargetSize>& sizes,
+                                           std::vector<RenderResult>& out_results) {
+    return pimpl_->RenderForFrameSizes(pts, sizes, out_results);
+}
+
+size_t Renderer::RenderBatch(int64_t pts_begin, int64_t pts_end, std::vector<RenderResult>& out_results) {
+    return pimpl_->RenderBatch(pts_begin, pts_end, out_results);
+}
+
+int64_t Renderer::GetNextChangePTS(int64_t pts) {
+    return pimpl_->GetNextChangePTS(pts);
+}
+
+size_t Renderer::Prerender(int64_t pts_begin, int64_t pts_end) {
+    return pimpl_->Prerender(pts_begin, pts_end);
+}
+
+void Renderer::SetAsyncRendering(bool enable, std::function<void(int64_t pts)> on_ready) {
+    pimpl_->SetAsyncRendering(enable, std::move(on_ready));
+}
+
+bool Renderer::Preload(uint32_t iso6392_language_code, bool prerasterize, bool in_background) {
+    return pimpl_->Preload(iso6392_language_code, prerasterize, in_background);
+}
+
 RenderStatus Renderer::Render(int64_t pts, RenderResult& out_result) {
     return pimpl_->Render(pts, out_result);
 }
 
+RenderStatus Renderer::RenderInto(int64_t pts, const FrameBuffer& frame) {
+    return pimpl_->RenderInto(pts, frame);
+}
+
+RenderStatus Renderer::RenderLayers(int64_t pts, RenderResult& out_caption, RenderResult& out_superimpose) {
+    return pimpl_->RenderLayers(pts, out_caption, out_superimpose);
+}
+
+bool Renderer::SetGlyphAtlasSize(int width, int height) {
+    return pimpl_->SetGlyphAtlasSize(width, height);
+}
+
+RenderStatus Renderer::RenderGlyphAtlas(int64_t pts, GlyphAtlasRenderResult& out_result) {
+    return pimpl_->RenderGlyphAtlas(pts, out_result);
+}
+
+RenderStatus Renderer::RenderLayout(int64_t pts, LayoutResult& out_result) {
+    return pimpl_->RenderLayout(pts, out_result);
+}
+
 void Renderer::Flush() {
     pimpl_->Flush();
 }
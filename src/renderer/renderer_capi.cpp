@@ -17,7 +17,9 @@
  */
 
 #include <cstdlib>
-#include "aribcaption/aligned_alloc.hpp"
+#include <cstring>
+#include <memory>
+#include <vector>
 #include "aribcaption/renderer.h"
 #include "aribcaption/renderer.hpp"
 #include "renderer/renderer_impl.hpp"
@@ -64,7 +66,7 @@ static Caption ConstructCaptionFromCAPI(const aribcc_caption_t* src) {
     }
 
     if (src->drcs_map) {
-        auto drcs_map = reinterpret_cast<std::unordered_map<uint32_t, DRCS>*>(src->drcs_map);
+        auto drcs_map = reinterpret_cast<DRCSMap*>(src->drcs_map);
         caption.drcs_map = *drcs_map;
     }
 
@@ -79,10 +81,14 @@ void aribcc_render_result_cleanup(aribcc_render_result_t* render_result) {
             aribcc_image_t* image = &render_result->images[i];
             aribcc_image_cleanup(image);
         }
-        free(render_result->images);
+        MemoryAllocator::Free(render_result->images);
         render_result->images = nullptr;
         render_result->image_count = 0;
     }
+    if (render_result->image_changed) {
+        MemoryAllocator::Free(render_result->image_changed);
+        render_result->image_changed = nullptr;
+    }
 }
 
 aribcc_renderer_t* aribcc_renderer_alloc(aribcc_context_t* context) {
@@ -106,6 +112,12 @@ bool aribcc_renderer_initialize(aribcc_renderer_t* renderer,
                             static_cast<TextRendererType>(text_renderer_type));
 }
 
+bool aribcc_renderer_initialize_from(aribcc_renderer_t* renderer, aribcc_renderer_t* other) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    auto other_impl = reinterpret_cast<RendererImpl*>(other);
+    return impl->InitializeFrom(*other_impl);
+}
+
 void aribcc_renderer_set_stroke_width(aribcc_renderer_t* renderer, float dots) {
     auto impl = reinterpret_cast<RendererImpl*>(renderer);
     impl->SetStrokeWidth(dots);
@@ -121,6 +133,21 @@ void aribcc_renderer_set_force_stroke_text(aribcc_renderer_t* renderer, bool for
     impl->SetForceStrokeText(force_stroke);
 }
 
+void aribcc_renderer_set_stroke_mode(aribcc_renderer_t* renderer, aribcc_stroke_mode_t mode) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetStrokeMode(static_cast<StrokeMode>(mode));
+}
+
+void aribcc_renderer_set_quality_preset(aribcc_renderer_t* renderer, aribcc_quality_preset_t preset) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetQualityPreset(static_cast<QualityPreset>(preset));
+}
+
+void aribcc_renderer_set_distance_field_glyphs(aribcc_renderer_t* renderer, bool enable) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetDistanceFieldGlyphs(enable);
+}
+
 void aribcc_renderer_set_force_no_ruby(aribcc_renderer_t* renderer, bool force_no_ruby) {
     auto impl = reinterpret_cast<RendererImpl*>(renderer);
     impl->SetForceNoRuby(force_no_ruby);
@@ -131,11 +158,36 @@ void aribcc_renderer_set_force_no_background(aribcc_renderer_t* renderer, bool f
     impl->SetForceNoBackground(force_no_background);
 }
 
+void aribcc_renderer_set_trim_region_images(aribcc_renderer_t* renderer, bool trim) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetTrimRegionImages(trim);
+}
+
 void aribcc_renderer_set_merge_region_images(aribcc_renderer_t* renderer, bool merge) {
     auto impl = reinterpret_cast<RendererImpl*>(renderer);
     impl->SetMergeRegionImages(merge);
 }
 
+void aribcc_renderer_set_superimpose_layer(aribcc_renderer_t* renderer, bool enable) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetSuperimposeLayer(enable);
+}
+
+void aribcc_renderer_set_output_pixel_format(aribcc_renderer_t* renderer, aribcc_pixelformat_t format) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetOutputPixelFormat(static_cast<PixelFormat>(format));
+}
+
+bool aribcc_renderer_set_image_alignment(aribcc_renderer_t* renderer, size_t row_alignment, size_t base_alignment) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    return impl->SetImageAlignment(row_alignment, base_alignment);
+}
+
+void aribcc_renderer_set_run_length_encoded_images(aribcc_renderer_t* renderer, bool enable) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetRunLengthEncodedImages(enable);
+}
+
 bool aribcc_renderer_set_default_font_family(aribcc_renderer_t* renderer,
                                              const char * const * font_family,
                                              size_t family_count,
@@ -176,6 +228,16 @@ bool aribcc_renderer_set_margins(aribcc_renderer_t* renderer, int top, int botto
     return impl->SetMargins(top, bottom, left, right);
 }
 
+void aribcc_renderer_set_max_render_magnification(aribcc_renderer_t* renderer, float magnification) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetMaxRenderMagnification(magnification);
+}
+
+void aribcc_renderer_set_render_time_budget(aribcc_renderer_t* renderer, int64_t budget_us) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetRenderTimeBudget(budget_us);
+}
+
 void aribcc_renderer_set_storage_policy(aribcc_renderer_t* renderer,
                                         aribcc_caption_storage_policy_t storage_policy,
                                         size_t upper_limit) {
@@ -183,41 +245,231 @@ void aribcc_renderer_set_storage_policy(aribcc_renderer_t* renderer,
     impl->SetStoragePolicy(static_cast<CaptionStoragePolicy>(storage_policy), upper_limit);
 }
 
+void aribcc_renderer_set_compact_caption_storage(aribcc_renderer_t* renderer, bool compact) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetCompactCaptionStorage(compact);
+}
+
+void aribcc_renderer_set_cold_caption_storage(aribcc_renderer_t* renderer, bool enable, int64_t hot_window) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetColdCaptionStorage(enable, hot_window);
+}
+
+size_t aribcc_renderer_get_caption_storage_bytes(aribcc_renderer_t* renderer) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    return impl->GetCaptionStorageBytes();
+}
+
+void aribcc_renderer_set_glyph_cache_limit(aribcc_renderer_t* renderer, size_t limit_bytes) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetGlyphCacheLimit(limit_bytes);
+}
+
+bool aribcc_renderer_set_glyph_cache_file(aribcc_renderer_t* renderer, const char* filename) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    return impl->SetGlyphCacheFile(filename ? filename : "");
+}
+
+void aribcc_renderer_set_region_image_cache_size(aribcc_renderer_t* renderer, size_t count) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetRegionImageCacheSize(count);
+}
+
+bool aribcc_renderer_set_region_render_threads(aribcc_renderer_t* renderer, size_t count) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    return impl->SetRegionRenderThreads(count);
+}
+
+void aribcc_renderer_get_glyph_cache_stats(aribcc_renderer_t* renderer, aribcc_glyph_cache_stats_t* out_stats) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    GlyphCacheStats stats = impl->GetGlyphCacheStats();
+
+    out_stats->hits = stats.hits;
+    out_stats->misses = stats.misses;
+    out_stats->entry_count = stats.entry_count;
+    out_stats->used_bytes = stats.used_bytes;
+    out_stats->limit_bytes = stats.limit_bytes;
+}
+
+void aribcc_renderer_set_bitmap_pool_limit(aribcc_renderer_t* renderer, size_t limit_bytes) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetBitmapPoolLimit(limit_bytes);
+}
+
+void aribcc_renderer_get_bitmap_pool_stats(aribcc_renderer_t* renderer, aribcc_bitmap_pool_stats_t* out_stats) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    BitmapPoolStats stats = impl->GetBitmapPoolStats();
+
+    out_stats->hits = stats.hits;
+    out_stats->misses = stats.misses;
+    out_stats->pooled_count = stats.pooled_count;
+    out_stats->pooled_bytes = stats.pooled_bytes;
+    out_stats->limit_bytes = stats.limit_bytes;
+}
+
+void aribcc_renderer_trim_memory(aribcc_renderer_t* renderer, aribcc_memory_trim_level_t level) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->TrimMemory(static_cast<MemoryTrimLevel>(level));
+}
+
+void aribcc_renderer_get_memory_usage(aribcc_renderer_t* renderer, aribcc_renderer_memory_usage_t* out_usage) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    RendererMemoryUsage usage = impl->GetMemoryUsage();
+
+    out_usage->caption_storage_bytes = usage.caption_storage_bytes;
+    out_usage->glyph_cache_bytes = usage.glyph_cache_bytes;
+    out_usage->drcs_cache_bytes = usage.drcs_cache_bytes;
+    out_usage->region_image_cache_bytes = usage.region_image_cache_bytes;
+    out_usage->rendered_image_bytes = usage.rendered_image_bytes;
+    out_usage->glyph_atlas_bytes = usage.glyph_atlas_bytes;
+    out_usage->bitmap_pool_bytes = usage.bitmap_pool_bytes;
+    out_usage->font_face_count = usage.font_face_count;
+}
+
+void aribcc_renderer_get_startup_timings(aribcc_renderer_t* renderer, aribcc_renderer_startup_timings_t* out_timings) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    RendererStartupTimings timings = impl->GetStartupTimings();
+
+    out_timings->initialize_us = timings.initialize_us;
+    out_timings->font_provider_init_us = timings.font_provider_init_us;
+    out_timings->text_renderer_init_us = timings.text_renderer_init_us;
+    out_timings->first_font_load_us = timings.first_font_load_us;
+    out_timings->first_render_us = timings.first_render_us;
+}
+
 bool aribcc_renderer_append_caption(aribcc_renderer_t* renderer, const aribcc_caption_t* caption) {
     auto impl = reinterpret_cast<RendererImpl*>(renderer);
     Caption cap = ConstructCaptionFromCAPI(caption);
     return impl->AppendCaption(std::move(cap));
 }
 
-static void ConvertImageToCAPI(const Image& image, aribcc_image_t* out_image) {
+bool aribcc_renderer_append_caption_handle(aribcc_renderer_t* renderer, aribcc_caption_handle_t* caption) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    std::unique_ptr<Caption> cap(reinterpret_cast<Caption*>(caption));
+    return impl->AppendCaption(std::move(*cap));
+}
+
+bool aribcc_renderer_append_captions(aribcc_renderer_t* renderer, const aribcc_caption_t* captions, size_t count) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    std::vector<Caption> caps;
+    caps.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        caps.push_back(ConstructCaptionFromCAPI(&captions[i]));
+    }
+    return impl->AppendCaptions(std::move(caps));
+}
+
+bool aribcc_renderer_extend_caption(aribcc_renderer_t* renderer, int64_t pts, int64_t duration) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    return impl->ExtendCaption(pts, duration);
+}
+
+// Returns false if out of memory, out_image is left empty in that case
+static bool ConvertImageToCAPI(const Image& image, BitmapPool& pool, aribcc_image_t* out_image) {
     out_image->width = image.width;
     out_image->height = image.height;
     out_image->stride = image.stride;
     out_image->dst_x = image.dst_x;
     out_image->dst_y = image.dst_y;
+    out_image->display_width = image.display_width;
+    out_image->display_height = image.display_height;
     out_image->pixel_format = static_cast<aribcc_pixelformat_t>(image.pixel_format);
 
-    if (!image.bitmap.empty()) {
-        out_image->bitmap_size = static_cast<uint32_t>(image.bitmap.size());
-        out_image->bitmap = reinterpret_cast<uint8_t*>(AlignedAlloc(out_image->bitmap_size, Image::kAlignedTo));
-        memcpy(out_image->bitmap, image.bitmap.data(), out_image->bitmap_size);
+    if (image.size()) {
+        out_image->bitmap = pool.AcquireCAPIBuffer(image.size());
+        if (!out_image->bitmap) {
+            aribcc_image_cleanup(out_image);
+            return false;
+        }
+        out_image->bitmap_size = static_cast<uint32_t>(image.size());
+        memcpy(out_image->bitmap, image.data(), out_image->bitmap_size);
+    }
+    if (!image.palette.empty()) {
+        out_image->palette = reinterpret_cast<aribcc_color_t*>(
+            pool.allocator().Allocate(image.palette.size() * sizeof(aribcc_color_t))
+        );
+        if (!out_image->palette) {
+            aribcc_image_cleanup(out_image);
+            return false;
+        }
+        out_image->palette_size = static_cast<uint32_t>(image.palette.size());
+        memcpy(out_image->palette, image.palette.data(), image.palette.size() * sizeof(aribcc_color_t));
+    }
+    if (!image.spans.empty()) {
+        out_image->spans = reinterpret_cast<aribcc_image_span_t*>(
+            pool.allocator().Allocate(image.spans.size() * sizeof(aribcc_image_span_t))
+        );
+        if (!out_image->spans) {
+            aribcc_image_cleanup(out_image);
+            return false;
+        }
+        out_image->span_count = static_cast<uint32_t>(image.spans.size());
+        memcpy(out_image->spans, image.spans.data(), image.spans.size() * sizeof(aribcc_image_span_t));
     }
+    return true;
 }
 
-static void ConvertRenderResultToCAPI(const RenderResult& result, aribcc_render_result_t* out_result) {
+static void BorrowImageToCAPI(const Image& image, aribcc_image_t* out_image) {
+    static_assert(sizeof(aribcc_image_span_t) == sizeof(ImageSpan));
+    out_image->width = image.width;
+    out_image->height = image.height;
+    out_image->stride = image.stride;
+    out_image->dst_x = image.dst_x;
+    out_image->dst_y = image.dst_y;
+    out_image->display_width = image.display_width;
+    out_image->display_height = image.display_height;
+    out_image->pixel_format = static_cast<aribcc_pixelformat_t>(image.pixel_format);
+    out_image->bitmap_size = static_cast<uint32_t>(image.size());
+    out_image->bitmap = image.size() ? const_cast<uint8_t*>(image.data()) : nullptr;
+    out_image->palette_size = static_cast<uint32_t>(image.palette.size());
+    out_image->palette = image.palette.empty() ? nullptr
+                                               : reinterpret_cast<aribcc_color_t*>(
+                                                     const_cast<ColorRGBA*>(image.palette.data()));
+    out_image->span_count = static_cast<uint32_t>(image.spans.size());
+    out_image->spans = image.spans.empty() ? nullptr
+                                           : reinterpret_cast<aribcc_image_span_t*>(
+                                                 const_cast<ImageSpan*>(image.spans.data()));
+}
+
+// Images of the superimpose layer, if any, follow the caption images.
+// Returns false if out of memory, out_result is left without images in that case.
+static bool ConvertRenderResultToCAPI(const RenderResult& result,
+                                      const std::vector<Image>& images,
+                                      const std::vector<Image>& superimpose_images,
+                                      BitmapPool& pool,
+                                      aribcc_render_result_t* out_result) {
     out_result->pts = result.pts;
     out_result->duration = result.duration;
-
-    if (!result.images.empty()) {
-        out_result->image_count = static_cast<uint32_t>(result.images.size());
-        out_result->images = reinterpret_cast<aribcc_image_t*>(calloc(out_result->image_count, sizeof(aribcc_image_t)));
+    out_result->region_cache_hits = result.region_cache_hits;
+    out_result->quality = static_cast<aribcc_render_quality_t>(result.quality);
+
+    if (!images.empty() || !superimpose_images.empty()) {
+        uint32_t image_count = static_cast<uint32_t>(images.size() + superimpose_images.size());
+        out_result->images = reinterpret_cast<aribcc_image_t*>(
+            pool.allocator().AllocateZeroed(image_count * sizeof(aribcc_image_t))
+        );
+        if (!out_result->images) {
+            return false;
+        }
+        out_result->image_count = image_count;
 
         for (uint32_t i = 0; i < out_result->image_count; i++) {
-            const Image& src = result.images[i];
+            const Image& src = i < images.size() ? images[i] : superimpose_images[i - images.size()];
             aribcc_image_t* dst = &out_result->images[i];
-            ConvertImageToCAPI(src, dst);
+            if (!ConvertImageToCAPI(src, pool, dst)) {
+                aribcc_render_result_cleanup(out_result);
+                return false;
+            }
         }
+
+        out_result->image_changed = reinterpret_cast<uint8_t*>(pool.allocator().Allocate(result.image_changed.size()));
+        if (!out_result->image_changed && !result.image_changed.empty()) {
+            aribcc_render_result_cleanup(out_result);
+            return false;
+        }
+        memcpy(out_result->image_changed, result.image_changed.data(), result.image_changed.size());
     }
+    return true;
 }
 
 aribcc_render_status_t aribcc_renderer_try_render(aribcc_renderer_t* renderer, int64_t pts) {
@@ -226,18 +478,169 @@ aribcc_render_status_t aribcc_renderer_try_render(aribcc_renderer_t* renderer, i
     return static_cast<aribcc_render_status_t>(status);
 }
 
+int64_t aribcc_renderer_get_next_change_pts(aribcc_renderer_t* renderer, int64_t pts) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    return impl->GetNextChangePTS(pts);
+}
+
+size_t aribcc_renderer_prerender(aribcc_renderer_t* renderer, int64_t pts_begin, int64_t pts_end) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    return impl->Prerender(pts_begin, pts_end);
+}
+
+bool aribcc_renderer_preload(aribcc_renderer_t* renderer,
+                             uint32_t iso6392_language_code,
+                             bool prerasterize,
+                             bool in_background) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    return impl->Preload(iso6392_language_code, prerasterize, in_background);
+}
+
+void aribcc_renderer_set_async_rendering(aribcc_renderer_t* renderer,
+                                         bool enable,
+                                         aribcc_render_ready_callback_t callback,
+                                         void* userdata) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    if (!callback) {
+        impl->SetAsyncRendering(enable, nullptr);
+        return;
+    }
+    impl->SetAsyncRendering(enable, [callback, userdata](int64_t pts) {
+        callback(pts, userdata);
+    });
+}
+
+aribcc_render_status_t aribcc_renderer_render_into(aribcc_renderer_t* renderer,
+                                                   int64_t pts,
+                                                   const aribcc_frame_buffer_t* frame) {
+    static_assert(sizeof(aribcc_frame_buffer_t) == sizeof(FrameBuffer));
+
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    RenderStatus status = impl->RenderInto(pts, *reinterpret_cast<const FrameBuffer*>(frame));
+    return static_cast<aribcc_render_status_t>(status);
+}
+
 aribcc_render_status_t aribcc_renderer_render(aribcc_renderer_t* renderer,
                                               int64_t pts,
                                               aribcc_render_result_t* out_result) {
     auto impl = reinterpret_cast<RendererImpl*>(renderer);
 
+    // Copy images from the renderer directly, avoid an intermediate copy
+    RenderResult result;
+    RenderStatus status = impl->RenderWithoutImages(pts, result);
+
+    memset(out_result, 0, sizeof(*out_result));
+
+    if (status == RenderStatus::kGotImage || status == RenderStatus::kGotImageUnchanged) {
+        if (!ConvertRenderResultToCAPI(result, impl->rendered_images(), impl->superimpose_images(),
+                                       impl->bitmap_pool(), out_result)) {
+            return ARIBCC_RENDER_STATUS_ERROR;
+        }
+    }
+
+    return static_cast<aribcc_render_status_t>(status);
+}
+
+aribcc_render_status_t aribcc_renderer_render_layers(aribcc_renderer_t* renderer,
+                                                     int64_t pts,
+                                                     aribcc_render_result_t* out_caption,
+                                                     aribcc_render_result_t* out_superimpose) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+
+    RenderResult caption_result;
+    RenderResult superimpose_result;
+    RenderStatus status = impl->RenderLayersWithoutImages(pts, caption_result, superimpose_result);
+
+    memset(out_caption, 0, sizeof(*out_caption));
+    memset(out_superimpose, 0, sizeof(*out_superimpose));
+
+    if (status == RenderStatus::kGotImage || status == RenderStatus::kGotImageUnchanged) {
+        const std::vector<Image> none;
+        if (!ConvertRenderResultToCAPI(caption_result, impl->rendered_images(), none,
+                                       impl->bitmap_pool(), out_caption) ||
+            !ConvertRenderResultToCAPI(superimpose_result, none, impl->superimpose_images(),
+                                       impl->bitmap_pool(), out_superimpose)) {
+            aribcc_render_result_cleanup(out_caption);
+            aribcc_render_result_cleanup(out_superimpose);
+            return ARIBCC_RENDER_STATUS_ERROR;
+        }
+    }
+
+    return static_cast<aribcc_render_status_t>(status);
+}
+
+aribcc_render_status_t aribcc_renderer_render_borrowed(aribcc_renderer_t* renderer,
+                                                       int64_t pts,
+                                                       aribcc_render_result_t* out_result) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+
     RenderResult result;
-    RenderStatus status = impl->Render(pts, result);
+    RenderStatus status = impl->RenderWithoutImages(pts, result);
+
+    memset(out_result, 0, sizeof(*out_result));
+
+    if (status == RenderStatus::kGotImage || status == RenderStatus::kGotImageUnchanged) {
+        const std::vector<Image>& images = impl->rendered_images();
+        const std::vector<Image>& superimpose_images = impl->superimpose_images();
+        std::vector<aribcc_image_t>& borrowed = impl->capi_borrowed_images();
+
+        borrowed.resize(images.size() + superimpose_images.size());
+        for (size_t i = 0; i < images.size(); i++) {
+            BorrowImageToCAPI(images[i], &borrowed[i]);
+        }
+        for (size_t i = 0; i < superimpose_images.size(); i++) {
+            BorrowImageToCAPI(superimpose_images[i], &borrowed[images.size() + i]);
+        }
+
+        out_result->pts = result.pts;
+        out_result->duration = result.duration;
+        out_result->region_cache_hits = result.region_cache_hits;
+        out_result->quality = static_cast<aribcc_render_quality_t>(result.quality);
+        if (!borrowed.empty()) {
+            out_result->images = borrowed.data();
+            out_result->image_count = static_cast<uint32_t>(borrowed.size());
+            out_result->image_changed = impl->rendered_images_changed().data();
+        }
+    }
+
+    return static_cast<aribcc_render_status_t>(status);
+}
+
+bool aribcc_renderer_set_glyph_atlas_size(aribcc_renderer_t* renderer, int width, int height) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    return impl->SetGlyphAtlasSize(width, height);
+}
+
+aribcc_render_status_t aribcc_renderer_render_glyph_atlas(aribcc_renderer_t* renderer,
+                                                          int64_t pts,
+                                                          aribcc_glyph_atlas_render_result_t* out_result) {
+    static_assert(sizeof(aribcc_glyph_quad_t) == sizeof(GlyphQuad));
+    static_assert(sizeof(aribcc_atlas_rect_t) == sizeof(AtlasRect));
+
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+
+    GlyphAtlasRenderResult& result = impl->capi_glyph_atlas_result();
+    RenderStatus status = impl->RenderGlyphAtlas(pts, result);
 
     memset(out_result, 0, sizeof(*out_result));
 
+    out_result->atlas_generation = result.atlas_generation;
+    out_result->atlas_width = result.atlas_width;
+    out_result->atlas_height = result.atlas_height;
+    out_result->atlas_pixels = result.atlas_pixels;
+
+    if (!result.dirty_rects.empty()) {
+        out_result->dirty_rects = reinterpret_cast<const aribcc_atlas_rect_t*>(result.dirty_rects.data());
+        out_result->dirty_rect_count = static_cast<uint32_t>(result.dirty_rects.size());
+    }
+
     if (status == RenderStatus::kGotImage || status == RenderStatus::kGotImageUnchanged) {
-        ConvertRenderResultToCAPI(result, out_result);
+        out_result->pts = result.pts;
+        out_result->duration = result.duration;
+        if (!result.quads.empty()) {
+            out_result->quads = reinterpret_cast<const aribcc_glyph_quad_t*>(result.quads.data());
+            out_result->quad_count = static_cast<uint32_t>(result.quads.size());
+        }
     }
 
     return static_cast<aribcc_render_status_t>(status);
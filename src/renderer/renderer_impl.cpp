@@ -16,27 +16,146 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <algorithm>
 #include <iterator>
+#include <limits>
+#include <string_view>
+#include <utility>
+#include "aribcaption/caption_view.hpp"
 #include "aribcaption/context.hpp"
+#include "base/lz_compress.hpp"
+#include "renderer/alphablend.hpp"
 #include "renderer/bitmap.hpp"
 #include "renderer/canvas.hpp"
+#include "renderer/frame_blender.hpp"
+#include "renderer/image_quantizer.hpp"
+#include "renderer/image_rle.hpp"
 #include "renderer/renderer_impl.hpp"
 
 namespace aribcaption::internal {
 
 RendererImpl::RendererImpl(Context& context)
-    : context_(context), log_(GetContextLogger(context)), region_renderer_(context) {}
+    : context_(context),
+      log_(GetContextLogger(context)),
+      metrics_(GetContextMetrics(context)),
+      tracer_(GetContextTracer(context)),
+      bitmap_pool_(std::make_shared<BitmapPool>(metrics_, GetContextAllocator(context))),
+      memory_trim_registry_(GetContextMemoryTrimRegistry(context)),
+      region_renderer_(context) {
+    region_renderer_.SetBitmapPool(bitmap_pool_.get());
+
+    memory_trim_listener_id_ = memory_trim_registry_->Add([this](MemoryTrimLevel level) {
+        // Free buffers of the pool are not referred by anyone, release them right away
+        bitmap_pool_->ReleaseFreeBuffers();
+
+        int pending = pending_memory_trim_.load(std::memory_order_relaxed);
+        while (pending < static_cast<int>(level) &&
+               !pending_memory_trim_.compare_exchange_weak(pending, static_cast<int>(level))) {}
+    });
+}
 
-RendererImpl::~RendererImpl() = default;
+RendererImpl::~RendererImpl() {
+    memory_trim_registry_->Remove(memory_trim_listener_id_);
+    WaitForPreload();
+    StopAsyncThread();
+    StopRegionWorkers();
+}
 
 bool RendererImpl::Initialize(CaptionType caption_type,
                               FontProviderType font_provider_type,
                               TextRendererType text_renderer_type) {
+    auto lock = LockRendering();
+    uint64_t start = Metrics::NowMicroseconds();
     expected_caption_type_ = caption_type;
+    font_provider_type_ = font_provider_type;
+    text_renderer_type_ = text_renderer_type;
     LoadDefaultFontFamilies();
-    return region_renderer_.Initialize(font_provider_type, text_renderer_type);
+    if (!region_renderer_.Initialize(font_provider_type, text_renderer_type)) {
+        return false;
+    }
+    initialize_us_ = Metrics::NowMicroseconds() - start;
+    return true;
+}
+
+bool RendererImpl::InitializeFrom(RendererImpl& other) {
+    if (&other == this) {
+        return false;
+    }
+
+    // Settings and caches of other must not change while being copied
+    other.WaitForPreload();
+    auto other_lock = other.LockRendering();
+    auto lock = LockRendering();
+    uint64_t start = Metrics::NowMicroseconds();
+
+    expected_caption_type_ = other.expected_caption_type_;
+    font_provider_type_ = other.font_provider_type_;
+    text_renderer_type_ = other.text_renderer_type_;
+    if (!region_renderer_.Initialize(font_provider_type_, text_renderer_type_)) {
+        return false;
+    }
+    region_renderer_.CopySettingsFrom(other.region_renderer_);
+    region_renderer_.SetBitmapPool(bitmap_pool_.get());
+    if (!region_renderer_.CopyWarmStateFrom(other.region_renderer_)) {
+        log_->e("RendererImpl: Source renderer is not initialized");
+        return false;
+    }
+
+    language_font_family_ = other.language_font_family_;
+    force_no_ruby_ = other.force_no_ruby_;
+    force_default_font_family_ = other.force_default_font_family_;
+
+    frame_size_inited_ = other.frame_size_inited_;
+    frame_width_ = other.frame_width_;
+    frame_height_ = other.frame_height_;
+    video_area_size_inited_ = other.video_area_size_inited_;
+    video_area_width_ = other.video_area_width_;
+    video_area_height_ = other.video_area_height_;
+    video_area_start_x_ = other.video_area_start_x_;
+    video_area_start_y_ = other.video_area_start_y_;
+    margins_inited_ = other.margins_inited_;
+    margin_top_ = other.margin_top_;
+    margin_bottom_ = other.margin_bottom_;
+    margin_left_ = other.margin_left_;
+    margin_right_ = other.margin_right_;
+    max_render_magnification_ = other.max_render_magnification_;
+
+    // Measured costs are kept as well, they depend on the glyphs cached
+    render_time_budget_ = other.render_time_budget_;
+    render_quality_costs_ = other.render_quality_costs_;
+    stroke_mode_ = other.stroke_mode_;
+
+    storage_policy_ = other.storage_policy_;
+    upper_limit_count_ = other.upper_limit_count_;
+    upper_limit_duration_ = other.upper_limit_duration_;
+    upper_limit_bytes_ = other.upper_limit_bytes_;
+    compact_caption_storage_ = other.compact_caption_storage_;
+    cold_caption_storage_ = other.cold_caption_storage_;
+    cold_hot_window_ = other.cold_hot_window_;
+
+    merge_region_images_ = other.merge_region_images_;
+    share_image_buffers_ = other.share_image_buffers_;
+    superimpose_layer_ = other.superimpose_layer_;
+    output_pixel_format_ = other.output_pixel_format_;
+    run_length_encoded_images_ = other.run_length_encoded_images_;
+    persistent_glyph_cache_ = other.persistent_glyph_cache_;
+
+    bitmap_pool_->SetAlignment(other.bitmap_pool_->row_alignment(), other.bitmap_pool_->base_alignment());
+    bitmap_pool_->SetLimit(other.bitmap_pool_->GetStats().limit_bytes);
+
+    if (!other.worker_region_renderers_.empty() &&
+            !SetRegionRenderThreads(other.worker_region_renderers_.size() + 1)) {
+        return false;
+    }
+
+    OnRenderingSettingsChanged();
+    initialize_us_ = Metrics::NowMicroseconds() - start;
+    return true;
 }
 
 void RendererImpl::LoadDefaultFontFamilies() {
@@ -78,39 +197,116 @@ void RendererImpl::LoadDefaultFontFamilies() {
 }
 
 void RendererImpl::SetStrokeWidth(float dots) {
-    region_renderer_.SetStrokeWidth(dots);
-    InvalidatePrevRenderedImages();
+    auto lock = LockRendering();
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) { region_renderer.SetStrokeWidth(dots); });
+    OnRenderingSettingsChanged();
 }
 
 void RendererImpl::SetReplaceDRCS(bool replace) {
-    region_renderer_.SetReplaceDRCS(replace);
-    InvalidatePrevRenderedImages();
+    auto lock = LockRendering();
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) { region_renderer.SetReplaceDRCS(replace); });
+    OnRenderingSettingsChanged();
 }
 
 void RendererImpl::SetForceStrokeText(bool force_stroke) {
-    region_renderer_.SetForceStrokeText(force_stroke);
-    InvalidatePrevRenderedImages();
+    auto lock = LockRendering();
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) { region_renderer.SetForceStrokeText(force_stroke); });
+    OnRenderingSettingsChanged();
+}
+
+void RendererImpl::SetStrokeMode(StrokeMode mode) {
+    auto lock = LockRendering();
+    stroke_mode_ = mode;
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) { region_renderer.SetStrokeMode(mode); });
+    OnRenderingSettingsChanged();
+}
+
+void RendererImpl::SetQualityPreset(QualityPreset preset) {
+    auto lock = LockRendering();
+    StrokeMode stroke_mode = StrokeMode::kOutline;
+    TextHinting hinting = TextHinting::kDefault;
+    DRCSScaleFilter drcs_scale_filter = DRCSScaleFilter::kNearest;
+    switch (preset) {
+        case QualityPreset::kFast:
+            stroke_mode = StrokeMode::kDilation;
+            hinting = TextHinting::kNone;
+            break;
+        case QualityPreset::kBest:
+            hinting = TextHinting::kLight;
+            drcs_scale_filter = DRCSScaleFilter::kBilinear;
+            break;
+        case QualityPreset::kBalanced:
+        default:
+            break;
+    }
+
+    stroke_mode_ = stroke_mode;
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) {
+        region_renderer.SetStrokeMode(stroke_mode);
+        region_renderer.SetTextHinting(hinting);
+        region_renderer.SetDRCSScaleFilter(drcs_scale_filter);
+    });
+    OnRenderingSettingsChanged();
+}
+
+void RendererImpl::SetDistanceFieldGlyphs(bool enable) {
+    auto lock = LockRendering();
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) { region_renderer.SetDistanceFieldGlyphs(enable); });
+    OnRenderingSettingsChanged();
 }
 
 void RendererImpl::SetForceNoRuby(bool force_no_ruby) {
+    auto lock = LockRendering();
     force_no_ruby_ = force_no_ruby;
-    InvalidatePrevRenderedImages();
+    OnRenderingSettingsChanged();
 }
 
 void RendererImpl::SetForceNoBackground(bool force_no_background) {
-    region_renderer_.SetForceNoBackground(force_no_background);
-    InvalidatePrevRenderedImages();
+    auto lock = LockRendering();
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) { region_renderer.SetForceNoBackground(force_no_background); });
+    OnRenderingSettingsChanged();
+}
+
+void RendererImpl::SetTrimRegionImages(bool trim) {
+    auto lock = LockRendering();
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) { region_renderer.SetTrimImages(trim); });
+    OnRenderingSettingsChanged();
 }
 
 void RendererImpl::SetMergeRegionImages(bool merge) {
+    auto lock = LockRendering();
     bool prev = merge_region_images_;
     merge_region_images_ = merge;
     if (prev != merge) {
-        InvalidatePrevRenderedImages();
+        OnRenderingSettingsChanged();
+    }
+}
+
+void RendererImpl::SetOutputPixelFormat(PixelFormat format) {
+    auto lock = LockRendering();
+    if (output_pixel_format_ == format) {
+        return;
     }
+    output_pixel_format_ = format;
+
+    // Images rendered in previous format can't be taken over anymore
+    DropPrerenderedImages();
+    OnRenderingSettingsChanged();
+}
+
+void RendererImpl::SetRunLengthEncodedImages(bool enable) {
+    auto lock = LockRendering();
+    if (run_length_encoded_images_ == enable) {
+        return;
+    }
+    run_length_encoded_images_ = enable;
+
+    DropPrerenderedImages();
+    OnRenderingSettingsChanged();
 }
 
 bool RendererImpl::SetDefaultFontFamily(const std::vector<std::string>& font_family, bool force_default) {
+    auto lock = LockRendering();
     force_default_font_family_ = force_default;
     return SetLanguageSpecificFontFamily(0, font_family);
 }
@@ -120,9 +316,10 @@ bool RendererImpl::SetLanguageSpecificFontFamily(uint32_t language_code, const s
         return false;
     }
 
+    auto lock = LockRendering();
     language_font_family_[language_code] = font_family;
 
-    InvalidatePrevRenderedImages();
+    OnRenderingSettingsChanged();
     return true;
 }
 
@@ -132,15 +329,15 @@ bool RendererImpl::SetFrameSize(int frame_width, int frame_height) {
         return false;
     }
 
-    if (frame_width_ != frame_width || frame_height_ != frame_height) {
-        InvalidatePrevRenderedImages();
-    }
-
+    auto lock = LockRendering();
     frame_width_ = frame_width;
     frame_height_ = frame_height;
     frame_size_inited_ = true;
 
-    SetMargins(margin_top_, margin_bottom_, margin_left_, margin_right_);
+    // Rendered images are moved or dropped by SetMargins() depending on the new video area
+    if (!SetMargins(margin_top_, margin_bottom_, margin_left_, margin_right_)) {
+        OnRenderingSettingsChanged();
+    }
 
     return true;
 }
@@ -151,6 +348,7 @@ bool RendererImpl::SetMargins(int top, int bottom, int left, int right) {
         return false;
     }
 
+    auto lock = LockRendering();
     int video_width = frame_width_ - left - right;
     int video_height = frame_height_ - top - bottom;
 
@@ -159,8 +357,8 @@ bool RendererImpl::SetMargins(int top, int bottom, int left, int right) {
         return false;
     }
 
-    if (margin_top_ != top || margin_bottom_ != bottom || margin_left_ != left || margin_right_ != right) {
-        InvalidatePrevRenderedImages();
+    if (video_area_size_inited_ && (video_area_width_ != video_width || video_area_height_ != video_height)) {
+        OnVideoAreaResized(video_width, video_height);
     }
 
     video_area_width_ = video_width;
@@ -178,6 +376,18 @@ bool RendererImpl::SetMargins(int top, int bottom, int left, int right) {
     return true;
 }
 
+void RendererImpl::SetMaxRenderMagnification(float magnification) {
+    auto lock = LockRendering();
+    max_render_magnification_ = std::max(magnification, 0.0f);
+    OnRenderingSettingsChanged();
+}
+
+void RendererImpl::SetRenderTimeBudget(int64_t budget_us) {
+    auto lock = LockRendering();
+    render_time_budget_ = std::max<int64_t>(budget_us, 0);
+    render_quality_costs_.fill(0.0);
+}
+
 void RendererImpl::SetStoragePolicy(CaptionStoragePolicy policy, std::optional<size_t> upper_limit) {
     storage_policy_ = policy;
 
@@ -187,7 +397,206 @@ void RendererImpl::SetStoragePolicy(CaptionStoragePolicy policy, std::optional<s
     } else if (policy == CaptionStoragePolicy::kUpperLimitDuration) {
         assert(upper_limit.has_value());
         upper_limit_duration_ = upper_limit.value();
+    } else if (policy == CaptionStoragePolicy::kUpperLimitBytes) {
+        assert(upper_limit.has_value());
+        upper_limit_bytes_ = upper_limit.value();
+    }
+}
+
+void RendererImpl::SetCompactCaptionStorage(bool compact) {
+    auto async_lock = LockAsyncState();
+    compact_caption_storage_ = compact;
+}
+
+void RendererImpl::SetColdCaptionStorage(bool enable, int64_t hot_window) {
+    auto async_lock = LockAsyncState();
+    cold_caption_storage_ = enable;
+    cold_hot_window_ = std::max<int64_t>(hot_window, 0);
+    hot_captions_.clear();
+    if (enable) {
+        // Freeze captions out of the window at the next lookup
+        for (const auto& [pts, caption] : captions_) {
+            hot_captions_.push_back(pts);
+        }
+        cold_sweep_pending_ = true;
+    }
+}
+
+size_t RendererImpl::GetCaptionStorageBytes() {
+    auto async_lock = LockAsyncState();
+    return caption_storage_bytes_;
+}
+
+void RendererImpl::SetGlyphCacheLimit(size_t limit_bytes) {
+    auto lock = LockRendering();
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) { region_renderer.SetGlyphCacheLimit(limit_bytes); });
+}
+
+bool RendererImpl::SetGlyphCacheFile(const std::string& filename) {
+    auto lock = LockRendering();
+    std::shared_ptr<PersistentGlyphCache> cache;
+    bool loaded = true;
+    if (!filename.empty()) {
+        cache = std::make_shared<PersistentGlyphCache>(context_);
+        loaded = cache->Open(filename);
+    }
+    persistent_glyph_cache_ = cache;
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) { region_renderer.SetPersistentGlyphCache(cache); });
+    return loaded;
+}
+
+void RendererImpl::SetShareImageBuffers(bool share) {
+    share_image_buffers_ = share;
+}
+
+void RendererImpl::SetSuperimposeLayer(bool enable) {
+    auto lock = LockRendering();
+    superimpose_layer_ = enable;
+    if (!enable) {
+        superimposes_.clear();
+        InvalidateSuperimposeImages();
+    }
+}
+
+bool RendererImpl::SetImageAlignment(size_t row_alignment, size_t base_alignment) {
+    auto is_power_of_two = [](size_t x) { return x && (x & (x - 1)) == 0; };
+    if (!is_power_of_two(row_alignment) || !is_power_of_two(base_alignment)) {
+        log_->e("Renderer: Image alignments must be powers of two, got %zu and %zu", row_alignment, base_alignment);
+        return false;
+    }
+
+    auto lock = LockRendering();
+    size_t previous_row_alignment = bitmap_pool_->row_alignment();
+    size_t previous_base_alignment = bitmap_pool_->base_alignment();
+    bitmap_pool_->SetAlignment(row_alignment, base_alignment);
+    if (bitmap_pool_->row_alignment() == previous_row_alignment &&
+            bitmap_pool_->base_alignment() == previous_base_alignment) {
+        return true;
+    }
+
+    // Cached and prerendered images are laid out in the previous alignment
+    ForEachRegionRenderer([](RegionRenderer& region_renderer) { region_renderer.ClearRegionImageCache(); });
+    DropPrerenderedImages();
+    OnRenderingSettingsChanged();
+    return true;
+}
+
+void RendererImpl::SetRegionImageCacheSize(size_t count) {
+    auto lock = LockRendering();
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) { region_renderer.SetRegionImageCacheSize(count); });
+}
+
+GlyphCacheStats RendererImpl::GetGlyphCacheStats() const {
+    auto lock = LockRendering();
+    GlyphCacheStats stats = region_renderer_.GetGlyphCacheStats();
+    for (const auto& region_renderer : worker_region_renderers_) {
+        GlyphCacheStats worker_stats = region_renderer->GetGlyphCacheStats();
+        stats.hits += worker_stats.hits;
+        stats.misses += worker_stats.misses;
+        stats.entry_count += worker_stats.entry_count;
+        stats.used_bytes += worker_stats.used_bytes;
+        stats.limit_bytes += worker_stats.limit_bytes;
+    }
+    return stats;
+}
+
+void RendererImpl::SetBitmapPoolLimit(size_t limit_bytes) {
+    bitmap_pool_->SetLimit(limit_bytes);
+}
+
+BitmapPoolStats RendererImpl::GetBitmapPoolStats() const {
+    return bitmap_pool_->GetStats();
+}
+
+void RendererImpl::TrimMemory(MemoryTrimLevel level) {
+    int pending = pending_memory_trim_.exchange(kNoPendingMemoryTrim);
+    if (pending > static_cast<int>(level)) {
+        level = static_cast<MemoryTrimLevel>(pending);
+    }
+
+    WaitForPreload();
+    auto lock = LockRendering();
+    TrimMemoryLocked(level);
+}
+
+void RendererImpl::ApplyPendingMemoryTrim() {
+    if (pending_memory_trim_.load(std::memory_order_relaxed) == kNoPendingMemoryTrim) {
+        return;
+    }
+    auto lock = LockRendering();
+    int pending = pending_memory_trim_.exchange(kNoPendingMemoryTrim);
+    if (pending != kNoPendingMemoryTrim) {
+        TrimMemoryLocked(static_cast<MemoryTrimLevel>(pending));
+    }
+}
+
+void RendererImpl::TrimMemoryLocked(MemoryTrimLevel level) {
+    {
+        auto async_lock = LockAsyncState();
+        // Results of the worker thread are kept, otherwise RenderAsync() would have nothing to return
+        if (!async_enabled_) {
+            DropPrerenderedImages();
+            if (level >= MemoryTrimLevel::kComplete) {
+                InvalidatePrevRenderedImages();
+                InvalidateSuperimposeImages();
+            }
+        }
+    }
+
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) { region_renderer.TrimMemory(level); });
+
+    if (level >= MemoryTrimLevel::kComplete) {
+        glyph_atlas_.Release();
+        has_prev_atlas_caption_ = false;
+    }
+
+    // Images recycled above end up in the pool, release them at last
+    bitmap_pool_->ReleaseFreeBuffers();
+}
+
+RendererMemoryUsage RendererImpl::GetMemoryUsage() const {
+    auto lock = LockRendering();
+    RendererMemoryUsage usage;
+    region_renderer_.AddMemoryUsage(usage);
+    for (const auto& region_renderer : worker_region_renderers_) {
+        region_renderer->AddMemoryUsage(usage);
     }
+    usage.glyph_atlas_bytes = glyph_atlas_.memory_bytes();
+    usage.bitmap_pool_bytes = bitmap_pool_->GetStats().pooled_bytes;
+
+    auto async_lock = LockAsyncState();
+    usage.caption_storage_bytes = caption_storage_bytes_;
+    for (const auto& [pts, superimpose] : superimposes_) {
+        usage.caption_storage_bytes += EstimateCaptionBytes(superimpose);
+    }
+    for (const Image& image : prev_rendered_images_) {
+        usage.rendered_image_bytes += image.size();
+    }
+    for (const Image& image : prev_superimpose_images_) {
+        usage.rendered_image_bytes += image.size();
+    }
+    for (const auto& [pts, prerendered] : prerendered_) {
+        for (const Image& image : prerendered.images) {
+            usage.rendered_image_bytes += image.size();
+        }
+    }
+    return usage;
+}
+
+RendererStartupTimings RendererImpl::GetStartupTimings() const {
+    auto lock = LockRendering();
+    RendererStartupTimings timings;
+    timings.initialize_us = initialize_us_;
+    region_renderer_.GetStartupTimings(timings);
+    timings.first_render_us = first_render_us_;
+    return timings;
+}
+
+void RendererImpl::RecycleImages(std::vector<Image>&& images) {
+    for (Image& image : images) {
+        bitmap_pool_->Recycle(std::move(image));
+    }
+    images.clear();
 }
 
 bool RendererImpl::AppendCaption(const Caption& caption) {
@@ -197,11 +606,22 @@ bool RendererImpl::AppendCaption(const Caption& caption) {
     if (caption.pts == PTS_NOPTS || caption.plane_width <= 0 || caption.plane_height <= 0) {
         return false;
     }
+    if (superimpose_layer_ && caption.type == CaptionType::kSuperimpose) {
+        return AppendSuperimpose(Caption(caption));
+    }
 
     int64_t pts = caption.pts;
+    auto async_lock = LockAsyncState();
 
+    // Caption of the same PTS will be replaced
+    if (auto existing = captions_.find(pts); existing != captions_.end()) {
+        caption_storage_bytes_ -= StoredCaptionBytes(existing);
+        cold_captions_.erase(pts);
+    }
+
+    std::map<int64_t, Caption>::iterator inserted;
     if (captions_.empty()) {
-        captions_.emplace(pts, caption);
+        inserted = captions_.emplace(pts, caption).first;
     } else {
         auto prev = captions_.lower_bound(pts - 1);
         if (prev == captions_.end() || (prev != captions_.begin() && prev->first > pts - 1)) {
@@ -214,14 +634,19 @@ bool RendererImpl::AppendCaption(const Caption& caption) {
             prev_caption.wait_duration = pts - prev_caption.pts;
         }
 
-        captions_.insert_or_assign(std::next(prev), pts, caption);
+        inserted = captions_.insert_or_assign(std::next(prev), pts, caption);
     }
+    OnCaptionInserted(inserted);
 
     if (pts <= prev_rendered_caption_pts_) {
         InvalidatePrevRenderedImages();
     }
 
     CleanupCaptionsIfNecessary();
+
+    if (async_enabled_) {
+        QueueAsyncRendering(pts);
+    }
     return true;
 }
 
@@ -232,11 +657,22 @@ bool RendererImpl::AppendCaption(Caption&& caption) {
     if (caption.pts == PTS_NOPTS || caption.plane_width <= 0 || caption.plane_height <= 0) {
         return false;
     }
+    if (superimpose_layer_ && caption.type == CaptionType::kSuperimpose) {
+        return AppendSuperimpose(std::move(caption));
+    }
 
     int64_t pts = caption.pts;
+    auto async_lock = LockAsyncState();
+
+    // Caption of the same PTS will be replaced
+    if (auto existing = captions_.find(pts); existing != captions_.end()) {
+        caption_storage_bytes_ -= StoredCaptionBytes(existing);
+        cold_captions_.erase(pts);
+    }
 
+    std::map<int64_t, Caption>::iterator inserted;
     if (captions_.empty()) {
-        captions_.emplace(pts, std::move(caption));
+        inserted = captions_.emplace(pts, std::move(caption)).first;
     } else {
         auto prev = captions_.lower_bound(pts - 1);
         if (prev == captions_.end() || (prev != captions_.begin() && prev->first > pts - 1)) {
@@ -249,180 +685,1395 @@ bool RendererImpl::AppendCaption(Caption&& caption) {
             prev_caption.wait_duration = pts - prev_caption.pts;
         }
 
-        captions_.insert_or_assign(std::next(prev), pts, std::move(caption));
+        inserted = captions_.insert_or_assign(std::next(prev), pts, std::move(caption));
     }
+    OnCaptionInserted(inserted);
 
     if (pts <= prev_rendered_caption_pts_) {
         InvalidatePrevRenderedImages();
     }
 
     CleanupCaptionsIfNecessary();
+
+    if (async_enabled_) {
+        QueueAsyncRendering(pts);
+    }
     return true;
 }
 
-void RendererImpl::CleanupCaptionsIfNecessary() {
-    if (storage_policy_ == CaptionStoragePolicy::kUnlimited) {
-        return;
-    } else if (storage_policy_ == CaptionStoragePolicy::kMinimum) {
-        if (prev_rendered_caption_pts_ == PTS_NOPTS) {
-            return;
-        }
-        auto prev_rendered_caption_iter = captions_.find(prev_rendered_caption_pts_);
-        if (prev_rendered_caption_iter != captions_.end()) {
-            captions_.erase(captions_.begin(), prev_rendered_caption_iter);
-        }
-    } else if (storage_policy_ == CaptionStoragePolicy::kUpperLimitCount) {
-        if (captions_.size() <= upper_limit_count_) {
-            return;
-        }
-        auto erase_end = std::prev(captions_.end(), static_cast<ptrdiff_t>(upper_limit_count_));
-        if (erase_end != captions_.begin()) {
-            captions_.erase(captions_.begin(), erase_end);
-        }
-    } else if (storage_policy_ == CaptionStoragePolicy::kUpperLimitDuration) {
-        if (captions_.empty()) {
-            return;
-        }
-        int64_t last_caption_pts = captions_.rbegin()->first;
-        int64_t erase_end_pts = last_caption_pts - static_cast<int64_t>(upper_limit_duration_);
-        auto erase_end = captions_.lower_bound(erase_end_pts);
-        if (erase_end != captions_.end() && erase_end != captions_.begin()) {
-            captions_.erase(captions_.begin(), erase_end);
+bool RendererImpl::AppendCaptions(std::vector<Caption>&& captions) {
+    bool sorted = true;
+    for (size_t i = 0; i < captions.size(); i++) {
+        const Caption& caption = captions[i];
+        // Superimpose of a separate layer is appended one by one as well
+        if (caption.pts == PTS_NOPTS || caption.plane_width <= 0 || caption.plane_height <= 0 ||
+                (i > 0 && caption.pts <= captions[i - 1].pts) ||
+                (superimpose_layer_ && caption.type == CaptionType::kSuperimpose)) {
+            sorted = false;
+            break;
         }
     }
-}
 
-RenderStatus RendererImpl::TryRender(int64_t pts) {
-    if (!frame_size_inited_ || !margins_inited_) {
-        return RenderStatus::kError;
+    auto async_lock = LockAsyncState();
+    if (!sorted || captions.empty() || (!captions_.empty() && captions_.rbegin()->first >= captions.front().pts)) {
+        async_lock = {};
+        bool ret = true;
+        for (Caption& caption : captions) {
+            ret &= AppendCaption(std::move(caption));
+        }
+        captions.clear();
+        return ret;
     }
 
-    if (captions_.empty()) {
-        return RenderStatus::kNoImage;
+    // Correct previous caption's duration, then the batch's own ones in one pass
+    if (!captions_.empty() && captions_.rbegin()->second.wait_duration == DURATION_INDEFINITE) {
+        Caption& prev_caption = captions_.rbegin()->second;
+        prev_caption.wait_duration = captions.front().pts - prev_caption.pts;
     }
-
-    auto iter = captions_.lower_bound(pts);
-    if (iter == captions_.end() || (iter != captions_.begin() && iter->first > pts)) {
-        --iter;
+    for (size_t i = 0; i + 1 < captions.size(); i++) {
+        if (captions[i].wait_duration == DURATION_INDEFINITE) {
+            captions[i].wait_duration = captions[i + 1].pts - captions[i].pts;
+        }
     }
 
-    Caption& caption = iter->second;
-    if (pts < caption.pts || (caption.wait_duration != DURATION_INDEFINITE && pts >= caption.pts + caption.wait_duration)) {
-        // Timeout
-        return RenderStatus::kNoImage;
+    // Inserting at the end with a hint takes constant time, the index keeps being appended as well
+    int64_t first_pts = captions.front().pts;
+    for (Caption& caption : captions) {
+        int64_t pts = caption.pts;
+        OnCaptionInserted(captions_.emplace_hint(captions_.end(), pts, std::move(caption)));
     }
-    if (caption.regions.empty()) {
-        return RenderStatus::kNoImage;
+
+    if (first_pts <= prev_rendered_caption_pts_) {
+        InvalidatePrevRenderedImages();
     }
 
-    if (has_prev_rendered_caption_ && prev_rendered_caption_pts_ == caption.pts) {
-        if (!prev_rendered_images_.empty()) {
-            return RenderStatus::kGotImageUnchanged;
-        } else {
-            return RenderStatus::kNoImage;
+    CleanupCaptionsIfNecessary();
+
+    if (async_enabled_) {
+        for (const Caption& caption : captions) {
+            QueueAsyncRendering(caption.pts);
         }
     }
-
-    return RenderStatus::kGotImage;
+    captions.clear();
+    return true;
 }
 
-RenderStatus RendererImpl::Render(int64_t pts, RenderResult& out_result) {
-    if (!frame_size_inited_ || !margins_inited_) {
-        assert(frame_size_inited_ && margins_inited_ && "Frame size / margins must be indicated first");
-        return RenderStatus::kError;
+bool RendererImpl::AppendSuperimpose(Caption&& caption) {
+    int64_t pts = caption.pts;
+
+    // Correct previous superimpose's duration
+    auto next = superimposes_.lower_bound(pts);
+    if (next != superimposes_.begin()) {
+        Caption& prev = std::prev(next)->second;
+        if (prev.wait_duration == DURATION_INDEFINITE) {
+            prev.wait_duration = pts - prev.pts;
+        }
     }
+    superimposes_.insert_or_assign(next, pts, std::move(caption));
 
-    out_result.pts = 0;
-    out_result.duration = 0;
-    out_result.images.clear();
+    if (pts <= prev_superimpose_pts_) {
+        InvalidateSuperimposeImages();
+    }
 
-    if (captions_.empty()) {
-        InvalidatePrevRenderedImages();
-        return RenderStatus::kNoImage;
+    // Superimpose ended before the new one is of no use for playing forward
+    if (storage_policy_ == CaptionStoragePolicy::kMinimum) {
+        for (auto iter = superimposes_.begin(); iter != superimposes_.end() && iter->first < pts; ) {
+            if (CaptionEndPTS(iter->second) > pts) {
+                break;
+            }
+            iter = superimposes_.erase(iter);
+        }
     }
+    return true;
+}
 
-    auto iter = captions_.lower_bound(pts);
-    if (iter == captions_.end() || (iter != captions_.begin() && iter->first > pts)) {
-        --iter;
+bool RendererImpl::ExtendCaption(int64_t pts, int64_t duration) {
+    auto async_lock = LockAsyncState();
+    if (auto superimpose = superimposes_.find(pts); superimpose != superimposes_.end()) {
+        superimpose->second.wait_duration = duration;
+        return true;
+    }
+    auto iter = captions_.find(pts);
+    if (iter == captions_.end()) {
+        return false;
     }
+    iter->second.wait_duration = duration;
 
-    Caption& caption = iter->second;
-    if (pts < caption.pts || (caption.wait_duration != DURATION_INDEFINITE && pts >= caption.pts + caption.wait_duration)) {
-        // Timeout
-        InvalidatePrevRenderedImages();
-        return RenderStatus::kNoImage;
+    if (!caption_index_dirty_) {
+        auto entry = std::lower_bound(caption_index_.begin(), caption_index_.end(), pts,
+                                      [](const CaptionIndexEntry& e, int64_t value) { return e.pts < value; });
+        if (entry != caption_index_.end() && entry->pts == pts) {
+            entry->end_pts = CaptionEndPTS(iter->second);
+        } else {
+            caption_index_dirty_ = true;
+        }
     }
-    if (caption.regions.empty()) {
-        InvalidatePrevRenderedImages();
-        return RenderStatus::kNoImage;
+    if (has_prev_rendered_caption_ && prev_rendered_caption_pts_ == pts) {
+        prev_rendered_caption_duration_ = duration;
     }
+    return true;
+}
 
-    if (has_prev_rendered_caption_ && prev_rendered_caption_pts_ == caption.pts) {
-        // Reuse previous rendered caption
-        if (!prev_rendered_images_.empty()) {
-            out_result.pts = prev_rendered_caption_pts_;
-            out_result.duration = prev_rendered_caption_duration_;
-            out_result.images = prev_rendered_images_;
-            return RenderStatus::kGotImageUnchanged;
+void RendererImpl::OnCaptionInserted(std::map<int64_t, Caption>::iterator inserted) {
+    if (compact_caption_storage_) {
+        CompactCaptionRegions(inserted->second);
+    }
+    caption_storage_bytes_ += EstimateCaptionBytes(inserted->second);
+    spilled_pts_ = std::min(spilled_pts_, inserted->first);
+    IndexInsertedCaption(inserted);
+
+    if (cold_caption_storage_) {
+        int64_t pts = inserted->first;
+        if (cold_sweep_pts_ != PTS_NOPTS && (pts < cold_sweep_pts_ - cold_hot_window_ ||
+                                             pts > cold_sweep_pts_ + cold_hot_window_)) {
+            FreezeCaption(inserted);
         } else {
-            InvalidatePrevRenderedImages();
-            return RenderStatus::kNoImage;
+            hot_captions_.push_back(pts);
+            cold_sweep_pending_ = true;
         }
     }
+}
 
-    // Prepare for rendering
+void RendererImpl::IndexInsertedCaption(std::map<int64_t, Caption>::iterator inserted) {
+    const Caption& caption = inserted->second;
+    bool appended = std::next(inserted) == captions_.end() &&
+                    (caption_index_.empty() || caption_index_.back().pts < caption.pts);
+    if (caption_index_dirty_ || !appended || caption_index_.size() + 1 != captions_.size()) {
+        caption_index_dirty_ = true;
+        return;
+    }
 
-    // Set up Font Language
-    region_renderer_.SetFontLanguage(caption.iso6392_language_code);
+    // Appending in PTS order is the common case, which keeps the index without rebuilding.
+    // Duration of the previous caption may have been corrected by the appended one.
+    if (!caption_index_.empty()) {
+        CaptionIndexEntry& prev = caption_index_.back();
+        prev.end_pts = CaptionEndPTS(*prev.caption);
+    }
+    caption_index_.push_back(CaptionIndexEntry{caption.pts, CaptionEndPTS(caption), &inserted->second});
+}
 
-    // Set up Font Family
-    uint32_t language_code = caption.iso6392_language_code;
-    if (force_default_font_family_ || language_font_family_.find(language_code) == language_font_family_.end()) {
-        language_code = 0;
+void RendererImpl::RebuildCaptionIndex() {
+    caption_index_.clear();
+    caption_index_.reserve(captions_.size());
+    for (auto& [pts, caption] : captions_) {
+        caption_index_.push_back(CaptionIndexEntry{pts, CaptionEndPTS(caption), &caption});
     }
-    region_renderer_.SetFontFamily(language_font_family_[language_code]);
+    caption_cursor_ = 0;
+    caption_index_dirty_ = false;
+}
 
-    // Set up origin plane size / target caption area
-    AdjustCaptionArea(caption.plane_width, caption.plane_height);
+int64_t RendererImpl::CaptionEndPTS(const Caption& caption) {
+    if (caption.wait_duration == DURATION_INDEFINITE) {
+        return std::numeric_limits<int64_t>::max();
+    }
+    return caption.pts + caption.wait_duration;
+}
 
-    std::vector<Image> images;
+void RendererImpl::CompactCaptionRegions(Caption& caption) {
     for (CaptionRegion& region : caption.regions) {
-        if (region.is_ruby && force_no_ruby_) {
-            continue;
+        if (!region.chars.empty() && region.compact_chars.Assign(region.chars)) {
+            std::vector<CaptionChar>().swap(region.chars);
         }
+    }
+}
 
-        Result<Image, RegionRenderError> result = region_renderer_.RenderCaptionRegion(region, caption.drcs_map);
-        if (result.is_ok()) {
-            images.push_back(std::move(result.value()));
-        } else if (result.error() == RegionRenderError::kImageTooSmall) {
-            // Skip image which is too small
-            continue;
-        } else {
-            log_->e("RendererImpl: RenderCaptionRegion() failed with error: %d", static_cast<int>(result.error()));
-            InvalidatePrevRenderedImages();
-            return RenderStatus::kError;
-        }
+size_t RendererImpl::EstimateCaptionBytes(const Caption& caption) {
+    // Node of captions_ included
+    size_t bytes = sizeof(std::pair<const int64_t, Caption>) + sizeof(void*) * 4;
+    bytes += caption.text.capacity();
+    bytes += caption.regions.capacity() * sizeof(CaptionRegion);
+    for (const CaptionRegion& region : caption.regions) {
+        const CompactCaptionChars& compact = region.compact_chars;
+        bytes += region.chars.capacity() * sizeof(CaptionChar);
+        bytes += compact.runs.capacity() * sizeof(CaptionCharRun);
+        bytes += (compact.codepoints.capacity() + compact.pua_codepoints.capacity() +
+                  compact.drcs_codes.capacity()) * sizeof(uint32_t);
     }
+    bytes += caption.drcs_map.bucket_count() * sizeof(void*);
+    for (const auto& [code, drcs] : caption.drcs_map) {
+        bytes += sizeof(DRCSMap::value_type) + sizeof(void*) * 2;
+        bytes += drcs.pixels.capacity() + drcs.md5.capacity() + drcs.alternative_text.capacity();
+    }
+    return bytes;
+}
 
-    if (merge_region_images_ && images.size() > 1) {
-        Image merged = MergeImages(images);
-        images.clear();
-        images.push_back(std::move(merged));
+void RendererImpl::EraseCaptionsBefore(std::map<int64_t, Caption>::iterator erase_end) {
+    for (auto iter = captions_.begin(); iter != erase_end; ++iter) {
+        caption_storage_bytes_ -= StoredCaptionBytes(iter);
+    }
+    if (!cold_captions_.empty()) {
+        cold_captions_.erase(cold_captions_.begin(), erase_end == captions_.end()
+                                                         ? cold_captions_.end()
+                                                         : cold_captions_.lower_bound(erase_end->first));
     }
+    captions_.erase(captions_.begin(), erase_end);
+}
 
-    has_prev_rendered_caption_ = true;
-    prev_rendered_caption_pts_ = caption.pts;
-    prev_rendered_caption_duration_ = caption.wait_duration;
+void RendererImpl::SpillCaptionsIntoCompactForm() {
+    // The latest caption is kept as is, since it's the most likely one to be rendered
+    auto last = std::prev(captions_.end());
+    for (auto iter = captions_.lower_bound(spilled_pts_);
+            iter != last && caption_storage_bytes_ > upper_limit_bytes_; ++iter) {
+        caption_storage_bytes_ -= EstimateCaptionBytes(iter->second);
+        CompactCaptionRegions(iter->second);
+        caption_storage_bytes_ += EstimateCaptionBytes(iter->second);
+        spilled_pts_ = iter->first + 1;
+    }
+}
+
+size_t RendererImpl::StoredCaptionBytes(std::map<int64_t, Caption>::const_iterator iter) const {
+    size_t bytes = EstimateCaptionBytes(iter->second);
+    if (auto cold = cold_captions_.find(iter->first); cold != cold_captions_.end()) {
+        bytes += cold->second.capacity();
+    }
+    return bytes;
+}
+
+void RendererImpl::FreezeCaption(std::map<int64_t, Caption>::iterator iter) {
+    Caption& caption = iter->second;
+    if (caption.regions.empty() && caption.drcs_map.empty()) {
+        return;  // Nothing worth compressing, e.g. a clearing caption, or frozen already
+    }
+
+    std::vector<uint8_t> serialized;
+    SerializeCaption(caption, serialized);
+    std::vector<uint8_t>& compressed = cold_captions_[iter->first];
+    lz::Compress(serialized.data(), serialized.size(), compressed);
+    compressed.shrink_to_fit();
+
+    // Timing, plane size and flags are kept in the stub for lookups
+    caption_storage_bytes_ -= EstimateCaptionBytes(caption);
+    std::string().swap(caption.text);
+    std::vector<CaptionRegion>().swap(caption.regions);
+    DRCSMap().swap(caption.drcs_map);
+    caption_storage_bytes_ += EstimateCaptionBytes(caption) + compressed.capacity();
+}
+
+void RendererImpl::ThawCaption(std::map<int64_t, Caption>::iterator iter) {
+    auto cold = cold_captions_.find(iter->first);
+    if (cold == cold_captions_.end()) {
+        return;
+    }
+
+    Caption caption;
+    if (!GetCaptionForRendering(iter, caption)) {
+        return;  // Left as an empty caption
+    }
+    if (compact_caption_storage_) {
+        CompactCaptionRegions(caption);
+    }
+    caption_storage_bytes_ -= StoredCaptionBytes(iter);
+    cold_captions_.erase(cold);
+    caption.wait_duration = iter->second.wait_duration;  // Could have been corrected since frozen
+    iter->second = std::move(caption);
+    caption_storage_bytes_ += EstimateCaptionBytes(iter->second);
+
+    if (cold_caption_storage_) {
+        hot_captions_.push_back(iter->first);
+    }
+}
+
+void RendererImpl::FreezeColdCaptions(int64_t pts) {
+    cold_sweep_pts_ = pts;
+    cold_sweep_pending_ = false;
+
+    auto out_of_window = [&](int64_t caption_pts) -> bool {
+        if (caption_pts >= pts - cold_hot_window_ && caption_pts <= pts + cold_hot_window_) {
+            return false;
+        }
+        if (auto iter = captions_.find(caption_pts); iter != captions_.end()) {
+            FreezeCaption(iter);
+        }
+        return true;
+    };
+    hot_captions_.erase(std::remove_if(hot_captions_.begin(), hot_captions_.end(), out_of_window),
+                        hot_captions_.end());
+}
+
+auto RendererImpl::GetCaptionForRendering(std::map<int64_t, Caption>::iterator iter, Caption& cold_storage)
+        -> const Caption* {
+    auto cold = cold_captions_.find(iter->first);
+    if (cold == cold_captions_.end()) {
+        return &iter->second;
+    }
+
+    std::vector<uint8_t> serialized;
+    CaptionView view;
+    if (!lz::Decompress(cold->second.data(), cold->second.size(), serialized) ||
+            !view.Open(serialized.data(), serialized.size())) {
+        log_->e("RendererImpl: Corrupted cold caption at PTS %lld", static_cast<long long>(iter->first));
+        return nullptr;
+    }
+    view.ToCaption(cold_storage);
+    return &cold_storage;
+}
+
+auto RendererImpl::GetRenderRegions(const Caption& caption, std::vector<CaptionRegion>& region_storage)
+        -> const std::vector<CaptionRegion>& {
+    bool has_compact_regions = std::any_of(caption.regions.begin(), caption.regions.end(),
+                                           [](const CaptionRegion& region) { return !region.compact_chars.empty(); });
+    if (!has_compact_regions) {
+        return caption.regions;
+    }
+
+    region_storage.resize(caption.regions.size());
+    for (size_t i = 0; i < caption.regions.size(); i++) {
+        const CaptionRegion& region = caption.regions[i];
+        CaptionRegion& expanded = region_storage[i];
+        expanded.x = region.x;
+        expanded.y = region.y;
+        expanded.width = region.width;
+        expanded.height = region.height;
+        expanded.is_ruby = region.is_ruby;
+        expanded.fingerprint = region.fingerprint;
+        if (region.compact_chars.empty()) {
+            expanded.chars = region.chars;
+        } else {
+            region.compact_chars.Expand(expanded.chars);
+        }
+    }
+    return region_storage;
+}
+
+void RendererImpl::CleanupCaptionsIfNecessary() {
+    size_t count_before = captions_.size();
+    EraseOutdatedCaptions();
+
+    // Captions are only erased from the front, so drop the same amount of index entries
+    size_t erased = count_before - captions_.size();
+    if (erased && !caption_index_dirty_) {
+        caption_index_.erase(caption_index_.begin(), caption_index_.begin() + static_cast<ptrdiff_t>(erased));
+        caption_cursor_ = caption_cursor_ >= erased ? caption_cursor_ - erased : 0;
+    }
+}
+
+void RendererImpl::EraseOutdatedCaptions() {
+    if (storage_policy_ == CaptionStoragePolicy::kUnlimited) {
+        return;
+    } else if (storage_policy_ == CaptionStoragePolicy::kMinimum) {
+        if (prev_rendered_caption_pts_ == PTS_NOPTS) {
+            return;
+        }
+        auto prev_rendered_caption_iter = captions_.find(prev_rendered_caption_pts_);
+        if (prev_rendered_caption_iter != captions_.end()) {
+            EraseCaptionsBefore(prev_rendered_caption_iter);
+        }
+    } else if (storage_policy_ == CaptionStoragePolicy::kUpperLimitCount) {
+        if (captions_.size() <= upper_limit_count_) {
+            return;
+        }
+        auto erase_end = std::prev(captions_.end(), static_cast<ptrdiff_t>(upper_limit_count_));
+        if (erase_end != captions_.begin()) {
+            EraseCaptionsBefore(erase_end);
+        }
+    } else if (storage_policy_ == CaptionStoragePolicy::kUpperLimitDuration) {
+        if (captions_.empty()) {
+            return;
+        }
+        int64_t last_caption_pts = captions_.rbegin()->first;
+        int64_t erase_end_pts = last_caption_pts - static_cast<int64_t>(upper_limit_duration_);
+        auto erase_end = captions_.lower_bound(erase_end_pts);
+        if (erase_end != captions_.end() && erase_end != captions_.begin()) {
+            EraseCaptionsBefore(erase_end);
+        }
+    } else if (storage_policy_ == CaptionStoragePolicy::kUpperLimitBytes) {
+        if (captions_.empty() || caption_storage_bytes_ <= upper_limit_bytes_) {
+            return;
+        }
+        SpillCaptionsIntoCompactForm();
+
+        auto erase_end = captions_.begin();
+        size_t bytes = caption_storage_bytes_;
+        while (bytes > upper_limit_bytes_ && std::next(erase_end) != captions_.end()) {
+            bytes -= StoredCaptionBytes(erase_end);
+            ++erase_end;
+        }
+        EraseCaptionsBefore(erase_end);
+    }
+}
+
+RenderStatus RendererImpl::TryRender(int64_t pts) {
+    bool caption_shown = !prev_rendered_images_.empty();
+    RenderStatus status = TryRenderCaptionLayer(pts);
+    if (!superimpose_layer_ || status == RenderStatus::kError || status == RenderStatus::kNotReady) {
+        return status;
+    }
+
+    RenderStatus superimpose_status = RenderStatus::kNoImage;
+    bool superimpose_vanished = false;
+    if (const Caption* found = FindSuperimposeAt(pts)) {
+        if (!has_prev_superimpose_ || prev_superimpose_pts_ != found->pts) {
+            superimpose_status = RenderStatus::kGotImage;
+        } else if (!prev_superimpose_images_.empty()) {
+            superimpose_status = RenderStatus::kGotImageUnchanged;
+        }
+    } else {
+        superimpose_vanished = !prev_superimpose_images_.empty();
+    }
+    return CombineLayerStatus(status, caption_shown && status == RenderStatus::kNoImage,
+                              superimpose_status, superimpose_vanished);
+}
+
+RenderStatus RendererImpl::TryRenderCaptionLayer(int64_t pts) {
+    if (!frame_size_inited_ || !margins_inited_) {
+        return RenderStatus::kError;
+    }
+
+    auto async_lock = LockAsyncState();
+
+    if (captions_.empty()) {
+        return RenderStatus::kNoImage;
+    }
+
+    Caption* found = FindCaptionAt(pts);
+    if (!found) {
+        return RenderStatus::kNoImage;
+    }
+    Caption& caption = *found;
+
+    if (has_prev_rendered_caption_ && prev_rendered_caption_pts_ == caption.pts) {
+        if (render_time_budget_ > 0 && prev_rendered_quality_ != RenderQuality::kFull &&
+                ChooseRenderQuality(caption) < prev_rendered_quality_) {
+            return RenderStatus::kGotImage;  // Going to be restored into a better quality
+        }
+        if (!prev_rendered_images_.empty()) {
+            return prev_rendered_images_moved_ ? RenderStatus::kGotImage : RenderStatus::kGotImageUnchanged;
+        } else {
+            return RenderStatus::kNoImage;
+        }
+    }
+
+    return RenderStatus::kGotImage;
+}
+
+int64_t RendererImpl::GetNextChangePTS(int64_t pts) {
+    auto async_lock = LockAsyncState();
+
+    // Start of the next superimpose, or end of the current one
+    int64_t next_pts = PTS_NOPTS;
+    auto next_superimpose = superimposes_.upper_bound(pts);
+    if (next_superimpose != superimposes_.end()) {
+        next_pts = next_superimpose->first;
+    }
+    if (next_superimpose != superimposes_.begin()) {
+        int64_t end_pts = CaptionEndPTS(std::prev(next_superimpose)->second);
+        if (end_pts > pts && end_pts != std::numeric_limits<int64_t>::max() &&
+                (next_pts == PTS_NOPTS || end_pts < next_pts)) {
+            next_pts = end_pts;
+        }
+    }
+
+    if (captions_.empty()) {
+        return next_pts;
+    }
+    if (caption_index_dirty_) {
+        RebuildCaptionIndex();
+    }
+
+    auto next = std::upper_bound(caption_index_.begin(), caption_index_.end(), pts,
+                                 [](int64_t value, const CaptionIndexEntry& entry) {
+                                     return value < entry.pts;
+                                 });
+    if (next != caption_index_.end() && (next_pts == PTS_NOPTS || next->pts < next_pts)) {
+        next_pts = next->pts;
+    }
+
+    // The caption presented at pts may time out before the next one starts
+    if (next != caption_index_.begin()) {
+        int64_t end_pts = std::prev(next)->end_pts;
+        if (end_pts > pts && end_pts != std::numeric_limits<int64_t>::max() &&
+                (next_pts == PTS_NOPTS || end_pts < next_pts)) {
+            next_pts = end_pts;
+        }
+    }
+
+    return next_pts;
+}
+
+RenderStatus RendererImpl::Render(int64_t pts, RenderResult& out_result) {
+    ARIBCC_TRACE_SCOPE(tracer_.get(), "renderer", "RendererImpl::Render");
+    RenderStatus status = RenderWithoutImages(pts, out_result);
+    if (status != RenderStatus::kGotImage && status != RenderStatus::kGotImageUnchanged) {
+        return status;
+    }
+
+    out_result.images.reserve(prev_rendered_images_.size() + prev_superimpose_images_.size());
+    CopyRenderedImages(prev_rendered_images_, out_result.images);
+    CopyRenderedImages(prev_superimpose_images_, out_result.images);
+    return status;
+}
+
+void RendererImpl::CopyRenderedImages(const std::vector<Image>& images, std::vector<Image>& out_images) {
+    if (share_image_buffers_) {
+        // Only the references are copied
+        out_images.insert(out_images.end(), images.begin(), images.end());
+    } else {
+        for (const Image& image : images) {
+            out_images.push_back(Bitmap::UnshareImageBuffer(image, bitmap_pool_.get()));
+        }
+    }
+}
+
+RenderStatus RendererImpl::RenderInto(int64_t pts, const FrameBuffer& frame) {
+    ARIBCC_TRACE_SCOPE(tracer_.get(), "renderer", "RendererImpl::RenderInto");
+    RenderResult result;
+    RenderStatus status = RenderWithoutImages(pts, result);
+    if (status != RenderStatus::kGotImage && status != RenderStatus::kGotImageUnchanged) {
+        return status;
+    }
+
+    // Superimpose is blended above captions
+    for (const std::vector<Image>* images : {&prev_rendered_images_, &prev_superimpose_images_}) {
+        for (const Image& image : *images) {
+            if (!BlendImageToFrame(image, frame)) {
+                log_->e("RendererImpl: Invalid FrameBuffer for RenderInto()");
+                return RenderStatus::kError;
+            }
+        }
+    }
+
+    return status;
+}
+
+RenderStatus RendererImpl::RenderLayers(int64_t pts, RenderResult& out_caption, RenderResult& out_superimpose) {
+    ARIBCC_TRACE_SCOPE(tracer_.get(), "renderer", "RendererImpl::RenderLayers");
+    RenderStatus status = RenderLayersWithoutImages(pts, out_caption, out_superimpose);
+    if (status != RenderStatus::kGotImage && status != RenderStatus::kGotImageUnchanged) {
+        return status;
+    }
+
+    CopyRenderedImages(prev_rendered_images_, out_caption.images);
+    CopyRenderedImages(prev_superimpose_images_, out_superimpose.images);
+    return status;
+}
+
+RenderStatus RendererImpl::RenderWithoutImages(int64_t pts, RenderResult& out_result) {
+    if (!superimpose_layer_) {
+        return RenderCaptionLayer(pts, out_result);
+    }
+
+    RenderResult superimpose;
+    RenderStatus status = RenderLayersWithoutImages(pts, out_result, superimpose);
+    if (status != RenderStatus::kGotImage && status != RenderStatus::kGotImageUnchanged) {
+        return status;
+    }
+
+    // Caption images come first, timing is of the caption layer unless it has no image
+    if (prev_rendered_images_.empty()) {
+        out_result.pts = superimpose.pts;
+        out_result.duration = superimpose.duration;
+    }
+    out_result.image_changed.insert(out_result.image_changed.end(),
+                                    superimpose.image_changed.begin(), superimpose.image_changed.end());
+    layered_images_changed_ = out_result.image_changed;
+    return status;
+}
+
+RenderStatus RendererImpl::RenderLayersWithoutImages(int64_t pts,
+                                                     RenderResult& out_caption,
+                                                     RenderResult& out_superimpose) {
+    bool caption_shown = !prev_rendered_images_.empty();
+    RenderStatus caption_status = RenderCaptionLayer(pts, out_caption);
+
+    out_superimpose.pts = 0;
+    out_superimpose.duration = 0;
+    out_superimpose.images.clear();
+    out_superimpose.region_cache_hits = 0;
+    out_superimpose.quality = RenderQuality::kFull;
+    out_superimpose.image_changed.clear();
+    if (caption_status == RenderStatus::kError || caption_status == RenderStatus::kNotReady) {
+        return caption_status;
+    }
+
+    bool superimpose_vanished = false;
+    RenderStatus superimpose_status = RenderSuperimposeLayer(pts, out_superimpose, superimpose_vanished);
+    if (superimpose_status == RenderStatus::kError) {
+        return superimpose_status;
+    }
+    return CombineLayerStatus(caption_status, caption_shown && caption_status == RenderStatus::kNoImage,
+                              superimpose_status, superimpose_vanished);
+}
+
+RenderStatus RendererImpl::CombineLayerStatus(RenderStatus caption_status, bool caption_vanished,
+                                              RenderStatus superimpose_status, bool superimpose_vanished) {
+    auto has_images = [](RenderStatus status) {
+        return status == RenderStatus::kGotImage || status == RenderStatus::kGotImageUnchanged;
+    };
+    if (!has_images(caption_status) && !has_images(superimpose_status)) {
+        return caption_status == RenderStatus::kNoImage ? superimpose_status : caption_status;
+    }
+    // Images disappeared from one layer are a change as well
+    bool changed = caption_status == RenderStatus::kGotImage || superimpose_status == RenderStatus::kGotImage ||
+                   caption_vanished || superimpose_vanished;
+    return changed ? RenderStatus::kGotImage : RenderStatus::kGotImageUnchanged;
+}
+
+RenderStatus RendererImpl::RenderSuperimposeLayer(int64_t pts, RenderResult& out_result, bool& out_vanished) {
+    out_vanished = !prev_superimpose_images_.empty();
+
+    const Caption* found = FindSuperimposeAt(pts);
+    if (!found) {
+        InvalidateSuperimposeImages();
+        return RenderStatus::kNoImage;
+    }
+
+    if (has_prev_superimpose_ && prev_superimpose_pts_ == found->pts) {
+        out_vanished = false;
+        if (prev_superimpose_images_.empty()) {
+            return RenderStatus::kNoImage;
+        }
+        out_result.pts = found->pts;
+        out_result.duration = found->wait_duration;
+        out_result.image_changed.assign(prev_superimpose_images_.size(), 0);
+        return RenderStatus::kGotImageUnchanged;
+    }
+
+    // Shares the region renderers with the caption layer, thus with the asynchronous rendering thread
+    auto lock = LockRendering();
+    std::vector<Image> images;
+    std::vector<uint64_t> image_hashes;
+    if (!RenderCaptionImages(*found, images, image_hashes, nullptr)) {
+        RecycleImages(std::move(images));
+        InvalidateSuperimposeImages();
+        return RenderStatus::kError;
+    }
+    if (share_image_buffers_) {
+        for (Image& image : images) {
+            Bitmap::ShareImageBuffer(image, bitmap_pool_.get());
+        }
+    }
+
+    RecycleImages(std::move(prev_superimpose_images_));
+    has_prev_superimpose_ = true;
+    prev_superimpose_pts_ = found->pts;
+    prev_superimpose_images_ = std::move(images);
+    if (prev_superimpose_images_.empty()) {
+        return RenderStatus::kNoImage;
+    }
+
+    out_result.pts = found->pts;
+    out_result.duration = found->wait_duration;
+    out_result.image_changed.assign(prev_superimpose_images_.size(), 1);
+    return RenderStatus::kGotImage;
+}
+
+RenderStatus RendererImpl::RenderCaptionLayer(int64_t pts, RenderResult& out_result) {
+    if (!frame_size_inited_ || !margins_inited_) {
+        assert(frame_size_inited_ && margins_inited_ && "Frame size / margins must be indicated first");
+        return RenderStatus::kError;
+    }
+
+    out_result.pts = 0;
+    out_result.duration = 0;
+    out_result.images.clear();
+    out_result.region_cache_hits = 0;
+    out_result.quality = RenderQuality::kFull;
+    out_result.image_changed.clear();
+
+    ApplyPendingMemoryTrim();
+
+    if (async_enabled_) {
+        return RenderAsync(pts, out_result);
+    }
+
+    WaitForPreload();
+
+    if (captions_.empty()) {
+        InvalidatePrevRenderedImages();
+        return RenderStatus::kNoImage;
+    }
+
+    Caption* found = FindCaptionAt(pts);
+    if (!found) {
+        // Timeout, or empty caption
+        InvalidatePrevRenderedImages();
+        return RenderStatus::kNoImage;
+    }
+    Caption& caption = *found;
+
+    bool same_caption = has_prev_rendered_caption_ && prev_rendered_caption_pts_ == caption.pts;
+    RenderQuality quality = RenderQuality::kFull;
+    if (render_time_budget_ > 0) {
+        if (same_caption && prev_rendered_quality_ != RenderQuality::kFull) {
+            // Better levels are predicted cheaper as time goes, so that restoring gets attempted
+            for (size_t level = 0; level < static_cast<size_t>(prev_rendered_quality_); level++) {
+                render_quality_costs_[level] *= 0.97;
+            }
+        }
+        quality = ChooseRenderQuality(caption);
+    }
+
+    if (same_caption && (render_time_budget_ <= 0 || quality >= prev_rendered_quality_)) {
+        // Reuse previous rendered caption
+        out_result.quality = prev_rendered_quality_;
+        if (!prev_rendered_images_.empty()) {
+            // Images moved by a resize of the video area are reported as changed
+            bool moved = prev_rendered_images_moved_;
+            prev_rendered_images_moved_ = false;
+            out_result.pts = prev_rendered_caption_pts_;
+            out_result.duration = prev_rendered_caption_duration_;
+            prev_rendered_images_changed_.assign(prev_rendered_images_.size(), moved ? 1 : 0);
+            out_result.image_changed = prev_rendered_images_changed_;
+            return moved ? RenderStatus::kGotImage : RenderStatus::kGotImageUnchanged;
+        } else {
+            InvalidatePrevRenderedImages();
+            return RenderStatus::kNoImage;
+        }
+    }
+
+    uint64_t region_cache_hits_before = 0;
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) {
+        region_cache_hits_before += region_renderer.region_image_cache_hits();
+    });
+
+    std::vector<Image> images;
+    std::vector<uint64_t> image_hashes;
+    std::vector<uint8_t> images_changed;
+    auto render_begin = std::chrono::steady_clock::now();
+    uint64_t render_start_us = Metrics::NowMicroseconds();
+    if (quality != RenderQuality::kFull) {
+        ApplyRenderQuality(quality);
+    }
+    bool rendered = RenderCaptionImages(caption, images, image_hashes, &images_changed);
+    if (quality != RenderQuality::kFull) {
+        ApplyRenderQuality(RenderQuality::kFull);
+    }
+    if (!rendered) {
+        RecycleImages(std::move(images));
+        InvalidatePrevRenderedImages();
+        return RenderStatus::kError;
+    }
+    RecordFirstRender(render_start_us);
+    if (render_time_budget_ > 0) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                             render_begin);
+        UpdateRenderQualityCost(caption, quality, elapsed.count());
+    }
+
+    // Prerendered images of this caption have been taken over, drop them along with the outdated ones
+    for (auto iter = prerendered_.begin(); iter != prerendered_.end() && iter->first <= caption.pts; ) {
+        RecycleImages(std::move(iter->second.images));
+        iter = prerendered_.erase(iter);
+    }
+
+    if (share_image_buffers_) {
+        for (Image& image : images) {
+            Bitmap::ShareImageBuffer(image, bitmap_pool_.get());
+        }
+    }
+
+    RecycleImages(std::move(prev_rendered_images_));
+
+    has_prev_rendered_caption_ = true;
+    prev_rendered_caption_pts_ = caption.pts;
+    prev_rendered_caption_duration_ = caption.wait_duration;
     prev_rendered_images_ = std::move(images);
+    prev_rendered_images_moved_ = false;
+    prev_rendered_image_hashes_ = std::move(image_hashes);
+    prev_rendered_images_changed_ = std::move(images_changed);
+    prev_rendered_quality_ = quality;
+
+    out_result.image_changed = prev_rendered_images_changed_;
+    out_result.quality = quality;
+
+    out_result.pts = caption.pts;
+    out_result.duration = caption.wait_duration;
+    uint64_t region_cache_hits_after = 0;
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) {
+        region_cache_hits_after += region_renderer.region_image_cache_hits();
+    });
+    out_result.region_cache_hits = static_cast<uint32_t>(region_cache_hits_after - region_cache_hits_before);
+    return RenderStatus::kGotImage;
+}
+
+RenderStatus RendererImpl::RenderForFrameSizes(int64_t pts,
+                                               const std::vector<RenderTargetSize>& sizes,
+                                               std::vector<RenderResult>& out_results) {
+    for (RenderResult& result : out_results) {
+        RecycleImages(std::move(result.images));
+    }
+    out_results.clear();
+    if (!frame_size_inited_ || !margins_inited_) {
+        assert(frame_size_inited_ && margins_inited_ && "Frame size / margins must be indicated first");
+        return RenderStatus::kError;
+    }
+    for (const RenderTargetSize& size : sizes) {
+        if (size.frame_width <= 0 || size.frame_height <= 0) {
+            log_->e("RendererImpl: Invalid frame size %dx%d", size.frame_width, size.frame_height);
+            return RenderStatus::kError;
+        }
+    }
+
+    WaitForPreload();
+    auto lock = LockRendering();
+    ApplyPendingMemoryTrim();
+    auto async_lock = LockAsyncState();
+
+    Caption* found = FindCaptionAt(pts);
+    if (!found) {
+        return RenderStatus::kNoImage;
+    }
+    const Caption& caption = *found;
+
+    // The caption area is set up from the video area by RenderCaptionImages(), switch it for each size.
+    // Nothing else depends on the frame size, so the original one is simply restored afterwards.
+    int video_area_width = video_area_width_;
+    int video_area_height = video_area_height_;
+    auto scale_margin = [](int margin, int size, int frame_size) {
+        return frame_size ? static_cast<int>(static_cast<int64_t>(margin) * size / frame_size) : 0;
+    };
+
+    bool failed = false;
+    for (const RenderTargetSize& size : sizes) {
+        video_area_width_ = std::max(0, size.frame_width -
+                                        scale_margin(margin_left_, size.frame_width, frame_width_) -
+                                        scale_margin(margin_right_, size.frame_width, frame_width_));
+        video_area_height_ = std::max(0, size.frame_height -
+                                         scale_margin(margin_top_, size.frame_height, frame_height_) -
+                                         scale_margin(margin_bottom_, size.frame_height, frame_height_));
+
+        RenderResult& result = out_results.emplace_back();
+        result.pts = caption.pts;
+        result.duration = caption.wait_duration;
+        std::vector<uint64_t> image_hashes;
+        if (!RenderCaptionImages(caption, result.images, image_hashes, nullptr)) {
+            failed = true;
+            break;
+        }
+        result.image_changed.assign(result.images.size(), 1);
+    }
+
+    video_area_width_ = video_area_width;
+    video_area_height_ = video_area_height;
+
+    if (failed) {
+        for (RenderResult& result : out_results) {
+            RecycleImages(std::move(result.images));
+        }
+        out_results.clear();
+        return RenderStatus::kError;
+    }
+    return RenderStatus::kGotImage;
+}
+
+bool RendererImpl::TakeImage(std::vector<Image>& from_images, std::vector<uint64_t>& from_hashes, uint64_t hash,
+                             std::vector<Image>& images, std::vector<uint64_t>& hashes) {
+    for (size_t i = 0; i < from_hashes.size(); i++) {
+        if (from_hashes[i] == hash && from_images[i].width) {
+            images.push_back(std::move(from_images[i]));
+            from_images[i] = Image{};
+            hashes.push_back(hash);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RendererImpl::RenderCaptionImages(const Caption& caption,
+                                       std::vector<Image>& images,
+                                       std::vector<uint64_t>& image_hashes,
+                                       std::vector<uint8_t>* images_changed) {
+    PrepareRegionRenderer(caption);
+
+    std::vector<CaptionRegion> region_storage;
+    const std::vector<CaptionRegion>& regions = GetRenderRegions(caption, region_storage);
+    bool skip_ruby = force_no_ruby_ || render_quality_ >= RenderQuality::kNoRuby;
+
+    std::vector<uint64_t> region_hashes;
+    region_hashes.reserve(regions.size());
+    for (const CaptionRegion& region : regions) {
+        if (region.is_ruby && skip_ruby) {
+            continue;
+        }
+        region_hashes.push_back(region_renderer_.HashRegion(region, caption.drcs_map));
+    }
+
+    // When presenting, take over identical images from the previous rendering (unchanged),
+    // or from the prerendered images of this caption (changed, but ready)
+    auto prerendered_iter = images_changed ? prerendered_.find(caption.pts) : prerendered_.end();
+    auto take_image = [&](uint64_t hash) -> bool {
+        if (!images_changed) {
+            return false;
+        }
+        if (TakeImage(prev_rendered_images_, prev_rendered_image_hashes_, hash, images, image_hashes)) {
+            images_changed->push_back(prev_rendered_images_moved_ ? 1 : 0);
+            return true;
+        }
+        if (prerendered_iter != prerendered_.end() &&
+                TakeImage(prerendered_iter->second.images, prerendered_iter->second.hashes, hash, images, image_hashes)) {
+            images_changed->push_back(1);
+            return true;
+        }
+        return false;
+    };
+
+    bool merge = merge_region_images_ && region_hashes.size() > 1;
+
+    uint64_t merged_hash = 0xCBF29CE484222325ull;
+    for (uint64_t hash : region_hashes) {
+        merged_hash = (merged_hash ^ hash) * 0x100000001B3ull;
+    }
+
+    if (merge && take_image(merged_hash)) {
+        // Merged image is ready, skip rendering the regions
+        return true;
+    }
+
+    // Collect regions to be rendered, images taken over keep their positions in region order
+    std::vector<RegionJob> jobs;
+    std::vector<Image> taken_images;
+    std::vector<uint64_t> taken_hashes;
+    std::vector<uint8_t> taken_changed;
+    std::vector<size_t> order;  // Index into jobs, or ~index into taken_images
+    size_t hash_index = 0;
+    for (const CaptionRegion& region : regions) {
+        if (region.is_ruby && skip_ruby) {
+            continue;
+        }
+        uint64_t region_hash = region_hashes[hash_index++];
+
+        if (!merge && take_image(region_hash)) {
+            // take_image() appends to images, move it aside until other regions are rendered
+            taken_images.push_back(std::move(images.back()));
+            taken_hashes.push_back(image_hashes.back());
+            taken_changed.push_back(images_changed->back());
+            images.pop_back();
+            image_hashes.pop_back();
+            images_changed->pop_back();
+            order.push_back(~(taken_images.size() - 1));
+            continue;
+        }
+
+        RegionJob& job = jobs.emplace_back();
+        job.region = &region;
+        job.drcs_map = &caption.drcs_map;
+        job.region_hash = region_hash;
+        order.push_back(jobs.size() - 1);
+    }
+
+    RenderRegionJobs(jobs);
+
+    bool failed = false;
+    for (size_t index : order) {
+        if (index >= jobs.size()) {
+            size_t taken_index = ~index;
+            images.push_back(std::move(taken_images[taken_index]));
+            image_hashes.push_back(taken_hashes[taken_index]);
+            images_changed->push_back(taken_changed[taken_index]);
+            continue;
+        }
+
+        Result<Image, RegionRenderError>& result = jobs[index].result.value();
+        if (result.is_ok()) {
+            if (!merge) {
+                MapImageToDisplayArea(result.value());
+                ConvertOutputPixelFormat(result.value());
+            }
+            images.push_back(std::move(result.value()));
+            image_hashes.push_back(jobs[index].region_hash);
+            metrics_->Add(MetricCounter::kImagesProduced);
+            if (images_changed) {
+                images_changed->push_back(1);
+            }
+        } else if (result.error() == RegionRenderError::kImageTooSmall ||
+                   result.error() == RegionRenderError::kImageTransparent) {
+            // Skip image which is too small or fully transparent
+            continue;
+        } else if (!failed) {
+            log_->e("RendererImpl: RenderCaptionRegion() failed with error: %d", static_cast<int>(result.error()));
+            failed = true;
+        }
+    }
+    if (failed) {
+        return false;
+    }
+
+    if (merge && images.size() > 1) {
+        Image merged = MergeImages(images);
+        images.clear();
+        images.push_back(std::move(merged));
+        image_hashes.assign(1, merged_hash);
+        if (images_changed) {
+            images_changed->assign(1, 1);
+        }
+    }
+    if (merge && !images.empty()) {
+        MapImageToDisplayArea(images.front());
+        ConvertOutputPixelFormat(images.front());
+    }
+
+    return true;
+}
+
+namespace {
+
+template <PixelFormat format>
+void ConvertImagePixels(Image& image) {
+    uint8_t* data = image.bitmap.data();
+    for (int y = 0; y < image.height; y++) {
+        auto line = reinterpret_cast<ColorRGBA*>(data + static_cast<size_t>(y) * image.stride);
+        alphablend::ConvertLine<format>(line, static_cast<size_t>(image.width));
+    }
+    image.pixel_format = format;
+}
+
+}  // namespace
+
+void RendererImpl::ConvertOutputPixelFormat(Image& image) {
+    if (output_pixel_format_ == image.pixel_format) {
+        if (run_length_encoded_images_) {
+            EncodeImageRunLength(image, bitmap_pool_.get());
+        }
+        return;
+    }
+    assert(image.pixel_format == PixelFormat::kRGBA8888);
+
+    if (image.shared_bitmap) {
+        // Pixels may be shared with the region image cache, convert a copy
+        image = Bitmap::UnshareImageBuffer(image, bitmap_pool_.get());
+    }
+
+    switch (output_pixel_format_) {
+        case PixelFormat::kRGBA8888Premultiplied:
+            ConvertImagePixels<PixelFormat::kRGBA8888Premultiplied>(image);
+            break;
+        case PixelFormat::kBGRA8888:
+            ConvertImagePixels<PixelFormat::kBGRA8888>(image);
+            break;
+        case PixelFormat::kBGRA8888Premultiplied:
+            ConvertImagePixels<PixelFormat::kBGRA8888Premultiplied>(image);
+            break;
+        case PixelFormat::kIndexed8:
+            ConvertImageToIndexed8(image, bitmap_pool_.get());
+            break;
+        case PixelFormat::kRGBA8888:
+        default:
+            break;
+    }
+
+    if (run_length_encoded_images_) {
+        EncodeImageRunLength(image, bitmap_pool_.get());
+    }
+}
+
+size_t RendererImpl::Prerender(int64_t pts_begin, int64_t pts_end) {
+    if (!frame_size_inited_ || !margins_inited_) {
+        assert(frame_size_inited_ && margins_inited_ && "Frame size / margins must be indicated first");
+        return 0;
+    }
+
+    if (async_enabled_) {
+        return 0;  // Upcoming captions are rendered by the worker thread already
+    }
+
+    WaitForPreload();
+
+    // Drop prerendered images of captions which have been removed
+    for (auto iter = prerendered_.begin(); iter != prerendered_.end(); ) {
+        if (captions_.find(iter->first) == captions_.end()) {
+            RecycleImages(std::move(iter->second.images));
+            iter = prerendered_.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    size_t count = 0;
+    for (auto iter = captions_.lower_bound(pts_begin); iter != captions_.end() && iter->first < pts_end; ++iter) {
+        if (prerendered_.find(iter->first) != prerendered_.end() ||
+                (has_prev_rendered_caption_ && prev_rendered_caption_pts_ == iter->first)) {
+            continue;  // Already rendered
+        }
+
+        // Cold captions are decompressed temporarily, rather than kept out of the hot window
+        Caption cold_caption;
+        const Caption* stored = GetCaptionForRendering(iter, cold_caption);
+        if (!stored) {
+            continue;
+        }
+        const Caption& caption = *stored;
+
+        PrerenderedImages prerendered;
+        if (!RenderCaptionImages(caption, prerendered.images, prerendered.hashes, nullptr)) {
+            RecycleImages(std::move(prerendered.images));
+            continue;
+        }
+        prerendered_.emplace(caption.pts, std::move(prerendered));
+        count++;
+    }
+
+    return count;
+}
+
+size_t RendererImpl::RenderBatch(int64_t pts_begin, int64_t pts_end, std::vector<RenderResult>& out_results) {
+    out_results.clear();
+    if (!frame_size_inited_ || !margins_inited_) {
+        assert(frame_size_inited_ && margins_inited_ && "Frame size / margins must be indicated first");
+        return 0;
+    }
+
+    WaitForPreload();
+    auto lock = LockRendering();
+    auto async_lock = LockAsyncState();
+
+    // Consecutive captions sharing font language and plane size are rendered as one list of region jobs,
+    // so that regions of different captions are spread over the region worker threads
+    struct BatchCaption {
+        const Caption* caption = nullptr;
+        Caption cold_storage;
+        std::vector<CaptionRegion> region_storage;
+        size_t first_job = 0;
+        size_t job_count = 0;
+    };
+    constexpr size_t kMaxBatchCaptions = 64;
+    std::deque<BatchCaption> batch;  // Jobs refer to the regions stored inside
+    std::vector<RegionJob> jobs;
+
+    auto render_batch = [&]() {
+        RenderRegionJobs(jobs);
+
+        for (BatchCaption& item : batch) {
+            const Caption& caption = *item.caption;
+            bool merge = merge_region_images_ && item.job_count > 1;
+
+            RenderResult result;
+            result.pts = caption.pts;
+            result.duration = caption.wait_duration;
+            bool failed = false;
+            for (size_t i = item.first_job; i < item.first_job + item.job_count; i++) {
+                Result<Image, RegionRenderError>& region_result = jobs[i].result.value();
+                if (region_result.is_ok()) {
+                    if (!merge) {
+                        MapImageToDisplayArea(region_result.value());
+                        ConvertOutputPixelFormat(region_result.value());
+                    }
+                    result.images.push_back(std::move(region_result.value()));
+                    metrics_->Add(MetricCounter::kImagesProduced);
+                } else if (region_result.error() != RegionRenderError::kImageTooSmall &&
+                           region_result.error() != RegionRenderError::kImageTransparent && !failed) {
+                    log_->e("RendererImpl: RenderCaptionRegion() failed with error: %d",
+                            static_cast<int>(region_result.error()));
+                    failed = true;
+                }
+            }
+            if (failed) {
+                RecycleImages(std::move(result.images));
+                continue;
+            }
+
+            if (merge && result.images.size() > 1) {
+                Image merged = MergeImages(result.images);
+                result.images.clear();
+                result.images.push_back(std::move(merged));
+            }
+            if (merge && !result.images.empty()) {
+                MapImageToDisplayArea(result.images.front());
+                ConvertOutputPixelFormat(result.images.front());
+            }
+            result.image_changed.assign(result.images.size(), 1);
+            out_results.push_back(std::move(result));
+        }
+
+        batch.clear();
+        jobs.clear();
+    };
+
+    for (auto iter = captions_.lower_bound(pts_begin); iter != captions_.end() && iter->first < pts_end; ++iter) {
+        Caption cold_caption;
+        const Caption* stored = GetCaptionForRendering(iter, cold_caption);
+        if (!stored) {
+            continue;
+        }
+
+        if (!batch.empty()) {
+            const Caption& first = *batch.front().caption;
+            if (batch.size() >= kMaxBatchCaptions || first.iso6392_language_code != stored->iso6392_language_code ||
+                    first.plane_width != stored->plane_width || first.plane_height != stored->plane_height) {
+                render_batch();
+            }
+        }
+        if (batch.empty()) {
+            // Region hashes depend on the font family and caption area as well
+            PrepareRegionRenderer(*stored);
+        }
+
+        BatchCaption& item = batch.emplace_back();
+        if (stored == &cold_caption) {
+            item.cold_storage = std::move(cold_caption);
+            stored = &item.cold_storage;
+        }
+        item.caption = stored;
+        item.first_job = jobs.size();
+
+        for (const CaptionRegion& region : GetRenderRegions(*stored, item.region_storage)) {
+            if (region.is_ruby && force_no_ruby_) {
+                continue;
+            }
+            RegionJob& job = jobs.emplace_back();
+            job.region = &region;
+            job.drcs_map = &stored->drcs_map;
+            job.region_hash = region_renderer_.HashRegion(region, stored->drcs_map);
+        }
+        item.job_count = jobs.size() - item.first_job;
+    }
+    if (!batch.empty()) {
+        render_batch();
+    }
+
+    return out_results.size();
+}
+
+bool RendererImpl::SetGlyphAtlasSize(int width, int height) {
+    if (width <= 0 || height <= 0) {
+        assert(width > 0 && height > 0 && "Atlas width/height must > 0");
+        return false;
+    }
+
+    auto lock = LockRendering();
+    glyph_atlas_.SetSize(width, height);
+    OnRenderingSettingsChanged();
+    return true;
+}
+
+RenderStatus RendererImpl::RenderGlyphAtlas(int64_t pts, GlyphAtlasRenderResult& out_result) {
+    if (!frame_size_inited_ || !margins_inited_) {
+        assert(frame_size_inited_ && margins_inited_ && "Frame size / margins must be indicated first");
+        return RenderStatus::kError;
+    }
+
+    out_result.pts = 0;
+    out_result.duration = 0;
+    out_result.quads.clear();
+    out_result.dirty_rects.clear();
+
+    auto lock = LockRendering();
+    ApplyPendingMemoryTrim();
+    auto async_lock = LockAsyncState();
+
+    auto fill_atlas_info = [&]() {
+        out_result.atlas_generation = glyph_atlas_.generation();
+        out_result.atlas_width = glyph_atlas_.width();
+        out_result.atlas_height = glyph_atlas_.height();
+        out_result.atlas_pixels = glyph_atlas_.data();
+        for (const Rect& rect : glyph_atlas_.TakeDirtyRects()) {
+            out_result.dirty_rects.push_back(AtlasRect{rect.left, rect.top, rect.width(), rect.height()});
+        }
+    };
+    fill_atlas_info();
+
+    Caption* found = FindCaptionAt(pts);
+    if (!found) {
+        has_prev_atlas_caption_ = false;
+        prev_atlas_caption_pts_ = PTS_NOPTS;
+        prev_atlas_quads_.clear();
+        return RenderStatus::kNoImage;
+    }
+    Caption& caption = *found;
+
+    if (has_prev_atlas_caption_ && prev_atlas_caption_pts_ == caption.pts) {
+        out_result.pts = caption.pts;
+        out_result.duration = caption.wait_duration;
+        out_result.quads = prev_atlas_quads_;
+        return prev_atlas_quads_.empty() ? RenderStatus::kNoImage : RenderStatus::kGotImageUnchanged;
+    }
+
+    PrepareRegionRenderer(caption, false);
+
+    std::vector<CaptionRegion> region_storage;
+    const std::vector<CaptionRegion>& regions = GetRenderRegions(caption, region_storage);
+
+    std::vector<GlyphQuad> quads;
+
+    // If the atlas runs out of space, reset it and start over once
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool atlas_full = false;
+        quads.clear();
+
+        for (const CaptionRegion& region : regions) {
+            if (region.is_ruby && force_no_ruby_) {
+                continue;
+            }
+
+            auto result = region_renderer_.RenderCaptionRegionQuads(region, caption.drcs_map, glyph_atlas_);
+            if (result.is_ok()) {
+                std::vector<GlyphQuad>& region_quads = result.value();
+                quads.insert(quads.end(), region_quads.begin(), region_quads.end());
+            } else if (result.error() == RegionRenderError::kImageTooSmall ||
+                       result.error() == RegionRenderError::kImageTransparent) {
+                continue;
+            } else if (result.error() == RegionRenderError::kAtlasFull) {
+                atlas_full = true;
+                break;
+            } else {
+                log_->e("RendererImpl: RenderCaptionRegionQuads() failed with error: %d",
+                        static_cast<int>(result.error()));
+                has_prev_atlas_caption_ = false;
+                return RenderStatus::kError;
+            }
+        }
+
+        if (!atlas_full) {
+            break;
+        } else if (attempt == 0) {
+            glyph_atlas_.Reset();
+        } else {
+            log_->e("RendererImpl: Glyph atlas is too small for the caption");
+            has_prev_atlas_caption_ = false;
+            glyph_atlas_.Reset();
+            return RenderStatus::kError;
+        }
+    }
+
+    has_prev_atlas_caption_ = true;
+    prev_atlas_caption_pts_ = caption.pts;
+    prev_atlas_quads_ = std::move(quads);
+
+    fill_atlas_info();
+    out_result.pts = caption.pts;
+    out_result.duration = caption.wait_duration;
+    out_result.quads = prev_atlas_quads_;
+    return RenderStatus::kGotImage;
+}
+
+RenderStatus RendererImpl::RenderLayout(int64_t pts, LayoutResult& out_result) {
+    if (!frame_size_inited_ || !margins_inited_) {
+        assert(frame_size_inited_ && margins_inited_ && "Frame size / margins must be indicated first");
+        return RenderStatus::kError;
+    }
+
+    out_result.pts = 0;
+    out_result.duration = 0;
+    out_result.regions.clear();
+
+    auto lock = LockRendering();
+    ApplyPendingMemoryTrim();
+    auto async_lock = LockAsyncState();
+
+    Caption* found = FindCaptionAt(pts);
+    if (!found) {
+        return RenderStatus::kNoImage;
+    }
+    const Caption& caption = *found;
+
+    // Only the caption area is needed, fonts are left untouched
+    AdjustCaptionArea(caption.plane_width, caption.plane_height, false);
+
+    std::vector<CaptionRegion> region_storage;
+    for (const CaptionRegion& region : GetRenderRegions(caption, region_storage)) {
+        if (region.is_ruby && force_no_ruby_) {
+            continue;
+        }
+        out_result.regions.push_back(region_renderer_.LayoutCaptionRegion(region));
+    }
 
     out_result.pts = caption.pts;
     out_result.duration = caption.wait_duration;
-    out_result.images = prev_rendered_images_;
     return RenderStatus::kGotImage;
 }
 
 Image RendererImpl::MergeImages(std::vector<Image>& images) {
     if (images.empty()) return Image{};
+    ARIBCC_TRACE_SCOPE(tracer_.get(), "renderer", "RendererImpl::MergeImages");
 
     Rect rect(images[0].dst_x, images[0].dst_y, images[0].dst_x, images[0].dst_y);
 
@@ -431,14 +2082,65 @@ Image RendererImpl::MergeImages(std::vector<Image>& images) {
         rect.Include(image.dst_x + image.width - 1, image.dst_y + image.height - 1);  // bottom right corner
     }
 
-    Bitmap bitmap(rect.width(), rect.height(), PixelFormat::kRGBA8888);
-    Canvas canvas(bitmap);
+    // Caption regions hardly overlap
+    bool overlapped = false;
+    for (size_t i = 0; i < images.size() && !overlapped; i++) {
+        const Image& a = images[i];
+        Rect a_rect(a.dst_x, a.dst_y, a.dst_x + a.width, a.dst_y + a.height);
+        for (size_t j = i + 1; j < images.size(); j++) {
+            const Image& b = images[j];
+            Rect intersection = Rect::ClipRect(a_rect, Rect(b.dst_x, b.dst_y, b.dst_x + b.width, b.dst_y + b.height));
+            if (intersection.width() > 0 && intersection.height() > 0) {
+                overlapped = true;
+                break;
+            }
+        }
+    }
 
-    for (auto& image : images) {
-        int x = image.dst_x - rect.left;
-        int y = image.dst_y - rect.top;
-        Bitmap bmp = Bitmap::FromImage(std::move(image));
-        canvas.DrawBitmap(bmp, x, y);
+    // Pixels are cleared only where no image is copied to
+    Bitmap bitmap(rect.width(), rect.height(), PixelFormat::kRGBA8888, bitmap_pool_.get(),
+                  overlapped ? BitmapInit::kClear : BitmapInit::kUninitialized);
+
+    if (!overlapped) {
+        // Blending onto transparent pixels is a plain copy, copy the rows directly from the images
+        // and clear the gaps between them, so that each pixel is written once
+        std::vector<const Image*> row_images;
+        for (int y = 0; y < bitmap.height(); y++) {
+            row_images.clear();
+            for (const Image& image : images) {
+                int image_y = y + rect.top - image.dst_y;
+                if (image_y >= 0 && image_y < image.height) {
+                    row_images.push_back(&image);
+                }
+            }
+            std::sort(row_images.begin(), row_images.end(), [](const Image* a, const Image* b) {
+                return a->dst_x < b->dst_x;
+            });
+
+            auto line = reinterpret_cast<uint8_t*>(bitmap.GetPixelAt(0, y));
+            size_t offset = 0;
+            for (const Image* image : row_images) {
+                auto x = static_cast<size_t>(image->dst_x - rect.left) * sizeof(ColorRGBA);
+                auto row_bytes = static_cast<size_t>(image->width) * sizeof(ColorRGBA);
+                memset(line + offset, 0, x - offset);
+                memcpy(line + x, image->data() + static_cast<size_t>(y + rect.top - image->dst_y) * image->stride,
+                       row_bytes);
+                offset = x + row_bytes;
+            }
+            memset(line + offset, 0, static_cast<size_t>(bitmap.stride()) - offset);
+        }
+        for (auto& image : images) {
+            bitmap_pool_->Recycle(std::move(image));
+        }
+    } else {
+        Canvas canvas(bitmap);
+        for (auto& image : images) {
+            int x = image.dst_x - rect.left;
+            int y = image.dst_y - rect.top;
+            Bitmap bmp = Bitmap::FromImage(std::move(image), bitmap_pool_.get());
+            canvas.DrawBitmap(bmp, x, y);
+            bitmap_pool_->Recycle(Bitmap::ToImage(std::move(bmp)));
+        }
     }
 
     Image merged = Bitmap::ToImage(std::move(bitmap));
@@ -447,35 +2149,712 @@ Image RendererImpl::MergeImages(std::vector<Image>& images) {
     return merged;
 }
 
-void RendererImpl::AdjustCaptionArea(int origin_plane_width, int origin_plane_height) {
-    float x_magnification = static_cast<float>(video_area_width_) / static_cast<float>(origin_plane_width);
-    float y_magnification = static_cast<float>(video_area_height_) / static_cast<float>(origin_plane_height);
+auto RendererImpl::FindSuperimposeAt(int64_t pts) const -> const Caption* {
+    auto next = superimposes_.upper_bound(pts);
+    if (next == superimposes_.begin()) {
+        return nullptr;
+    }
+    const Caption& superimpose = std::prev(next)->second;
+    return pts < CaptionEndPTS(superimpose) ? &superimpose : nullptr;
+}
+
+auto RendererImpl::FindCaptionAt(int64_t pts) -> Caption* {
+    if (captions_.empty()) {
+        return nullptr;
+    }
+
+    if (caption_index_dirty_) {
+        RebuildCaptionIndex();
+    }
+
+    // Find the last caption starting at or before pts, or the first one if there is none.
+    // Playback moves forward, so try the remembered cursor and its successor before searching.
+    size_t count = caption_index_.size();
+    auto starts_at_or_before = [&](size_t i) { return caption_index_[i].pts <= pts; };
+    size_t cursor = std::min(caption_cursor_, count - 1);
+
+    if (starts_at_or_before(cursor) && (cursor + 1 == count || !starts_at_or_before(cursor + 1))) {
+        // Still within the current caption
+    } else if (cursor + 1 < count && starts_at_or_before(cursor + 1) &&
+               (cursor + 2 == count || !starts_at_or_before(cursor + 2))) {
+        cursor++;
+    } else {
+        // Seeked
+        auto iter = std::upper_bound(caption_index_.begin(), caption_index_.end(), pts,
+                                     [](int64_t value, const CaptionIndexEntry& entry) {
+                                         return value < entry.pts;
+                                     });
+        cursor = iter == caption_index_.begin() ? 0 : static_cast<size_t>(iter - caption_index_.begin()) - 1;
+    }
+    caption_cursor_ = cursor;
+
+    if (cold_caption_storage_ && (cold_sweep_pending_ || cold_sweep_pts_ == PTS_NOPTS ||
+                                  std::abs(pts - cold_sweep_pts_) > cold_hot_window_ / 2)) {
+        FreezeColdCaptions(pts);
+    }
+
+    const CaptionIndexEntry& entry = caption_index_[cursor];
+    if (pts < entry.pts || pts >= entry.end_pts) {
+        // Timeout
+        return nullptr;
+    }
+    if (!cold_captions_.empty()) {
+        ThawCaption(captions_.find(entry.pts));
+    }
+    if (entry.caption->regions.empty()) {
+        return nullptr;
+    }
+
+    return entry.caption;
+}
+
+void RendererImpl::PrepareRegionRenderer(const Caption& caption, bool limit_magnification) {
+    // Set up Font Language
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) {
+        region_renderer.SetFontLanguage(caption.iso6392_language_code);
+    });
+
+    // Set up Font Family
+    uint32_t language_code = caption.iso6392_language_code;
+    if (force_default_font_family_ || language_font_family_.find(language_code) == language_font_family_.end()) {
+        language_code = 0;
+    }
+    const std::vector<std::string>& font_family = language_font_family_[language_code];
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) { region_renderer.SetFontFamily(font_family); });
+
+    // Set up origin plane size / target caption area
+    AdjustCaptionArea(caption.plane_width, caption.plane_height, limit_magnification);
+}
+
+Rect RendererImpl::CalcCaptionArea(int video_area_width, int video_area_height,
+                                   int origin_plane_width, int origin_plane_height) {
+    float x_magnification = static_cast<float>(video_area_width) / static_cast<float>(origin_plane_width);
+    float y_magnification = static_cast<float>(video_area_height) / static_cast<float>(origin_plane_height);
     float magnification = std::min(x_magnification, y_magnification);
 
     int caption_area_width = static_cast<int>(std::floor(static_cast<float>(origin_plane_width) * magnification));
     int caption_area_height = static_cast<int>(std::floor(static_cast<float>(origin_plane_height) * magnification));
-    int caption_area_start_x = (video_area_width_ - caption_area_width) / 2;
-    int caption_area_start_y = (video_area_height_ - caption_area_height) / 2;
+    int caption_area_start_x = (video_area_width - caption_area_width) / 2;
+    int caption_area_start_y = (video_area_height - caption_area_height) / 2;
+
+    return Rect(caption_area_start_x,
+                caption_area_start_y,
+                caption_area_start_x + caption_area_width,
+                caption_area_start_y + caption_area_height);
+}
+
+void RendererImpl::AdjustCaptionArea(int origin_plane_width, int origin_plane_height, bool limit_magnification) {
+    Rect caption_area = CalcCaptionArea(video_area_width_, video_area_height_, origin_plane_width, origin_plane_height);
+
+    float max_magnification = max_render_magnification_;
+    if (render_quality_ >= RenderQuality::kReducedScale) {
+        float reduced = static_cast<float>(caption_area.width()) / static_cast<float>(origin_plane_width) / 2.0f;
+        max_magnification = max_magnification > 0.0f ? std::min(max_magnification, reduced) : reduced;
+    }
+
+    float max_width = static_cast<float>(origin_plane_width) * max_magnification;
+    render_area_scaled_ = limit_magnification && max_magnification > 0.0f &&
+                          static_cast<float>(caption_area.width()) > max_width;
+    if (render_area_scaled_) {
+        float max_height = static_cast<float>(origin_plane_height) * max_magnification;
+        display_area_ = caption_area;
+        render_area_ = Rect(0, 0, std::max(1, static_cast<int>(std::floor(max_width))),
+                                  std::max(1, static_cast<int>(std::floor(max_height))));
+        caption_area = render_area_;
+    }
+
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) {
+        region_renderer.SetOriginalPlaneSize(origin_plane_width, origin_plane_height);
+        region_renderer.SetTargetCaptionAreaRect(caption_area);
+    });
+}
+
+void RendererImpl::MapImageToDisplayArea(Image& image) const {
+    if (!render_area_scaled_) {
+        return;
+    }
+
+    // Edges are mapped separately, so that adjacent images stay adjacent
+    double scale_x = static_cast<double>(display_area_.width()) / static_cast<double>(render_area_.width());
+    double scale_y = static_cast<double>(display_area_.height()) / static_cast<double>(render_area_.height());
+    auto left = static_cast<int>(std::lround(image.dst_x * scale_x));
+    auto top = static_cast<int>(std::lround(image.dst_y * scale_y));
+    auto right = static_cast<int>(std::lround((image.dst_x + image.width) * scale_x));
+    auto bottom = static_cast<int>(std::lround((image.dst_y + image.height) * scale_y));
+
+    image.dst_x = display_area_.left + left;
+    image.dst_y = display_area_.top + top;
+    image.display_width = right - left;
+    image.display_height = bottom - top;
+}
+
+size_t RendererImpl::CountRenderChars(const Caption& caption, RenderQuality quality) const {
+    bool skip_ruby = force_no_ruby_ || quality >= RenderQuality::kNoRuby;
+    size_t count = 0;
+    for (const CaptionRegion& region : caption.regions) {
+        if (region.is_ruby && skip_ruby) {
+            continue;
+        }
+        count += region.compact_chars.empty() ? region.chars.size() : region.compact_chars.size();
+    }
+    return std::max<size_t>(count, 1);
+}
+
+RenderQuality RendererImpl::ChooseRenderQuality(const Caption& caption) const {
+    // The best level predicted to fit into the budget, levels not measured yet are assumed to fit
+    for (size_t level = 0; level + 1 < kRenderQualityLevels; level++) {
+        auto quality = static_cast<RenderQuality>(level);
+        double cost = render_quality_costs_[level] * static_cast<double>(CountRenderChars(caption, quality));
+        if (render_quality_costs_[level] == 0.0 || cost <= static_cast<double>(render_time_budget_)) {
+            return quality;
+        }
+    }
+    return RenderQuality::kReducedScale;
+}
+
+void RendererImpl::ApplyRenderQuality(RenderQuality quality) {
+    render_quality_ = quality;
+    StrokeMode stroke_mode = quality >= RenderQuality::kDilationStroke ? StrokeMode::kDilation : stroke_mode_;
+    ForEachRegionRenderer([&](RegionRenderer& region_renderer) { region_renderer.SetStrokeMode(stroke_mode); });
+}
+
+void RendererImpl::UpdateRenderQualityCost(const Caption& caption, RenderQuality quality, int64_t elapsed_us) {
+    auto level = static_cast<size_t>(quality);
+    double cost = static_cast<double>(elapsed_us) / static_cast<double>(CountRenderChars(caption, quality));
+    double& average = render_quality_costs_[level];
+    average = average == 0.0 ? cost : average * 0.75 + cost * 0.25;
+
+    // Costs of better levels are measured again from time to time, e.g. once glyphs have been cached
+    for (size_t i = 0; i < level; i++) {
+        render_quality_costs_[i] *= 0.9;
+    }
+}
 
-    Rect caption_area(caption_area_start_x,
-                      caption_area_start_y,
-                      caption_area_start_x + caption_area_width,
-                      caption_area_start_y + caption_area_height);
+bool RendererImpl::SetRegionRenderThreads(size_t count) {
+    auto lock = LockRendering();
+    StopRegionWorkers();
+    worker_region_renderers_.clear();
+
+    // The calling thread renders as well
+    for (size_t i = 1; i < count; i++) {
+        auto region_renderer = std::make_unique<RegionRenderer>(context_);
+        if (!region_renderer->Initialize(font_provider_type_, text_renderer_type_)) {
+            log_->e("RendererImpl: Initialize RegionRenderer for worker thread failed");
+            worker_region_renderers_.clear();
+            return false;
+        }
+        region_renderer->CopySettingsFrom(region_renderer_);
+        region_renderer->CopyWarmStateFrom(region_renderer_);
+        worker_region_renderers_.push_back(std::move(region_renderer));
+    }
+
+    region_workers_quit_ = false;
+    for (auto& region_renderer : worker_region_renderers_) {
+        region_workers_.emplace_back(&RendererImpl::RegionWorkerLoop, this, std::ref(*region_renderer));
+    }
+
+    // Images rendered by worker thread's RegionRenderer are not cached in region_renderer_
+    OnRenderingSettingsChanged();
+    return true;
+}
+
+void RendererImpl::StopRegionWorkers() {
+    {
+        std::lock_guard<std::mutex> jobs_lock(region_jobs_mutex_);
+        region_workers_quit_ = true;
+    }
+    region_jobs_cond_.notify_all();
+    for (std::thread& worker : region_workers_) {
+        worker.join();
+    }
+    region_workers_.clear();
+}
+
+void RendererImpl::RenderRegionJobs(std::vector<RegionJob>& jobs) {
+    if (jobs.size() <= 1 || region_workers_.empty()) {
+        for (RegionJob& job : jobs) {
+            job.result = region_renderer_.RenderCaptionRegion(*job.region, *job.drcs_map, job.region_hash);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> jobs_lock(region_jobs_mutex_);
+        region_jobs_ = &jobs;
+        region_jobs_next_ = 0;
+        region_jobs_pending_ = jobs.size();
+    }
+    region_jobs_cond_.notify_all();
+
+    RunRegionJobs(region_renderer_);
+
+    std::unique_lock<std::mutex> jobs_lock(region_jobs_mutex_);
+    region_jobs_done_cond_.wait(jobs_lock, [this] { return region_jobs_pending_ == 0; });
+    region_jobs_ = nullptr;
+}
+
+void RendererImpl::RunRegionJobs(RegionRenderer& region_renderer) {
+    std::unique_lock<std::mutex> jobs_lock(region_jobs_mutex_);
+    while (region_jobs_ && region_jobs_next_ < region_jobs_->size()) {
+        RegionJob& job = (*region_jobs_)[region_jobs_next_++];
+        jobs_lock.unlock();
+
+        job.result = region_renderer.RenderCaptionRegion(*job.region, *job.drcs_map, job.region_hash);
+
+        jobs_lock.lock();
+        if (--region_jobs_pending_ == 0) {
+            region_jobs_done_cond_.notify_one();
+        }
+    }
+}
 
-    region_renderer_.SetOriginalPlaneSize(origin_plane_width, origin_plane_height);
-    region_renderer_.SetTargetCaptionAreaRect(caption_area);
+void RendererImpl::RegionWorkerLoop(RegionRenderer& region_renderer) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> jobs_lock(region_jobs_mutex_);
+            region_jobs_cond_.wait(jobs_lock, [this] {
+                return region_workers_quit_ || (region_jobs_ && region_jobs_next_ < region_jobs_->size());
+            });
+            if (region_workers_quit_) {
+                return;
+            }
+        }
+        RunRegionJobs(region_renderer);
+    }
 }
 
 void RendererImpl::Flush() {
+    auto async_lock = LockAsyncState();
     captions_.clear();
+    caption_storage_bytes_ = 0;
+    spilled_pts_ = std::numeric_limits<int64_t>::min();
+    cold_captions_.clear();
+    hot_captions_.clear();
+    cold_sweep_pts_ = PTS_NOPTS;
+    cold_sweep_pending_ = false;
+    caption_index_.clear();
+    caption_index_dirty_ = false;
+    caption_cursor_ = 0;
+    superimposes_.clear();
+    InvalidatePrevRenderedImages();
+    InvalidateSuperimposeImages();
+    DropPrerenderedImages();
+    async_queue_.clear();
+    async_generation_++;
+}
+
+void RendererImpl::DropPrerenderedImages() {
+    for (auto& [pts, prerendered] : prerendered_) {
+        RecycleImages(std::move(prerendered.images));
+    }
+    prerendered_.clear();
+}
+
+void RendererImpl::OnRenderingSettingsChanged() {
+    auto async_lock = LockAsyncState();
     InvalidatePrevRenderedImages();
+    InvalidateSuperimposeImages();
+
+    if (async_enabled_) {
+        // Results of the worker thread are outdated, render all captions again
+        async_generation_++;
+        DropPrerenderedImages();
+        async_queue_.clear();
+        for (const auto& [pts, caption] : captions_) {
+            async_queue_.push_back(pts);
+        }
+        async_cond_.notify_one();
+    }
+}
+
+void RendererImpl::OnVideoAreaResized(int video_width, int video_height) {
+    auto async_lock = LockAsyncState();
+    InvalidateSuperimposeImages();
+
+    // Layout of a caption only depends on the size of the video area. Images rendered for the old one are still
+    // valid if the caption area keeps its size and just moves, e.g. letterboxing after resizing the window.
+    bool moved = false;
+    auto move_images = [&](int64_t pts, std::vector<Image>& images) -> bool {
+        auto iter = captions_.find(pts);
+        if (iter == captions_.end()) {
+            return false;
+        }
+        const Caption& caption = iter->second;
+        Rect from = CalcCaptionArea(video_area_width_, video_area_height_, caption.plane_width, caption.plane_height);
+        Rect to = CalcCaptionArea(video_width, video_height, caption.plane_width, caption.plane_height);
+        if (from.width() != to.width() || from.height() != to.height()) {
+            return false;
+        }
+        for (Image& image : images) {
+            image.dst_x += to.left - from.left;
+            image.dst_y += to.top - from.top;
+        }
+        moved = to.left != from.left || to.top != from.top;
+        return true;
+    };
+
+    if (has_prev_rendered_caption_) {
+        int64_t pts = prev_rendered_caption_pts_;
+        if (move_images(pts, prev_rendered_images_)) {
+            prev_rendered_images_moved_ |= moved;
+        } else {
+            InvalidatePrevRenderedImages();
+            if (async_enabled_) {
+                async_queue_.push_back(pts);
+            }
+        }
+    }
+
+    // Quads are cheap to build again from the glyph atlas
+    has_prev_atlas_caption_ = false;
+    prev_atlas_caption_pts_ = PTS_NOPTS;
+    prev_atlas_quads_.clear();
+
+    for (auto iter = prerendered_.begin(); iter != prerendered_.end(); ) {
+        if (move_images(iter->first, iter->second.images)) {
+            ++iter;
+            continue;
+        }
+        if (async_enabled_) {
+            async_queue_.push_back(iter->first);
+        }
+        RecycleImages(std::move(iter->second.images));
+        iter = prerendered_.erase(iter);
+    }
+
+    if (async_enabled_) {
+        if (async_rendering_) {
+            // Being rendered for the old video area
+            async_rendering_outdated_ = true;
+            async_queue_.push_back(async_rendering_pts_);
+        }
+        async_cond_.notify_one();
+    }
+}
+
+void RendererImpl::SetAsyncRendering(bool enable, std::function<void(int64_t pts)> on_ready) {
+    StopAsyncThread();
+
+    async_callback_ = std::move(on_ready);
+    if (!enable) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> async_lock(async_mutex_);
+        async_quit_ = false;
+        async_generation_++;
+        DropPrerenderedImages();
+        async_queue_.clear();
+        for (const auto& [pts, caption] : captions_) {
+            async_queue_.push_back(pts);
+        }
+    }
+
+    async_enabled_ = true;
+    async_thread_ = std::thread(&RendererImpl::AsyncRenderLoop, this);
+}
+
+void RendererImpl::StopAsyncThread() {
+    if (!async_thread_.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> async_lock(async_mutex_);
+        async_quit_ = true;
+    }
+    async_cond_.notify_one();
+    async_thread_.join();
+    async_enabled_ = false;
+}
+
+void RendererImpl::QueueAsyncRendering(int64_t pts) {
+    // Caption may have been replaced, drop the outdated result
+    auto iter = prerendered_.find(pts);
+    if (iter != prerendered_.end()) {
+        RecycleImages(std::move(iter->second.images));
+        prerendered_.erase(iter);
+    }
+
+    if (async_rendering_ && async_rendering_pts_ == pts) {
+        async_rendering_outdated_ = true;
+    }
+
+    async_queue_.push_back(pts);
+    async_cond_.notify_one();
+}
+
+void RendererImpl::AsyncRenderLoop() {
+    while (true) {
+        Caption caption;
+        uint64_t generation = 0;
+        {
+            std::unique_lock<std::mutex> async_lock(async_mutex_);
+            async_cond_.wait(async_lock, [this] { return async_quit_ || !async_queue_.empty(); });
+            if (async_quit_) {
+                return;
+            }
+
+            int64_t pts = async_queue_.front();
+            async_queue_.pop_front();
+
+            auto iter = captions_.find(pts);
+            if (iter == captions_.end() || prerendered_.find(pts) != prerendered_.end() ||
+                    (has_prev_rendered_caption_ && prev_rendered_caption_pts_ == pts)) {
+                continue;  // Removed, or rendered already
+            }
+            const Caption* stored = GetCaptionForRendering(iter, caption);
+            if (!stored) {
+                continue;
+            }
+            if (stored != &caption) {
+                caption = *stored;
+            }
+            generation = async_generation_;
+            async_rendering_ = true;
+            async_rendering_pts_ = pts;
+            async_rendering_outdated_ = false;
+        }
+
+        PrerenderedImages prerendered;
+        prerendered.generation = generation;
+        bool ok = false;
+        {
+            std::lock_guard<std::recursive_mutex> lock(render_mutex_);
+            uint64_t render_start_us = Metrics::NowMicroseconds();
+            ok = RenderCaptionImages(caption, prerendered.images, prerendered.hashes, nullptr);
+            if (ok) {
+                RecordFirstRender(render_start_us);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> async_lock(async_mutex_);
+            async_rendering_ = false;
+            if (!ok || generation != async_generation_ || async_rendering_outdated_ ||
+                    captions_.find(caption.pts) == captions_.end()) {
+                RecycleImages(std::move(prerendered.images));
+                continue;
+            }
+            prerendered_.insert_or_assign(caption.pts, std::move(prerendered));
+        }
+
+        if (async_callback_) {
+            async_callback_(caption.pts);
+        }
+    }
+}
+
+// Hiragana, katakana and CJK punctuations, followed by frequent kanji in captions
+static const char32_t kPreloadCharacters[] =
+    U"ぁあぃいぅうぇえぉおかがきぎくぐけげこごさざしじすずせぜそぞただちぢっつづてでとどなにぬねのはばぱひびぴふぶぷへべぺほぼぽ"
+    U"まみむめもゃやゅゆょよらりるれろゎわゐゑをんゔ"
+    U"ァアィイゥウェエォオカガキギクグケゲコゴサザシジスズセゼソゾタダチヂッツヅテデトドナニヌネノハバパヒビピフブプヘベペホボポ"
+    U"マミムメモャヤュユョヨラリルレロヮワヰヱヲンヴヵヶ"
+    U"、。，．・：？！ー～「」『』（）［］【】♪０１２３４５６７８９"
+    U"日一人年大十二本中出三見月生五上四私今何時行分来前後子自言事思気手下国長学話会方的目場合間"
+    U"彼女男家社当同心体定作入山語東京内部電明新金食外所道高実小田物地者発動開全知主聞用先"
+    U"声元持好意味助届待帰買読書休";
+
+bool RendererImpl::Preload(uint32_t iso6392_language_code, bool prerasterize, bool in_background) {
+    if (!frame_size_inited_ || !margins_inited_) {
+        assert(frame_size_inited_ && margins_inited_ && "Frame size / margins must be indicated first");
+        return false;
+    }
+
+    WaitForPreload();
+
+    if (!in_background) {
+        auto lock = LockRendering();
+        return PreloadFonts(iso6392_language_code, prerasterize);
+    }
+
+    // Settings are guarded by render_mutex_ as long as preload_thread_ is joinable
+    preload_thread_ = std::thread([this, iso6392_language_code, prerasterize] {
+        std::lock_guard<std::recursive_mutex> thread_lock(render_mutex_);
+        PreloadFonts(iso6392_language_code, prerasterize);
+    });
+    return true;
+}
+
+void RendererImpl::WaitForPreload() {
+    if (preload_thread_.joinable()) {
+        preload_thread_.join();
+    }
+}
+
+bool RendererImpl::PreloadFonts(uint32_t iso6392_language_code, bool prerasterize) {
+    // Render captions of standard size characters, so that fonts are resolved and loaded,
+    // and glyphs are cached in the size of actual captions
+    auto make_caption = [](uint32_t language_code, std::u32string_view chars, CharStyle style) {
+        constexpr int kCharSize = 36;
+        constexpr int kHorizontalSpacing = 4;
+        constexpr int kVerticalSpacing = 24;
+
+        CaptionRegion region;
+        region.x = 0;
+        region.y = 0;
+        region.width = static_cast<int>(chars.size()) * (kCharSize + kHorizontalSpacing);
+        region.height = kCharSize + kVerticalSpacing;
+        for (size_t i = 0; i < chars.size(); i++) {
+            CaptionChar ch;
+            ch.codepoint = chars[i];
+            ch.x = static_cast<int>(i) * (kCharSize + kHorizontalSpacing);
+            ch.y = 0;
+            ch.char_width = kCharSize;
+            ch.char_height = kCharSize;
+            ch.char_horizontal_spacing = kHorizontalSpacing;
+            ch.char_vertical_spacing = kVerticalSpacing;
+            ch.char_horizontal_scale = 1.0f;
+            ch.char_vertical_scale = 1.0f;
+            ch.text_color = ColorRGBA(255, 255, 255, 255);
+            ch.stroke_color = ColorRGBA(0, 0, 0, 255);
+            ch.style = style;
+            region.chars.push_back(ch);
+        }
+
+        Caption caption;
+        caption.iso6392_language_code = language_code;
+        caption.plane_width = 960;
+        caption.plane_height = 540;
+        caption.regions.push_back(std::move(region));
+        return caption;
+    };
+
+    auto render = [this](const Caption& caption) {
+        std::vector<Image> images;
+        std::vector<uint64_t> image_hashes;
+        bool ok = RenderCaptionImages(caption, images, image_hashes, nullptr);
+        RecycleImages(std::move(images));
+        return ok;
+    };
+
+    // Resolve font families of other languages first, font providers keep the matching results
+    for (const auto& [language_code, font_family] : language_font_family_) {
+        if (language_code != iso6392_language_code) {
+            render(make_caption(language_code, U"A", CharStyle::kCharStyleDefault));
+        }
+    }
+
+    // Then the expected language, whose fonts stay loaded
+    if (!prerasterize) {
+        return render(make_caption(iso6392_language_code, U"あ", CharStyle::kCharStyleDefault));
+    }
+
+    std::u32string_view chars(kPreloadCharacters);
+    constexpr size_t kCharsPerRow = 24;  // Fits in the 960 wide plane
+    bool ok = true;
+    for (CharStyle style : {CharStyle::kCharStyleDefault, CharStyle::kCharStyleStroke}) {
+        for (size_t i = 0; i < chars.size(); i += kCharsPerRow) {
+            // Keep going if some characters are missing in the fonts
+            ok &= render(make_caption(iso6392_language_code, chars.substr(i, kCharsPerRow), style));
+        }
+    }
+    return ok;
+}
+
+RenderStatus RendererImpl::RenderAsync(int64_t pts, RenderResult& out_result) {
+    std::lock_guard<std::mutex> async_lock(async_mutex_);
+
+    Caption* found = FindCaptionAt(pts);
+    if (!found) {
+        // Timeout, or empty caption
+        InvalidatePrevRenderedImages();
+        return RenderStatus::kNoImage;
+    }
+    Caption& caption = *found;
+
+    if (has_prev_rendered_caption_ && prev_rendered_caption_pts_ == caption.pts) {
+        // Reuse previous rendered caption
+        if (!prev_rendered_images_.empty()) {
+            // Images moved by a resize of the video area are reported as changed
+            bool moved = prev_rendered_images_moved_;
+            prev_rendered_images_moved_ = false;
+            out_result.pts = prev_rendered_caption_pts_;
+            out_result.duration = prev_rendered_caption_duration_;
+            prev_rendered_images_changed_.assign(prev_rendered_images_.size(), moved ? 1 : 0);
+            out_result.image_changed = prev_rendered_images_changed_;
+            return moved ? RenderStatus::kGotImage : RenderStatus::kGotImageUnchanged;
+        } else {
+            InvalidatePrevRenderedImages();
+            return RenderStatus::kNoImage;
+        }
+    }
+
+    auto prerendered_iter = prerendered_.find(caption.pts);
+    if (prerendered_iter == prerendered_.end() || prerendered_iter->second.generation != async_generation_) {
+        return RenderStatus::kNotReady;
+    }
+    PrerenderedImages& prerendered = prerendered_iter->second;
+
+    std::vector<Image> images;
+    std::vector<uint64_t> image_hashes;
+    std::vector<uint8_t> images_changed;
+    for (size_t i = 0; i < prerendered.images.size(); i++) {
+        uint64_t hash = prerendered.hashes[i];
+        // Prefer the identical image from the previous rendering, which keeps shared buffers stable
+        if (TakeImage(prev_rendered_images_, prev_rendered_image_hashes_, hash, images, image_hashes)) {
+            bitmap_pool_->Recycle(std::move(prerendered.images[i]));
+            images_changed.push_back(0);
+        } else {
+            images.push_back(std::move(prerendered.images[i]));
+            image_hashes.push_back(hash);
+            images_changed.push_back(1);
+        }
+    }
+
+    for (auto iter = prerendered_.begin(); iter != prerendered_.end() && iter->first <= caption.pts; ) {
+        RecycleImages(std::move(iter->second.images));
+        iter = prerendered_.erase(iter);
+    }
+
+    if (share_image_buffers_) {
+        for (Image& image : images) {
+            Bitmap::ShareImageBuffer(image, bitmap_pool_.get());
+        }
+    }
+
+    RecycleImages(std::move(prev_rendered_images_));
+
+    has_prev_rendered_caption_ = true;
+    prev_rendered_caption_pts_ = caption.pts;
+    prev_rendered_caption_duration_ = caption.wait_duration;
+    prev_rendered_images_ = std::move(images);
+    prev_rendered_images_moved_ = false;
+    prev_rendered_image_hashes_ = std::move(image_hashes);
+    prev_rendered_images_changed_ = std::move(images_changed);
+
+    out_result.pts = caption.pts;
+    out_result.duration = caption.wait_duration;
+    out_result.image_changed = prev_rendered_images_changed_;
+    return RenderStatus::kGotImage;
 }
 
 void RendererImpl::InvalidatePrevRenderedImages() {
     has_prev_rendered_caption_ = false;
     prev_rendered_caption_pts_ = PTS_NOPTS;
     prev_rendered_caption_duration_ = 0;
-    prev_rendered_images_.clear();
+    RecycleImages(std::move(prev_rendered_images_));
+    prev_rendered_images_moved_ = false;
+    prev_rendered_image_hashes_.clear();
+    prev_rendered_images_changed_.clear();
+
+    has_prev_atlas_caption_ = false;
+    prev_atlas_caption_pts_ = PTS_NOPTS;
+    prev_atlas_quads_.clear();
+}
+
+void RendererImpl::InvalidateSuperimposeImages() {
+    has_prev_superimpose_ = false;
+    prev_superimpose_pts_ = PTS_NOPTS;
+    RecycleImages(std::move(prev_superimpose_images_));
+}
+
+void RendererImpl::RecordFirstRender(uint64_t start_us) {
+    if (!first_render_us_) {
+        first_render_us_ = Metrics::NowMicroseconds() - start_us;
+    }
 }
 
 }  // namespace aribcaption::internal
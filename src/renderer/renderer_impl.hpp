@@ -19,13 +19,29 @@
 #ifndef ARIBCAPTION_RENDERER_IMPL_HPP
 #define ARIBCAPTION_RENDERER_IMPL_HPP
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <vector>
+#include <limits>
 #include <map>
+#include <unordered_map>
 #include "aribcaption/caption.hpp"
+#include "aribcaption/image.h"
 #include "aribcaption/renderer.hpp"
 #include "base/logger.hpp"
+#include "base/memory_trim_registry.hpp"
+#include "base/metrics.hpp"
+#include "base/tracer.hpp"
+#include "renderer/bitmap_pool.hpp"
+#include "renderer/glyph_atlas.hpp"
 #include "renderer/region_renderer.hpp"
 
 namespace aribcaption::internal {
@@ -38,40 +54,219 @@ public:
     bool Initialize(CaptionType caption_type = CaptionType::kCaption,
                     FontProviderType font_provider_type = FontProviderType::kAuto,
                     TextRendererType text_renderer_type = TextRendererType::kAuto);
+    bool InitializeFrom(RendererImpl& other);
 
     void SetStrokeWidth(float dots);
     void SetReplaceDRCS(bool replace);
     void SetForceStrokeText(bool force_stroke);
+    void SetStrokeMode(StrokeMode mode);
+    void SetQualityPreset(QualityPreset preset);
+    void SetDistanceFieldGlyphs(bool enable);
     void SetForceNoRuby(bool force_no_ruby);
     void SetForceNoBackground(bool force_no_background);
+    void SetTrimRegionImages(bool trim);
     void SetMergeRegionImages(bool merge);
+    void SetOutputPixelFormat(PixelFormat format);
+    void SetRunLengthEncodedImages(bool enable);
+    void SetShareImageBuffers(bool share);
+    void SetSuperimposeLayer(bool enable);
+    bool SetImageAlignment(size_t row_alignment, size_t base_alignment);
 
     bool SetDefaultFontFamily(const std::vector<std::string>& font_family, bool force_default);
     bool SetLanguageSpecificFontFamily(uint32_t language_code, const std::vector<std::string>& font_family);
     bool SetFrameSize(int frame_width, int frame_height);
     bool SetMargins(int top, int bottom, int left, int right);
+    void SetMaxRenderMagnification(float magnification);
+    void SetRenderTimeBudget(int64_t budget_us);
 
     void SetStoragePolicy(CaptionStoragePolicy policy, std::optional<size_t> upper_limit = std::nullopt);
+    void SetCompactCaptionStorage(bool compact);
+    void SetColdCaptionStorage(bool enable, int64_t hot_window);
+    size_t GetCaptionStorageBytes();
+
+    void SetGlyphCacheLimit(size_t limit_bytes);
+    bool SetGlyphCacheFile(const std::string& filename);
+    void SetRegionImageCacheSize(size_t count);
+    [[nodiscard]]
+    GlyphCacheStats GetGlyphCacheStats() const;
+
+    void SetBitmapPoolLimit(size_t limit_bytes);
+    [[nodiscard]]
+    BitmapPoolStats GetBitmapPoolStats() const;
+    void RecycleImages(std::vector<Image>&& images);
+
+    void TrimMemory(MemoryTrimLevel level);
+    [[nodiscard]]
+    RendererMemoryUsage GetMemoryUsage() const;
+    [[nodiscard]]
+    RendererStartupTimings GetStartupTimings() const;
+
+    [[nodiscard]]
+    BitmapPool& bitmap_pool() { return *bitmap_pool_; }
 
     bool AppendCaption(const Caption& caption);
     bool AppendCaption(Caption&& caption);
+    bool AppendCaptions(std::vector<Caption>&& captions);
+    bool ExtendCaption(int64_t pts, int64_t duration);
 
     RenderStatus TryRender(int64_t pts);
+    int64_t GetNextChangePTS(int64_t pts);
     RenderStatus Render(int64_t pts, RenderResult& out_result);
+    RenderStatus RenderForFrameSizes(int64_t pts,
+                                     const std::vector<RenderTargetSize>& sizes,
+                                     std::vector<RenderResult>& out_results);
+    RenderStatus RenderInto(int64_t pts, const FrameBuffer& frame);
+    RenderStatus RenderLayers(int64_t pts, RenderResult& out_caption, RenderResult& out_superimpose);
+    bool SetGlyphAtlasSize(int width, int height);
+    RenderStatus RenderGlyphAtlas(int64_t pts, GlyphAtlasRenderResult& out_result);
+    RenderStatus RenderLayout(int64_t pts, LayoutResult& out_result);
     void Flush();
+
+    // Same as Render(), but leaves out_result.images empty.
+    // Rendered images are kept inside and could be accessed through rendered_images() and superimpose_images()
+    // until next call, image_changed covers both in that order.
+    RenderStatus RenderWithoutImages(int64_t pts, RenderResult& out_result);
+    // Same as RenderLayers(), images are kept inside like in RenderWithoutImages()
+    RenderStatus RenderLayersWithoutImages(int64_t pts, RenderResult& out_caption, RenderResult& out_superimpose);
+
+    size_t Prerender(int64_t pts_begin, int64_t pts_end);
+    size_t RenderBatch(int64_t pts_begin, int64_t pts_end, std::vector<RenderResult>& out_results);
+
+    void SetAsyncRendering(bool enable, std::function<void(int64_t pts)> on_ready);
+
+    bool Preload(uint32_t iso6392_language_code, bool prerasterize, bool in_background);
+
+    bool SetRegionRenderThreads(size_t count);
+
+    [[nodiscard]]
+    const std::vector<Image>& rendered_images() const {
+        return prev_rendered_images_;
+    }
+
+    // Images of the superimpose layer, empty unless SetSuperimposeLayer() is enabled
+    [[nodiscard]]
+    const std::vector<Image>& superimpose_images() const {
+        return prev_superimpose_images_;
+    }
+
+    // Changed flags of rendered_images() followed by superimpose_images(), see RenderResult::image_changed
+    std::vector<uint8_t>& rendered_images_changed() {
+        return superimpose_layer_ ? layered_images_changed_ : prev_rendered_images_changed_;
+    }
+
+    // Storage for images / glyph atlas result borrowed through the C API
+    std::vector<aribcc_image_t>& capi_borrowed_images() {
+        return capi_borrowed_images_;
+    }
+
+    GlyphAtlasRenderResult& capi_glyph_atlas_result() {
+        return capi_glyph_atlas_result_;
+    }
 private:
     void LoadDefaultFontFamilies();
+    auto FindCaptionAt(int64_t pts) -> Caption*;
+    auto FindSuperimposeAt(int64_t pts) const -> const Caption*;
+    bool AppendSuperimpose(Caption&& caption);
+    void PrepareRegionRenderer(const Caption& caption, bool limit_magnification = true);
+    void IndexInsertedCaption(std::map<int64_t, Caption>::iterator inserted);
+    void RebuildCaptionIndex();
+    static int64_t CaptionEndPTS(const Caption& caption);
+    static void CompactCaptionRegions(Caption& caption);
+    static size_t EstimateCaptionBytes(const Caption& caption);
+    void OnCaptionInserted(std::map<int64_t, Caption>::iterator inserted);
+    void EraseCaptionsBefore(std::map<int64_t, Caption>::iterator erase_end);
+    void SpillCaptionsIntoCompactForm();
+    size_t StoredCaptionBytes(std::map<int64_t, Caption>::const_iterator iter) const;
+    void FreezeCaption(std::map<int64_t, Caption>::iterator iter);
+    void ThawCaption(std::map<int64_t, Caption>::iterator iter);
+    void FreezeColdCaptions(int64_t pts);
+    auto GetCaptionForRendering(std::map<int64_t, Caption>::iterator iter, Caption& cold_storage) -> const Caption*;
+    static auto GetRenderRegions(const Caption& caption, std::vector<CaptionRegion>& region_storage)
+        -> const std::vector<CaptionRegion>&;
     void CleanupCaptionsIfNecessary();
-    void AdjustCaptionArea(int origin_plane_width, int origin_plane_height);
+    void EraseOutdatedCaptions();
+    static Rect CalcCaptionArea(int video_area_width, int video_area_height,
+                                int origin_plane_width, int origin_plane_height);
+    void AdjustCaptionArea(int origin_plane_width, int origin_plane_height, bool limit_magnification);
+    void MapImageToDisplayArea(Image& image) const;
+    [[nodiscard]]
+    size_t CountRenderChars(const Caption& caption, RenderQuality quality) const;
+    [[nodiscard]]
+    RenderQuality ChooseRenderQuality(const Caption& caption) const;
+    void ApplyRenderQuality(RenderQuality quality);
+    void UpdateRenderQualityCost(const Caption& caption, RenderQuality quality, int64_t elapsed_us);
+    void OnVideoAreaResized(int video_width, int video_height);
     void InvalidatePrevRenderedImages();
+    void InvalidateSuperimposeImages();
+    void RecordFirstRender(uint64_t start_us);
+    void CopyRenderedImages(const std::vector<Image>& images, std::vector<Image>& out_images);
+    void OnRenderingSettingsChanged();
+    void DropPrerenderedImages();
+private:
+    // Locks only if asynchronous rendering or background preloading is enabled, otherwise returns an empty lock
+    [[nodiscard]]
+    std::unique_lock<std::recursive_mutex> LockRendering() const {
+        return (async_enabled_ || preload_thread_.joinable()) ? std::unique_lock<std::recursive_mutex>(render_mutex_)
+                                                              : std::unique_lock<std::recursive_mutex>();
+    }
+    [[nodiscard]]
+    std::unique_lock<std::mutex> LockAsyncState() const {
+        return async_enabled_ ? std::unique_lock<std::mutex>(async_mutex_) : std::unique_lock<std::mutex>();
+    }
+    void StopAsyncThread();
+    void QueueAsyncRendering(int64_t pts);
+    void AsyncRenderLoop();
+    RenderStatus RenderAsync(int64_t pts, RenderResult& out_result);
+    // Layers of SetSuperimposeLayer(), the caption layer is what Render() does without the superimpose layer
+    RenderStatus TryRenderCaptionLayer(int64_t pts);
+    RenderStatus RenderCaptionLayer(int64_t pts, RenderResult& out_result);
+    RenderStatus RenderSuperimposeLayer(int64_t pts, RenderResult& out_result, bool& out_vanished);
+    static RenderStatus CombineLayerStatus(RenderStatus caption_status, bool caption_vanished,
+                                           RenderStatus superimpose_status, bool superimpose_vanished);
+    bool PreloadFonts(uint32_t iso6392_language_code, bool prerasterize);
+    void TrimMemoryLocked(MemoryTrimLevel level);
+    // Apply the trimming requested by Context::TrimMemory(), must not be called with async_mutex_ held
+    void ApplyPendingMemoryTrim();
+    void WaitForPreload();
+
+    template <class Func>
+    void ForEachRegionRenderer(Func&& func) {
+        func(region_renderer_);
+        for (auto& region_renderer : worker_region_renderers_) {
+            func(*region_renderer);
+        }
+    }
+    struct RegionJob {
+        const CaptionRegion* region = nullptr;
+        const DRCSMap* drcs_map = nullptr;
+        uint64_t region_hash = 0;
+        std::optional<Result<Image, RegionRenderError>> result;
+    };
+    // Convert into the output pixel format, then run-length encode if enabled
+    void ConvertOutputPixelFormat(Image& image);
+    void RenderRegionJobs(std::vector<RegionJob>& jobs);
+    void RunRegionJobs(RegionRenderer& region_renderer);
+    void RegionWorkerLoop(RegionRenderer& region_renderer);
+    void StopRegionWorkers();
 private:
-    static Image MergeImages(std::vector<Image>& images);
+    // Render images of the caption into images / image_hashes.
+    // If images_changed is provided, the rendering is for presentation and identical images will be taken over
+    // from the previous rendering or the prerendered ones, with changed flags written back.
+    bool RenderCaptionImages(const Caption& caption,
+                             std::vector<Image>& images,
+                             std::vector<uint64_t>& image_hashes,
+                             std::vector<uint8_t>* images_changed);
+    static bool TakeImage(std::vector<Image>& from_images, std::vector<uint64_t>& from_hashes, uint64_t hash,
+                          std::vector<Image>& images, std::vector<uint64_t>& hashes);
+    Image MergeImages(std::vector<Image>& images);
 public:
     RendererImpl(const RendererImpl&) = delete;
     RendererImpl& operator=(const RendererImpl&) = delete;
 private:
     Context& context_;
     std::shared_ptr<Logger> log_;
+    std::shared_ptr<Metrics> metrics_;
+    std::shared_ptr<Tracer> tracer_;
 
     CaptionType expected_caption_type_ = CaptionType::kDefault;
 
@@ -98,22 +293,140 @@ private:
     int margin_left_ = 0;
     int margin_right_ = 0;
 
+    // Regions are rendered into render_area_ (at origin) and scaled into display_area_,
+    // if the caption area is magnified beyond max_render_magnification_
+    float max_render_magnification_ = 0.0f;
+    bool render_area_scaled_ = false;
+    Rect render_area_;
+    Rect display_area_;
+
+    // Rendering time budget, see SetRenderTimeBudget()
+    static constexpr size_t kRenderQualityLevels = 4;
+    int64_t render_time_budget_ = 0;                       // in microseconds, 0 if unlimited
+    RenderQuality render_quality_ = RenderQuality::kFull;  // Level applied in RenderCaptionImages()
+    std::array<double, kRenderQualityLevels> render_quality_costs_{};  // Microseconds per char, 0 if unknown
+    StrokeMode stroke_mode_ = StrokeMode::kOutline;        // Indicated by SetStrokeMode()
+
+    // Startup timings in microseconds, see GetStartupTimings()
+    uint64_t initialize_us_ = 0;
+    uint64_t first_render_us_ = 0;
+
     CaptionStoragePolicy storage_policy_ = CaptionStoragePolicy::kMinimum;
     size_t upper_limit_count_ = 0;
     size_t upper_limit_duration_ = 0;
+    size_t upper_limit_bytes_ = 0;
+    bool compact_caption_storage_ = false;
+
+    // Estimated memory usage of captions_, see EstimateCaptionBytes()
+    size_t caption_storage_bytes_ = 0;
+    // Captions before this PTS have been spilled into compact form for kUpperLimitBytes
+    int64_t spilled_pts_ = std::numeric_limits<int64_t>::min();
+
+    // Cold caption storage, see SetColdCaptionStorage()
+    bool cold_caption_storage_ = false;
+    int64_t cold_hot_window_ = 0;
+    // PTS => Compressed caption, captions_ holds a stub with the timing kept
+    std::map<int64_t, std::vector<uint8_t>> cold_captions_;
+    std::vector<int64_t> hot_captions_;  // PTS of expanded captions, frozen once out of the hot window
+    int64_t cold_sweep_pts_ = PTS_NOPTS;  // PTS of the last FreezeColdCaptions()
+    bool cold_sweep_pending_ = false;
 
     bool merge_region_images_ = false;
+    bool share_image_buffers_ = false;
+    PixelFormat output_pixel_format_ = PixelFormat::kRGBA8888;
+    bool run_length_encoded_images_ = false;
 
     // PTS => Caption
     // Sorted by PTS incrementally
     std::map<int64_t, Caption> captions_;
 
+    // Flat copy of captions_ timing for lookups in Render(), rebuilt lazily once marked dirty
+    struct CaptionIndexEntry {
+        int64_t pts;
+        int64_t end_pts;  // INT64_MAX for indefinite duration
+        Caption* caption;
+    };
+    std::vector<CaptionIndexEntry> caption_index_;
+    bool caption_index_dirty_ = false;
+    size_t caption_cursor_ = 0;  // Index entry found by the last lookup
+
+    // Shared with the TextRenderers, written back once all of them have released it
+    std::shared_ptr<PersistentGlyphCache> persistent_glyph_cache_;
+
+    // Must outlive region_renderer_, which refers to it
+    std::shared_ptr<BitmapPool> bitmap_pool_;
+
+    // Context::TrimMemory() may be called from any thread, only the level is recorded for the next rendering
+    static constexpr int kNoPendingMemoryTrim = -1;
+    std::shared_ptr<MemoryTrimRegistry> memory_trim_registry_;
+    uint64_t memory_trim_listener_id_ = 0;
+    std::atomic<int> pending_memory_trim_{kNoPendingMemoryTrim};
     RegionRenderer region_renderer_;
 
     bool has_prev_rendered_caption_ = false;
     int64_t prev_rendered_caption_pts_ = PTS_NOPTS;
     int64_t prev_rendered_caption_duration_ = 0;
     std::vector<Image> prev_rendered_images_;
+    std::vector<uint64_t> prev_rendered_image_hashes_;  // Region hash of each image in prev_rendered_images_
+    std::vector<uint8_t> prev_rendered_images_changed_;
+    bool prev_rendered_images_moved_ = false;  // Moved by a resize of the video area since last presented
+    RenderQuality prev_rendered_quality_ = RenderQuality::kFull;
+
+    // Superimpose kept apart from captions_, see SetSuperimposeLayer(). Sparse, thus neither indexed nor compacted
+    bool superimpose_layer_ = false;
+    std::map<int64_t, Caption> superimposes_;
+    bool has_prev_superimpose_ = false;
+    int64_t prev_superimpose_pts_ = PTS_NOPTS;
+    std::vector<Image> prev_superimpose_images_;
+    std::vector<uint8_t> layered_images_changed_;  // Changed flags of both layers, see rendered_images_changed()
+
+    // Images rendered ahead of presentation by Prerender(), keyed by caption PTS
+    struct PrerenderedImages {
+        std::vector<Image> images;
+        std::vector<uint64_t> hashes;  // Region hash of each image
+        uint64_t generation = 0;       // async_generation_ at rendering, asynchronous rendering only
+    };
+    std::map<int64_t, PrerenderedImages> prerendered_;
+
+    // Asynchronous rendering, see SetAsyncRendering().
+    // Lock order: render_mutex_ before async_mutex_.
+    bool async_enabled_ = false;
+    mutable std::recursive_mutex render_mutex_;  // Guards region_renderer_ and rendering settings
+    mutable std::mutex async_mutex_;  // Guards captions_, prerendered_ and the queue
+    std::condition_variable async_cond_;
+    std::thread async_thread_;
+    bool async_quit_ = false;
+    uint64_t async_generation_ = 0;  // Bumped when in-flight results become outdated
+    int64_t async_rendering_pts_ = 0;
+    bool async_rendering_ = false;   // Worker is rendering the caption at async_rendering_pts_
+    bool async_rendering_outdated_ = false;
+    std::deque<int64_t> async_queue_;
+    std::function<void(int64_t pts)> async_callback_;
+
+    // Background thread of Preload(), holds render_mutex_ while running
+    std::thread preload_thread_;
+
+    // Parallel region rendering, see SetRegionRenderThreads().
+    // Each worker thread owns a RegionRenderer configured identically to region_renderer_.
+    FontProviderType font_provider_type_ = FontProviderType::kAuto;
+    TextRendererType text_renderer_type_ = TextRendererType::kAuto;
+    std::vector<std::unique_ptr<RegionRenderer>> worker_region_renderers_;
+    std::vector<std::thread> region_workers_;
+    std::mutex region_jobs_mutex_;
+    std::condition_variable region_jobs_cond_;
+    std::condition_variable region_jobs_done_cond_;
+    std::vector<RegionJob>* region_jobs_ = nullptr;  // Jobs of the current rendering, nullptr if idle
+    size_t region_jobs_next_ = 0;
+    size_t region_jobs_pending_ = 0;
+    bool region_workers_quit_ = false;
+
+    std::vector<aribcc_image_t> capi_borrowed_images_;
+    GlyphAtlasRenderResult capi_glyph_atlas_result_;
+
+    GlyphAtlas glyph_atlas_;
+    bool has_prev_atlas_caption_ = false;
+    int64_t prev_atlas_caption_pts_ = PTS_NOPTS;
+    std::vector<GlyphQuad> prev_atlas_quads_;
 };
 
 }  // namespace aribcaption::internal
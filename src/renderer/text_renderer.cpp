@@ -65,6 +65,20 @@ std::unique_ptr<TextRenderer> TextRenderer::Create(TextRendererType type, Contex
     }
 }
 
+void TextRenderer::DrawRun(TextRenderContext& render_ctx, const std::vector<TextRunChar>& chars,
+                           CharStyle style, ColorRGBA color, ColorRGBA stroke_color,
+                           float stroke_width, int char_width, int char_height,
+                           TextRenderFallbackPolicy fallback_policy,
+                           std::vector<TextRenderStatus>& out_statuses) {
+    out_statuses.clear();
+    out_statuses.reserve(chars.size());
+    for (const TextRunChar& ch : chars) {
+        out_statuses.push_back(DrawChar(render_ctx, ch.x, ch.y, ch.ucs4, style, color, stroke_color,
+                                        stroke_width, char_width, char_height,
+                                        ch.underline_info, fallback_policy));
+    }
+}
+
 auto TextRenderer::FontProviderErrorToStatus(FontProviderError error) -> TextRenderStatus {
     switch (error) {
         case FontProviderError::kFontNotFound:
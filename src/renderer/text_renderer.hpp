@@ -21,12 +21,16 @@
 
 #include <memory>
 #include <optional>
+#include <vector>
 #include "aribcaption/caption.hpp"
 #include "aribcaption/context.hpp"
 #include "aribcaption/renderer.hpp"
 #include "base/result.hpp"
 #include "renderer/bitmap.hpp"
 #include "renderer/font_provider.hpp"
+#include "renderer/glyph_cache.hpp"
+#include "renderer/persistent_glyph_cache.hpp"
+#include "renderer/rect.hpp"
 
 namespace aribcaption {
 
@@ -42,11 +46,37 @@ enum class TextRenderStatus {
     kOtherError
 };
 
+// Hinting of glyph outlines, chosen by QualityPreset
+enum class TextHinting : uint8_t {
+    kDefault = 0,  // Default hinting of the implementation
+    kLight = 1,    // Vertical only, keeps glyph shapes closer to their outlines
+    kNone = 2,
+};
+
 enum class TextRenderFallbackPolicy {
     kAutoFallback,
     kFailOnCodePointNotFound
 };
 
+// A char of a run passed to TextRenderer::DrawRun()
+struct TextRunChar {
+    int x = 0;
+    int y = 0;
+    uint32_t ucs4 = 0;
+    std::optional<UnderlineInfo> underline_info;
+};
+
+// Coverage masks of a char and their placement, used for rendering without a target bitmap
+struct RasterizedChar {
+    GlyphCacheKey glyph_key;                    // identifies the content of masks, stable inside a TextRenderer
+    std::shared_ptr<const CachedGlyph> glyph;   // nullptr for blank chars, e.g. spaces
+    int fill_x = 0;
+    int fill_y = 0;
+    int border_x = 0;
+    int border_y = 0;
+    std::optional<Rect> underline;
+};
+
 class TextRenderContext {
 public:
     struct ContextPrivate {
@@ -99,6 +129,53 @@ public:
                           float stroke_width, int char_width, int char_height,
                           std::optional<UnderlineInfo> underline_info,
                           TextRenderFallbackPolicy fallback_policy) -> TextRenderStatus = 0;
+
+    // Draw a run of chars sharing style, colors and size, status of each char is stored into out_statuses.
+    // Implementations able to draw whole glyph runs may override, falls back to DrawChar() for each char.
+    virtual void DrawRun(TextRenderContext& render_ctx, const std::vector<TextRunChar>& chars,
+                         CharStyle style, ColorRGBA color, ColorRGBA stroke_color,
+                         float stroke_width, int char_width, int char_height,
+                         TextRenderFallbackPolicy fallback_policy,
+                         std::vector<TextRenderStatus>& out_statuses);
+
+    // Optional, used by glyph atlas rendering
+    virtual auto RasterizeChar(int x, int y, uint32_t ucs4, CharStyle style, float stroke_width,
+                               int char_width, int char_height,
+                               std::optional<UnderlineInfo> underline_info,
+                               TextRenderFallbackPolicy fallback_policy) -> Result<RasterizedChar, TextRenderStatus> {
+        (void)x, (void)y, (void)ucs4, (void)style, (void)stroke_width, (void)char_width, (void)char_height;
+        (void)underline_info, (void)fallback_policy;
+        return Err(TextRenderStatus::kOtherError);
+    }
+
+    // Only honored by implementations that generate stroke borders themselves
+    virtual void SetStrokeMode(StrokeMode mode) { (void)mode; }
+
+    // Only honored by implementations that rasterize glyph outlines themselves
+    virtual void SetDistanceFieldGlyphs(bool enable) { (void)enable; }
+
+    // Only honored by implementations that hint glyph outlines
+    virtual void SetHinting(TextHinting hinting) { (void)hinting; }
+
+    // Glyph cache is optional for TextRenderer implementations
+    virtual void SetGlyphCacheLimit(size_t limit_bytes) { (void)limit_bytes; }
+    [[nodiscard]]
+    virtual auto GetGlyphCacheStats() const -> GlyphCacheStats { return GlyphCacheStats{}; }
+
+    // Consulted on glyph cache misses, nullptr to detach. Optional as well
+    virtual void SetPersistentGlyphCache(std::shared_ptr<PersistentGlyphCache> cache) { (void)cache; }
+
+    // Release cached glyphs, and loaded font faces if release_faces, which are loaded again on demand
+    virtual void TrimMemory(bool release_faces) { (void)release_faces; }
+    [[nodiscard]]
+    virtual size_t GetFontFaceCount() const { return 0; }
+    // Time the first loading of the main font face took, in microseconds. Zero if not loaded yet, or not measured
+    [[nodiscard]]
+    virtual uint64_t GetFirstFontLoadMicroseconds() const { return 0; }
+
+    // Take over loaded font faces and cached glyphs of other, which must be created with the same TextRendererType.
+    // Settings are not copied. Optional, implementations without such state ignore it
+    virtual void CopyWarmStateFrom(const TextRenderer& other) { (void)other; }
 public:
     // Disallow copy and assign
     TextRenderer(const TextRenderer&) = delete;
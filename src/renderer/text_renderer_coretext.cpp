@@ -26,8 +26,14 @@
 
 namespace aribcaption {
 
+// Caption usually uses a few char sizes, e.g. normal, middle and ruby
+constexpr size_t kMaxSizedCTFonts = 8;
+
 TextRendererCoreText::TextRendererCoreText(Context& context, FontProvider& font_provider)
-    : log_(GetContextLogger(context)), font_provider_(font_provider) {}
+    : log_(GetContextLogger(context)),
+      metrics_(GetContextMetrics(context)),
+      tracer_(GetContextTracer(context)),
+      font_provider_(font_provider) {}
 
 TextRendererCoreText::~TextRendererCoreText() = default;
 
@@ -47,12 +53,10 @@ bool TextRendererCoreText::SetFontFamily(const std::vector<std::string>& font_fa
 
     if (!font_family_.empty() && font_family_ != font_family) {
         // Reset CoreText fonts
-        main_ctfont_pixel_height_ = 0;
-        fallback_ctfont_pixel_height_ = 0;
         main_face_index_ = 0;
-        main_ctfont_sized_.reset();
+        main_ctfonts_sized_.clear();
         main_ctfont_.reset();
-        fallback_ctfont_sized_.reset();
+        fallback_ctfonts_sized_.clear();
         fallback_ctfont_.reset();
     }
 
@@ -115,28 +119,27 @@ auto TextRendererCoreText::DrawChar(TextRenderContext& render_ctx, int target_x,
 
     // Load main CTFont if not loaded
     if (!main_ctfont_) {
+        uint64_t start = Metrics::NowMicroseconds();
         auto result = LoadCTFont();
         if (result.is_err()) {
             log_->e("TextRendererCoreText: Cannot find valid font");
             return FontProviderErrorToStatus(result.error());
         }
+        if (!first_font_load_us_) {
+            first_font_load_us_ = Metrics::NowMicroseconds() - start;
+        }
         std::pair<ScopedCFRef<CTFontRef>, size_t>& pair = result.value();
         main_ctfont_ = std::move(pair.first);
         main_face_index_ = pair.second;
     }
 
-    // Build size-specified main CTFont
-    if (!main_ctfont_sized_ || char_height != main_ctfont_pixel_height_) {
-        main_ctfont_pixel_height_ = char_height;
-        main_ctfont_sized_ = CreateSizedCTFont(main_ctfont_.get(), char_height);
-        if (!main_ctfont_sized_) {
-            log_->e("TextRendererCoreText: Create sized CTFont failed");
-            return TextRenderStatus::kOtherError;
-        }
+    // Retrieve size-specified main CTFont
+    CTFontRef ctfont = GetSizedCTFont(main_ctfonts_sized_, main_ctfont_.get(), char_height);
+    if (!ctfont) {
+        log_->e("TextRendererCoreText: Create sized CTFont failed");
+        return TextRenderStatus::kOtherError;
     }
 
-    CTFontRef ctfont = main_ctfont_sized_.get();
-
     std::u16string utf16;
     size_t codeunit_count = utf::UTF16AppendCodePoint(utf16, ucs4);
     CGGlyph glyphs[2] = {0};
@@ -160,7 +163,6 @@ auto TextRendererCoreText::DrawChar(TextRenderContext& render_ctx, int target_x,
             return TextRenderStatus::kCodePointNotFound;
         }
 
-        bool reset_sized_fallback = false;
         // Missing glyph, check fallback CTFont
         if (!fallback_ctfont_ || !CTFontGetGlyphsForCharacters(fallback_ctfont_.get(),
                                                                reinterpret_cast<UniChar*>(utf16.data()),
@@ -175,20 +177,15 @@ auto TextRendererCoreText::DrawChar(TextRenderContext& render_ctx, int target_x,
             }
             std::pair<ScopedCFRef<CTFontRef>, size_t>& pair = result.value();
             fallback_ctfont_ = std::move(pair.first);
-            reset_sized_fallback = true;
+            fallback_ctfonts_sized_.clear();
         }
 
-        // Build size-specified fallback CTFont
-        if (!fallback_ctfont_sized_ || char_height != fallback_ctfont_pixel_height_ || reset_sized_fallback) {
-            fallback_ctfont_pixel_height_ = char_height;
-            fallback_ctfont_sized_ = CreateSizedCTFont(fallback_ctfont_.get(), char_height);
-            if (!fallback_ctfont_sized_) {
-                log_->e("TextRendererCoreText: Create sized fallback CTFont failed");
-                return TextRenderStatus::kOtherError;
-            }
+        // Retrieve size-specified fallback CTFont
+        ctfont = GetSizedCTFont(fallback_ctfonts_sized_, fallback_ctfont_.get(), char_height);
+        if (!ctfont) {
+            log_->e("TextRendererCoreText: Create sized fallback CTFont failed");
+            return TextRenderStatus::kOtherError;
         }
-
-        ctfont = fallback_ctfont_sized_.get();
     }
 
     // Re-retrieve glyph from sized CTFont
@@ -216,8 +213,7 @@ auto TextRendererCoreText::DrawChar(TextRenderContext& render_ctx, int target_x,
     // Draw Underline if required
     if ((style & kCharStyleUnderline) && underline_info && underline_thickness > 0.0f) {
         CGFloat underline_y = baseline_y + underline_pos;
-        ScopedCFRef<CGColorRef> cg_underline_color = RGBAToCGColor(color);
-        CGContextSetStrokeColorWithColor(ctx.get(), cg_underline_color.get());
+        SetStrokeColor(ctx.get(), color);
         CGContextSetLineWidth(ctx.get(), underline_thickness);
 
         CGContextMoveToPoint(ctx.get(), underline_info->start_x, underline_y);
@@ -241,8 +237,7 @@ auto TextRendererCoreText::DrawChar(TextRenderContext& render_ctx, int target_x,
         ScopedCFRef<CGPathRef> path(CTFontCreatePathForGlyph(ctfont, glyphs[0], &path_matrix));
         CGContextAddPath(ctx.get(), path.get());
 
-        ScopedCFRef<CGColorRef> cg_stroke_color = RGBAToCGColor(stroke_color);
-        CGContextSetStrokeColorWithColor(ctx.get(), cg_stroke_color.get());
+        SetStrokeColor(ctx.get(), stroke_color);
         CGContextSetLineWidth(ctx.get(), stroke_width * 2);
         CGContextSetLineCap(ctx.get(), kCGLineCapRound);
         CGContextSetLineJoin(ctx.get(), kCGLineJoinRound);
@@ -250,8 +245,7 @@ auto TextRendererCoreText::DrawChar(TextRenderContext& render_ctx, int target_x,
     }
 
     // Draw character (fill)
-    ScopedCFRef<CGColorRef> cg_fill_color = RGBAToCGColor(color);
-    CGContextSetFillColorWithColor(ctx.get(), cg_fill_color.get());
+    SetFillColor(ctx.get(), color);
     CTFontDrawGlyphs(ctfont, &glyphs[0], &origin, 1, ctx.get());
 
     CGContextRestoreGState(ctx.get());
@@ -268,13 +262,16 @@ auto TextRendererCoreText::LoadCTFont(std::optional<uint32_t> codepoint, std::op
     // begin_index is optional
     size_t font_index = begin_index.value_or(0);
 
+    ARIBCC_TRACE_SCOPE(tracer_.get(), "renderer", "FontProvider::GetFontFace");
     const std::string& font_name = font_family_[font_index];
     auto result = font_provider_.GetFontFace(font_name, codepoint);
+    metrics_->Add(MetricCounter::kFontLookups);
 
     while (result.is_err() && font_index + 1 < font_family_.size()) {
         // Find next suitable font
         font_index++;
         result = font_provider_.GetFontFace(font_family_[font_index], codepoint);
+        metrics_->Add(MetricCounter::kFontLookups);
     }
     if (result.is_err()) {
         // Not found, return Err Result
@@ -292,17 +289,42 @@ auto TextRendererCoreText::LoadCTFont(std::optional<uint32_t> codepoint, std::op
     return Ok(std::make_pair(std::move(priv->ct_font), font_index));
 }
 
-auto TextRendererCoreText::RGBAToCGColor(ColorRGBA rgba) -> ScopedCFRef<CGColorRef> {
-    CGFloat components[] = {
-        static_cast<CGFloat>(rgba.r) / 255.0f,
-        static_cast<CGFloat>(rgba.g) / 255.0f,
-        static_cast<CGFloat>(rgba.b) / 255.0f,
-        static_cast<CGFloat>(rgba.a) / 255.0f,
-    };
-    ScopedCFRef<CGColorSpaceRef> space(CGColorSpaceCreateDeviceRGB());
-    ScopedCFRef<CGColorRef> cgcolor(CGColorCreate(space.get(), components));
+auto TextRendererCoreText::GetSizedCTFont(std::unordered_map<int, ScopedCFRef<CTFontRef>>& sized_ctfonts,
+                                          CTFontRef ctfont, int char_height) -> CTFontRef {
+    auto iter = sized_ctfonts.find(char_height);
+    if (iter != sized_ctfonts.end()) {
+        return iter->second.get();
+    }
+
+    ScopedCFRef<CTFontRef> sized_ctfont = CreateSizedCTFont(ctfont, char_height);
+    if (!sized_ctfont) {
+        return nullptr;
+    }
+
+    if (sized_ctfonts.size() >= kMaxSizedCTFonts) {
+        sized_ctfonts.clear();
+    }
+    CTFontRef result = sized_ctfont.get();
+    sized_ctfonts.emplace(char_height, std::move(sized_ctfont));
+    return result;
+}
+
+// Set colors by components directly, which is cheaper than creating CGColors for each char.
+// The bitmap context uses DeviceRGB color space.
+void TextRendererCoreText::SetFillColor(CGContextRef ctx, ColorRGBA rgba) {
+    CGContextSetRGBFillColor(ctx,
+                             static_cast<CGFloat>(rgba.r) / 255.0f,
+                             static_cast<CGFloat>(rgba.g) / 255.0f,
+                             static_cast<CGFloat>(rgba.b) / 255.0f,
+                             static_cast<CGFloat>(rgba.a) / 255.0f);
+}
 
-    return cgcolor;
+void TextRendererCoreText::SetStrokeColor(CGContextRef ctx, ColorRGBA rgba) {
+    CGContextSetRGBStrokeColor(ctx,
+                               static_cast<CGFloat>(rgba.r) / 255.0f,
+                               static_cast<CGFloat>(rgba.g) / 255.0f,
+                               static_cast<CGFloat>(rgba.b) / 255.0f,
+                               static_cast<CGFloat>(rgba.a) / 255.0f);
 }
 
 auto TextRendererCoreText::CreateBitmapTargetCGContext(Bitmap& bitmap) -> ScopedCFRef<CGContextRef> {
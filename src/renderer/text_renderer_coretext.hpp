@@ -30,9 +30,12 @@
 #include <string>
 #include <memory>
 #include <optional>
+#include <unordered_map>
 #include "aribcaption/context.hpp"
 #include "base/logger.hpp"
+#include "base/metrics.hpp"
 #include "base/scoped_cfref.hpp"
+#include "base/tracer.hpp"
 #include "renderer/bitmap.hpp"
 #include "renderer/font_provider.hpp"
 #include "renderer/text_renderer.hpp"
@@ -54,30 +57,36 @@ public:
                   float stroke_width, int char_width, int char_height,
                   std::optional<UnderlineInfo> underline_info,
                   TextRenderFallbackPolicy fallback_policy) -> TextRenderStatus override;
+    [[nodiscard]]
+    uint64_t GetFirstFontLoadMicroseconds() const override { return first_font_load_us_; }
 private:
     auto LoadCTFont(std::optional<uint32_t> codepoint = std::nullopt,
                     std::optional<size_t> begin_index = std::nullopt)
                     -> Result<std::pair<ScopedCFRef<CTFontRef>, size_t>, FontProviderError>;
+    static auto GetSizedCTFont(std::unordered_map<int, ScopedCFRef<CTFontRef>>& sized_ctfonts,
+                               CTFontRef ctfont, int char_height) -> CTFontRef;
 private:
-    static auto RGBAToCGColor(ColorRGBA rgba) -> ScopedCFRef<CGColorRef>;
+    static void SetFillColor(CGContextRef ctx, ColorRGBA rgba);
+    static void SetStrokeColor(CGContextRef ctx, ColorRGBA rgba);
     static auto CreateBitmapTargetCGContext(Bitmap& bitmap) -> ScopedCFRef<CGContextRef>;
     static auto CreateSizedCTFont(CTFontRef ctfont, int char_height) -> ScopedCFRef<CTFontRef>;
 private:
     std::shared_ptr<Logger> log_;
+    std::shared_ptr<Metrics> metrics_;
+    std::shared_ptr<Tracer> tracer_;
 
     FontProvider& font_provider_;
     std::vector<std::string> font_family_;
 
     size_t main_face_index_ = 0;
+    uint64_t first_font_load_us_ = 0;
 
     ScopedCFRef<CTFontRef> main_ctfont_;
     ScopedCFRef<CTFontRef> fallback_ctfont_;
 
-    int main_ctfont_pixel_height_ = 0;
-    int fallback_ctfont_pixel_height_ = 0;
-
-    ScopedCFRef<CTFontRef> main_ctfont_sized_;
-    ScopedCFRef<CTFontRef> fallback_ctfont_sized_;
+    // Size-specified CTFonts, keyed by pixel height
+    std::unordered_map<int, ScopedCFRef<CTFontRef>> main_ctfonts_sized_;
+    std::unordered_map<int, ScopedCFRef<CTFontRef>> fallback_ctfonts_sized_;
 };
 
 }  // namespace aribcaption
@@ -16,6 +16,7 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <functional>
@@ -198,7 +199,10 @@ private:
 
 
 TextRendererDirectWrite::TextRendererDirectWrite(Context& context, FontProvider& font_provider)
-    : log_(GetContextLogger(context)), font_provider_(font_provider) {
+    : log_(GetContextLogger(context)),
+      metrics_(GetContextMetrics(context)),
+      tracer_(GetContextTracer(context)),
+      font_provider_(font_provider) {
     assert(font_provider.GetType() == FontProviderType::kDirectWrite);
 }
 
@@ -280,29 +284,28 @@ public:
 public:
     ComPtr<IWICBitmap> wic_bitmap;
     ComPtr<ID2D1RenderTarget> d2d_render_target;
+    ComPtr<ID2D1SolidColorBrush> fill_brush;
+    ComPtr<ID2D1SolidColorBrush> outline_brush;
 };
 
 auto TextRendererDirectWrite::BeginDraw(Bitmap& target_bmp) -> TextRenderContext {
-    auto priv = std::make_unique<TextRenderContextPrivateDirectWrite>();
-    // Create WIC bitmap
-    HRESULT hr = wic_factory_->CreateBitmap(static_cast<UINT>(target_bmp.width()),
-                                            static_cast<UINT>(target_bmp.height()),
-                                            GUID_WICPixelFormat32bppPRGBA,
-                                            WICBitmapCreateCacheOption::WICBitmapCacheOnLoad,
-                                            &priv->wic_bitmap);
-    if (FAILED(hr)) {
-        log_->e("TextRendererDirectWrite: Allocate IWICBitmap failed");
+    auto width = static_cast<uint32_t>(target_bmp.width());
+    auto height = static_cast<uint32_t>(target_bmp.height());
+    if (!PrepareDrawingResources(width, height)) {
         return TextRenderContext(target_bmp);
     }
 
-    // Create WIC-target Direct2D render target
-    priv->d2d_render_target = CreateWICRenderTarget(priv->wic_bitmap.Get());
-    if (!priv->d2d_render_target) {
-        log_->e("TextRendererDirectWrite: Create WIC ID2D1RenderTarget failed");
-        return TextRenderContext(target_bmp);
-    }
+    auto priv = std::make_unique<TextRenderContextPrivateDirectWrite>();
+    priv->wic_bitmap = wic_bitmap_;
+    priv->d2d_render_target = wic_render_target_;
+    priv->fill_brush = fill_brush_;
+    priv->outline_brush = outline_brush_;
 
+    // The pooled bitmap may be larger than the region, only clear and draw inside the region
     priv->d2d_render_target->BeginDraw();
+    priv->d2d_render_target->PushAxisAlignedClip(
+        D2D1::RectF(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height)),
+        D2D1_ANTIALIAS_MODE_ALIASED);
     priv->d2d_render_target->Clear();
     priv->d2d_render_target->SetAntialiasMode(D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
     priv->d2d_render_target->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_CLEARTYPE);
@@ -312,20 +315,86 @@ auto TextRendererDirectWrite::BeginDraw(Bitmap& target_bmp) -> TextRenderContext
 
 void TextRendererDirectWrite::EndDraw(TextRenderContext& context) {
     auto priv = static_cast<TextRenderContextPrivateDirectWrite*>(context.GetPrivate());
+    if (!priv) {
+        return;
+    }
 
+    priv->d2d_render_target->PopAxisAlignedClip();
     HRESULT hr = priv->d2d_render_target->EndDraw();
     if (FAILED(hr)) {
         log_->e("TextRendererDirectWrite: ID2D1RenderTarget::EndDraw() returned error");
+        if (hr == D2DERR_RECREATE_TARGET) {
+            // Drop pooled resources, they will be recreated in next BeginDraw()
+            wic_render_target_.Reset();
+            fill_brush_.Reset();
+            outline_brush_.Reset();
+        }
     }
     priv->d2d_render_target.Reset();
 
-    bool result = BlendWICBitmapToBitmap(priv->wic_bitmap.Get(), context.GetBitmap(), 0, 0);
+    Bitmap& target_bmp = context.GetBitmap();
+    bool result = BlendWICBitmapToBitmap(priv->wic_bitmap.Get(),
+                                         static_cast<uint32_t>(target_bmp.width()),
+                                         static_cast<uint32_t>(target_bmp.height()),
+                                         target_bmp, 0, 0);
     if (!result) {
         log_->e("TextRendererDirectWrite: BlendWICBitmapToBitmap() failed");
     }
     priv->wic_bitmap.Reset();
 }
 
+bool TextRendererDirectWrite::PrepareDrawingResources(uint32_t width, uint32_t height) {
+    if (!wic_bitmap_ || width > wic_bitmap_width_ || height > wic_bitmap_height_) {
+        uint32_t new_width = std::max(width, wic_bitmap_width_);
+        uint32_t new_height = std::max(height, wic_bitmap_height_);
+
+        // Create WIC bitmap
+        ComPtr<IWICBitmap> wic_bitmap;
+        HRESULT hr = wic_factory_->CreateBitmap(static_cast<UINT>(new_width),
+                                                static_cast<UINT>(new_height),
+                                                GUID_WICPixelFormat32bppPRGBA,
+                                                WICBitmapCreateCacheOption::WICBitmapCacheOnLoad,
+                                                &wic_bitmap);
+        if (FAILED(hr)) {
+            log_->e("TextRendererDirectWrite: Allocate IWICBitmap failed");
+            return false;
+        }
+
+        wic_bitmap_ = std::move(wic_bitmap);
+        wic_bitmap_width_ = new_width;
+        wic_bitmap_height_ = new_height;
+
+        // Render target and brushes are bound to the WIC bitmap
+        wic_render_target_.Reset();
+        fill_brush_.Reset();
+        outline_brush_.Reset();
+    }
+
+    if (!wic_render_target_) {
+        // Create WIC-target Direct2D render target
+        wic_render_target_ = CreateWICRenderTarget(wic_bitmap_.Get());
+        if (!wic_render_target_) {
+            log_->e("TextRendererDirectWrite: Create WIC ID2D1RenderTarget failed");
+            return false;
+        }
+    }
+
+    if (!fill_brush_ || !outline_brush_) {
+        HRESULT hr = wic_render_target_->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::White), &fill_brush_);
+        if (SUCCEEDED(hr)) {
+            hr = wic_render_target_->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black), &outline_brush_);
+        }
+        if (FAILED(hr)) {
+            log_->e("TextRendererDirectWrite: ID2D1RenderTarget::CreateSolidColorBrush() failed");
+            fill_brush_.Reset();
+            outline_brush_.Reset();
+            return false;
+        }
+    }
+
+    return true;
+}
+
 auto TextRendererDirectWrite::DrawChar(TextRenderContext& render_ctx, int target_x, int target_y,
                                        uint32_t ucs4, CharStyle style, ColorRGBA color, ColorRGBA stroke_color,
                                        float stroke_width, int char_width, int char_height,
@@ -349,11 +418,15 @@ auto TextRendererDirectWrite::DrawChar(TextRenderContext& render_ctx, int target
 
     // Load main font if not loaded
     if (!main_faceinfo_) {
+        uint64_t start = Metrics::NowMicroseconds();
         auto result = LoadDWriteFont();
         if (result.is_err()) {
             log_->e("TextRendererDirectWrite: Cannot find valid font");
             return FontProviderErrorToStatus(result.error());
         }
+        if (!first_font_load_us_) {
+            first_font_load_us_ = Metrics::NowMicroseconds() - start;
+        }
         auto& pair = result.value();
         main_faceinfo_ = std::move(pair.first);
         main_face_index_ = pair.second;
@@ -500,15 +573,14 @@ auto TextRendererDirectWrite::DrawChar(TextRenderContext& render_ctx, int target
         canvas.DrawRect(color, underline_rect);
     };
 
-    ComPtr<ID2D1SolidColorBrush> fill_brush;
-    render_target->CreateSolidColorBrush(RGBAToD2DColor(color), &fill_brush);
-
-    ComPtr<ID2D1SolidColorBrush> outline_brush;
-    render_target->CreateSolidColorBrush(RGBAToD2DColor(stroke_color), &outline_brush);
+    // Brushes are pooled with the render target, D2D captures brush state at each draw call
+    render_ctx_priv->fill_brush->SetColor(RGBAToD2DColor(color));
+    render_ctx_priv->outline_brush->SetColor(RGBAToD2DColor(stroke_color));
 
     ComPtr<OutlineTextRenderer> outline_text_renderer(new OutlineTextRenderer(
         horizontal_scale, 1.0f, style & CharStyle::kCharStyleStroke, stroke_width * 2,
-        stroke_style_, d2d_factory_, render_target, fill_brush, outline_brush, underline_callback));
+        stroke_style_, d2d_factory_, render_target,
+        render_ctx_priv->fill_brush, render_ctx_priv->outline_brush, underline_callback));
 
     text_layout->Draw(nullptr,
                       outline_text_renderer.Get(),
@@ -528,13 +600,16 @@ auto TextRendererDirectWrite::LoadDWriteFont(std::optional<uint32_t> codepoint,
     // begin_index is optional
     size_t font_index = begin_index.value_or(0);
 
+    ARIBCC_TRACE_SCOPE(tracer_.get(), "renderer", "FontProvider::GetFontFace");
     const std::string& font_name = font_family_[font_index];
     auto result = font_provider_.GetFontFace(font_name, codepoint);
+    metrics_->Add(MetricCounter::kFontLookups);
 
     while (result.is_err() && font_index + 1 < font_family_.size()) {
         // Find next suitable font
         font_index++;
         result = font_provider_.GetFontFace(font_family_[font_index], codepoint);
+        metrics_->Add(MetricCounter::kFontLookups);
     }
     if (result.is_err()) {
         // Not found, return Err Result
@@ -607,13 +682,9 @@ auto TextRendererDirectWrite::CreateWICRenderTarget(IWICBitmap* target) -> ComPt
     return render_target;
 }
 
-bool TextRendererDirectWrite::BlendWICBitmapToBitmap(IWICBitmap* wic_bitmap,
-                                                     Bitmap& target_bmp,
-                                                     int target_x, int target_y) {
-    uint32_t width = 0;
-    uint32_t height = 0;
-    wic_bitmap->GetSize(&width, &height);
-
+bool TextRendererDirectWrite::BlendWICBitmapToBitmap(IWICBitmap* wic_bitmap, uint32_t width, uint32_t height,
+                                                     Bitmap& target_bmp, int target_x, int target_y) {
+    // Only the top-left width x height area is used if the bitmap is pooled and larger
     WICRect lock_rect = {0, 0, static_cast<int>(width), static_cast<int>(height)};
 
     ComPtr<IWICBitmapLock> lock;
@@ -25,7 +25,9 @@
 #include <wincodec.h>
 #include <optional>
 #include "aribcaption/context.hpp"
+#include "base/metrics.hpp"
 #include "base/scoped_com_initializer.hpp"
+#include "base/tracer.hpp"
 #include "renderer/font_provider.hpp"
 #include "renderer/text_renderer.hpp"
 
@@ -48,19 +50,24 @@ public:
                   float stroke_width, int char_width, int char_height,
                   std::optional<UnderlineInfo> underline_info,
                   TextRenderFallbackPolicy fallback_policy) -> TextRenderStatus override;
+    [[nodiscard]]
+    uint64_t GetFirstFontLoadMicroseconds() const override { return first_font_load_us_; }
 private:
     auto LoadDWriteFont(std::optional<uint32_t> codepoint = std::nullopt,
                         std::optional<size_t> begin_index = std::nullopt)
         -> Result<std::pair<FontfaceInfo, size_t>, FontProviderError>;
     auto CreateDWriteTextFormat(FontfaceInfo& face_info, int font_size) -> ComPtr<IDWriteTextFormat>;
     auto CreateWICRenderTarget(IWICBitmap* target) -> ComPtr<ID2D1RenderTarget>;
-    bool BlendWICBitmapToBitmap(IWICBitmap* wic_bitmap, Bitmap& target_bmp,
-                                int target_x, int target_y);
+    bool PrepareDrawingResources(uint32_t width, uint32_t height);
+    bool BlendWICBitmapToBitmap(IWICBitmap* wic_bitmap, uint32_t width, uint32_t height,
+                                Bitmap& target_bmp, int target_x, int target_y);
 private:
     static D2D1_COLOR_F RGBAToD2DColor(ColorRGBA color);
     static bool FontfaceHasCharacter(FontfaceInfo& fontface, uint32_t ucs4);
 private:
     std::shared_ptr<Logger> log_;
+    std::shared_ptr<Metrics> metrics_;
+    std::shared_ptr<Tracer> tracer_;
 
     FontProvider& font_provider_;
     uint32_t iso6392_language_code_ = 0;
@@ -73,6 +80,7 @@ private:
     ComPtr<ID2D1StrokeStyle> stroke_style_;
 
     size_t main_face_index_ = 0;
+    uint64_t first_font_load_us_ = 0;
 
     std::optional<FontfaceInfo> main_faceinfo_;
     std::optional<FontfaceInfo> fallback_faceinfo_;
@@ -82,6 +90,14 @@ private:
 
     ComPtr<IDWriteTextFormat> main_text_format_;
     ComPtr<IDWriteTextFormat> fallback_text_format_;
+
+    // Drawing resources reused across regions, grown to the largest region seen
+    ComPtr<IWICBitmap> wic_bitmap_;
+    ComPtr<ID2D1RenderTarget> wic_render_target_;
+    ComPtr<ID2D1SolidColorBrush> fill_brush_;
+    ComPtr<ID2D1SolidColorBrush> outline_brush_;
+    uint32_t wic_bitmap_width_ = 0;
+    uint32_t wic_bitmap_height_ = 0;
 };
 
 }  // namespace aribcaption
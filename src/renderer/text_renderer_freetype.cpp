@@ -16,36 +16,69 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <cstdint>
 #include <cmath>
+#include <tuple>
 #include "base/scoped_holder.hpp"
 #include "base/utf_helper.hpp"
-#include "renderer/alphablend.hpp"
+#include "base/xxhash.hpp"
 #include "renderer/canvas.hpp"
+#include "renderer/distance_field.hpp"
+#include "renderer/mask_dilation.hpp"
 #include "renderer/text_renderer_freetype.hpp"
-#include FT_STROKER_H
 #include FT_SFNT_NAMES_H
+#include FT_SIZES_H
 #include FT_TRUETYPE_IDS_H
 
 namespace aribcaption {
 
+TextRendererFreetype::FreetypeFace::~FreetypeFace() {
+    if (face) {
+        std::lock_guard<std::mutex> lock(library->mutex);
+        face.Reset();
+    }
+}
+
 TextRendererFreetype::TextRendererFreetype(Context& context, FontProvider& font_provider) :
-      log_(GetContextLogger(context)), font_provider_(font_provider) {}
+      log_(GetContextLogger(context)),
+      metrics_(GetContextMetrics(context)),
+      tracer_(GetContextTracer(context)),
+      font_provider_(font_provider),
+      shared_registry_(GetContextSharedRegistry(context)) {}
 
 TextRendererFreetype::~TextRendererFreetype() = default;
 
 bool TextRendererFreetype::Initialize() {
-    FT_Library library;
-    FT_Error error = FT_Init_FreeType(&library);
-    if (error) {
+    auto create_library = []() -> std::shared_ptr<FreetypeLibrary> {
+        FT_Library library;
+        if (FT_Init_FreeType(&library)) {
+            return nullptr;
+        }
+        auto shared_library = std::make_shared<FreetypeLibrary>();
+        shared_library->library = ScopedHolder<FT_Library>(library, FT_Done_FreeType);
+        return shared_library;
+    };
+
+    if (shared_registry_) {
+        library_ = shared_registry_->GetOrCreate<FreetypeLibrary>("freetype:library", create_library);
+    } else {
+        library_ = create_library();
+    }
+    if (!library_) {
         log_->e("Freetype: FT_Init_FreeType() failed");
-        library_ = nullptr;
         return false;
     }
 
-    library_ = ScopedHolder<FT_Library>(library, FT_Done_FreeType);
+    FT_Stroker stroker;
+    if (FT_Stroker_New(library_->library, &stroker)) {
+        log_->e("Freetype: FT_Stroker_New() failed");
+        return false;
+    }
+    stroker_ = ScopedHolder<FT_Stroker>(stroker, FT_Stroker_Done);
+
     return true;
 }
 
@@ -61,11 +94,10 @@ bool TextRendererFreetype::SetFontFamily(const std::vector<std::string>& font_fa
 
     if (!font_family_.empty() && font_family_ != font_family) {
         // Reset Freetype faces
-        main_face_.Reset();
-        fallback_face_.Reset();
-        main_face_data_.clear();
-        fallback_face_data_.clear();
+        main_face_.reset();
         main_face_index_ = 0;
+        fallback_faces_.clear();
+        fallback_face_map_.clear();
     }
 
     font_family_ = font_family;
@@ -86,6 +118,96 @@ auto TextRendererFreetype::DrawChar(TextRenderContext& render_ctx, int target_x,
                                     float stroke_width, int char_width, int char_height,
                                     std::optional<UnderlineInfo> underline_info,
                                     TextRenderFallbackPolicy fallback_policy) -> TextRenderStatus {
+    auto result = RasterizeChar(target_x, target_y, ucs4, style, stroke_width, char_width, char_height,
+                                underline_info, fallback_policy);
+    if (result.is_err()) {
+        return result.error();
+    }
+
+    const RasterizedChar& rasterized = result.value();
+    if (!rasterized.glyph) {
+        return TextRenderStatus::kOK;
+    }
+
+    Canvas canvas(render_ctx.GetBitmap());
+
+    // Draw Underline if required
+    if (rasterized.underline) {
+        canvas.DrawRect(color, rasterized.underline.value());
+    }
+
+    // Draw stroke border, if required
+    if (rasterized.glyph->border) {
+        const GlyphMask& border = rasterized.glyph->border.value();
+        canvas.DrawMask(stroke_color, border.coverage.data(), border.width, border.height, border.width,
+                        rasterized.border_x, rasterized.border_y);
+    }
+
+    // Draw filling
+    const GlyphMask& fill = rasterized.glyph->fill;
+    canvas.DrawMask(color, fill.coverage.data(), fill.width, fill.height, fill.width,
+                    rasterized.fill_x, rasterized.fill_y);
+
+    return TextRenderStatus::kOK;
+}
+
+void TextRendererFreetype::DrawRun(TextRenderContext& render_ctx, const std::vector<TextRunChar>& chars,
+                                   CharStyle style, ColorRGBA color, ColorRGBA stroke_color,
+                                   float stroke_width, int char_width, int char_height,
+                                   TextRenderFallbackPolicy fallback_policy,
+                                   std::vector<TextRenderStatus>& out_statuses) {
+    out_statuses.clear();
+    out_statuses.reserve(chars.size());
+    run_rasterized_.clear();
+    run_underlines_.clear();
+
+    // Rasterize all chars first, so that underlines of adjacent chars could be drawn as one rect below glyphs
+    for (const TextRunChar& ch : chars) {
+        auto result = RasterizeChar(ch.x, ch.y, ch.ucs4, style, stroke_width, char_width, char_height,
+                                    ch.underline_info, fallback_policy);
+        if (result.is_err()) {
+            out_statuses.push_back(result.error());
+            continue;
+        }
+        out_statuses.push_back(TextRenderStatus::kOK);
+        RasterizedChar& rasterized = run_rasterized_.emplace_back(std::move(result.value()));
+        if (!rasterized.glyph || !rasterized.underline) {
+            continue;
+        }
+        const Rect& underline = rasterized.underline.value();
+        if (!run_underlines_.empty() && run_underlines_.back().right == underline.left &&
+            run_underlines_.back().top == underline.top && run_underlines_.back().bottom == underline.bottom) {
+            run_underlines_.back().right = underline.right;
+        } else {
+            run_underlines_.push_back(underline);
+        }
+    }
+
+    Canvas canvas(render_ctx.GetBitmap());
+    for (const Rect& underline : run_underlines_) {
+        canvas.DrawRect(color, underline);
+    }
+    for (const RasterizedChar& rasterized : run_rasterized_) {
+        if (!rasterized.glyph) {
+            continue;
+        }
+        if (rasterized.glyph->border) {
+            const GlyphMask& border = rasterized.glyph->border.value();
+            canvas.DrawMask(stroke_color, border.coverage.data(), border.width, border.height, border.width,
+                            rasterized.border_x, rasterized.border_y);
+        }
+        const GlyphMask& fill = rasterized.glyph->fill;
+        canvas.DrawMask(color, fill.coverage.data(), fill.width, fill.height, fill.width,
+                        rasterized.fill_x, rasterized.fill_y);
+    }
+    run_rasterized_.clear();  // Release references to cached glyphs
+}
+
+auto TextRendererFreetype::RasterizeChar(int target_x, int target_y, uint32_t ucs4, CharStyle style,
+                                         float stroke_width, int char_width, int char_height,
+                                         std::optional<UnderlineInfo> underline_info,
+                                         TextRenderFallbackPolicy fallback_policy)
+                                         -> Result<RasterizedChar, TextRenderStatus> {
     assert(char_height > 0);
     if (stroke_width < 0.0f) {
         stroke_width = 0.0f;
@@ -94,177 +216,462 @@ auto TextRendererFreetype::DrawChar(TextRenderContext& render_ctx, int target_x,
     // Handle space characters
     if (ucs4 == 0x0009 || ucs4 == 0x0020 || ucs4 == 0x00A0 || ucs4 == 0x1680 ||
         ucs4 == 0x3000 || ucs4 == 0x202F || ucs4 == 0x205F || (ucs4 >= 0x2000 && ucs4 <= 0x200A)) {
-        return TextRenderStatus::kOK;
+        return Ok(RasterizedChar{});
     }
 
     if (!main_face_) {
         // If main FT_Face is not yet loaded, try load FT_Face from font_family_
         // We don't care about the codepoint (ucs4) now
-        auto result = LoadFontFace(false);
+        uint64_t start = Metrics::NowMicroseconds();
+        auto result = LoadFontFace();
         if (result.is_err()) {
             log_->e("Freetype: Cannot find valid font");
-            return FontProviderErrorToStatus(result.error());
+            return Err(FontProviderErrorToStatus(result.error()));
+        }
+        if (!first_font_load_us_) {
+            first_font_load_us_ = Metrics::NowMicroseconds() - start;
         }
-        std::pair<FT_Face, size_t>& pair = result.value();
-        main_face_ = ScopedHolder<FT_Face>(pair.first, FT_Done_Face);
+        auto& pair = result.value();
+        main_face_ = std::move(pair.first);
         main_face_index_ = pair.second;
+        main_face_id_ = next_face_id_++;
     }
 
-    FT_Face face = main_face_;
-    FT_UInt glyph_index = FT_Get_Char_Index(face, ucs4);
+    FreetypeFace* face = main_face_.get();
+    uint32_t face_id = main_face_id_;
+    FT_UInt glyph_index = GetCharIndex(*face, ucs4);
 
     if (glyph_index == 0) {
-        log_->w("Freetype: Main font %s doesn't contain U+%04X", face->family_name, ucs4);
-
         if (fallback_policy == TextRenderFallbackPolicy::kFailOnCodePointNotFound) {
-            return TextRenderStatus::kCodePointNotFound;
+            log_->w("Freetype: Main font %s doesn't contain U+%04X", face->face->family_name, ucs4);
+            return Err(TextRenderStatus::kCodePointNotFound);
         }
 
-        // Missing glyph, check fallback face
-        if (fallback_face_ && (glyph_index = FT_Get_Char_Index(fallback_face_, ucs4))) {
-            face = fallback_face_;
-        } else if (main_face_index_ + 1 >= font_family_.size()) {
-            // Fallback fonts not available
-            return TextRenderStatus::kCodePointNotFound;
-        } else {
-            // Fallback fontface not loaded, or fallback fontface doesn't contain required codepoint
-            // Load next fallback font face by specific codepoint
-            auto result = LoadFontFace(true, ucs4, main_face_index_ + 1);
-            if (result.is_err()) {
-                log_->e("Freetype: Cannot find available fallback font for U+%04X", ucs4);
-                return FontProviderErrorToStatus(result.error());
-            }
-            std::pair<FT_Face, size_t>& pair = result.value();
-            fallback_face_ = ScopedHolder<FT_Face>(pair.first, FT_Done_Face);
-
-            // Use this fallback fontface for rendering this time
-            face = fallback_face_;
-            glyph_index = FT_Get_Char_Index(face, ucs4);
-            if (glyph_index == 0) {
-                log_->e("Freetype: Got glyph_index == 0 for U+%04X in fallback font", ucs4);
-                return TextRenderStatus::kCodePointNotFound;
-            }
+        // Missing glyph, check fallback faces
+        auto result = FindFallbackFace(ucs4);
+        if (result.is_err()) {
+            return Err(result.error());
         }
+        std::tie(face, face_id) = result.value();
+        glyph_index = GetCharIndex(*face, ucs4);
     }
 
-    if (FT_Set_Pixel_Sizes(face, static_cast<FT_UInt>(char_width), static_cast<FT_UInt>(char_height))) {
-        log_->e("Freetype: FT_Set_Pixel_Sizes failed");
-        return TextRenderStatus::kOtherError;
+    FT_Fixed stroke_width_26_6 = 0;
+    if (style & CharStyle::kCharStyleStroke && stroke_width > 0.0f) {
+        stroke_width_26_6 = static_cast<FT_Fixed>(stroke_width * 64);
+    }
+
+    GlyphCacheKey cache_key;
+    cache_key.face_id = face_id;
+    cache_key.glyph_index = glyph_index;
+    cache_key.pixel_width = char_width;
+    cache_key.pixel_height = char_height;
+    cache_key.stroke_width = static_cast<int32_t>(stroke_width_26_6);
+    cache_key.stroke_mode = stroke_width_26_6 ? static_cast<uint8_t>(stroke_mode_) : 0;
+    cache_key.hinting = static_cast<uint8_t>(hinting_);
+
+    // Distance fields are clamped by their spread, which limits stroke width on small characters,
+    // while resampling much larger than the reference size rounds corners off.
+    // Such characters are rasterized from outlines instead.
+    float stroke_width_px = static_cast<float>(stroke_width_26_6) / 64.0f;
+    float field_scale = static_cast<float>(char_height) / static_cast<float>(kDistanceFieldReferenceSize);
+    cache_key.distance_field = distance_field_glyphs_ &&
+                               char_height <= kDistanceFieldReferenceSize * 2 &&
+                               stroke_width_px + 1.0f < static_cast<float>(kDistanceFieldSpread) * field_scale;
+    if (cache_key.distance_field) {
+        cache_key.stroke_mode = 0;
+        cache_key.hinting = 0;
     }
 
-    int baseline = static_cast<int>(face->size->metrics.ascender >> 6);
-    int ascender = static_cast<int>(face->size->metrics.ascender >> 6);
-    int descender = static_cast<int>(face->size->metrics.descender >> 6);
-    int underline = static_cast<int>(FT_MulFix(face->underline_position, face->size->metrics.x_scale) >> 6);
-    int underline_thickness = static_cast<int>(FT_MulFix(face->underline_thickness, face->size->metrics.x_scale) >> 6);
+    std::shared_ptr<const CachedGlyph> glyph = glyph_cache_.Get(cache_key);
+    metrics_->Add(glyph ? MetricCounter::kGlyphCacheHits : MetricCounter::kGlyphCacheMisses);
+
+    // Distance field glyphs are cheap to produce once the field is cached, they aren't persisted
+    PersistentGlyphCache::Key persistent_key;
+    bool persistent = persistent_glyph_cache_ && face->font_id && !cache_key.distance_field;
+    if (!glyph && persistent) {
+        persistent_key.font_id = face->font_id;
+        persistent_key.glyph_index = cache_key.glyph_index;
+        persistent_key.pixel_width = cache_key.pixel_width;
+        persistent_key.pixel_height = cache_key.pixel_height;
+        persistent_key.stroke_width = cache_key.stroke_width;
+        persistent_key.stroke_mode = cache_key.stroke_mode;
+        persistent_key.hinting = cache_key.hinting;
+        glyph = persistent_glyph_cache_->Get(persistent_key);
+        if (glyph) {
+            glyph_cache_.Put(cache_key, glyph);
+        }
+    }
+    if (!glyph) {
+        auto result = cache_key.distance_field ?
+            RasterizeGlyphFromDistanceField(*face, face_id, glyph_index, char_width, char_height, stroke_width_px) :
+            RasterizeGlyph(*face, glyph_index, char_width, char_height, stroke_width_26_6);
+        if (result.is_err()) {
+            return Err(result.error());
+        }
+        glyph = std::move(result.value());
+        glyph_cache_.Put(cache_key, glyph);
+        if (persistent) {
+            persistent_glyph_cache_->Put(persistent_key, glyph);
+        }
+    }
 
-    int em_height = ascender + std::abs(descender);
+    int baseline = glyph->ascender;
+    int em_height = glyph->ascender + std::abs(glyph->descender);
     int em_adjust_y = (char_height - em_height) / 2;
+    int underline = glyph->underline_position;
+    int underline_thickness = glyph->underline_thickness;
+
+    RasterizedChar rasterized;
+    rasterized.glyph_key = cache_key;
+
+    // Underline if required
+    if ((style & kCharStyleUnderline) && underline_info && underline_thickness > 0) {
+        int underline_y = target_y + baseline + em_adjust_y + std::abs(underline);
+        Rect underline_rect(underline_info->start_x,
+                            underline_y,
+                            underline_info->start_x + underline_info->width,
+                            underline_y + 1);
+
+        int half_thickness = underline_thickness / 2;
+
+        if (underline_thickness % 2) {  // odd number
+            underline_rect.top -= half_thickness;
+            underline_rect.bottom += half_thickness;
+        } else {  // even number
+            underline_rect.top -= half_thickness - 1;
+            underline_rect.bottom += half_thickness;
+        }
+
+        rasterized.underline = underline_rect;
+    }
+
+    // Stroke border, if required
+    if (glyph->border) {
+        const GlyphMask& mask = glyph->border.value();
+        rasterized.border_x = target_x + mask.left;
+        rasterized.border_y = target_y + baseline + em_adjust_y - mask.top;
+    }
 
-    if (FT_Load_Glyph(face, glyph_index, FT_LOAD_NO_BITMAP)) {
+    // Filling
+    rasterized.fill_x = target_x + glyph->fill.left;
+    rasterized.fill_y = target_y + baseline + em_adjust_y - glyph->fill.top;
+
+    rasterized.glyph = std::move(glyph);
+    return Ok(std::move(rasterized));
+}
+
+void TextRendererFreetype::SetStrokeMode(StrokeMode mode) {
+    stroke_mode_ = mode;
+}
+
+void TextRendererFreetype::SetHinting(TextHinting hinting) {
+    hinting_ = hinting;
+}
+
+void TextRendererFreetype::SetDistanceFieldGlyphs(bool enable) {
+    distance_field_glyphs_ = enable;
+    if (!enable) {
+        distance_field_cache_.Clear();
+    }
+}
+
+void TextRendererFreetype::SetGlyphCacheLimit(size_t limit_bytes) {
+    glyph_cache_.SetLimit(limit_bytes);
+    distance_field_cache_.SetLimit(limit_bytes);
+}
+
+auto TextRendererFreetype::GetGlyphCacheStats() const -> GlyphCacheStats {
+    return glyph_cache_.GetStats();
+}
+
+void TextRendererFreetype::SetPersistentGlyphCache(std::shared_ptr<PersistentGlyphCache> cache) {
+    persistent_glyph_cache_ = std::move(cache);
+}
+
+void TextRendererFreetype::TrimMemory(bool release_faces) {
+    glyph_cache_.Clear();
+    distance_field_cache_.Clear();
+    run_rasterized_ = std::vector<RasterizedChar>();
+    run_underlines_ = std::vector<Rect>();
+
+    if (release_faces) {
+        // Faces shared through the registry are closed once the last renderer released them
+        main_face_.reset();
+        main_face_index_ = 0;
+        fallback_faces_.clear();
+        fallback_face_map_.clear();
+    } else {
+        // Faces are kept, their sizes are created again on demand
+        if (main_face_) {
+            ReleaseSizes(*main_face_);
+        }
+        for (FallbackFace& fallback : fallback_faces_) {
+            ReleaseSizes(*fallback.face);
+        }
+    }
+}
+
+void TextRendererFreetype::CopyWarmStateFrom(const TextRenderer& other) {
+    const auto& source = static_cast<const TextRendererFreetype&>(other);
+    if (&source == this || !source.library_) {
+        return;
+    }
+
+    // Faces belong to the library of source, adopt it along with them
+    if (library_ != source.library_) {
+        FT_Stroker stroker;
+        if (FT_Stroker_New(source.library_->library, &stroker)) {
+            log_->e("Freetype: FT_Stroker_New() failed");
+            return;
+        }
+        stroker_ = ScopedHolder<FT_Stroker>(stroker, FT_Stroker_Done);
+        library_ = source.library_;
+    }
+
+    // FreetypeFace is guarded by its own mutex, so the faces may be shared between renderers on different threads
+    font_family_ = source.font_family_;
+    main_face_ = source.main_face_;
+    main_face_index_ = source.main_face_index_;
+    fallback_faces_ = source.fallback_faces_;
+    fallback_face_map_ = source.fallback_face_map_;
+    main_face_id_ = source.main_face_id_;
+    next_face_id_ = source.next_face_id_;
+
+    // Cache keys refer to the face ids copied above
+    glyph_cache_.CopyFrom(source.glyph_cache_);
+    distance_field_cache_.CopyFrom(source.distance_field_cache_);
+}
+
+size_t TextRendererFreetype::GetFontFaceCount() const {
+    return (main_face_ ? 1 : 0) + fallback_faces_.size();
+}
+
+FT_UInt TextRendererFreetype::GetCharIndex(FreetypeFace& face, uint32_t ucs4) {
+    std::lock_guard<std::mutex> lock(face.mutex);
+    return FT_Get_Char_Index(face.face, ucs4);
+}
+
+auto TextRendererFreetype::RasterizeGlyph(FreetypeFace& shared_face, FT_UInt glyph_index, int char_width, int char_height,
+                                          FT_Fixed stroke_width) -> Result<std::shared_ptr<CachedGlyph>, TextRenderStatus> {
+    std::lock_guard<std::mutex> lock(shared_face.mutex);
+    FT_Face face = shared_face.face;
+
+    const FreetypeSize* size = ActivateSize(shared_face, char_width, char_height);
+    if (!size) {
+        return Err(TextRenderStatus::kOtherError);
+    }
+
+    auto glyph = std::make_shared<CachedGlyph>();
+    CopySizeMetrics(*size, *glyph);
+
+    FT_Int32 load_flags = FT_LOAD_NO_BITMAP;
+    FT_Render_Mode render_mode = FT_RENDER_MODE_NORMAL;
+    if (hinting_ == TextHinting::kLight) {
+        load_flags |= FT_LOAD_TARGET_LIGHT;
+        render_mode = FT_RENDER_MODE_LIGHT;
+    } else if (hinting_ == TextHinting::kNone) {
+        load_flags |= FT_LOAD_NO_HINTING;
+    }
+
+    if (FT_Load_Glyph(face, glyph_index, load_flags)) {
         log_->e("Freetype: FT_Load_Glyph failed");
-        return TextRenderStatus::kOtherError;
+        return Err(TextRenderStatus::kOtherError);
     }
 
     // Generate glyph bitmap for filling
     ScopedHolder<FT_Glyph> glyph_image(nullptr, FT_Done_Glyph);
     if (FT_Get_Glyph(face->glyph, &glyph_image)) {
         log_->e("Freetype: FT_Get_Glyph failed");
-        return TextRenderStatus::kOtherError;
+        return Err(TextRenderStatus::kOtherError);
     }
 
-    if (FT_Glyph_To_Bitmap(&glyph_image, FT_RENDER_MODE_NORMAL, nullptr, true)) {
+    if (FT_Glyph_To_Bitmap(&glyph_image, render_mode, nullptr, true)) {
         log_->e("Freetype: FT_Glyph_To_Bitmap failed");
-        return TextRenderStatus::kOtherError;
+        return Err(TextRenderStatus::kOtherError);
     }
 
-    ScopedHolder<FT_Glyph> border_glyph_image(nullptr, FT_Done_Glyph);
+    glyph->fill = FTBitmapGlyphToMask(reinterpret_cast<FT_BitmapGlyph>(glyph_image.Get()));
 
     // If we need stroke text (border)
-    if (style & CharStyle::kCharStyleStroke && stroke_width > 0.0f) {
+    if (stroke_width > 0 && stroke_mode_ == StrokeMode::kDilation) {
+        // Grow the fill coverage instead of stroking and rasterizing the outline a second time
+        glyph->border = DilateGlyphMask(glyph->fill, static_cast<float>(stroke_width) / 64.0f);
+    } else if (stroke_width > 0) {
         // Generate glyph bitmap for stroke border
         ScopedHolder<FT_Glyph> stroke_glyph(nullptr, FT_Done_Glyph);
         if (FT_Get_Glyph(face->glyph, &stroke_glyph)) {
             log_->e("Freetype: FT_Get_Glyph failed");
-            return TextRenderStatus::kOtherError;
+            return Err(TextRenderStatus::kOtherError);
         }
 
-        ScopedHolder<FT_Stroker> stroker(nullptr, FT_Stroker_Done);
-        FT_Stroker_New(library_, &stroker);
-        FT_Stroker_Set(stroker,
-                       static_cast<FT_Fixed>(stroke_width * 64),
+        FT_Stroker_Set(stroker_,
+                       stroke_width,
                        FT_STROKER_LINECAP_ROUND,
                        FT_STROKER_LINEJOIN_ROUND,
                        0);
 
-        FT_Glyph_StrokeBorder(&stroke_glyph, stroker, false, true);
+        FT_Glyph_StrokeBorder(&stroke_glyph, stroker_, false, true);
 
-        if (FT_Glyph_To_Bitmap(&stroke_glyph, FT_RENDER_MODE_NORMAL, nullptr, true)) {
+        if (FT_Glyph_To_Bitmap(&stroke_glyph, render_mode, nullptr, true)) {
             log_->e("Freetype: FT_Glyph_To_Bitmap failed");
-            return TextRenderStatus::kOtherError;
+            return Err(TextRenderStatus::kOtherError);
         }
 
-        border_glyph_image = std::move(stroke_glyph);
+        glyph->border = FTBitmapGlyphToMask(reinterpret_cast<FT_BitmapGlyph>(stroke_glyph.Get()));
     }
 
-    Canvas canvas(render_ctx.GetBitmap());
+    return Ok(std::move(glyph));
+}
 
-    // Draw Underline if required
-    if ((style & kCharStyleUnderline) && underline_info && underline_thickness > 0) {
-        int underline_y = target_y + baseline + em_adjust_y + std::abs(underline);
-        Rect underline_rect(underline_info->start_x,
-                            underline_y,
-                            underline_info->start_x + underline_info->width,
-                            underline_y + 1);
+auto TextRendererFreetype::RasterizeGlyphFromDistanceField(FreetypeFace& shared_face, uint32_t face_id,
+                                                           FT_UInt glyph_index, int char_width, int char_height,
+                                                           float stroke_width)
+                                                           -> Result<std::shared_ptr<CachedGlyph>, TextRenderStatus> {
+    // Fields are rasterized in the aspect ratio of the character, so that distances scale uniformly
+    int reference_height = kDistanceFieldReferenceSize;
+    int reference_width = std::max(1, static_cast<int>(std::lround(
+        static_cast<double>(reference_height) * char_width / char_height)));
+
+    GlyphCacheKey field_key;
+    field_key.face_id = face_id;
+    field_key.glyph_index = glyph_index;
+    field_key.pixel_width = reference_width;
+    field_key.pixel_height = reference_height;
+    field_key.distance_field = true;
+
+    auto glyph = std::make_shared<CachedGlyph>();
+    std::shared_ptr<const CachedGlyph> field = distance_field_cache_.Get(field_key);
+
+    {
+        std::lock_guard<std::mutex> lock(shared_face.mutex);
+        FT_Face face = shared_face.face;
+
+        if (!field) {
+            if (!ActivateSize(shared_face, reference_width, reference_height)) {
+                return Err(TextRenderStatus::kOtherError);
+            }
 
-        int half_thickness = underline_thickness / 2;
+            // Hinting is meaningless for a field resampled into other sizes
+            if (FT_Load_Glyph(face, glyph_index, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING)) {
+                log_->e("Freetype: FT_Load_Glyph failed");
+                return Err(TextRenderStatus::kOtherError);
+            }
 
-        if (underline_thickness % 2) {  // odd number
-            underline_rect.top -= half_thickness;
-            underline_rect.bottom += half_thickness;
-        } else {  // even number
-            underline_rect.top -= half_thickness - 1;
-            underline_rect.bottom += half_thickness;
+            ScopedHolder<FT_Glyph> glyph_image(nullptr, FT_Done_Glyph);
+            if (FT_Get_Glyph(face->glyph, &glyph_image)) {
+                log_->e("Freetype: FT_Get_Glyph failed");
+                return Err(TextRenderStatus::kOtherError);
+            }
+
+            if (FT_Glyph_To_Bitmap(&glyph_image, FT_RENDER_MODE_NORMAL, nullptr, true)) {
+                log_->e("Freetype: FT_Glyph_To_Bitmap failed");
+                return Err(TextRenderStatus::kOtherError);
+            }
+
+            auto new_field = std::make_shared<CachedGlyph>();
+            new_field->fill =
+                ComputeDistanceField(FTBitmapGlyphToMask(reinterpret_cast<FT_BitmapGlyph>(glyph_image.Get())));
+            distance_field_cache_.Put(field_key, new_field);
+            field = std::move(new_field);
         }
 
-        canvas.DrawRect(color, underline_rect);
+        // Size metrics are still taken from the face at the target size, no outline is loaded
+        const FreetypeSize* size = ActivateSize(shared_face, char_width, char_height);
+        if (!size) {
+            return Err(TextRenderStatus::kOtherError);
+        }
+        CopySizeMetrics(*size, *glyph);
     }
 
-    // Draw stroke border bitmap, if required
-    if (border_glyph_image) {
-        auto border_bitmap_glyph = reinterpret_cast<FT_BitmapGlyph>(border_glyph_image.Get());
-        int start_x = target_x + border_bitmap_glyph->left;
-        int start_y = target_y + baseline + em_adjust_y - border_bitmap_glyph->top;
+    float scale_x = static_cast<float>(char_width) / static_cast<float>(reference_width);
+    float scale_y = static_cast<float>(char_height) / static_cast<float>(reference_height);
+    glyph->fill = ResampleDistanceField(field->fill, scale_x, scale_y, 0.0f);
+    if (stroke_width > 0.0f) {
+        glyph->border = ResampleDistanceField(field->fill, scale_x, scale_y, stroke_width);
+    }
 
-        Bitmap bmp = FTBitmapToColoredBitmap(border_bitmap_glyph->bitmap, stroke_color);
-        canvas.DrawBitmap(bmp, start_x, start_y);
+    return Ok(std::move(glyph));
+}
+
+// face.mutex must be held, the returned size is valid until the next call on the face
+auto TextRendererFreetype::ActivateSize(FreetypeFace& shared_face, int char_width, int char_height)
+        -> const FreetypeSize* {
+    FT_Face face = shared_face.face;
+    std::vector<FreetypeSize>& sizes = shared_face.sizes;
+
+    for (size_t i = sizes.size(); i-- > 0;) {
+        if (sizes[i].pixel_width == char_width && sizes[i].pixel_height == char_height) {
+            std::rotate(sizes.begin() + static_cast<ptrdiff_t>(i),
+                        sizes.begin() + static_cast<ptrdiff_t>(i) + 1, sizes.end());
+            FreetypeSize& cached = sizes.back();
+            if (face->size != cached.size && FT_Activate_Size(cached.size)) {
+                log_->e("Freetype: FT_Activate_Size failed");
+                return nullptr;
+            }
+            return &cached;
+        }
     }
 
-    // Draw filling bitmap
-    if (glyph_image) {
-        auto bitmap_glyph = reinterpret_cast<FT_BitmapGlyph>(glyph_image.Get());
-        int start_x = target_x + bitmap_glyph->left;
-        int start_y = target_y + baseline + em_adjust_y - bitmap_glyph->top;
+    if (sizes.size() >= kMaxFaceSizes) {
+        FT_Done_Size(sizes.front().size);
+        sizes.erase(sizes.begin());
+    }
 
-        Bitmap bmp = FTBitmapToColoredBitmap(bitmap_glyph->bitmap, color);
-        canvas.DrawBitmap(bmp, start_x, start_y);
+    FT_Size ft_size = nullptr;
+    if (FT_New_Size(face, &ft_size)) {
+        log_->e("Freetype: FT_New_Size failed");
+        return nullptr;
+    }
+    if (FT_Activate_Size(ft_size) ||
+            FT_Set_Pixel_Sizes(face, static_cast<FT_UInt>(char_width), static_cast<FT_UInt>(char_height))) {
+        log_->e("Freetype: FT_Set_Pixel_Sizes failed");
+        FT_Done_Size(ft_size);
+        return nullptr;
     }
 
-    return TextRenderStatus::kOK;
+    FreetypeSize& size = sizes.emplace_back();
+    size.pixel_width = char_width;
+    size.pixel_height = char_height;
+    size.size = ft_size;
+    size.ascender = static_cast<int>(ft_size->metrics.ascender >> 6);
+    size.descender = static_cast<int>(ft_size->metrics.descender >> 6);
+    size.underline_position = static_cast<int>(FT_MulFix(face->underline_position, ft_size->metrics.x_scale) >> 6);
+    size.underline_thickness = static_cast<int>(FT_MulFix(face->underline_thickness, ft_size->metrics.x_scale) >> 6);
+    return &size;
 }
 
-Bitmap TextRendererFreetype::FTBitmapToColoredBitmap(const FT_Bitmap& ft_bmp, ColorRGBA color) {
-    Bitmap bitmap(static_cast<int>(ft_bmp.width), static_cast<int>(ft_bmp.rows), PixelFormat::kRGBA8888);
+void TextRendererFreetype::ReleaseSizes(FreetypeFace& face) {
+    std::lock_guard<std::mutex> lock(face.mutex);
+    for (FreetypeSize& size : face.sizes) {
+        FT_Done_Size(size.size);
+    }
+    face.sizes.clear();
+}
 
-    for (uint32_t y = 0; y < ft_bmp.rows; y++) {
-        uint32_t src_index = y * ft_bmp.pitch;
-        const uint8_t* src = &ft_bmp.buffer[src_index];
-        ColorRGBA* dest = bitmap.GetPixelAt(0, static_cast<int>(y));
+void TextRendererFreetype::CopySizeMetrics(const FreetypeSize& size, CachedGlyph& glyph) {
+    glyph.ascender = size.ascender;
+    glyph.descender = size.descender;
+    glyph.underline_position = size.underline_position;
+    glyph.underline_thickness = size.underline_thickness;
+}
+
+GlyphMask TextRendererFreetype::FTBitmapGlyphToMask(FT_BitmapGlyph bitmap_glyph) {
+    const FT_Bitmap& ft_bmp = bitmap_glyph->bitmap;
 
-        alphablend::FillLineWithAlphas(dest, src, color, ft_bmp.width);
+    GlyphMask mask;
+    mask.left = bitmap_glyph->left;
+    mask.top = bitmap_glyph->top;
+    mask.width = static_cast<int>(ft_bmp.width);
+    mask.height = static_cast<int>(ft_bmp.rows);
+    mask.coverage.resize(static_cast<size_t>(ft_bmp.width) * ft_bmp.rows);
+
+    for (uint32_t y = 0; y < ft_bmp.rows; y++) {
+        const uint8_t* src = &ft_bmp.buffer[y * ft_bmp.pitch];
+        memcpy(&mask.coverage[y * ft_bmp.width], src, ft_bmp.width);
     }
 
-    return bitmap;
+    return mask;
 }
 
 static bool MatchFontFamilyName(FT_Face face, const std::string& family_name) {
@@ -294,10 +701,114 @@ static bool MatchFontFamilyName(FT_Face face, const std::string& family_name) {
     return false;
 }
 
-auto TextRendererFreetype::LoadFontFace(bool is_fallback,
-                                        std::optional<uint32_t> codepoint,
-                                        std::optional<size_t> begin_index)
-        -> Result<std::pair<FT_Face, size_t>, FontProviderError> {
+auto TextRendererFreetype::FindFallbackFace(uint32_t ucs4) -> Result<std::pair<FreetypeFace*, uint32_t>, TextRenderStatus> {
+    // Resolved before, whether found or not
+    auto iter = fallback_face_map_.find(ucs4);
+    if (iter != fallback_face_map_.end()) {
+        if (iter->second == kNoFallbackFace) {
+            return Err(TextRenderStatus::kCodePointNotFound);
+        }
+        FallbackFace& fallback = fallback_faces_[static_cast<size_t>(iter->second)];
+        return Ok(std::make_pair(fallback.face.get(), fallback.face_id));
+    }
+
+    log_->w("Freetype: Main font %s doesn't contain U+%04X", main_face_->face->family_name, ucs4);
+
+    // Check fallback faces loaded for other codepoints first
+    for (size_t i = 0; i < fallback_faces_.size(); i++) {
+        if (GetCharIndex(*fallback_faces_[i].face, ucs4)) {
+            fallback_face_map_[ucs4] = static_cast<int32_t>(i);
+            return Ok(std::make_pair(fallback_faces_[i].face.get(), fallback_faces_[i].face_id));
+        }
+    }
+
+    if (main_face_index_ + 1 >= font_family_.size()) {
+        // Fallback fonts not available
+        fallback_face_map_[ucs4] = kNoFallbackFace;
+        return Err(TextRenderStatus::kCodePointNotFound);
+    }
+
+    // Resolved in a previous run, which saves querying the font provider
+    std::shared_ptr<FreetypeFace> face = LoadPersistentFallbackFace(ucs4);
+
+    if (!face) {
+        // Load next fallback font face by specific codepoint
+        auto result = LoadFontFace(ucs4, main_face_index_ + 1);
+        if (result.is_err()) {
+            log_->e("Freetype: Cannot find available fallback font for U+%04X", ucs4);
+            if (result.error() == FontProviderError::kFontNotFound ||
+                result.error() == FontProviderError::kCodePointNotFound) {
+                fallback_face_map_[ucs4] = kNoFallbackFace;
+            }
+            return Err(FontProviderErrorToStatus(result.error()));
+        }
+        face = std::move(result.value().first);
+
+        if (GetCharIndex(*face, ucs4) == 0) {
+            log_->e("Freetype: Got glyph_index == 0 for U+%04X in fallback font", ucs4);
+            fallback_face_map_[ucs4] = kNoFallbackFace;
+            return Err(TextRenderStatus::kCodePointNotFound);
+        }
+
+        if (persistent_glyph_cache_ && face->font_id && !face->filename.empty()) {
+            PersistentFallbackFont font;
+            font.filename = face->filename;
+            font.family_name = face->family_name;
+            font.postscript_name = face->postscript_name;
+            font.face_index = static_cast<int>(face->face->face_index);
+            font.font_id = face->font_id;
+            persistent_glyph_cache_->PutFallback(HashFallbackFamily(), ucs4, std::move(font));
+        }
+    }
+
+    if (fallback_faces_.size() >= kMaxFallbackFaces) {
+        // Too many fallback fonts, start over
+        fallback_faces_.clear();
+        fallback_face_map_.clear();
+    }
+
+    FallbackFace& fallback = fallback_faces_.emplace_back(FallbackFace{std::move(face), next_face_id_++});
+    fallback_face_map_[ucs4] = static_cast<int32_t>(fallback_faces_.size() - 1);
+
+    return Ok(std::make_pair(fallback.face.get(), fallback.face_id));
+}
+
+auto TextRendererFreetype::LoadPersistentFallbackFace(uint32_t ucs4) -> std::shared_ptr<FreetypeFace> {
+    if (!persistent_glyph_cache_ || !main_face_->font_id) {
+        return nullptr;
+    }
+    std::optional<PersistentFallbackFont> font = persistent_glyph_cache_->GetFallback(HashFallbackFamily(), ucs4);
+    if (!font) {
+        return nullptr;
+    }
+
+    FontfaceInfo info;
+    info.filename = std::move(font->filename);
+    info.family_name = std::move(font->family_name);
+    info.postscript_name = std::move(font->postscript_name);
+    info.face_index = font->face_index;
+    info.provider_type = font_provider_.GetType();
+
+    // The font file may have been updated or removed since
+    auto result = AcquireFontFace(info);
+    if (result.is_err() || result.value()->font_id != font->font_id || !GetCharIndex(*result.value(), ucs4)) {
+        return nullptr;
+    }
+    return std::move(result.value());
+}
+
+uint64_t TextRendererFreetype::HashFallbackFamily() const {
+    // Fallback resolutions depend on the remaining font family after the main face
+    uint64_t hash = main_face_->font_id;
+    for (size_t i = main_face_index_ + 1; i < font_family_.size(); i++) {
+        const std::string& name = font_family_[i];
+        hash = xxhash::Hash64(reinterpret_cast<const uint8_t*>(name.data()), name.size(), hash);
+    }
+    return hash;
+}
+
+auto TextRendererFreetype::LoadFontFace(std::optional<uint32_t> codepoint, std::optional<size_t> begin_index)
+        -> Result<std::pair<std::shared_ptr<FreetypeFace>, size_t>, FontProviderError> {
     if (begin_index && begin_index.value() >= font_family_.size()) {
         return Err(FontProviderError::kFontNotFound);
     }
@@ -305,54 +816,104 @@ auto TextRendererFreetype::LoadFontFace(bool is_fallback,
     // begin_index is optional
     size_t font_index = begin_index.value_or(0);
 
+    ARIBCC_TRACE_SCOPE(tracer_.get(), "renderer", "FontProvider::GetFontFace");
     const std::string& font_name = font_family_[font_index];
     auto result = font_provider_.GetFontFace(font_name, codepoint);
+    metrics_->Add(MetricCounter::kFontLookups);
 
     while (result.is_err() && font_index + 1 < font_family_.size()) {
         // Find next suitable font
         font_index++;
         result = font_provider_.GetFontFace(font_family_[font_index], codepoint);
+        metrics_->Add(MetricCounter::kFontLookups);
     }
     if (result.is_err()) {
         // Not found, return Err Result
         return Err(result.error());
     }
 
-    FontfaceInfo& info = result.value();
+    auto face_result = AcquireFontFace(result.value());
+    if (face_result.is_err()) {
+        return Err(face_result.error());
+    }
+    return Ok(std::make_pair(std::move(face_result.value()), font_index));
+}
+
+auto TextRendererFreetype::AcquireFontFace(FontfaceInfo& info) -> Result<std::shared_ptr<FreetypeFace>, FontProviderError> {
+    if (!shared_registry_) {
+        return OpenFontFace(info);
+    }
 
-    bool use_memory_data = false;
-    std::vector<uint8_t>* memory_data = nullptr;
-    if (!info.font_data.empty()) {
-        use_memory_data = true;
-        if (!is_fallback) {
-            main_face_.Reset();
-            main_face_data_ = std::move(info.font_data);
-            memory_data = &main_face_data_;
-        } else {  // is_fallback
-            fallback_face_.Reset();
-            fallback_face_data_ = std::move(info.font_data);
-            memory_data = &fallback_face_data_;
-        }
+    // Identify the font by its source, faces loaded from memory are identified by names and data size
+    std::string key = !info.font_data ? "freetype:file:" + info.filename
+                                      : "freetype:memory:" + std::to_string(info.font_data->size());
+    key += ":" + std::to_string(info.face_index) + ":" + info.postscript_name + ":" + info.family_name;
+
+    FontProviderError error = FontProviderError::kOtherError;
+    std::shared_ptr<FreetypeFace> face =
+        shared_registry_->GetOrCreate<FreetypeFace>(key, [&]() -> std::shared_ptr<FreetypeFace> {
+            auto face_result = OpenFontFace(info);
+            if (face_result.is_err()) {
+                error = face_result.error();
+                return nullptr;
+            }
+            return std::move(face_result.value());
+        });
+    if (!face) {
+        return Err(error);
     }
 
-    FT_Face face = nullptr;
-    if (!use_memory_data) {
-        if (FT_New_Face(library_, info.filename.c_str(), info.face_index, &face)) {
-            return Err(FontProviderError::kFontNotFound);
+    if (info.font_data && face->data != info.font_data && (!face->data || *face->data != *info.font_data)) {
+        // Different font data under the same names, don't share
+        auto face_result = OpenFontFace(info);
+        if (face_result.is_err()) {
+            return Err(face_result.error());
         }
-    } else {  // use_memory_data
-        if (FT_New_Memory_Face(library_,
-                               memory_data->data(),
-                               static_cast<FT_Long>(memory_data->size()),
-                               info.face_index,
-                               &face)) {
-            return Err(FontProviderError::kFontNotFound);
+        face = std::move(face_result.value());
+    }
+
+    return Ok(std::move(face));
+}
+
+auto TextRendererFreetype::OpenFontFace(FontfaceInfo& info) -> Result<std::shared_ptr<FreetypeFace>, FontProviderError> {
+    auto shared_face = std::make_shared<FreetypeFace>();
+    shared_face->library = library_;
+    shared_face->data = std::move(info.font_data);
+
+    // Map font files rather than letting FreeType open them, so font tables are read straight from the mapping,
+    // whose pages are shared by every face of the same file. Fall back to FT_New_Face() if mapping failed.
+    const uint8_t* memory_data = shared_face->data ? shared_face->data->data() : nullptr;
+    size_t memory_size = shared_face->data ? shared_face->data->size() : 0;
+    if (!memory_size && shared_face->mapped_file.Open(info.filename)) {
+        memory_data = shared_face->mapped_file.data();
+        memory_size = shared_face->mapped_file.size();
+    }
+    bool use_memory_data = memory_size > 0;
+    FT_Library library = library_->library;
+
+    std::lock_guard<std::mutex> lock(library_->mutex);
+
+    auto open_face = [&](FT_Long face_index) -> FT_Face {
+        FT_Face face = nullptr;
+        FT_Error error = 0;
+        if (!use_memory_data) {
+            error = FT_New_Face(library, info.filename.c_str(), face_index, &face);
+        } else {  // use_memory_data
+            error = FT_New_Memory_Face(library,
+                                       memory_data,
+                                       static_cast<FT_Long>(memory_size),
+                                       face_index,
+                                       &face);
         }
+        return error ? nullptr : face;
+    };
+
+    ScopedHolder<FT_Face> face(open_face(info.face_index), FT_Done_Face);
+    if (!face) {
+        return Err(FontProviderError::kFontNotFound);
     }
 
-    if (info.face_index >= 0) {
-        return Ok(std::make_pair(face, font_index));
-    } else {
+    if (info.face_index < 0) {
         // face_index is negative, e.g. -1, means face index is unknown
         // Find exact font face by PostScript name or Family name
         if (info.family_name.empty() && info.postscript_name.empty()) {
@@ -360,33 +921,43 @@ auto TextRendererFreetype::LoadFontFace(bool is_fallback,
             return Err(FontProviderError::kOtherError);
         }
 
-        for (FT_Long i = 0; i < face->num_faces; i++) {
-            FT_Done_Face(face);
-
-            if (!use_memory_data) {
-                if (FT_New_Face(library_, info.filename.c_str(), i, &face)) {
-                    return Err(FontProviderError::kFontNotFound);
-                }
-            } else {  // use_memory_data
-                if (FT_New_Memory_Face(library_,
-                                       memory_data->data(),
-                                       static_cast<FT_Long>(memory_data->size()),
-                                       i,
-                                       &face)) {
-                    return Err(FontProviderError::kFontNotFound);
-                }
+        FT_Long num_faces = face->num_faces;
+        bool found = false;
+        for (FT_Long i = 0; i < num_faces && !found; i++) {
+            face = open_face(i);
+            if (!face) {
+                return Err(FontProviderError::kFontNotFound);
             }
 
             // Find by comparing PostScript name
             if (!info.postscript_name.empty() && info.postscript_name == FT_Get_Postscript_Name(face)) {
-                return Ok(std::make_pair(face, font_index));
+                found = true;
             } else if (!info.family_name.empty() && MatchFontFamilyName(face, info.family_name)) {
                 // Find by matching family name
-                return Ok(std::make_pair(face, font_index));
+                found = true;
             }
         }
-        return Err(FontProviderError::kFontNotFound);
+        if (!found) {
+            return Err(FontProviderError::kFontNotFound);
+        }
     }
+
+    shared_face->filename = info.filename;
+    shared_face->family_name = info.family_name;
+    shared_face->postscript_name = info.postscript_name;
+    if (use_memory_data) {
+        // Identified by size and both ends of the data, as hashing whole font files would slow down opening
+        constexpr size_t kHashBytes = 64 * 1024;
+        size_t hash_bytes = std::min(memory_size, kHashBytes);
+        uint64_t seed = (static_cast<uint64_t>(FREETYPE_MAJOR) << 48) | (static_cast<uint64_t>(FREETYPE_MINOR) << 32) |
+                        (static_cast<uint64_t>(FREETYPE_PATCH) << 16) | static_cast<uint64_t>(face->face_index);
+        uint64_t font_id = xxhash::Hash64(memory_data, hash_bytes, seed ^ memory_size);
+        font_id = xxhash::Hash64(memory_data + memory_size - hash_bytes, hash_bytes, font_id);
+        shared_face->font_id = font_id ? font_id : 1;
+    }
+
+    shared_face->face = std::move(face);  // Released in ~FreetypeFace(), with library locked
+    return Ok(std::move(shared_face));
 }
 
 }  // namespace aribcaption
@@ -21,18 +21,28 @@
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_GLYPH_H
+#include FT_STROKER_H
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include <optional>
 #include <utility>
 #include "aribcaption/caption.hpp"
 #include "aribcaption/color.hpp"
 #include "aribcaption/context.hpp"
 #include "base/logger.hpp"
+#include "base/mapped_file.hpp"
+#include "base/metrics.hpp"
 #include "base/result.hpp"
 #include "base/scoped_holder.hpp"
+#include "base/shared_registry.hpp"
+#include "base/tracer.hpp"
 #include "renderer/bitmap.hpp"
 #include "renderer/font_provider.hpp"
+#include "renderer/glyph_cache.hpp"
 #include "renderer/text_renderer.hpp"
 
 namespace aribcaption {
@@ -52,24 +62,139 @@ public:
                   float stroke_width, int char_width, int char_height,
                   std::optional<UnderlineInfo> underline_info,
                   TextRenderFallbackPolicy fallback_policy) -> TextRenderStatus override;
+    void DrawRun(TextRenderContext& render_ctx, const std::vector<TextRunChar>& chars,
+                 CharStyle style, ColorRGBA color, ColorRGBA stroke_color,
+                 float stroke_width, int char_width, int char_height,
+                 TextRenderFallbackPolicy fallback_policy,
+                 std::vector<TextRenderStatus>& out_statuses) override;
+    auto RasterizeChar(int x, int y, uint32_t ucs4, CharStyle style, float stroke_width,
+                       int char_width, int char_height,
+                       std::optional<UnderlineInfo> underline_info,
+                       TextRenderFallbackPolicy fallback_policy) -> Result<RasterizedChar, TextRenderStatus> override;
+    void SetStrokeMode(StrokeMode mode) override;
+    void SetDistanceFieldGlyphs(bool enable) override;
+    void SetHinting(TextHinting hinting) override;
+    void SetGlyphCacheLimit(size_t limit_bytes) override;
+    auto GetGlyphCacheStats() const -> GlyphCacheStats override;
+    void SetPersistentGlyphCache(std::shared_ptr<PersistentGlyphCache> cache) override;
+    void TrimMemory(bool release_faces) override;
+    [[nodiscard]]
+    size_t GetFontFaceCount() const override;
+    [[nodiscard]]
+    uint64_t GetFirstFontLoadMicroseconds() const override { return first_font_load_us_; }
+    void CopyWarmStateFrom(const TextRenderer& other) override;
 private:
-    static Bitmap FTBitmapToColoredBitmap(const FT_Bitmap& ft_bmp, ColorRGBA color);
-    auto LoadFontFace(bool is_fallback,
-                      std::optional<uint32_t> codepoint = std::nullopt,
+    // FT_Library, shared between renderers if Context::SetShareFontFaces() is enabled
+    struct FreetypeLibrary {
+        ScopedHolder<FT_Library> library;
+        std::mutex mutex;  // Guards FT_New_Face / FT_Done_Face, which are not thread-safe on a shared library
+    };
+
+    // FT_Size of a face at a pixel size, along with the size metrics derived from it
+    struct FreetypeSize {
+        int pixel_width = 0;
+        int pixel_height = 0;
+        FT_Size size = nullptr;     // Owned by the face, released by FT_Done_Face() at the latest
+
+        // In pixels
+        int ascender = 0;
+        int descender = 0;
+        int underline_position = 0;
+        int underline_thickness = 0;
+    };
+
+    // FT_Face along with its backing memory, shared between renderers if Context::SetShareFontFaces() is enabled
+    struct FreetypeFace {
+        std::shared_ptr<FreetypeLibrary> library;
+        std::shared_ptr<const std::vector<uint8_t>> data;  // Backing memory of face if loaded from memory, must outlive face
+        MappedFile mapped_file;     // Backing memory of face if loaded from file, must outlive face
+        ScopedHolder<FT_Face> face;
+        std::mutex mutex;           // FT_Face is not thread-safe, guards any access to face
+
+        // Sizes activated by ActivateSize(), most recently used last. Switching between cached sizes
+        // saves recomputing scaled metrics and running the TrueType prep program again
+        std::vector<FreetypeSize> sizes;
+
+        // Source of the face for persisting fallback resolutions, filename is empty if loaded from memory
+        std::string filename;
+        std::string family_name;
+        std::string postscript_name;
+        uint64_t font_id = 0;       // Identity of font data and FreeType version across processes, 0 if unknown
+
+        FreetypeFace() = default;
+        ~FreetypeFace();
+        FreetypeFace(const FreetypeFace&) = delete;
+        FreetypeFace& operator=(const FreetypeFace&) = delete;
+    };
+private:
+    static FT_UInt GetCharIndex(FreetypeFace& face, uint32_t ucs4);
+    auto RasterizeGlyph(FreetypeFace& face, FT_UInt glyph_index, int char_width, int char_height, FT_Fixed stroke_width)
+        -> Result<std::shared_ptr<CachedGlyph>, TextRenderStatus>;
+    auto RasterizeGlyphFromDistanceField(FreetypeFace& face, uint32_t face_id, FT_UInt glyph_index,
+                                         int char_width, int char_height, float stroke_width)
+        -> Result<std::shared_ptr<CachedGlyph>, TextRenderStatus>;
+    auto ActivateSize(FreetypeFace& face, int char_width, int char_height) -> const FreetypeSize*;
+    static void ReleaseSizes(FreetypeFace& face);
+    static void CopySizeMetrics(const FreetypeSize& size, CachedGlyph& glyph);
+    static GlyphMask FTBitmapGlyphToMask(FT_BitmapGlyph bitmap_glyph);
+    auto FindFallbackFace(uint32_t ucs4) -> Result<std::pair<FreetypeFace*, uint32_t>, TextRenderStatus>;
+    auto LoadPersistentFallbackFace(uint32_t ucs4) -> std::shared_ptr<FreetypeFace>;
+    [[nodiscard]]
+    uint64_t HashFallbackFamily() const;
+    auto LoadFontFace(std::optional<uint32_t> codepoint = std::nullopt,
                       std::optional<size_t> begin_index = std::nullopt)
-        -> Result<std::pair<FT_Face, size_t>, FontProviderError>;  // Result<Pair<face, font_index>, error>
+        -> Result<std::pair<std::shared_ptr<FreetypeFace>, size_t>, FontProviderError>;  // Result<Pair<face, font_index>, error>
+    auto AcquireFontFace(FontfaceInfo& info) -> Result<std::shared_ptr<FreetypeFace>, FontProviderError>;
+    auto OpenFontFace(FontfaceInfo& info) -> Result<std::shared_ptr<FreetypeFace>, FontProviderError>;
 private:
     std::shared_ptr<Logger> log_;
+    std::shared_ptr<Metrics> metrics_;
+    std::shared_ptr<Tracer> tracer_;
 
     FontProvider& font_provider_;
     std::vector<std::string> font_family_;
 
-    ScopedHolder<FT_Library> library_;
-    ScopedHolder<FT_Face> main_face_;
-    ScopedHolder<FT_Face> fallback_face_;
-    std::vector<uint8_t> main_face_data_;
-    std::vector<uint8_t> fallback_face_data_;
+    std::shared_ptr<SharedRegistry> shared_registry_;  // nullptr if font sharing is disabled
+    std::shared_ptr<FreetypeLibrary> library_;
+    ScopedHolder<FT_Stroker> stroker_;  // Reused across glyphs, must be released before library_
+    std::shared_ptr<FreetypeFace> main_face_;
     size_t main_face_index_ = 0;
+
+    struct FallbackFace {
+        std::shared_ptr<FreetypeFace> face;
+        uint32_t face_id = 0;
+    };
+    // Fallback faces loaded so far, kept until font family changes
+    std::vector<FallbackFace> fallback_faces_;
+    // Codepoint => index into fallback_faces_, or kNoFallbackFace if no fallback font contains the codepoint
+    static constexpr int32_t kNoFallbackFace = -1;
+    static constexpr size_t kMaxFallbackFaces = 16;
+    std::unordered_map<uint32_t, int32_t> fallback_face_map_;
+
+    // Upper limit of FreetypeFace::sizes, ruby and normal characters of a few magnifications fit within
+    static constexpr size_t kMaxFaceSizes = 8;
+
+    // Faces are identified by a serial number rather than FT_Face address, which may be reused after free
+    uint32_t main_face_id_ = 0;
+    uint32_t next_face_id_ = 1;
+    uint64_t first_font_load_us_ = 0;
+
+    StrokeMode stroke_mode_ = StrokeMode::kOutline;
+    TextHinting hinting_ = TextHinting::kDefault;
+    GlyphCache glyph_cache_;
+
+    // Reference size for rasterizing distance fields, in pixels of character height
+    static constexpr int kDistanceFieldReferenceSize = 64;
+    bool distance_field_glyphs_ = false;
+    // Distance fields of glyphs keyed by reference size, see RasterizeGlyphFromDistanceField()
+    GlyphCache distance_field_cache_;
+
+    // Glyphs and fallback resolutions persisted across runs, nullptr if not enabled
+    std::shared_ptr<PersistentGlyphCache> persistent_glyph_cache_;
+
+    // Scratch buffers of DrawRun(), kept for reusing capacity
+    std::vector<RasterizedChar> run_rasterized_;
+    std::vector<Rect> run_underlines_;
 };
 
 }  // namespace aribcaption
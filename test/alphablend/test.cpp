@@ -18,13 +18,450 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <vector>
+#include "base/cpu_features.hpp"
+#include "renderer/alphablend.hpp"
 #include "renderer/bitmap.hpp"
 #include "renderer/canvas.hpp"
 #include "stopwatch.hpp"
 
 using namespace aribcaption;
 
+namespace {
+
+using FillLineFunc = void(*)(ColorRGBA* __restrict, ColorRGBA, size_t);
+using FillLineWithAlphasFunc = void(*)(ColorRGBA* __restrict, const uint8_t* __restrict, ColorRGBA, size_t);
+using BlendColorToLineFunc = void(*)(ColorRGBA* __restrict, ColorRGBA, size_t);
+using BlendColorWithAlphasToLineFunc = void(*)(ColorRGBA* __restrict, const uint8_t* __restrict, ColorRGBA, size_t);
+using BlendLineFunc = void(*)(ColorRGBA* __restrict, const ColorRGBA* __restrict, size_t);
+
+struct Kernels {
+    const char* name;
+    FillLineFunc fill_line;
+    FillLineWithAlphasFunc fill_line_with_alphas;
+    BlendColorToLineFunc blend_color_to_line;
+    BlendColorWithAlphasToLineFunc blend_color_with_alphas_to_line;
+    BlendLineFunc blend_line;
+    BlendLineFunc blend_line_premultiplied_src;
+};
+
+// Scalar model of the SIMD kernels: every product is truncated separately before the saturating add
+uint8_t MulHi(uint32_t x, uint32_t y) {
+    return static_cast<uint8_t>((x * y) >> 8);
+}
+
+uint8_t AddSat(uint32_t x, uint32_t y) {
+    return alphablend::Clamp255(x + y);
+}
+
+ColorRGBA ReferenceBlend(ColorRGBA dst, ColorRGBA src) {
+    uint32_t ff_minus_a = 255 - src.a;
+    return ColorRGBA(AddSat(MulHi(src.r, src.a), MulHi(dst.r, ff_minus_a)),
+                     AddSat(MulHi(src.g, src.a), MulHi(dst.g, ff_minus_a)),
+                     AddSat(MulHi(src.b, src.a), MulHi(dst.b, ff_minus_a)),
+                     AddSat(MulHi(255, src.a), MulHi(dst.a, ff_minus_a)));
+}
+
+ColorRGBA ReferenceBlend_PremultipliedSrc(ColorRGBA dst, ColorRGBA src) {
+    uint32_t ff_minus_a = 255 - src.a;
+    return ColorRGBA(AddSat(src.r, MulHi(dst.r, ff_minus_a)),
+                     AddSat(src.g, MulHi(dst.g, ff_minus_a)),
+                     AddSat(src.b, MulHi(dst.b, ff_minus_a)),
+                     AddSat(src.a, MulHi(dst.a, ff_minus_a)));
+}
+
+uint32_t NextRandom(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+bool CheckLine(const char* kernel, const char* func, const ColorRGBA* result,
+               const ColorRGBA* expected, size_t width, size_t offset) {
+    for (size_t i = 0; i < width; i++) {
+        if (result[i].u32 != expected[i].u32) {
+            fprintf(stderr, "%s::%s mismatch: width = %zu, offset = %zu, index = %zu, "
+                            "result = 0x%08X, expected = 0x%08X\n",
+                    kernel, func, width, offset, i, result[i].u32, expected[i].u32);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TestKernels(const Kernels& kernels) {
+    constexpr size_t kMaxWidth = 80;
+    constexpr size_t kMaxOffset = 4;
+    constexpr size_t kGuard = 8;
+    const ColorRGBA guard_color(0x5A, 0xA5, 0x5A, 0xA5);
+
+    uint32_t seed = 0x12345678;
+    bool ok = true;
+
+    std::vector<size_t> widths;
+    for (size_t width = 0; width <= kMaxWidth; width++) {
+        widths.push_back(width);
+    }
+    widths.push_back(1920);
+
+    for (size_t width : widths) {
+        for (size_t offset = 0; offset < kMaxOffset; offset++) {
+            std::vector<ColorRGBA> dst_line(offset + width + kGuard, guard_color);
+            std::vector<ColorRGBA> src_line(offset + width);
+            std::vector<uint8_t> alphas(offset + width);
+            for (size_t i = 0; i < offset + width; i++) {
+                src_line[i].u32 = NextRandom(seed);
+                alphas[i] = static_cast<uint8_t>(NextRandom(seed));
+            }
+            // Cover the fully transparent / opaque edge cases too
+            if (width > 2) {
+                src_line[offset].a = 0;
+                src_line[offset + 1].a = 255;
+            }
+
+            std::vector<ColorRGBA> initial(offset + width + kGuard, guard_color);
+            for (size_t i = offset; i < offset + width; i++) {
+                initial[i].u32 = NextRandom(seed);
+            }
+
+            ColorRGBA color(NextRandom(seed));
+            std::vector<ColorRGBA> expected(initial);
+            ColorRGBA* dest = dst_line.data() + offset;
+            const ColorRGBA* src = src_line.data() + offset;
+
+            // FillLine
+            dst_line = initial;
+            for (size_t i = offset; i < offset + width; i++) {
+                expected[i] = color;
+            }
+            kernels.fill_line(dest, color, width);
+            ok &= CheckLine(kernels.name, "FillLine", dst_line.data(), expected.data(), dst_line.size(), offset);
+
+            // FillLineWithAlphas
+            dst_line = initial;
+            for (size_t i = offset; i < offset + width; i++) {
+                expected[i] = ColorRGBA(color, MulHi(alphas[i], color.a));
+            }
+            kernels.fill_line_with_alphas(dest, alphas.data() + offset, color, width);
+            ok &= CheckLine(kernels.name, "FillLineWithAlphas",
+                            dst_line.data(), expected.data(), dst_line.size(), offset);
+
+            // BlendColorToLine
+            dst_line = initial;
+            for (size_t i = offset; i < offset + width; i++) {
+                expected[i] = ReferenceBlend(initial[i], color);
+            }
+            kernels.blend_color_to_line(dest, color, width);
+            ok &= CheckLine(kernels.name, "BlendColorToLine",
+                            dst_line.data(), expected.data(), dst_line.size(), offset);
+
+            // BlendColorWithAlphasToLine
+            dst_line = initial;
+            for (size_t i = offset; i < offset + width; i++) {
+                expected[i] = ReferenceBlend(initial[i], ColorRGBA(color, MulHi(alphas[i], color.a)));
+            }
+            kernels.blend_color_with_alphas_to_line(dest, alphas.data() + offset, color, width);
+            ok &= CheckLine(kernels.name, "BlendColorWithAlphasToLine",
+                            dst_line.data(), expected.data(), dst_line.size(), offset);
+
+            // BlendLine
+            dst_line = initial;
+            for (size_t i = offset; i < offset + width; i++) {
+                expected[i] = ReferenceBlend(initial[i], src_line[i]);
+            }
+            kernels.blend_line(dest, src, width);
+            ok &= CheckLine(kernels.name, "BlendLine", dst_line.data(), expected.data(), dst_line.size(), offset);
+
+            // BlendLine_PremultipliedSrc, source must be a valid premultiplied color
+            for (size_t i = offset; i < offset + width; i++) {
+                ColorRGBA& c = src_line[i];
+                c = ColorRGBA(MulHi(c.r, c.a), MulHi(c.g, c.a), MulHi(c.b, c.a), c.a);
+            }
+            dst_line = initial;
+            for (size_t i = offset; i < offset + width; i++) {
+                expected[i] = ReferenceBlend_PremultipliedSrc(initial[i], src_line[i]);
+            }
+            kernels.blend_line_premultiplied_src(dest, src, width);
+            ok &= CheckLine(kernels.name, "BlendLine_PremultipliedSrc",
+                            dst_line.data(), expected.data(), dst_line.size(), offset);
+
+            if (!ok) {
+                return false;
+            }
+        }
+    }
+
+    return ok;
+}
+
+void BenchmarkKernels(const Kernels& kernels) {
+    constexpr size_t kWidth = 3840;
+    constexpr size_t kLines = 2160;
+    constexpr int kCount = 20;
+
+    std::vector<ColorRGBA> dest(kWidth * kLines, ColorRGBA(255, 0, 0, 180));
+    std::vector<ColorRGBA> src(kWidth * kLines, ColorRGBA(0, 255, 0, 128));
+    std::vector<uint8_t> alphas(kWidth * kLines, 0x80);
+    const ColorRGBA color(0, 0, 255, 200);
+
+    auto stopwatch = StopWatch::Create();
+
+    auto measure = [&](const char* func, auto&& body) {
+        stopwatch->Start();
+        for (int n = 0; n < kCount; n++) {
+            for (size_t y = 0; y < kLines; y++) {
+                body(y * kWidth);
+            }
+        }
+        stopwatch->Stop();
+        double average = static_cast<double>(stopwatch->GetMicroseconds()) / kCount / 1000.0;
+        double mpixels = static_cast<double>(kWidth * kLines) / (average * 1000.0);
+        printf("%-8s %-28s average = %8.3lfms, %8.1lf Mpx/s\n", kernels.name, func, average, mpixels);
+    };
+
+    measure("FillLine", [&](size_t i) {
+        kernels.fill_line(dest.data() + i, color, kWidth);
+    });
+    measure("FillLineWithAlphas", [&](size_t i) {
+        kernels.fill_line_with_alphas(dest.data() + i, alphas.data() + i, color, kWidth);
+    });
+    measure("BlendColorToLine", [&](size_t i) {
+        kernels.blend_color_to_line(dest.data() + i, color, kWidth);
+    });
+    measure("BlendColorWithAlphasToLine", [&](size_t i) {
+        kernels.blend_color_with_alphas_to_line(dest.data() + i, alphas.data() + i, color, kWidth);
+    });
+    measure("BlendLine", [&](size_t i) {
+        kernels.blend_line(dest.data() + i, src.data() + i, kWidth);
+    });
+    measure("BlendLine_PremultipliedSrc", [&](size_t i) {
+        kernels.blend_line_premultiplied_src(dest.data() + i, src.data() + i, kWidth);
+    });
+}
+
+std::vector<Kernels> GetSIMDKernels() {
+    std::vector<Kernels> list;
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#if defined(__SSE2__) || defined(_MSC_VER)
+    list.push_back({"SSE2",
+                    alphablend::internal::x86::FillLine_SSE2,
+                    alphablend::internal::x86::FillLineWithAlphas_SSE2,
+                    alphablend::internal::x86::BlendColorToLine_SSE2,
+                    alphablend::internal::x86::BlendColorWithAlphasToLine_SSE2,
+                    alphablend::internal::x86::BlendLine_SSE2,
+                    alphablend::internal::x86::BlendLine_PremultipliedSrc_SSE2});
+#endif
+#if defined(ARIBCC_HAS_AVX2_KERNELS)
+    if (cpu::HasAVX2()) {
+        list.push_back({"AVX2",
+                        alphablend::internal::x86::FillLine_AVX2,
+                        alphablend::internal::x86::FillLineWithAlphas_AVX2,
+                        alphablend::internal::x86::BlendColorToLine_AVX2,
+                        alphablend::internal::x86::BlendColorWithAlphasToLine_AVX2,
+                        alphablend::internal::x86::BlendLine_AVX2,
+                        alphablend::internal::x86::BlendLine_PremultipliedSrc_AVX2});
+    } else {
+        printf("AVX2 is not supported by this CPU, skipped\n");
+    }
+#endif
+#elif defined(ARIBCC_HAS_NEON_KERNELS)
+    list.push_back({"NEON",
+                    alphablend::internal::arm::FillLine_NEON,
+                    alphablend::internal::arm::FillLineWithAlphas_NEON,
+                    alphablend::internal::arm::BlendColorToLine_NEON,
+                    alphablend::internal::arm::BlendColorWithAlphasToLine_NEON,
+                    alphablend::internal::arm::BlendLine_NEON,
+                    alphablend::internal::arm::BlendLine_PremultipliedSrc_NEON});
+#endif
+    return list;
+}
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#if defined(__SSE2__) || defined(_MSC_VER)
+
+constexpr alphablend::YUVCoefficients kTestCoefficients = {47, 157, 16, -26, -87, 112, 112, -102, -10};
+
+std::vector<ColorRGBA> RandomPremultipliedLine(size_t width, uint32_t& seed) {
+    std::vector<ColorRGBA> line(width);
+    for (ColorRGBA& c : line) {
+        uint32_t r = NextRandom(seed);
+        uint8_t a = (r & 3) == 0 ? 0 : ((r & 3) == 1 ? 255 : static_cast<uint8_t>(r >> 24));
+        c = ColorRGBA(static_cast<uint8_t>(r >> 8), static_cast<uint8_t>(r >> 16), static_cast<uint8_t>(r), 255);
+        c = ColorRGBA(static_cast<uint8_t>(alphablend::Div255(c.r * a)),
+                      static_cast<uint8_t>(alphablend::Div255(c.g * a)),
+                      static_cast<uint8_t>(alphablend::Div255(c.b * a)), a);
+    }
+    return line;
+}
+
+template <typename Sample>
+std::vector<Sample> RandomSamples(size_t count, uint32_t& seed) {
+    std::vector<Sample> samples(count);
+    for (Sample& sample : samples) {
+        sample = static_cast<Sample>(NextRandom(seed) << alphablend::internal::YUVSampleTraits<Sample>::kPadding);
+    }
+    return samples;
+}
+
+template <typename Sample>
+bool CheckSamples(const char* func, const std::vector<Sample>& result,
+                  const std::vector<Sample>& expected, size_t width) {
+    for (size_t i = 0; i < result.size(); i++) {
+        if (result[i] != expected[i]) {
+            fprintf(stderr, "SSE2::%s mismatch: width = %zu, index = %zu, result = %u, expected = %u\n",
+                    func, width, i, static_cast<unsigned>(result[i]), static_cast<unsigned>(expected[i]));
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Sample>
+bool TestLumaKernel(const char* func, uint32_t& seed) {
+    for (size_t width = 0; width <= 80; width++) {
+        std::vector<ColorRGBA> src = RandomPremultipliedLine(width, seed);
+        std::vector<Sample> expected = RandomSamples<Sample>(width, seed);
+        std::vector<Sample> result = expected;
+        alphablend::internal::BlendLumaLine_Generic(expected.data(), src.data(), width, kTestCoefficients);
+        alphablend::internal::x86::BlendLumaLine_SSE2(result.data(), src.data(), width, kTestCoefficients);
+        if (!CheckSamples(func, result, expected, width)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Sample, bool interleaved_uv>
+bool TestChromaKernel(const char* func, uint32_t& seed) {
+    for (size_t blocks = 0; blocks <= 40; blocks++) {
+        std::vector<ColorRGBA> line0 = RandomPremultipliedLine(blocks * 2, seed);
+        std::vector<ColorRGBA> line1 = RandomPremultipliedLine(blocks * 2, seed);
+        std::vector<Sample> expected = RandomSamples<Sample>(blocks * 2, seed);
+        std::vector<Sample> result = expected;
+        size_t v_offset = interleaved_uv ? 1 : blocks;
+        alphablend::internal::BlendChromaLine_Generic<Sample, interleaved_uv>(
+            expected.data(), expected.data() + v_offset, line0.data(), line1.data(), blocks, kTestCoefficients);
+        alphablend::internal::x86::BlendChromaLine_SSE2<Sample, interleaved_uv>(
+            result.data(), result.data() + v_offset, line0.data(), line1.data(), blocks, kTestCoefficients);
+        if (!CheckSamples(func, result, expected, blocks)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TestYUVKernels() {
+    uint32_t seed = 0x9E3779B9;
+    bool ok = true;
+    ok &= TestLumaKernel<uint8_t>("BlendLumaLine<uint8_t>", seed);
+    ok &= TestLumaKernel<uint16_t>("BlendLumaLine<uint16_t>", seed);
+    ok &= TestChromaKernel<uint8_t, false>("BlendChromaLine<uint8_t, planar>", seed);
+    ok &= TestChromaKernel<uint8_t, true>("BlendChromaLine<uint8_t, interleaved>", seed);
+    ok &= TestChromaKernel<uint16_t, true>("BlendChromaLine<uint16_t, interleaved>", seed);
+    return ok;
+}
+
+// Luma and chroma of a 3840x2160 frame, in NV12 and P010
+template <typename Sample>
+void BenchmarkYUVKernels(const char* name, bool simd) {
+    constexpr size_t kWidth = 3840;
+    constexpr size_t kLines = 2160;
+    constexpr int kCount = 20;
+
+    uint32_t seed = 0x2545F491;
+    std::vector<ColorRGBA> src = RandomPremultipliedLine(kWidth * 2, seed);
+    std::vector<Sample> luma(kWidth * kLines);
+    std::vector<Sample> chroma(kWidth * kLines / 2);
+
+    auto stopwatch = StopWatch::Create();
+    stopwatch->Start();
+    for (int n = 0; n < kCount; n++) {
+        for (size_t y = 0; y < kLines; y += 2) {
+            Sample* uv = chroma.data() + y / 2 * kWidth;
+            if (simd) {
+                alphablend::internal::x86::BlendLumaLine_SSE2(luma.data() + y * kWidth, src.data(), kWidth, kTestCoefficients);
+                alphablend::internal::x86::BlendLumaLine_SSE2(luma.data() + (y + 1) * kWidth, src.data() + kWidth, kWidth, kTestCoefficients);
+                alphablend::internal::x86::BlendChromaLine_SSE2<Sample, true>(uv, uv + 1, src.data(), src.data() + kWidth,
+                                                                              kWidth / 2, kTestCoefficients);
+            } else {
+                alphablend::internal::BlendLumaLine_Generic(luma.data() + y * kWidth, src.data(), kWidth, kTestCoefficients);
+                alphablend::internal::BlendLumaLine_Generic(luma.data() + (y + 1) * kWidth, src.data() + kWidth, kWidth, kTestCoefficients);
+                alphablend::internal::BlendChromaLine_Generic<Sample, true>(uv, uv + 1, src.data(), src.data() + kWidth,
+                                                                            kWidth / 2, kTestCoefficients);
+            }
+        }
+    }
+    stopwatch->Stop();
+    double average = static_cast<double>(stopwatch->GetMicroseconds()) / kCount / 1000.0;
+    printf("%-8s %-28s average = %8.3lfms\n", simd ? "SSE2" : "Generic", name, average);
+}
+
+#endif  // defined(__SSE2__) || defined(_MSC_VER)
+#endif
+
+}  // namespace
+
 int main(int argc, char** argv) {
+    const Kernels generic{"Generic",
+                          alphablend::internal::FillLine_Generic,
+                          alphablend::internal::FillLineWithAlphas_Generic,
+                          alphablend::internal::BlendColorToLine_Generic,
+                          alphablend::internal::BlendColorWithAlphasToLine_Generic,
+                          alphablend::internal::BlendLine_Generic,
+                          alphablend::internal::BlendLine_PremultipliedSrc_Generic};
+    const Kernels dispatched{"Dispatch",
+                             alphablend::FillLine,
+                             alphablend::FillLineWithAlphas,
+                             alphablend::BlendColorToLine,
+                             alphablend::BlendColorWithAlphasToLine,
+                             alphablend::BlendLine,
+                             alphablend::BlendLine_PremultipliedSrc};
+
+    std::vector<Kernels> simd_kernels = GetSIMDKernels();
+
+    // Correctness: every SIMD implementation must produce bit-exact results
+    bool ok = true;
+    for (const Kernels& kernels : simd_kernels) {
+        bool result = TestKernels(kernels);
+        printf("%-8s correctness: %s\n", kernels.name, result ? "OK" : "FAILED");
+        ok &= result;
+    }
+    if (!simd_kernels.empty()) {
+        bool result = TestKernels(dispatched);
+        printf("%-8s correctness: %s\n", dispatched.name, result ? "OK" : "FAILED");
+        ok &= result;
+    }
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#if defined(__SSE2__) || defined(_MSC_VER)
+    bool yuv_result = TestYUVKernels();
+    printf("%-8s YUV correctness: %s\n", "SSE2", yuv_result ? "OK" : "FAILED");
+    ok &= yuv_result;
+#endif
+#endif
+
+    if (!ok) {
+        return 1;
+    }
+
+    // Throughput of each line kernel on a 3840x2160 frame
+    BenchmarkKernels(generic);
+    for (const Kernels& kernels : simd_kernels) {
+        BenchmarkKernels(kernels);
+    }
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#if defined(__SSE2__) || defined(_MSC_VER)
+    for (bool simd : {false, true}) {
+        BenchmarkYUVKernels<uint8_t>("NV12 luma + chroma", simd);
+        BenchmarkYUVKernels<uint16_t>("P010 luma + chroma", simd);
+    }
+#endif
+#endif
+
+    // Whole bitmap blending through Canvas
     constexpr int count = 1000;
 
     auto stopwatch = StopWatch::Create();
@@ -53,4 +490,4 @@ int main(int argc, char** argv) {
            static_cast<double>(average) / 1000.0f);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,556 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/*
+ * Microbenchmarks for the decoder, the renderer and the alphablend kernels.
+ *
+ * Results are printed into stdout, one JSON object per line (or CSV with --csv),
+ * so that they could be collected and diffed between releases.
+ * Besides wall time, heap allocations per operation are counted through operator new
+ * and the allocator of the Context, which serves pixel buffers.
+ *
+ * With --baseline, results are compared against the JSON output of a previous run,
+ * and the exit code is non-zero if time or allocations regressed beyond --tolerance percents (default 25).
+ *
+ * Usage: benchmark [--csv] [--filter <substring>] [--min-time-ms <ms>] [--baseline <file>] [--tolerance <percent>]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/decoder.hpp"
+#include "aribcaption/renderer.hpp"
+#include "renderer/alphablend.hpp"
+#include "renderer/font_provider.hpp"
+#include "sample_data.h"
+#include "stopwatch.hpp"
+
+using namespace aribcaption;
+
+static std::atomic<uint64_t> allocation_count{0};
+
+// Count allocations of the whole process, including the ones inside libaribcaption
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+namespace {
+
+struct Options {
+    bool csv = false;
+    std::string filter;
+    int64_t min_time_us = 100000;
+    int samples = 5;
+    std::string baseline;
+    double tolerance = 25.0;  // in percents
+};
+
+struct BenchmarkResult {
+    std::string name;
+    double ns_per_op = 0.0;
+    double min_ns_per_op = 0.0;
+    double allocs_per_op = 0.0;
+};
+
+// Pixel buffers bypass operator new, count them through the Context allocator
+void* CountingAlloc(void*, size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size);
+}
+
+void CountingFree(void*, void* ptr) {
+    free(ptr);
+}
+
+class BenchmarkRunner {
+public:
+    explicit BenchmarkRunner(const Options& options)
+        : options_(options), stopwatch_(StopWatch::Create()) {
+        if (options_.csv) {
+            printf("name,iterations,ns_per_op,min_ns_per_op,allocs_per_op\n");
+        }
+    }
+
+    [[nodiscard]]
+    bool Enabled(const std::string& name) const {
+        return options_.filter.empty() || name.find(options_.filter) != std::string::npos;
+    }
+
+    // fn performs one operation per call and returns false on failure
+    void Run(const std::string& name, const std::function<bool()>& fn) {
+        if (!Enabled(name)) {
+            return;
+        }
+
+        // Warm up, also reject broken setups
+        if (!fn()) {
+            fprintf(stderr, "%s: failed, skipped\n", name.c_str());
+            return;
+        }
+
+        // Find an iteration count exceeding the minimum sample time
+        uint64_t iterations = 1;
+        while (true) {
+            int64_t elapsed = Measure(fn, iterations);
+            if (elapsed < 0) {
+                fprintf(stderr, "%s: failed, skipped\n", name.c_str());
+                return;
+            }
+            if (elapsed >= options_.min_time_us) {
+                break;
+            }
+            uint64_t scale = elapsed > 0 ? options_.min_time_us * 5 / 4 / elapsed + 1 : 10;
+            iterations *= std::min<uint64_t>(scale, 10);
+        }
+
+        double total_ns = 0.0;
+        double min_ns = 0.0;
+        uint64_t allocations_begin = allocation_count.load(std::memory_order_relaxed);
+        for (int i = 0; i < options_.samples; i++) {
+            double ns = static_cast<double>(Measure(fn, iterations)) * 1000.0 / static_cast<double>(iterations);
+            total_ns += ns;
+            min_ns = (i == 0) ? ns : std::min(min_ns, ns);
+        }
+        uint64_t allocations = allocation_count.load(std::memory_order_relaxed) - allocations_begin;
+
+        BenchmarkResult result;
+        result.name = name;
+        result.ns_per_op = total_ns / options_.samples;
+        result.min_ns_per_op = min_ns;
+        result.allocs_per_op = static_cast<double>(allocations) / static_cast<double>(iterations * options_.samples);
+
+        if (options_.csv) {
+            printf("%s,%llu,%.1f,%.1f,%.2f\n", name.c_str(), (unsigned long long)iterations,
+                   result.ns_per_op, result.min_ns_per_op, result.allocs_per_op);
+        } else {
+            printf("{\"name\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.1f,\"min_ns_per_op\":%.1f,"
+                   "\"allocs_per_op\":%.2f}\n",
+                   name.c_str(), (unsigned long long)iterations,
+                   result.ns_per_op, result.min_ns_per_op, result.allocs_per_op);
+        }
+        fflush(stdout);
+
+        results_.push_back(std::move(result));
+    }
+
+    [[nodiscard]]
+    const std::vector<BenchmarkResult>& results() const { return results_; }
+private:
+    int64_t Measure(const std::function<bool()>& fn, uint64_t iterations) {
+        stopwatch_->Reset();
+        stopwatch_->Start();
+        for (uint64_t i = 0; i < iterations; i++) {
+            if (!fn()) {
+                return -1;
+            }
+        }
+        stopwatch_->Stop();
+        return stopwatch_->GetMicroseconds();
+    }
+private:
+    Options options_;
+    std::unique_ptr<StopWatch> stopwatch_;
+    std::vector<BenchmarkResult> results_;
+};
+
+// Parse the JSON lines output of a previous run, return false if the file couldn't be read
+bool LoadBaseline(const std::string& filename, std::unordered_map<std::string, BenchmarkResult>& baseline) {
+    FILE* file = fopen(filename.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        char name[512] = {0};
+        unsigned long long iterations = 0;
+        BenchmarkResult result;
+        int fields = sscanf(line,
+                            "{\"name\":\"%511[^\"]\",\"iterations\":%llu,\"ns_per_op\":%lf,\"min_ns_per_op\":%lf,"
+                            "\"allocs_per_op\":%lf}",
+                            name, &iterations, &result.ns_per_op, &result.min_ns_per_op, &result.allocs_per_op);
+        if (fields < 4) {
+            continue;
+        }
+        if (fields < 5) {
+            result.allocs_per_op = -1.0;  // Recorded by an older version, not compared
+        }
+        result.name = name;
+        baseline[result.name] = std::move(result);
+    }
+
+    fclose(file);
+    return true;
+}
+
+// Compare fastest samples, which are less noisy than the means. Return count of regressions
+int CompareWithBaseline(const std::vector<BenchmarkResult>& results,
+                        const std::unordered_map<std::string, BenchmarkResult>& baseline,
+                        double tolerance) {
+    double factor = 1.0 + tolerance / 100.0;
+    int regressions = 0;
+
+    for (const BenchmarkResult& result : results) {
+        auto iter = baseline.find(result.name);
+        if (iter == baseline.end()) {
+            fprintf(stderr, "%s: not in baseline\n", result.name.c_str());
+            continue;
+        }
+        const BenchmarkResult& base = iter->second;
+
+        if (result.min_ns_per_op > base.min_ns_per_op * factor) {
+            fprintf(stderr, "%s: time regressed, %.1f ns/op against baseline %.1f ns/op\n",
+                    result.name.c_str(), result.min_ns_per_op, base.min_ns_per_op);
+            regressions++;
+        }
+        // Allow fractional noise, e.g. from amortized container growth
+        if (base.allocs_per_op >= 0.0 && result.allocs_per_op > base.allocs_per_op * factor + 0.5) {
+            fprintf(stderr, "%s: allocations regressed, %.2f allocs/op against baseline %.2f allocs/op\n",
+                    result.name.c_str(), result.allocs_per_op, base.allocs_per_op);
+            regressions++;
+        }
+    }
+
+    return regressions;
+}
+
+void BenchmarkDecode(BenchmarkRunner& runner, Context& context) {
+    struct Sample {
+        const char* name;
+        const uint8_t* data;
+        size_t length;
+    };
+    const Sample samples[] = {
+        {"sample_data_1", sample_data_1, sizeof(sample_data_1)},
+        {"sample_data_drcs_1", sample_data_drcs_1, sizeof(sample_data_drcs_1)},
+    };
+
+    for (const Sample& sample : samples) {
+        for (int mode = 0; mode < 3; mode++) {
+            static const char* mode_names[] = {"default", "reuse_storage", "text_only"};
+            std::string name = std::string("decode/") + sample.name + "/" + mode_names[mode];
+
+            Decoder decoder(context);
+            decoder.Initialize();
+            decoder.SetReuseCaptionStorage(mode != 0);
+            decoder.SetTextOnly(mode == 2);
+            DecodeResult result;
+
+            runner.Run(name, [&]() {
+                return decoder.Decode(sample.data, sample.length, 0, result) == DecodeStatus::kGotCaption;
+            });
+        }
+
+        // Per packet cost of batch decoding
+        std::vector<DecodePacket> packets(16);
+        for (DecodePacket& packet : packets) {
+            packet.data = sample.data;
+            packet.length = sample.length;
+        }
+        Decoder decoder(context);
+        decoder.Initialize();
+        DecodeBatchResult result;
+        size_t index = 0;
+        runner.Run(std::string("decode/") + sample.name + "/batch", [&]() {
+            if (index % packets.size() == 0) {
+                decoder.DecodeBatch(packets.data(), packets.size(), result);
+                if (result.captions.size() != packets.size()) {
+                    return false;
+                }
+            }
+            index++;
+            return true;
+        });
+    }
+}
+
+Caption MakeSyntheticCaption(int64_t pts, bool stroke, const DRCS* drcs) {
+    static const char32_t* lines[] = {
+        U"The quick brown fox jumps over",
+        U"the lazy dog, 0123456789!?",
+    };
+
+    Caption caption;
+    caption.type = CaptionType::kCaption;
+    caption.pts = pts;
+    caption.wait_duration = 1000;
+    caption.plane_width = 960;
+    caption.plane_height = 540;
+
+    int y = 390;
+    for (const char32_t* line : lines) {
+        CaptionRegion region;
+        region.x = 120;
+        region.y = y;
+        region.height = 60;
+
+        int x = region.x;
+        for (const char32_t* p = line; *p; p++) {
+            CaptionChar ch;
+            ch.type = drcs ? CaptionCharType::kDRCS : CaptionCharType::kText;
+            ch.codepoint = *p;
+            ch.u8str[0] = static_cast<char>(*p);
+            ch.drcs_code = drcs ? 0x4121 : 0;
+            ch.x = x;
+            ch.y = y;
+            ch.char_width = 36;
+            ch.char_height = 36;
+            ch.char_horizontal_spacing = 4;
+            ch.char_vertical_spacing = 24;
+            ch.char_horizontal_scale = drcs ? 1.0f : 0.5f;
+            ch.char_vertical_scale = 1.0f;
+            ch.text_color = ColorRGBA(255, 255, 255, 255);
+            ch.back_color = ColorRGBA(0, 0, 0, 128);
+            ch.stroke_color = ColorRGBA(0, 0, 0, 255);
+            ch.style = stroke ? CharStyle::kCharStyleStroke : CharStyle::kCharStyleDefault;
+
+            x += ch.section_width();
+            region.width += ch.section_width();
+            region.chars.push_back(ch);
+        }
+        caption.regions.push_back(std::move(region));
+        y += 60;
+    }
+
+    if (drcs) {
+        caption.drcs_map[0x4121] = *drcs;
+    }
+
+    return caption;
+}
+
+void BenchmarkRender(BenchmarkRunner& runner, Context& context) {
+    struct Resolution {
+        const char* name;
+        int width;
+        int height;
+    };
+    const Resolution resolutions[] = {
+        {"720p", 1280, 720},
+        {"1080p", 1920, 1080},
+        {"2160p", 3840, 2160},
+    };
+
+    // Borrow a DRCS pattern from the sample data
+    std::optional<DRCS> sample_drcs;
+    {
+        Decoder decoder(context);
+        decoder.Initialize();
+        DecodeResult result;
+        if (decoder.Decode(sample_data_drcs_1, sizeof(sample_data_drcs_1), 0, result) == DecodeStatus::kGotCaption &&
+                !result.caption->drcs_map.empty()) {
+            sample_drcs = result.caption->drcs_map.begin()->second;
+        }
+    }
+
+    enum Variant { kText, kTextStroke, kTextRaster, kDRCS };
+    struct Config {
+        const char* name;
+        Variant variant;
+    };
+    const Config configs[] = {
+        {"text", kText},
+        {"stroke", kTextStroke},
+        {"stroke_nocache", kTextRaster},  // glyph cache disabled, rasterize every glyph
+        {"drcs", kDRCS},
+    };
+
+    for (const Resolution& resolution : resolutions) {
+        for (const Config& config : configs) {
+            for (int merge = 0; merge < 2; merge++) {
+                std::string name = std::string("render/") + resolution.name + "/" + config.name +
+                                   (merge ? "/merge" : "/nomerge");
+                if (!runner.Enabled(name)) {
+                    continue;
+                }
+                if (config.variant == kDRCS && !sample_drcs) {
+                    fprintf(stderr, "%s: no DRCS in sample data, skipped\n", name.c_str());
+                    continue;
+                }
+
+                Renderer renderer(context);
+                if (!renderer.Initialize()) {
+                    fprintf(stderr, "%s: Renderer::Initialize() failed, skipped\n", name.c_str());
+                    continue;
+                }
+                renderer.SetFrameSize(resolution.width, resolution.height);
+                renderer.SetStoragePolicy(CaptionStoragePolicy::kUnlimited);
+                renderer.SetRegionImageCacheSize(0);
+                renderer.SetMergeRegionImages(merge);
+                renderer.SetReplaceDRCS(false);
+                if (config.variant == kTextRaster) {
+                    renderer.SetGlyphCacheLimit(0);
+                }
+
+                bool stroke = config.variant == kTextStroke || config.variant == kTextRaster;
+                const DRCS* drcs = config.variant == kDRCS ? &*sample_drcs : nullptr;
+
+                // Alternate between two captions, so that every call renders
+                renderer.AppendCaption(MakeSyntheticCaption(0, stroke, drcs));
+                renderer.AppendCaption(MakeSyntheticCaption(1000, stroke, drcs));
+
+                int64_t index = 0;
+                RenderResult result;
+                runner.Run(name, [&]() {
+                    int64_t pts = (index++ & 1) * 1000 + 10;
+                    return renderer.Render(pts, result) == RenderStatus::kGotImage;
+                });
+            }
+        }
+    }
+}
+
+void BenchmarkAlphablend(BenchmarkRunner& runner) {
+    constexpr size_t kWidth = 1920;
+
+    std::vector<ColorRGBA> dest(kWidth, ColorRGBA(10, 20, 30, 128));
+    std::vector<ColorRGBA> src(kWidth);
+    std::vector<uint8_t> alphas(kWidth);
+    for (size_t i = 0; i < kWidth; i++) {
+        src[i] = ColorRGBA(static_cast<uint8_t>(i), 100, 200, static_cast<uint8_t>(i * 7));
+        alphas[i] = static_cast<uint8_t>(i * 13);
+    }
+    ColorRGBA color(255, 128, 0, 200);
+
+    runner.Run("alphablend/FillLine/1920", [&]() {
+        alphablend::FillLine(dest.data(), color, kWidth);
+        return true;
+    });
+    runner.Run("alphablend/FillLineWithAlphas/1920", [&]() {
+        alphablend::FillLineWithAlphas(dest.data(), alphas.data(), color, kWidth);
+        return true;
+    });
+    runner.Run("alphablend/BlendColorToLine/1920", [&]() {
+        alphablend::BlendColorToLine(dest.data(), color, kWidth);
+        return true;
+    });
+    runner.Run("alphablend/BlendColorWithAlphasToLine/1920", [&]() {
+        alphablend::BlendColorWithAlphasToLine(dest.data(), alphas.data(), color, kWidth);
+        return true;
+    });
+    runner.Run("alphablend/BlendLine/1920", [&]() {
+        alphablend::BlendLine(dest.data(), src.data(), kWidth);
+        return true;
+    });
+}
+
+void BenchmarkFontLookup(BenchmarkRunner& runner, Context& context) {
+    std::unique_ptr<FontProvider> provider = FontProvider::Create(FontProviderType::kAuto, context);
+    if (!provider || !provider->Initialize()) {
+        fprintf(stderr, "font: FontProvider initialization failed, skipped\n");
+        return;
+    }
+
+    runner.Run("font/lookup/family", [&]() {
+        return provider->GetFontFace("sans-serif", std::nullopt).is_ok();
+    });
+    runner.Run("font/lookup/codepoint", [&]() {
+        return provider->GetFontFace("sans-serif", U'A').is_ok();
+    });
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--csv")) {
+            options.csv = true;
+        } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (!strcmp(argv[i], "--min-time-ms") && i + 1 < argc) {
+            options.min_time_us = std::max<int64_t>(1, atoll(argv[++i])) * 1000;
+        } else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) {
+            options.baseline = argv[++i];
+        } else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc) {
+            options.tolerance = std::max(0.0, atof(argv[++i]));
+        } else {
+            fprintf(stderr, "Usage: %s [--csv] [--filter <substring>] [--min-time-ms <ms>] "
+                            "[--baseline <file>] [--tolerance <percent>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::unordered_map<std::string, BenchmarkResult> baseline;
+    if (!options.baseline.empty() && !LoadBaseline(options.baseline, baseline)) {
+        fprintf(stderr, "Cannot read baseline %s\n", options.baseline.c_str());
+        return 1;
+    }
+
+    Context context;
+    context.SetLogcatCallback([](LogLevel level, const char* message) {
+        if (level == LogLevel::kError) {
+            fprintf(stderr, "%s\n", message);
+        }
+    });
+    AllocatorCallbacks allocator;
+    allocator.alloc = CountingAlloc;
+    allocator.free = CountingFree;
+    context.SetAllocator(allocator);
+
+    BenchmarkRunner runner(options);
+    BenchmarkDecode(runner, context);
+    BenchmarkRender(runner, context);
+    BenchmarkAlphablend(runner);
+    BenchmarkFontLookup(runner, context);
+
+    if (!options.baseline.empty()) {
+        int regressions = CompareWithBaseline(runner.results(), baseline, options.tolerance);
+        if (regressions) {
+            fprintf(stderr, "%d regression(s) against baseline %s\n", regressions, options.baseline.c_str());
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/*
+ * Cold-start benchmark, measuring the phases before the first caption is shown, e.g. on channel zapping.
+ *
+ * Every phase runs once, so the numbers only mean "cold" on the first run within a fresh process:
+ * invoke the benchmark once per backend instead of looping in a script around a single process.
+ * Caches outside of the process (font caches of the system, page cache) are not dropped.
+ *
+ * Results are printed into stdout, one JSON object per line (or CSV with --csv), in microseconds.
+ * With --budget-ms, the exit code is non-zero if the time to the first caption exceeds the budget.
+ *
+ * Usage: startup_benchmark [--csv] [--font-provider <name>] [--text-renderer <name>] [--budget-ms <ms>]
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include "aribcaption/context.hpp"
+#include "aribcaption/decoder.hpp"
+#include "aribcaption/renderer.hpp"
+#include "sample_data.h"
+#include "stopwatch.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+struct Backend {
+    const char* name;
+    int type;
+};
+
+const Backend kFontProviders[] = {
+    {"auto", static_cast<int>(FontProviderType::kAuto)},
+#if defined(ARIBCC_USE_CORETEXT)
+    {"coretext", static_cast<int>(FontProviderType::kCoreText)},
+#endif
+#if defined(ARIBCC_USE_DIRECTWRITE)
+    {"directwrite", static_cast<int>(FontProviderType::kDirectWrite)},
+#endif
+#if defined(ARIBCC_USE_FONTCONFIG)
+    {"fontconfig", static_cast<int>(FontProviderType::kFontconfig)},
+#endif
+#if defined(ARIBCC_IS_ANDROID)
+    {"android", static_cast<int>(FontProviderType::kAndroid)},
+#endif
+#if defined(ARIBCC_USE_GDI_FONT)
+    {"gdi", static_cast<int>(FontProviderType::kGDI)},
+#endif
+};
+
+const Backend kTextRenderers[] = {
+    {"auto", static_cast<int>(TextRendererType::kAuto)},
+#if defined(ARIBCC_USE_CORETEXT)
+    {"coretext", static_cast<int>(TextRendererType::kCoreText)},
+#endif
+#if defined(ARIBCC_USE_DIRECTWRITE)
+    {"directwrite", static_cast<int>(TextRendererType::kDirectWrite)},
+#endif
+#if defined(ARIBCC_USE_FREETYPE)
+    {"freetype", static_cast<int>(TextRendererType::kFreetype)},
+#endif
+};
+
+template <size_t N>
+const Backend* FindBackend(const Backend (&backends)[N], const char* name) {
+    for (const Backend& backend : backends) {
+        if (!strcmp(backend.name, name)) {
+            return &backend;
+        }
+    }
+    return nullptr;
+}
+
+template <size_t N>
+void PrintBackends(const char* option, const Backend (&backends)[N]) {
+    fprintf(stderr, "  %s:", option);
+    for (const Backend& backend : backends) {
+        fprintf(stderr, " %s", backend.name);
+    }
+    fprintf(stderr, "\n");
+}
+
+class PhaseReporter {
+public:
+    PhaseReporter(bool csv, std::string prefix) : csv_(csv), prefix_(std::move(prefix)) {
+        if (csv_) {
+            printf("name,us\n");
+        }
+    }
+
+    void Report(const char* phase, int64_t us) {
+        if (csv_) {
+            printf("%s/%s,%lld\n", prefix_.c_str(), phase, static_cast<long long>(us));
+        } else {
+            printf("{\"name\":\"%s/%s\",\"us\":%lld}\n", prefix_.c_str(), phase, static_cast<long long>(us));
+        }
+        fflush(stdout);
+    }
+private:
+    bool csv_;
+    std::string prefix_;
+};
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    bool csv = false;
+    const Backend* font_provider = &kFontProviders[0];
+    const Backend* text_renderer = &kTextRenderers[0];
+    int64_t budget_us = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--csv")) {
+            csv = true;
+        } else if (!strcmp(argv[i], "--font-provider") && i + 1 < argc &&
+                   (font_provider = FindBackend(kFontProviders, argv[i + 1]))) {
+            i++;
+        } else if (!strcmp(argv[i], "--text-renderer") && i + 1 < argc &&
+                   (text_renderer = FindBackend(kTextRenderers, argv[i + 1]))) {
+            i++;
+        } else if (!strcmp(argv[i], "--budget-ms") && i + 1 < argc) {
+            budget_us = atoll(argv[++i]) * 1000;
+        } else {
+            fprintf(stderr, "Usage: %s [--csv] [--font-provider <name>] [--text-renderer <name>] "
+                            "[--budget-ms <ms>]\n", argv[0]);
+            PrintBackends("--font-provider", kFontProviders);
+            PrintBackends("--text-renderer", kTextRenderers);
+            return 1;
+        }
+    }
+
+    PhaseReporter reporter(csv, std::string("startup/") + font_provider->name + "/" + text_renderer->name);
+    std::unique_ptr<StopWatch> total = StopWatch::Create();
+    std::unique_ptr<StopWatch> phase = StopWatch::Create();
+    total->Start();
+
+    phase->Start();
+    Context context;
+    context.SetLogcatCallback([](LogLevel level, const char* message) {
+        if (level == LogLevel::kError) {
+            fprintf(stderr, "%s\n", message);
+        }
+    });
+    phase->Stop();
+    reporter.Report("context", phase->GetMicroseconds());
+
+    phase->Reset();
+    phase->Start();
+    Decoder decoder(context);
+    if (!decoder.Initialize()) {
+        fprintf(stderr, "Decoder::Initialize() failed\n");
+        return 1;
+    }
+    phase->Stop();
+    reporter.Report("decoder_init", phase->GetMicroseconds());
+
+    // Includes lazily constructed tables of the decoder
+    DecodeResult decode_result;
+    phase->Reset();
+    phase->Start();
+    DecodeStatus decode_status = decoder.Decode(sample_data_1, sizeof(sample_data_1), 0, decode_result);
+    phase->Stop();
+    if (decode_status != DecodeStatus::kGotCaption) {
+        fprintf(stderr, "Decoder::Decode() got no caption\n");
+        return 1;
+    }
+    reporter.Report("first_decode", phase->GetMicroseconds());
+
+    phase->Reset();
+    phase->Start();
+    Renderer renderer(context);
+    if (!renderer.Initialize(CaptionType::kCaption,
+                             static_cast<FontProviderType>(font_provider->type),
+                             static_cast<TextRendererType>(text_renderer->type))) {
+        fprintf(stderr, "Renderer::Initialize() failed\n");
+        return 1;
+    }
+    renderer.SetFrameSize(1920, 1080);
+    renderer.SetRegionImageCacheSize(0);
+    phase->Stop();
+    reporter.Report("renderer_init", phase->GetMicroseconds());
+
+    Caption caption = *decode_result.caption;
+    renderer.AppendCaption(caption);
+
+    RenderResult render_result;
+    phase->Reset();
+    phase->Start();
+    RenderStatus render_status = renderer.Render(caption.pts, render_result);
+    phase->Stop();
+    total->Stop();
+    if (render_status == RenderStatus::kError) {
+        fprintf(stderr, "Renderer::Render() failed\n");
+        return 1;
+    }
+    reporter.Report("first_render_call", phase->GetMicroseconds());
+
+    // Phases within the library, as reported by the renderer itself
+    RendererStartupTimings timings = renderer.GetStartupTimings();
+    reporter.Report("renderer/initialize", static_cast<int64_t>(timings.initialize_us));
+    reporter.Report("renderer/font_provider_init", static_cast<int64_t>(timings.font_provider_init_us));
+    reporter.Report("renderer/text_renderer_init", static_cast<int64_t>(timings.text_renderer_init_us));
+    reporter.Report("renderer/first_font_load", static_cast<int64_t>(timings.first_font_load_us));
+    reporter.Report("renderer/first_render", static_cast<int64_t>(timings.first_render_us));
+
+    // Same caption at another PTS, for comparison against a renderer that has warmed up
+    caption.pts += 1000;
+    renderer.AppendCaption(caption);
+    phase->Reset();
+    phase->Start();
+    renderer.Render(caption.pts, render_result);
+    phase->Stop();
+    reporter.Report("warm_render_call", phase->GetMicroseconds());
+
+    int64_t time_to_first_caption = total->GetMicroseconds();
+    reporter.Report("time_to_first_caption", time_to_first_caption);
+
+    if (budget_us > 0 && time_to_first_caption > budget_us) {
+        fprintf(stderr, "Time to first caption %lld us exceeds the budget of %lld us\n",
+                static_cast<long long>(time_to_first_caption), static_cast<long long>(budget_us));
+        return 1;
+    }
+
+    return 0;
+}
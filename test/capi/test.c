@@ -111,6 +111,27 @@ int main(int argc, char* argv[]) {
 
     aribcc_render_result_cleanup(&render_result);
 
+    // Decode again into a caption handle, and hand it over to the renderer without conversion
+    aribcc_caption_handle_t* caption_handle = NULL;
+    decode_status = aribcc_decoder_decode_handle(decoder,
+                                                 sample_data_drcs_1,
+                                                 sizeof(sample_data_drcs_1),
+                                                 1000,
+                                                 &caption_handle);
+    printf("DecodeStatus: %d\n", decode_status);
+    if (decode_status == ARIBCC_DECODE_STATUS_GOT_CAPTION) {
+        printf("%s\n", aribcc_caption_handle_get_text(caption_handle));
+        printf("RegionCount: %u\n", aribcc_caption_handle_get_region_count(caption_handle));
+        aribcc_renderer_append_caption_handle(renderer, caption_handle);
+    }
+
+    render_status = aribcc_renderer_render(renderer, 1000, &render_result);
+    printf("RenderStatus: %d\n", render_status);
+    if (render_status == ARIBCC_RENDER_STATUS_GOT_IMAGE) {
+        printf("ImageCount: %u\n", render_result.image_count);
+    }
+    aribcc_render_result_cleanup(&render_result);
+
     aribcc_renderer_free(renderer);
     aribcc_decoder_free(decoder);
     aribcc_context_free(ctx);
@@ -155,6 +155,7 @@ private:
         });
 
         decoder_.Initialize(EncodingScheme::kAuto, CaptionType::kCaption);
+        decoder_.SetTextOnly(true);  // Only text and timing are needed for SRT
     }
 
     static std::string MillisecondsToTime(int64_t millis) {
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "aribcaption/caption_view.hpp"
+#include "aribcaption/context.hpp"
+#include "aribcaption/decoder.hpp"
+#include "sample_data.h"
+
+using namespace aribcaption;
+
+static bool CompareChars(const CaptionChar& ch, const CaptionCharView& view) {
+    return ch.type == view.type() && ch.codepoint == view.codepoint() && ch.drcs_code == view.drcs_code() &&
+           ch.x == view.x() && ch.y == view.y() && ch.char_width == view.char_width() &&
+           ch.char_horizontal_scale == view.char_horizontal_scale() &&
+           ch.text_color.u32 == view.text_color().u32 && ch.stroke_color.u32 == view.stroke_color().u32 &&
+           ch.style == view.style() && ch.enclosure_style == view.enclosure_style() && view.u8str() == ch.u8str;
+}
+
+static int TestCaption(const Caption& caption) {
+    int failures = 0;
+
+    std::vector<uint8_t> data;
+    SerializeCaption(caption, data);
+
+    CaptionView view;
+    if (!view.Open(data.data(), data.size()) || view.encoded_size() != data.size()) {
+        printf("Open FAILED\n");
+        return 1;
+    }
+
+    // Read records in place
+    if (view.text() != caption.text || view.pts() != caption.pts || view.wait_duration() != caption.wait_duration ||
+        view.region_count() != caption.regions.size() || view.drcs_count() != caption.drcs_map.size()) {
+        printf("Caption fields mismatch\n");
+        failures++;
+    }
+    for (size_t i = 0; i < caption.regions.size() && i < view.region_count(); i++) {
+        const CaptionRegion& region = caption.regions[i];
+        CaptionRegionView region_view = view.region_at(i);
+        if (region.x != region_view.x() || region.width != region_view.width() ||
+            region.chars.size() != region_view.char_count()) {
+            printf("Region %zu mismatch\n", i);
+            failures++;
+            continue;
+        }
+        for (size_t j = 0; j < region.chars.size(); j++) {
+            if (!CompareChars(region.chars[j], region_view.char_at(j))) {
+                printf("Char %zu of region %zu mismatch\n", j, i);
+                failures++;
+            }
+        }
+    }
+    for (size_t i = 0; i < view.drcs_count(); i++) {
+        DRCSView drcs_view = view.drcs_at(i);
+        auto iter = caption.drcs_map.find(drcs_view.code());
+        if (iter == caption.drcs_map.end() || iter->second.md5 != drcs_view.md5() ||
+            iter->second.pixels != std::vector<uint8_t>(drcs_view.pixels(),
+                                                        drcs_view.pixels() + drcs_view.pixels_size())) {
+            printf("DRCS %zu mismatch\n", i);
+            failures++;
+        }
+    }
+
+    // Decoded caption must be encoded into identical bytes
+    Caption decoded;
+    view.ToCaption(decoded);
+    std::vector<uint8_t> reencoded;
+    SerializeCaption(decoded, reencoded);
+    if (reencoded != data) {
+        printf("Round trip mismatch\n");
+        failures++;
+    }
+
+    // Regions stored in compact form must be encoded identically
+    Caption compact = caption;
+    size_t run_count = 0;
+    for (CaptionRegion& region : compact.regions) {
+        if (!region.compact_chars.Assign(region.chars)) {
+            printf("CompactCaptionChars::Assign() FAILED\n");
+            failures++;
+        }
+        run_count += region.compact_chars.runs.size();
+        region.chars.clear();
+    }
+    std::vector<uint8_t> compact_encoded;
+    SerializeCaption(compact, compact_encoded);
+    if (compact_encoded != data) {
+        printf("Compact regions mismatch\n");
+        failures++;
+    }
+
+    // Truncated buffers must be rejected
+    for (size_t size = 0; size < data.size(); size++) {
+        if (view.Open(data.data(), size)) {
+            printf("Truncated buffer of %zu bytes accepted\n", size);
+            failures++;
+            break;
+        }
+    }
+
+    printf("Encoded %zu regions, %zu DRCS into %zu bytes, %zu char runs\n",
+           caption.regions.size(), caption.drcs_map.size(), data.size(), run_count);
+    return failures;
+}
+
+int main(int argc, const char* argv[]) {
+    Context context;
+    context.SetLogcatCallback([](LogLevel level, const char* message) {
+        if (level == LogLevel::kError) {
+            fprintf(stderr, "%s\n", message);
+        }
+    });
+
+    Decoder decoder(context);
+    decoder.Initialize();
+    DecodeResult result;
+
+    int failures = 0;
+    if (decoder.Decode(sample_data_1, sizeof(sample_data_1), 0, result) == DecodeStatus::kGotCaption) {
+        failures += TestCaption(*result.caption);
+    } else {
+        failures++;
+    }
+    if (decoder.Decode(sample_data_drcs_1, sizeof(sample_data_drcs_1), 1000, result) == DecodeStatus::kGotCaption) {
+        failures += TestCaption(*result.caption);
+    } else {
+        failures++;
+    }
+
+    printf("Failures: %d\n", failures);
+    return failures ? 1 : 0;
+}
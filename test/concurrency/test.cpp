@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Stress test for sharing a Context between decoders and renderers living on different threads.
+// Build with -DCMAKE_CXX_FLAGS=-fsanitize=thread (and -DCMAKE_C_FLAGS=-fsanitize=thread) to check for data races.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "aribcaption/aribcaption.hpp"
+#include "sample_data.h"
+
+using namespace aribcaption;
+
+constexpr int worker_count = 8;
+constexpr int iteration_count = 50;
+
+static bool DecodeSample(Decoder& decoder, const uint8_t* data, size_t size, int64_t pts, Caption& out_caption) {
+    DecodeResult result;
+    DecodeStatus status = decoder.Decode(data, size, pts, result);
+    if (status != DecodeStatus::kGotCaption) {
+        return false;
+    }
+    out_caption = std::move(*result.caption);
+    out_caption.iso6392_language_code = ThreeCC("jpn");
+    return true;
+}
+
+static void RunWorker(Context& context, int index, std::atomic<int>& failures) {
+    Decoder decoder(context);
+    decoder.Initialize();
+
+    Renderer renderer(context);
+    renderer.Initialize();
+    renderer.SetFrameSize(1920, 1080);
+    if (index % 2) {
+        renderer.SetRegionRenderThreads(2);
+    }
+
+    // Results must not depend on what other threads are doing.
+    // Rendering may fail without suitable fonts installed, but must fail consistently.
+    std::string expected_text[2];
+    std::optional<RenderStatus> expected_status[2];
+    for (int i = 0; i < iteration_count; i++) {
+        int64_t pts = static_cast<int64_t>(i) * 1000;
+        Caption caption;
+        bool drcs = (i + index) % 2 != 0;
+        bool got_caption = drcs ? DecodeSample(decoder, sample_data_drcs_1, sizeof(sample_data_drcs_1), pts, caption)
+                                : DecodeSample(decoder, sample_data_1, sizeof(sample_data_1), pts, caption);
+        if (!got_caption) {
+            failures++;
+            continue;
+        }
+
+        if (expected_text[drcs].empty()) {
+            expected_text[drcs] = caption.text;
+        } else if (caption.text != expected_text[drcs]) {
+            failures++;
+        }
+
+        caption.wait_duration = 1000;
+        renderer.AppendCaption(std::move(caption));
+
+        RenderResult render_result;
+        RenderStatus status = renderer.Render(pts, render_result);
+        if (status == RenderStatus::kGotImageUnchanged) {
+            status = RenderStatus::kGotImage;
+        }
+        if (!expected_status[drcs]) {
+            expected_status[drcs] = status;
+        } else if (status != expected_status[drcs]) {
+            failures++;
+        }
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    Context context;
+    context.SetShareFontFaces(true);
+
+    std::atomic<int> failures{0};
+    std::atomic<bool> quit{false};
+
+    // Reconfigure the context while it's being used by all the workers
+    std::thread configurator([&] {
+        int round = 0;
+        while (!quit) {
+            if (round % 2) {
+                context.SetLogcatCallback(nullptr);
+            } else {
+                context.SetLogcatCallback([](LogLevel level, const char* message) {
+                    if (level == LogLevel::kError) {
+                        fprintf(stderr, "%s\n", message);
+                    }
+                });
+            }
+            context.SetShareFontFaces(round % 3 != 0);
+            round++;
+            std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < worker_count; i++) {
+        workers.emplace_back(RunWorker, std::ref(context), i, std::ref(failures));
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    quit = true;
+    configurator.join();
+
+    printf("Workers: %d, iterations: %d, failures: %d\n", worker_count, iteration_count, failures.load());
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
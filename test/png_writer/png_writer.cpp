@@ -122,7 +122,7 @@ bool png_writer_write_image(const char* filename, const Image& image) {
     std::vector<png_bytep> row_pointers;
 
     for (int y = 0; y < image.height ; y++) {
-        auto base = reinterpret_cast<const uint8_t*>(image.bitmap.data());
+        auto base = image.data();
         uint8_t* ptr = const_cast<uint8_t*>(base) + y * image.stride;
         row_pointers.push_back(ptr);
     }
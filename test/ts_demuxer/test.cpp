@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "aribcaption/caption_seek_index.hpp"
+#include "aribcaption/context.hpp"
+#include "aribcaption/decoder.hpp"
+#include "aribcaption/ts_demuxer.hpp"
+#include "sample_data.h"
+
+using namespace aribcaption;
+
+// Builds 188-byte TS packets for feeding the demuxer
+class TSWriter {
+public:
+    void WriteSection(uint16_t pid, std::vector<uint8_t> section) {
+        // section_length covers the bytes after it, including CRC_32
+        size_t section_length = section.size() - 3 + 4;
+        section[1] = static_cast<uint8_t>((section[1] & 0xF0) | (section_length >> 8));
+        section[2] = static_cast<uint8_t>(section_length & 0xFF);
+        uint32_t crc = CRC32(section.data(), section.size());
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            section.push_back(static_cast<uint8_t>(crc >> shift));
+        }
+        section.insert(section.begin(), 0x00);  // pointer_field
+        WritePayload(pid, section);
+    }
+
+    void WritePES(uint16_t pid, uint8_t stream_id, int64_t pts_90k, const uint8_t* data, size_t size) {
+        std::vector<uint8_t> pes = {0x00, 0x00, 0x01, stream_id, 0x00, 0x00, 0x80, 0x80, 0x05};
+        pes.push_back(static_cast<uint8_t>(0x21 | ((pts_90k >> 29) & 0x0E)));
+        pes.push_back(static_cast<uint8_t>(pts_90k >> 22));
+        pes.push_back(static_cast<uint8_t>(0x01 | ((pts_90k >> 14) & 0xFE)));
+        pes.push_back(static_cast<uint8_t>(pts_90k >> 7));
+        pes.push_back(static_cast<uint8_t>(0x01 | ((pts_90k << 1) & 0xFE)));
+        pes.insert(pes.end(), data, data + size);
+        size_t pes_packet_length = pes.size() - 6;
+        pes[4] = static_cast<uint8_t>(pes_packet_length >> 8);
+        pes[5] = static_cast<uint8_t>(pes_packet_length & 0xFF);
+        WritePayload(pid, pes);
+    }
+
+    const std::vector<uint8_t>& data() const { return data_; }
+private:
+    void WritePayload(uint16_t pid, const std::vector<uint8_t>& payload) {
+        size_t offset = 0;
+        bool first = true;
+        while (offset < payload.size()) {
+            size_t chunk = std::min<size_t>(184, payload.size() - offset);
+            data_.push_back(0x47);
+            data_.push_back(static_cast<uint8_t>((first ? 0x40 : 0x00) | (pid >> 8)));
+            data_.push_back(static_cast<uint8_t>(pid & 0xFF));
+            uint8_t& cc = continuity_counters_[pid];
+            if (chunk < 184) {
+                // Pad with adaptation field stuffing
+                size_t adaptation_field_length = 184 - chunk - 1;
+                data_.push_back(static_cast<uint8_t>(0x30 | cc));
+                data_.push_back(static_cast<uint8_t>(adaptation_field_length));
+                if (adaptation_field_length) {
+                    data_.push_back(0x00);
+                    data_.insert(data_.end(), adaptation_field_length - 1, 0xFF);
+                }
+            } else {
+                data_.push_back(static_cast<uint8_t>(0x10 | cc));
+            }
+            cc = (cc + 1) & 0x0F;
+            data_.insert(data_.end(), payload.begin() + offset, payload.begin() + offset + chunk);
+            offset += chunk;
+            first = false;
+        }
+    }
+
+    static uint32_t CRC32(const uint8_t* data, size_t size) {
+        uint32_t crc = 0xFFFFFFFF;
+        for (size_t i = 0; i < size; i++) {
+            crc ^= static_cast<uint32_t>(data[i]) << 24;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+            }
+        }
+        return crc;
+    }
+private:
+    std::vector<uint8_t> data_;
+    uint8_t continuity_counters_[0x2000] = {};
+};
+
+constexpr uint16_t kPMTPID = 0x01F0;
+constexpr uint16_t kVideoPID = 0x0100;
+constexpr uint16_t kCaptionPID = 0x0130;
+constexpr uint16_t kSuperimposePID = 0x0138;
+constexpr int64_t kPTSWrap = INT64_C(1) << 33;
+
+static std::vector<uint8_t> MakeTS(int repeat) {
+    TSWriter writer;
+    writer.WriteSection(0x0000, {
+        0x00, 0xB0, 0x00, 0x7F, 0xE1, 0xC1, 0x00, 0x00,
+        0x00, 0x00, 0xE0, 0x10,                                  // network_PID
+        0x04, 0x08, static_cast<uint8_t>(0xE0 | (kPMTPID >> 8)), kPMTPID & 0xFF,
+    });
+    writer.WriteSection(kPMTPID, {
+        0x02, 0xB0, 0x00, 0x04, 0x08, 0xC1, 0x00, 0x00, 0xE1, 0x00, 0xF0, 0x00,
+        0x02, 0xE1, 0x00, 0xF0, 0x03, 0x52, 0x01, 0x00,               // video, component_tag 0x00
+        0x06, 0xE1, 0x30, 0xF0, 0x07, 0x52, 0x01, 0x30, 0xFD, 0x02, 0x00, 0x08,  // caption
+        0x06, 0xE1, 0x38, 0xF0, 0x03, 0x52, 0x01, 0x38,               // superimpose, tag only
+        0x06, 0xE1, 0x40, 0xF0, 0x07, 0x52, 0x01, 0x40, 0xFD, 0x02, 0x00, 0x0C,  // data broadcasting
+    });
+
+    const uint8_t video_payload[8] = {0x00, 0x00, 0x00, 0x01, 0x09, 0xF0, 0x00, 0x00};
+    int64_t base_pts = kPTSWrap - 90000 * 5;  // Wraps around in the middle
+    writer.WritePES(kVideoPID, 0xE0, base_pts, video_payload, sizeof(video_payload));
+    for (int i = 0; i < repeat; i++) {
+        int64_t pts = (base_pts + 90000 * (i + 1)) % kPTSWrap;
+        const uint8_t* data = i % 2 ? sample_data_drcs_1 : sample_data_1;
+        size_t size = i % 2 ? sizeof(sample_data_drcs_1) : sizeof(sample_data_1);
+        writer.WritePES(kCaptionPID, 0xBD, pts, data, size);
+        writer.WritePES(kVideoPID, 0xE0, pts, video_payload, sizeof(video_payload));
+    }
+    return writer.data();
+}
+
+struct Packet {
+    uint16_t pid;
+    int64_t pts;
+    uint64_t offset;
+    std::vector<uint8_t> data;
+};
+
+static std::vector<Packet> Demux(Context& context, const std::vector<uint8_t>& ts, std::mt19937* rng) {
+    std::vector<Packet> packets;
+    TSDemuxer demuxer(context);
+    demuxer.SetPacketCallback([&](const TSCaptionPacket& packet) {
+        packets.push_back(Packet{packet.stream->pid, packet.pts, packet.offset,
+                                 std::vector<uint8_t>(packet.data, packet.data + packet.length)});
+    });
+
+    if (!rng) {
+        demuxer.Feed(ts.data(), ts.size());
+    } else {
+        // Feed in random chunks, with leading garbage bytes
+        const uint8_t garbage[5] = {0x00, 0x12, 0x34, 0x56, 0x78};
+        demuxer.Feed(garbage, sizeof(garbage));
+        size_t offset = 0;
+        while (offset < ts.size()) {
+            size_t chunk = std::min<size_t>(1 + (*rng)() % 400, ts.size() - offset);
+            demuxer.Feed(ts.data() + offset, chunk);
+            offset += chunk;
+        }
+    }
+    demuxer.Flush();
+
+    const auto& streams = demuxer.GetCaptionStreams();
+    bool streams_ok = streams.size() == 2 &&
+                      streams[0].pid == kCaptionPID && streams[0].type == CaptionType::kCaption &&
+                      streams[1].pid == kSuperimposePID && streams[1].type == CaptionType::kSuperimpose;
+    printf("Caption streams: %zu %s, first video PTS: %lld\n",
+           streams.size(), streams_ok ? "OK" : "FAILED", static_cast<long long>(demuxer.GetFirstVideoPTS()));
+    return packets;
+}
+
+int main(int argc, const char* argv[]) {
+    Context context;
+    context.SetLogcatCallback([](LogLevel level, const char* message) {
+        if (level == LogLevel::kError || level == LogLevel::kWarning) {
+            fprintf(stderr, "%s\n", message);
+        }
+    });
+
+    const int repeat = 10;
+    std::vector<uint8_t> ts = MakeTS(repeat);
+    std::mt19937 rng(1);
+
+    std::vector<Packet> expected = Demux(context, ts, nullptr);
+    std::vector<Packet> chunked = Demux(context, ts, &rng);
+
+    int failures = 0;
+    if (expected.size() != static_cast<size_t>(repeat) || chunked.size() != expected.size()) {
+        failures++;
+    }
+    for (size_t i = 0; i < expected.size() && i < chunked.size(); i++) {
+        const uint8_t* data = i % 2 ? sample_data_drcs_1 : sample_data_1;
+        size_t size = i % 2 ? sizeof(sample_data_drcs_1) : sizeof(sample_data_1);
+        int64_t expected_pts = ((kPTSWrap - 90000 * 5) + 90000 * static_cast<int64_t>(i + 1)) / 90;
+        const Packet& packet = expected[i];
+        if (packet.pid != kCaptionPID || packet.pts != expected_pts || packet.data.size() != size ||
+            memcmp(packet.data.data(), data, size) != 0 ||
+            chunked[i].pts != packet.pts || chunked[i].data != packet.data ||
+            chunked[i].offset != packet.offset + 5 || packet.offset % 188 != 0) {
+            printf("Packet %zu mismatch, pts: %lld\n", i, static_cast<long long>(packet.pts));
+            failures++;
+        }
+    }
+
+    // Packets are ready for decoding as-is, build a seek index meanwhile
+    Decoder decoder(context);
+    decoder.Initialize();
+    DecodeResult result;
+    CaptionSeekIndex index;
+    std::vector<uint8_t> state;
+    std::vector<std::string> texts;
+    for (const Packet& packet : expected) {
+        decoder.SaveState(state);
+        index.Append(packet.pts, packet.offset, state);
+        auto status = decoder.Decode(packet.data.data(), packet.data.size(), packet.pts, result);
+        if (status == DecodeStatus::kGotCaption) {
+            printf("[%lld] %s\n", static_cast<long long>(result.caption->pts), result.caption->text.c_str());
+            texts.push_back(result.caption->text);
+        } else {
+            texts.emplace_back();
+            failures += status == DecodeStatus::kError;
+        }
+    }
+
+    // Restored states must be saved back identically
+    decoder.SaveState(state);
+    Decoder restored(context);
+    restored.Initialize();
+    std::vector<uint8_t> restored_state;
+    if (restored.RestoreState(state.data(), state.size())) {
+        restored.SaveState(restored_state);
+    }
+    if (restored_state != state) {
+        printf("Decoder state round trip FAILED\n");
+        failures++;
+    }
+
+    std::vector<uint8_t> index_data;
+    index.Serialize(index_data);
+    CaptionSeekIndex loaded;
+    if (!loaded.Deserialize(index_data.data(), index_data.size()) ||
+        loaded.seek_points().size() != expected.size() || loaded.state_count() != index.state_count()) {
+        printf("Seek index round trip FAILED\n");
+        failures++;
+    }
+    printf("Seek index: %zu points, %zu states, %zu bytes\n",
+           loaded.seek_points().size(), loaded.state_count(), index_data.size());
+
+    // Seek to each caption, then resume demuxing and decoding from the recorded offset
+    TSDemuxer demuxer(context);
+    demuxer.Feed(ts.data(), ts.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        Decoder seeked(context);
+        seeked.Initialize();
+        uint64_t offset = 0;
+        if (!loaded.Seek(expected[i].pts + 500, seeked, offset) || offset != expected[i].offset) {
+            printf("Seek to packet %zu FAILED\n", i);
+            failures++;
+            continue;
+        }
+
+        std::string text;
+        bool got_packet = false;
+        demuxer.SetPacketCallback([&](const TSCaptionPacket& packet) {
+            if (got_packet) {
+                return;
+            }
+            got_packet = true;
+            if (seeked.Decode(packet.data, packet.length, packet.pts, result) == DecodeStatus::kGotCaption) {
+                text = result.caption->text;
+            }
+        });
+        demuxer.Seek(offset);
+        demuxer.Feed(ts.data() + offset, ts.size() - offset);
+        demuxer.Flush();
+        if (!got_packet || text != texts[i]) {
+            printf("Decoding after seeking to packet %zu mismatch\n", i);
+            failures++;
+        }
+    }
+
+    printf("Packets: %zu, failures: %d\n", expected.size(), failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,552 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/decoder.hpp"
+#include "aribcaption/subtitle_writer.hpp"
+#include "aribcaption/ts_demuxer.hpp"
+#include "base/mapped_file.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+constexpr size_t kTSPacketSize = 188;
+constexpr size_t kMaxPrescanSize = 64 * 1024 * 1024;
+constexpr size_t kMinChunkSize = 8 * 1024 * 1024;
+constexpr size_t kMaxChunkTailSize = 4 * 1024 * 1024;
+constexpr int64_t kLastCaptionDuration = 1000;
+
+enum class OutputFormat {
+    kSRT,
+    kWebVTT,
+    kTTML,
+    kASS,
+};
+
+struct Options {
+    std::vector<std::string> inputs;
+    std::string output;
+    OutputFormat format = OutputFormat::kSRT;
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    bool superimpose = false;
+    bool quiet = false;
+};
+
+// Caption PES packet captured by a demuxing worker, data lives in the chunk's arena
+struct CapturedPacket {
+    uint16_t pid;
+    int64_t pts;
+    size_t offset;
+    size_t length;
+};
+
+struct ChunkResult {
+    std::vector<uint8_t> arena;
+    std::vector<CapturedPacket> packets;
+};
+
+struct Subtitle {
+    int64_t begin;
+    int64_t end;
+    std::string text;
+};
+
+// A caption stream and language decoded by one job, which results in one output file
+struct DecodeJob {
+    TSCaptionStream stream;
+    LanguageId language_id = LanguageId::kFirst;
+    uint32_t iso6392_language_code = 0;
+    std::vector<Subtitle> subtitles;
+    std::string content;  // Formatted by SubtitleWriter, for formats other than SRT
+    size_t cue_count = 0;
+    size_t error_count = 0;
+};
+
+void PrintUsage(const char* program) {
+    printf("Usage: %s [OPTIONS] INPUT.ts [INPUT.ts ...]\n\n"
+           "Extract ARIB captions from MPEG-TS files into subtitle files.\n\n"
+           "Options:\n"
+           "  -o, --output PATH    Output file path, only valid with a single input.\n"
+           "                       Defaults to the input path with the extension of the format.\n"
+           "  -f, --format FORMAT  srt (default), vtt, ttml or ass\n"
+           "                       Formats other than srt keep positions, colors and ruby of captions\n"
+           "  -j, --threads N      Worker thread count, defaults to the count of CPU cores\n"
+           "  -s, --superimpose    Also extract superimpose streams\n"
+           "  -q, --quiet          Only print errors\n"
+           "  -h, --help           Show this help\n\n"
+           "The second language of a stream, and streams other than the first caption stream,\n"
+           "are written to separate files named with the language code or the PID inserted.\n",
+           program);
+}
+
+bool ParseOptions(int argc, const char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next_value = [&]() -> const char* {
+            return i + 1 < argc ? argv[++i] : nullptr;
+        };
+
+        if (arg == "-h" || arg == "--help") {
+            return false;
+        } else if (arg == "-o" || arg == "--output") {
+            const char* value = next_value();
+            if (!value) {
+                return false;
+            }
+            options.output = value;
+        } else if (arg == "-f" || arg == "--format") {
+            const char* value = next_value();
+            std::string format = value ? value : "";
+            if (format == "srt") {
+                options.format = OutputFormat::kSRT;
+            } else if (format == "vtt" || format == "webvtt") {
+                options.format = OutputFormat::kWebVTT;
+            } else if (format == "ttml") {
+                options.format = OutputFormat::kTTML;
+            } else if (format == "ass") {
+                options.format = OutputFormat::kASS;
+            } else {
+                fprintf(stderr, "Unknown format: %s\n", format.c_str());
+                return false;
+            }
+        } else if (arg == "-j" || arg == "--threads") {
+            const char* value = next_value();
+            int threads = value ? atoi(value) : 0;
+            if (threads <= 0) {
+                fprintf(stderr, "Invalid thread count\n");
+                return false;
+            }
+            options.threads = static_cast<size_t>(threads);
+        } else if (arg == "-s" || arg == "--superimpose") {
+            options.superimpose = true;
+        } else if (arg == "-q" || arg == "--quiet") {
+            options.quiet = true;
+        } else if (!arg.empty() && arg[0] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            return false;
+        } else {
+            options.inputs.push_back(arg);
+        }
+    }
+
+    if (options.inputs.empty()) {
+        return false;
+    }
+    if (!options.output.empty() && options.inputs.size() > 1) {
+        fprintf(stderr, "--output could only be used with a single input\n");
+        return false;
+    }
+    return true;
+}
+
+void LogToStderr(Context& context) {
+    context.SetLogcatCallback([](LogLevel level, const char* message) {
+        if (level == LogLevel::kError) {
+            fprintf(stderr, "%s\n", message);
+        }
+    });
+}
+
+uint16_t PacketPID(const uint8_t* packet) {
+    return static_cast<uint16_t>((packet[1] & 0x1F) << 8 | packet[2]);
+}
+
+// Find the first offset followed by two consecutive sync bytes
+size_t FindSyncOffset(const uint8_t* data, size_t size) {
+    for (size_t offset = 0; offset + kTSPacketSize < size && offset < kTSPacketSize; offset++) {
+        if (data[offset] == 0x47 && data[offset + kTSPacketSize] == 0x47) {
+            return offset;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Demux one chunk of the file [begin, end)
+ *
+ * The demuxer is warmed up by the prescanned head of the file, so that it knows the PMT at the chunk start.
+ * PES packets which start inside the chunk belong to it, those left incomplete at the end are finished
+ * by following packets of their PIDs. Packets before the first PES start of a PID belong to the previous chunk,
+ * and are dropped naturally by the demuxer.
+ */
+void DemuxChunk(const uint8_t* file, size_t file_size, size_t prescan_size,
+                size_t begin, size_t end, ChunkResult& out_result) {
+    Context context;
+    LogToStderr(context);
+    TSDemuxer demuxer(context);
+
+    bool capture = false;
+    demuxer.SetPacketCallback([&](const TSCaptionPacket& packet) {
+        if (!capture) {
+            return;
+        }
+        out_result.packets.push_back(CapturedPacket{packet.stream->pid, packet.pts,
+                                                    out_result.arena.size(), packet.length});
+        out_result.arena.insert(out_result.arena.end(), packet.data, packet.data + packet.length);
+    });
+
+    if (begin > 0) {
+        demuxer.Feed(file, prescan_size);
+        demuxer.Flush();
+    }
+    capture = true;
+    demuxer.Feed(file + begin, end - begin);
+
+    std::vector<uint16_t> pending_pids;
+    for (const TSCaptionStream& stream : demuxer.GetCaptionStreams()) {
+        pending_pids.push_back(stream.pid);
+    }
+    size_t tail_end = std::min(file_size, end + kMaxChunkTailSize);
+    for (size_t offset = end; offset + kTSPacketSize <= tail_end && !pending_pids.empty(); offset += kTSPacketSize) {
+        const uint8_t* packet = file + offset;
+        if (packet[0] != 0x47) {
+            break;
+        }
+        auto iter = std::find(pending_pids.begin(), pending_pids.end(), PacketPID(packet));
+        if (iter == pending_pids.end()) {
+            continue;
+        }
+        if (packet[1] & 0x40) {
+            pending_pids.erase(iter);  // Start of the next PES packet, owned by the next chunk
+            continue;
+        }
+        demuxer.Feed(packet, kTSPacketSize);
+    }
+    demuxer.Flush();
+}
+
+SubtitleFormat ToSubtitleFormat(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::kTTML:
+            return SubtitleFormat::kTTML;
+        case OutputFormat::kASS:
+            return SubtitleFormat::kASS;
+        case OutputFormat::kWebVTT:
+        default:
+            return SubtitleFormat::kWebVTT;
+    }
+}
+
+void DecodeStream(const std::vector<ChunkResult>& chunks, int64_t origin_pts, OutputFormat format, DecodeJob& job) {
+    Context context;
+    LogToStderr(context);
+    Decoder decoder(context);
+    decoder.Initialize(EncodingScheme::kAuto, job.stream.type, Profile::kDefault, job.language_id);
+    decoder.SetReuseCaptionStorage(true);
+
+    // SRT only takes plain text, other formats are written with layout by SubtitleWriter
+    std::unique_ptr<SubtitleWriter> writer;
+    if (format == OutputFormat::kSRT) {
+        decoder.SetTextOnly(true);
+    } else {
+        writer = std::make_unique<SubtitleWriter>(ToSubtitleFormat(format));
+        writer->SetLastCaptionDuration(kLastCaptionDuration);
+        writer->SetOutputCallback([&job](const char* data, size_t length) {
+            job.content.append(data, length);
+        });
+    }
+
+    DecodeResult result;
+    bool prev_indefinite = false;
+
+    for (const ChunkResult& chunk : chunks) {
+        for (const CapturedPacket& packet : chunk.packets) {
+            if (packet.pid != job.stream.pid) {
+                continue;
+            }
+            int64_t pts = packet.pts == PTS_NOPTS ? 0 : std::max<int64_t>(0, packet.pts - origin_pts);
+            auto status = decoder.Decode(chunk.arena.data() + packet.offset, packet.length, pts, result);
+            if (status == DecodeStatus::kError) {
+                job.error_count++;
+                continue;
+            } else if (status != DecodeStatus::kGotCaption) {
+                continue;
+            }
+
+            const Caption& caption = *result.caption;
+            if (!job.iso6392_language_code) {
+                job.iso6392_language_code = caption.iso6392_language_code;
+            }
+            if (writer) {
+                writer->AppendCaption(caption);
+                continue;
+            }
+            if (prev_indefinite) {
+                job.subtitles.back().end = caption.pts;
+            }
+            prev_indefinite = false;
+            if (caption.text.empty()) {
+                continue;  // e.g. clear screen, only terminates the previous caption
+            }
+
+            bool indefinite = caption.wait_duration == DURATION_INDEFINITE;
+            int64_t end = indefinite ? caption.pts + kLastCaptionDuration : caption.pts + caption.wait_duration;
+            job.subtitles.push_back(Subtitle{caption.pts, end, caption.text});
+            prev_indefinite = indefinite;
+        }
+    }
+
+    if (writer) {
+        writer->Finish();
+        job.cue_count = writer->cue_count();
+    } else {
+        job.cue_count = job.subtitles.size();
+    }
+}
+
+std::string FormatTime(int64_t millis) {
+    char buffer[32];
+    int64_t hours = millis / 1000 / 60 / 60;
+    int64_t minutes = (millis / 1000 / 60) % 60;
+    int64_t seconds = (millis / 1000) % 60;
+    snprintf(buffer, sizeof(buffer), "%02" PRId64 ":%02" PRId64 ":%02" PRId64 ",%03" PRId64,
+             hours, minutes, seconds, millis % 1000);
+    return buffer;
+}
+
+std::string FormatSRT(const std::vector<Subtitle>& subtitles) {
+    std::string out;
+    size_t index = 1;
+    for (const Subtitle& subtitle : subtitles) {
+        out += std::to_string(index) + "\n";
+        out += FormatTime(subtitle.begin) + " --> " + FormatTime(subtitle.end) + "\n";
+        out += subtitle.text + "\n\n";
+        index++;
+    }
+    return out;
+}
+
+const char* FormatExtension(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::kWebVTT:
+            return ".vtt";
+        case OutputFormat::kTTML:
+            return ".ttml";
+        case OutputFormat::kASS:
+            return ".ass";
+        case OutputFormat::kSRT:
+        default:
+            return ".srt";
+    }
+}
+
+// Insert suffix before the extension of path, or append the format extension if path has no extension
+std::string MakeOutputPath(const std::string& base, const std::string& suffix, OutputFormat format, bool has_extension) {
+    if (!has_extension) {
+        return base + suffix + FormatExtension(format);
+    }
+    size_t dot = base.find_last_of('.');
+    size_t slash = base.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return base + suffix;
+    }
+    return base.substr(0, dot) + suffix + base.substr(dot);
+}
+
+std::string StripExtension(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return path;
+    }
+    return path.substr(0, dot);
+}
+
+std::string LanguageCodeString(uint32_t iso6392_language_code) {
+    std::string code;
+    for (int shift = 16; shift >= 0; shift -= 8) {
+        auto ch = static_cast<char>((iso6392_language_code >> shift) & 0xFF);
+        if (ch >= 'a' && ch <= 'z') {
+            code += ch;
+        }
+    }
+    return code;
+}
+
+bool ExtractFile(const std::string& input, const Options& options, size_t& out_caption_count, size_t& out_bytes) {
+    auto start_time = std::chrono::steady_clock::now();
+
+    MappedFile file;
+    if (!file.Open(input)) {
+        fprintf(stderr, "%s: Cannot open input\n", input.c_str());
+        return false;
+    }
+    const uint8_t* data = file.data();
+    size_t sync_offset = FindSyncOffset(data, file.size());
+    size_t size = sync_offset + (file.size() - sync_offset) / kTSPacketSize * kTSPacketSize;
+
+    // Prescan the head of the file for caption streams and the first video PTS
+    Context context;
+    LogToStderr(context);
+    TSDemuxer prescan(context);
+    size_t prescan_size = sync_offset;
+    while (prescan_size < size && prescan_size < kMaxPrescanSize &&
+           (prescan.GetCaptionStreams().empty() || prescan.GetFirstVideoPTS() == PTS_NOPTS)) {
+        size_t block_size = std::min<size_t>(kTSPacketSize * 1024, size - prescan_size);
+        prescan.Feed(data + prescan_size, block_size);
+        prescan_size += block_size;
+    }
+
+    std::vector<DecodeJob> jobs;
+    for (const TSCaptionStream& stream : prescan.GetCaptionStreams()) {
+        if (stream.type == CaptionType::kSuperimpose && !options.superimpose) {
+            continue;
+        }
+        for (LanguageId language_id : {LanguageId::kFirst, LanguageId::kSecond}) {
+            DecodeJob job;
+            job.stream = stream;
+            job.language_id = language_id;
+            jobs.push_back(std::move(job));
+        }
+    }
+    if (jobs.empty()) {
+        fprintf(stderr, "%s: No caption stream found\n", input.c_str());
+        return false;
+    }
+    int64_t origin_pts = prescan.GetFirstVideoPTS() == PTS_NOPTS ? 0 : prescan.GetFirstVideoPTS();
+
+    // Demux chunks in parallel
+    size_t packet_count = (size - sync_offset) / kTSPacketSize;
+    size_t chunk_count = std::clamp<size_t>((size - sync_offset) / kMinChunkSize, 1, options.threads * 4);
+    std::vector<size_t> boundaries;
+    for (size_t i = 0; i <= chunk_count; i++) {
+        boundaries.push_back(sync_offset + packet_count * i / chunk_count * kTSPacketSize);
+    }
+
+    std::vector<ChunkResult> chunks(chunk_count);
+    std::atomic<size_t> next_chunk{0};
+    auto demux_worker = [&]() {
+        for (size_t i = next_chunk++; i < chunk_count; i = next_chunk++) {
+            DemuxChunk(data, size, prescan_size, boundaries[i], boundaries[i + 1], chunks[i]);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(options.threads, chunk_count); i++) {
+        workers.emplace_back(demux_worker);
+    }
+    demux_worker();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    // Decode each stream and language in parallel
+    std::atomic<size_t> next_job{0};
+    auto decode_worker = [&]() {
+        for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+            DecodeStream(chunks, origin_pts, options.format, jobs[i]);
+        }
+    };
+    for (size_t i = 1; i < std::min(options.threads, jobs.size()); i++) {
+        workers.emplace_back(decode_worker);
+    }
+    decode_worker();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    // The first caption stream goes to the plain output path, others are distinguished by suffixes
+    bool has_extension = !options.output.empty();
+    std::string base = has_extension ? options.output : StripExtension(input);
+    uint16_t primary_pid = jobs.front().stream.pid;
+    size_t caption_count = 0;
+    bool ok = true;
+
+    for (const DecodeJob& job : jobs) {
+        if (!job.cue_count) {
+            continue;
+        }
+        std::string suffix;
+        if (job.stream.pid != primary_pid) {
+            char pid[16];
+            snprintf(pid, sizeof(pid), ".pid%04X", job.stream.pid);
+            suffix += pid;
+        }
+        if (job.language_id != LanguageId::kFirst) {
+            std::string code = LanguageCodeString(job.iso6392_language_code);
+            suffix += "." + (code.empty() ? std::string("lang2") : code);
+        }
+
+        std::string path = MakeOutputPath(base, suffix, options.format, has_extension);
+        std::ofstream ofs(path, std::ios::binary);
+        std::string content = options.format == OutputFormat::kSRT ? FormatSRT(job.subtitles) : job.content;
+        ofs.write(content.data(), static_cast<std::streamsize>(content.size()));
+        if (!ofs) {
+            fprintf(stderr, "%s: Cannot write output\n", path.c_str());
+            ok = false;
+            continue;
+        }
+        caption_count += job.cue_count;
+        if (!options.quiet) {
+            printf("%s: %zu captions, %zu errors\n", path.c_str(), job.cue_count, job.error_count);
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    if (!options.quiet) {
+        printf("%s: %.1f MB in %.3f s, %.1f MB/s, %zu chunks\n", input.c_str(), (double)file.size() / 1e6,
+               seconds, (double)file.size() / 1e6 / std::max(seconds, 1e-9), chunk_count);
+    }
+
+    out_caption_count += caption_count;
+    out_bytes += file.size();
+    return ok;
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return -1;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    size_t caption_count = 0;
+    size_t bytes = 0;
+    int failures = 0;
+
+    for (const std::string& input : options.inputs) {
+        if (!ExtractFile(input, options, caption_count, bytes)) {
+            failures++;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    if (!options.quiet && options.inputs.size() > 1) {
+        printf("Total: %zu files, %zu failed, %zu captions, %.1f MB in %.3f s, %.1f MB/s\n",
+               options.inputs.size(), static_cast<size_t>(failures), caption_count, (double)bytes / 1e6,
+               seconds, (double)bytes / 1e6 / std::max(seconds, 1e-9));
+    }
+    return failures ? 1 : 0;
+}
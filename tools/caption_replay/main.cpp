@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "aribcc_config.h"
+#include "aribcaption/context.hpp"
+#include "aribcaption/decoder.hpp"
+#ifndef ARIBCC_NO_RENDERER
+#include "aribcaption/renderer.hpp"
+#endif
+#include "base/mapped_file.hpp"
+#include "decoder/pes_capture.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string input;
+    int frame_width = 1920;
+    int frame_height = 1080;
+    double speed = 0.0;  // Multiple of real time, 0 for max speed
+#ifdef ARIBCC_NO_RENDERER
+    bool render = false;  // Built without the renderer, decode only
+#else
+    bool render = true;
+#endif
+    bool quiet = false;
+};
+
+void PrintUsage(const char* program) {
+    printf("Usage: %s [OPTIONS] CAPTURE\n\n"
+           "Replay caption PES packets captured by Decoder::SetCaptureFile() through a Decoder and a Renderer,\n"
+           "and report decoding / rendering latency percentiles.\n\n"
+           "Options:\n"
+           "  -r, --resolution WxH  Frame size of rendering, defaults to 1920x1080\n"
+           "  -x, --speed N         Replay at N times real time by PTS, defaults to max speed (0)\n"
+           "  -n, --no-render       Only decode (always on if built without the renderer)\n"
+           "  -q, --quiet           Only print the summary\n"
+           "  -h, --help            Show this help\n",
+           program);
+}
+
+bool ParseOptions(int argc, const char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next_value = [&]() -> const char* {
+            return i + 1 < argc ? argv[++i] : nullptr;
+        };
+
+        if (arg == "-h" || arg == "--help") {
+            return false;
+        } else if (arg == "-r" || arg == "--resolution") {
+            const char* value = next_value();
+            if (!value || sscanf(value, "%dx%d", &options.frame_width, &options.frame_height) != 2 ||
+                    options.frame_width <= 0 || options.frame_height <= 0) {
+                fprintf(stderr, "Invalid resolution\n");
+                return false;
+            }
+        } else if (arg == "-x" || arg == "--speed") {
+            const char* value = next_value();
+            options.speed = value ? atof(value) : -1.0;
+            if (options.speed < 0.0) {
+                fprintf(stderr, "Invalid speed\n");
+                return false;
+            }
+        } else if (arg == "-n" || arg == "--no-render") {
+            options.render = false;
+        } else if (arg == "-q" || arg == "--quiet") {
+            options.quiet = true;
+        } else if (!arg.empty() && arg[0] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            return false;
+        } else if (options.input.empty()) {
+            options.input = arg;
+        } else {
+            fprintf(stderr, "Only one capture could be replayed at once\n");
+            return false;
+        }
+    }
+    return !options.input.empty();
+}
+
+int64_t ElapsedMicroseconds(Clock::time_point begin) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - begin).count();
+}
+
+// Nearest-rank percentiles of latencies in microseconds, sorts the samples
+void PrintLatencies(const char* name, std::vector<int64_t>& samples) {
+    if (samples.empty()) {
+        printf("%-8s no samples\n", name);
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p) -> int64_t {
+        size_t rank = static_cast<size_t>(p / 100.0 * static_cast<double>(samples.size()) + 0.5);
+        return samples[std::min(std::max<size_t>(rank, 1), samples.size()) - 1];
+    };
+    int64_t total = 0;
+    for (int64_t sample : samples) {
+        total += sample;
+    }
+    printf("%-8s count %zu, mean %" PRId64 " us, p50 %" PRId64 " us, p90 %" PRId64 " us, p99 %" PRId64
+           " us, max %" PRId64 " us\n",
+           name, samples.size(), total / static_cast<int64_t>(samples.size()),
+           percentile(50), percentile(90), percentile(99), samples.back());
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return -1;
+    }
+
+    MappedFile file;
+    if (!file.Open(options.input)) {
+        fprintf(stderr, "%s: Cannot open\n", options.input.c_str());
+        return 1;
+    }
+    PESCaptureReader reader(file.data(), file.size());
+    PESCaptureRecord record;
+    if (!reader.valid() || !reader.Next(record)) {
+        fprintf(stderr, "%s: Not a caption capture, or empty\n", options.input.c_str());
+        return 1;
+    }
+
+    Context context;
+    context.SetLogcatCallback([](LogLevel level, const char* message) {
+        if (level == LogLevel::kError) {
+            fprintf(stderr, "%s\n", message);
+        }
+    });
+
+    Decoder decoder(context);
+    decoder.Initialize(record.encoding_scheme, record.type, record.profile, record.language_id);
+    PESCaptureRecord current = record;
+
+#ifndef ARIBCC_NO_RENDERER
+    Renderer renderer(context);
+    if (options.render) {
+        if (!renderer.Initialize(record.type)) {
+            fprintf(stderr, "Renderer::Initialize() failed\n");
+            return 1;
+        }
+        renderer.SetFrameSize(options.frame_width, options.frame_height);
+        renderer.SetStoragePolicy(CaptionStoragePolicy::kUpperLimitCount, 8);
+    }
+    RenderResult render_result;
+#endif
+
+    std::vector<int64_t> decode_latencies;
+    std::vector<int64_t> render_latencies;
+    size_t packet_count = 0;
+    size_t decode_errors = 0;
+    size_t render_errors = 0;
+    int64_t first_pts = record.pts;
+    Clock::time_point start_time = Clock::now();
+    DecodeResult decode_result;
+
+    do {
+        // Settings changed while capturing are applied at the same packet
+        if (record.type != current.type) {
+            decoder.SetCaptionType(record.type);
+        }
+        if (record.profile != current.profile) {
+            decoder.SetProfile(record.profile);
+        }
+        if (record.encoding_scheme != current.encoding_scheme) {
+            decoder.SetEncodingScheme(record.encoding_scheme);
+        }
+        if (record.language_id != current.language_id) {
+            decoder.SwitchLanguage(record.language_id);
+        }
+        current = record;
+
+        if (options.speed > 0.0 && record.pts >= first_pts) {
+            auto due = std::chrono::microseconds(static_cast<int64_t>(
+                static_cast<double>(record.pts - first_pts) * 1000.0 / options.speed));
+            std::this_thread::sleep_until(start_time + due);
+        }
+
+        Clock::time_point decode_begin = Clock::now();
+        DecodeStatus status = decoder.Decode(record.data, record.length, record.pts, decode_result);
+        decode_latencies.push_back(ElapsedMicroseconds(decode_begin));
+        packet_count++;
+
+        if (status == DecodeStatus::kError) {
+            decode_errors++;
+        }
+#ifndef ARIBCC_NO_RENDERER
+        else if (status == DecodeStatus::kGotCaption && options.render) {
+            int64_t pts = decode_result.caption->pts;
+            Clock::time_point render_begin = Clock::now();
+            renderer.AppendCaption(std::move(*decode_result.caption));
+            RenderStatus render_status = renderer.Render(pts, render_result);
+            render_latencies.push_back(ElapsedMicroseconds(render_begin));
+
+            if (render_status == RenderStatus::kError) {
+                render_errors++;
+            }
+            if (!options.quiet) {
+                printf("pts %" PRId64 ": %zu images, rendered in %" PRId64 " us\n",
+                       pts, render_result.images.size(), render_latencies.back());
+            }
+        }
+#endif
+    } while (reader.Next(record));
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start_time).count();
+    printf("%s: %zu packets, %zu decode errors, %zu render errors in %.3f s\n",
+           options.input.c_str(), packet_count, decode_errors, render_errors, seconds);
+    PrintLatencies("decode", decode_latencies);
+    if (options.render) {
+        PrintLatencies("render", render_latencies);
+    }
+    return decode_errors || render_errors ? 1 : 0;
+}